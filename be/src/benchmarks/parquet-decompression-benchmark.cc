@@ -0,0 +1,196 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "gutil/strings/substitute.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "util/async-block-decompressor.h"
+#include "util/benchmark.h"
+#include "util/codec.h"
+#include "util/cpu-info.h"
+#include "util/thread.h"
+
+#include "common/names.h"
+
+// Benchmark to measure whether decompressing the data pages of a Parquet column chunk in
+// a separate thread pays off for the codecs of Parquet files (see
+// ParquetColumnChunkReader and --parquet_decompression_read_ahead_pages). For every
+// codec, NUM_PAGES text-like pages are decompressed and "decoded" by hashing their bytes
+// a number of times, which stands in for the cost of decoding the values. This compares:
+// * Sequential - every page is decompressed in the calling thread before it is decoded.
+// * Pipelined - like the column chunk reader, READ_AHEAD_PAGES pages at a time are
+//   decompressed by an AsyncBlockDecompressor while the previous ones are decoded.
+// Pipelining only gains if decompressing a page takes a good part of the time it takes
+// to decode it, which is the case for GZIP and ZSTD but not for Snappy.
+
+using std::mt19937;
+using std::uniform_int_distribution;
+using strings::Substitute;
+
+using namespace impala;
+
+constexpr int NUM_PAGES = 256;
+constexpr int64_t PAGE_SIZE = 64 * 1024;
+constexpr int READ_AHEAD_PAGES = 4;
+
+struct BenchmarkParams {
+  THdfsCompression::type codec;
+  /// Number of times the bytes of a page are hashed to decode it.
+  int decode_passes;
+
+  vector<string> compressed_pages;
+  boost::scoped_ptr<Codec> decompressor;
+  MemTracker mem_tracker;
+  MemPool pool;
+  boost::scoped_ptr<AsyncBlockDecompressor> async_decompressor;
+  /// Output buffer of the sequential benchmark.
+  vector<uint8_t> output;
+  /// The two sets of output buffers of the pipelined benchmark: one for the batch that is
+  /// decompressed and one for the batch that is decoded.
+  vector<uint8_t> read_ahead_outputs[2];
+  uint64_t checksum = 0;
+
+  BenchmarkParams(THdfsCompression::type codec, int decode_passes)
+    : codec(codec),
+      decode_passes(decode_passes),
+      pool(&mem_tracker),
+      output(PAGE_SIZE) {
+    for (vector<uint8_t>& outputs : read_ahead_outputs) {
+      outputs.resize(READ_AHEAD_PAGES * PAGE_SIZE);
+    }
+    // Rows of a few numeric and low-cardinality string fields, which compress to about
+    // the same ratio as typical Parquet data pages.
+    mt19937 rand_engine(codec);
+    uniform_int_distribution<int> dist(0, 100000);
+    const char* words[] = {"furiously", "quickly", "regular", "pending", "final"};
+    boost::scoped_ptr<Codec> compressor;
+    Status status = Codec::CreateCompressor(nullptr, false, Codec::CodecInfo(codec),
+        &compressor);
+    CHECK(status.ok()) << status.GetDetail();
+    for (int i = 0; i < NUM_PAGES; ++i) {
+      string page;
+      while (page.size() < PAGE_SIZE) {
+        int val = dist(rand_engine);
+        page += Substitute("$0|$1|$2 ", i, val, words[val % 5]);
+      }
+      page.resize(PAGE_SIZE);
+      string compressed(compressor->MaxOutputLen(PAGE_SIZE), '\0');
+      int64_t compressed_len = compressed.size();
+      uint8_t* compressed_data = reinterpret_cast<uint8_t*>(&compressed[0]);
+      status = compressor->ProcessBlock(true, PAGE_SIZE,
+          reinterpret_cast<const uint8_t*>(page.data()), &compressed_len,
+          &compressed_data);
+      CHECK(status.ok()) << status.GetDetail();
+      compressed.resize(compressed_len);
+      compressed_pages.push_back(move(compressed));
+    }
+    compressor->Close();
+    status = Codec::CreateDecompressor(nullptr, false, codec, &decompressor);
+    CHECK(status.ok()) << status.GetDetail();
+    async_decompressor.reset(new AsyncBlockDecompressor(&mem_tracker, codec));
+    status = async_decompressor->Open("benchmark", "parquet-decompression");
+    CHECK(status.ok()) << status.GetDetail();
+  }
+
+  ~BenchmarkParams() {
+    async_decompressor->Close();
+    decompressor->Close();
+    pool.FreeAll();
+  }
+
+  /// Adds the pages from 'page_idx' on to the next batch of 'async_decompressor', which
+  /// decompresses them into 'read_ahead_outputs[output_set]', and starts the batch.
+  /// Returns the index of the first page that was not added.
+  int ReadAhead(int page_idx, int output_set) {
+    for (int i = 0; i < READ_AHEAD_PAGES && page_idx < NUM_PAGES; ++i, ++page_idx) {
+      const string& page = compressed_pages[page_idx];
+      Status status = async_decompressor->AddBlock(
+          reinterpret_cast<const uint8_t*>(page.data()), page.size(),
+          read_ahead_outputs[output_set].data() + i * PAGE_SIZE, PAGE_SIZE);
+      CHECK(status.ok()) << status.GetDetail();
+    }
+    async_decompressor->StartBatch();
+    return page_idx;
+  }
+};
+
+uint64_t Decode(const uint8_t* data, int64_t len, int passes) {
+  uint64_t hash = 0;
+  for (int pass = 0; pass < passes; ++pass) {
+    for (int64_t i = 0; i < len; ++i) hash = hash * 31 + data[i];
+  }
+  return hash;
+}
+
+void SequentialBenchmark(int batch_size, void* data) {
+  BenchmarkParams* p = reinterpret_cast<BenchmarkParams*>(data);
+  for (int i = 0; i < batch_size; ++i) {
+    for (const string& page : p->compressed_pages) {
+      int64_t len = PAGE_SIZE;
+      uint8_t* output = p->output.data();
+      Status status = p->decompressor->ProcessBlock(true, page.size(),
+          reinterpret_cast<const uint8_t*>(page.data()), &len, &output);
+      CHECK(status.ok()) << status.GetDetail();
+      p->checksum += Decode(output, len, p->decode_passes);
+    }
+  }
+}
+
+void PipelinedBenchmark(int batch_size, void* data) {
+  BenchmarkParams* p = reinterpret_cast<BenchmarkParams*>(data);
+  vector<AsyncBlockDecompressor::Output> outputs;
+  for (int i = 0; i < batch_size; ++i) {
+    int output_set = 0;
+    int page_idx = p->ReadAhead(0, output_set);
+    while (p->async_decompressor->batch_in_progress()) {
+      Status status = p->async_decompressor->WaitForBatch(&p->pool, &outputs);
+      CHECK(status.ok()) << status.GetDetail();
+      // Decompress the next batch while the pages of this one are decoded.
+      output_set ^= 1;
+      if (page_idx < NUM_PAGES) page_idx = p->ReadAhead(page_idx, output_set);
+      for (const AsyncBlockDecompressor::Output& output : outputs) {
+        p->checksum += Decode(output.data, output.len, p->decode_passes);
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  InitThreading();
+  cout << endl << Benchmark::GetMachineInfo() << endl;
+
+  for (THdfsCompression::type codec :
+      {THdfsCompression::SNAPPY, THdfsCompression::GZIP, THdfsCompression::ZSTD}) {
+    for (int decode_passes : {1, 4}) {
+      BenchmarkParams params(codec, decode_passes);
+      Benchmark suite(Substitute("$0 decode passes $1", Codec::GetCodecName(codec),
+          decode_passes), false /* micro_heuristics */);
+      int baseline = suite.AddBenchmark("Sequential", SequentialBenchmark, &params, -1);
+      suite.AddBenchmark("Pipelined", PipelinedBenchmark, &params, baseline);
+      cout << suite.Measure() << endl;
+    }
+  }
+  return 0;
+}
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "gutil/strings/substitute.h"
+#include "scheduling/executor-scan-model.h"
 #include "scheduling/scheduler-test-util.h"
 #include "util/benchmark.h"
 #include "util/cpu-info.h"
@@ -34,6 +35,8 @@
 using namespace impala;
 using namespace impala::test;
 
+DECLARE_bool(scheduler_use_scan_throughput);
+
 
 // This benchmark exercises the core scheduling method 'ComputeScanRangeAssignment()' of
 // the Scheduler class for various cluster and table sizes. It makes the following
@@ -82,11 +85,24 @@ using namespace impala::test;
 //                          100 Blocks               8.46     8.46     8.49     0.114X     0.113X     0.112X
 //                         1000 Blocks              0.981        1        1    0.0132X    0.0133X    0.0131X
 //                        10000 Blocks                0.1    0.102    0.103   0.00134X   0.00136X   0.00136X
+//
+// The heterogeneous cluster suites simulate a cluster that mixes two hardware
+// generations: every SLOW_HOST_INTERVAL-th host scans at SLOW_HOST_RELATIVE_THROUGHPUT of
+// the throughput of the others, as recorded in the ExecutorScanModel. The benchmark
+// suite measures the scheduling overhead of weighing assignments by the modelled
+// throughput. The comparison that follows it prints, for each cluster size, the predicted
+// scan time (the time the slowest host needs for its assigned bytes) of byte-balanced
+// and throughput-aware assignments.
 
 static const vector<int> CLUSTER_SIZES = {3, 10, 50, 100, 500, 1000, 3000, 10000};
 static const int DEFAULT_CLUSTER_SIZE = 100;
 static const vector<int> NUM_BLOCKS_PER_TABLE = {1, 10, 100, 1000, 10000};
 static const int DEFAULT_NUM_BLOCKS_PER_TABLE = 100;
+static const vector<int> HETEROGENEOUS_CLUSTER_SIZES = {3, 10, 50, 100, 500, 1000};
+static const int HETEROGENEOUS_NUM_BLOCKS_PER_TABLE = 10000;
+static const int SLOW_HOST_INTERVAL = 2;
+static const double SLOW_HOST_RELATIVE_THROUGHPUT = 0.5;
+static const int64_t FAST_HOST_THROUGHPUT = 1024L * 1024L * 1024L;
 
 /// Members of this struct are needed to build the test fixtures and depend on each other.
 /// Since their constructors take const references they must be constructed in order,
@@ -162,6 +178,82 @@ void RunNumBlocksBenchmark(TReplicaPreference::type replica_preference) {
   cout << suite.Measure() << endl;
 }
 
+/// Returns the simulated scan throughput of host 'host_idx' in bytes per second. Host
+/// addresses only depend on the host index, so a host has the same throughput in all
+/// clusters.
+static double GetSimulatedThroughput(int host_idx) {
+  bool slow = host_idx % SLOW_HOST_INTERVAL == 0;
+  return slow ? FAST_HOST_THROUGHPUT * SLOW_HOST_RELATIVE_THROUGHPUT :
+      FAST_HOST_THROUGHPUT;
+}
+
+/// Records the simulated throughput of every host in 'cluster' in the ExecutorScanModel,
+/// as if each host had scanned for a second in a past query.
+static void RecordSimulatedThroughput(const Cluster& cluster) {
+  ExecutorScanModel* model = ExecutorScanModel::GetInstance();
+  for (int i = 0; i < cluster.NumHosts(); ++i) {
+    int64_t one_second_ns = 1000L * 1000L * 1000L;
+    model->Update(cluster.hosts()[i].ip, GetSimulatedThroughput(i), one_second_ns);
+  }
+}
+
+/// Returns the predicted time in seconds until all hosts have scanned the bytes assigned
+/// to them in 'result'.
+static double PredictScanTime(const Cluster& cluster, const Result& result) {
+  double max_time = 0;
+  for (int i = 0; i < cluster.NumHosts(); ++i) {
+    double time = static_cast<double>(result.NumTotalAssignedBytes(i))
+        / GetSimulatedThroughput(i);
+    max_time = max(max_time, time);
+  }
+  return max_time;
+}
+
+/// Measures the scheduling overhead of throughput-aware assignment on heterogeneous
+/// clusters.
+void RunHeterogeneousClusterBenchmark() {
+  Benchmark suite("Cluster Size, heterogeneous", false /* micro_heuristics */);
+  ExecutorScanModel::GetInstance()->Clear();
+  vector<TestCtx> test_ctx(CLUSTER_SIZES.size());
+  for (int i = 0; i < CLUSTER_SIZES.size(); ++i) {
+    int cluster_size = CLUSTER_SIZES[i];
+    InitializeTestCtx(cluster_size, DEFAULT_NUM_BLOCKS_PER_TABLE,
+        TReplicaPreference::REMOTE, &test_ctx[i]);
+    RecordSimulatedThroughput(*test_ctx[i].cluster);
+    string benchmark_name = strings::Substitute("$0 Hosts", cluster_size);
+    suite.AddBenchmark(benchmark_name, BenchmarkFunction, &test_ctx[i]);
+  }
+  cout << suite.Measure() << endl;
+  ExecutorScanModel::GetInstance()->Clear();
+}
+
+/// Compares the predicted scan time of byte-balanced and throughput-aware assignments on
+/// heterogeneous clusters.
+void RunHeterogeneousClusterComparison() {
+  cout << "Predicted scan time on heterogeneous clusters ("
+       << HETEROGENEOUS_NUM_BLOCKS_PER_TABLE << " blocks, REMOTE):" << endl;
+  ExecutorScanModel::GetInstance()->Clear();
+  for (int cluster_size : HETEROGENEOUS_CLUSTER_SIZES) {
+    TestCtx test_ctx;
+    InitializeTestCtx(cluster_size, HETEROGENEOUS_NUM_BLOCKS_PER_TABLE,
+        TReplicaPreference::REMOTE, &test_ctx);
+    RecordSimulatedThroughput(*test_ctx.cluster);
+    double scan_time[2];
+    for (bool use_throughput : {false, true}) {
+      FLAGS_scheduler_use_scan_throughput = use_throughput;
+      test_ctx.result->Reset();
+      Status status = test_ctx.scheduler_wrapper->Compute(test_ctx.result.get());
+      if (!status.ok()) LOG(FATAL) << status.GetDetail();
+      scan_time[use_throughput] = PredictScanTime(*test_ctx.cluster, *test_ctx.result);
+    }
+    cout << strings::Substitute("$0 Hosts: byte-balanced $1s, throughput-aware $2s "
+        "($3X)", cluster_size, scan_time[0], scan_time[1], scan_time[0] / scan_time[1])
+         << endl;
+  }
+  FLAGS_scheduler_use_scan_throughput = false;
+  ExecutorScanModel::GetInstance()->Clear();
+}
+
 int main(int argc, char** argv) {
   impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
   impala::InitFeSupport();
@@ -171,4 +263,6 @@ int main(int argc, char** argv) {
   RunClusterSizeBenchmark(TReplicaPreference::DISK_LOCAL);
   RunClusterSizeBenchmark(TReplicaPreference::REMOTE);
   RunNumBlocksBenchmark(TReplicaPreference::DISK_LOCAL);
+  RunHeterogeneousClusterBenchmark();
+  RunHeterogeneousClusterComparison();
 }
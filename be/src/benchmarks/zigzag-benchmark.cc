@@ -0,0 +1,130 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "exec/read-write-util.h"
+#include "gutil/strings/substitute.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+
+#include "common/names.h"
+
+// Benchmark to measure the speed of decoding the zig-zag encoded longs of Avro files for
+// various distributions of the encoded lengths. This compares:
+// * ByteLoop - the previous implementation of ReadWriteUtil::ReadZLong() that found the
+//   length of the encoding and then shifted the bytes into place one at a time.
+// * ReadZLong - ReadWriteUtil::ReadZLong(), which compacts the 7-bit groups of up to 8
+//   bytes with a constant number of word operations.
+
+using std::mt19937_64;
+using std::uniform_int_distribution;
+
+using namespace impala;
+
+constexpr int NUM_VALUES = 1024 * 1024;
+
+struct BenchmarkParams {
+  vector<uint8_t> buffer;
+  int64_t sum = 0;
+
+  /// Encodes NUM_VALUES values with a random number of significant bits between 1 and
+  /// 'max_bits'.
+  explicit BenchmarkParams(int max_bits)
+    : buffer(NUM_VALUES * ReadWriteUtil::MAX_ZLONG_LEN + ReadWriteUtil::MAX_ZLONG_LEN) {
+    mt19937_64 rand_engine(max_bits);
+    uniform_int_distribution<int> bits_dist(1, max_bits);
+    int64_t len = 0;
+    for (int i = 0; i < NUM_VALUES; ++i) {
+      int64_t val = rand_engine() >> (64 - bits_dist(rand_engine));
+      if (rand_engine() & 1) val = -val;
+      len += ReadWriteUtil::PutZLong(val, buffer.data() + len);
+    }
+    buffer.resize(len);
+  }
+};
+
+/// Copy of the previous version of ReadWriteUtil::ReadZLong() without the slow path for
+/// the end of the buffer, which the benchmark does not reach.
+inline int64_t ReadZLongByteLoop(uint8_t** buf) {
+  uint64_t x = *reinterpret_cast<uint64_t*>(*buf);
+  int num_bytes = 11;
+  for (int i = 0; i < sizeof(x); ++i) {
+    if ((x & (0x80LL << (i * 8))) == 0) {
+      num_bytes = i + 1;
+      break;
+    }
+  }
+  if (num_bytes == 11) {
+    uint16_t y = *reinterpret_cast<uint16_t*>(*buf + 8);
+    if ((y & 0x80) == 0) {
+      num_bytes = 9;
+    } else if ((y & 0x8000) == 0) {
+      num_bytes = 10;
+    }
+  }
+  uint64_t zlong = 0;
+  int shift = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    zlong |= static_cast<uint64_t>(**buf & 0x7f) << shift;
+    shift += 7;
+    ++(*buf);
+  }
+  return (zlong >> 1) ^ -(zlong & 1);
+}
+
+void ByteLoopBenchmark(int batch_size, void* data) {
+  BenchmarkParams* p = reinterpret_cast<BenchmarkParams*>(data);
+  for (int i = 0; i < batch_size; ++i) {
+    uint8_t* buf = p->buffer.data();
+    // Stop before the last values so that the 10 byte reads stay within the buffer.
+    uint8_t* buf_end = buf + p->buffer.size() - ReadWriteUtil::MAX_ZLONG_LEN;
+    while (buf < buf_end) p->sum += ReadZLongByteLoop(&buf);
+  }
+}
+
+void ReadZLongBenchmark(int batch_size, void* data) {
+  BenchmarkParams* p = reinterpret_cast<BenchmarkParams*>(data);
+  for (int i = 0; i < batch_size; ++i) {
+    uint8_t* buf = p->buffer.data();
+    uint8_t* buf_end = buf + p->buffer.size() - ReadWriteUtil::MAX_ZLONG_LEN;
+    while (buf < buf_end) {
+      ReadWriteUtil::ZLongResult r = ReadWriteUtil::ReadZLong(&buf, buf_end);
+      if (UNLIKELY(!r.ok)) {
+        LOG(ERROR) << "Error in ReadZLong()";
+        exit(1);
+      }
+      p->sum += r.val;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  CpuInfo::Init();
+  cout << endl << Benchmark::GetMachineInfo() << endl;
+
+  for (int max_bits : {6, 13, 20, 34, 63}) {
+    BenchmarkParams params(max_bits);
+    Benchmark suite(Substitute("ZigZag decoding max bits $0", max_bits));
+    int baseline = suite.AddBenchmark("ByteLoop", ByteLoopBenchmark, &params, -1);
+    suite.AddBenchmark("ReadZLong", ReadZLongBenchmark, &params, baseline);
+    cout << suite.Measure() << endl;
+  }
+  return 0;
+}
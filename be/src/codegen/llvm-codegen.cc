@@ -140,10 +140,11 @@ const map<int64_t, std::string> LlvmCodeGen::cpu_flag_mappings_{
     {CpuInfo::SSSE3, "+ssse3"}, {CpuInfo::SSE4_1, "+sse4.1"},
     {CpuInfo::SSE4_2, "+sse4.2"}, {CpuInfo::POPCNT, "+popcnt"}, {CpuInfo::AVX, "+avx"},
     {CpuInfo::AVX2, "+avx2"}, {CpuInfo::PCLMULQDQ, "+pclmul"},
+    {CpuInfo::AVX512BW, "+avx512bw"},
     {~(CpuInfo::SSSE3), "-ssse3"}, {~(CpuInfo::SSE4_1), "-sse4.1"},
     {~(CpuInfo::SSE4_2), "-sse4.2"}, {~(CpuInfo::POPCNT), "-popcnt"},
     {~(CpuInfo::AVX), "-avx"}, {~(CpuInfo::AVX2), "-avx2"},
-    {~(CpuInfo::PCLMULQDQ), "-pclmul"}};
+    {~(CpuInfo::PCLMULQDQ), "-pclmul"}, {~(CpuInfo::AVX512BW), "-avx512bw"}};
 
 [[noreturn]] static void LlvmCodegenHandleError(
     void* user_data, const string& reason, bool gen_crash_diag) {
@@ -23,14 +23,30 @@
 #include "exec/hdfs-scan-node-base.h"
 #include "exec/hdfs-scan-node.h"
 #include "exec/scanner-context.inline.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/fragment-instance-state.h"
+#include "runtime/io/request-ranges.h"
+#include "runtime/mem-pool.h"
 #include "runtime/runtime-state.h"
 #include "runtime/string-search.h"
+#include "runtime/thread-resource-mgr.h"
 #include "util/codec.h"
+#include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
 #include "util/test-info.h"
 
 #include "common/names.h"
 
+DEFINE_bool(enable_pipelined_sequence_decompression, true, "(Advanced) If true, the "
+    "blocks of large scan ranges of compressed SequenceFiles and RCFiles are "
+    "decompressed in a separate thread, if a thread token is available, so that the "
+    "next block is decompressed while the current one is parsed.");
+DEFINE_int64_hidden(pipelined_sequence_decompression_min_range_size,
+    8L * 1024L * 1024L, "Minimum size of a scan range of a compressed SequenceFile or "
+    "RCFile for the decompression of its blocks to be pipelined. Smaller ranges do not "
+    "take long enough to decompress to make up for starting a thread. Tests lower it to "
+    "pipeline the decompression of small files.");
+
 using namespace impala;
 using namespace impala::io;
 
@@ -68,7 +84,7 @@ Status BaseSequenceScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
         metadata->original_split);
     ScanRangeMetadata* header_metadata =
             static_cast<ScanRangeMetadata*>(header_range->meta_data());
-    header_metadata->is_sequence_header = true;
+    header_metadata->is_file_header = true;
     header_ranges.push_back(header_range);
   }
   // When the header is parsed, we will issue more AddDiskIoRanges in
@@ -126,6 +142,11 @@ void BaseSequenceScanner::Close(RowBatch* row_batch) {
   VLOG_FILE << "Bytes read past scan range: " << -stream_->bytes_left();
   VLOG_FILE << "Average block size: "
             << (num_syncs_ > 1 ? total_block_size_ / (num_syncs_ - 1) : 0);
+  if (async_decompressor_ != nullptr) {
+    async_decompressor_->Close();
+    async_decompressor_.reset();
+    state_->resource_pool()->ReleaseThreadToken(false);
+  }
   // Need to close the decompressor before releasing the resources at AddFinalRowBatch(),
   // because in some cases there is memory allocated in decompressor_'s temp_memory_pool_.
   if (decompressor_.get() != nullptr) {
@@ -135,6 +156,9 @@ void BaseSequenceScanner::Close(RowBatch* row_batch) {
   if (row_batch != nullptr) {
     row_batch->tuple_data_pool()->AcquireData(data_buffer_pool_.get(), false);
     row_batch->tuple_data_pool()->AcquireData(template_tuple_pool_.get(), false);
+    if (read_ahead_pool_ != nullptr) {
+      row_batch->tuple_data_pool()->AcquireData(read_ahead_pool_.get(), false);
+    }
     if (scan_node_->HasRowBatchQueue()) {
       static_cast<HdfsScanNode*>(scan_node_)->AddMaterializedRowBatch(
         unique_ptr<RowBatch>(row_batch));
@@ -142,6 +166,7 @@ void BaseSequenceScanner::Close(RowBatch* row_batch) {
   } else {
     data_buffer_pool_->FreeAll();
     template_tuple_pool_->FreeAll();
+    if (read_ahead_pool_ != nullptr) read_ahead_pool_->FreeAll();
   }
   context_->ReleaseCompletedResources(true);
 
@@ -203,8 +228,14 @@ Status BaseSequenceScanner::GetNextInternal(RowBatch* row_batch) {
     // This checks for abort_on_error.
     RETURN_IF_ERROR(state_->LogOrReturnError(status.msg()));
 
-    // Recover by skipping to the next sync.
     parse_status_ = Status::OK();
+    // Continue with the next block if 'stream_' was already positioned there by
+    // reading ahead.
+    bool error_in_stream = async_decompressor_ == nullptr || read_ahead_error_returned_;
+    read_ahead_error_returned_ = false;
+    if (!error_in_stream) return Status::OK();
+
+    // Recover by skipping to the next sync.
     int64_t error_offset = stream_->file_offset();
     status = SkipToSync(header_->sync, SYNC_HASH_SIZE);
     COUNTER_ADD(bytes_skipped_counter_, stream_->file_offset() - error_offset);
@@ -328,6 +359,81 @@ Status BaseSequenceScanner::SkipToSync(const uint8_t* sync, int sync_size) {
   return Status::OK();
 }
 
+Status BaseSequenceScanner::StartAsyncDecompression() {
+  DCHECK(header_ != nullptr);
+  DCHECK(async_decompressor_ == nullptr);
+  if (!FLAGS_enable_pipelined_sequence_decompression) return Status::OK();
+  // The LZO decompressor is implemented by a plugin that Codec cannot create.
+  if (!header_->is_compressed || header_->compression_type == THdfsCompression::LZO) {
+    return Status::OK();
+  }
+  if (stream_->scan_range()->bytes_to_read()
+      < FLAGS_pipelined_sequence_decompression_min_range_size) {
+    return Status::OK();
+  }
+  if (!state_->resource_pool()->TryAcquireThreadToken()) return Status::OK();
+  async_decompressor_.reset(
+      new AsyncBlockDecompressor(scan_node_->mem_tracker(), header_->compression_type));
+  string thread_name = Substitute("sequence-decompression (finst:$0, plan-node-id:$1)",
+      PrintId(state_->fragment_instance_id()), scan_node_->id());
+  Status status = async_decompressor_->Open(
+      FragmentInstanceState::FINST_THREAD_GROUP_NAME, thread_name);
+  if (!status.ok()) {
+    async_decompressor_->Close();
+    async_decompressor_.reset();
+    state_->resource_pool()->ReleaseThreadToken(false);
+    return status;
+  }
+  if (read_ahead_pool_ == nullptr) {
+    read_ahead_pool_.reset(new MemPool(scan_node_->mem_tracker()));
+  }
+  COUNTER_ADD(ADD_COUNTER(scan_node_->runtime_profile(), "PipelinedDecompressionRanges",
+      TUnit::UNIT), 1);
+  return Status::OK();
+}
+
+Status BaseSequenceScanner::NextBlockReadAhead(
+    vector<AsyncBlockDecompressor::Output>* outputs) {
+  DCHECK(async_decompressor_ != nullptr);
+  outputs->clear();
+  if (!async_decompressor_->batch_in_progress()) {
+    // Nothing was read ahead, because this is the first block of the scan range or
+    // because reading ahead stopped at an error or at the end of the scan range.
+    if (read_ahead_status_.ok() && !read_ahead_eos_) ReadAhead();
+    if (!async_decompressor_->batch_in_progress()) {
+      if (!read_ahead_status_.ok()) {
+        Status status = read_ahead_status_;
+        read_ahead_status_ = Status::OK();
+        read_ahead_error_returned_ = true;
+        return status;
+      }
+      DCHECK(read_ahead_eos_);
+      eos_ = true;
+      return Status::OK();
+    }
+  }
+  // With pipelining, this is the time spent waiting for the decompression thread.
+  SCOPED_TIMER(decompress_timer_);
+  return async_decompressor_->WaitForBatch(read_ahead_pool_.get(), outputs);
+}
+
+void BaseSequenceScanner::ReadAhead() {
+  DCHECK(async_decompressor_ != nullptr);
+  DCHECK(!async_decompressor_->batch_in_progress());
+  DCHECK(!eos_);
+  if (!read_ahead_status_.ok() || read_ahead_eos_) return;
+  Status status = ReadBlockAhead();
+  if (!async_decompressor_->batch_in_progress()) async_decompressor_->DiscardBlocks();
+  // The end of the scan range and errors only take effect once the block that was read
+  // ahead was processed.
+  read_ahead_eos_ = eos_;
+  eos_ = false;
+  if (!status.ok()) {
+    read_ahead_status_ = status;
+    parse_status_ = Status::OK();
+  }
+}
+
 void BaseSequenceScanner::CloseFileRanges(const char* filename) {
   DCHECK(only_parsing_header_);
   const HdfsFileDesc* desc = scan_node_->GetFileDesc(
@@ -24,6 +24,7 @@
 #include <stdint.h>
 
 #include "exec/hdfs-scanner.h"
+#include "util/async-block-decompressor.h"
 
 namespace impala {
 
@@ -45,6 +46,17 @@ class ScannerContext;
 /// ranges, the first scan range must process the following block since the second scan
 /// range cannot find the incomplete sync. context_->eosr() will not alert us to this
 /// situation, causing the block to be incorrectly skipped.
+///
+/// Pipelined decompression:
+/// The blocks of compressed files are processed strictly in order, so decompressing a
+/// block and parsing it cannot overlap on the scanner thread. Subclasses that support it
+/// call StartAsyncDecompression() to have 'async_decompressor_' decompress the next
+/// block in a separate thread while the current one is parsed. They then read each block
+/// ahead with ReadBlockAhead(), including the sync that follows it, and get the
+/// decompressed block with NextBlockReadAhead() once the previous one was processed. Only
+/// one block is read ahead at a time, which bounds the extra memory used. Errors and the
+/// end of the scan range that are found while reading ahead only take effect after the
+/// blocks before them were processed.
 class BaseSequenceScanner : public HdfsScanner {
  public:
   /// Issue the initial ranges for all sequence container files. 'files' must not be
@@ -114,6 +126,15 @@ class BaseSequenceScanner : public HdfsScanner {
   /// Returns type of scanner: e.g. rcfile, seqfile
   virtual THdfsFileFormat::type file_format() const = 0;
 
+  /// Reads the next block from 'stream_' and adds its compressed data to
+  /// 'async_decompressor_', starts the decompression with StartBatch() and then reads the
+  /// sync that follows the block, if any. May set 'eos_' like ProcessRange(). Must be
+  /// implemented by subclasses that call StartAsyncDecompression().
+  virtual Status ReadBlockAhead() WARN_UNUSED_RESULT {
+    DCHECK(false);
+    return Status::OK();
+  }
+
   BaseSequenceScanner(HdfsScanNodeBase*, RuntimeState*);
 
   /// Read sync marker from 'stream_' and validate against 'header_->sync'. Returns
@@ -130,6 +151,32 @@ class BaseSequenceScanner : public HdfsScanner {
   /// - sync_size: number of bytes for sync
   Status SkipToSync(const uint8_t* sync, int sync_size) WARN_UNUSED_RESULT;
 
+  /// Creates and opens 'async_decompressor_' if pipelined decompression is enabled, the
+  /// file is compressed, the scan range is large enough and a thread token is available.
+  /// Called from InitNewRange() by subclasses that implement ReadBlockAhead().
+  Status StartAsyncDecompression() WARN_UNUSED_RESULT;
+
+  /// Waits for the decompression of the block that was read ahead and returns its
+  /// decompressed data in 'outputs', with the memory of buffers that were not
+  /// preallocated in 'read_ahead_pool_'. If nothing was read ahead, i.e. at the start of
+  /// the scan range, reads the next block first. Returns the error that occurred while
+  /// reading ahead, or sets 'eos_', once all blocks before it were returned. The caller
+  /// must call ReadAhead() after making the returned block the current one.
+  Status NextBlockReadAhead(std::vector<AsyncBlockDecompressor::Output>* outputs)
+      WARN_UNUSED_RESULT;
+
+  /// Reads the next block ahead with ReadBlockAhead() unless an error or the end of the
+  /// scan range was reached while reading ahead. Defers both, see above.
+  void ReadAhead();
+
+  /// Decompresses the blocks that were read ahead in a separate thread. Null if the
+  /// blocks are decompressed by the scanner thread.
+  boost::scoped_ptr<AsyncBlockDecompressor> async_decompressor_;
+
+  /// Pool for the buffers of the block that was read ahead. Its memory must be moved to
+  /// 'data_buffer_pool_' once the block becomes the current one.
+  boost::scoped_ptr<MemPool> read_ahead_pool_;
+
   /// Estimate of header size in bytes.  This is initial number of bytes to issue
   /// per file.  If the estimate is too low, more bytes will be read as necessary.
   const static int HEADER_SIZE;
@@ -174,6 +221,19 @@ class BaseSequenceScanner : public HdfsScanner {
 
   /// Number of bytes skipped when advancing to next sync on error.
   RuntimeProfile::Counter* bytes_skipped_counter_ = nullptr;
+
+  /// The error that occurred while reading ahead, which is returned once the blocks that
+  /// were read ahead before it are processed.
+  Status read_ahead_status_;
+
+  /// True if the last block that was read ahead is the last one of the scan range.
+  bool read_ahead_eos_ = false;
+
+  /// True if the error returned by ProcessRange() is 'read_ahead_status_'. Other errors
+  /// of scanners that read ahead occur while 'stream_' is positioned at the start of the
+  /// next block, so recovering from them must not skip to the next sync, which would
+  /// skip that block.
+  bool read_ahead_error_returned_ = false;
 };
 
 }
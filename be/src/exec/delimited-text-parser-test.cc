@@ -15,10 +15,12 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <random>
 #include <string>
 
 #include "exec/delimited-text-parser.inline.h"
 #include "testutil/gtest-util.h"
+#include "util/cpu-info.h"
 
 #include "common/names.h"
 
@@ -215,6 +217,75 @@ TEST(DelimitedTextParser, SpecialDelimiters) {
   Validate(&nul_field_parser, field2, 5, TUPLE_DELIM, 3, 6);
 }
 
+/// Parses 'data' with 'parser' for a table with 'num_cols' columns in batches of at most
+/// 'max_tuples' tuples and returns the start and length of all fields and the offsets
+/// of all tuple ends.
+static void ParseAll(TupleDelimitedTextParser* parser, int num_cols, const string& data,
+    int max_tuples, vector<pair<int64_t, int32_t>>* fields, vector<int64_t>* row_ends) {
+  parser->ParserReset();
+  char* data_start = const_cast<char*>(data.data());
+  char* data_ptr = data_start;
+  vector<char*> row_end_locs(max_tuples);
+  // Every character may end a tuple with 'num_cols' fields.
+  vector<FieldLocation> field_locations((data.size() + 1) * num_cols);
+  while (data_ptr < data_start + data.size()) {
+    int num_tuples = 0;
+    int num_fields = 0;
+    char* next_column_start;
+    ASSERT_OK(parser->ParseFieldLocations(max_tuples, data_start + data.size() - data_ptr,
+        &data_ptr, row_end_locs.data(), field_locations.data(), &num_tuples,
+        &num_fields, &next_column_start));
+    for (int i = 0; i < num_fields; ++i) {
+      fields->emplace_back(
+          field_locations[i].start - data_start, field_locations[i].len);
+    }
+    for (int i = 0; i < num_tuples; ++i) {
+      row_ends->push_back(row_end_locs[i] - data_start);
+    }
+  }
+}
+
+// Test that all instruction sets produce the same fields as the scalar parser, also
+// across batches and with escape characters at 64 byte block boundaries.
+TEST(DelimitedTextParser, InstructionSets) {
+  const int NUM_COLS = 3;
+  bool is_materialized_col[NUM_COLS] = {true, false, true};
+  TupleDelimitedTextParser no_escape_parser(
+      NUM_COLS, 0, is_materialized_col, '\n', ',', '^');
+  TupleDelimitedTextParser escape_parser(
+      NUM_COLS, 0, is_materialized_col, '\n', ',', '^', '\\');
+
+  const char CHARS[] = "abc,,^\n\r\\\\";
+  std::mt19937 rng(0);
+  for (int iter = 0; iter < 100; ++iter) {
+    string data;
+    int len = rng() % 1000;
+    for (int i = 0; i < len; ++i) data += CHARS[rng() % (sizeof(CHARS) - 1)];
+    int max_tuples = 1 + rng() % 10;
+    for (TupleDelimitedTextParser* parser : {&no_escape_parser, &escape_parser}) {
+      vector<pair<int64_t, int32_t>> expected_fields;
+      vector<int64_t> expected_row_ends;
+      {
+        CpuInfo::TempDisable disable_avx512(CpuInfo::AVX512BW);
+        CpuInfo::TempDisable disable_avx2(CpuInfo::AVX2);
+        CpuInfo::TempDisable disable_sse42(CpuInfo::SSE4_2);
+        ParseAll(parser, NUM_COLS, data, max_tuples, &expected_fields,
+            &expected_row_ends);
+      }
+      // Disable one more instruction set in each iteration, starting with none.
+      vector<unique_ptr<CpuInfo::TempDisable>> disablers;
+      for (int64_t feature : {CpuInfo::AVX512BW, CpuInfo::AVX2, CpuInfo::SSE4_2}) {
+        vector<pair<int64_t, int32_t>> fields;
+        vector<int64_t> row_ends;
+        ParseAll(parser, NUM_COLS, data, max_tuples, &fields, &row_ends);
+        EXPECT_EQ(fields, expected_fields) << feature << " " << data;
+        EXPECT_EQ(row_ends, expected_row_ends) << feature << " " << data;
+        disablers.emplace_back(new CpuInfo::TempDisable(feature));
+      }
+    }
+  }
+}
+
 // TODO: expand test for other delimited text parser functions/cases.
 // Not all of them work without creating a HdfsScanNode but we can expand
 // these tests quite a bit more.
@@ -17,7 +17,12 @@
 
 #include "exec/delimited-text-parser.inline.h"
 
+#ifndef __aarch64__
+#include <immintrin.h>
+#endif
+
 #include "exec/hdfs-scanner.h"
+#include "util/bit-util.h"
 #include "util/cpu-info.h"
 
 #include "common/names.h"
@@ -91,7 +96,9 @@ DelimitedTextParser<DELIMITED_TUPLES>::DelimitedTextParser(
   if (collection_item_delim != '\0') search_chars[num_delims_++] = collection_item_delim_;
 
   DCHECK_GT(num_delims_, 0);
+  DCHECK_LE(num_delims_, sizeof(delim_chars_));
   xmm_delim_search_ = _mm_loadu_si128(reinterpret_cast<__m128i*>(search_chars));
+  memcpy(delim_chars_, search_chars, num_delims_);
 
   ParserReset();
 }
@@ -116,6 +123,148 @@ void DelimitedTextParser<DELIMITED_TUPLES>::ParserReset() {
 
 template void DelimitedTextParser<true>::ParserReset();
 
+#ifndef __aarch64__
+/// Sets 'delim_mask' and 'escape_mask' to the masks of the characters in the 64
+/// characters at 'buffer' that are one of the 'num_delims' characters in 'delims' or
+/// that are 'escape_char', using AVX2 instructions. Bit i of a mask corresponds to
+/// 'buffer[i]'. 'escape_mask' is only computed if 'process_escapes' is true.
+__attribute__((target("avx2")))
+static void StructuralMasksAvx2(const char* buffer, const char* delims, int num_delims,
+    bool process_escapes, char escape_char, uint64_t* delim_mask, uint64_t* escape_mask) {
+  const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer));
+  const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + 32));
+  __m256i lo_match = _mm256_setzero_si256();
+  __m256i hi_match = _mm256_setzero_si256();
+  for (int i = 0; i < num_delims; ++i) {
+    const __m256i delim = _mm256_set1_epi8(delims[i]);
+    lo_match = _mm256_or_si256(lo_match, _mm256_cmpeq_epi8(lo, delim));
+    hi_match = _mm256_or_si256(hi_match, _mm256_cmpeq_epi8(hi, delim));
+  }
+  const uint32_t lo_delims = _mm256_movemask_epi8(lo_match);
+  const uint32_t hi_delims = _mm256_movemask_epi8(hi_match);
+  *delim_mask = lo_delims | static_cast<uint64_t>(hi_delims) << 32;
+  if (process_escapes) {
+    const __m256i escape = _mm256_set1_epi8(escape_char);
+    const uint32_t lo_escape = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, escape));
+    const uint32_t hi_escape = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, escape));
+    *escape_mask = lo_escape | static_cast<uint64_t>(hi_escape) << 32;
+  }
+}
+
+/// Same as StructuralMasksAvx2() but using AVX-512BW instructions.
+__attribute__((target("avx512bw")))
+static void StructuralMasksAvx512(const char* buffer, const char* delims,
+    int num_delims, bool process_escapes, char escape_char, uint64_t* delim_mask,
+    uint64_t* escape_mask) {
+  const __m512i data = _mm512_loadu_si512(buffer);
+  uint64_t mask = 0;
+  for (int i = 0; i < num_delims; ++i) {
+    mask |= _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8(delims[i]));
+  }
+  *delim_mask = mask;
+  if (process_escapes) {
+    *escape_mask = _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8(escape_char));
+  }
+}
+#endif
+
+template <bool DELIMITED_TUPLES>
+template <bool PROCESS_ESCAPES, bool AVX512>
+Status DelimitedTextParser<DELIMITED_TUPLES>::ParseStructural(int max_tuples,
+    int64_t* remaining_len, char** byte_buffer_ptr, char** row_end_locations,
+    FieldLocation* field_locations, int* num_tuples, int* num_fields,
+    char** next_column_start) {
+#ifndef __aarch64__
+  DCHECK(CpuInfo::IsSupported(AVX512 ? CpuInfo::AVX512BW : CpuInfo::AVX2));
+  while (LIKELY(*remaining_len >= STRUCTURAL_BLOCK_SIZE)) {
+    // Build the masks of all delimiters and escape characters of the block, with bit i
+    // corresponding to the character at offset i.
+    uint64_t delim_mask;
+    uint64_t escape_mask = 0;
+    if (AVX512) {
+      StructuralMasksAvx512(*byte_buffer_ptr, delim_chars_, num_delims_,
+          PROCESS_ESCAPES, escape_char_, &delim_mask, &escape_mask);
+    } else {
+      StructuralMasksAvx2(*byte_buffer_ptr, delim_chars_, num_delims_,
+          PROCESS_ESCAPES, escape_char_, &delim_mask, &escape_mask);
+    }
+    if (PROCESS_ESCAPES) {
+      DCHECK(escape_char_ != '\0');
+      // Branch-free equivalent of ProcessEscapeMask().
+      delim_mask &= ~BitUtil::FindEscaped64(escape_mask, &last_char_is_escape_);
+    }
+
+    char* last_char = *byte_buffer_ptr + STRUCTURAL_BLOCK_SIZE - 1;
+    bool last_char_is_unescaped_delim = delim_mask >> (STRUCTURAL_BLOCK_SIZE - 1);
+    if (DELIMITED_TUPLES) {
+      unfinished_tuple_ = !(last_char_is_unescaped_delim &&
+          (*last_char == tuple_delim_ || (tuple_delim_ == '\n' && *last_char == '\r')));
+    }
+
+    int last_col_idx = 0;
+    // Process the delimiters of the block from lsb->msb, like ParseSse().
+    while (delim_mask != 0) {
+      int n = BitUtil::CountTrailingZeros(delim_mask);
+      // Clear the lowest set bit.
+      delim_mask &= delim_mask - 1;
+
+      if (PROCESS_ESCAPES) {
+        // Determine if there was an escape character between [last_col_idx, n]
+        uint64_t col_mask = (~0ULL << last_col_idx) & (~0ULL >> (63 - n));
+        current_column_has_escape_ |= (escape_mask & col_mask) != 0;
+        last_col_idx = n;
+      }
+
+      char* delim_ptr = *byte_buffer_ptr + n;
+
+      if (IsFieldOrCollectionItemDelimiter(*delim_ptr)) {
+        RETURN_IF_ERROR(AddColumn<PROCESS_ESCAPES>(delim_ptr - *next_column_start,
+            next_column_start, num_fields, field_locations));
+        continue;
+      }
+
+      if (DELIMITED_TUPLES &&
+          (*delim_ptr == tuple_delim_ || (tuple_delim_ == '\n' && *delim_ptr == '\r'))) {
+        if (UNLIKELY(
+                last_row_delim_offset_ == *remaining_len - n && *delim_ptr == '\n')) {
+          // If the row ended in \r\n then move the next start past the \n
+          ++*next_column_start;
+          last_row_delim_offset_ = -1;
+          continue;
+        }
+        RETURN_IF_ERROR(AddColumn<PROCESS_ESCAPES>(delim_ptr - *next_column_start,
+            next_column_start, num_fields, field_locations));
+        Status status = FillColumns<false>(0, NULL, num_fields, field_locations);
+        DCHECK(status.ok());
+        column_idx_ = num_partition_keys_;
+        row_end_locations[*num_tuples] = delim_ptr;
+        ++(*num_tuples);
+        // Remember where we saw the last \r.
+        last_row_delim_offset_ = *delim_ptr == '\r' ? *remaining_len - n - 1 : -1;
+        if (UNLIKELY(*num_tuples == max_tuples)) {
+          (*byte_buffer_ptr) += (n + 1);
+          if (PROCESS_ESCAPES) last_char_is_escape_ = false;
+          *remaining_len -= (n + 1);
+          // If the last character we processed was \r then set the offset to 0
+          // so that we will use it at the beginning of the next batch.
+          if (last_row_delim_offset_ == *remaining_len) last_row_delim_offset_ = 0;
+          return Status::OK();
+        }
+      }
+    }
+
+    if (PROCESS_ESCAPES) {
+      // Determine if there was an escape character between (last_col_idx, 63)
+      current_column_has_escape_ |= (escape_mask >> last_col_idx) != 0;
+    }
+
+    *remaining_len -= STRUCTURAL_BLOCK_SIZE;
+    *byte_buffer_ptr += STRUCTURAL_BLOCK_SIZE;
+  }
+#endif
+  return Status::OK();
+}
+
 // Parsing raw csv data into FieldLocation descriptors.
 template<bool DELIMITED_TUPLES>
 Status DelimitedTextParser<DELIMITED_TUPLES>::ParseFieldLocations(int max_tuples,
@@ -132,6 +281,30 @@ Status DelimitedTextParser<DELIMITED_TUPLES>::ParseFieldLocations(int max_tuples
     last_row_delim_offset_ = -1;
   }
 
+  if (CpuInfo::IsSupported(CpuInfo::AVX512BW)) {
+    if (process_escapes_) {
+      RETURN_IF_ERROR(ParseStructural<true, true>(max_tuples, &remaining_len,
+          byte_buffer_ptr, row_end_locations, field_locations, num_tuples, num_fields,
+          next_column_start));
+    } else {
+      RETURN_IF_ERROR(ParseStructural<false, true>(max_tuples, &remaining_len,
+          byte_buffer_ptr, row_end_locations, field_locations, num_tuples, num_fields,
+          next_column_start));
+    }
+  } else if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+    if (process_escapes_) {
+      RETURN_IF_ERROR(ParseStructural<true, false>(max_tuples, &remaining_len,
+          byte_buffer_ptr, row_end_locations, field_locations, num_tuples, num_fields,
+          next_column_start));
+    } else {
+      RETURN_IF_ERROR(ParseStructural<false, false>(max_tuples, &remaining_len,
+          byte_buffer_ptr, row_end_locations, field_locations, num_tuples, num_fields,
+          next_column_start));
+    }
+  }
+
+  if (*num_tuples == max_tuples) return Status::OK();
+
   if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
     if (process_escapes_) {
       RETURN_IF_ERROR(ParseSse<true>(max_tuples, &remaining_len, byte_buffer_ptr,
@@ -68,8 +68,9 @@ class DelimitedTextParser {
   /// This function uses SSE ("Intel x86 instruction set extension
   /// 'Streaming Simd Extension') if the hardware supports SSE4.2
   /// instructions.  SSE4.2 added string processing instructions that
-  /// allow for processing 16 characters at a time.  Otherwise, this
-  /// function walks the file_buffer_ character by character.
+  /// allow for processing 16 characters at a time.  If the hardware supports AVX2 or
+  /// AVX-512BW, 64 characters at a time are processed with ParseStructural() first.
+  /// Otherwise, this function walks the file_buffer_ character by character.
   /// Input Parameters:
   ///   max_tuples: The maximum number of tuples that should be parsed.
   ///               This is used to control how the batching works.
@@ -169,6 +170,21 @@ class DelimitedTextParser {
       FieldLocation* field_locations,
       int* num_tuples, int* num_fields, char** next_column_start);
 
+  /// Number of characters processed at a time by ParseStructural().
+  static const int STRUCTURAL_BLOCK_SIZE = 64;
+
+  /// Helper routine to parse delimited text 64 characters at a time. It builds a 64-bit
+  /// mask of the delimiters and escape characters of each block with AVX2 instructions,
+  /// or with AVX-512BW instructions if 'AVX512' is true, and resolves escaped delimiters
+  /// for the whole block at once with integer arithmetic instead of walking the escape
+  /// characters one by one. Leaves fewer than 64 characters for ParseSse().
+  /// Identical arguments and template argument 'PROCESS_ESCAPES' as ParseSse.
+  template <bool PROCESS_ESCAPES, bool AVX512>
+  Status ParseStructural(int max_tuples, int64_t* remaining_len,
+      char** byte_buffer_ptr, char** row_end_locations_,
+      FieldLocation* field_locations,
+      int* num_tuples, int* num_fields, char** next_column_start);
+
   bool IsFieldOrCollectionItemDelimiter(char c) {
     return (!DELIMITED_TUPLES && c == field_delim_) ||
       (DELIMITED_TUPLES && field_delim_ != tuple_delim_ && c == field_delim_) ||
@@ -194,6 +210,9 @@ class DelimitedTextParser {
   /// The number of delimiters contained in xmm_delim_search_, i.e. its length.
   int num_delims_;
 
+  /// The delimiters contained in xmm_delim_search_. Used by ParseStructural().
+  char delim_chars_[4];
+
   /// Number of columns in the table (including partition columns)
   int num_cols_;
 
@@ -17,17 +17,42 @@
 
 #include "exec/filter-context.h"
 
+#include <mutex>
+
+#include <boost/algorithm/string/join.hpp>
+
 #include "codegen/codegen-anyval.h"
 #include "exprs/scalar-expr-evaluator.h"
+#include "runtime/descriptors.h"
 #include "runtime/runtime-filter.inline.h"
 #include "runtime/tuple-row.h"
 #include "util/min-max-filter.h"
 #include "util/runtime-profile-counters.h"
 #include "service/hs2-util.h"
 
+DECLARE_double(min_filter_reject_ratio);
+
+DEFINE_bool(skip_wait_for_ineffective_runtime_filters, false, "(Advanced) If true, "
+    "HDFS scans do not wait for runtime filters on non-partition columns that rejected "
+    "too few rows (see --min_filter_reject_ratio) in past scans of the same column by "
+    "a filter from the same join in the same plan position. Such filters are still "
+    "applied if they arrive while the scan is running.");
+
 using namespace impala;
 using namespace strings;
 
+/// Scans in which a filter was applied to fewer rows than this are too small to judge
+/// the filter's effectiveness and are not recorded in FilterEffectivenessHistory.
+static const int64_t MIN_ROWS_FOR_FILTER_HISTORY = 100 * 1024;
+/// Number of scans a filter must have been recorded in before it is considered
+/// ineffective.
+static const int64_t MIN_SCANS_FOR_FILTER_HISTORY = 2;
+/// Weight of the latest scan in the decayed rejection ratio.
+static const double FILTER_HISTORY_DECAY_WEIGHT = 0.5;
+/// Maximum number of entries in FilterEffectivenessHistory. The history is cleared if it
+/// grows beyond this.
+static const int64_t MAX_FILTER_HISTORY_ENTRIES = 64 * 1024;
+
 const std::string FilterStats::ROW_GROUPS_KEY = "RowGroups";
 const std::string FilterStats::FILES_KEY = "Files";
 const std::string FilterStats::SPLITS_KEY = "Splits";
@@ -43,6 +68,10 @@ FilterStats::FilterStats(RuntimeProfile* runtime_profile) {
   // TODO: These only apply to Parquet, so only register them in that case.
   RegisterCounterGroup(FilterStats::ROWS_KEY);
   RegisterCounterGroup(FilterStats::ROW_GROUPS_KEY);
+  disabled_as_ineffective = ADD_COUNTER(profile, "DisabledAsIneffective", TUnit::UNIT);
+  reenabled = ADD_COUNTER(profile, "ReenabledAfterDisabling", TUnit::UNIT);
+  rows_skipped_as_ineffective =
+      ADD_COUNTER(profile, "RowsSkippedAsIneffective", TUnit::UNIT);
 }
 
 void FilterStats::IncrCounters(const string& key, int32_t total, int32_t processed,
@@ -66,6 +95,96 @@ void FilterStats::RegisterCounterGroup(const string& key) {
   counters[key] = counter;
 }
 
+const FilterStats::CounterGroup& FilterStats::GetCounterGroup(const string& key) const {
+  CountersMap::const_iterator it = counters.find(key);
+  DCHECK(it != counters.end()) << "Tried to get unknown counter group";
+  return it->second;
+}
+
+FilterEffectivenessHistory* FilterEffectivenessHistory::GetInstance() {
+  static FilterEffectivenessHistory history;
+  return &history;
+}
+
+/// Returns the column path of 'slot_id' as a string, e.g. "1.2", or an empty string if
+/// the slot is not a column.
+static string ColPathString(const DescriptorTbl& desc_tbl, TSlotId slot_id) {
+  const SlotDescriptor* slot_desc = desc_tbl.GetSlotDescriptor(slot_id);
+  if (slot_desc == nullptr || slot_desc->col_path().empty()) return "";
+  std::vector<string> path_elems;
+  for (int idx : slot_desc->col_path()) path_elems.push_back(std::to_string(idx));
+  return boost::algorithm::join(path_elems, ".");
+}
+
+/// Returns the table and column of the build side expression of 'filter_desc' if it is
+/// a column reference, e.g. "db.tbl.1". Otherwise returns an empty string.
+static string BuildColumnString(
+    const DescriptorTbl& desc_tbl, const TRuntimeFilterDesc& filter_desc) {
+  const std::vector<TExprNode>& nodes = filter_desc.src_expr.nodes;
+  if (nodes.size() != 1 || nodes[0].node_type != TExprNodeType::SLOT_REF) return "";
+  TSlotId slot_id = nodes[0].slot_ref.slot_id;
+  const SlotDescriptor* slot_desc = desc_tbl.GetSlotDescriptor(slot_id);
+  if (slot_desc == nullptr || slot_desc->parent()->table_desc() == nullptr) return "";
+  string col_path = ColPathString(desc_tbl, slot_id);
+  if (col_path.empty()) return "";
+  return Substitute("$0.$1",
+      slot_desc->parent()->table_desc()->fully_qualified_name(), col_path);
+}
+
+string FilterEffectivenessHistory::MakeKey(const string& table_name,
+    const DescriptorTbl& desc_tbl, const TRuntimeFilterDesc& filter_desc,
+    TPlanNodeId node_id) {
+  for (const TRuntimeFilterTargetDesc& target : filter_desc.targets) {
+    if (target.node_id != node_id) continue;
+    if (target.target_expr_slotids.empty()) return "";
+    std::vector<string> col_paths;
+    for (TSlotId slot_id : target.target_expr_slotids) {
+      string col_path = ColPathString(desc_tbl, slot_id);
+      if (col_path.empty()) return "";
+      col_paths.push_back(col_path);
+    }
+    // A filter's effectiveness depends on the build side that produces it as much as on
+    // the scanned column, e.g. on the predicates on the build side table. Filters from
+    // different joins or plans must therefore not share an entry.
+    return Substitute("$0:$1:$2:$3:$4:$5", table_name,
+        boost::algorithm::join(col_paths, ","), static_cast<int>(filter_desc.type),
+        filter_desc.src_node_id, node_id, BuildColumnString(desc_tbl, filter_desc));
+  }
+  return "";
+}
+
+void FilterEffectivenessHistory::Update(
+    const string& key, int64_t processed, int64_t rejected) {
+  DCHECK(!key.empty());
+  if (processed < MIN_ROWS_FOR_FILTER_HISTORY) return;
+  double reject_ratio = rejected / static_cast<double>(processed);
+  std::lock_guard<SpinLock> l(lock_);
+  if (entries_.size() >= MAX_FILTER_HISTORY_ENTRIES && entries_.count(key) == 0) {
+    entries_.clear();
+  }
+  Entry& entry = entries_[key];
+  if (entry.num_scans == 0) {
+    entry.reject_ratio = reject_ratio;
+  } else {
+    entry.reject_ratio = FILTER_HISTORY_DECAY_WEIGHT * reject_ratio
+        + (1 - FILTER_HISTORY_DECAY_WEIGHT) * entry.reject_ratio;
+  }
+  ++entry.num_scans;
+}
+
+bool FilterEffectivenessHistory::IsIneffective(const string& key) const {
+  if (key.empty()) return false;
+  std::lock_guard<SpinLock> l(lock_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) return false;
+  return it->second.num_scans >= MIN_SCANS_FOR_FILTER_HISTORY
+      && it->second.reject_ratio < FLAGS_min_filter_reject_ratio;
+}
+
+bool FilterEffectivenessHistory::SkipWaitForFilter(const string& key) const {
+  return FLAGS_skip_wait_for_ineffective_runtime_filters && IsIneffective(key);
+}
+
 Status FilterContext::CloneFrom(const FilterContext& from, ObjectPool* pool,
     RuntimeState* state, MemPool* expr_perm_pool, MemPool* expr_results_pool) {
   filter = from.filter;
@@ -22,6 +22,7 @@
 #include <boost/unordered_map.hpp>
 #include "runtime/runtime-filter.h"
 #include "util/runtime-profile.h"
+#include "util/spinlock.h"
 
 namespace llvm {
 class Function;
@@ -30,6 +31,7 @@ class Function;
 namespace impala {
 
 class BloomFilter;
+class DescriptorTbl;
 class LlvmCodeGen;
 class MinMaxFilter;
 class RuntimeState;
@@ -73,15 +75,82 @@ class FilterStats {
   /// Adds a new counter group with key 'key'. Not thread safe.
   void RegisterCounterGroup(const std::string& key);
 
+  /// Returns the counters with key 'key'. Thread safe as long as there are no concurrent
+  /// calls to RegisterCounterGroup().
+  const CounterGroup& GetCounterGroup(const std::string& key) const;
+
+  /// Records that a scanner stopped evaluating the filter on rows because it rejected
+  /// too few of them, or that it re-enabled the filter to re-measure its rejection rate.
+  /// Thread safe.
+  void IncrDisabledAsIneffective() const { disabled_as_ineffective->Add(1); }
+  void IncrReenabled() const { reenabled->Add(1); }
+
+  /// Adds 'num_rows' rows that the filter was not evaluated on because a scanner had
+  /// disabled it as ineffective. This is the row evaluation work saved. Thread safe.
+  void AddRowsSkippedAsIneffective(int64_t num_rows) const {
+    rows_skipped_as_ineffective->Add(num_rows);
+  }
+
  private:
   /// Map from some key to statistics for that key.
   typedef boost::unordered_map<std::string, CounterGroup> CountersMap;
   CountersMap counters;
 
+  /// Counters for the adaptive disabling of row-level filtering in scanners, see
+  /// HdfsScanner::CheckFiltersEffectiveness().
+  RuntimeProfile::Counter* disabled_as_ineffective;
+  RuntimeProfile::Counter* reenabled;
+  RuntimeProfile::Counter* rows_skipped_as_ineffective;
+
   /// Runtime profile to which counters are added. Owned by runtime state's object pool.
   RuntimeProfile* profile;
 };
 
+/// Process-wide history of how many rows runtime filters rejected in past scans, keyed by
+/// the scanned table, the target column(s) and the producing join of the filter (see
+/// MakeKey()). Scans use
+/// it to avoid waiting for the arrival of filters that were consistently ineffective on
+/// the same target. Filters are still applied if they arrive later, so the history only
+/// affects how long a scan waits before it starts. Thread safe.
+class FilterEffectivenessHistory {
+ public:
+  static FilterEffectivenessHistory* GetInstance();
+
+  /// Returns the key for filter 'filter_desc' applied by the scan with id 'node_id' on
+  /// table 'table_name'. The target slots are resolved to their column paths with
+  /// 'desc_tbl', as slot ids are not stable across queries. The key also identifies the
+  /// build side by the ids of the producing join and the scan in the plan and by the
+  /// build column, if the filter is built from one. Returns an empty string if the
+  /// target cannot be identified.
+  static std::string MakeKey(const std::string& table_name,
+      const DescriptorTbl& desc_tbl, const TRuntimeFilterDesc& filter_desc,
+      TPlanNodeId node_id);
+
+  /// Records that a filter with key 'key' rejected 'rejected' of the 'processed' rows it
+  /// was applied to in one scan. Scans that processed too few rows are ignored.
+  void Update(const std::string& key, int64_t processed, int64_t rejected);
+
+  /// Returns true if filters with key 'key' were observed in enough past scans and their
+  /// exponentially decayed rejection ratio is below --min_filter_reject_ratio.
+  bool IsIneffective(const std::string& key) const;
+
+  /// Returns true if scans should not wait for the arrival of filters with key 'key',
+  /// i.e. if --skip_wait_for_ineffective_runtime_filters is set and IsIneffective().
+  bool SkipWaitForFilter(const std::string& key) const;
+
+ private:
+  struct Entry {
+    /// Rejection ratio, exponentially decayed across scans.
+    double reject_ratio = 0;
+    /// Number of scans that updated this entry.
+    int64_t num_scans = 0;
+  };
+
+  /// Protects 'entries_'.
+  mutable SpinLock lock_;
+  boost::unordered_map<std::string, Entry> entries_;
+};
+
 /// FilterContext contains all metadata for a single runtime filter, and allows the filter
 /// to be applied in the context of a single thread.
 struct FilterContext {
@@ -21,6 +21,7 @@
 #include "exprs/agg-fn-evaluator.h"
 #include "runtime/row-batch.h"
 #include "runtime/tuple-row.h"
+#include "util/runtime-profile-counters.h"
 
 using namespace impala;
 
@@ -55,6 +56,72 @@ Status GroupingAggregator::AddBatchImpl(RowBatch* batch,
   return Status::OK();
 }
 
+template <bool AGGREGATED_ROWS>
+Status GroupingAggregator::AddBatchToPassImpl(
+    RowBatch* batch, HashTableCtx* __restrict__ ht_ctx) {
+  DCHECK(!hash_partitions_.empty());
+  DCHECK(!is_streaming_preagg_);
+  DCHECK(overflow_partition_ != nullptr);
+  // All items of 'hash_partitions_' point to the partition that is aggregated.
+  Partition* partition = hash_partitions_[0];
+  DCHECK(!partition->is_spilled());
+  HashTable* hash_tbl = partition->hash_tbl.get();
+  if (!pass_hash_tbl_full_) {
+    SCOPED_TIMER(ht_resize_timer_);
+    bool resized;
+    RETURN_IF_ERROR(hash_tbl->CheckAndResize(batch->num_rows(), ht_ctx, &resized));
+    pass_hash_tbl_full_ = !resized;
+  }
+  BufferedTupleStream* overflow_stream = AGGREGATED_ROWS ?
+      overflow_partition_->aggregated_row_stream.get() :
+      overflow_partition_->unaggregated_row_stream.get();
+
+  HashTableCtx::ExprValuesCache* expr_vals_cache = ht_ctx->expr_values_cache();
+  const int cache_size = expr_vals_cache->capacity();
+  const int num_rows = batch->num_rows();
+  for (int group_start = 0; group_start < num_rows; group_start += cache_size) {
+    EvalAndHashPrefetchGroup<AGGREGATED_ROWS>(
+        batch, group_start, TPrefetchMode::NONE, ht_ctx);
+
+    FOREACH_ROW_LIMIT(batch, group_start, cache_size, batch_iter) {
+      TupleRow* row = batch_iter.Get();
+      if (!expr_vals_cache->IsRowNull()) {
+        // A full hash table still has free buckets, it just cannot grow any more.
+        bool found;
+        HashTable::Iterator it = hash_tbl->FindBuildRowBucket(ht_ctx, &found);
+        DCHECK(!it.AtEnd()) << "Hash table had no free buckets";
+        Tuple* intermediate_tuple = nullptr;
+        if (found) {
+          intermediate_tuple = it.GetTuple();
+        } else if (!pass_hash_tbl_full_) {
+          intermediate_tuple = ConstructIntermediateTuple(partition->agg_fn_evals,
+              partition->aggregated_row_stream.get(), &add_batch_status_);
+          if (LIKELY(intermediate_tuple != nullptr)) {
+            it.SetTuple(intermediate_tuple, expr_vals_cache->CurExprValuesHash());
+          } else {
+            RETURN_IF_ERROR(std::move(add_batch_status_));
+            pass_hash_tbl_full_ = true;
+          }
+        }
+        if (intermediate_tuple != nullptr) {
+          UpdateTuple(partition->agg_fn_evals.data(), intermediate_tuple, row,
+              AGGREGATED_ROWS);
+        } else if (UNLIKELY(!AddRowToSpilledStream(
+                       overflow_stream, row, &add_batch_status_))) {
+          RETURN_IF_ERROR(std::move(add_batch_status_));
+          // Spilling 'partition' to free up reservation would split its groups between
+          // two spilled partitions.
+          return Status(TErrorCode::PARTITIONED_AGG_MULTI_PASS_FAILS, id_,
+              partition->level, buffer_pool_client()->DebugString());
+        }
+      }
+      expr_vals_cache->NextRow();
+    }
+    DCHECK(expr_vals_cache->AtEnd());
+  }
+  return Status::OK();
+}
+
 template <bool AGGREGATED_ROWS>
 void IR_ALWAYS_INLINE GroupingAggregator::EvalAndHashPrefetchGroup(RowBatch* batch,
     int start_row_idx, TPrefetchMode::type prefetch_mode, HashTableCtx* ht_ctx) {
@@ -261,3 +328,5 @@ template Status GroupingAggregator::AddBatchImpl<false>(
     RowBatch*, TPrefetchMode::type, HashTableCtx*, bool);
 template Status GroupingAggregator::AddBatchImpl<true>(
     RowBatch*, TPrefetchMode::type, HashTableCtx*, bool);
+template Status GroupingAggregator::AddBatchToPassImpl<false>(RowBatch*, HashTableCtx*);
+template Status GroupingAggregator::AddBatchToPassImpl<true>(RowBatch*, HashTableCtx*);
@@ -38,6 +38,7 @@
 #include "runtime/string-value.h"
 #include "runtime/tuple-row.h"
 #include "runtime/tuple.h"
+#include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
 #include "util/string-parser.h"
 
@@ -178,6 +179,8 @@ Status GroupingAggregator::Prepare(RuntimeState* state) {
     num_repartitions_ = ADD_COUNTER(runtime_profile(), "NumRepartitions", TUnit::UNIT);
     num_spilled_partitions_ =
         ADD_COUNTER(runtime_profile(), "SpilledPartitions", TUnit::UNIT);
+    num_aggregation_passes_ =
+        ADD_COUNTER(runtime_profile(), "NumAggregationPasses", TUnit::UNIT);
     max_partition_level_ =
         runtime_profile()->AddHighWaterMarkCounter("MaxPartitionLevel", TUnit::UNIT);
   }
@@ -819,11 +822,23 @@ Status GroupingAggregator::NextPartition() {
     // we only need to fit 1/PARTITION_FANOUT of the data in memory.
     // TODO: in some cases when the partition probably won't fit in memory it could
     // be better to skip directly to repartitioning.
-    RETURN_IF_ERROR(BuildSpilledPartition(&partition));
-    if (partition != nullptr) break;
-
-    // If we can't fit the partition in memory, repartition it.
-    RETURN_IF_ERROR(RepartitionSpilledPartition());
+    // The AGGREGATE_SPILLED_PARTITIONS_IN_PASSES query option makes tests aggregate all
+    // spilled partitions in multiple passes.
+    if (!spilled_partitions_.front()->is_skewed
+        && !state_->query_options().aggregate_spilled_partitions_in_passes) {
+      RETURN_IF_ERROR(BuildSpilledPartition(&partition));
+      if (partition != nullptr) break;
+
+      // If we can't fit the partition in memory, repartition it.
+      if (spilled_partitions_.front()->level + 1 < MAX_PARTITION_DEPTH) {
+        RETURN_IF_ERROR(RepartitionSpilledPartition());
+        continue;
+      }
+    }
+    // Repartitioning cannot reduce the partition any further. Aggregate the groups that
+    // fit in memory and leave the rest for the next pass.
+    RETURN_IF_ERROR(AggregateSpilledPartitionInPasses(&partition));
+    break;
   }
   DCHECK(!partition->is_spilled());
   DCHECK(partition->hash_tbl.get() != nullptr);
@@ -854,10 +869,9 @@ Status GroupingAggregator::BuildSpilledPartition(Partition** built_partition) {
   // rows to the hash table. It's possible the partition will spill at either stage.
   // In that case we need to finish processing 'src_partition' so that all rows are
   // appended to 'dst_partition'.
-  // TODO: if the partition spills again but the aggregation reduces the input
-  // significantly, we could do better here by keeping the incomplete hash table in
-  // memory and only spilling unaggregated rows that didn't fit in the hash table
-  // (somewhat similar to the passthrough pre-aggregation).
+  // If the partition spills again and repartitioning does not help,
+  // AggregateSpilledPartitionInPasses() keeps the incomplete hash table in memory
+  // instead.
   RETURN_IF_ERROR(ProcessStream<true>(src_partition->aggregated_row_stream.get(),
       /* has_more_streams */ src_partition->unaggregated_row_stream->num_rows() > 0));
   RETURN_IF_ERROR(ProcessStream<false>(src_partition->unaggregated_row_stream.get(),
@@ -929,10 +943,92 @@ Status GroupingAggregator::RepartitionSpilledPartition() {
   // spilled_partitions_/aggregated_partitions_.
   int64_t num_input_rows = partition->aggregated_row_stream->num_rows()
       + partition->unaggregated_row_stream->num_rows();
+  // A dominant grouping key collapses into a single hash table entry, so skew alone
+  // does not stop a partition from fitting in memory. But if all rows ended up in the
+  // same spilled partition again, the partition consists of a few groups whose
+  // aggregate states do not fit in memory, and repartitioning it further cannot help.
+  for (Partition* hash_partition : hash_partitions_) {
+    if (hash_partition == nullptr || !hash_partition->is_spilled()) continue;
+    int64_t num_rows = hash_partition->aggregated_row_stream->num_rows()
+        + hash_partition->unaggregated_row_stream->num_rows();
+    if (UNLIKELY(num_rows == num_input_rows)) hash_partition->is_skewed = true;
+  }
   RETURN_IF_ERROR(MoveHashPartitions(num_input_rows));
   return Status::OK();
 }
 
+Status GroupingAggregator::AggregateSpilledPartitionInPasses(
+    Partition** built_partition) {
+  DCHECK(!spilled_partitions_.empty());
+  DCHECK(!is_streaming_preagg_);
+  DCHECK(overflow_partition_ == nullptr);
+  // Leave the partition in 'spilled_partitions_' to be closed if we hit an error.
+  Partition* src_partition = spilled_partitions_.front();
+  DCHECK(src_partition->is_spilled());
+  int64_t num_input_rows = src_partition->aggregated_row_stream->num_rows()
+      + src_partition->unaggregated_row_stream->num_rows();
+  COUNTER_ADD(num_aggregation_passes_, 1);
+
+  // Create the partition that rows of groups that do not fit are appended to before the
+  // hash table can use up the reservation for its write buffer. It does not need the
+  // aggregate function evaluators since it never has a hash table.
+  overflow_partition_ = partition_pool_->Add(
+      new Partition(this, src_partition->level, src_partition->idx));
+  overflow_partition_->is_skewed = true;
+  pass_hash_tbl_full_ = false;
+  RETURN_IF_ERROR(overflow_partition_->InitStreams());
+  AggFnEvaluator::Close(overflow_partition_->agg_fn_evals, state_);
+  overflow_partition_->agg_fn_evals.clear();
+  overflow_partition_->agg_fn_perm_pool->FreeAll();
+  overflow_partition_->agg_fn_perm_pool.reset();
+  RETURN_IF_ERROR(overflow_partition_->aggregated_row_stream->UnpinStream(
+      BufferedTupleStream::UNPIN_ALL_EXCEPT_CURRENT));
+
+  RETURN_IF_ERROR(CreateHashPartitions(src_partition->level, src_partition->idx));
+  Partition* dst_partition = hash_partitions_[src_partition->idx];
+  if (UNLIKELY(dst_partition->is_spilled())) {
+    return Status(TErrorCode::PARTITIONED_AGG_MULTI_PASS_FAILS, id_,
+        src_partition->level, buffer_pool_client()->DebugString());
+  }
+
+  RETURN_IF_ERROR(ProcessStream<true>(src_partition->aggregated_row_stream.get(),
+      /* has_more_streams */ src_partition->unaggregated_row_stream->num_rows() > 0));
+  if (src_partition->unaggregated_row_stream->num_rows() > 0) {
+    // Free the write buffer of the aggregated rows and use it for the unaggregated rows.
+    RETURN_IF_ERROR(overflow_partition_->aggregated_row_stream->UnpinStream(
+        BufferedTupleStream::UNPIN_ALL));
+    bool got_buffer;
+    RETURN_IF_ERROR(overflow_partition_->unaggregated_row_stream->PrepareForWrite(
+        &got_buffer));
+    DCHECK(got_buffer) << "Accounted in min reservation"
+                       << buffer_pool_client()->DebugString();
+    RETURN_IF_ERROR(ProcessStream<false>(src_partition->unaggregated_row_stream.get(),
+        /* has_more_streams */ false));
+  }
+  DCHECK(!dst_partition->is_spilled());
+  src_partition->Close(false);
+  spilled_partitions_.pop_front();
+  hash_partitions_.clear();
+
+  Partition* overflow_partition = overflow_partition_;
+  overflow_partition_ = nullptr;
+  int64_t num_overflow_rows = overflow_partition->aggregated_row_stream->num_rows()
+      + overflow_partition->unaggregated_row_stream->num_rows();
+  VLOG(2) << "PA(node_id=" << id_ << ") aggregated "
+          << num_input_rows - num_overflow_rows << " of " << num_input_rows
+          << " rows of a spilled partition at level " << src_partition->level
+          << " in one pass";
+  if (num_overflow_rows == 0) {
+    overflow_partition->Close(false);
+  } else {
+    // At least the first group fits in the hash table, so each pass makes progress.
+    DCHECK_LT(num_overflow_rows, num_input_rows);
+    RETURN_IF_ERROR(PushSpilledPartition(overflow_partition));
+  }
+  *built_partition = dst_partition;
+  return Status::OK();
+}
+
 template <bool AGGREGATED_ROWS>
 Status GroupingAggregator::ProcessStream(BufferedTupleStream* input_stream,
     bool has_more_streams) {
@@ -955,6 +1051,11 @@ Status GroupingAggregator::ProcessStream(BufferedTupleStream* input_stream,
       bool got_buffer = false;
       RETURN_IF_ERROR(input_stream->PrepareForRead(/*attach_on_read*/ true, &got_buffer));
       if (got_buffer) break;
+      // The partition that is aggregated in a pass is never spilled.
+      if (UNLIKELY(overflow_partition_ != nullptr)) {
+        return Status(TErrorCode::PARTITIONED_AGG_MULTI_PASS_FAILS, id_,
+            hash_partitions_[0]->level, buffer_pool_client()->DebugString());
+      }
       // Did not have a buffer to read the input stream. Spill and try again.
       RETURN_IF_ERROR(SpillPartition(AGGREGATED_ROWS));
     }
@@ -970,8 +1071,12 @@ Status GroupingAggregator::ProcessStream(BufferedTupleStream* input_stream,
       rows_read += batch.num_rows();
       if (rows_read == input_stream->num_rows()) DCHECK(eos);
       bool has_more_rows = AGGREGATED_ROWS ? (has_more_streams || !eos) : !eos;
-      RETURN_IF_ERROR(AddBatchImpl<AGGREGATED_ROWS>(&batch, prefetch_mode, ht_ctx_.get(),
-          has_more_rows));
+      if (overflow_partition_ != nullptr) {
+        RETURN_IF_ERROR(AddBatchToPassImpl<AGGREGATED_ROWS>(&batch, ht_ctx_.get()));
+      } else {
+        RETURN_IF_ERROR(AddBatchImpl<AGGREGATED_ROWS>(&batch, prefetch_mode,
+            ht_ctx_.get(), has_more_rows));
+      }
       RETURN_IF_ERROR(QueryMaintenance(state_));
       batch.Reset();
       // We are reading in attach_on_read mode, the large read page reservation could be
@@ -1101,6 +1206,10 @@ void GroupingAggregator::ClosePartitions() {
   aggregated_partitions_.clear();
   for (Partition* partition : spilled_partitions_) partition->Close(true);
   spilled_partitions_.clear();
+  if (overflow_partition_ != nullptr) {
+    overflow_partition_->Close(true);
+    overflow_partition_ = nullptr;
+  }
   memset(hash_tbls_, 0, sizeof(hash_tbls_));
   partition_pool_->Clear();
 }
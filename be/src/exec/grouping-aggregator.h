@@ -233,9 +233,10 @@ class GroupingAggregator : public Aggregator {
   /// (if we have enough scratch disk space) in case there is no skew is:
   ///  MEM_LIMIT * (PARTITION_FANOUT ^ MAX_PARTITION_DEPTH).
   /// In the case where there is skew, repartitioning is unlikely to help (assuming a
-  /// reasonable hash function).
+  /// reasonable hash function). Partitions that repartitioning did not reduce or that
+  /// reached the maximum depth are aggregated in multiple passes instead, see
+  /// AggregateSpilledPartitionInPasses().
   /// Note that we need to have at least as many SEED_PRIMES in HashTableCtx.
-  /// TODO: we can revisit and try harder to explicitly detect skew.
   static const int MAX_PARTITION_DEPTH = 16;
 
   /// Default initial number of buckets in a hash table.
@@ -347,6 +348,9 @@ class GroupingAggregator : public Aggregator {
   /// Number of partitions that have been spilled.
   RuntimeProfile::Counter* num_spilled_partitions_ = nullptr;
 
+  /// Number of passes over spilled partitions that could not be repartitioned.
+  RuntimeProfile::Counter* num_aggregation_passes_ = nullptr;
+
   /// The largest fraction after repartitioning. This is expected to be
   /// 1 / PARTITION_FANOUT. A value much larger indicates skew.
   RuntimeProfile::HighWaterMarkCounter* largest_partition_percent_ = nullptr;
@@ -402,6 +406,15 @@ class GroupingAggregator : public Aggregator {
   /// All partitions that have been spilled and need further processing.
   std::deque<Partition*> spilled_partitions_;
 
+  /// The spilled partition that rows of groups that do not fit in the hash table are
+  /// appended to while a spilled partition is aggregated in multiple passes. NULL
+  /// otherwise.
+  Partition* overflow_partition_ = nullptr;
+
+  /// True if the hash table of the partition that is aggregated in the current pass
+  /// cannot take new groups any more. Only valid if 'overflow_partition_' is not NULL.
+  bool pass_hash_tbl_full_ = false;
+
   /// All partitions that are aggregated and can just return the results in GetNext().
   /// After consuming all the input, hash_partitions_ is split into spilled_partitions_
   /// and aggregated_partitions_, depending on if it was spilled or not.
@@ -416,7 +429,7 @@ class GroupingAggregator : public Aggregator {
   /// require an unaggregated stream.
   struct Partition {
     Partition(GroupingAggregator* parent, int level, int idx)
-      : parent(parent), is_closed(false), level(level), idx(idx) {}
+      : parent(parent), is_closed(false), level(level), idx(idx), is_skewed(false) {}
 
     ~Partition();
 
@@ -464,6 +477,12 @@ class GroupingAggregator : public Aggregator {
     /// The index of this partition within 'hash_partitions_' at its level.
     const int idx;
 
+    /// True if repartitioning did not reduce the number of rows of this partition, i.e.
+    /// its rows belong to a few groups whose aggregate states do not fit in memory
+    /// together. Such partitions are aggregated in multiple passes instead of being
+    /// repartitioned again.
+    bool is_skewed;
+
     /// Hash table for this partition.
     /// Can be NULL if this partition is no longer maintaining a hash table (i.e.
     /// is spilled or we are passing through all rows for this partition).
@@ -583,7 +602,16 @@ class GroupingAggregator : public Aggregator {
   Status IR_ALWAYS_INLINE AppendSpilledRow(
       Partition* partition, TupleRow* row) WARN_UNUSED_RESULT;
 
-  /// Reads all the rows from input_stream and process them by calling AddBatchImpl().
+  /// Aggregates the rows in 'batch' into the single partition in 'hash_partitions_' as
+  /// part of a pass of AggregateSpilledPartitionInPasses(). Rows of groups that are
+  /// already in the hash table are aggregated. Rows of new groups are added to the hash
+  /// table until it is full and appended to 'overflow_partition_' after that. Never
+  /// spills the partition.
+  template <bool AGGREGATED_ROWS>
+  Status AddBatchToPassImpl(RowBatch* batch, HashTableCtx* ht_ctx) WARN_UNUSED_RESULT;
+
+  /// Reads all the rows from input_stream and process them by calling AddBatchImpl(), or
+  /// AddBatchToPassImpl() if 'overflow_partition_' is set.
   template <bool AGGREGATED_ROWS>
   Status ProcessStream(BufferedTupleStream* input_stream, bool has_more_streams)
       WARN_UNUSED_RESULT;
@@ -661,6 +689,17 @@ class GroupingAggregator : public Aggregator {
   /// * in 'aggregated_partitions_', if the output partition was not spilled.
   Status RepartitionSpilledPartition() WARN_UNUSED_RESULT;
 
+  /// Aggregates the first partition in 'spilled_partitions_' in a pass that keeps the
+  /// hash table in memory once it is full: rows of the groups that fit are aggregated
+  /// and the rows of the remaining groups are appended to a new spilled partition, which
+  /// is added to the head of 'spilled_partitions_' for the next pass. Used instead of
+  /// RepartitionSpilledPartition() for partitions that are skewed or at the maximum
+  /// partition depth. Each pass aggregates at least one group, so a partition is fully
+  /// aggregated in a finite number of passes. Sets *built_partition to the in-memory
+  /// partition, which the caller owns and is responsible for closing.
+  Status AggregateSpilledPartitionInPasses(Partition** built_partition)
+      WARN_UNUSED_RESULT;
+
   /// Picks a partition from 'hash_partitions_' to spill. 'more_aggregate_rows' is passed
   /// to Partition::Spill() when spilling the partition. See the Partition::Spill()
   /// comment for further explanation.
@@ -0,0 +1,385 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-json-scanner.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "common/logging.h"
+#include "exec/hdfs-scan-node-base.h"
+#include "exec/hdfs-scan-node.h"
+#include "exec/hdfs-text-scanner.h"
+#include "exec/json-parser.h"
+#include "exec/scanner-context.inline.h"
+#include "exec/text-converter.h"
+#include "gen-cpp/ErrorCodes_types.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/descriptors.h"
+#include "runtime/io/request-context.h"
+#include "runtime/io/request-ranges.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "util/codec.h"
+#include "util/debug-util.h"
+#include "util/error-util.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using namespace impala::io;
+using namespace strings;
+
+/// Maximum number of bytes of an invalid record that are included in its error message.
+static const int MAX_ERROR_RECORD_LEN = 128;
+
+HdfsJsonScanner::HdfsJsonScanner(HdfsScanNodeBase* scan_node, RuntimeState* state)
+  : HdfsScanner(scan_node, state),
+    boundary_pool_(new MemPool(scan_node->mem_tracker())),
+    boundary_record_(boundary_pool_.get()) {
+}
+
+HdfsJsonScanner::~HdfsJsonScanner() {
+}
+
+Status HdfsJsonScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
+    const vector<HdfsFileDesc*>& files) {
+  vector<ScanRange*> compressed_file_ranges;
+  for (HdfsFileDesc* file : files) {
+    THdfsCompression::type compression = file->file_compression;
+    if (compression == THdfsCompression::NONE) {
+      // Uncompressed files are split on record boundaries, so all ranges are issued.
+      RETURN_IF_ERROR(scan_node->AddDiskIoRanges(file, EnqueueLocation::TAIL));
+      continue;
+    }
+    if (!HdfsTextScanner::HasBuiltinSupport(compression)) {
+      return Status(Substitute("Scanning JSON files compressed with $0 is not "
+          "supported: $1", PrintThriftEnum(compression), file->filename));
+    }
+    for (ScanRange* split : file->splits) {
+      // Compressed files are read as a whole by the scanner of the split at offset 0.
+      if (split->offset() != 0) {
+        scan_node->runtime_state()->LogError(ErrorMsg(
+            TErrorCode::COMPRESSED_FILE_MULTIPLE_BLOCKS, file->filename,
+            split->offset()));
+        scan_node->RangeComplete(THdfsFileFormat::JSON, compression);
+        continue;
+      }
+      DCHECK_GT(file->file_length, 0);
+      ScanRangeMetadata* metadata = static_cast<ScanRangeMetadata*>(split->meta_data());
+      ScanRange* file_range = scan_node->AllocateScanRange(file->fs,
+          file->filename.c_str(), file->file_length, 0, metadata->partition_id,
+          split->disk_id(), split->expected_local(), file->mtime,
+          BufferOpts(split->cache_options()));
+      compressed_file_ranges.push_back(file_range);
+      scan_node->max_compressed_text_file_length()->Set(file->file_length);
+    }
+  }
+  if (!compressed_file_ranges.empty()) {
+    RETURN_IF_ERROR(
+        scan_node->AddDiskIoRanges(compressed_file_ranges, EnqueueLocation::TAIL));
+  }
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::Codegen(HdfsScanPlanNode* node, FragmentState* state,
+    llvm::Function** write_aligned_tuples_fn) {
+  // Once their fields are located, records are written exactly like delimited text.
+  return HdfsTextScanner::Codegen(node, state, write_aligned_tuples_fn);
+}
+
+Status HdfsJsonScanner::Open(ScannerContext* context) {
+  RETURN_IF_ERROR(HdfsScanner::Open(context));
+
+  parse_json_timer_ = ADD_TIMER(scan_node_->runtime_profile(), "JsonParseTime");
+
+  vector<string> field_names;
+  for (const SlotDescriptor* slot_desc : scan_node_->materialized_slots()) {
+    field_names.push_back(
+        scan_node_->hdfs_table()->col_descs()[slot_desc->col_pos()].name());
+  }
+  json_parser_.reset(new JsonParser(field_names));
+  field_locations_.resize(state_->batch_size() * field_names.size());
+
+  RETURN_IF_ERROR(InitNewRange());
+  return Status::OK();
+}
+
+void HdfsJsonScanner::Close(RowBatch* row_batch) {
+  DCHECK(!is_closed_);
+  // The decompressor may hold memory in its temp pool, so close it before transferring
+  // the remaining resources to 'row_batch'.
+  if (decompressor_ != nullptr) {
+    decompressor_->Close();
+    decompressor_.reset();
+  }
+  boundary_pool_->FreeAll();
+  if (row_batch != nullptr) {
+    row_batch->tuple_data_pool()->AcquireData(template_tuple_pool_.get(), false);
+    row_batch->tuple_data_pool()->AcquireData(data_buffer_pool_.get(), false);
+    if (scan_node_->HasRowBatchQueue()) {
+      static_cast<HdfsScanNode*>(scan_node_)->AddMaterializedRowBatch(
+          unique_ptr<RowBatch>(row_batch));
+    }
+  } else {
+    template_tuple_pool_->FreeAll();
+    data_buffer_pool_->FreeAll();
+  }
+  context_->ReleaseCompletedResources(true);
+
+  // Verify all resources (if any) have been transferred or freed.
+  DCHECK_EQ(template_tuple_pool_->total_allocated_bytes(), 0);
+  DCHECK_EQ(data_buffer_pool_->total_allocated_bytes(), 0);
+  DCHECK_EQ(boundary_pool_->total_allocated_bytes(), 0);
+  scan_node_->RangeComplete(THdfsFileFormat::JSON,
+      stream_->file_desc()->file_compression);
+  CloseInternal();
+}
+
+Status HdfsJsonScanner::InitNewRange() {
+  THdfsCompression::type compression = stream_->file_desc()->file_compression;
+  // Like text files, .deflate files written by Hadoop use zlib wrappings.
+  if (compression == THdfsCompression::DEFLATE) compression = THdfsCompression::DEFAULT;
+  RETURN_IF_ERROR(UpdateDecompressor(compression));
+
+  // Strings are unescaped by the JsonParser, not by the TextConverter.
+  text_converter_.reset(new TextConverter('\0',
+      scan_node_->hdfs_table()->null_column_value(), true, state_->strict_mode()));
+  RETURN_IF_ERROR(InitializeWriteTuplesFn(
+      context_->partition_descriptor(), THdfsFileFormat::JSON, "HdfsJsonScanner"));
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::FillBuffer(bool* eof) {
+  *eof = false;
+  uint8_t* buffer = nullptr;
+  int64_t len = 0;
+  if (decompressor_ != nullptr) {
+    // Read and decompress the whole file at once.
+    if (compressed_file_read_) {
+      *eof = true;
+      return Status::OK();
+    }
+    int64_t file_size = stream_->file_desc()->file_length;
+    uint8_t* compressed;
+    int64_t compressed_len;
+    Status status;
+    if (!stream_->GetBytes(file_size, &compressed, &compressed_len, &status)) {
+      DCHECK(!status.ok());
+      return status;
+    }
+    if (compressed_len < file_size) {
+      return Status(Substitute("Expected to read a compressed JSON file of size $0 "
+          "bytes, but only read $1 bytes. This may indicate data file corruption. "
+          "(file: $2).", file_size, compressed_len, stream_->filename()));
+    }
+    {
+      SCOPED_TIMER(decompress_timer_);
+      RETURN_IF_ERROR(
+          decompressor_->ProcessBlock(false, compressed_len, compressed, &len, &buffer));
+    }
+    // The buffer with the compressed data can be released.
+    context_->ReleaseCompletedResources(true);
+    compressed_file_read_ = true;
+  } else {
+    while (len == 0) {
+      if (!stream_->eosr()) {
+        RETURN_IF_ERROR(stream_->GetBuffer(false, &buffer, &len));
+      } else if (stream_->eof()) {
+        break;
+      } else {
+        // Past the end of the scan range, finishing its last record.
+        Status status;
+        if (!stream_->GetBytes(NEXT_BLOCK_READ_SIZE, &buffer, &len, &status)) {
+          DCHECK(!status.ok());
+          return status;
+        }
+        if (len == 0) break;
+      }
+    }
+  }
+  *eof = len == 0;
+  buffer_ptr_ = reinterpret_cast<char*>(buffer);
+  buffer_end_ = buffer_ptr_ + len;
+  return Status::OK();
+}
+
+bool HdfsJsonScanner::PastScanRange() {
+  // Compressed files are read as a whole.
+  if (decompressor_ != nullptr) return false;
+  const ScanRange* scan_range = stream_->scan_range();
+  int64_t offset = stream_->file_offset() - (buffer_end_ - buffer_ptr_);
+  return offset > scan_range->offset() + scan_range->len();
+}
+
+Status HdfsJsonScanner::FindFirstRecord(bool* found) {
+  *found = false;
+  // Skip the header lines at the start of the file, or the partial record at the start
+  // of the scan range, which belongs to the previous scan range.
+  int num_lines_to_skip =
+      stream_->scan_range()->offset() == 0 ? scan_node_->skip_header_line_count() : 1;
+  while (num_lines_to_skip > 0) {
+    if (buffer_ptr_ == buffer_end_) {
+      bool eof;
+      RETURN_IF_ERROR(FillBuffer(&eof));
+      if (eof) return Status::OK();
+    }
+    // Records that start after the next newline are not part of the scan range.
+    if (PastScanRange()) return Status::OK();
+    char* newline =
+        static_cast<char*>(memchr(buffer_ptr_, '\n', buffer_end_ - buffer_ptr_));
+    if (newline == nullptr) {
+      buffer_ptr_ = buffer_end_;
+    } else {
+      buffer_ptr_ = newline + 1;
+      --num_lines_to_skip;
+    }
+  }
+  *found = true;
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::GetNextInternal(RowBatch* row_batch) {
+  DCHECK(!eos_);
+  if (!first_record_found_) {
+    RETURN_IF_ERROR(FindFirstRecord(&first_record_found_));
+    if (!first_record_found_) {
+      eos_ = true;
+      return Status::OK();
+    }
+  }
+
+  int64_t tuple_buffer_size;
+  RETURN_IF_ERROR(
+      row_batch->ResizeAndAllocateTupleBuffer(state_, &tuple_buffer_size, &tuple_mem_));
+  tuple_ = reinterpret_cast<Tuple*>(tuple_mem_);
+
+  while (!eos_ && !row_batch->AtCapacity()) {
+    bool eof = false;
+    if (buffer_ptr_ == buffer_end_) RETURN_IF_ERROR(FillBuffer(&eof));
+    // At the end of the file, this completes the last record, which doesn't need to end
+    // with a newline.
+    RETURN_IF_ERROR(ProcessBuffer(row_batch));
+    if (eof || scan_node_->ReachedLimitShared()) eos_ = true;
+  }
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::ProcessBuffer(RowBatch* row_batch) {
+  MemPool* pool = row_batch->tuple_data_pool();
+  TupleRow* row = row_batch->GetRow(row_batch->AddRow());
+  int max_records = row_batch->capacity() - row_batch->num_rows();
+  int num_slots = scan_node_->materialized_slots().size();
+  FieldLocation* fields = field_locations_.data();
+  int num_records = 0;
+  bool added;
+
+  // Complete the record that started in a previous buffer. The buffer is only empty at
+  // the end of the file, where the record is complete as it is.
+  bool boundary_record_done = false;
+  if (!boundary_record_.IsEmpty()) {
+    if (buffer_ptr_ != buffer_end_) {
+      char* newline =
+          static_cast<char*>(memchr(buffer_ptr_, '\n', buffer_end_ - buffer_ptr_));
+      char* record_end = newline == nullptr ? buffer_end_ : newline;
+      RETURN_IF_ERROR(boundary_record_.Append(buffer_ptr_, record_end - buffer_ptr_));
+      buffer_ptr_ = newline == nullptr ? buffer_end_ : newline + 1;
+      // The record continues in the next buffer.
+      if (newline == nullptr) return Status::OK();
+    }
+    RETURN_IF_ERROR(ParseRecord(
+        boundary_record_.buffer(), boundary_record_.len(), pool, fields, &added));
+    if (added) {
+      fields += num_slots;
+      ++num_records;
+    }
+    boundary_record_done = true;
+  }
+
+  while (num_records < max_records && buffer_ptr_ != buffer_end_) {
+    if (PastScanRange()) {
+      eos_ = true;
+      break;
+    }
+    char* newline =
+        static_cast<char*>(memchr(buffer_ptr_, '\n', buffer_end_ - buffer_ptr_));
+    if (newline == nullptr) {
+      if (boundary_record_done) break;
+      RETURN_IF_ERROR(boundary_record_.Append(buffer_ptr_, buffer_end_ - buffer_ptr_));
+      buffer_ptr_ = buffer_end_;
+      break;
+    }
+    RETURN_IF_ERROR(
+        ParseRecord(buffer_ptr_, newline - buffer_ptr_, pool, fields, &added));
+    buffer_ptr_ = newline + 1;
+    if (added) {
+      fields += num_slots;
+      ++num_records;
+    }
+  }
+
+  // Fields may point into 'boundary_record_' until the tuples are written.
+  RETURN_IF_ERROR(WriteRecords(num_records, row, row_batch));
+  if (boundary_record_done) boundary_record_.Clear();
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::ParseRecord(const char* record, int64_t len, MemPool* pool,
+    FieldLocation* fields, bool* added) {
+  {
+    SCOPED_TIMER(parse_json_timer_);
+    RETURN_IF_ERROR(json_parser_->Parse(record, len, pool, fields, added));
+  }
+  if (LIKELY(*added)) return Status::OK();
+  const char* end = record + len;
+  if (find_if(record, end, [](char c) { return !isspace(c); }) == end) {
+    return Status::OK();
+  }
+  string error = Substitute("Error parsing JSON record: file: $0, before offset: $1: $2",
+      stream_->filename(), stream_->file_offset() - (buffer_end_ - buffer_ptr_),
+      string(record, min<int64_t>(len, MAX_ERROR_RECORD_LEN)));
+  return state_->LogOrReturnError(ErrorMsg(TErrorCode::GENERAL, error));
+}
+
+Status HdfsJsonScanner::WriteRecords(int num_records, TupleRow* row,
+    RowBatch* row_batch) {
+  COUNTER_ADD(scan_node_->rows_read_counter(), num_records);
+  if (num_records == 0) return Status::OK();
+  SCOPED_TIMER(scan_node_->materialize_tuple_timer());
+  int num_tuples_materialized;
+  int num_slots = scan_node_->materialized_slots().size();
+  if (num_slots == 0) {
+    // If we are doing count(*) then we return tuples only containing partition keys.
+    num_tuples_materialized = WriteTemplateTuples(row, num_records);
+  } else {
+    // Need to copy out strings if they may reference the I/O buffers or
+    // 'boundary_record_'.
+    const bool copy_strings = !string_slot_offsets_.empty() &&
+        stream_->file_desc()->file_compression == THdfsCompression::NONE;
+    int max_added_tuples = (scan_node_->limit() == -1) ?
+        num_records :
+        scan_node_->limit() - scan_node_->rows_returned_shared();
+    num_tuples_materialized = WriteAlignedTuplesCodegenOrInterpret(
+        row_batch->tuple_data_pool(), row, field_locations_.data(), num_records,
+        max_added_tuples, num_slots, 0, copy_strings);
+    RETURN_IF_ERROR(parse_status_);
+    DCHECK_GE(num_tuples_materialized, 0);
+  }
+  return CommitRows(num_tuples_materialized, row_batch);
+}
@@ -0,0 +1,127 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <boost/scoped_ptr.hpp>
+
+#include "exec/hdfs-scanner.h"
+#include "runtime/string-buffer.h"
+#include "util/runtime-profile-counters.h"
+
+namespace impala {
+
+class JsonParser;
+struct HdfsFileDesc;
+
+/// HdfsScanner implementation that reads newline-delimited JSON files, i.e. files with
+/// one JSON object per line, as written by Hive's JsonSerDe. The values of the top-level
+/// fields of each object whose names match materialized columns are written into the
+/// slots of a tuple, with the same TextConverter and codegen'd WriteAlignedTuples() as
+/// the text scanner. Fields that are missing or null are NULL.
+///
+/// Uncompressed files are split like text files: a scan range skips the partial record
+/// at its start, unless it starts at offset 0, and reads past its end to finish the last
+/// record that starts in it. More precisely, a record belongs to the scan range that
+/// contains the byte before it. Compressed files are read and decompressed as a whole by
+/// the scanner of the first split.
+///
+/// Records that are not valid JSON objects are reported as row parse errors and skipped.
+/// Blank lines are skipped silently.
+class HdfsJsonScanner : public HdfsScanner {
+ public:
+  HdfsJsonScanner(HdfsScanNodeBase* scan_node, RuntimeState* state);
+  virtual ~HdfsJsonScanner();
+
+  /// Implementation of HdfsScanner interface.
+  virtual Status Open(ScannerContext* context) WARN_UNUSED_RESULT;
+  virtual void Close(RowBatch* row_batch);
+
+  /// Issue io manager byte ranges for 'files'.
+  static Status IssueInitialRanges(HdfsScanNodeBase* scan_node,
+      const std::vector<HdfsFileDesc*>& files) WARN_UNUSED_RESULT;
+
+  /// Codegen WriteAlignedTuples(). Stores the resulting function in
+  /// 'write_aligned_tuples_fn' if codegen was successful or nullptr otherwise.
+  static Status Codegen(HdfsScanPlanNode* node, FragmentState* state,
+      llvm::Function** write_aligned_tuples_fn);
+
+ protected:
+  virtual Status GetNextInternal(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+ private:
+  const static int NEXT_BLOCK_READ_SIZE = 64 * 1024; //bytes
+
+  virtual Status InitNewRange() WARN_UNUSED_RESULT;
+
+  /// Skips to the first record of the scan range. Sets 'found' to false if no record
+  /// starts in the scan range.
+  Status FindFirstRecord(bool* found) WARN_UNUSED_RESULT;
+
+  /// Reads the next buffer from 'stream_' into [buffer_ptr_, buffer_end_), reading past
+  /// the end of the scan range if needed. Sets 'eof' to true if there is no more data.
+  Status FillBuffer(bool* eof) WARN_UNUSED_RESULT;
+
+  /// Returns true if the next record does not belong to the scan range, i.e. starts
+  /// after the byte following the scan range.
+  bool PastScanRange();
+
+  /// Parses the complete records in the current buffer, at most as many as fit into
+  /// 'row_batch', and adds the ones that pass the conjuncts to it. A record that
+  /// continues in the next buffer is saved in 'boundary_record_'.
+  Status ProcessBuffer(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+  /// Parses 'record' into the next tuple's worth of 'field_locations_'. Sets 'added'
+  /// to false if the record is blank or not valid JSON, in which case the error is
+  /// logged.
+  Status ParseRecord(const char* record, int64_t len, MemPool* pool,
+      FieldLocation* fields, bool* added) WARN_UNUSED_RESULT;
+
+  /// Writes 'num_records' parsed records into tuples, evaluates the conjuncts and
+  /// commits the rows that pass them to 'row_batch'.
+  Status WriteRecords(int num_records, TupleRow* row, RowBatch* row_batch)
+      WARN_UNUSED_RESULT;
+
+  /// Helper class for extracting the fields of the materialized columns from records.
+  boost::scoped_ptr<JsonParser> json_parser_;
+
+  /// Current position in and end of the buffer returned by 'stream_'.
+  char* buffer_ptr_ = nullptr;
+  char* buffer_end_ = nullptr;
+
+  /// True once FindFirstRecord() found the first record of the scan range.
+  bool first_record_found_ = false;
+
+  /// True if the whole compressed file has been read.
+  bool compressed_file_read_ = false;
+
+  /// Mem pool for 'boundary_record_'. Does not hold any tuple data of returned batches,
+  /// because string data is always deep-copied into the output batch when reading
+  /// uncompressed files.
+  boost::scoped_ptr<MemPool> boundary_pool_;
+
+  /// The beginning of a record that straddles buffers.
+  StringBuffer boundary_record_;
+
+  /// Field locations of the records of the current batch, one tuple's worth per record.
+  std::vector<FieldLocation> field_locations_;
+
+  /// Time parsing JSON records.
+  RuntimeProfile::Counter* parse_json_timer_ = nullptr;
+};
+
+}
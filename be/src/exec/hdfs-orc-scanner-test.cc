@@ -0,0 +1,195 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-orc-scanner.h"
+
+#include <cstring>
+#include <orc/OrcFile.hh>
+
+#include "common/object-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.inline.h"
+#include "testutil/gtest-util.h"
+#include "util/min-max-filter.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+/// orc::OutputStream that writes to a string.
+class StringOutputStream : public orc::OutputStream {
+ public:
+  uint64_t getLength() const override { return data_.size(); }
+  uint64_t getNaturalWriteSize() const override { return 64 * 1024; }
+  void write(const void* buf, size_t length) override {
+    data_.append(static_cast<const char*>(buf), length);
+  }
+  const std::string& getName() const override { return name_; }
+  void close() override {}
+  const string& data() const { return data_; }
+
+ private:
+  string data_;
+  string name_ = "StringOutputStream";
+};
+
+/// orc::InputStream that reads from a string.
+class StringInputStream : public orc::InputStream {
+ public:
+  StringInputStream(const string& data) : data_(data) {}
+  uint64_t getLength() const override { return data_.size(); }
+  uint64_t getNaturalReadSize() const override { return 64 * 1024; }
+  void read(void* buf, uint64_t length, uint64_t offset) override {
+    ASSERT_LE(offset + length, data_.size());
+    memcpy(buf, data_.data() + offset, length);
+  }
+  const std::string& getName() const override { return name_; }
+
+ private:
+  const string data_;
+  string name_ = "StringInputStream";
+};
+
+class HdfsOrcScannerTest : public testing::Test {
+ protected:
+  virtual void TearDown() override {
+    for (MinMaxFilter* filter : filters_) filter->Close();
+  }
+
+  /// Writes an ORC file with a single column of type 'orc_type' and a single stripe
+  /// that contains 'int_values' or 'string_values', depending on the type. Returns the
+  /// reader of the file.
+  unique_ptr<orc::Reader> WriteSingleStripe(const string& orc_type,
+      const vector<int64_t>& int_values, const vector<string>& string_values) {
+    unique_ptr<orc::Type> schema =
+        orc::Type::buildTypeFromString("struct<col:" + orc_type + ">");
+    StringOutputStream output;
+    orc::WriterOptions options;
+    unique_ptr<orc::Writer> writer = orc::createWriter(*schema, &output, options);
+    int num_rows = max(int_values.size(), string_values.size());
+    unique_ptr<orc::ColumnVectorBatch> batch = writer->createRowBatch(num_rows);
+    orc::StructVectorBatch* root = static_cast<orc::StructVectorBatch*>(batch.get());
+    if (!int_values.empty()) {
+      auto col = static_cast<orc::LongVectorBatch*>(root->fields[0]);
+      for (int i = 0; i < num_rows; ++i) col->data[i] = int_values[i];
+      col->numElements = num_rows;
+    } else {
+      auto col = static_cast<orc::StringVectorBatch*>(root->fields[0]);
+      for (int i = 0; i < num_rows; ++i) {
+        col->data[i] = const_cast<char*>(string_values[i].data());
+        col->length[i] = string_values[i].size();
+      }
+      col->numElements = num_rows;
+    }
+    root->numElements = num_rows;
+    writer->add(*batch);
+    writer->close();
+    orc::ReaderOptions reader_options;
+    return orc::createReader(
+        unique_ptr<orc::InputStream>(new StringInputStream(output.data())),
+        reader_options);
+  }
+
+  /// Returns whether the statistics of the column of the first stripe of 'reader' let a
+  /// min-max filter of 'type' with the bounds 'min' and 'max' through.
+  template <typename T>
+  bool StripePassesFilter(
+      orc::Reader* reader, const ColumnType& type, const T& min, const T& max) {
+    // Min-max filters on CHAR and VARCHAR columns are STRING filters.
+    ColumnType filter_type = type.IsStringType() ? ColumnType(TYPE_STRING) : type;
+    MinMaxFilter* filter =
+        MinMaxFilter::Create(filter_type, &obj_pool_, &mem_tracker_);
+    filters_.push_back(filter);
+    filter->Insert(&min);
+    filter->Insert(&max);
+    filter->MaterializeValues();
+    unique_ptr<orc::StripeStatistics> stripe_stats = reader->getStripeStatistics(0);
+    // Column 0 is the root struct.
+    return HdfsOrcScanner::OrcStatsOverlapFilter(
+        *stripe_stats->getColumnStatistics(1), type, filter);
+  }
+
+  /// Same as above for string types.
+  bool StripePassesStringFilter(orc::Reader* reader, const ColumnType& type,
+      const string& min, const string& max) {
+    StringValue min_value(min);
+    StringValue max_value(max);
+    return StripePassesFilter(reader, type, min_value, max_value);
+  }
+
+  ObjectPool obj_pool_;
+  MemTracker mem_tracker_;
+  vector<MinMaxFilter*> filters_;
+};
+
+// Test that stripes are pruned by the statistics of INT columns.
+TEST_F(HdfsOrcScannerTest, IntStripeStats) {
+  unique_ptr<orc::Reader> reader = WriteSingleStripe("int", {10, 15, 20}, {});
+  ColumnType int_type(TYPE_INT);
+  EXPECT_TRUE(StripePassesFilter<int32_t>(reader.get(), int_type, 12, 13));
+  EXPECT_TRUE(StripePassesFilter<int32_t>(reader.get(), int_type, 20, 30));
+  EXPECT_TRUE(StripePassesFilter<int32_t>(reader.get(), int_type, 0, 10));
+  EXPECT_FALSE(StripePassesFilter<int32_t>(reader.get(), int_type, 21, 30));
+  EXPECT_FALSE(StripePassesFilter<int32_t>(reader.get(), int_type, -5, 9));
+
+  // Statistics that do not fit the table type are not used.
+  unique_ptr<orc::Reader> bigint_reader =
+      WriteSingleStripe("bigint", {1000, 2000}, {});
+  ColumnType tinyint_type(TYPE_TINYINT);
+  EXPECT_TRUE(StripePassesFilter<int8_t>(bigint_reader.get(), tinyint_type, 1, 2));
+}
+
+// Test that stripes are pruned by the statistics of STRING columns.
+TEST_F(HdfsOrcScannerTest, StringStripeStats) {
+  unique_ptr<orc::Reader> reader =
+      WriteSingleStripe("string", {}, {"banana", "apple", "cherry"});
+  ColumnType string_type(TYPE_STRING);
+  EXPECT_TRUE(StripePassesStringFilter(reader.get(), string_type, "b", "c"));
+  EXPECT_TRUE(StripePassesStringFilter(reader.get(), string_type, "cherry", "d"));
+  EXPECT_FALSE(StripePassesStringFilter(reader.get(), string_type, "cherryx", "d"));
+  EXPECT_FALSE(StripePassesStringFilter(reader.get(), string_type, "a", "appla"));
+  // STRING values are not truncated, so a prefix of the minimum does not match.
+  EXPECT_FALSE(StripePassesStringFilter(reader.get(), string_type, "app", "app"));
+}
+
+// Test that the statistics of VARCHAR columns are truncated like the values read from
+// the column before they are compared to filters.
+TEST_F(HdfsOrcScannerTest, VarcharStripeStats) {
+  unique_ptr<orc::Reader> reader =
+      WriteSingleStripe("varchar(10)", {}, {"abcdef", "abzzzz", "abmmmm"});
+  // The table declares a shorter length than the file, so the values read from the
+  // file are "abc", "abz" and "abm".
+  ColumnType varchar_type = ColumnType::CreateVarcharType(3);
+  EXPECT_TRUE(StripePassesStringFilter(reader.get(), varchar_type, "abc", "abc"));
+  EXPECT_TRUE(StripePassesStringFilter(reader.get(), varchar_type, "abz", "abz"));
+  EXPECT_TRUE(StripePassesStringFilter(reader.get(), varchar_type, "abm", "abm"));
+  EXPECT_FALSE(StripePassesStringFilter(reader.get(), varchar_type, "aa", "abb"));
+  EXPECT_FALSE(StripePassesStringFilter(reader.get(), varchar_type, "ac", "b"));
+
+  // Values that are not truncated are compared as is.
+  ColumnType long_varchar_type = ColumnType::CreateVarcharType(10);
+  EXPECT_FALSE(
+      StripePassesStringFilter(reader.get(), long_varchar_type, "abc", "abc"));
+  EXPECT_TRUE(
+      StripePassesStringFilter(reader.get(), long_varchar_type, "abcdef", "abcdef"));
+
+  // CHAR statistics are not used, as ORC stores CHAR values without padding.
+  ColumnType char_type = ColumnType::CreateCharType(3);
+  EXPECT_TRUE(StripePassesStringFilter(reader.get(), char_type, "aa", "abb"));
+}
+
+}
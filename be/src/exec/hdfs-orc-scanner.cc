@@ -17,14 +17,18 @@
 
 #include "exec/hdfs-orc-scanner.h"
 
+#include <cmath>
+#include <limits>
 #include <queue>
 
 #include "exec/exec-node.inline.h"
 #include "exec/orc-column-readers.h"
+#include "exec/orc-native-readers.h"
 #include "exec/scanner-context.inline.h"
 #include "exec/scratch-tuple-batch.h"
 #include "exprs/expr.h"
 #include "runtime/collection-value-builder.h"
+#include "runtime/date-value.h"
 #include "runtime/exec-env.h"
 #include "runtime/io/request-context.h"
 #include "runtime/mem-tracker.h"
@@ -32,6 +36,7 @@
 #include "runtime/timestamp-value.inline.h"
 #include "runtime/tuple-row.h"
 #include "util/decompress.h"
+#include "util/min-max-filter.h"
 
 #include "common/names.h"
 
@@ -40,6 +45,10 @@ using namespace impala::io;
 
 DEFINE_bool(enable_orc_scanner, true,
     "If false, reading from ORC format tables is not supported");
+DEFINE_bool(enable_orc_native_decoding, false, "(Experimental) If true, the ORC scanner "
+    "decodes the stripes of flat scans of integer, floating point and string columns "
+    "directly from their streams instead of with the ORC library, if it supports the "
+    "encodings.");
 
 Status HdfsOrcScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
     const vector<HdfsFileDesc*>& files) {
@@ -106,32 +115,35 @@ void HdfsOrcScanner::OrcMemPool::free(char* p) {
 // TODO: improve this to use async IO (IMPALA-6636).
 void HdfsOrcScanner::ScanRangeInputStream::read(void* buf, uint64_t length,
     uint64_t offset) {
-  const ScanRange* metadata_range = scanner_->metadata_range_;
+  Status status =
+      scanner_->ReadFileBytes(reinterpret_cast<uint8_t*>(buf), length, offset);
+  if (!status.ok()) throw ResourceError(status);
+}
+
+Status HdfsOrcScanner::ReadFileBytes(uint8_t* buf, int64_t length, int64_t offset) {
   const ScanRange* split_range =
-      reinterpret_cast<ScanRangeMetadata*>(metadata_range->meta_data())->original_split;
-  int64_t partition_id = scanner_->context_->partition_descriptor()->id();
+      reinterpret_cast<ScanRangeMetadata*>(metadata_range_->meta_data())->original_split;
+  int64_t partition_id = context_->partition_descriptor()->id();
 
   // Set expected_local to false to avoid cache on stale data (IMPALA-6830)
   bool expected_local = false;
   int cache_options = split_range->cache_options() & ~BufferOpts::USE_HDFS_CACHE;
-  ScanRange* range = scanner_->scan_node_->AllocateScanRange(
-      metadata_range->fs(), scanner_->filename(), length, offset, partition_id,
+  ScanRange* range = scan_node_->AllocateScanRange(
+      metadata_range_->fs(), filename(), length, offset, partition_id,
       split_range->disk_id(), expected_local, split_range->mtime(),
-      BufferOpts::ReadInto(reinterpret_cast<uint8_t*>(buf), length, cache_options));
+      BufferOpts::ReadInto(buf, length, cache_options));
 
   unique_ptr<BufferDescriptor> io_buffer;
   Status status;
   {
-    SCOPED_TIMER2(scanner_->state_->total_storage_wait_timer(),
-        scanner_->scan_node_->scanner_io_wait_time());
+    SCOPED_TIMER2(state_->total_storage_wait_timer(), scan_node_->scanner_io_wait_time());
     bool needs_buffers;
-    status =
-        scanner_->scan_node_->reader_context()->StartScanRange(range, &needs_buffers);
+    status = scan_node_->reader_context()->StartScanRange(range, &needs_buffers);
     DCHECK(!status.ok() || !needs_buffers) << "Already provided a buffer";
     if (status.ok()) status = range->GetNext(&io_buffer);
   }
   if (io_buffer != nullptr) range->ReturnBuffer(move(io_buffer));
-  if (!status.ok()) throw ResourceError(status);
+  return status;
 }
 
 HdfsOrcScanner::HdfsOrcScanner(HdfsScanNodeBase* scan_node, RuntimeState* state)
@@ -152,6 +164,10 @@ Status HdfsOrcScanner::Open(ScannerContext* context) {
       ADD_COUNTER(scan_node_->runtime_profile(), "NumOrcColumns", TUnit::UNIT);
   num_stripes_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumOrcStripes", TUnit::UNIT);
+  num_stripes_skipped_by_filters_counter_ = ADD_COUNTER(scan_node_->runtime_profile(),
+      "NumOrcStripesSkippedByRuntimeFilters", TUnit::UNIT);
+  num_native_stripes_counter_ = ADD_COUNTER(scan_node_->runtime_profile(),
+      "NumOrcStripesDecodedNatively", TUnit::UNIT);
   num_scanners_with_no_reads_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumScannersWithNoReads", TUnit::UNIT);
   process_footer_timer_stats_ =
@@ -235,6 +251,7 @@ Status HdfsOrcScanner::Open(ScannerContext* context) {
   // Update 'row_reader_options_' based on the tuple descriptor so the ORC lib can skip
   // columns we don't need.
   RETURN_IF_ERROR(SelectColumns(*scan_node_->tuple_desc()));
+  ResolveStatsFilterTargets();
   // By enabling lazy decoding, String stripes with DICTIONARY_ENCODING[_V2] can be
   // stored in an EncodedStringVectorBatch, where the data is stored in a dictionary
   // blob more efficiently.
@@ -267,11 +284,54 @@ Status HdfsOrcScanner::Open(ScannerContext* context) {
 
   // Set top-level template tuple.
   template_tuple_ = template_tuple_map_[scan_node_->tuple_desc()];
-  return Status::OK();
+  return InitNativeStripeReader();
+}
+
+Status HdfsOrcScanner::InitNativeStripeReader() {
+  if (!FLAGS_enable_orc_native_decoding) return Status::OK();
+  // The native readers produce the rows of the top-level tuple only. Rows that need
+  // ACID validation or a synthetic row id are left to the ORC library.
+  const TupleDescriptor* tuple_desc = scan_node_->tuple_desc();
+  if (!tuple_desc->collection_slots().empty() || row_batches_need_validation_
+      || acid_synthetic_rowid_ != nullptr) {
+    return Status::OK();
+  }
+  if (!OrcNativeStripeReader::SupportsCompression(reader_->getCompression())) {
+    return Status::OK();
+  }
+  // The native readers decode whole stripes. Stripes are still skipped by the runtime
+  // filters in NextStripe(), but the row groups that a SearchArgument rules out by the
+  // row index are only skipped by the ORC library, so such scans are left to it.
+  if (row_reader_options_.getSearchArgument() != nullptr) return Status::OK();
+  const orc::Type& root_type = reader_->getType();
+  vector<OrcNativeColumnReader*> readers;
+  for (const SlotDescriptor* slot_desc : tuple_desc->slots()) {
+    if (IsPartitionKeySlot(slot_desc) || IsMissingField(slot_desc)) continue;
+    auto it = slot_to_col_id_.find(slot_desc);
+    if (it == slot_to_col_id_.end()) return Status::OK();
+    // Only direct children of the root, i.e. not the fields of structs or of the row of
+    // ACID files, are supported.
+    const orc::Type* node = nullptr;
+    for (uint64_t i = 0; i < root_type.getSubtypeCount(); ++i) {
+      if (root_type.getSubtype(i)->getColumnId() == it->second) {
+        node = root_type.getSubtype(i);
+      }
+    }
+    if (node == nullptr) return Status::OK();
+    OrcNativeColumnReader* reader = OrcNativeColumnReader::Create(*node, slot_desc, this);
+    if (reader == nullptr) return Status::OK();
+    readers.push_back(reader);
+  }
+  if (readers.empty()) return Status::OK();
+  native_stripe_reader_.reset(
+      new OrcNativeStripeReader(this, move(readers), dictionary_pool_.get()));
+  return native_stripe_reader_->Open(
+      reader_->getCompression(), reader_->getCompressionSize());
 }
 
 void HdfsOrcScanner::Close(RowBatch* row_batch) {
   DCHECK(!is_closed_);
+  if (native_stripe_reader_ != nullptr) native_stripe_reader_->Close();
   if (row_batch != nullptr) {
     context_->ReleaseCompletedResources(true);
     row_batch->tuple_data_pool()->AcquireData(template_tuple_pool_.get(), false);
@@ -619,7 +679,8 @@ Status HdfsOrcScanner::GetNextInternal(RowBatch* row_batch) {
   // to can be skip. 'end_of_stripe_' marks whether current stripe is drained. It's only
   // set to true in 'AssembleRows'.
   while (advance_stripe_ || end_of_stripe_) {
-    // The next stripe will use a new dictionary blob so transfer the memory to row_batch.
+    // The next stripe will use a new dictionary blob and stream data so transfer the
+    // memory to row_batch.
     row_batch->tuple_data_pool()->AcquireData(dictionary_pool_.get(), false);
     context_->ReleaseCompletedResources(/* done */ true);
     // Commit the rows to flush the row batch from the previous stripe.
@@ -711,13 +772,34 @@ Status HdfsOrcScanner::NextStripe() {
       continue;
     }
 
-    // TODO: check if this stripe can be skipped by stats. e.g. IMPALA-6505 In that case,
-    // set the file row index in 'orc_root_reader_' accordingly.
-    if (first_invocation && acid_synthetic_rowid_ != nullptr) {
-      orc_root_reader_->SetFileRowIndex(skipped_rows);
+    if (!StripePassesStatsFilters(stripe_idx_)) {
+      COUNTER_ADD(num_stripes_skipped_by_filters_counter_, 1);
+      skipped_rows += stripe->getNumberOfRows();
+      continue;
+    }
+
+    if (acid_synthetic_rowid_ != nullptr) {
+      // The file row index continues from the end of the previous stripe read by this
+      // scanner, or starts at the first row of the file, plus the skipped rows.
+      orc_root_reader_->SetFileRowIndex(
+          (first_invocation ? 0 : orc_root_reader_->file_row_idx()) + skipped_rows);
     }
 
     COUNTER_ADD(num_stripes_counter_, 1);
+    native_stripe_ = false;
+    if (native_stripe_reader_ != nullptr) {
+      parse_status_ = native_stripe_reader_->StartStripe(*stripe, &native_stripe_);
+      if (!parse_status_.ok()) return parse_status_;
+    }
+    if (native_stripe_) {
+      COUNTER_ADD(num_native_stripes_counter_, 1);
+      // The ORC library does not read this stripe.
+      row_reader_.reset();
+      RETURN_IF_ERROR(orc_root_reader_->UpdateInputBatch(nullptr));
+      orc_root_batch_.reset();
+      end_of_stripe_ = false;
+      break;
+    }
     row_reader_options_.range(stripe->getOffset(), stripe_len);
     try {
       row_reader_ = reader_->createRowReader(row_reader_options_);
@@ -740,7 +822,189 @@ Status HdfsOrcScanner::NextStripe() {
   return Status::OK();
 }
 
+/// Number of milliseconds that ORC timestamp statistics are widened by on both ends.
+/// The statistics are in UTC, but may have been adjusted to the writer's time zone, and
+/// are truncated to milliseconds. Widening them by a day covers any time zone offset.
+static const int64_t ORC_TIMESTAMP_STATS_SLACK_MS = 24LL * 60 * 60 * 1000;
+
+/// Returns true if the integer statistics 'stats' may overlap with 'filter', or if
+/// they are not usable for a column of 'type'.
+template <typename T>
+static bool IntegerStatsOverlap(const orc::ColumnStatistics& stats,
+    const ColumnType& type, MinMaxFilter* filter) {
+  auto int_stats = dynamic_cast<const orc::IntegerColumnStatistics*>(&stats);
+  if (int_stats == nullptr || !int_stats->hasMinimum() || !int_stats->hasMaximum()) {
+    return true;
+  }
+  int64_t min = int_stats->getMinimum();
+  int64_t max = int_stats->getMaximum();
+  // Out of range values indicate that the file type differs from the table type.
+  if (min < std::numeric_limits<T>::min() || max > std::numeric_limits<T>::max()) {
+    return true;
+  }
+  T data_min = static_cast<T>(min);
+  T data_max = static_cast<T>(max);
+  return filter->EvalOverlap(type, &data_min, &data_max);
+}
+
+/// Returns true if the floating point statistics 'stats' may overlap with 'filter', or
+/// if they are not usable.
+template <typename T>
+static bool DoubleStatsOverlap(const orc::ColumnStatistics& stats,
+    const ColumnType& type, MinMaxFilter* filter) {
+  auto double_stats = dynamic_cast<const orc::DoubleColumnStatistics*>(&stats);
+  if (double_stats == nullptr || !double_stats->hasMinimum()
+      || !double_stats->hasMaximum()) {
+    return true;
+  }
+  double min = double_stats->getMinimum();
+  double max = double_stats->getMaximum();
+  if (std::isnan(min) || std::isnan(max)) return true;
+  T data_min = static_cast<T>(min);
+  T data_max = static_cast<T>(max);
+  return filter->EvalOverlap(type, &data_min, &data_max);
+}
+
+bool HdfsOrcScanner::OrcStatsOverlapFilter(const orc::ColumnStatistics& stats,
+    const ColumnType& type, MinMaxFilter* filter) {
+  switch (type.type) {
+    case TYPE_TINYINT: return IntegerStatsOverlap<int8_t>(stats, type, filter);
+    case TYPE_SMALLINT: return IntegerStatsOverlap<int16_t>(stats, type, filter);
+    case TYPE_INT: return IntegerStatsOverlap<int32_t>(stats, type, filter);
+    case TYPE_BIGINT: return IntegerStatsOverlap<int64_t>(stats, type, filter);
+    case TYPE_FLOAT: return DoubleStatsOverlap<float>(stats, type, filter);
+    case TYPE_DOUBLE: return DoubleStatsOverlap<double>(stats, type, filter);
+    case TYPE_STRING:
+    case TYPE_VARCHAR: {
+      // CHAR is not supported because ORC stores the values without padding.
+      auto string_stats = dynamic_cast<const orc::StringColumnStatistics*>(&stats);
+      if (string_stats == nullptr || !string_stats->hasMinimum()
+          || !string_stats->hasMaximum()) {
+        return true;
+      }
+      // The strings are owned by 'stats', which outlives the filter evaluation.
+      const string& min = string_stats->getMinimum();
+      const string& max = string_stats->getMaximum();
+      int min_len = min.size();
+      int max_len = max.size();
+      if (type.type == TYPE_VARCHAR) {
+        // VARCHAR values are truncated to the declared length when they are read, see
+        // OrcStringColumnReader. Truncation preserves the order of the values, so the
+        // truncated statistics bound the truncated values.
+        min_len = std::min(min_len, type.len);
+        max_len = std::min(max_len, type.len);
+      }
+      StringValue data_min(const_cast<char*>(min.data()), min_len);
+      StringValue data_max(const_cast<char*>(max.data()), max_len);
+      return filter->EvalOverlap(type, &data_min, &data_max);
+    }
+    case TYPE_DATE: {
+      auto date_stats = dynamic_cast<const orc::DateColumnStatistics*>(&stats);
+      if (date_stats == nullptr || !date_stats->hasMinimum()
+          || !date_stats->hasMaximum()) {
+        return true;
+      }
+      DateValue data_min(date_stats->getMinimum());
+      DateValue data_max(date_stats->getMaximum());
+      if (!data_min.IsValid() || !data_max.IsValid()) return true;
+      return filter->EvalOverlap(type, &data_min, &data_max);
+    }
+    case TYPE_TIMESTAMP: {
+      auto ts_stats = dynamic_cast<const orc::TimestampColumnStatistics*>(&stats);
+      if (ts_stats == nullptr || !ts_stats->hasMinimum() || !ts_stats->hasMaximum()) {
+        return true;
+      }
+      TimestampValue data_min = TimestampValue::UtcFromUnixTimeMillis(
+          ts_stats->getMinimum() - ORC_TIMESTAMP_STATS_SLACK_MS);
+      TimestampValue data_max = TimestampValue::UtcFromUnixTimeMillis(
+          ts_stats->getMaximum() + ORC_TIMESTAMP_STATS_SLACK_MS);
+      if (!data_min.HasDateAndTime() || !data_max.HasDateAndTime()) return true;
+      return filter->EvalOverlap(type, &data_min, &data_max);
+    }
+    default:
+      return true;
+  }
+}
+
+void HdfsOrcScanner::ResolveStatsFilterTargets() {
+  stats_filter_targets_.clear();
+  if (!state_->query_options().orc_read_statistics) return;
+  const TupleDescriptor* tuple_desc = scan_node_->tuple_desc();
+  for (int i = 0; i < filter_ctxs_.size(); ++i) {
+    const RuntimeFilter* filter = filter_ctxs_[i]->filter;
+    if (!filter->is_min_max_filter()) continue;
+    const TRuntimeFilterDesc& filter_desc = filter->filter_desc();
+    auto it = filter_desc.planid_to_target_ndx.find(scan_node_->id());
+    DCHECK(it != filter_desc.planid_to_target_ndx.end());
+    const TRuntimeFilterTargetDesc& target = filter_desc.targets[it->second];
+    // Only filters that are applied directly to a column can be evaluated against the
+    // column's statistics.
+    const vector<TExprNode>& nodes = target.target_expr.nodes;
+    if (nodes.size() != 1 || nodes[0].node_type != TExprNodeType::SLOT_REF) continue;
+    const SlotDescriptor* slot_desc = nullptr;
+    for (const SlotDescriptor* slot : tuple_desc->slots()) {
+      if (slot->id() == nodes[0].slot_ref.slot_id) slot_desc = slot;
+    }
+    if (slot_desc == nullptr || slot_desc->type().IsComplexType()
+        || IsPartitionKeySlot(slot_desc)) {
+      continue;
+    }
+    const orc::Type* node = nullptr;
+    bool pos_field;
+    bool missing_field;
+    Status status = schema_resolver_->ResolveColumn(
+        slot_desc->col_path(), &node, &pos_field, &missing_field);
+    if (!status.ok() || pos_field || missing_field) continue;
+    stats_filter_targets_.push_back({i, slot_desc, node->getColumnId()});
+  }
+}
+
+bool HdfsOrcScanner::StripePassesStatsFilters(int stripe_idx) {
+  if (stats_filter_targets_.empty()) return true;
+  unique_ptr<orc::StripeStatistics> stripe_stats;
+  for (const StatsFilterTarget& target : stats_filter_targets_) {
+    const FilterContext* ctx = filter_ctxs_[target.filter_idx];
+    MinMaxFilter* minmax_filter = ctx->filter->get_min_max();
+    if (minmax_filter == nullptr || minmax_filter->AlwaysTrue()) {
+      // The filter has not arrived yet or cannot reject anything.
+      ctx->stats->IncrCounters(FilterStats::ROW_GROUPS_KEY, 1, 0, 0);
+      continue;
+    }
+    bool passes = !minmax_filter->AlwaysFalse();
+    if (passes) {
+      if (stripe_stats == nullptr) {
+        try {
+          stripe_stats = reader_->getStripeStatistics(stripe_idx);
+        } catch (std::exception& e) {
+          // The statistics are only used to skip data, so the stripe is read as usual.
+          VLOG_QUERY << "Error in reading statistics of stripe " << stripe_idx
+                     << " in ORC file " << filename() << ": " << e.what();
+          return true;
+        }
+      }
+      if (target.orc_column_id >= stripe_stats->getNumberOfColumns()) {
+        ctx->stats->IncrCounters(FilterStats::ROW_GROUPS_KEY, 1, 0, 0);
+        continue;
+      }
+      const orc::ColumnStatistics* col_stats =
+          stripe_stats->getColumnStatistics(target.orc_column_id);
+      // Min-max filters let NULLs through, see RuntimeFilter::Eval().
+      passes = col_stats->hasNull()
+          || OrcStatsOverlapFilter(*col_stats, target.slot_desc->type(), minmax_filter);
+    }
+    ctx->stats->IncrCounters(FilterStats::ROW_GROUPS_KEY, 1, 1, passes ? 0 : 1);
+    if (!passes) {
+      VLOG(3) << "Skipping stripe " << stripe_idx << " of ORC file " << filename()
+              << " by runtime filter " << ctx->filter->id() << ": "
+              << minmax_filter->DebugString();
+      return false;
+    }
+  }
+  return true;
+}
+
 Status HdfsOrcScanner::AssembleRows(RowBatch* row_batch) {
+  if (native_stripe_) return AssembleRowsNative(row_batch);
   bool continue_execution = !scan_node_->ReachedLimitShared() && !context_->cancelled();
   if (!continue_execution) return Status::CancelledInternal("ORC scanner");
 
@@ -787,6 +1051,29 @@ Status HdfsOrcScanner::AssembleRows(RowBatch* row_batch) {
   return Status::OK();
 }
 
+Status HdfsOrcScanner::AssembleRowsNative(RowBatch* row_batch) {
+  bool continue_execution = !scan_node_->ReachedLimitShared() && !context_->cancelled();
+  if (!continue_execution) return Status::CancelledInternal("ORC scanner");
+  if (tuple_ == nullptr) RETURN_IF_ERROR(AllocateTupleMem(row_batch));
+
+  int64_t num_rows_read = 0;
+  while (continue_execution && native_stripe_reader_->rows_remaining() > 0) {
+    DCHECK(scratch_batch_->AtEnd());
+    RETURN_IF_ERROR(scratch_batch_->Reset(state_));
+    InitTupleBuffer(template_tuple_, scratch_batch_->tuple_mem, scratch_batch_->capacity);
+    RETURN_IF_ERROR(native_stripe_reader_->ReadBatch(scratch_batch_.get()));
+    num_rows_read += scratch_batch_->num_tuples;
+    int num_tuples_transferred = TransferScratchTuples(row_batch);
+    RETURN_IF_ERROR(CommitRows(num_tuples_transferred, row_batch));
+    if (row_batch->AtCapacity()) break;
+    continue_execution &= !scan_node_->ReachedLimitShared() && !context_->cancelled();
+  }
+  end_of_stripe_ = native_stripe_reader_->rows_remaining() == 0;
+  stripe_rows_read_ += num_rows_read;
+  COUNTER_ADD(scan_node_->rows_read_counter(), num_rows_read);
+  return Status::OK();
+}
+
 Status HdfsOrcScanner::TransferTuples(RowBatch* dst_batch) {
   DCHECK_LT(dst_batch->num_rows(), dst_batch->capacity());
   if (tuple_ == nullptr) RETURN_IF_ERROR(AllocateTupleMem(dst_batch));
@@ -37,6 +37,8 @@ namespace impala {
 struct HdfsFileDesc;
 class OrcStructReader;
 class OrcComplexColumnReader;
+class OrcNativeStripeReader;
+class MinMaxFilter;
 
 /// This scanner leverage the ORC library to parse ORC files located in HDFS. Data is
 /// transformed into Impala in-memory representation (i.e. Tuples, RowBatches) by
@@ -57,6 +59,17 @@ class OrcComplexColumnReader;
 ///     the range of the Stripe boundaries. Then create a orc::RowReader for this Stripe
 ///     (HdfsOrcScanner::NextStripe)
 ///
+/// Stripes can be skipped without decoding any of their data if the stripe statistics
+/// show that none of their rows can pass an arrived runtime min-max filter. The
+/// filters that are applicable, i.e. that target a top-level column of the file
+/// directly, are resolved to ORC column ids in 'stats_filter_targets_'.
+///
+/// If --enable_orc_native_decoding is true, flat scans of integer, floating point and
+/// string columns bypass the ORC library for the stripes whose column encodings
+/// OrcNativeStripeReader supports: it reads the streams of the stripe and decodes them
+/// directly into the scratch batch, see AssembleRowsNative(). Other stripes of the same
+/// file still go through the library.
+///
 class HdfsOrcScanner : public HdfsColumnarScanner {
  public:
   /// Exception throws from the orc scanner to stop the orc::RowReader. It's used in
@@ -145,6 +158,8 @@ class HdfsOrcScanner : public HdfsColumnarScanner {
   friend class OrcStructReader;
   friend class OrcListReader;
   friend class OrcMapReader;
+  friend class OrcNativeColumnReader;
+  friend class OrcNativeStripeReader;
   friend class HdfsOrcScannerTest;
 
   /// Memory guard of the tuple_mem_
@@ -171,7 +186,8 @@ class HdfsOrcScanner : public HdfsColumnarScanner {
   /// Mem pool used in orc readers.
   boost::scoped_ptr<OrcMemPool> reader_mem_pool_;
 
-  /// Pool to copy dictionary buffer into.
+  /// Pool to copy dictionary buffer into, and for the stream data that the slots point
+  /// to in stripes that 'native_stripe_reader_' decodes.
   /// This pool is shared across all the batches in a stripe.
   boost::scoped_ptr<MemPool> dictionary_pool_;
   /// Pool to copy non-dictionary buffer into. This pool is responsible for handling
@@ -180,6 +196,20 @@ class HdfsOrcScanner : public HdfsColumnarScanner {
 
   std::unique_ptr<OrcSchemaResolver> schema_resolver_ = nullptr;
 
+  /// A runtime min-max filter that can be evaluated against ORC column statistics.
+  struct StatsFilterTarget {
+    /// Index of the filter in 'filter_ctxs_' and 'filter_stats_'.
+    int filter_idx;
+    /// The slot that the filter is applied to.
+    const SlotDescriptor* slot_desc;
+    /// Id of the ORC column that the slot is materialized from.
+    uint64_t orc_column_id;
+  };
+
+  /// Runtime min-max filters that can be used to skip stripes. Populated in Open() if
+  /// the ORC_READ_STATISTICS query option is set.
+  std::vector<StatsFilterTarget> stats_filter_targets_;
+
   /// orc::Reader's responsibility is to read the footer and metadata from an ORC file.
   /// It creates orc::RowReader for further materialization. orc::RowReader is used for
   /// reading rows from the file.
@@ -195,6 +225,15 @@ class HdfsOrcScanner : public HdfsColumnarScanner {
   /// in 'AssembleRows'
   std::unique_ptr<orc::ColumnVectorBatch> orc_root_batch_;
 
+  /// Decodes the stripes of flat scans whose columns it supports directly into the
+  /// scratch batch, instead of 'row_reader_' and 'orc_root_reader_'. Null if the scan or
+  /// the file is not supported, if the scan has a SearchArgument, or if
+  /// --enable_orc_native_decoding is false, which is the default.
+  std::unique_ptr<OrcNativeStripeReader> native_stripe_reader_;
+
+  /// True if the current stripe is decoded by 'native_stripe_reader_'.
+  bool native_stripe_ = false;
+
   /// The root column reader to transfer orc values into impala RowBatch. The root of
   /// the ORC file schema is always in STRUCT type so we use OrcStructReader here.
   /// Instead of using std::unique_ptr, this object is tracked in 'obj_pool_' to be
@@ -248,6 +287,13 @@ class HdfsOrcScanner : public HdfsColumnarScanner {
   /// Number of stripes that need to be read.
   RuntimeProfile::Counter* num_stripes_counter_ = nullptr;
 
+  /// Number of stripes skipped because their statistics showed that none of their rows
+  /// can pass a runtime min-max filter.
+  RuntimeProfile::Counter* num_stripes_skipped_by_filters_counter_ = nullptr;
+
+  /// Number of stripes that were decoded by 'native_stripe_reader_'.
+  RuntimeProfile::Counter* num_native_stripes_counter_ = nullptr;
+
   /// Number of scanners that end up doing no reads because their splits don't overlap
   /// with the midpoint of any stripe in the file.
   RuntimeProfile::Counter* num_scanners_with_no_reads_counter_ = nullptr;
@@ -266,11 +312,37 @@ class HdfsOrcScanner : public HdfsColumnarScanner {
   /// row_reader_ to scan it.
   Status NextStripe() WARN_UNUSED_RESULT;
 
+  /// Populates 'stats_filter_targets_' with the runtime min-max filters of the scan that
+  /// target columns of this file. Must be called after 'schema_resolver_' is created.
+  void ResolveStatsFilterTargets();
+
+  /// Evaluates the arrived filters in 'stats_filter_targets_' against the statistics of
+  /// the 'stripe_idx'-th stripe. Returns false if the stripe cannot contain any row that
+  /// passes the filters, i.e. if it can be skipped. Updates the filter stats.
+  bool StripePassesStatsFilters(int stripe_idx);
+
+  /// Returns true if the ORC column statistics 'stats' of a column of 'type' show that
+  /// the column may contain values that pass 'filter'. Returns true for types whose
+  /// statistics are not supported.
+  static bool OrcStatsOverlapFilter(const orc::ColumnStatistics& stats,
+      const ColumnType& type, MinMaxFilter* filter);
+
   /// Reads data to materialize instances of 'tuple_desc'.
   /// Returns a non-OK status if a non-recoverable error was encountered and execution
   /// of this query should be terminated immediately.
   Status AssembleRows(RowBatch* row_batch) WARN_UNUSED_RESULT;
 
+  /// Implementation of AssembleRows() for stripes that are decoded by
+  /// 'native_stripe_reader_'.
+  Status AssembleRowsNative(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+  /// Creates 'native_stripe_reader_' if all of the materialized slots are top-level
+  /// columns of the file that it can decode. Called at the end of Open().
+  Status InitNativeStripeReader() WARN_UNUSED_RESULT;
+
+  /// Reads 'length' bytes of the file starting at 'offset' into 'buf'.
+  Status ReadFileBytes(uint8_t* buf, int64_t length, int64_t offset) WARN_UNUSED_RESULT;
+
   /// Materialize collection(list/map) tuples belong to the 'row_idx'-th row of
   /// coll_reader's ORC batch. Each column reader will hold an ORC batch until its values
   /// are drained.
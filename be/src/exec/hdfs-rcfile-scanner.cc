@@ -108,6 +108,8 @@ Status HdfsRCFileScanner::InitNewRange() {
       columns_[i].materialize_column = false;
     }
   }
+  next_columns_ = columns_;
+  RETURN_IF_ERROR(StartAsyncDecompression());
 
   // TODO: Initialize codegen fn here
   return Status::OK();
@@ -242,6 +244,45 @@ BaseSequenceScanner::FileHeader* HdfsRCFileScanner::AllocateFileHeader() {
 Status HdfsRCFileScanner::StartRowGroup() {
   num_rows_ = 0;
   row_pos_ = 0;
+  if (async_decompressor_ != nullptr) return StartPipelinedRowGroup();
+  while (num_rows_ == 0) RETURN_IF_ERROR(ReadRowGroup());
+  return Status::OK();
+}
+
+Status HdfsRCFileScanner::StartPipelinedRowGroup() {
+  // Row groups without rows are skipped, like in StartRowGroup().
+  while (num_rows_ == 0) {
+    vector<AsyncBlockDecompressor::Output> outputs;
+    RETURN_IF_ERROR(NextBlockReadAhead(&outputs));
+    if (eos_) return Status::OK();
+    data_buffer_pool_->AcquireData(read_ahead_pool_.get(), false);
+    SwapRowGroups();
+    // Decompress the next row group while this one is parsed.
+    ReadAhead();
+  }
+  return Status::OK();
+}
+
+Status HdfsRCFileScanner::ReadBlockAhead() {
+  // Read the row group into the state of the next row group.
+  SwapRowGroups();
+  Status status = ReadRowGroup();
+  SwapRowGroups();
+  RETURN_IF_ERROR(status);
+  async_decompressor_->StartBatch();
+  return ReadRowGroupSync();
+}
+
+void HdfsRCFileScanner::SwapRowGroups() {
+  swap(columns_, next_columns_);
+  swap(key_buffer_, next_key_buffer_);
+  swap(num_rows_, next_num_rows_);
+  swap(row_group_buffer_, next_row_group_buffer_);
+  swap(row_group_length_, next_row_group_length_);
+  swap(row_group_buffer_size_, next_row_group_buffer_size_);
+}
+
+Status HdfsRCFileScanner::ReadRowGroup() {
   key_length_ = 0;
   compressed_key_length_ = 0;
 
@@ -255,26 +296,27 @@ Status HdfsRCFileScanner::StartRowGroup() {
     columns_[i].current_field_len_rep = 0;
   }
 
-  while (num_rows_ == 0) {
-    RETURN_IF_ERROR(ReadRowGroupHeader());
-    RETURN_IF_ERROR(ReadKeyBuffers());
-    if (!reuse_row_group_buffer_ || row_group_buffer_size_ < row_group_length_) {
-      // Allocate a new buffer for reading the row group.  Row groups have a
-      // fixed number of rows so take a guess at how big it will be based on
-      // the previous row group size.
-      // The row group length depends on the user data and can be very big. This
-      // can cause us to go way over the mem limit so use TryAllocate instead.
-      row_group_buffer_ = data_buffer_pool_->TryAllocate(row_group_length_);
-      if (UNLIKELY(row_group_buffer_ == nullptr)) {
-        string details("RC file scanner failed to allocate row group buffer.");
-        return scan_node_->mem_tracker()->MemLimitExceeded(state_, details,
-            row_group_length_);
-      }
-      row_group_buffer_size_ = row_group_length_;
+  RETURN_IF_ERROR(ReadRowGroupHeader());
+  RETURN_IF_ERROR(ReadKeyBuffers());
+  if (!reuse_row_group_buffer_ || row_group_buffer_size_ < row_group_length_) {
+    // Allocate a new buffer for reading the row group.  Row groups have a
+    // fixed number of rows so take a guess at how big it will be based on
+    // the previous row group size.
+    // The row group length depends on the user data and can be very big. This
+    // can cause us to go way over the mem limit so use TryAllocate instead.
+    // Row groups that are read ahead use their own pool, so that their buffer is not
+    // attached to a row batch together with the buffer of the current row group.
+    MemPool* pool = async_decompressor_ != nullptr ?
+        read_ahead_pool_.get() : data_buffer_pool_.get();
+    row_group_buffer_ = pool->TryAllocate(row_group_length_);
+    if (UNLIKELY(row_group_buffer_ == nullptr)) {
+      string details("RC file scanner failed to allocate row group buffer.");
+      return scan_node_->mem_tracker()->MemLimitExceeded(state_, details,
+          row_group_length_);
     }
-    RETURN_IF_ERROR(ReadColumnBuffers());
+    row_group_buffer_size_ = row_group_length_;
   }
-  return Status::OK();
+  return ReadColumnBuffers();
 }
 
 Status HdfsRCFileScanner::ReadRowGroupHeader() {
@@ -503,6 +545,12 @@ Status HdfsRCFileScanner::ReadColumnBuffers() {
       RETURN_IF_FALSE(stream_->ReadBytes(
           column.buffer_len, &compressed_input, &parse_status_));
       uint8_t* compressed_output = row_group_buffer_ + column.start_offset;
+      if (async_decompressor_ != nullptr) {
+        // The row group is read ahead and decompressed in the decompression thread.
+        RETURN_IF_ERROR(async_decompressor_->AddBlock(compressed_input,
+            column.buffer_len, compressed_output, column.uncompressed_buffer_len));
+        continue;
+      }
       {
         SCOPED_TIMER(decompress_timer_);
         RETURN_IF_ERROR(decompressor_->ProcessBlock32(true, column.buffer_len,
@@ -623,19 +671,25 @@ Status HdfsRCFileScanner::ProcessRange(RowBatch* row_batch) {
       row_group_buffer_size_ = 0;
     }
 
-    // RCFiles don't end with syncs
-    if (stream_->eof()) {
-      eos_ = true;
-      return Status::OK();
-    }
+    // With pipelined decompression, the sync was already read ahead.
+    if (async_decompressor_ == nullptr) RETURN_IF_ERROR(ReadRowGroupSync());
+  }
+  return Status::OK();
+}
 
-    // Check for sync by looking for the marker that precedes syncs.
-    int marker;
-    RETURN_IF_FALSE(stream_->ReadInt(&marker, &parse_status_, /* peek */ true));
-    if (marker == HdfsRCFileScanner::SYNC_MARKER) {
-      RETURN_IF_FALSE(stream_->ReadInt(&marker, &parse_status_, /* peek */ false));
-      RETURN_IF_ERROR(ReadSync());
-    }
+Status HdfsRCFileScanner::ReadRowGroupSync() {
+  // RCFiles don't end with syncs
+  if (stream_->eof()) {
+    eos_ = true;
+    return Status::OK();
+  }
+
+  // Check for sync by looking for the marker that precedes syncs.
+  int marker;
+  RETURN_IF_FALSE(stream_->ReadInt(&marker, &parse_status_, /* peek */ true));
+  if (marker == HdfsRCFileScanner::SYNC_MARKER) {
+    RETURN_IF_FALSE(stream_->ReadInt(&marker, &parse_status_, /* peek */ false));
+    RETURN_IF_ERROR(ReadSync());
   }
   return Status::OK();
 }
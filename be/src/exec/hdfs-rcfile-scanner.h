@@ -263,6 +263,7 @@ class HdfsRCFileScanner : public BaseSequenceScanner {
   virtual Status ReadFileHeader() WARN_UNUSED_RESULT;
   virtual Status InitNewRange() WARN_UNUSED_RESULT;
   virtual Status ProcessRange(RowBatch* row_batch) WARN_UNUSED_RESULT;
+  virtual Status ReadBlockAhead() WARN_UNUSED_RESULT;
 
   virtual THdfsFileFormat::type file_format() const { return THdfsFileFormat::RC_FILE; }
 
@@ -314,12 +315,31 @@ class HdfsRCFileScanner : public BaseSequenceScanner {
   ///   cur_field_length_[col_idx]
   Status NextField(int col_idx) WARN_UNUSED_RESULT;
 
-  /// Read a row group (except for the sync marker and sync) into buffers.
+  /// Read the next row group with rows (except for the sync marker and sync) into
+  /// buffers, skipping row groups without rows.
+  /// Calls:
+  ///   ReadRowGroup() or StartPipelinedRowGroup()
+  Status StartRowGroup() WARN_UNUSED_RESULT;
+
+  /// Read a row group (except for the sync marker and sync) into buffers. With pipelined
+  /// decompression, the column buffers are only added to 'async_decompressor_'.
   /// Calls:
   ///   ReadRowGroupHeader()
   ///   ReadKeyBuffers()
   ///   ReadColumnBuffers()
-  Status StartRowGroup() WARN_UNUSED_RESULT;
+  Status ReadRowGroup() WARN_UNUSED_RESULT;
+
+  /// Implements StartRowGroup() with pipelined decompression: makes the row group that
+  /// was read ahead the current one and reads the next one ahead.
+  Status StartPipelinedRowGroup() WARN_UNUSED_RESULT;
+
+  /// Reads the sync after a row group, if there is one, or sets 'eos_' at the end of the
+  /// file.
+  Status ReadRowGroupSync() WARN_UNUSED_RESULT;
+
+  /// Swaps the state of the current row group with that of the row group that is read
+  /// ahead with pipelined decompression.
+  void SwapRowGroups();
 
   /// Move to next row. Calls NextField on each column that we are reading.
   /// Modifies:
@@ -419,6 +439,15 @@ class HdfsRCFileScanner : public BaseSequenceScanner {
   /// This is the allocated size of 'row_group_buffer_'.  'row_group_buffer_' is reused
   /// across row groups and will grow as necessary.
   int64_t row_group_buffer_size_ = 0;
+
+  /// The state of the row group that was read ahead with pipelined decompression,
+  /// corresponding to the members above.
+  std::vector<ColumnInfo> next_columns_;
+  std::vector<uint8_t> next_key_buffer_;
+  int next_num_rows_ = 0;
+  uint8_t* next_row_group_buffer_ = nullptr;
+  int64_t next_row_group_length_ = 0;
+  int64_t next_row_group_buffer_size_ = 0;
 };
 
 }
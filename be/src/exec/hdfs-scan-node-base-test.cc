@@ -0,0 +1,302 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-scan-node-base.h"
+
+#include <atomic>
+#include <thread>
+
+#include <gflags/gflags.h>
+
+#include "gen-cpp/control_service.pb.h"
+#include "runtime/io/request-ranges.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+DECLARE_int64(mt_scan_range_split_bytes);
+
+using namespace impala::io;
+
+namespace impala {
+
+static const int NUM_INSTANCES = 3;
+static const int64_t PARTITION_ID = 1;
+
+class ScanRangeSharedStateTest : public testing::Test {
+ protected:
+  virtual void SetUp() override {
+    state_.use_mt_scan_node_ = true;
+    for (int i = 0; i < NUM_INSTANCES; ++i) {
+      state_.scan_range_queues_.emplace_back(
+          new ScanRangeSharedState::InstanceScanRangeQueue());
+    }
+    state_.progress_.Init("Splits complete", 0);
+  }
+
+  /// Adds a file descriptor for 'filename' with the given format and compression.
+  void AddFile(const string& filename, THdfsFileFormat::type format,
+      THdfsCompression::type compression = THdfsCompression::NONE) {
+    HdfsFileDesc* desc = obj_pool_.Add(new HdfsFileDesc(filename));
+    desc->file_length = 1024 * 1024;
+    desc->file_format = format;
+    desc->file_compression = compression;
+    state_.file_descs_[make_pair(PARTITION_ID, filename)] = desc;
+  }
+
+  /// Returns a range of 'filename' for the bytes [offset, offset + len).
+  ScanRange* MakeRange(const string& filename, int64_t offset, int64_t len,
+      int cache_options = BufferOpts::NO_CACHING) {
+    ScanRangeMetadata* metadata =
+        obj_pool_.Add(new ScanRangeMetadata(PARTITION_ID, nullptr));
+    return ScanRange::AllocateScanRange(&obj_pool_, nullptr, filename.c_str(), len,
+        offset, {}, metadata, 0, false, 0, BufferOpts(cache_options));
+  }
+
+  /// Pops the next range for the instance with queue 'queue_idx' and checks that it is
+  /// 'expected' and whether it was stolen.
+  void ExpectPop(int queue_idx, ScanRange* expected, bool expected_stolen) {
+    bool stolen;
+    EXPECT_EQ(expected, state_.PopScanRange(queue_idx, &stolen));
+    EXPECT_EQ(expected_stolen, stolen);
+  }
+
+  int64_t NumQueued() { return state_.num_queued_scan_ranges_.Load(); }
+
+  ObjectPool obj_pool_;
+  ScanRangeSharedState state_;
+};
+
+// Test that an instance reads its own queue from the front.
+TEST_F(ScanRangeSharedStateTest, PopOwnQueueInOrder) {
+  AddFile("f", THdfsFileFormat::TEXT);
+  ScanRange* r0 = MakeRange("f", 0, 10);
+  ScanRange* r1 = MakeRange("f", 10, 10);
+  ScanRange* r2 = MakeRange("f", 20, 10);
+  state_.EnqueueScanRange(0, {r0, r1}, /* at_front */ false);
+  // Ranges queued at the front are read first.
+  state_.EnqueueScanRange(0, {r2}, /* at_front */ true);
+  EXPECT_EQ(3, NumQueued());
+  ExpectPop(0, r2, false);
+  ExpectPop(0, r0, false);
+  ExpectPop(0, r1, false);
+  ExpectPop(0, nullptr, false);
+  EXPECT_EQ(0, NumQueued());
+}
+
+// Test that the number of queued ranges stays consistent with the queues while
+// instances enqueue, pop and steal ranges concurrently.
+TEST_F(ScanRangeSharedStateTest, ConcurrentEnqueueAndPop) {
+  AddFile("f", THdfsFileFormat::TEXT);
+  const int num_ranges_per_instance = 10000;
+  std::atomic<int64_t> num_popped{0};
+  std::atomic<bool> saw_negative_count{false};
+  vector<std::thread> threads;
+  for (int i = 0; i < NUM_INSTANCES; ++i) {
+    vector<ScanRange*> ranges;
+    for (int j = 0; j < num_ranges_per_instance; ++j) {
+      ranges.push_back(MakeRange("f", j * 10, 10));
+    }
+    threads.emplace_back([this, i, ranges, &num_popped, &saw_negative_count]() {
+      bool stolen;
+      for (ScanRange* range : ranges) {
+        state_.EnqueueScanRange(i, {range}, /* at_front */ false);
+        if (state_.PopScanRange(i, &stolen) != nullptr) ++num_popped;
+        if (NumQueued() < 0) saw_negative_count = true;
+      }
+    });
+  }
+  for (std::thread& t : threads) t.join();
+  EXPECT_FALSE(saw_negative_count);
+  EXPECT_EQ(NUM_INSTANCES * num_ranges_per_instance, num_popped.load() + NumQueued());
+  bool stolen;
+  while (state_.PopScanRange(0, &stolen) != nullptr) ++num_popped;
+  EXPECT_EQ(NUM_INSTANCES * num_ranges_per_instance, num_popped.load());
+  EXPECT_EQ(0, NumQueued());
+}
+
+// Test that ranges read from the HDFS cache go to the front of the queue.
+TEST_F(ScanRangeSharedStateTest, CachedRangesFirst) {
+  AddFile("f", THdfsFileFormat::TEXT);
+  ScanRange* uncached = MakeRange("f", 0, 10);
+  ScanRange* cached = MakeRange("f", 10, 10, BufferOpts::USE_HDFS_CACHE);
+  state_.EnqueueScanRange(1, {uncached, cached}, /* at_front */ false);
+  ExpectPop(1, cached, false);
+  ExpectPop(1, uncached, false);
+}
+
+// Test that an instance with an empty queue steals from the back of the longest queue,
+// and that the owner of that queue keeps reading from the front.
+TEST_F(ScanRangeSharedStateTest, StealFromBackOfLongestQueue) {
+  AddFile("f", THdfsFileFormat::TEXT);
+  vector<ScanRange*> a = {MakeRange("f", 0, 10), MakeRange("f", 10, 10)};
+  vector<ScanRange*> b =
+      {MakeRange("f", 20, 10), MakeRange("f", 30, 10), MakeRange("f", 40, 10)};
+  state_.EnqueueScanRange(0, a, /* at_front */ false);
+  state_.EnqueueScanRange(1, b, /* at_front */ false);
+
+  // Queue 1 is the longest, so instance 2 steals the range that instance 1 would read
+  // last.
+  ExpectPop(2, b[2], true);
+  ExpectPop(1, b[0], false);
+  // Queue 0 is now the longest.
+  ExpectPop(2, a[1], true);
+  ExpectPop(2, b[1], true);
+  ExpectPop(0, a[0], false);
+  EXPECT_EQ(0, NumQueued());
+  ExpectPop(0, nullptr, false);
+  ExpectPop(2, nullptr, false);
+}
+
+// Test that uncompressed text and JSON ranges are split in two halves, of which the
+// second is queued at the back of the splitter's queue.
+TEST_F(ScanRangeSharedStateTest, SplitBoundaries) {
+  gflags::FlagSaver saver;
+  FLAGS_mt_scan_range_split_bytes = 100;
+  AddFile("text", THdfsFileFormat::TEXT);
+  AddFile("json", THdfsFileFormat::JSON);
+  ScanRange* queued = MakeRange("text", 0, 10);
+  state_.EnqueueScanRange(2, {queued}, /* at_front */ false);
+
+  ScanRange* range = MakeRange("text", 1000, 201);
+  ScanRange* head = state_.MaybeSplitScanRange(2, range);
+  ASSERT_TRUE(head != nullptr);
+  EXPECT_STREQ("text", head->file());
+  EXPECT_EQ(1000, head->offset());
+  EXPECT_EQ(100, head->len());
+  EXPECT_EQ(range->meta_data(), head->meta_data());
+  EXPECT_EQ(1, state_.progress_.total());
+  EXPECT_EQ(2, NumQueued());
+  ExpectPop(2, queued, false);
+  bool stolen;
+  ScanRange* tail = state_.PopScanRange(2, &stolen);
+  ASSERT_TRUE(tail != nullptr);
+  // The halves cover the range without gaps or overlap.
+  EXPECT_EQ(head->offset() + head->len(), tail->offset());
+  EXPECT_EQ(101, tail->len());
+
+  // Exactly twice the split size is the smallest range that is split.
+  EXPECT_TRUE(state_.MaybeSplitScanRange(0, MakeRange("text", 0, 199)) == nullptr);
+  head = state_.MaybeSplitScanRange(0, MakeRange("json", 0, 200));
+  ASSERT_TRUE(head != nullptr);
+  EXPECT_EQ(100, head->len());
+  tail = state_.PopScanRange(0, &stolen);
+  ASSERT_TRUE(tail != nullptr);
+  EXPECT_EQ(100, tail->offset());
+  EXPECT_EQ(100, tail->len());
+
+  // Splitting is disabled by a non-positive split size.
+  FLAGS_mt_scan_range_split_bytes = 0;
+  EXPECT_TRUE(state_.MaybeSplitScanRange(0, MakeRange("text", 0, 1000)) == nullptr);
+  EXPECT_EQ(0, NumQueued());
+}
+
+// Test that ranges are not split if enough ranges are queued for all instances.
+TEST_F(ScanRangeSharedStateTest, NoSplitWithEnoughQueuedRanges) {
+  gflags::FlagSaver saver;
+  FLAGS_mt_scan_range_split_bytes = 100;
+  AddFile("f", THdfsFileFormat::TEXT);
+  for (int i = 0; i < NUM_INSTANCES - 1; ++i) {
+    state_.EnqueueScanRange(i, {MakeRange("f", i * 10, 10)}, /* at_front */ false);
+  }
+  EXPECT_TRUE(state_.MaybeSplitScanRange(0, MakeRange("f", 100, 1000)) != nullptr);
+  EXPECT_EQ(NUM_INSTANCES, NumQueued());
+  EXPECT_TRUE(state_.MaybeSplitScanRange(0, MakeRange("f", 2000, 1000)) == nullptr);
+  EXPECT_EQ(NUM_INSTANCES, NumQueued());
+}
+
+// Test that ranges of formats that cannot be split at any offset are not split.
+TEST_F(ScanRangeSharedStateTest, NoSplitOfNonSplittableRanges) {
+  gflags::FlagSaver saver;
+  FLAGS_mt_scan_range_split_bytes = 100;
+  AddFile("gzip", THdfsFileFormat::TEXT, THdfsCompression::GZIP);
+  AddFile("bzip2", THdfsFileFormat::TEXT, THdfsCompression::BZIP2);
+  AddFile("parquet", THdfsFileFormat::PARQUET);
+  AddFile("orc", THdfsFileFormat::ORC);
+  AddFile("seq", THdfsFileFormat::SEQUENCE_FILE);
+  AddFile("avro", THdfsFileFormat::AVRO);
+  AddFile("text", THdfsFileFormat::TEXT);
+  for (const string& file : {"gzip", "bzip2", "parquet", "orc", "seq", "avro"}) {
+    EXPECT_TRUE(state_.MaybeSplitScanRange(0, MakeRange(file, 0, 1000)) == nullptr)
+        << file;
+  }
+
+  // Cached ranges are read in one piece.
+  EXPECT_TRUE(state_.MaybeSplitScanRange(0,
+      MakeRange("text", 0, 1000, BufferOpts::USE_HDFS_CACHE)) == nullptr);
+
+  // Footer ranges of columnar files and file header ranges are not split.
+  ScanRange* split = MakeRange("text", 0, 1000);
+  ScanRange* footer = MakeRange("text", 0, 1000);
+  static_cast<ScanRangeMetadata*>(footer->meta_data())->original_split = split;
+  EXPECT_TRUE(state_.MaybeSplitScanRange(0, footer) == nullptr);
+  ScanRange* header = MakeRange("text", 0, 1000);
+  static_cast<ScanRangeMetadata*>(header->meta_data())->is_file_header = true;
+  EXPECT_TRUE(state_.MaybeSplitScanRange(0, header) == nullptr);
+  EXPECT_EQ(0, NumQueued());
+  EXPECT_EQ(0, state_.progress_.total());
+}
+
+// Test that an instance asks the coordinator for as many ranges as it has idle
+// instances, and that the scan range submission held for the ranges handed out by the
+// coordinator is given up once all of them were received and issued.
+TEST_F(ScanRangeSharedStateTest, DynamicScanRanges) {
+  AddFile("f", THdfsFileFormat::PARQUET);
+  state_.receives_dynamic_scan_ranges_ = true;
+  // One submission per instance and one for the ranges from the coordinator.
+  state_.UpdateRemainingScanRangeSubmissions(NUM_INSTANCES + 1);
+  ScanRangeRequestPB request;
+  // Ranges are only requested once all instances issued their initial ranges.
+  EXPECT_FALSE(state_.GetScanRangeRequest(&request));
+  state_.UpdateRemainingScanRangeSubmissions(-NUM_INSTANCES);
+  ASSERT_TRUE(state_.GetScanRangeRequest(&request));
+  EXPECT_EQ(NUM_INSTANCES, request.num_ranges_wanted());
+  EXPECT_EQ(0, request.num_ranges_received());
+
+  // Queued ranges and received ranges that were not issued yet count as work.
+  state_.EnqueueScanRange(0, {MakeRange("f", 0, 10)}, /* at_front */ false);
+  HdfsFileDesc* received_file = obj_pool_.Add(new HdfsFileDesc("g"));
+  {
+    lock_guard<mutex> l(state_.dynamic_scan_ranges_lock_);
+    state_.pending_dynamic_files_.push_back(received_file);
+    state_.num_pending_dynamic_files_.Store(1);
+    state_.num_dynamic_ranges_received_ = 2;
+  }
+  EXPECT_TRUE(state_.HasPendingDynamicScanRanges());
+  ASSERT_TRUE(state_.GetScanRangeRequest(&request));
+  EXPECT_EQ(NUM_INSTANCES - 2, request.num_ranges_wanted());
+  EXPECT_EQ(2, request.num_ranges_received());
+  state_.EnqueueScanRange(1, {MakeRange("f", 10, 10)}, /* at_front */ false);
+  EXPECT_FALSE(state_.GetScanRangeRequest(&request));
+
+  vector<HdfsFileDesc*> files;
+  ASSERT_OK(state_.TakeDynamicScanRanges(&files));
+  ASSERT_EQ(1, files.size());
+  EXPECT_EQ(received_file, files[0]);
+  EXPECT_FALSE(state_.HasPendingDynamicScanRanges());
+  {
+    lock_guard<mutex> l(state_.dynamic_scan_ranges_lock_);
+    state_.no_more_dynamic_ranges_ = true;
+  }
+  // The submission is held until the instance finished issuing the received ranges.
+  EXPECT_EQ(1, state_.RemainingScanRangeSubmissions());
+  state_.DoneIssuingDynamicScanRanges();
+  EXPECT_EQ(0, state_.RemainingScanRangeSubmissions());
+  EXPECT_FALSE(state_.GetScanRangeRequest(&request));
+}
+
+}
@@ -20,6 +20,7 @@
 #include "exec/base-sequence-scanner.h"
 #include "exec/hdfs-avro-scanner.h"
 #include "exec/hdfs-columnar-scanner.h"
+#include "exec/hdfs-json-scanner.h"
 #include "exec/hdfs-orc-scanner.h"
 #include "exec/hdfs-plugin-text-scanner.h"
 #include "exec/hdfs-rcfile-scanner.h"
@@ -72,6 +73,11 @@ using namespace impala::io;
 using namespace strings;
 
 namespace impala {
+DEFINE_int64(mt_scan_range_split_bytes, 32L * 1024L * 1024L, "(Advanced) Uncompressed "
+    "text scan ranges of at least twice this size are split in two by multi-threaded "
+    "scans when other instances of the scan run out of ranges to read. A value <= 0 "
+    "disables splitting.");
+
 PROFILE_DEFINE_TIMER(TotalRawHdfsReadTime, STABLE_LOW, "Aggregate wall clock time"
     " across all Disk I/O threads in HDFS read operations.");
 PROFILE_DEFINE_TIMER(TotalRawHdfsOpenFileTime, STABLE_LOW, "Aggregate wall clock time"
@@ -236,79 +242,19 @@ Status HdfsScanPlanNode::Init(const TPlanNode& tnode, FragmentState* state) {
 Status HdfsScanPlanNode::ProcessScanRangesAndInitSharedState(FragmentState* state) {
   // Initialize the template tuple pool.
   shared_state_.template_pool_.reset(new MemPool(state->query_mem_tracker()));
-  auto& template_tuple_map_ = shared_state_.partition_template_tuple_map_;
-  ObjectPool* obj_pool = shared_state_.obj_pool();
-  auto& file_descs = shared_state_.file_descs_;
   HdfsFsCache::HdfsFsMap fs_cache;
   int num_ranges_missing_volume_id = 0;
   int64_t total_splits = 0;
+  vector<HdfsFileDesc*> new_files;
   const vector<const PlanFragmentInstanceCtxPB*>& instance_ctx_pbs =
       state->instance_ctx_pbs();
   for (auto ctx : instance_ctx_pbs) {
     auto ranges = ctx->per_node_scan_ranges().find(tnode_->node_id);
     if (ranges == ctx->per_node_scan_ranges().end()) continue;
     for (const ScanRangeParamsPB& params : ranges->second.scan_ranges()) {
-      DCHECK(params.scan_range().has_hdfs_file_split());
-      const HdfsFileSplitPB& split = params.scan_range().hdfs_file_split();
-      HdfsPartitionDescriptor* partition_desc =
-          hdfs_table_->GetPartition(split.partition_id());
-      if (template_tuple_map_.find(split.partition_id()) == template_tuple_map_.end()) {
-        template_tuple_map_[split.partition_id()] =
-            InitTemplateTuple(partition_desc->partition_key_value_evals(),
-                shared_state_.template_pool_.get());
-      }
-      // Convert the ScanRangeParamsPB into per-file DiskIO::ScanRange objects and
-      // populate partition_ids_, file_descs_, and per_type_files_.
-      if (partition_desc == nullptr) {
-        // TODO: this should be a DCHECK but we sometimes hit it. It's likely IMPALA-1702.
-        LOG(ERROR) << "Bad table descriptor! table_id=" << hdfs_table_->id()
-                   << " partition_id=" << split.partition_id() << "\n"
-                   << PrintThrift(state->fragment())
-                   << state->fragment_ctx().DebugString();
-        return Status("Query encountered invalid metadata, likely due to IMPALA-1702."
-                      " Try rerunning the query.");
-      }
-
-      filesystem::path file_path(partition_desc->location());
-      file_path.append(split.relative_path(), filesystem::path::codecvt());
-      const string& native_file_path = file_path.native();
-
-      auto file_desc_map_key = make_pair(partition_desc->id(), native_file_path);
-      HdfsFileDesc* file_desc = nullptr;
-      auto file_desc_it = file_descs.find(file_desc_map_key);
-      if (file_desc_it == file_descs.end()) {
-        // Add new file_desc to file_descs_ and per_type_files_
-        file_desc = obj_pool->Add(new HdfsFileDesc(native_file_path));
-        file_descs[file_desc_map_key] = file_desc;
-        file_desc->file_length = split.file_length();
-        file_desc->mtime = split.mtime();
-        file_desc->file_compression = CompressionTypePBToThrift(split.file_compression());
-        file_desc->file_format = partition_desc->file_format();
-        RETURN_IF_ERROR(HdfsFsCache::instance()->GetConnection(
-            native_file_path, &file_desc->fs, &fs_cache));
-        shared_state_.per_type_files_[partition_desc->file_format()].push_back(file_desc);
-      } else {
-        // File already processed
-        file_desc = file_desc_it->second;
-      }
-
-      bool expected_local = params.has_is_remote() && !params.is_remote();
-      if (expected_local && params.volume_id() == -1) ++num_ranges_missing_volume_id;
-
-      int cache_options = BufferOpts::NO_CACHING;
-      if (params.has_try_hdfs_cache() && params.try_hdfs_cache()) {
-        cache_options |= BufferOpts::USE_HDFS_CACHE;
-      }
-      if ((!expected_local || FLAGS_always_use_data_cache)
-          && !state->query_options().disable_data_cache) {
-        cache_options |= BufferOpts::USE_DATA_CACHE;
-      }
-      ScanRangeMetadata* metadata =
-          obj_pool->Add(new ScanRangeMetadata(split.partition_id(), nullptr));
-      file_desc->splits.push_back(ScanRange::AllocateScanRange(obj_pool, file_desc->fs,
-          file_desc->filename.c_str(), split.length(), split.offset(), {}, metadata,
-          params.volume_id(), expected_local, file_desc->mtime,
-          BufferOpts(cache_options)));
+      RETURN_IF_ERROR(AddScanRange(state, params, &shared_state_.file_descs_,
+          &shared_state_.partition_template_tuple_map_, &fs_cache,
+          &num_ranges_missing_volume_id, &new_files));
       total_splits++;
     }
     // Update server wide metrics for number of scan ranges and ranges that have
@@ -316,6 +262,9 @@ Status HdfsScanPlanNode::ProcessScanRangesAndInitSharedState(FragmentState* stat
     ImpaladMetrics::NUM_RANGES_PROCESSED->Increment(ranges->second.scan_ranges().size());
     ImpaladMetrics::NUM_RANGES_MISSING_VOLUME_ID->Increment(num_ranges_missing_volume_id);
   }
+  for (HdfsFileDesc* file_desc : new_files) {
+    shared_state_.per_type_files_[file_desc->file_format].push_back(file_desc);
+  }
   // Set up the rest of the shared state.
   shared_state_.remaining_scan_range_submissions_.Store(instance_ctx_pbs.size());
   shared_state_.progress().Init(
@@ -327,6 +276,13 @@ Status HdfsScanPlanNode::ProcessScanRangesAndInitSharedState(FragmentState* stat
       << "Non MT scan node should only have a single instance.";
   auto instance_ctxs = state->instance_ctxs();
   DCHECK_EQ(instance_ctxs.size(), instance_ctx_pbs.size());
+  if (shared_state_.use_mt_scan_node_) {
+    for (int i = 0; i < instance_ctxs.size(); ++i) {
+      shared_state_.scan_range_queue_idx_[instance_ctxs[i]->fragment_instance_id] = i;
+      shared_state_.scan_range_queues_.emplace_back(
+          new ScanRangeSharedState::InstanceScanRangeQueue());
+    }
+  }
   int files_per_instance = file_descs.size() / instance_ctxs.size();
   int remainder = file_descs.size() % instance_ctxs.size();
   int num_lists = min(file_descs.size(), instance_ctxs.size());
@@ -341,6 +297,148 @@ Status HdfsScanPlanNode::ProcessScanRangesAndInitSharedState(FragmentState* stat
     }
   }
   DCHECK(fd_it == file_descs.end());
+
+  // The coordinator hands out the ranges it held back for this node (see
+  // Scheduler::HoldBackScanRanges()) in the responses to status reports. One scan range
+  // submission is held until all of them have been received and issued.
+  bool receives_dynamic_scan_ranges = false;
+  for (auto ctx : instance_ctx_pbs) {
+    for (int32_t node_id : ctx->dynamic_scan_range_nodes()) {
+      if (node_id == tnode_->node_id) receives_dynamic_scan_ranges = true;
+    }
+  }
+  if (receives_dynamic_scan_ranges && shared_state_.use_mt_scan_node_) {
+    shared_state_.receives_dynamic_scan_ranges_ = true;
+    shared_state_.remaining_scan_range_submissions_.Add(1);
+    dynamic_scan_ranges_state_ = state;
+    state->query_state()->RegisterScanRangeReceiver(this);
+  }
+  return Status::OK();
+}
+
+bool HdfsScanPlanNode::GetScanRangeRequest(ScanRangeRequestPB* request) {
+  return shared_state_.GetScanRangeRequest(request);
+}
+
+void HdfsScanPlanNode::AddScanRanges(const ScanRangeGrantPB& grant) {
+  {
+    lock_guard<mutex> l(shared_state_.dynamic_scan_ranges_lock_);
+    if (shared_state_.no_more_dynamic_ranges_) return;
+    // Skip the ranges that were already received in an earlier response.
+    int64_t first_idx =
+        shared_state_.num_dynamic_ranges_received_ - grant.first_range_idx();
+    DCHECK_GE(first_idx, 0);
+    if (first_idx >= 0 && first_idx <= grant.scan_ranges_size()) {
+      Status status = AddDynamicScanRanges(grant, first_idx);
+      if (!status.ok()) {
+        // Fail the scan instead of waiting for ranges that will never be issued.
+        shared_state_.dynamic_scan_ranges_status_ = status;
+        shared_state_.no_more_dynamic_ranges_ = true;
+      }
+    }
+    if (grant.no_more_ranges()) shared_state_.no_more_dynamic_ranges_ = true;
+    shared_state_.MaybeDoneWithDynamicScanRanges();
+  }
+  shared_state_.NotifyScanRangeWaiters();
+}
+
+Status HdfsScanPlanNode::AddDynamicScanRanges(
+    const ScanRangeGrantPB& grant, int first_idx) {
+  FragmentState* state = dynamic_scan_ranges_state_;
+  // Each grant gets its own file descriptors so that only the new ranges are issued.
+  HdfsFileDesc::FileDescMap file_descs;
+  HdfsFsCache::HdfsFsMap fs_cache;
+  int num_ranges_missing_volume_id = 0;
+  vector<HdfsFileDesc*> new_files;
+  for (int i = first_idx; i < grant.scan_ranges_size(); ++i) {
+    RETURN_IF_ERROR(AddScanRange(state, grant.scan_ranges(i), &file_descs,
+        &shared_state_.dynamic_template_tuple_map_, &fs_cache,
+        &num_ranges_missing_volume_id, &new_files));
+  }
+  int num_new_ranges = grant.scan_ranges_size() - first_idx;
+  ImpaladMetrics::NUM_RANGES_PROCESSED->Increment(num_new_ranges);
+  ImpaladMetrics::NUM_RANGES_MISSING_VOLUME_ID->Increment(num_ranges_missing_volume_id);
+  for (HdfsFileDesc* file_desc : new_files) {
+    // Scanners look up the descriptor of a range's file by partition and file name.
+    // Files that also have statically assigned ranges are found in 'file_descs_'.
+    auto key = make_pair(
+        static_cast<ScanRangeMetadata*>(file_desc->splits[0]->meta_data())->partition_id,
+        file_desc->filename);
+    if (shared_state_.file_descs_.find(key) == shared_state_.file_descs_.end()) {
+      shared_state_.dynamic_file_descs_.emplace(key, file_desc);
+    }
+    shared_state_.pending_dynamic_files_.push_back(file_desc);
+  }
+  shared_state_.num_pending_dynamic_files_.Store(
+      shared_state_.pending_dynamic_files_.size());
+  shared_state_.num_dynamic_ranges_received_ += num_new_ranges;
+  shared_state_.progress_.AddTotal(num_new_ranges);
+  return Status::OK();
+}
+
+Status HdfsScanPlanNode::AddScanRange(FragmentState* state,
+    const ScanRangeParamsPB& params, HdfsFileDesc::FileDescMap* file_descs,
+    boost::unordered_map<int64_t, Tuple*>* template_tuples,
+    HdfsFsCache::HdfsFsMap* fs_cache, int* num_ranges_missing_volume_id,
+    vector<HdfsFileDesc*>* new_files) {
+  DCHECK(params.scan_range().has_hdfs_file_split());
+  const HdfsFileSplitPB& split = params.scan_range().hdfs_file_split();
+  HdfsPartitionDescriptor* partition_desc =
+      hdfs_table_->GetPartition(split.partition_id());
+  if (template_tuples->find(split.partition_id()) == template_tuples->end()) {
+    (*template_tuples)[split.partition_id()] = InitTemplateTuple(
+        partition_desc->partition_key_value_evals(), shared_state_.template_pool_.get());
+  }
+  // Convert the ScanRangeParamsPB into per-file DiskIO::ScanRange objects.
+  if (partition_desc == nullptr) {
+    // TODO: this should be a DCHECK but we sometimes hit it. It's likely IMPALA-1702.
+    LOG(ERROR) << "Bad table descriptor! table_id=" << hdfs_table_->id()
+               << " partition_id=" << split.partition_id() << "\n"
+               << PrintThrift(state->fragment())
+               << state->fragment_ctx().DebugString();
+    return Status("Query encountered invalid metadata, likely due to IMPALA-1702."
+                  " Try rerunning the query.");
+  }
+
+  filesystem::path file_path(partition_desc->location());
+  file_path.append(split.relative_path(), filesystem::path::codecvt());
+  const string& native_file_path = file_path.native();
+
+  auto file_desc_map_key = make_pair(partition_desc->id(), native_file_path);
+  HdfsFileDesc* file_desc = nullptr;
+  auto file_desc_it = file_descs->find(file_desc_map_key);
+  if (file_desc_it == file_descs->end()) {
+    file_desc = shared_state_.obj_pool_.Add(new HdfsFileDesc(native_file_path));
+    (*file_descs)[file_desc_map_key] = file_desc;
+    file_desc->file_length = split.file_length();
+    file_desc->mtime = split.mtime();
+    file_desc->file_compression = CompressionTypePBToThrift(split.file_compression());
+    file_desc->file_format = partition_desc->file_format();
+    RETURN_IF_ERROR(HdfsFsCache::instance()->GetConnection(
+        native_file_path, &file_desc->fs, fs_cache));
+    new_files->push_back(file_desc);
+  } else {
+    // File already processed
+    file_desc = file_desc_it->second;
+  }
+
+  bool expected_local = params.has_is_remote() && !params.is_remote();
+  if (expected_local && params.volume_id() == -1) ++*num_ranges_missing_volume_id;
+
+  int cache_options = BufferOpts::NO_CACHING;
+  if (params.has_try_hdfs_cache() && params.try_hdfs_cache()) {
+    cache_options |= BufferOpts::USE_HDFS_CACHE;
+  }
+  if ((!expected_local || FLAGS_always_use_data_cache)
+      && !state->query_options().disable_data_cache) {
+    cache_options |= BufferOpts::USE_DATA_CACHE;
+  }
+  ScanRangeMetadata* metadata =
+      shared_state_.obj_pool_.Add(new ScanRangeMetadata(split.partition_id(), nullptr));
+  file_desc->splits.push_back(ScanRange::AllocateScanRange(&shared_state_.obj_pool_,
+      file_desc->fs, file_desc->filename.c_str(), split.length(), split.offset(), {},
+      metadata, params.volume_id(), expected_local, file_desc->mtime,
+      BufferOpts(cache_options)));
   return Status::OK();
 }
 
@@ -376,6 +474,10 @@ void HdfsScanPlanNode::Close() {
   if (shared_state_.template_pool_.get() != nullptr) {
     shared_state_.template_pool_->FreeAll();
   }
+  if (dynamic_scan_ranges_state_ != nullptr) {
+    dynamic_scan_ranges_state_->query_state()->UnregisterScanRangeReceiver(this);
+    dynamic_scan_ranges_state_ = nullptr;
+  }
   PlanNode::Close();
 }
 
@@ -462,6 +564,17 @@ Status HdfsScanNodeBase::Prepare(RuntimeState* state) {
   scan_node_pool_.reset(new MemPool(mem_tracker()));
   runtime_profile()->AddInfoString("Table Name", hdfs_table_->fully_qualified_name());
 
+  const vector<TRuntimeFilterDesc>& filter_descs = plan_node_.tnode_->runtime_filters;
+  DCHECK_EQ(filter_descs.size(), filter_ctxs_.size());
+  filter_history_keys_.resize(filter_descs.size());
+  for (int i = 0; i < filter_descs.size(); ++i) {
+    auto it = filter_descs[i].planid_to_target_ndx.find(id());
+    DCHECK(it != filter_descs[i].planid_to_target_ndx.end());
+    if (filter_descs[i].targets[it->second].is_bound_by_partition_columns) continue;
+    filter_history_keys_[i] = FilterEffectivenessHistory::MakeKey(
+        hdfs_table_->fully_qualified_name(), state->desc_tbl(), filter_descs[i], id());
+  }
+
   if (HasRowBatchQueue()) {
     // Add per volume stats to the runtime profile for Non MT scan node.
     PerVolumeStats per_volume_stats;
@@ -484,6 +597,9 @@ void HdfsScanPlanNode::Codegen(FragmentState* state) {
       case THdfsFileFormat::TEXT:
         status = HdfsTextScanner::Codegen(this, state, &fn);
         break;
+      case THdfsFileFormat::JSON:
+        status = HdfsJsonScanner::Codegen(this, state, &fn);
+        break;
       case THdfsFileFormat::SEQUENCE_FILE:
         status = HdfsSequenceScanner::Codegen(this, state, &fn);
         break;
@@ -617,6 +733,8 @@ void HdfsScanNodeBase::Close(RuntimeState* state) {
   }
 
   StopAndFinalizeCounters();
+  // All scanners are closed at this point, so the filter stats are final.
+  UpdateFilterEffectivenessHistory();
 
   // There should be no active hdfs read threads.
   DCHECK_EQ(active_hdfs_read_thread_counter_.value(), 0);
@@ -635,6 +753,26 @@ void HdfsScanNodeBase::Close(RuntimeState* state) {
   ScanNode::Close(state);
 }
 
+bool HdfsScanNodeBase::SkipWaitForFilter(int filter_idx) const {
+  DCHECK_LT(filter_idx, filter_history_keys_.size());
+  return FilterEffectivenessHistory::GetInstance()->SkipWaitForFilter(
+      filter_history_keys_[filter_idx]);
+}
+
+void HdfsScanNodeBase::UpdateFilterEffectivenessHistory() {
+  for (int i = 0; i < filter_history_keys_.size(); ++i) {
+    const FilterContext& ctx = filter_ctxs_[i];
+    if (filter_history_keys_[i].empty() || ctx.stats == nullptr) continue;
+    // Only filters that arrived and were not always true could have been evaluated
+    // on rows.
+    if (!ctx.filter->HasFilter() || ctx.filter->AlwaysTrue()) continue;
+    const FilterStats::CounterGroup& rows =
+        ctx.stats->GetCounterGroup(FilterStats::ROWS_KEY);
+    FilterEffectivenessHistory::GetInstance()->Update(filter_history_keys_[i],
+        rows.processed->value(), rows.rejected->value());
+  }
+}
+
 Status HdfsScanNodeBase::IssueInitialScanRanges(RuntimeState* state) {
   DCHECK(!initial_ranges_issued_.Load());
   initial_ranges_issued_.Store(true);
@@ -649,13 +787,21 @@ Status HdfsScanNodeBase::IssueInitialScanRanges(RuntimeState* state) {
   }
 
   if (filter_ctxs_.size() > 0) WaitForRuntimeFilters();
-  // Apply dynamic partition-pruning per-file.
-  HdfsFileDesc::FileFormatsMap matching_per_type_files;
   std::vector<HdfsFileDesc*>* file_list =
       shared_state_->GetFilesForIssuingScanRangesForInstance(
           runtime_state_->instance_ctx().fragment_instance_id);
   if (file_list == nullptr) return Status::OK();
-  for (HdfsFileDesc* file : *file_list) {
+  RETURN_IF_ERROR(IssueFileRanges(*file_list));
+  // Except for BaseSequenceScanner, IssueInitialRanges() takes care of
+  // issuing all the ranges. For BaseSequenceScanner, IssueInitialRanges()
+  // will have incremented the counter.
+  return Status::OK();
+}
+
+Status HdfsScanNodeBase::IssueFileRanges(const vector<HdfsFileDesc*>& files) {
+  // Apply dynamic partition-pruning per-file.
+  HdfsFileDesc::FileFormatsMap matching_per_type_files;
+  for (HdfsFileDesc* file : files) {
     if (FilePassesFilterPredicates(filter_ctxs_, file->file_format, file)) {
       matching_per_type_files[file->file_format].push_back(file);
     } else {
@@ -681,6 +827,9 @@ Status HdfsScanNodeBase::IssueInitialScanRanges(RuntimeState* state) {
       case THdfsFileFormat::TEXT:
         RETURN_IF_ERROR(HdfsTextScanner::IssueInitialRanges(this, entry.second));
         break;
+      case THdfsFileFormat::JSON:
+        RETURN_IF_ERROR(HdfsJsonScanner::IssueInitialRanges(this, entry.second));
+        break;
       case THdfsFileFormat::SEQUENCE_FILE:
       case THdfsFileFormat::RC_FILE:
       case THdfsFileFormat::AVRO:
@@ -693,9 +842,6 @@ Status HdfsScanNodeBase::IssueInitialScanRanges(RuntimeState* state) {
         DCHECK(false) << "Unexpected file type " << entry.first;
     }
   }
-  // Except for BaseSequenceScanner, IssueInitialRanges() takes care of
-  // issuing all the ranges. For BaseSequenceScanner, IssueInitialRanges()
-  // will have incremented the counter.
   return Status::OK();
 }
 
@@ -725,7 +871,7 @@ void HdfsScanNodeBase::SkipScanRange(io::ScanRange* scan_range) {
                                << " partition_id=" << partition_id << "\n"
                                << PrintThrift(runtime_state_->instance_ctx());
   const HdfsFileDesc* desc = GetFileDesc(partition_id, *scan_range->file_string());
-  if (metadata->is_sequence_header) {
+  if (metadata->is_file_header) {
     // File ranges haven't been issued yet, skip entire file.
     UpdateRemainingScanRangeSubmissions(-1);
     SkipFile(partition->file_format(), desc);
@@ -851,6 +997,9 @@ Status HdfsScanNodeBase::CreateAndOpenScannerHelper(HdfsPartitionDescriptor* par
             this, runtime_state_, it->second));
       }
       break;
+    case THdfsFileFormat::JSON:
+      scanner->reset(new HdfsJsonScanner(this, runtime_state_));
+      break;
     case THdfsFileFormat::SEQUENCE_FILE:
       scanner->reset(new HdfsSequenceScanner(this, runtime_state_));
       break;
@@ -1161,8 +1310,14 @@ void HdfsScanNodeBase::UpdateBytesRead(
 const HdfsFileDesc* ScanRangeSharedState::GetFileDesc(
     int64_t partition_id, const std::string& filename) {
   auto file_desc_map_key = make_pair(partition_id, filename);
-  DCHECK(file_descs_.find(file_desc_map_key) != file_descs_.end());
-  return file_descs_[file_desc_map_key];
+  auto it = file_descs_.find(file_desc_map_key);
+  if (it != file_descs_.end() || !receives_dynamic_scan_ranges_) {
+    DCHECK(it != file_descs_.end());
+    return it->second;
+  }
+  lock_guard<mutex> l(dynamic_scan_ranges_lock_);
+  DCHECK(dynamic_file_descs_.find(file_desc_map_key) != dynamic_file_descs_.end());
+  return dynamic_file_descs_[file_desc_map_key];
 }
 
 void ScanRangeSharedState::SetFileMetadata(
@@ -1183,9 +1338,15 @@ void* ScanRangeSharedState::GetFileMetadata(
 }
 
 Tuple* ScanRangeSharedState::GetTemplateTupleForPartitionId(int64_t partition_id) {
-  DCHECK(partition_template_tuple_map_.find(partition_id)
-      != partition_template_tuple_map_.end());
-  return partition_template_tuple_map_[partition_id];
+  auto it = partition_template_tuple_map_.find(partition_id);
+  if (it != partition_template_tuple_map_.end() || !receives_dynamic_scan_ranges_) {
+    DCHECK(it != partition_template_tuple_map_.end());
+    return it->second;
+  }
+  lock_guard<mutex> l(dynamic_scan_ranges_lock_);
+  DCHECK(dynamic_template_tuple_map_.find(partition_id)
+      != dynamic_template_tuple_map_.end());
+  return dynamic_template_tuple_map_[partition_id];
 }
 
 void ScanRangeSharedState::UpdateRemainingScanRangeSubmissions(int32_t delta) {
@@ -1200,43 +1361,143 @@ void ScanRangeSharedState::UpdateRemainingScanRangeSubmissions(int32_t delta) {
   range_submission_cv_.NotifyAll();
 }
 
+int ScanRangeSharedState::GetScanRangeQueueIdx(
+    const TUniqueId& fragment_instance_id) const {
+  DCHECK(use_mt_scan_node_) << "Should only be called by MT scan nodes";
+  auto it = scan_range_queue_idx_.find(fragment_instance_id);
+  DCHECK(it != scan_range_queue_idx_.end());
+  return it->second;
+}
+
 void ScanRangeSharedState::EnqueueScanRange(
-    const vector<ScanRange*>& ranges, bool at_front) {
+    int queue_idx, const vector<ScanRange*>& ranges, bool at_front) {
   DCHECK(use_mt_scan_node_) << "Should only be called by MT scan nodes";
-  if (!at_front) {
+  InstanceScanRangeQueue* queue = scan_range_queues_[queue_idx].get();
+  {
+    lock_guard<SpinLock> l(queue->lock);
     for (ScanRange* scan_range : ranges) {
-      if(scan_range->UseHdfsCache()){
-        scan_range_queue_.PushFront(scan_range);
-        continue;
+      if (at_front || scan_range->UseHdfsCache()) {
+        queue->ranges.push_front(scan_range);
+      } else {
+        queue->ranges.push_back(scan_range);
       }
-      scan_range_queue_.Enqueue(scan_range);
     }
-  } else {
-    for (ScanRange* scan_range : ranges) {
-      scan_range_queue_.PushFront(scan_range);
+    // Counted under the queue lock so that the count never lags behind the ranges
+    // that other instances can pop, which would make it drop below zero.
+    num_queued_scan_ranges_.Add(ranges.size());
+  }
+  // Wake up instances that found all queues empty and wait for more work.
+  NotifyScanRangeWaiters();
+}
+
+ScanRange* ScanRangeSharedState::PopScanRange(int queue_idx, bool* stolen) {
+  *stolen = false;
+  if (num_queued_scan_ranges_.Load() == 0) return nullptr;
+  InstanceScanRangeQueue* own_queue = scan_range_queues_[queue_idx].get();
+  {
+    lock_guard<SpinLock> l(own_queue->lock);
+    if (!own_queue->ranges.empty()) {
+      ScanRange* range = own_queue->ranges.front();
+      own_queue->ranges.pop_front();
+      num_queued_scan_ranges_.Add(-1);
+      return range;
     }
   }
+  // Steal from the back of the longest queue, i.e. the range its owner would read last.
+  // Retry if another instance emptied the victim in between.
+  while (num_queued_scan_ranges_.Load() > 0) {
+    InstanceScanRangeQueue* victim = nullptr;
+    size_t victim_size = 0;
+    for (const unique_ptr<InstanceScanRangeQueue>& queue : scan_range_queues_) {
+      lock_guard<SpinLock> l(queue->lock);
+      if (queue->ranges.size() > victim_size) {
+        victim = queue.get();
+        victim_size = queue->ranges.size();
+      }
+    }
+    if (victim == nullptr) return nullptr;
+    lock_guard<SpinLock> l(victim->lock);
+    if (victim->ranges.empty()) continue;
+    ScanRange* range = victim->ranges.back();
+    victim->ranges.pop_back();
+    num_queued_scan_ranges_.Add(-1);
+    *stolen = victim != own_queue;
+    return range;
+  }
+  return nullptr;
+}
+
+ScanRange* ScanRangeSharedState::MaybeSplitScanRange(int queue_idx, ScanRange* range) {
+  if (FLAGS_mt_scan_range_split_bytes <= 0) return nullptr;
+  if (range->len() < 2 * FLAGS_mt_scan_range_split_bytes) return nullptr;
+  int64_t num_instances = scan_range_queues_.size();
+  if (num_queued_scan_ranges_.Load() >= num_instances) return nullptr;
+  if (range->UseHdfsCache()) return nullptr;
+  ScanRangeMetadata* metadata = static_cast<ScanRangeMetadata*>(range->meta_data());
+  if (metadata->original_split != nullptr || metadata->is_file_header) {
+    return nullptr;
+  }
+  // The text and JSON scanners start at the first tuple boundary after the start of a
+  // range that does not start the file and read past its end to finish the last tuple,
+  // so uncompressed text and JSON can be split at any offset.
+  const HdfsFileDesc* file_desc = GetFileDesc(metadata->partition_id, range->file());
+  if ((file_desc->file_format != THdfsFileFormat::TEXT
+          && file_desc->file_format != THdfsFileFormat::JSON)
+      || file_desc->file_compression != THdfsCompression::NONE) {
+    return nullptr;
+  }
+  int64_t head_len = range->len() / 2;
+  BufferOpts buffer_opts(range->cache_options());
+  ScanRange* head = ScanRange::AllocateScanRange(&obj_pool_, file_desc->fs,
+      file_desc->filename.c_str(), head_len, range->offset(), {}, metadata,
+      range->disk_id(), range->expected_local(), range->mtime(), buffer_opts);
+  ScanRange* tail = ScanRange::AllocateScanRange(&obj_pool_, file_desc->fs,
+      file_desc->filename.c_str(), range->len() - head_len, range->offset() + head_len,
+      {}, metadata, range->disk_id(), range->expected_local(), range->mtime(),
+      buffer_opts);
+  // One range to read became two.
+  progress_.AddTotal(1);
+  EnqueueScanRange(queue_idx, {tail}, /* at_front */ false);
+  return head;
 }
 
-Status ScanRangeSharedState::GetNextScanRange(
-    RuntimeState* state, ScanRange** scan_range) {
+Status ScanRangeSharedState::GetNextScanRange(RuntimeState* state, int queue_idx,
+    RuntimeProfile::Counter* ranges_stolen_counter,
+    RuntimeProfile::Counter* ranges_split_counter, ScanRange** scan_range) {
   DCHECK(use_mt_scan_node_) << "Should only be called by MT scan nodes";
   while (true) {
-    *scan_range = scan_range_queue_.Dequeue();
-    if (*scan_range != nullptr) return Status::OK();
+    bool stolen;
+    *scan_range = PopScanRange(queue_idx, &stolen);
+    if (*scan_range != nullptr) {
+      if (stolen) COUNTER_ADD(ranges_stolen_counter, 1);
+      ScanRange* head = MaybeSplitScanRange(queue_idx, *scan_range);
+      if (head != nullptr) {
+        COUNTER_ADD(ranges_split_counter, 1);
+        *scan_range = head;
+      }
+      return Status::OK();
+    }
     {
       unique_lock<mutex> l(scan_range_submission_lock_);
-      while (scan_range_queue_.empty() && remaining_scan_range_submissions_.Load() > 0
-          && !state->is_cancelled()) {
+      while (num_queued_scan_ranges_.Load() == 0
+          && num_pending_dynamic_files_.Load() == 0
+          && remaining_scan_range_submissions_.Load() > 0 && !state->is_cancelled()) {
         range_submission_cv_.Wait(l);
       }
     }
+    // Let the caller issue the ranges received from the coordinator.
+    if (num_pending_dynamic_files_.Load() > 0) return Status::OK();
     // No more work to do.
-    if (scan_range_queue_.empty() && remaining_scan_range_submissions_.Load() == 0) {
+    if (num_queued_scan_ranges_.Load() == 0
+        && remaining_scan_range_submissions_.Load() == 0) {
       break;
     }
     if (state->is_cancelled()) return Status::CANCELLED;
   }
+  if (receives_dynamic_scan_ranges_) {
+    lock_guard<mutex> l(dynamic_scan_ranges_lock_);
+    return dynamic_scan_ranges_status_;
+  }
   return Status::OK();
 }
 
@@ -1244,4 +1505,52 @@ void ScanRangeSharedState::AddCancellationHook(RuntimeState* state) {
   DCHECK(use_mt_scan_node_) << "Should only be called by MT scan nodes";
   state->AddCancellationCV(&scan_range_submission_lock_, &range_submission_cv_);
 }
+
+bool ScanRangeSharedState::GetScanRangeRequest(ScanRangeRequestPB* request) {
+  // Wait for all instances to issue their initial ranges before asking for more.
+  if (remaining_scan_range_submissions_.Load() > 1) return false;
+  lock_guard<mutex> l(dynamic_scan_ranges_lock_);
+  if (no_more_dynamic_ranges_) return false;
+  int64_t num_wanted = static_cast<int64_t>(scan_range_queues_.size())
+      - num_queued_scan_ranges_.Load() - pending_dynamic_files_.size();
+  if (num_wanted <= 0) return false;
+  request->set_num_ranges_wanted(num_wanted);
+  request->set_num_ranges_received(num_dynamic_ranges_received_);
+  return true;
+}
+
+Status ScanRangeSharedState::TakeDynamicScanRanges(vector<HdfsFileDesc*>* files) {
+  DCHECK(files->empty());
+  if (num_pending_dynamic_files_.Load() == 0) return Status::OK();
+  lock_guard<mutex> l(dynamic_scan_ranges_lock_);
+  RETURN_IF_ERROR(dynamic_scan_ranges_status_);
+  if (pending_dynamic_files_.empty()) return Status::OK();
+  files->swap(pending_dynamic_files_);
+  num_pending_dynamic_files_.Store(0);
+  ++num_issuing_dynamic_ranges_;
+  return Status::OK();
+}
+
+void ScanRangeSharedState::DoneIssuingDynamicScanRanges() {
+  {
+    lock_guard<mutex> l(dynamic_scan_ranges_lock_);
+    DCHECK_GT(num_issuing_dynamic_ranges_, 0);
+    --num_issuing_dynamic_ranges_;
+    MaybeDoneWithDynamicScanRanges();
+  }
+  NotifyScanRangeWaiters();
+}
+
+void ScanRangeSharedState::MaybeDoneWithDynamicScanRanges() {
+  if (dynamic_submission_done_ || !no_more_dynamic_ranges_) return;
+  if (!pending_dynamic_files_.empty() || num_issuing_dynamic_ranges_ > 0) return;
+  dynamic_submission_done_ = true;
+  UpdateRemainingScanRangeSubmissions(-1);
+}
+
+void ScanRangeSharedState::NotifyScanRangeWaiters() {
+  // Acquire the lock so that no waiting instance misses the notification.
+  { unique_lock<mutex> l(scan_range_submission_lock_); }
+  range_submission_cv_.NotifyAll();
+}
 }
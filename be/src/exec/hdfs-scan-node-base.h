@@ -20,6 +20,7 @@
 #define IMPALA_EXEC_HDFS_SCAN_NODE_BASE_H_
 
 #include <stdint.h>
+#include <deque>
 #include <memory>
 #include <tuple>
 #include <unordered_set>
@@ -33,8 +34,10 @@
 #include "exec/filter-context.h"
 #include "exec/scan-node.h"
 #include "runtime/descriptors.h"
+#include "runtime/hdfs-fs-cache.h"
 #include "runtime/io/request-context.h"
 #include "runtime/io/request-ranges.h"
+#include "runtime/query-state.h"
 #include "util/avro-util.h"
 #include "util/container-util.h"
 #include "util/progress-updater.h"
@@ -105,8 +108,9 @@ struct ScanRangeMetadata {
   const io::ScanRange* original_split;
 
   /// True, if this object belongs to a scan range which is the header of a
-  /// sequence-based file
-  bool is_sequence_header = false;
+  /// sequence-based file or of a gzip-compressed text file. The splits of the file are
+  /// issued by the scanner of the header range.
+  bool is_file_header = false;
 
   ScanRangeMetadata(int64_t partition_id, const io::ScanRange* original_split)
       : partition_id(partition_id), original_split(original_split) { }
@@ -168,27 +172,84 @@ class ScanRangeSharedState {
 
   /// The following public methods are only used by MT scan nodes.
 
-  /// Adds all scan ranges to the queue. If 'at_front' is true or the range has
-  /// USE_HDFS_CACHE option set, then adds it to the front of the queue.
-  void EnqueueScanRange(const std::vector<io::ScanRange*>& ranges, bool at_front);
-
-  /// Sets a reference to the next scan range in input variable 'scan_range' from a queue
-  /// of scan ranges that need to be read. Blocks if there are remaining scan range
-  /// submissions and the queue is empty. Unblocks and returns CANCELLED status in case
-  /// the query was cancelled. 'scan_range' is set to nullptr if no more scan ranges are
-  /// left to read.
-  Status GetNextScanRange(RuntimeState* state, io::ScanRange** scan_range);
+  /// Returns the index of the scan range queue owned by the instance with id
+  /// 'fragment_instance_id'.
+  int GetScanRangeQueueIdx(const TUniqueId& fragment_instance_id) const;
+
+  /// Adds all scan ranges to the queue with index 'queue_idx'. If 'at_front' is true or
+  /// the range has USE_HDFS_CACHE option set, then adds it to the front of the queue.
+  /// Wakes up the instances waiting for ranges in GetNextScanRange().
+  void EnqueueScanRange(
+      int queue_idx, const std::vector<io::ScanRange*>& ranges, bool at_front);
+
+  /// Sets a reference to the next scan range in input variable 'scan_range'. The range
+  /// is taken from the front of the queue with index 'queue_idx' or, if that queue is
+  /// empty, stolen from the back of the longest queue of another instance, in which case
+  /// 'ranges_stolen_counter' is incremented. Large uncompressed text ranges are split in
+  /// two when fewer ranges are queued than there are instances, so that idle instances
+  /// can steal the second half; 'ranges_split_counter' counts these splits. Blocks if
+  /// there are remaining scan range submissions and all queues are empty. Unblocks and
+  /// returns CANCELLED status in case the query was cancelled. 'scan_range' is set to
+  /// nullptr if no more scan ranges are left to read, or if ranges received from the
+  /// coordinator need to be issued first (see HasPendingDynamicScanRanges()).
+  Status GetNextScanRange(RuntimeState* state, int queue_idx,
+      RuntimeProfile::Counter* ranges_stolen_counter,
+      RuntimeProfile::Counter* ranges_split_counter, io::ScanRange** scan_range);
 
   /// Add the required hooks to the runtime state that gets triggered in case of
   /// cancellation. Must be called before adding or removing scan ranges to the queue.
   void AddCancellationHook(RuntimeState* state);
 
+  /// Moves the files of the scan ranges that the coordinator handed out to this node and
+  /// that were not issued yet to 'files'. If any are returned, the caller must issue
+  /// their initial ranges and then call DoneIssuingDynamicScanRanges(). Returns an error
+  /// if the ranges could not be converted.
+  Status TakeDynamicScanRanges(std::vector<HdfsFileDesc*>* files);
+  void DoneIssuingDynamicScanRanges();
+
+  /// Returns true if there are ranges from the coordinator that were not issued yet.
+  bool HasPendingDynamicScanRanges() const {
+    return num_pending_dynamic_files_.Load() > 0;
+  }
+
  private:
   friend class HdfsScanPlanNode;
+  friend class ScanRangeSharedStateTest;
 
   ScanRangeSharedState() = default;
   DISALLOW_COPY_AND_ASSIGN(ScanRangeSharedState);
 
+  /// Queue of scan ranges owned by a single instance. The owner takes ranges from the
+  /// front, other instances steal from the back.
+  struct InstanceScanRangeQueue {
+    SpinLock lock;
+    std::deque<io::ScanRange*> ranges;
+  };
+
+  /// Removes and returns the range at the front of the queue with index 'queue_idx' or,
+  /// if it is empty, the range at the back of the longest other queue. Sets '*stolen' if
+  /// the range came from another queue. Returns nullptr if all queues are empty.
+  io::ScanRange* PopScanRange(int queue_idx, bool* stolen);
+
+  /// Splits 'range' in two halves if it is an uncompressed text range of at least
+  /// twice --mt_scan_range_split_bytes and fewer ranges are queued than there are
+  /// instances. Returns the first half, which the caller reads, and pushes the second
+  /// half to the back of the queue with index 'queue_idx'. Returns nullptr if 'range'
+  /// was not split.
+  io::ScanRange* MaybeSplitScanRange(int queue_idx, io::ScanRange* range);
+
+  /// Returns true and fills 'request' if this node may receive more scan ranges from the
+  /// coordinator and fewer ranges are queued or pending than there are instances.
+  bool GetScanRangeRequest(ScanRangeRequestPB* request);
+
+  /// Gives up the scan range submission held for the ranges handed out by the
+  /// coordinator once all of them have been received and issued. Must be called with
+  /// 'dynamic_scan_ranges_lock_' held.
+  void MaybeDoneWithDynamicScanRanges();
+
+  /// Wakes up all instances waiting in GetNextScanRange().
+  void NotifyScanRangeWaiters();
+
   /// Contains all the file descriptors and the scan ranges created.
   ObjectPool obj_pool_;
 
@@ -243,21 +304,74 @@ class ScanRangeSharedState {
   /// Used by scan instances to wait for remaining scan range submission
   ConditionVariable range_submission_cv_;
 
-  /// Queue of all scan ranges that need to be read. Shared by all instances of this
-  /// fragment. Only used for MT scans.
-  InternalQueue<io::ScanRange> scan_range_queue_;
+  /// Scan ranges that need to be read, one queue per instance of this fragment. Ranges
+  /// are queued by the instance that issues them and work-stolen by idle instances, so
+  /// that an instance that is assigned a few large files does not set the tail latency
+  /// of the whole scan. Only used for MT scans.
+  std::vector<std::unique_ptr<InstanceScanRangeQueue>> scan_range_queues_;
+
+  /// Fragment instance id => index into 'scan_range_queues_'. Populated in
+  /// HdfsScanPlanNode::Init() after which it is never modified.
+  std::unordered_map<TUniqueId, int> scan_range_queue_idx_;
+
+  /// Total number of ranges in 'scan_range_queues_'.
+  AtomicInt64 num_queued_scan_ranges_{0};
+
+  /// True if the coordinator hands out some of the scan ranges of this node while the
+  /// scan runs. One scan range submission is then held until all of those ranges have
+  /// been received and issued. Set in HdfsScanPlanNode::Init().
+  bool receives_dynamic_scan_ranges_ = false;
+
+  /// Number of entries in 'pending_dynamic_files_'. Read without holding the lock by
+  /// instances waiting for scan ranges.
+  AtomicInt32 num_pending_dynamic_files_{0};
+
+  /// Protects the members below.
+  std::mutex dynamic_scan_ranges_lock_;
+
+  /// Descriptors of files that only appear in scan ranges handed out by the coordinator.
+  /// Used by GetFileDesc() for files that are not in 'file_descs_'.
+  HdfsFileDesc::FileDescMap dynamic_file_descs_;
+
+  /// Template tuples of partitions that only appear in scan ranges handed out by the
+  /// coordinator.
+  boost::unordered_map<int64_t, Tuple*> dynamic_template_tuple_map_;
+
+  /// Files with ranges that were received from the coordinator but not issued yet.
+  std::vector<HdfsFileDesc*> pending_dynamic_files_;
+
+  /// Number of ranges received from the coordinator so far.
+  int64_t num_dynamic_ranges_received_ = 0;
+
+  /// Number of instances that are issuing ranges taken from 'pending_dynamic_files_'.
+  int num_issuing_dynamic_ranges_ = 0;
+
+  /// True once the coordinator has no more ranges for this node.
+  bool no_more_dynamic_ranges_ = false;
+
+  /// True once the scan range submission for dynamic ranges was given up.
+  bool dynamic_submission_done_ = false;
+
+  /// Error encountered while converting ranges received from the coordinator.
+  Status dynamic_scan_ranges_status_;
 
   /// END: Members that are used only by MT scan nodes(use_mt_scan_node_ is true).
   /////////////////////////////////////////////////////////////////////
 };
 
-class HdfsScanPlanNode : public ScanPlanNode {
+class HdfsScanPlanNode : public ScanPlanNode, public ScanRangeReceiver {
  public:
   virtual Status Init(const TPlanNode& tnode, FragmentState* state) override;
   virtual void Close() override;
   virtual Status CreateExecNode(RuntimeState* state, ExecNode** node) const override;
   virtual void Codegen(FragmentState* state) override;
 
+  /// ScanRangeReceiver implementation, used if the coordinator hands out some of the
+  /// scan ranges of this node while the scan runs.
+  virtual int node_id() const override { return tnode_->node_id; }
+  virtual bool GetScanRangeRequest(ScanRangeRequestPB* request) override;
+  virtual void AddScanRanges(const ScanRangeGrantPB& grant) override;
+
   /// Returns index into materialized_slots with 'path'.  Returns SKIP_COLUMN if
   /// that path is not materialized. Only valid to call after Init().
   int GetMaterializedSlotIdx(const std::vector<int>& path) const;
@@ -329,6 +443,25 @@ class HdfsScanPlanNode : public ScanPlanNode {
   /// Processes all the scan range params for this scan node to create all the required
   /// file descriptors, update metrics and fill in all relevant state in 'shared_state_'.
   Status ProcessScanRangesAndInitSharedState(FragmentState* state);
+
+  /// Converts 'params' into a scan range of its file's descriptor in 'file_descs'.
+  /// Descriptors that are created are added to 'file_descs' and 'new_files', template
+  /// tuples of new partitions to 'template_tuples'. Increments
+  /// 'num_ranges_missing_volume_id' for local ranges without a volume id.
+  Status AddScanRange(FragmentState* state, const ScanRangeParamsPB& params,
+      HdfsFileDesc::FileDescMap* file_descs,
+      boost::unordered_map<int64_t, Tuple*>* template_tuples,
+      HdfsFsCache::HdfsFsMap* fs_cache, int* num_ranges_missing_volume_id,
+      std::vector<HdfsFileDesc*>* new_files);
+
+  /// Converts the ranges of 'grant' starting at 'first_idx' and queues their files in
+  /// 'shared_state_' for issuing. Must be called with
+  /// 'shared_state_.dynamic_scan_ranges_lock_' held.
+  Status AddDynamicScanRanges(const ScanRangeGrantPB& grant, int first_idx);
+
+  /// Set in Init() if the coordinator hands out some of the scan ranges of this node
+  /// while the scan runs, in which case this node is registered as ScanRangeReceiver.
+  FragmentState* dynamic_scan_ranges_state_ = nullptr;
   /// Per scanner type codegen'd fn.
   /// The actual types of the functions differ so we use void* as the common type and
   /// reinterpret cast before calling the functions.
@@ -774,6 +907,19 @@ class HdfsScanNodeBase : public ScanNode {
   /// Pointer to the scan range related state that is shared across all node instances.
   ScanRangeSharedState* shared_state_ = nullptr;
 
+  /// Keys of the filters in 'filter_ctxs_' in FilterEffectivenessHistory. Empty for
+  /// filters that are not tracked, e.g. filters on partition columns, which are used
+  /// to prune files regardless of how many rows they reject.
+  std::vector<std::string> filter_history_keys_;
+
+  /// Returns true if the filter was ineffective on this target in past scans, see
+  /// FilterEffectivenessHistory. Scans do not wait for such filters to arrive.
+  virtual bool SkipWaitForFilter(int filter_idx) const override;
+
+  /// Records the rejection ratios of the filters applied by this scan in
+  /// FilterEffectivenessHistory.
+  void UpdateFilterEffectivenessHistory();
+
   /// Performs dynamic partition pruning, i.e., applies runtime filters to files, and
   /// issues initial ranges for all file types. Waits for runtime filters if necessary.
   /// Only valid to call if !initial_ranges_issued_. Sets initial_ranges_issued_ to true.
@@ -781,6 +927,11 @@ class HdfsScanNodeBase : public ScanNode {
   /// scanner thread cancels the scan when it runs into an error.
   Status IssueInitialScanRanges(RuntimeState* state) WARN_UNUSED_RESULT;
 
+  /// Applies runtime filters to 'files' and issues initial ranges for the files that
+  /// pass them. Used by IssueInitialScanRanges() and for the ranges that the coordinator
+  /// hands out while the scan runs.
+  Status IssueFileRanges(const std::vector<HdfsFileDesc*>& files) WARN_UNUSED_RESULT;
+
   /// Gets the next scan range to process and allocates buffer for it. 'reservation' is
   /// an in/out argument with the current reservation available for this range. It may
   /// be increased by this function up to a computed "ideal" reservation, in which case
@@ -35,6 +35,12 @@ using namespace impala::io;
 
 namespace impala {
 
+PROFILE_DEFINE_COUNTER(ScanRangesStolen, STABLE_LOW, TUnit::UNIT,
+    "Number of scan ranges this instance stole from the queue of another instance.");
+PROFILE_DEFINE_COUNTER(ScanRangesSplit, DEBUG, TUnit::UNIT,
+    "Number of large unstarted scan ranges this instance split in two so that idle "
+    "instances could steal the second half.");
+
 HdfsScanNodeMt::HdfsScanNodeMt(
     ObjectPool* pool, const HdfsScanPlanNode& pnode, const DescriptorTbl& descs)
   : HdfsScanNodeBase(pool, pnode, pnode.tnode_->hdfs_scan_node, descs),
@@ -46,6 +52,10 @@ HdfsScanNodeMt::~HdfsScanNodeMt() {
 
 Status HdfsScanNodeMt::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(HdfsScanNodeBase::Prepare(state));
+  scan_range_queue_idx_ =
+      shared_state_->GetScanRangeQueueIdx(state->fragment_instance_id());
+  scan_ranges_stolen_counter_ = PROFILE_ScanRangesStolen.Instantiate(runtime_profile());
+  scan_ranges_split_counter_ = PROFILE_ScanRangesSplit.Instantiate(runtime_profile());
   return Status::OK();
 }
 
@@ -154,16 +164,30 @@ Status HdfsScanNodeMt::AddDiskIoRanges(
   if (enqueue_location == EnqueueLocation::HEAD) {
     at_front = true;
   }
-  shared_state_->EnqueueScanRange(ranges, at_front);
+  shared_state_->EnqueueScanRange(scan_range_queue_idx_, ranges, at_front);
   return Status::OK();
 }
 
 Status HdfsScanNodeMt::GetNextScanRangeToRead(
     io::ScanRange** scan_range, bool* needs_buffers) {
-  RETURN_IF_ERROR(shared_state_->GetNextScanRange(runtime_state_, scan_range));
+  do {
+    RETURN_IF_ERROR(IssueDynamicScanRanges());
+    RETURN_IF_ERROR(shared_state_->GetNextScanRange(runtime_state_,
+        scan_range_queue_idx_, scan_ranges_stolen_counter_, scan_ranges_split_counter_,
+        scan_range));
+  } while (*scan_range == nullptr && shared_state_->HasPendingDynamicScanRanges());
   if (*scan_range != nullptr) {
     RETURN_IF_ERROR(reader_context_->StartScanRange(*scan_range, needs_buffers));
   }
   return Status::OK();
 }
+
+Status HdfsScanNodeMt::IssueDynamicScanRanges() {
+  vector<HdfsFileDesc*> files;
+  RETURN_IF_ERROR(shared_state_->TakeDynamicScanRanges(&files));
+  if (files.empty()) return Status::OK();
+  Status status = IssueFileRanges(files);
+  shared_state_->DoneIssuingDynamicScanRanges();
+  return status;
+}
 }
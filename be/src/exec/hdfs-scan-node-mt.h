@@ -50,21 +50,36 @@ class HdfsScanNodeMt : public HdfsScanNodeBase {
   virtual bool HasRowBatchQueue() const override { return false; }
   virtual ExecutionModel getExecutionModel() const override { return TASK_BASED; }
 
-  /// Adds the range to a queue shared among all instances of this scan node.
+  /// Adds the range to the queue of this instance, from which idle instances of this
+  /// scan node may steal it.
   Status AddDiskIoRanges(const std::vector<io::ScanRange*>& ranges,
         EnqueueLocation enqueue_location = EnqueueLocation::TAIL) override;
 
  protected:
-  /// Fetches the next range to read from a queue shared among all instances of this scan
-  /// node. Also schedules it to be read by disk threads via the reader context.
+  /// Fetches the next range to read from the queue of this instance, or steals one from
+  /// another instance of this scan node. Also schedules it to be read by disk threads via
+  /// the reader context.
   Status GetNextScanRangeToRead(io::ScanRange** scan_range, bool* needs_buffers) override;
 
  private:
+  /// Issues the initial ranges of files with scan ranges that the coordinator handed out
+  /// to this scan node and that no instance has issued yet.
+  Status IssueDynamicScanRanges();
+
   /// Create and open new scanner for this partition type.
   /// If the scanner is successfully created and opened, it is returned in 'scanner'.
   Status CreateAndOpenScanner(HdfsPartitionDescriptor* partition,
       ScannerContext* context, boost::scoped_ptr<HdfsScanner>* scanner);
 
+  /// Index of the scan range queue owned by this instance in the shared state.
+  int scan_range_queue_idx_ = -1;
+
+  /// Number of scan ranges stolen from other instances.
+  RuntimeProfile::Counter* scan_ranges_stolen_counter_ = nullptr;
+
+  /// Number of scan ranges split in two for other instances to steal.
+  RuntimeProfile::Counter* scan_ranges_split_counter_ = nullptr;
+
   /// Current scan range and corresponding scanner.
   io::ScanRange* scan_range_;
   boost::scoped_ptr<ScannerContext> scanner_ctx_;
@@ -221,13 +221,15 @@ int64_t HdfsScanNode::EstimateScannerThreadMemConsumption() const {
 
   // Next add in the other memory that we estimate the scanner thread will use,
   // e.g. decompression buffers, tuple buffers, etc.
-  // For compressed text, we estimate this based on the file size (since the whole file
-  // will need to be decompressed at once). For all other formats, we use a constant.
+  // For compressed text and JSON, we estimate this based on the file size (since the
+  // whole file will need to be decompressed at once). For all other formats, we use a
+  // constant.
   // Note: this is crude and we could try to refine it by factoring in the number of
   // columns, etc, but it is unclear how beneficial this would be.
   int64_t est_non_reserved_bytes = FLAGS_hdfs_scanner_thread_max_estimated_bytes;
-  auto it = shared_state_->per_type_files().find(THdfsFileFormat::TEXT);
-  if (it != shared_state_->per_type_files().end()) {
+  for (THdfsFileFormat::type format : {THdfsFileFormat::TEXT, THdfsFileFormat::JSON}) {
+    auto it = shared_state_->per_type_files().find(format);
+    if (it == shared_state_->per_type_files().end()) continue;
     for (HdfsFileDesc* file : it->second) {
       if (file->file_compression != THdfsCompression::NONE) {
         int64_t compressed_text_est_bytes =
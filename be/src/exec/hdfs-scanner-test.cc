@@ -0,0 +1,178 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-scanner.h"
+
+#include <gflags/gflags.h>
+
+#include "exec/filter-context.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+DECLARE_double(min_filter_reject_ratio);
+DECLARE_bool(skip_wait_for_ineffective_runtime_filters);
+
+namespace impala {
+
+class HdfsScannerTest : public testing::Test {
+ protected:
+  typedef HdfsScanner::LocalFilterStats LocalFilterStats;
+  typedef LocalFilterStats::EffectivenessChange EffectivenessChange;
+
+  // Simulates a check interval of 'rows' rows. If the filter is enabled, it rejects
+  // 'rejected' of them. Then checks the effectiveness of the filter and returns the
+  // result. '*rows_skipped' is set to the rows skipped by the check, if not NULL.
+  static EffectivenessChange RunInterval(LocalFilterStats* stats, int64_t rows,
+      int64_t rejected, bool is_bloom_filter = true, int64_t* rows_skipped = nullptr) {
+    stats->total_possible += rows;
+    if (stats->enabled_for_row) {
+      stats->considered += rows;
+      stats->rejected += rejected;
+    }
+    int64_t skipped;
+    EffectivenessChange change =
+        stats->CheckEffectiveness(false, true, is_bloom_filter, &skipped);
+    if (rows_skipped != nullptr) *rows_skipped = skipped;
+    return change;
+  }
+};
+
+// Test that a filter that rejects too few rows is disabled, that the rows it is not
+// evaluated on are counted, and that it is re-enabled after the backoff.
+TEST_F(HdfsScannerTest, FilterDisabledAndReenabled) {
+  LocalFilterStats stats;
+  int64_t rows_skipped;
+  EXPECT_EQ(EffectivenessChange::DISABLED, RunInterval(&stats, 1000, 10));
+  EXPECT_FALSE(stats.enabled_for_row);
+  EXPECT_TRUE(stats.disabled_as_ineffective);
+  EXPECT_FLOAT_EQ(0.01, stats.decayed_reject_ratio);
+
+  // Re-enabled after one check, after which the rows skipped in the interval count.
+  EXPECT_EQ(EffectivenessChange::REENABLED,
+      RunInterval(&stats, 500, 0, true, &rows_skipped));
+  EXPECT_EQ(500, rows_skipped);
+  EXPECT_TRUE(stats.enabled_for_row);
+  EXPECT_FALSE(stats.disabled_as_ineffective);
+
+  // Still ineffective: the backoff doubles to two checks.
+  EXPECT_EQ(EffectivenessChange::DISABLED, RunInterval(&stats, 1000, 10));
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&stats, 1000, 0, true, &rows_skipped));
+  EXPECT_EQ(1000, rows_skipped);
+  EXPECT_FALSE(stats.enabled_for_row);
+  EXPECT_EQ(EffectivenessChange::REENABLED, RunInterval(&stats, 1000, 0));
+
+  // The filter became selective. The decayed ratio rises above the threshold, so it
+  // stays enabled and the backoff is reset.
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&stats, 1000, 900));
+  EXPECT_TRUE(stats.enabled_for_row);
+  EXPECT_GE(stats.decayed_reject_ratio, FLAGS_min_filter_reject_ratio);
+  EXPECT_EQ(1, stats.reenable_backoff);
+}
+
+// Test that a single interval with a low rejection ratio does not disable an effective
+// filter, but that a filter that stays ineffective is disabled once the decayed ratio
+// falls below the threshold.
+TEST_F(HdfsScannerTest, FilterRejectRatioDecays) {
+  LocalFilterStats stats;
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&stats, 1000, 900));
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&stats, 1000, 0));
+  EXPECT_FLOAT_EQ(0.45, stats.decayed_reject_ratio);
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&stats, 1000, 0));
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&stats, 1000, 0));
+  EXPECT_TRUE(stats.enabled_for_row);
+  EXPECT_EQ(EffectivenessChange::DISABLED, RunInterval(&stats, 1000, 0));
+  EXPECT_LT(stats.decayed_reject_ratio, FLAGS_min_filter_reject_ratio);
+
+  // Intervals in which the filter was not evaluated do not change the ratio.
+  LocalFilterStats not_evaluated;
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&not_evaluated, 0, 0));
+  EXPECT_LT(not_evaluated.decayed_reject_ratio, 0);
+  EXPECT_TRUE(not_evaluated.enabled_for_row);
+}
+
+// Test that the backoff before re-enabling a filter is capped.
+TEST_F(HdfsScannerTest, FilterReenableBackoffCapped) {
+  LocalFilterStats stats;
+  int expected_backoff = 1;
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(EffectivenessChange::DISABLED, RunInterval(&stats, 1000, 0));
+    EXPECT_EQ(expected_backoff, stats.checks_until_reenable);
+    for (int j = 1; j < expected_backoff; ++j) {
+      ASSERT_EQ(EffectivenessChange::NONE, RunInterval(&stats, 1000, 0));
+    }
+    ASSERT_EQ(EffectivenessChange::REENABLED, RunInterval(&stats, 1000, 0));
+    expected_backoff = min(2 * expected_backoff, MAX_FILTER_REENABLE_BACKOFF);
+  }
+  EXPECT_EQ(MAX_FILTER_REENABLE_BACKOFF, expected_backoff);
+}
+
+// Test that min-max filters and always true filters are not re-enabled.
+TEST_F(HdfsScannerTest, FilterNotReenabled) {
+  LocalFilterStats min_max_stats;
+  EXPECT_EQ(EffectivenessChange::DISABLED, RunInterval(&min_max_stats, 1000, 0, false));
+  for (int i = 0; i < 2 * MAX_FILTER_REENABLE_BACKOFF; ++i) {
+    ASSERT_EQ(EffectivenessChange::NONE, RunInterval(&min_max_stats, 1000, 0, false));
+  }
+  EXPECT_FALSE(min_max_stats.enabled_for_row);
+
+  LocalFilterStats always_true_stats;
+  EXPECT_EQ(EffectivenessChange::DISABLED, RunInterval(&always_true_stats, 1000, 0));
+  int64_t rows_skipped;
+  EXPECT_EQ(EffectivenessChange::NONE,
+      always_true_stats.CheckEffectiveness(true, true, true, &rows_skipped));
+  EXPECT_EQ(0, rows_skipped);
+  EXPECT_FALSE(always_true_stats.enabled_for_row);
+  EXPECT_FALSE(always_true_stats.disabled_as_ineffective);
+  EXPECT_EQ(EffectivenessChange::NONE, RunInterval(&always_true_stats, 1000, 0));
+  EXPECT_FALSE(always_true_stats.enabled_for_row);
+}
+
+// Test that scans skip waiting for a filter only once it was ineffective in enough
+// large past scans, and wait again once it became effective.
+TEST_F(HdfsScannerTest, SkipWaitForIneffectiveFilter) {
+  gflags::FlagSaver saver;
+  FLAGS_skip_wait_for_ineffective_runtime_filters = true;
+  FilterEffectivenessHistory history;
+  const string key = "db.tbl:1:0";
+  const int64_t rows = 1024 * 1024;
+  EXPECT_FALSE(history.SkipWaitForFilter(key));
+  history.Update(key, rows, 0);
+  // A single scan is not enough.
+  EXPECT_FALSE(history.IsIneffective(key));
+  EXPECT_FALSE(history.SkipWaitForFilter(key));
+  // Small scans are ignored.
+  history.Update(key, 100, 0);
+  EXPECT_FALSE(history.SkipWaitForFilter(key));
+  history.Update(key, rows, rows / 100);
+  EXPECT_TRUE(history.IsIneffective(key));
+  EXPECT_TRUE(history.SkipWaitForFilter(key));
+  // Other targets are not affected.
+  EXPECT_FALSE(history.SkipWaitForFilter("db.tbl:2:0"));
+  EXPECT_FALSE(history.SkipWaitForFilter(""));
+
+  FLAGS_skip_wait_for_ineffective_runtime_filters = false;
+  EXPECT_TRUE(history.IsIneffective(key));
+  EXPECT_FALSE(history.SkipWaitForFilter(key));
+  FLAGS_skip_wait_for_ineffective_runtime_filters = true;
+
+  // The filter became effective: the decayed ratio rises above the threshold.
+  history.Update(key, rows, rows / 2);
+  EXPECT_FALSE(history.SkipWaitForFilter(key));
+}
+
+}
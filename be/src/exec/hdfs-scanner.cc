@@ -813,16 +813,76 @@ void HdfsScanner::ReportColumnParseError(const SlotDescriptor* desc,
 
 void HdfsScanner::CheckFiltersEffectiveness() {
   for (int i = 0; i < filter_stats_.size(); ++i) {
-    LocalFilterStats* stats = &filter_stats_[i];
-    const RuntimeFilter* filter = filter_ctxs_[i]->filter;
-    double reject_ratio = stats->rejected / static_cast<double>(stats->considered);
-    if (filter->AlwaysTrue() ||
-        reject_ratio < FLAGS_min_filter_reject_ratio) {
-      stats->enabled_for_row = 0;
+    const FilterContext* ctx = filter_ctxs_[i];
+    const RuntimeFilter* filter = ctx->filter;
+    int64_t rows_skipped = 0;
+    LocalFilterStats::EffectivenessChange change = filter_stats_[i].CheckEffectiveness(
+        filter->AlwaysTrue(), filter->HasFilter(), filter->is_bloom_filter(),
+        &rows_skipped);
+    if (rows_skipped > 0) ctx->stats->AddRowsSkippedAsIneffective(rows_skipped);
+    if (change == LocalFilterStats::EffectivenessChange::DISABLED) {
+      VLOG(3) << "Disabling ineffective filter " << filter->id() << " with decayed "
+              << "reject ratio " << filter_stats_[i].decayed_reject_ratio << " for "
+              << static_cast<int>(filter_stats_[i].checks_until_reenable) << " checks";
+      ctx->stats->IncrDisabledAsIneffective();
+    } else if (change == LocalFilterStats::EffectivenessChange::REENABLED) {
+      ctx->stats->IncrReenabled();
     }
   }
 }
 
+HdfsScanner::LocalFilterStats::EffectivenessChange
+HdfsScanner::LocalFilterStats::CheckEffectiveness(bool always_true, bool has_filter,
+    bool is_bloom_filter, int64_t* rows_skipped) {
+  int64_t considered_since_check = considered - considered_at_last_check;
+  int64_t rejected_since_check = rejected - rejected_at_last_check;
+  int64_t total_possible_since_check = total_possible - total_possible_at_last_check;
+  considered_at_last_check = considered;
+  rejected_at_last_check = rejected;
+  total_possible_at_last_check = total_possible;
+  *rows_skipped = 0;
+
+  if (always_true) {
+    enabled_for_row = 0;
+    disabled_as_ineffective = 0;
+    return EffectivenessChange::NONE;
+  }
+  if (disabled_as_ineffective) {
+    DCHECK(!enabled_for_row);
+    if (has_filter) *rows_skipped = total_possible_since_check;
+    // Only Bloom filters are re-enabled. Min-max filters may also have been disabled
+    // for the row group or page level in the meantime, see HdfsParquetScanner.
+    if (!is_bloom_filter || --checks_until_reenable > 0) {
+      return EffectivenessChange::NONE;
+    }
+    disabled_as_ineffective = 0;
+    enabled_for_row = 1;
+    return EffectivenessChange::REENABLED;
+  }
+  // Skip filters that were disabled for other reasons or not evaluated since the
+  // last check, e.g. because they had not arrived yet.
+  if (!enabled_for_row || considered_since_check == 0) return EffectivenessChange::NONE;
+
+  float reject_ratio = rejected_since_check / static_cast<float>(considered_since_check);
+  if (decayed_reject_ratio < 0) {
+    decayed_reject_ratio = reject_ratio;
+  } else {
+    decayed_reject_ratio = FILTER_REJECT_RATIO_DECAY_WEIGHT * reject_ratio
+        + (1 - FILTER_REJECT_RATIO_DECAY_WEIGHT) * decayed_reject_ratio;
+  }
+  if (decayed_reject_ratio >= FLAGS_min_filter_reject_ratio) {
+    // The filter is effective (again), so re-measure it soon if it becomes
+    // ineffective later.
+    reenable_backoff = 1;
+    return EffectivenessChange::NONE;
+  }
+  enabled_for_row = 0;
+  disabled_as_ineffective = 1;
+  checks_until_reenable = reenable_backoff;
+  reenable_backoff = min(2 * reenable_backoff, MAX_FILTER_REENABLE_BACKOFF);
+  return EffectivenessChange::DISABLED;
+}
+
 Status HdfsScanner::IssueFooterRanges(HdfsScanNodeBase* scan_node,
     const THdfsFileFormat::type& file_type, const vector<HdfsFileDesc*>& files) {
   DCHECK(!files.empty());
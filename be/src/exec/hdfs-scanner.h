@@ -56,6 +56,13 @@ constexpr int BATCHES_PER_FILTER_SELECTIVITY_CHECK = 16;
 static_assert(BitUtil::IsPowerOf2(BATCHES_PER_FILTER_SELECTIVITY_CHECK),
               "BATCHES_PER_FILTER_SELECTIVITY_CHECK must be a power of two");
 
+// The maximum number of checks that a filter that was disabled as ineffective stays
+// disabled before it is re-enabled to re-measure its rejection ratio.
+constexpr int MAX_FILTER_REENABLE_BACKOFF = 64;
+
+// The weight of the latest check interval in the decayed rejection ratio of a filter.
+constexpr float FILTER_REJECT_RATIO_DECAY_WEIGHT = 0.5;
+
 /// Intermediate structure used for two pass parsing approach. In the first pass,
 /// the FieldLocation structs are filled out and contain where all the fields start and
 /// their lengths.  In the second pass, the FieldLocation is used to write out the
@@ -220,6 +227,8 @@ class HdfsScanner {
   static const char* LLVM_CLASS_NAME;
 
  protected:
+  friend class HdfsScannerTest;
+
   /// The scan node that started this scanner
   HdfsScanNodeBase* scan_node_;
 
@@ -336,6 +345,16 @@ class HdfsScanner {
     /// available from row 0).
     int64_t total_possible;
 
+    /// Values of 'considered', 'rejected' and 'total_possible' at the last effectiveness
+    /// check.
+    int64_t considered_at_last_check;
+    int64_t rejected_at_last_check;
+    int64_t total_possible_at_last_check;
+
+    /// Exponentially decayed ratio of rows rejected by the filter across effectiveness
+    /// checks. Negative until the filter was evaluated in one check interval.
+    float decayed_reject_ratio;
+
     /// Use known-width type to act as logical boolean.  Set to 1 if corresponding filter
     /// in filter_ctxs_ should be applied at row level, 0 if it was ineffective and was
     /// disabled.
@@ -347,17 +366,48 @@ class HdfsScanner {
     /// Apply the filter at row group level only.
     uint8_t enabled_for_rowgroup;
 
+    /// Set to 1 if 'enabled_for_row' was cleared by CheckFiltersEffectiveness() because
+    /// the filter rejected too few rows. Such filters may be re-enabled later.
+    uint8_t disabled_as_ineffective;
+
+    /// Number of effectiveness checks to wait before re-enabling a filter that was
+    /// disabled as ineffective. Doubles every time the filter is found ineffective
+    /// again, up to MAX_FILTER_REENABLE_BACKOFF.
+    uint8_t reenable_backoff;
+
+    /// Number of remaining effectiveness checks until the filter is re-enabled.
+    uint8_t checks_until_reenable;
+
     /// Padding to ensure structs do not straddle cache-line boundary.
-    uint8_t padding[5];
+    uint8_t padding[6];
 
     LocalFilterStats()
       : considered(0),
         rejected(0),
         total_possible(0),
+        considered_at_last_check(0),
+        rejected_at_last_check(0),
+        total_possible_at_last_check(0),
+        decayed_reject_ratio(-1),
         enabled_for_row(1),
         enabled_for_page(1),
-        enabled_for_rowgroup(1) {}
+        enabled_for_rowgroup(1),
+        disabled_as_ineffective(0),
+        reenable_backoff(1),
+        checks_until_reenable(0) {}
+
+    /// The result of CheckEffectiveness().
+    enum class EffectivenessChange { NONE, DISABLED, REENABLED };
+
+    /// Implements CheckFiltersEffectiveness() for a single filter, whose state is given
+    /// by 'always_true', 'has_filter' and 'is_bloom_filter'. Sets '*rows_skipped' to the
+    /// number of rows that the filter was not evaluated on since the last check because
+    /// it was disabled as ineffective. Returns whether the filter was disabled or
+    /// re-enabled by this check.
+    EffectivenessChange CheckEffectiveness(bool always_true, bool has_filter,
+        bool is_bloom_filter, int64_t* rows_skipped);
   };
+  static_assert(sizeof(LocalFilterStats) == 64, "LocalFilterStats must be 64 bytes");
 
   /// Cached runtime filter contexts, one for each filter that applies to this column.
   vector<const FilterContext *> filter_ctxs_;
@@ -380,7 +430,12 @@ class HdfsScanner {
       "just don't forget to increase READ_SIZE_MIN_VALUE as well.");
 
   /// Check runtime filters' effectiveness every BATCHES_PER_FILTER_SELECTIVITY_CHECK
-  /// row batches. Will update 'filter_stats_'.
+  /// row batches. Will update 'filter_stats_'. The rejection ratio of each filter in the
+  /// last check interval is folded into an exponentially decayed ratio. A filter whose
+  /// decayed ratio drops below --min_filter_reject_ratio is no longer evaluated on rows.
+  /// Bloom filters disabled this way are re-enabled for one check interval after an
+  /// exponentially increasing number of checks, so that a filter whose effectiveness
+  /// changes over the course of the scan, e.g. with sorted data, is applied again.
   void CheckFiltersEffectiveness();
 
   /// Evaluates 'row' against the i-th runtime filter for this scan node and returns
@@ -108,6 +108,8 @@ Status HdfsSequenceScanner::InitNewRange() {
   SeqFileHeader* seq_header = reinterpret_cast<SeqFileHeader*>(header_);
   if (seq_header->is_compressed) {
     RETURN_IF_ERROR(UpdateDecompressor(header_->codec));
+    // Records of row-compressed files are too small to decompress in another thread.
+    if (!seq_header->is_row_compressed) RETURN_IF_ERROR(StartAsyncDecompression());
   }
 
   // Initialize codegen fn
@@ -192,6 +194,8 @@ inline Status HdfsSequenceScanner::GetRecord(uint8_t** record_ptr,
 //   c. Materialize those field locations to row batches
 // 3. Read the sync indicator and check the sync block
 // This mimics the technique for text.
+// With pipelined decompression, step 1 only waits for the decompression of the block
+// that was read ahead, and the next block and its sync are read before step 2.
 // This function only returns on error or when the entire scan range is complete.
 Status HdfsSequenceScanner::ProcessBlockCompressedScanRange(RowBatch* row_batch) {
   DCHECK(header_->is_compressed);
@@ -199,14 +203,19 @@ Status HdfsSequenceScanner::ProcessBlockCompressedScanRange(RowBatch* row_batch)
   if (num_buffered_records_in_compressed_block_ == 0) {
     // We are reading a new compressed block. Pass the previous buffer pool bytes to the
     // batch. We don't need them anymore.
-    if (!decompressor_->reuse_output_buffer()) {
+    if (async_decompressor_ != nullptr || !decompressor_->reuse_output_buffer()) {
       row_batch->tuple_data_pool()->AcquireData(data_buffer_pool_.get(), false);
       RETURN_IF_ERROR(CommitRows(0, row_batch));
       if (row_batch->AtCapacity()) return Status::OK();
     }
     // Step 1
-    RETURN_IF_ERROR(ReadCompressedBlock());
-    if (num_buffered_records_in_compressed_block_ < 0) return parse_status_;
+    if (async_decompressor_ != nullptr) {
+      RETURN_IF_ERROR(NextPipelinedBlock());
+      if (eos_) return Status::OK();
+    } else {
+      RETURN_IF_ERROR(ReadCompressedBlock());
+      if (num_buffered_records_in_compressed_block_ < 0) return parse_status_;
+    }
   }
 
   // Step 2
@@ -215,32 +224,36 @@ Status HdfsSequenceScanner::ProcessBlockCompressedScanRange(RowBatch* row_batch)
     if (row_batch->AtCapacity() || scan_node_->ReachedLimitShared()) break;
   }
 
-  if (num_buffered_records_in_compressed_block_ == 0) {
-    // SequenceFiles don't end with syncs.
-    if (stream_->eof()) {
-      eos_ = true;
-      return Status::OK();
-    }
-
-    // Step 3
-    int sync_indicator;
-    RETURN_IF_FALSE(stream_->ReadInt(&sync_indicator, &parse_status_));
-    if (sync_indicator != -1) {
-      if (state_->LogHasSpace()) {
-        stringstream ss;
-        ss << stream_->filename() << " Expecting sync indicator (-1) at file offset "
-           << (stream_->file_offset() - sizeof(int)) << ".  "
-           << "Sync indicator found " << sync_indicator << ".";
-        state_->LogError(ErrorMsg(TErrorCode::GENERAL, ss.str()));
-      }
-      return Status("Bad sync hash");
-    }
-    RETURN_IF_ERROR(ReadSync());
+  // Step 3, unless the sync was already read ahead.
+  if (num_buffered_records_in_compressed_block_ == 0 && async_decompressor_ == nullptr) {
+    RETURN_IF_ERROR(ReadBlockSync());
   }
 
   return Status::OK();
 }
 
+Status HdfsSequenceScanner::ReadBlockSync() {
+  // SequenceFiles don't end with syncs.
+  if (stream_->eof()) {
+    eos_ = true;
+    return Status::OK();
+  }
+
+  int sync_indicator;
+  RETURN_IF_FALSE(stream_->ReadInt(&sync_indicator, &parse_status_));
+  if (sync_indicator != -1) {
+    if (state_->LogHasSpace()) {
+      stringstream ss;
+      ss << stream_->filename() << " Expecting sync indicator (-1) at file offset "
+         << (stream_->file_offset() - sizeof(int)) << ".  "
+         << "Sync indicator found " << sync_indicator << ".";
+      state_->LogError(ErrorMsg(TErrorCode::GENERAL, ss.str()));
+    }
+    return Status("Bad sync hash");
+  }
+  return ReadSync();
+}
+
 Status HdfsSequenceScanner::ProcessDecompressedBlock(RowBatch* row_batch) {
   int64_t max_tuples = row_batch->capacity() - row_batch->num_rows();
   int num_to_process = min(max_tuples, num_buffered_records_in_compressed_block_);
@@ -522,6 +535,28 @@ Status HdfsSequenceScanner::ReadBlockHeader() {
 
 Status HdfsSequenceScanner::ReadCompressedBlock() {
   int64_t num_buffered_records;
+  uint8_t* compressed_data = nullptr;
+  int64_t block_size = 0;
+  RETURN_IF_ERROR(
+      ReadCompressedBlockData(&num_buffered_records, &compressed_data, &block_size));
+
+  {
+    int64_t len;
+    SCOPED_TIMER(decompress_timer_);
+    RETURN_IF_ERROR(decompressor_->ProcessBlock(false, block_size, compressed_data,
+                                                &len, &unparsed_data_buffer_));
+    VLOG_FILE << "Decompressed " << block_size << " to " << len;
+    next_record_in_compressed_block_ = unparsed_data_buffer_;
+    next_record_in_compressed_block_len_ = len;
+    data_buffer_end_ = unparsed_data_buffer_ + len;
+  }
+  num_buffered_records_in_compressed_block_ = num_buffered_records;
+  return Status::OK();
+}
+
+Status HdfsSequenceScanner::ReadCompressedBlockData(int64_t* num_records,
+    uint8_t** compressed_data, int64_t* block_size) {
+  int64_t num_buffered_records;
   RETURN_IF_FALSE(stream_->ReadVLong(
       &num_buffered_records, &parse_status_));
   if (num_buffered_records < 0) {
@@ -543,28 +578,41 @@ Status HdfsSequenceScanner::ReadCompressedBlock() {
   RETURN_IF_FALSE(stream_->SkipText(&parse_status_));
 
   // Read the compressed value buffer from the unbuffered stream.
-  int64_t block_size = 0;
-  RETURN_IF_FALSE(stream_->ReadVLong(&block_size, &parse_status_));
+  RETURN_IF_FALSE(stream_->ReadVLong(block_size, &parse_status_));
   // Check for a reasonable size
-  if (block_size > MAX_BLOCK_SIZE || block_size < 0) {
+  if (*block_size > MAX_BLOCK_SIZE || *block_size < 0) {
     stringstream ss;
-    ss << stream_->filename() << " Compressed block size is: " << block_size;
+    ss << stream_->filename() << " Compressed block size is: " << *block_size;
     return Status(ss.str());
   }
 
+  RETURN_IF_FALSE(stream_->ReadBytes(*block_size, compressed_data, &parse_status_));
+  *num_records = num_buffered_records;
+  return Status::OK();
+}
+
+Status HdfsSequenceScanner::ReadBlockAhead() {
   uint8_t* compressed_data = nullptr;
-  RETURN_IF_FALSE(stream_->ReadBytes(block_size, &compressed_data, &parse_status_));
+  int64_t block_size = 0;
+  RETURN_IF_ERROR(ReadCompressedBlockData(
+      &num_records_in_block_read_ahead_, &compressed_data, &block_size));
+  RETURN_IF_ERROR(async_decompressor_->AddBlock(compressed_data, block_size));
+  async_decompressor_->StartBatch();
+  return ReadBlockSync();
+}
 
-  {
-    int64_t len;
-    SCOPED_TIMER(decompress_timer_);
-    RETURN_IF_ERROR(decompressor_->ProcessBlock(false, block_size, compressed_data,
-                                                &len, &unparsed_data_buffer_));
-    VLOG_FILE << "Decompressed " << block_size << " to " << len;
-    next_record_in_compressed_block_ = unparsed_data_buffer_;
-    next_record_in_compressed_block_len_ = len;
-    data_buffer_end_ = unparsed_data_buffer_ + len;
-  }
-  num_buffered_records_in_compressed_block_ = num_buffered_records;
+Status HdfsSequenceScanner::NextPipelinedBlock() {
+  vector<AsyncBlockDecompressor::Output> outputs;
+  RETURN_IF_ERROR(NextBlockReadAhead(&outputs));
+  if (eos_) return Status::OK();
+  DCHECK_EQ(outputs.size(), 1);
+  data_buffer_pool_->AcquireData(read_ahead_pool_.get(), false);
+  unparsed_data_buffer_ = outputs[0].data;
+  next_record_in_compressed_block_ = unparsed_data_buffer_;
+  next_record_in_compressed_block_len_ = outputs[0].len;
+  data_buffer_end_ = unparsed_data_buffer_ + outputs[0].len;
+  num_buffered_records_in_compressed_block_ = num_records_in_block_read_ahead_;
+  // Decompress the next block while this one is parsed.
+  ReadAhead();
   return Status::OK();
 }
@@ -180,6 +180,7 @@ class HdfsSequenceScanner : public BaseSequenceScanner {
   virtual Status ReadFileHeader() WARN_UNUSED_RESULT;
   virtual Status InitNewRange() WARN_UNUSED_RESULT;
   virtual Status ProcessRange(RowBatch* row_batch) WARN_UNUSED_RESULT;
+  virtual Status ReadBlockAhead() WARN_UNUSED_RESULT;
 
   virtual THdfsFileFormat::type file_format() const {
     return THdfsFileFormat::SEQUENCE_FILE;
@@ -209,6 +210,22 @@ class HdfsSequenceScanner : public BaseSequenceScanner {
   /// successful.
   Status ReadCompressedBlock() WARN_UNUSED_RESULT;
 
+  /// Reads the header of a compressed block, which is not decompressed. Returns the
+  /// number of records in the block in 'num_records' and its compressed value buffer in
+  /// 'compressed_data' and 'block_size'.
+  Status ReadCompressedBlockData(int64_t* num_records, uint8_t** compressed_data,
+      int64_t* block_size) WARN_UNUSED_RESULT;
+
+  /// Reads the sync that follows a compressed block, or sets 'eos_' at the end of the
+  /// file.
+  Status ReadBlockSync() WARN_UNUSED_RESULT;
+
+  /// Makes the compressed block that was read ahead the current block like
+  /// ReadCompressedBlock() and reads the next block ahead. Used instead of
+  /// ReadCompressedBlock() if 'async_decompressor_' is set. Sets 'eos_' if there are no
+  /// more blocks.
+  Status NextPipelinedBlock() WARN_UNUSED_RESULT;
+
   /// Utility function for parsing 'next_record_in_compressed_block_'. Called by
   /// ProcessBlockCompressedScanRange().
   Status ProcessDecompressedBlock(RowBatch* row_batch) WARN_UNUSED_RESULT;
@@ -255,6 +272,9 @@ class HdfsSequenceScanner : public BaseSequenceScanner {
   /// Number of buffered records unparsed_data_buffer_ from block compressed data.
   int64_t num_buffered_records_in_compressed_block_ = 0;
 
+  /// Number of records of the compressed block that was read ahead.
+  int64_t num_records_in_block_read_ahead_ = 0;
+
   /// Next record from block compressed data.
   int64_t next_record_in_compressed_block_len_ = 0;
 
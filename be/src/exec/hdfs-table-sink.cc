@@ -52,6 +52,21 @@ using boost::posix_time::microsec_clock;
 using boost::posix_time::ptime;
 using namespace strings;
 
+DEFINE_bool(hdfs_sink_detect_clustered_input, true, "If true, the HDFS table sink of an "
+    "unclustered insert into a partitioned table finalizes the file of a partition as "
+    "soon as the rows of another partition follow, as long as the input appears to be "
+    "clustered by the partition keys, so that only one partition writer is open. This "
+    "only covers input that looks clustered: if rows of a partition whose file was "
+    "finalized follow later, an extra file is written for the partition and a writer "
+    "per partition is kept open from then on. To bound the number of open writers "
+    "for any input, sort it by the partition keys in front of the sink instead, e.g. "
+    "with the CLUSTERED hint.");
+DEFINE_int32(hdfs_sink_max_open_partition_writers, 0, "(Advanced) Maximum number of "
+    "partitions that the HDFS table sink of an unclustered insert keeps open writers "
+    "for. If more partitions receive rows, the files of the least recently written "
+    "partitions are finalized and further rows for them are written to new files, so "
+    "a partition can end up with many small files. 0 means no limit.");
+
 namespace impala {
 
 Status HdfsTableSinkConfig::Init(
@@ -134,6 +149,8 @@ Status HdfsTableSink::Prepare(RuntimeState* state, MemTracker* parent_mem_tracke
       dynamic_partition_key_expr_evals_.push_back(partition_key_expr_evals_[i]);
     }
   }
+  input_appears_clustered_ = FLAGS_hdfs_sink_detect_clustered_input
+      && !input_is_clustered_ && !dynamic_partition_key_expr_evals_.empty();
   // Sanity check.
   DCHECK_LE(partition_key_expr_evals_.size(), table_desc_->num_cols())
       << DebugString();
@@ -148,6 +165,8 @@ Status HdfsTableSink::Prepare(RuntimeState* state, MemTracker* parent_mem_tracke
   files_created_counter_ = ADD_COUNTER(profile(), "FilesCreated", TUnit::UNIT);
   rows_inserted_counter_ = ADD_COUNTER(profile(), "RowsInserted", TUnit::UNIT);
   bytes_written_counter_ = ADD_COUNTER(profile(), "BytesWritten", TUnit::BYTES);
+  partition_writers_closed_early_counter_ =
+      ADD_COUNTER(profile(), "PartitionWritersClosedEarly", TUnit::UNIT);
   encode_timer_ = ADD_TIMER(profile(), "EncodeTimer");
   hdfs_write_timer_ = ADD_TIMER(profile(), "HdfsWriteTimer");
   compress_timer_ = ADD_TIMER(profile(), "CompressTimer");
@@ -396,6 +415,85 @@ Status HdfsTableSink::WriteClusteredRowBatch(RuntimeState* state, RowBatch* batc
   return Status::OK();
 }
 
+Status HdfsTableSink::WriteUnclusteredRowBatch(RuntimeState* state, RowBatch* batch) {
+  DCHECK_GT(batch->num_rows(), 0);
+  DCHECK(!dynamic_partition_key_expr_evals_.empty());
+  DCHECK(!input_is_clustered_);
+
+  // The partitions that receive rows from this batch, in the order of their first row.
+  vector<PartitionPair*> batch_partitions;
+  PartitionPair* partition_pair = nullptr;
+  string key;
+  string prev_key;
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    const TupleRow* current_row = batch->GetRow(i);
+    GetHashTblKey(current_row, dynamic_partition_key_expr_evals_, &key);
+    if (partition_pair == nullptr || key != prev_key) {
+      RETURN_IF_ERROR(GetOpenOutputPartition(state, current_row, key, &partition_pair));
+      if (partition_pair->second.empty()) {
+        batch_partitions.push_back(partition_pair);
+      } else {
+        // A second run of rows of the same partition in this batch.
+        input_appears_clustered_ = false;
+      }
+      swap(key, prev_key);
+    }
+    partition_pair->second.push_back(i);
+  }
+  for (PartitionPair* batch_partition : batch_partitions) {
+    RETURN_IF_ERROR(WriteRowsToPartition(state, batch, batch_partition));
+    batch_partition->first->last_write_seq = ++last_write_seq_;
+  }
+  int max_open_partitions =
+      input_appears_clustered_ ? 1 : FLAGS_hdfs_sink_max_open_partition_writers;
+  if (max_open_partitions > 0) {
+    RETURN_IF_ERROR(CloseLeastRecentlyWrittenPartitions(state, max_open_partitions));
+  }
+  return Status::OK();
+}
+
+Status HdfsTableSink::GetOpenOutputPartition(RuntimeState* state, const TupleRow* row,
+    const string& key, PartitionPair** partition_pair) {
+  int num_partitions = partition_keys_to_output_partitions_.size();
+  RETURN_IF_ERROR(GetOutputPartition(state, row, key, partition_pair, false));
+  OutputPartition* output_partition = (*partition_pair)->first.get();
+  if (output_partition->writer_closed) {
+    // The partition receives rows again after its file was finalized.
+    input_appears_clustered_ = false;
+    RETURN_IF_ERROR(CreateWriter(state, output_partition));
+    output_partition->writer_closed = false;
+    RETURN_IF_ERROR(CreateNewTmpFile(state, output_partition));
+    open_partitions_.push_back(*partition_pair);
+  } else if (partition_keys_to_output_partitions_.size() > num_partitions) {
+    open_partitions_.push_back(*partition_pair);
+  }
+  return Status::OK();
+}
+
+Status HdfsTableSink::CloseLeastRecentlyWrittenPartitions(RuntimeState* state,
+    int max_open_partitions) {
+  if (open_partitions_.size() <= max_open_partitions) return Status::OK();
+  sort(open_partitions_.begin(), open_partitions_.end(),
+      [](const PartitionPair* a, const PartitionPair* b) {
+        return a->first->last_write_seq < b->first->last_write_seq;
+      });
+  int num_to_close = open_partitions_.size() - max_open_partitions;
+  for (int i = 0; i < num_to_close; ++i) {
+    OutputPartition* output_partition = open_partitions_[i]->first.get();
+    DCHECK(open_partitions_[i]->second.empty());
+    RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
+    if (output_partition->writer.get() != nullptr) {
+      output_partition->writer->Close();
+      output_partition->writer.reset();
+    }
+    output_partition->writer_closed = true;
+    COUNTER_ADD(partition_writers_closed_early_counter_, 1);
+  }
+  open_partitions_.erase(
+      open_partitions_.begin(), open_partitions_.begin() + num_to_close);
+  return Status::OK();
+}
+
 Status HdfsTableSink::CreateNewTmpFile(RuntimeState* state,
     OutputPartition* output_partition) {
   SCOPED_TIMER(ADD_TIMER(profile(), "TmpFileCreateTimer"));
@@ -595,6 +693,15 @@ Status HdfsTableSink::InitOutputPartition(RuntimeState* state,
   // case of INSERT OVERWRITEs.
   if (empty_partition && (!overwrite_ || !IsTransactional())) return Status::OK();
 
+  RETURN_IF_ERROR(CreateWriter(state, output_partition));
+  COUNTER_ADD(partitions_created_counter_, 1);
+  return CreateNewTmpFile(state, output_partition);
+}
+
+Status HdfsTableSink::CreateWriter(RuntimeState* state,
+    OutputPartition* output_partition) {
+  const HdfsPartitionDescriptor& partition_descriptor =
+      *output_partition->partition_descriptor;
   switch (partition_descriptor.file_format()) {
     case THdfsFileFormat::TEXT:
       output_partition->writer.reset(
@@ -620,9 +727,7 @@ Status HdfsTableSink::InitOutputPartition(RuntimeState* state,
       }
       return Status(error_msg.str());
   }
-  RETURN_IF_ERROR(output_partition->writer->Init());
-  COUNTER_ADD(partitions_created_counter_, 1);
-  return CreateNewTmpFile(state, output_partition);
+  return output_partition->writer->Init();
 }
 
 void HdfsTableSink::GetHashTblKey(const TupleRow* row,
@@ -703,21 +808,7 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch) {
   } else if (input_is_clustered_) {
     RETURN_IF_ERROR(WriteClusteredRowBatch(state, batch));
   } else {
-    for (int i = 0; i < batch->num_rows(); ++i) {
-      const TupleRow* current_row = batch->GetRow(i);
-
-      string key;
-      GetHashTblKey(current_row, dynamic_partition_key_expr_evals_, &key);
-      PartitionPair* partition_pair = nullptr;
-      RETURN_IF_ERROR(
-          GetOutputPartition(state, current_row, key, &partition_pair, false));
-      partition_pair->second.push_back(i);
-    }
-    for (PartitionMap::value_type& partition : partition_keys_to_output_partitions_) {
-      if (!partition.second.second.empty()) {
-        RETURN_IF_ERROR(WriteRowsToPartition(state, batch, &partition.second));
-      }
-    }
+    RETURN_IF_ERROR(WriteUnclusteredRowBatch(state, batch));
   }
 
   return Status::OK();
@@ -792,6 +883,7 @@ void HdfsTableSink::Close(RuntimeState* state) {
     Status close_status = ClosePartitionFile(state, cur_partition->second.first.get());
     if (!close_status.ok()) state->LogError(close_status.msg());
   }
+  open_partitions_.clear();
   partition_keys_to_output_partitions_.clear();
   ScalarExprEvaluator::Close(partition_key_expr_evals_, state);
   DataSink::Close(state);
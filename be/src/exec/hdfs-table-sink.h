@@ -188,6 +188,33 @@ class HdfsTableSink : public DataSink {
   /// files. The input must be ordered by the partition key expressions.
   Status WriteClusteredRowBatch(RuntimeState* state, RowBatch* batch) WARN_UNUSED_RESULT;
 
+  /// Maps all rows in 'batch' to partitions and appends them to their temporary Hdfs
+  /// files if the input is not known to be clustered. The partition is looked up once
+  /// per run of rows with the same key. As long as the input appears to be clustered,
+  /// i.e. no partition receives rows again after the rows of another partition, only
+  /// the writer of the last partition is kept open after each batch. Otherwise at most
+  /// --hdfs_sink_max_open_partition_writers writers are kept open if the flag is
+  /// positive. The files of the other partitions are finalized and their writers
+  /// closed, see CloseLeastRecentlyWrittenPartitions().
+  Status WriteUnclusteredRowBatch(RuntimeState* state, RowBatch* batch)
+      WARN_UNUSED_RESULT;
+
+  /// Like GetOutputPartition(), but also creates a new writer and file for the
+  /// partition if its writer was closed by CloseLeastRecentlyWrittenPartitions(), and
+  /// tracks the partition in 'open_partitions_'.
+  Status GetOpenOutputPartition(RuntimeState* state, const TupleRow* row,
+      const std::string& key, PartitionPair** partition_pair) WARN_UNUSED_RESULT;
+
+  /// Finalizes the files and closes the writers of the least recently written
+  /// partitions in 'open_partitions_' until at most 'max_open_partitions' are left.
+  Status CloseLeastRecentlyWrittenPartitions(RuntimeState* state,
+      int max_open_partitions) WARN_UNUSED_RESULT;
+
+  /// Creates the writer of 'output_partition' for the file format of its partition
+  /// descriptor and initializes it.
+  Status CreateWriter(RuntimeState* state, OutputPartition* output_partition)
+      WARN_UNUSED_RESULT;
+
   /// Updates runtime stats of HDFS with rows written, then closes the file associated
   /// with the partition by calling ClosePartitionFile()
   Status FinalizePartitionFile(RuntimeState* state, OutputPartition* partition)
@@ -262,6 +289,16 @@ class HdfsTableSink : public DataSink {
   /// batches. Only set if 'input_is_clustered_' is true.
   std::string current_clustered_partition_key_;
 
+  /// True as long as the input of an unclustered insert into a partitioned table
+  /// appears to be clustered by the partition keys. Set in Prepare().
+  bool input_appears_clustered_ = false;
+
+  /// The partitions of an unclustered insert that have an open writer.
+  std::vector<PartitionPair*> open_partitions_;
+
+  /// Sequence number of the last write of rows to a partition.
+  int64_t last_write_seq_ = 0;
+
   /// The directory in which to write intermediate results. Set to
   /// <hdfs_table_base_dir>/_impala_insert_staging/ during Prepare()
   std::string staging_dir_;
@@ -306,6 +343,10 @@ class HdfsTableSink : public DataSink {
   RuntimeProfile::Counter* rows_inserted_counter_;
   RuntimeProfile::Counter* bytes_written_counter_;
 
+  /// Number of times the writer of a partition was closed before the end of an
+  /// unclustered insert, see CloseLeastRecentlyWrittenPartitions().
+  RuntimeProfile::Counter* partition_writers_closed_early_counter_;
+
   /// Time spent converting tuple to on disk format.
   RuntimeProfile::Counter* encode_timer_;
   /// Time spent writing to hdfs
@@ -42,17 +42,24 @@
 #include "gen-cpp/ErrorCodes_types.h"
 #include "gutil/strings/substitute.h"
 #include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/fragment-state.h"
+#include "runtime/io/disk-io-mgr.h"
 #include "runtime/io/request-context.h"
 #include "runtime/io/request-ranges.h"
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/thread-resource-mgr.h"
 #include "runtime/tuple-row.h"
 #include "runtime/tuple.h"
 #include "util/codec.h"
+#include "util/debug-util.h"
+#include "util/decompress.h"
 #include "util/error-util.h"
+#include "util/pipelined-decompressor.h"
 #include "util/runtime-profile-counters.h"
 #include "util/stopwatch.h"
 
@@ -73,6 +80,15 @@ using namespace impala;
 using namespace impala::io;
 using namespace strings;
 
+DEFINE_bool(enable_bgzf_text_splits, true, "(Advanced) If true, gzip-compressed text "
+    "files that span multiple splits are checked for the BGZF format, and the splits of "
+    "BGZF files are scanned in parallel instead of reading the whole file in one "
+    "scanner.");
+DEFINE_bool(enable_pipelined_text_decompression, false, "(Advanced) If true, large "
+    "compressed text files that are read as a whole by one scanner are decompressed in "
+    "a separate thread, if a thread token is available, so that decompression and "
+    "parsing proceed in parallel.");
+
 const char* HdfsTextScanner::LLVM_CLASS_NAME = "class.impala::HdfsTextScanner";
 
 // Suffix for lzo index file: hdfs-filename.index
@@ -82,6 +98,10 @@ const string HdfsTextScanner::LZO_INDEX_SUFFIX = ".index";
 // progress.
 const int64_t COMPRESSED_DATA_FIXED_READ_SIZE = 1 * 1024 * 1024;
 
+// Minimum size of a compressed text file for its decompression to be pipelined. Smaller
+// files do not take long enough to decompress to make up for starting a thread.
+const int64_t PIPELINED_DECOMPRESSION_MIN_FILE_SIZE = 16 * 1024 * 1024;
+
 HdfsTextScanner::HdfsTextScanner(HdfsScanNodeBase* scan_node, RuntimeState* state)
     : HdfsScanner(scan_node, state),
       byte_buffer_ptr_(nullptr),
@@ -97,7 +117,15 @@ HdfsTextScanner::HdfsTextScanner(HdfsScanNodeBase* scan_node, RuntimeState* stat
       batch_start_ptr_(nullptr),
       error_in_row_(false),
       partial_tuple_(nullptr),
-      parse_delimiter_timer_(nullptr) {
+      parse_delimiter_timer_(nullptr),
+      bgzf_(false),
+      bgzf_block_found_(false),
+      bgzf_block_pending_(false),
+      bgzf_pending_block_(nullptr),
+      bgzf_pending_block_len_(0),
+      bgzf_pending_block_eosr_(false),
+      bgzf_pending_block_in_scan_range_(false),
+      hand_off_io_buffers_(false) {
 }
 
 HdfsTextScanner::~HdfsTextScanner() {
@@ -106,6 +134,7 @@ HdfsTextScanner::~HdfsTextScanner() {
 Status HdfsTextScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
     const vector<HdfsFileDesc*>& files) {
   vector<ScanRange*> compressed_text_scan_ranges;
+  vector<ScanRange*> header_ranges;
   map<string, vector<HdfsFileDesc*>> plugin_text_files;
   for (int i = 0; i < files.size(); ++i) {
     THdfsCompression::type compression = files[i]->file_compression;
@@ -122,36 +151,30 @@ Status HdfsTextScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
       case THdfsCompression::ZSTD:
       case THdfsCompression::BZIP2:
       case THdfsCompression::DEFLATE:
-        for (int j = 0; j < files[i]->splits.size(); ++j) {
-          // In order to decompress gzip-, snappy-, bzip2- and deflate-compressed text
-          // files, we need to read entire files. Only read a file if we're assigned the
-          // first split to avoid reading multi-block files with multiple scanners.
-          ScanRange* split = files[i]->splits[j];
-
-          // We only process the split that starts at offset 0.
-          if (split->offset() != 0) {
-            // We are expecting each file to be one hdfs block (so all the scan range
-            // offsets should be 0).  This is not incorrect but we will issue a warning.
-            scan_node->runtime_state()->LogError(ErrorMsg(
-                TErrorCode::COMPRESSED_FILE_MULTIPLE_BLOCKS,
-                files[i]->filename, split->offset()));
-            // We assign the entire file to one scan range, so mark all but one split
-            // (i.e. the first split) as complete.
-            scan_node->RangeComplete(THdfsFileFormat::TEXT, compression);
-            continue;
-          }
-
-          // Populate the list of compressed text scan ranges.
-          DCHECK_GT(files[i]->file_length, 0);
+        if (compression == THdfsCompression::GZIP && FLAGS_enable_bgzf_text_splits
+            && (files[i]->splits.size() > 1
+                || files[i]->splits[0]->len() < files[i]->file_length)) {
+          // The file may be a BGZF file whose splits can be read in parallel. Issue
+          // just the header range. The scanner of the header range issues the splits
+          // or a range for the whole file, depending on the format of the file.
           ScanRangeMetadata* metadata =
-              static_cast<ScanRangeMetadata*>(split->meta_data());
-          ScanRange* file_range = scan_node->AllocateScanRange(files[i]->fs,
-              files[i]->filename.c_str(), files[i]->file_length, 0,
-              metadata->partition_id, split->disk_id(), split->expected_local(),
-              files[i]->mtime, BufferOpts(split->cache_options()));
-          compressed_text_scan_ranges.push_back(file_range);
-          scan_node->max_compressed_text_file_length()->Set(files[i]->file_length);
+              static_cast<ScanRangeMetadata*>(files[i]->splits[0]->meta_data());
+          int64_t header_size = min<int64_t>(
+              GzipDecompressor::BGZF_HEADER_SIZE, files[i]->file_length);
+          int cache_options = !scan_node->IsDataCacheDisabled() ?
+              BufferOpts::USE_DATA_CACHE : BufferOpts::NO_CACHING;
+          ScanRange* header_range = scan_node->AllocateScanRange(files[i]->fs,
+              files[i]->filename.c_str(), header_size, 0, metadata->partition_id, -1,
+              false, files[i]->mtime, BufferOpts(cache_options),
+              metadata->original_split);
+          static_cast<ScanRangeMetadata*>(header_range->meta_data())->is_file_header =
+              true;
+          header_ranges.push_back(header_range);
+          break;
         }
+        // In order to decompress gzip-, snappy-, bzip2- and deflate-compressed text
+        // files, we need to read entire files.
+        AddWholeFileRange(scan_node, files[i], &compressed_text_scan_ranges);
         break;
 
       default: {
@@ -178,6 +201,11 @@ Status HdfsTextScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
     RETURN_IF_ERROR(scan_node->AddDiskIoRanges(compressed_text_scan_ranges,
           EnqueueLocation::TAIL));
   }
+  if (header_ranges.size() > 0) {
+    // When the header is read, more ranges are issued from the scanner threads.
+    scan_node->UpdateRemainingScanRangeSubmissions(header_ranges.size());
+    RETURN_IF_ERROR(scan_node->AddDiskIoRanges(header_ranges, EnqueueLocation::TAIL));
+  }
   for (const auto& entry : plugin_text_files) {
     DCHECK_GT(entry.second.size(), 0) << "List should be non-empty";
     // This can fail if the plugin library can't be loaded.
@@ -187,8 +215,109 @@ Status HdfsTextScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
   return Status::OK();
 }
 
+void HdfsTextScanner::AddWholeFileRange(HdfsScanNodeBase* scan_node,
+    const HdfsFileDesc* file, vector<ScanRange*>* ranges) {
+  for (int j = 0; j < file->splits.size(); ++j) {
+    // Only read a file if we're assigned the first split to avoid reading multi-block
+    // files with multiple scanners.
+    ScanRange* split = file->splits[j];
+
+    // We only process the split that starts at offset 0.
+    if (split->offset() != 0) {
+      // We are expecting each file to be one hdfs block (so all the scan range
+      // offsets should be 0).  This is not incorrect but we will issue a warning.
+      scan_node->runtime_state()->LogError(ErrorMsg(
+          TErrorCode::COMPRESSED_FILE_MULTIPLE_BLOCKS, file->filename, split->offset()));
+      // We assign the entire file to one scan range, so mark all but one split
+      // (i.e. the first split) as complete.
+      scan_node->RangeComplete(THdfsFileFormat::TEXT, file->file_compression);
+      continue;
+    }
+
+    // Populate the list of compressed text scan ranges.
+    DCHECK_GT(file->file_length, 0);
+    ScanRangeMetadata* metadata = static_cast<ScanRangeMetadata*>(split->meta_data());
+    ScanRange* file_range = scan_node->AllocateScanRange(file->fs,
+        file->filename.c_str(), file->file_length, 0, metadata->partition_id,
+        split->disk_id(), split->expected_local(), file->mtime,
+        BufferOpts(split->cache_options()));
+    ranges->push_back(file_range);
+    scan_node->max_compressed_text_file_length()->Set(file->file_length);
+  }
+}
+
+Status HdfsTextScanner::ProcessGzipFileHeader() {
+  DCHECK(only_parsing_header_);
+  int64_t partition_id = context_->partition_descriptor()->id();
+  const HdfsFileDesc* desc = scan_node_->GetFileDesc(partition_id, stream_->filename());
+  uint8_t* header;
+  int64_t header_len;
+  Status status;
+  if (!stream_->GetBytes(GzipDecompressor::BGZF_HEADER_SIZE, &header, &header_len,
+          &status)) {
+    DCHECK(!status.ok());
+    scan_node_->UpdateRemainingScanRangeSubmissions(-1);
+    return status;
+  }
+  GzipFileHeader* file_header = state_->obj_pool()->Add(new GzipFileHeader());
+  file_header->is_bgzf = header_len == GzipDecompressor::BGZF_HEADER_SIZE
+      && GzipDecompressor::IsBgzfHeader(header);
+  scan_node_->SetFileMetadata(partition_id, stream_->filename(), file_header);
+  // Issue the scan ranges with priority since they would result in producing RowBatches.
+  if (file_header->is_bgzf) {
+    VLOG_FILE << "Scanning the splits of BGZF file " << stream_->filename()
+              << " in parallel";
+    status = scan_node_->AddDiskIoRanges(desc->splits, EnqueueLocation::HEAD);
+  } else {
+    vector<ScanRange*> ranges;
+    AddWholeFileRange(scan_node_, desc, &ranges);
+    if (!ranges.empty()) {
+      status = scan_node_->AddDiskIoRanges(ranges, EnqueueLocation::HEAD);
+    }
+  }
+  scan_node_->UpdateRemainingScanRangeSubmissions(-1);
+  return status;
+}
+
+Status HdfsTextScanner::StartPipelinedDecompression() {
+  DCHECK(decompressor_ != nullptr);
+  if (!FLAGS_enable_pipelined_text_decompression) return Status::OK();
+  if (!decompressor_->supports_streaming()) return Status::OK();
+  if (stream_->file_desc()->file_length < PIPELINED_DECOMPRESSION_MIN_FILE_SIZE) {
+    return Status::OK();
+  }
+  if (!state_->resource_pool()->TryAcquireThreadToken()) return Status::OK();
+  pipelined_decompressor_.reset(new PipelinedDecompressor(
+      scan_node_->mem_tracker(), decompression_type_, stream_->filename()));
+  string thread_name = Substitute("text-decompression (finst:$0, plan-node-id:$1)",
+      PrintId(state_->fragment_instance_id()), scan_node_->id());
+  Status status = pipelined_decompressor_->Open(
+      FragmentInstanceState::FINST_THREAD_GROUP_NAME, thread_name);
+  if (!status.ok()) {
+    pipelined_decompressor_->Close();
+    pipelined_decompressor_.reset();
+    state_->resource_pool()->ReleaseThreadToken(false);
+    return status;
+  }
+  // The decompression thread holds on to up to MAX_QUEUED_INPUTS + 1 of the I/O buffers
+  // that are handed off to it, so they are only handed off if the scan range has at
+  // least one more buffer to read into. Otherwise their data is copied.
+  DiskIoMgr* io_mgr = ExecEnv::GetInstance()->disk_io_mgr();
+  int64_t min_reservation = min(stream_->file_desc()->file_length,
+      (PipelinedDecompressor::MAX_QUEUED_INPUTS + 2) * io_mgr->max_buffer_size());
+  hand_off_io_buffers_ = stream_->reservation() >= min_reservation;
+  COUNTER_ADD(ADD_COUNTER(scan_node_->runtime_profile(), "PipelinedDecompressionFiles",
+      TUnit::UNIT), 1);
+  return Status::OK();
+}
+
 void HdfsTextScanner::Close(RowBatch* row_batch) {
   DCHECK(!is_closed_);
+  if (pipelined_decompressor_ != nullptr) {
+    pipelined_decompressor_->Close();
+    pipelined_decompressor_.reset();
+    state_->resource_pool()->ReleaseThreadToken(false);
+  }
   // Need to close the decompressor before transferring the remaining resources to
   // 'row_batch' because in some cases there is memory allocated in the decompressor_'s
   // temp_memory_pool_.
@@ -237,6 +366,15 @@ Status HdfsTextScanner::InitNewRange() {
     compression_type = THdfsCompression::DEFAULT;
   }
   RETURN_IF_ERROR(UpdateDecompressor(compression_type));
+  if (compression_type == THdfsCompression::GZIP) {
+    GzipFileHeader* file_header = reinterpret_cast<GzipFileHeader*>(
+        scan_node_->GetFileMetadata(
+            context_->partition_descriptor()->id(), stream_->filename()));
+    bgzf_ = file_header != nullptr && file_header->is_bgzf;
+  }
+  if (decompressor_ != nullptr && !bgzf_) {
+    RETURN_IF_ERROR(StartPipelinedDecompression());
+  }
 
   HdfsPartitionDescriptor* hdfs_partition = context_->partition_descriptor();
   char field_delim = hdfs_partition->field_delim();
@@ -304,12 +442,17 @@ Status HdfsTextScanner::FinishScanRange(RowBatch* row_batch) {
     Status status = Status::OK();
     byte_buffer_read_size_ = 0;
 
-    // If compressed text, then there is nothing more to be read.
+    // If compressed text, then there is nothing more to be read, except for the blocks
+    // after the scan range of BGZF files.
     // TODO: calling FillByteBuffer() at eof() can cause
     // ScannerContext::Stream::GetNextBuffer to DCHECK. Fix this.
     if (decompressor_.get() == nullptr && !stream_->eof()) {
       status =
         FillByteBufferWrapper(row_batch->tuple_data_pool(), &eosr, NEXT_BLOCK_READ_SIZE);
+    } else if (bgzf_ && (bgzf_block_pending_ || !stream_->eof())) {
+      status = FillByteBufferWrapper(row_batch->tuple_data_pool(), &eosr);
+      // Reading past the scan range, so only the end of the file ends it.
+      eosr = true;
     }
 
     if (!status.ok() || byte_buffer_read_size_ == 0) {
@@ -378,6 +521,12 @@ Status HdfsTextScanner::ProcessRange(RowBatch* row_batch, int* num_tuples) {
 
   MemPool* pool = row_batch->tuple_data_pool();
   bool eosr = stream_->eosr() || scan_state_ == PAST_SCAN_RANGE;
+  if (bgzf_block_pending_ && bgzf_pending_block_in_scan_range_) {
+    // 'stream_' is past the BGZF block that CheckForSplitDelimiter() read ahead, but the
+    // block still belongs to the scan range.
+    DCHECK_EQ(scan_state_, FIRST_TUPLE_FOUND);
+    eosr = false;
+  }
   while (true) {
     if (!eosr && byte_buffer_ptr_ == byte_buffer_end_) {
       RETURN_IF_ERROR(FillByteBufferWrapper(pool, &eosr));
@@ -463,6 +612,10 @@ Status HdfsTextScanner::ProcessRange(RowBatch* row_batch, int* num_tuples) {
 
 Status HdfsTextScanner::GetNextInternal(RowBatch* row_batch) {
   DCHECK(!eos_);
+  if (only_parsing_header_) {
+    eos_ = true;
+    return ProcessGzipFileHeader();
+  }
   DCHECK_GE(scan_state_, SCAN_RANGE_INITIALIZED);
   DCHECK_NE(scan_state_, DONE);
 
@@ -528,6 +681,12 @@ Status HdfsTextScanner::FillByteBuffer(MemPool* pool, bool* eosr, int num_bytes)
           reinterpret_cast<uint8_t**>(&byte_buffer_ptr_), &byte_buffer_read_size_));
     }
     *eosr = stream_->eosr();
+  } else if (bgzf_) {
+    DCHECK_EQ(num_bytes, 0);
+    RETURN_IF_ERROR(FillByteBufferBgzf(pool, eosr));
+  } else if (pipelined_decompressor_ != nullptr) {
+    DCHECK_EQ(num_bytes, 0);
+    RETURN_IF_ERROR(FillByteBufferPipelined(pool, eosr));
   } else if (decompressor_->supports_streaming()) {
     DCHECK_EQ(num_bytes, 0);
     RETURN_IF_ERROR(FillByteBufferCompressedStream(pool, eosr));
@@ -690,6 +849,169 @@ Status HdfsTextScanner::FillByteBufferCompressedFile(bool* eosr) {
   return Status::OK();
 }
 
+Status HdfsTextScanner::FillByteBufferBgzf(MemPool* pool, bool* eosr) {
+  if (!bgzf_block_pending_) {
+    // We're about to decompress a new block. Attach the memory of previous blocks to
+    // 'pool'. Blocks that were read ahead by CheckForSplitDelimiter() are still needed.
+    if (pool != nullptr) {
+      pool->AcquireData(data_buffer_pool_.get(), false);
+    } else {
+      data_buffer_pool_->FreeAll();
+    }
+    RETURN_IF_ERROR(ReadBgzfBlock());
+  }
+  DCHECK(bgzf_block_pending_);
+  bgzf_block_pending_ = false;
+  byte_buffer_ptr_ = reinterpret_cast<char*>(bgzf_pending_block_);
+  byte_buffer_read_size_ = bgzf_pending_block_len_;
+  *eosr = bgzf_pending_block_eosr_;
+  return Status::OK();
+}
+
+Status HdfsTextScanner::ReadBgzfBlock() {
+  DCHECK(!bgzf_block_pending_);
+  bgzf_block_pending_ = true;
+  bgzf_pending_block_ = nullptr;
+  bgzf_pending_block_len_ = 0;
+  bgzf_pending_block_eosr_ = true;
+  bgzf_pending_block_in_scan_range_ = false;
+  if (!bgzf_block_found_) {
+    RETURN_IF_ERROR(SkipToBgzfBlock(&bgzf_block_found_));
+    // No block starts in the scan range.
+    if (!bgzf_block_found_) return Status::OK();
+  }
+  bool in_scan_range = !stream_->eosr();
+  bgzf_pending_block_in_scan_range_ = in_scan_range;
+  // Skip empty blocks, but stop at the end of the scan range so that the caller can
+  // tell the blocks of the scan range from the blocks after it.
+  do {
+    if (stream_->eof()) return Status::OK();
+    uint8_t* header;
+    int64_t header_len;
+    Status status;
+    if (!stream_->GetBytes(GzipDecompressor::BGZF_HEADER_SIZE, &header, &header_len,
+            &status, /*peek*/ true)) {
+      DCHECK(!status.ok());
+      return status;
+    }
+    if (header_len < GzipDecompressor::BGZF_HEADER_SIZE) {
+      return Status(TErrorCode::COMPRESSED_FILE_TRUNCATED, stream_->filename());
+    }
+    if (!GzipDecompressor::IsBgzfHeader(header)) {
+      return Status(TErrorCode::COMPRESSED_FILE_BLOCK_CORRUPTED, "BGZF");
+    }
+    int block_size = GzipDecompressor::BgzfBlockSize(header);
+    uint8_t* block;
+    int64_t block_len;
+    if (!stream_->GetBytes(block_size, &block, &block_len, &status)) {
+      DCHECK(!status.ok());
+      return status;
+    }
+    if (block_len < block_size) {
+      return Status(TErrorCode::COMPRESSED_FILE_TRUNCATED, stream_->filename());
+    }
+    int64_t uncompressed_len = GzipDecompressor::BgzfUncompressedSize(block, block_size);
+    if (uncompressed_len > GzipDecompressor::BGZF_MAX_BLOCK_SIZE) {
+      return Status(TErrorCode::COMPRESSED_FILE_BLOCK_CORRUPTED, "BGZF");
+    }
+    bgzf_pending_block_eosr_ = stream_->eosr();
+    if (uncompressed_len == 0) continue;
+    uint8_t* output = data_buffer_pool_->TryAllocate(uncompressed_len);
+    if (UNLIKELY(output == nullptr)) {
+      return data_buffer_pool_->mem_tracker()->MemLimitExceeded(state_,
+          "Failed to allocate a buffer for a decompressed BGZF block", uncompressed_len);
+    }
+    int64_t output_len = uncompressed_len;
+    {
+      SCOPED_TIMER(decompress_timer_);
+      RETURN_IF_ERROR(decompressor_->ProcessBlock(
+          true, block_size, block, &output_len, &output));
+    }
+    if (output_len != uncompressed_len) {
+      return Status(TErrorCode::COMPRESSED_FILE_BLOCK_CORRUPTED, "BGZF");
+    }
+    bgzf_pending_block_ = output;
+    bgzf_pending_block_len_ = output_len;
+  } while (bgzf_pending_block_len_ == 0
+      && (!in_scan_range || !bgzf_pending_block_eosr_));
+  return Status::OK();
+}
+
+Status HdfsTextScanner::SkipToBgzfBlock(bool* found) {
+  // Look for the first block header that starts in the scan range. Data that looks like
+  // a block header by chance is very unlikely, since 10 bytes of the header are fixed.
+  *found = false;
+  Status status;
+  while (!stream_->eosr()) {
+    uint8_t* buffer;
+    int64_t buffer_len;
+    RETURN_IF_ERROR(stream_->GetBuffer(/*peek*/ true, &buffer, &buffer_len));
+    if (buffer_len == 0) break;
+    uint8_t* magic = reinterpret_cast<uint8_t*>(memchr(buffer, 31, buffer_len));
+    if (magic == nullptr) {
+      if (!stream_->SkipBytes(buffer_len, &status)) return status;
+      continue;
+    }
+    if (!stream_->SkipBytes(magic - buffer, &status)) return status;
+    uint8_t* header;
+    int64_t header_len;
+    if (!stream_->GetBytes(GzipDecompressor::BGZF_HEADER_SIZE, &header, &header_len,
+            &status, /*peek*/ true)) {
+      DCHECK(!status.ok());
+      return status;
+    }
+    if (header_len == GzipDecompressor::BGZF_HEADER_SIZE
+        && GzipDecompressor::IsBgzfHeader(header)) {
+      *found = true;
+      return Status::OK();
+    }
+    if (!stream_->SkipBytes(1, &status)) return status;
+  }
+  return Status::OK();
+}
+
+Status HdfsTextScanner::FillByteBufferPipelined(MemPool* pool, bool* eosr) {
+  // We're about to return a new decompressed buffer. Attach the memory from previous
+  // buffers to 'pool'.
+  if (pool != nullptr) {
+    pool->AcquireData(data_buffer_pool_.get(), false);
+  } else {
+    data_buffer_pool_->FreeAll();
+  }
+  uint8_t* buffer = nullptr;
+  int64_t len = 0;
+  do {
+    // Keep the decompression thread supplied with compressed data.
+    while (!stream_->eosr() && pipelined_decompressor_->NeedsInput()) {
+      unique_ptr<BufferDescriptor> io_buffer;
+      uint8_t* compressed_buffer;
+      int64_t compressed_len;
+      if (hand_off_io_buffers_) {
+        RETURN_IF_ERROR(stream_->TakeBuffer(
+            &io_buffer, &compressed_buffer, &compressed_len));
+      } else {
+        RETURN_IF_ERROR(stream_->GetBuffer(false, &compressed_buffer, &compressed_len));
+      }
+      bool last_input = stream_->eosr();
+      if (io_buffer != nullptr) {
+        pipelined_decompressor_->AddInput(
+            move(io_buffer), compressed_buffer, compressed_len, last_input);
+      } else {
+        RETURN_IF_ERROR(pipelined_decompressor_->AddInput(
+            compressed_buffer, compressed_len, last_input));
+      }
+      if (last_input) context_->ReleaseCompletedResources(true);
+    }
+    // With pipelining, this is the time spent waiting for the decompression thread.
+    SCOPED_TIMER(decompress_timer_);
+    RETURN_IF_ERROR(pipelined_decompressor_->GetOutput(
+        data_buffer_pool_.get(), &buffer, &len, eosr));
+  } while (len == 0 && !*eosr);
+  byte_buffer_ptr_ = reinterpret_cast<char*>(buffer);
+  byte_buffer_read_size_ = len;
+  return Status::OK();
+}
+
 Status HdfsTextScanner::FindFirstTuple(MemPool* pool) {
   DCHECK_EQ(scan_state_, SCAN_RANGE_INITIALIZED);
 
@@ -772,6 +1094,13 @@ Status HdfsTextScanner::CheckForSplitDelimiter(bool* split_delimiter) {
   // The '\r' may be escaped. If it's not the text parser will report a complete tuple.
   if (delimited_text_parser_->HasUnfinishedTuple()) return Status::OK();
 
+  if (bgzf_) {
+    // Read the next block ahead of time. It is returned by the next FillByteBuffer().
+    if (!bgzf_block_pending_) RETURN_IF_ERROR(ReadBgzfBlock());
+    *split_delimiter = bgzf_pending_block_len_ > 0 && *bgzf_pending_block_ == '\n';
+    return Status::OK();
+  }
+
   // Peek ahead one byte to see if the '\r' is followed by '\n'.
   Status status;
   uint8_t* next_byte;
@@ -807,6 +1136,12 @@ Status HdfsTextScanner::Codegen(HdfsScanPlanNode* node, FragmentState* state,
 
 Status HdfsTextScanner::Open(ScannerContext* context) {
   RETURN_IF_ERROR(HdfsScanner::Open(context));
+  if (static_cast<ScanRangeMetadata*>(stream_->scan_range()->meta_data())
+          ->is_file_header) {
+    // The splits of the file are issued once the header is read in GetNextInternal().
+    only_parsing_header_ = true;
+    return Status::OK();
+  }
 
   parse_delimiter_timer_ = ADD_TIMER(scan_node_->runtime_profile(), "DelimiterParseTime");
 
@@ -27,6 +27,7 @@ namespace impala {
 
 template<bool>
 class DelimitedTextParser;
+class PipelinedDecompressor;
 class ScannerContext;
 struct HdfsFileDesc;
 
@@ -46,6 +47,17 @@ struct HdfsFileDesc;
 /// delimiter is considered part of the second scan range, i.e., the first scan range's
 /// scanner is responsible for the tuple directly before it, and the second scan range's
 /// scanner for the tuple directly after it.
+///
+/// Compressed text files:
+/// Compressed text files are usually read as a whole by a single scanner. Large files
+/// that are compressed with a streaming codec can be decompressed in a separate thread
+/// (see PipelinedDecompressor), so that decompression overlaps with parsing.
+/// Gzip-compressed files that span multiple splits are checked for the BGZF format
+/// first, by reading the header of the file in a header range. The splits of BGZF files
+/// are read in parallel like the splits of uncompressed files, with the difference that
+/// a split consists of the BGZF blocks that start in it. Each scanner starts at the
+/// first block that starts in its scan range and applies the rules above to the
+/// decompressed bytes of its blocks.
 class HdfsTextScanner : public HdfsScanner {
  public:
   HdfsTextScanner(HdfsScanNodeBase* scan_node, RuntimeState* state);
@@ -119,6 +131,14 @@ class HdfsTextScanner : public HdfsScanner {
  private:
   const static int NEXT_BLOCK_READ_SIZE = 64 * 1024; //bytes
 
+  /// Metadata of a gzip-compressed text file, stored with SetFileMetadata() by the
+  /// scanner of its header range.
+  struct GzipFileHeader {
+    /// True if the file is in BGZF format, in which case its splits are read in
+    /// parallel.
+    bool is_bgzf;
+  };
+
   /// The text scanner transitions through these states exactly in order.
   enum TextScanState {
     CONSTRUCTED,
@@ -132,6 +152,21 @@ class HdfsTextScanner : public HdfsScanner {
   /// scan range. Advances the scan state to SCAN_RANGE_INITIALIZED.
   virtual Status InitNewRange() WARN_UNUSED_RESULT;
 
+  /// Adds a scan range for the whole of the compressed file 'file' to 'ranges' if
+  /// 'file' has a split that starts at offset 0. All other splits of the file are
+  /// marked as complete.
+  static void AddWholeFileRange(HdfsScanNodeBase* scan_node, const HdfsFileDesc* file,
+      std::vector<io::ScanRange*>* ranges);
+
+  /// Reads the header of a gzip-compressed text file from the header range of this
+  /// scanner. Issues the splits of the file if it is a BGZF file and a scan range for
+  /// the whole file otherwise.
+  Status ProcessGzipFileHeader() WARN_UNUSED_RESULT;
+
+  /// Starts decompressing the file in a separate thread if that is enabled, the file is
+  /// large enough and a thread token is available.
+  Status StartPipelinedDecompression() WARN_UNUSED_RESULT;
+
   /// Finds the start of the first tuple in this scan range and initializes
   /// 'byte_buffer_ptr_' to point to the start of first tuple. Advances the scan state
   /// to FIRST_TUPLE_FOUND, if successful. Otherwise, consumes the whole scan range
@@ -191,6 +226,26 @@ class HdfsTextScanner : public HdfsScanner {
   /// by returned batches to 'pool'. If 'pool' is nullptr the buffers are freed instead.
   Status FillByteBufferCompressedStream(MemPool* pool, bool* eosr) WARN_UNUSED_RESULT;
 
+  /// Fills the next byte buffer with the next BGZF block of a BGZF file, skipping empty
+  /// blocks. Sets 'eosr' if the block is the last one that starts in the scan range. In
+  /// the scan range, an empty buffer is returned if only empty blocks are left.
+  /// Attaches the buffers of previous blocks to 'pool', or frees them if 'pool' is
+  /// nullptr.
+  Status FillByteBufferBgzf(MemPool* pool, bool* eosr) WARN_UNUSED_RESULT;
+
+  /// Reads and decompresses the next non-empty BGZF block into the pending block, see
+  /// 'bgzf_pending_block_'.
+  Status ReadBgzfBlock() WARN_UNUSED_RESULT;
+
+  /// Advances 'stream_' to the first BGZF block that starts in the scan range. Sets
+  /// 'found' to false if no block starts in the scan range.
+  Status SkipToBgzfBlock(bool* found) WARN_UNUSED_RESULT;
+
+  /// Fills the next byte buffer with decompressed data from 'pipelined_decompressor_',
+  /// after handing it more compressed data from 'stream_' if it needs it. Attaches
+  /// buffers from previous calls to 'pool', or frees them if 'pool' is nullptr.
+  Status FillByteBufferPipelined(MemPool* pool, bool* eosr) WARN_UNUSED_RESULT;
+
   /// Used by FillByteBufferCompressedStream() to decompress data from 'stream_'.
   /// Returns COMPRESSED_FILE_DECOMPRESSOR_NO_PROGRESS if it needs more input.
   /// If bytes_to_read > 0, will read specified size.
@@ -280,6 +335,34 @@ class HdfsTextScanner : public HdfsScanner {
 
   /// Time parsing text files
   RuntimeProfile::Counter* parse_delimiter_timer_;
+
+  /// True if the scan range is a split of a BGZF file, which is read block by block.
+  bool bgzf_;
+
+  /// True once the first BGZF block that starts in the scan range was found.
+  bool bgzf_block_found_;
+
+  /// The next decompressed BGZF block, if 'bgzf_block_pending_' is true. Set by
+  /// ReadBgzfBlock() and consumed by FillByteBufferBgzf(). CheckForSplitDelimiter()
+  /// reads the next block ahead of time to look at its first byte. An empty block is
+  /// pending if the scan range only has empty blocks left.
+  bool bgzf_block_pending_;
+  uint8_t* bgzf_pending_block_;
+  int64_t bgzf_pending_block_len_;
+
+  /// True if the pending block is the last one that starts in the scan range.
+  bool bgzf_pending_block_eosr_;
+
+  /// True if the pending block starts in the scan range.
+  bool bgzf_pending_block_in_scan_range_;
+
+  /// Decompresses the file in a separate thread, if pipelined decompression is used.
+  /// The scanner holds a thread token for the thread while it is set.
+  boost::scoped_ptr<PipelinedDecompressor> pipelined_decompressor_;
+
+  /// True if the I/O buffers of the stream are handed off to 'pipelined_decompressor_'
+  /// instead of copying their data.
+  bool hand_off_io_buffers_;
 };
 
 }
@@ -0,0 +1,133 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+
+#include "exec/json-parser.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const string NULL_VALUE = "<NULL>";
+
+/// Parses 'record' and checks that it is valid and that the values of the fields are
+/// 'expected', with NULL_VALUE standing for NULL.
+static void Validate(JsonParser* parser, const string& record,
+    const vector<string>& expected) {
+  MemTracker tracker;
+  MemPool pool(&tracker);
+  vector<FieldLocation> fields(parser->num_fields());
+  bool valid;
+  ASSERT_OK(parser->Parse(record.data(), record.size(), &pool, fields.data(), &valid));
+  ASSERT_TRUE(valid) << record;
+  ASSERT_EQ(expected.size(), fields.size());
+  for (int i = 0; i < fields.size(); ++i) {
+    EXPECT_GE(fields[i].len, 0);
+    string value = fields[i].start == nullptr ? NULL_VALUE :
+        string(fields[i].start, fields[i].len);
+    EXPECT_EQ(expected[i], value) << record;
+  }
+  pool.FreeAll();
+}
+
+static void ValidateInvalid(JsonParser* parser, const string& record) {
+  MemTracker tracker;
+  MemPool pool(&tracker);
+  vector<FieldLocation> fields(parser->num_fields());
+  bool valid;
+  ASSERT_OK(parser->Parse(record.data(), record.size(), &pool, fields.data(), &valid));
+  EXPECT_FALSE(valid) << record;
+  pool.FreeAll();
+}
+
+TEST(JsonParserTest, Basic) {
+  JsonParser parser({"id", "name", "Score", "flag"});
+  Validate(&parser, R"({"id": 1, "name": "a", "score": 1.5e3, "flag": true})",
+      {"1", "a", "1.5e3", "true"});
+  // Keys can be in any order and are matched case-insensitively.
+  Validate(&parser, R"(  {"FLAG":false,"Name":"b" , "ID" : -2}  )",
+      {"-2", "b", NULL_VALUE, "false"});
+  // Missing keys, nulls and unknown keys.
+  Validate(&parser, R"({"other": "x", "name": null, "id": 3})",
+      {"3", NULL_VALUE, NULL_VALUE, NULL_VALUE});
+  Validate(&parser, "{}", {NULL_VALUE, NULL_VALUE, NULL_VALUE, NULL_VALUE});
+  Validate(&parser, "{\t}\r", {NULL_VALUE, NULL_VALUE, NULL_VALUE, NULL_VALUE});
+  // The last value of a duplicate key wins.
+  Validate(&parser, R"({"id": 1, "id": 2, "name": "a", "name": null})",
+      {"2", NULL_VALUE, NULL_VALUE, NULL_VALUE});
+  // Empty strings are not NULL.
+  Validate(&parser, R"({"name": ""})", {NULL_VALUE, "", NULL_VALUE, NULL_VALUE});
+}
+
+TEST(JsonParserTest, Strings) {
+  JsonParser parser({"s"});
+  // Structural characters inside of strings.
+  Validate(&parser, R"({"s": "{[a:b,c]}"})", {"{[a:b,c]}"});
+  Validate(&parser, R"({"s": "a\"b\\"})", {"a\"b\\"});
+  Validate(&parser, R"({"s": "\\\"\\"})", {"\\\"\\"});
+  Validate(&parser, R"({"s": "\/\b\f\n\r\t"})", {"/\b\f\n\r\t"});
+  // Unicode escapes are converted to UTF-8, including surrogate pairs.
+  Validate(&parser, R"({"s": "\u0041\u00e9\u20ac\ud83d\ude00"})",
+      {"A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"});
+  // Unescaped UTF-8 is returned as is.
+  Validate(&parser, "{\"s\": \"\xc3\xa9\"}", {"\xc3\xa9"});
+  // Strings and runs of backslashes that cross the 64 character blocks of the first
+  // stage.
+  for (int padding = 0; padding < 70; ++padding) {
+    string prefix(padding, ' ');
+    Validate(&parser, prefix + R"({"s": "a\\\\\"b\\", "t": "}"})", {"a\\\\\"b\\"});
+    string long_string(padding * 3, 'x');
+    Validate(&parser, R"({"t": ")" + long_string + R"(", "s": ")" + long_string
+        + R"("})", {long_string});
+  }
+}
+
+TEST(JsonParserTest, Nested) {
+  JsonParser parser({"a", "b"});
+  // Nested values are returned as JSON text.
+  Validate(&parser, R"({"a": {"x": [1, {"y": "]}"}]}, "b": [[], {}]})",
+      {R"({"x": [1, {"y": "]}"}]})", "[[], {}]"});
+  // Keys of nested objects are not top-level fields.
+  Validate(&parser, R"({"c": {"a": 1, "b": 2}, "b": 3})", {NULL_VALUE, "3"});
+}
+
+TEST(JsonParserTest, Invalid) {
+  JsonParser parser({"a"});
+  ValidateInvalid(&parser, "");
+  ValidateInvalid(&parser, "   ");
+  ValidateInvalid(&parser, "[1, 2]");
+  ValidateInvalid(&parser, R"(x{"a": 1})");
+  ValidateInvalid(&parser, R"({"a": 1} x)");
+  ValidateInvalid(&parser, R"({"a": 1)");
+  ValidateInvalid(&parser, R"({"a": 1,})");
+  ValidateInvalid(&parser, R"({"a" 1})");
+  ValidateInvalid(&parser, R"({"a": })");
+  ValidateInvalid(&parser, R"({"a": "b})");
+  ValidateInvalid(&parser, R"({"a": "b" "c"})");
+  ValidateInvalid(&parser, R"({"a": {"b": 1})");
+  ValidateInvalid(&parser, R"({a: 1})");
+  ValidateInvalid(&parser, R"({"a": "\x"})");
+  ValidateInvalid(&parser, R"({"a": "\ud83d"})");
+  // The parser can be reused after invalid records.
+  Validate(&parser, R"({"a": 1})", {"1"});
+}
+
+}
@@ -0,0 +1,337 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/json-parser.h"
+
+#include <limits>
+#include <strings.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "util/bit-util.h"
+#include "util/sse-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+/// Number of characters that the first stage classifies at a time.
+static const int BLOCK_SIZE = 64;
+
+static inline bool IsJsonWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline const char* SkipWhitespace(const char* ptr, const char* end) {
+  while (ptr < end && IsJsonWhitespace(*ptr)) ++ptr;
+  return ptr;
+}
+
+static inline bool IsBlank(const char* ptr, const char* end) {
+  return SkipWhitespace(ptr, end) == end;
+}
+
+/// Sets bit i of each mask if the i-th character of 'block' is a quote, a backslash or
+/// a structural character. Uses SSE2, which is available on all x86_64 CPUs and is
+/// emulated with NEON on aarch64.
+static inline void ClassifyBlock(const char* block, uint64_t* quote_mask,
+    uint64_t* backslash_mask, uint64_t* structural_mask) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+  // '[' and ']' differ from '{' and '}' only in bit 5.
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  const __m128i open_brace = _mm_set1_epi8('{');
+  const __m128i close_brace = _mm_set1_epi8('}');
+  *quote_mask = 0;
+  *backslash_mask = 0;
+  *structural_mask = 0;
+  for (int i = 0; i < BLOCK_SIZE / SSEUtil::CHARS_PER_128_BIT_REGISTER; ++i) {
+    const int shift = i * SSEUtil::CHARS_PER_128_BIT_REGISTER;
+    __m128i chars = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(block + shift));
+    __m128i folded = _mm_or_si128(chars, case_bit);
+    __m128i structural = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chars, colon), _mm_cmpeq_epi8(chars, comma)),
+        _mm_or_si128(
+            _mm_cmpeq_epi8(folded, open_brace), _mm_cmpeq_epi8(folded, close_brace)));
+    *quote_mask |= static_cast<uint64_t>(static_cast<uint16_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chars, quote)))) << shift;
+    *backslash_mask |= static_cast<uint64_t>(static_cast<uint16_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chars, backslash)))) << shift;
+    *structural_mask |= static_cast<uint64_t>(static_cast<uint16_t>(
+        _mm_movemask_epi8(structural))) << shift;
+  }
+}
+
+/// Sets bit i of the result to the xor of bits [0, i] of 'v'. Turns a mask of quotes
+/// into a mask of the characters inside of strings, including the opening quotes.
+static inline uint64_t PrefixXor(uint64_t v) {
+  v ^= v << 1;
+  v ^= v << 2;
+  v ^= v << 4;
+  v ^= v << 8;
+  v ^= v << 16;
+  v ^= v << 32;
+  return v;
+}
+
+static inline int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+/// Parses the four hex digits at 'src' into 'code_unit'.
+static inline bool ParseCodeUnit(const char* src, uint32_t* code_unit) {
+  *code_unit = 0;
+  for (int i = 0; i < 4; ++i) {
+    int v = HexValue(src[i]);
+    if (v < 0) return false;
+    *code_unit = *code_unit << 4 | v;
+  }
+  return true;
+}
+
+/// Unescapes the JSON string [src, src + len) into 'dst' and sets 'dst_len'. The result
+/// is never longer than the input. Returns false if there is an invalid escape sequence.
+static bool UnescapeJsonString(const char* src, int len, char* dst, int* dst_len) {
+  const char* end = src + len;
+  char* out = dst;
+  while (src < end) {
+    if (*src != '\\') {
+      *out++ = *src++;
+      continue;
+    }
+    if (src + 1 == end) return false;
+    char c = src[1];
+    src += 2;
+    switch (c) {
+      case '"': *out++ = '"'; break;
+      case '\\': *out++ = '\\'; break;
+      case '/': *out++ = '/'; break;
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'u': {
+        uint32_t code_point;
+        if (end - src < 4 || !ParseCodeUnit(src, &code_point)) return false;
+        src += 4;
+        if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+          // A high surrogate must be followed by an escaped low surrogate.
+          uint32_t low;
+          if (end - src < 6 || src[0] != '\\' || src[1] != 'u'
+              || !ParseCodeUnit(src + 2, &low) || low < 0xDC00 || low > 0xDFFF) {
+            return false;
+          }
+          src += 6;
+          code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        }
+        // Encode the code point as UTF-8.
+        if (code_point < 0x80) {
+          *out++ = code_point;
+        } else if (code_point < 0x800) {
+          *out++ = 0xC0 | (code_point >> 6);
+          *out++ = 0x80 | (code_point & 0x3F);
+        } else if (code_point < 0x10000) {
+          *out++ = 0xE0 | (code_point >> 12);
+          *out++ = 0x80 | ((code_point >> 6) & 0x3F);
+          *out++ = 0x80 | (code_point & 0x3F);
+        } else {
+          *out++ = 0xF0 | (code_point >> 18);
+          *out++ = 0x80 | ((code_point >> 12) & 0x3F);
+          *out++ = 0x80 | ((code_point >> 6) & 0x3F);
+          *out++ = 0x80 | (code_point & 0x3F);
+        }
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  *dst_len = out - dst;
+  return true;
+}
+
+JsonParser::JsonParser(const vector<string>& field_names) {
+  for (const string& name : field_names) {
+    field_names_.push_back(boost::algorithm::to_lower_copy(name));
+  }
+}
+
+bool JsonParser::BuildStructuralIndex(const char* record, int64_t len) {
+  structural_index_.clear();
+  bool escape_next = false;
+  // All ones if the previous block ended inside of a string.
+  uint64_t in_string_carry = 0;
+  char tail[BLOCK_SIZE];
+  for (int64_t offset = 0; offset < len; offset += BLOCK_SIZE) {
+    const char* block = record + offset;
+    if (len - offset < BLOCK_SIZE) {
+      // Pad the last block with whitespace, which is not classified.
+      memset(tail, ' ', BLOCK_SIZE);
+      memcpy(tail, block, len - offset);
+      block = tail;
+    }
+    uint64_t quote_mask;
+    uint64_t backslash_mask;
+    uint64_t structural_mask;
+    ClassifyBlock(block, &quote_mask, &backslash_mask, &structural_mask);
+    quote_mask &= ~BitUtil::FindEscaped64(backslash_mask, &escape_next);
+    uint64_t in_string = PrefixXor(quote_mask) ^ in_string_carry;
+    in_string_carry = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+    structural_mask = (structural_mask & ~in_string) | quote_mask;
+    while (structural_mask != 0) {
+      structural_index_.push_back(offset + BitUtil::CountTrailingZeros(structural_mask));
+      structural_mask &= structural_mask - 1;
+    }
+  }
+  return in_string_carry == 0;
+}
+
+int JsonParser::FindField(const char* key, int len, int key_idx) {
+  if (key_idx < key_fields_.size()) {
+    int field_idx = key_fields_[key_idx];
+    if (field_idx >= 0 && field_names_[field_idx].size() == len
+        && strncasecmp(key, field_names_[field_idx].data(), len) == 0) {
+      return field_idx;
+    }
+  } else {
+    key_fields_.resize(key_idx + 1);
+  }
+  int field_idx = -1;
+  for (int i = 0; i < field_names_.size(); ++i) {
+    if (field_names_[i].size() == len
+        && strncasecmp(key, field_names_[i].data(), len) == 0) {
+      field_idx = i;
+      break;
+    }
+  }
+  key_fields_[key_idx] = field_idx;
+  return field_idx;
+}
+
+Status JsonParser::SetStringField(char* start, int len, MemPool* pool,
+    FieldLocation* field, bool* valid) {
+  if (LIKELY(memchr(start, '\\', len) == nullptr)) {
+    field->start = start;
+    field->len = len;
+    return Status::OK();
+  }
+  char* buffer = reinterpret_cast<char*>(pool->TryAllocateUnaligned(len));
+  if (UNLIKELY(buffer == nullptr)) {
+    string details = Substitute("Failed to allocate $0 bytes for a JSON string.", len);
+    return pool->mem_tracker()->MemLimitExceeded(nullptr, details, len);
+  }
+  *valid = UnescapeJsonString(start, len, buffer, &field->len);
+  field->start = buffer;
+  return Status::OK();
+}
+
+Status JsonParser::Parse(const char* record, int64_t len, MemPool* pool,
+    FieldLocation* fields, bool* valid) {
+  for (int i = 0; i < field_names_.size(); ++i) {
+    fields[i].start = nullptr;
+    fields[i].len = 0;
+  }
+  *valid = false;
+  if (UNLIKELY(len > numeric_limits<int>::max())) return Status::OK();
+  if (!BuildStructuralIndex(record, len)) return Status::OK();
+  // The TextConverter takes non-const pointers, but doesn't modify the fields.
+  char* data = const_cast<char*>(record);
+  const char* end = record + len;
+  const uint32_t* index = structural_index_.data();
+  const int num_structurals = structural_index_.size();
+  if (num_structurals < 2 || data[index[0]] != '{' || !IsBlank(record, data + index[0])) {
+    return Status::OK();
+  }
+  int i = 1;
+  int key_idx = 0;
+  // Handle the empty object.
+  if (data[index[i]] == '}') ++i;
+  while (data[index[i - 1]] != '}') {
+    // A key is a string followed by a colon.
+    if (i + 2 >= num_structurals || data[index[i]] != '"' || data[index[i + 1]] != '"'
+        || data[index[i + 2]] != ':') {
+      return Status::OK();
+    }
+    char* key = data + index[i] + 1;
+    int field_idx = FindField(key, data + index[i + 1] - key, key_idx++);
+    FieldLocation* field = field_idx >= 0 ? &fields[field_idx] : nullptr;
+    i += 3;
+
+    char* value = const_cast<char*>(SkipWhitespace(data + index[i - 1] + 1, end));
+    if (i >= num_structurals || value == end) return Status::OK();
+    if (*value == '"') {
+      DCHECK_EQ(value, data + index[i]);
+      if (i + 1 >= num_structurals || data[index[i + 1]] != '"') return Status::OK();
+      char* value_end = data + index[i + 1];
+      i += 2;
+      if (field != nullptr) {
+        bool valid_string = true;
+        RETURN_IF_ERROR(
+            SetStringField(value + 1, value_end - value - 1, pool, field, &valid_string));
+        if (!valid_string) return Status::OK();
+      }
+      if (i >= num_structurals || !IsBlank(value_end + 1, data + index[i])) {
+        return Status::OK();
+      }
+    } else if (*value == '{' || *value == '[') {
+      // Skip to the end of the nested value.
+      DCHECK_EQ(value, data + index[i]);
+      int depth = 0;
+      do {
+        char c = data[index[i]];
+        if (c == '{' || c == '[') {
+          ++depth;
+        } else if (c == '}' || c == ']') {
+          --depth;
+        }
+        ++i;
+      } while (depth > 0 && i < num_structurals);
+      if (depth > 0 || i >= num_structurals) return Status::OK();
+      if (field != nullptr) {
+        field->start = value;
+        field->len = data + index[i - 1] + 1 - value;
+      }
+    } else {
+      // A number, boolean or null, which ends at the next structural character.
+      const char* value_end = data + index[i];
+      while (value_end > value && IsJsonWhitespace(value_end[-1])) --value_end;
+      int value_len = value_end - value;
+      if (value_len == 0) return Status::OK();
+      if (field != nullptr) {
+        bool is_null = value_len == 4 && memcmp(value, "null", 4) == 0;
+        field->start = is_null ? nullptr : value;
+        field->len = is_null ? 0 : value_len;
+      }
+    }
+    // The value is followed by a comma or the end of the object.
+    char c = data[index[i++]];
+    if (c != ',' && c != '}') return Status::OK();
+  }
+  *valid = i == num_structurals && IsBlank(data + index[i - 1] + 1, end);
+  return Status::OK();
+}
+
+}
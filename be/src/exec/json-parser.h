@@ -0,0 +1,90 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/status.h"
+#include "exec/hdfs-scanner.h"
+
+namespace impala {
+
+class MemPool;
+
+/// Extracts the values of a fixed set of top-level fields from JSON objects, i.e. from
+/// the records of newline-delimited JSON files.
+///
+/// Parsing happens in two stages, following simdjson. The first stage classifies 64
+/// characters at a time with SIMD compares and builds an index of the structural
+/// characters ({}[]:,) that are not inside of strings, plus the unescaped quotes. The
+/// second stage only walks that index to find the keys and values of the top-level
+/// object, so the bytes of values are never looked at one by one, except for strings
+/// that contain escape sequences.
+///
+/// Values are returned as FieldLocations that can be passed to the TextConverter:
+///  - Strings without the enclosing quotes. Strings with escape sequences are unescaped
+///    into memory from the MemPool passed to Parse().
+///  - Numbers and booleans as they are in the record.
+///  - Nested objects and arrays as their JSON text.
+///  - Missing fields and JSON nulls as NULL, i.e. with a nullptr 'start'.
+/// Records are validated as far as it is needed to find the values, e.g. the contents of
+/// nested values are not.
+class JsonParser {
+ public:
+  /// 'field_names' are the names of the fields to extract, in the order in which their
+  /// values are returned by Parse(). Names are matched case-insensitively, like Hive's
+  /// JsonSerDe does.
+  JsonParser(const std::vector<std::string>& field_names);
+
+  /// Parses the JSON object in [record, record + len) and sets 'fields', which must have
+  /// space for one FieldLocation per field name, to the values of the fields. Sets
+  /// 'valid' to false if the record is not a well-formed JSON object. Returns an error
+  /// if memory for unescaped strings could not be allocated.
+  Status Parse(const char* record, int64_t len, MemPool* pool, FieldLocation* fields,
+      bool* valid);
+
+  int num_fields() const { return field_names_.size(); }
+
+ private:
+  /// Builds 'structural_index_' for the record. Returns false if a string is not
+  /// terminated.
+  bool BuildStructuralIndex(const char* record, int64_t len);
+
+  /// Returns the index of the field with name [key, key + len), or -1 if it is not one
+  /// of the extracted fields. 'key_idx' is the position of the key in the record.
+  int FindField(const char* key, int len, int key_idx);
+
+  /// Sets 'field' to the string [start, start + len), which does not include the quotes,
+  /// unescaping it into memory from 'pool' if needed.
+  Status SetStringField(char* start, int len, MemPool* pool, FieldLocation* field,
+      bool* valid);
+
+  /// Lower-case names of the extracted fields.
+  std::vector<std::string> field_names_;
+
+  /// The i-th element is the field that the i-th key of the last record matched, or -1.
+  /// Records of a file usually list their keys in the same order, so the field that a
+  /// key matched last time is tried first.
+  std::vector<int> key_fields_;
+
+  /// Offsets of the structural characters of the current record.
+  std::vector<uint32_t> structural_index_;
+};
+
+}
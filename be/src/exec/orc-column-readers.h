@@ -596,6 +596,7 @@ class OrcStructReader : public OrcComplexColumnReader {
   }
 
   void SetFileRowIndex(int64_t file_row_idx) { file_row_idx_ = file_row_idx; }
+  int64_t file_row_idx() const { return file_row_idx_; }
 
  private:
   void FillSyntheticRowId(ScratchTupleBatch* scratch_batch, int scratch_batch_idx,
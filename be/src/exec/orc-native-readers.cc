@@ -0,0 +1,547 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/orc-native-readers.h"
+
+#include <limits>
+#include <string.h>
+
+#include "exec/hdfs-orc-scanner.h"
+#include "exec/scratch-tuple-batch.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.h"
+#include "runtime/tuple.h"
+#include "util/codec.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+namespace impala {
+
+/// The streams that hold the data of a column. The index streams that follow them in
+/// orc::StreamKind are not read.
+static const int NUM_DATA_STREAM_KINDS = orc::StreamKind_SECONDARY + 1;
+
+static const char* StreamKindName(orc::StreamKind kind) {
+  switch (kind) {
+    case orc::StreamKind_PRESENT: return "PRESENT";
+    case orc::StreamKind_DATA: return "DATA";
+    case orc::StreamKind_LENGTH: return "LENGTH";
+    case orc::StreamKind_DICTIONARY_DATA: return "DICTIONARY_DATA";
+    default: return "unknown";
+  }
+}
+
+/// Writes the values of the non-null rows to the slots at 'tuple_offset' of the tuples
+/// starting at 'tuple_mem' and sets the null indicators of the other rows.
+template <typename T>
+static void WriteSlots(int num_rows, const T* values, const uint8_t* present,
+    int tuple_offset, const NullIndicatorOffset& null_offset, uint8_t* tuple_mem,
+    int tuple_byte_size) {
+  for (int i = 0; i < num_rows; ++i) {
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_byte_size);
+    if (present != nullptr && !present[i]) {
+      tuple->SetNull(null_offset);
+      continue;
+    }
+    *reinterpret_cast<T*>(tuple->GetSlot(tuple_offset)) = *values++;
+  }
+}
+
+/// Reader for SMALLINT, INT and BIGINT slots of SHORT, INT and LONG columns with the
+/// DIRECT_V2 encoding, whose values are in the signed RLEv2 DATA stream.
+template <typename T>
+class OrcNativeIntColumnReader : public OrcNativeColumnReader {
+ public:
+  OrcNativeIntColumnReader(const orc::Type& node, const SlotDescriptor* slot_desc,
+      HdfsOrcScanner* scanner)
+    : OrcNativeColumnReader(node, slot_desc, scanner), data_decoder_(true) {}
+
+  bool SupportsEncoding(orc::ColumnEncodingKind encoding) const override {
+    return encoding == orc::ColumnEncodingKind_DIRECT_V2;
+  }
+
+ protected:
+  Status StartValues(orc::ColumnEncodingKind encoding, uint32_t dictionary_size,
+      const vector<OrcStreamData>& streams) override {
+    const OrcStreamData& data = streams[orc::StreamKind_DATA];
+    data_decoder_.Reset(data.data, data.len);
+    return Status::OK();
+  }
+
+  Status ReadValues(int num_rows, int num_values, const uint8_t* present,
+      uint8_t* tuple_mem, int tuple_byte_size) override {
+    values_.resize(num_values);
+    if (UNLIKELY(!data_decoder_.GetValues(num_values, values_.data()))) {
+      return CorruptStreamError(orc::StreamKind_DATA);
+    }
+    WriteSlots(num_rows, values_.data(), present, slot_desc_->tuple_offset(),
+        slot_desc_->null_indicator_offset(), tuple_mem, tuple_byte_size);
+    return Status::OK();
+  }
+
+ private:
+  OrcRleV2Decoder data_decoder_;
+  vector<T> values_;
+};
+
+/// Reader for FLOAT and DOUBLE slots of FLOAT and DOUBLE columns, whose values are
+/// stored in the DATA stream as little-endian IEEE 754 floats of the column's type.
+template <typename T>
+class OrcNativeFloatingPointColumnReader : public OrcNativeColumnReader {
+ public:
+  OrcNativeFloatingPointColumnReader(const orc::Type& node,
+      const SlotDescriptor* slot_desc, HdfsOrcScanner* scanner)
+    : OrcNativeColumnReader(node, slot_desc, scanner),
+      value_width_(node.getKind() == orc::FLOAT ? sizeof(float) : sizeof(double)) {}
+
+  bool SupportsEncoding(orc::ColumnEncodingKind encoding) const override {
+    return encoding == orc::ColumnEncodingKind_DIRECT;
+  }
+
+ protected:
+  Status StartValues(orc::ColumnEncodingKind encoding, uint32_t dictionary_size,
+      const vector<OrcStreamData>& streams) override {
+    data_ = streams[orc::StreamKind_DATA].data;
+    data_end_ = data_ + streams[orc::StreamKind_DATA].len;
+    return Status::OK();
+  }
+
+  Status ReadValues(int num_rows, int num_values, const uint8_t* present,
+      uint8_t* tuple_mem, int tuple_byte_size) override {
+    if (UNLIKELY(data_end_ - data_ < static_cast<int64_t>(num_values) * value_width_)) {
+      return CorruptStreamError(orc::StreamKind_DATA);
+    }
+    values_.resize(num_values);
+    if (value_width_ == sizeof(float)) {
+      for (int i = 0; i < num_values; ++i) {
+        float value;
+        memcpy(&value, data_ + i * sizeof(float), sizeof(float));
+        values_[i] = value;
+      }
+    } else {
+      for (int i = 0; i < num_values; ++i) {
+        double value;
+        memcpy(&value, data_ + i * sizeof(double), sizeof(double));
+        values_[i] = value;
+      }
+    }
+    data_ += num_values * value_width_;
+    WriteSlots(num_rows, values_.data(), present, slot_desc_->tuple_offset(),
+        slot_desc_->null_indicator_offset(), tuple_mem, tuple_byte_size);
+    return Status::OK();
+  }
+
+ private:
+  /// Size of the values in the DATA stream.
+  const int value_width_;
+
+  const uint8_t* data_ = nullptr;
+  const uint8_t* data_end_ = nullptr;
+  vector<T> values_;
+};
+
+/// Reader for STRING and VARCHAR slots of STRING, VARCHAR and CHAR columns. The slots
+/// point into the stream that holds the string data, which is not copied:
+///  - DIRECT_V2: the strings are stored one after another in the DATA stream and their
+///    lengths in the unsigned RLEv2 LENGTH stream.
+///  - DICTIONARY_V2: the dictionary entries are stored in the DICTIONARY_DATA stream and
+///    their lengths in the LENGTH stream. The DATA stream holds the unsigned RLEv2
+///    indices of the values in the dictionary.
+class OrcNativeStringColumnReader : public OrcNativeColumnReader {
+ public:
+  OrcNativeStringColumnReader(const orc::Type& node, const SlotDescriptor* slot_desc,
+      HdfsOrcScanner* scanner)
+    : OrcNativeColumnReader(node, slot_desc, scanner),
+      max_len_(slot_desc->type().type == TYPE_VARCHAR ?
+          slot_desc->type().len : std::numeric_limits<int>::max()),
+      data_decoder_(false),
+      length_decoder_(false) {}
+
+  bool SupportsEncoding(orc::ColumnEncodingKind encoding) const override {
+    return encoding == orc::ColumnEncodingKind_DIRECT_V2
+        || encoding == orc::ColumnEncodingKind_DICTIONARY_V2;
+  }
+
+  bool SlotsReferenceStream(orc::StreamKind kind) const override {
+    return kind == orc::StreamKind_DATA || kind == orc::StreamKind_DICTIONARY_DATA;
+  }
+
+ protected:
+  Status StartValues(orc::ColumnEncodingKind encoding, uint32_t dictionary_size,
+      const vector<OrcStreamData>& streams) override {
+    is_dictionary_ = encoding == orc::ColumnEncodingKind_DICTIONARY_V2;
+    const OrcStreamData& length = streams[orc::StreamKind_LENGTH];
+    length_decoder_.Reset(length.data, length.len);
+    if (!is_dictionary_) {
+      data_ = streams[orc::StreamKind_DATA].data;
+      data_end_ = data_ + streams[orc::StreamKind_DATA].len;
+      return Status::OK();
+    }
+    const OrcStreamData& data = streams[orc::StreamKind_DATA];
+    data_decoder_.Reset(data.data, data.len);
+    // Decode the whole dictionary up front, the indices can refer to any entry.
+    const OrcStreamData& dict_data = streams[orc::StreamKind_DICTIONARY_DATA];
+    const uint8_t* dict = dict_data.data;
+    dictionary_.resize(dictionary_size);
+    return DecodeStrings(
+        dictionary_size, dict, dict_data.data + dict_data.len, dictionary_.data());
+  }
+
+  Status ReadValues(int num_rows, int num_values, const uint8_t* present,
+      uint8_t* tuple_mem, int tuple_byte_size) override {
+    values_.resize(num_values);
+    if (is_dictionary_) {
+      indices_.resize(num_values);
+      if (UNLIKELY(!data_decoder_.GetValues(num_values, indices_.data()))) {
+        return CorruptStreamError(orc::StreamKind_DATA);
+      }
+      for (int i = 0; i < num_values; ++i) {
+        if (UNLIKELY(indices_[i] >= dictionary_.size())) {
+          return CorruptStreamError(orc::StreamKind_DATA);
+        }
+        values_[i] = dictionary_[indices_[i]];
+      }
+    } else {
+      RETURN_IF_ERROR(DecodeStrings(num_values, data_, data_end_, values_.data()));
+    }
+    WriteSlots(num_rows, values_.data(), present, slot_desc_->tuple_offset(),
+        slot_desc_->null_indicator_offset(), tuple_mem, tuple_byte_size);
+    return Status::OK();
+  }
+
+ private:
+  /// Decodes the lengths of the next 'num_values' strings from the LENGTH stream into
+  /// 'values', which point to the strings stored one after another from 'data' on.
+  /// Advances 'data' past them.
+  Status DecodeStrings(int64_t num_values, const uint8_t*& data, const uint8_t* data_end,
+      StringValue* values) {
+    lengths_.resize(num_values);
+    if (UNLIKELY(!length_decoder_.GetValues(num_values, lengths_.data()))) {
+      return CorruptStreamError(orc::StreamKind_LENGTH);
+    }
+    for (int64_t i = 0; i < num_values; ++i) {
+      uint64_t len = lengths_[i];
+      if (UNLIKELY(len > static_cast<uint64_t>(data_end - data)
+          || len > std::numeric_limits<int>::max())) {
+        return CorruptStreamError(is_dictionary_ ?
+            orc::StreamKind_DICTIONARY_DATA : orc::StreamKind_DATA);
+      }
+      values[i] = StringValue(reinterpret_cast<char*>(const_cast<uint8_t*>(data)),
+          min<int>(len, max_len_));
+      data += len;
+    }
+    return Status::OK();
+  }
+
+  /// Maximum length of the slot's strings. VARCHAR values are truncated to it.
+  const int max_len_;
+
+  /// True if the column has the DICTIONARY_V2 encoding in the current stripe.
+  bool is_dictionary_ = false;
+
+  /// Decoder of the dictionary indices in the DATA stream.
+  OrcRleV2Decoder data_decoder_;
+
+  /// Decoder of the lengths of the values or of the dictionary entries.
+  OrcRleV2Decoder length_decoder_;
+
+  /// The rest of the string data of DIRECT_V2 columns.
+  const uint8_t* data_ = nullptr;
+  const uint8_t* data_end_ = nullptr;
+
+  vector<StringValue> dictionary_;
+  vector<StringValue> values_;
+  vector<uint64_t> indices_;
+  vector<uint64_t> lengths_;
+};
+
+OrcNativeColumnReader* OrcNativeColumnReader::Create(const orc::Type& node,
+    const SlotDescriptor* slot_desc, HdfsOrcScanner* scanner) {
+  orc::TypeKind kind = node.getKind();
+  bool is_int = kind == orc::SHORT || kind == orc::INT || kind == orc::LONG;
+  bool is_string = kind == orc::STRING || kind == orc::VARCHAR || kind == orc::CHAR;
+  OrcNativeColumnReader* reader = nullptr;
+  switch (slot_desc->type().type) {
+    case TYPE_SMALLINT:
+      if (!is_int) break;
+      reader = new OrcNativeIntColumnReader<int16_t>(node, slot_desc, scanner);
+      break;
+    case TYPE_INT:
+      if (!is_int) break;
+      reader = new OrcNativeIntColumnReader<int32_t>(node, slot_desc, scanner);
+      break;
+    case TYPE_BIGINT:
+      if (!is_int) break;
+      reader = new OrcNativeIntColumnReader<int64_t>(node, slot_desc, scanner);
+      break;
+    case TYPE_FLOAT:
+      if (kind == orc::FLOAT) {
+        reader = new OrcNativeFloatingPointColumnReader<float>(node, slot_desc, scanner);
+      }
+      break;
+    case TYPE_DOUBLE:
+      if (kind == orc::FLOAT || kind == orc::DOUBLE) {
+        reader = new OrcNativeFloatingPointColumnReader<double>(node, slot_desc, scanner);
+      }
+      break;
+    case TYPE_STRING:
+    case TYPE_VARCHAR:
+      if (is_string) reader = new OrcNativeStringColumnReader(node, slot_desc, scanner);
+      break;
+    default:
+      break;
+  }
+  if (reader == nullptr) return nullptr;
+  return scanner->obj_pool_.Add(reader);
+}
+
+OrcNativeColumnReader::OrcNativeColumnReader(const orc::Type& node,
+    const SlotDescriptor* slot_desc, HdfsOrcScanner* scanner)
+  : slot_desc_(slot_desc),
+    scanner_(scanner),
+    orc_column_id_(node.getColumnId()) {
+}
+
+Status OrcNativeColumnReader::StartStripe(orc::ColumnEncodingKind encoding,
+    uint32_t dictionary_size, const vector<OrcStreamData>& streams) {
+  DCHECK(SupportsEncoding(encoding));
+  const OrcStreamData& present = streams[orc::StreamKind_PRESENT];
+  has_present_stream_ = present.data != nullptr;
+  if (has_present_stream_) present_decoder_.Reset(present.data, present.len);
+  return StartValues(encoding, dictionary_size, streams);
+}
+
+Status OrcNativeColumnReader::ReadValueBatch(int num_rows, uint8_t* tuple_mem,
+    int tuple_byte_size) {
+  if (!has_present_stream_) {
+    return ReadValues(num_rows, num_rows, nullptr, tuple_mem, tuple_byte_size);
+  }
+  present_.resize(num_rows);
+  if (UNLIKELY(!present_decoder_.GetValues(num_rows, present_.data()))) {
+    return CorruptStreamError(orc::StreamKind_PRESENT);
+  }
+  int num_values = 0;
+  for (int i = 0; i < num_rows; ++i) num_values += present_[i];
+  return ReadValues(num_rows, num_values, present_.data(), tuple_mem, tuple_byte_size);
+}
+
+Status OrcNativeColumnReader::CorruptStreamError(orc::StreamKind kind) const {
+  return Status(Substitute("Corrupt ORC file: $0. Invalid $1 stream of column $2.",
+      scanner_->filename(), StreamKindName(kind), orc_column_id_));
+}
+
+OrcNativeStripeReader::OrcNativeStripeReader(HdfsOrcScanner* scanner,
+    vector<OrcNativeColumnReader*> readers, MemPool* data_pool)
+  : scanner_(scanner),
+    readers_(move(readers)),
+    data_pool_(data_pool),
+    stripe_pool_(new MemPool(scanner->scan_node_->mem_tracker())) {
+}
+
+OrcNativeStripeReader::~OrcNativeStripeReader() {
+  DCHECK(decompressor_ == nullptr) << "Must call Close()";
+}
+
+bool OrcNativeStripeReader::SupportsCompression(orc::CompressionKind compression) {
+  switch (compression) {
+    case orc::CompressionKind_NONE:
+    case orc::CompressionKind_ZLIB:
+    case orc::CompressionKind_SNAPPY:
+    case orc::CompressionKind_LZ4:
+    case orc::CompressionKind_ZSTD:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Status OrcNativeStripeReader::Open(orc::CompressionKind compression,
+    uint64_t compression_block_size) {
+  DCHECK(SupportsCompression(compression));
+  if (compression == orc::CompressionKind_NONE) return Status::OK();
+  // The chunks of ORC streams are compressed without the headers of the codecs' file
+  // formats, i.e. ZLIB chunks are raw deflate streams.
+  THdfsCompression::type format;
+  switch (compression) {
+    case orc::CompressionKind_ZLIB: format = THdfsCompression::DEFLATE; break;
+    case orc::CompressionKind_SNAPPY: format = THdfsCompression::SNAPPY; break;
+    case orc::CompressionKind_LZ4: format = THdfsCompression::LZ4; break;
+    case orc::CompressionKind_ZSTD: format = THdfsCompression::ZSTD; break;
+    default: DCHECK(false); return Status::OK();
+  }
+  compression_block_size_ = compression_block_size;
+  decompressor_pool_.reset(new MemPool(scanner_->scan_node_->mem_tracker()));
+  return Codec::CreateDecompressor(decompressor_pool_.get(), false, format,
+      &decompressor_);
+}
+
+void OrcNativeStripeReader::Close() {
+  stripe_pool_->FreeAll();
+  if (decompressor_ != nullptr) {
+    decompressor_->Close();
+    decompressor_.reset();
+  }
+  if (decompressor_pool_ != nullptr) decompressor_pool_->FreeAll();
+}
+
+Status OrcNativeStripeReader::StartStripe(const orc::StripeInformation& stripe,
+    bool* supported) {
+  *supported = false;
+  rows_remaining_ = 0;
+  stripe_pool_->FreeAll();
+  vector<orc::ColumnEncodingKind> encodings;
+  vector<uint32_t> dictionary_sizes;
+  vector<unique_ptr<orc::StreamInformation>> stream_infos;
+  // The ORC library reads the stripe footer, which holds the encodings and streams of
+  // the columns, through the scanner's ScanRangeInputStream.
+  try {
+    for (OrcNativeColumnReader* reader : readers_) {
+      uint64_t column_id = reader->orc_column_id();
+      orc::ColumnEncodingKind encoding = stripe.getColumnEncoding(column_id);
+      if (!reader->SupportsEncoding(encoding)) return Status::OK();
+      encodings.push_back(encoding);
+      dictionary_sizes.push_back(stripe.getDictionarySize(column_id));
+    }
+    for (uint64_t i = 0; i < stripe.getNumberOfStreams(); ++i) {
+      stream_infos.push_back(stripe.getStreamInformation(i));
+    }
+  } catch (HdfsOrcScanner::ResourceError& e) {
+    return e.GetStatus();
+  } catch (std::exception& e) {
+    return Status(Substitute("Encountered parse error in the footer of a stripe of ORC "
+        "file $0: $1", scanner_->filename(), e.what()));
+  }
+  for (int i = 0; i < readers_.size(); ++i) {
+    vector<OrcStreamData> streams(NUM_DATA_STREAM_KINDS);
+    RETURN_IF_ERROR(ReadColumnStreams(readers_[i], stream_infos, &streams));
+    RETURN_IF_ERROR(readers_[i]->StartStripe(encodings[i], dictionary_sizes[i], streams));
+  }
+  *supported = true;
+  rows_remaining_ = stripe.getNumberOfRows();
+  return Status::OK();
+}
+
+Status OrcNativeStripeReader::ReadColumnStreams(OrcNativeColumnReader* reader,
+    const vector<unique_ptr<orc::StreamInformation>>& stream_infos,
+    vector<OrcStreamData>* streams) {
+  // Writers store the data streams of a column next to each other, so they are read
+  // with a single I/O.
+  int64_t begin = std::numeric_limits<int64_t>::max();
+  int64_t end = 0;
+  bool referenced = false;
+  for (const unique_ptr<orc::StreamInformation>& info : stream_infos) {
+    if (info->getColumnId() != reader->orc_column_id()) continue;
+    if (info->getKind() >= NUM_DATA_STREAM_KINDS) continue;
+    begin = min<int64_t>(begin, info->getOffset());
+    end = max<int64_t>(end, info->getOffset() + info->getLength());
+    referenced |= reader->SlotsReferenceStream(info->getKind());
+  }
+  if (end == 0) return Status::OK();
+
+  // Slots can reference the read buffer directly unless it needs to be decompressed.
+  MemPool* pool =
+      referenced && decompressor_ == nullptr ? data_pool_ : stripe_pool_.get();
+  uint8_t* buffer;
+  RETURN_IF_ERROR(Allocate(pool, end - begin, &buffer));
+  RETURN_IF_ERROR(scanner_->ReadFileBytes(buffer, end - begin, begin));
+  for (const unique_ptr<orc::StreamInformation>& info : stream_infos) {
+    if (info->getColumnId() != reader->orc_column_id()) continue;
+    orc::StreamKind kind = info->getKind();
+    if (kind >= NUM_DATA_STREAM_KINDS) continue;
+    OrcStreamData* stream = &(*streams)[kind];
+    const uint8_t* data = buffer + (info->getOffset() - begin);
+    if (decompressor_ == nullptr) {
+      stream->data = data;
+      stream->len = info->getLength();
+    } else {
+      MemPool* output_pool =
+          reader->SlotsReferenceStream(kind) ? data_pool_ : stripe_pool_.get();
+      RETURN_IF_ERROR(Decompress(data, info->getLength(), output_pool, stream));
+    }
+  }
+  return Status::OK();
+}
+
+Status OrcNativeStripeReader::Decompress(const uint8_t* data, int64_t len,
+    MemPool* pool, OrcStreamData* stream) {
+  // Compressed streams are sequences of chunks of at most 'compression_block_size_'
+  // bytes of decompressed data. Each chunk starts with a 3 byte little-endian header
+  // that holds its length shifted left by one, with the lowest bit set if the chunk is
+  // stored uncompressed.
+  Status corrupt_error(Substitute("Corrupt ORC file: $0. Invalid compression chunk in "
+      "a stream of the stripe.", scanner_->filename()));
+  const uint8_t* data_end = data + len;
+  int64_t num_chunks = 0;
+  for (const uint8_t* chunk = data; chunk < data_end; ++num_chunks) {
+    if (UNLIKELY(data_end - chunk < 3)) return corrupt_error;
+    uint32_t header = chunk[0] | (chunk[1] << 8) | (chunk[2] << 16);
+    chunk += 3;
+    if (UNLIKELY(header >> 1 > data_end - chunk)) return corrupt_error;
+    chunk += header >> 1;
+  }
+  uint8_t* output;
+  RETURN_IF_ERROR(Allocate(pool, num_chunks * compression_block_size_, &output));
+  int64_t output_len = 0;
+  for (const uint8_t* chunk = data; chunk < data_end;) {
+    uint32_t header = chunk[0] | (chunk[1] << 8) | (chunk[2] << 16);
+    int64_t chunk_len = header >> 1;
+    chunk += 3;
+    if (header & 1) {
+      if (UNLIKELY(chunk_len > compression_block_size_)) return corrupt_error;
+      memcpy(output + output_len, chunk, chunk_len);
+      output_len += chunk_len;
+    } else {
+      int64_t chunk_output_len = compression_block_size_;
+      uint8_t* chunk_output = output + output_len;
+      RETURN_IF_ERROR(decompressor_->ProcessBlock(
+          true, chunk_len, chunk, &chunk_output_len, &chunk_output));
+      output_len += chunk_output_len;
+    }
+    chunk += chunk_len;
+  }
+  stream->data = output;
+  stream->len = output_len;
+  return Status::OK();
+}
+
+Status OrcNativeStripeReader::Allocate(MemPool* pool, int64_t len, uint8_t** buffer) {
+  *buffer = pool->TryAllocate(len);
+  if (UNLIKELY(*buffer == nullptr)) {
+    string details = Substitute("Could not allocate $0 bytes for the streams of a "
+        "stripe of ORC file '$1'.", len, scanner_->filename());
+    return scanner_->scan_node_->mem_tracker()->MemLimitExceeded(
+        scanner_->state_, details, len);
+  }
+  return Status::OK();
+}
+
+Status OrcNativeStripeReader::ReadBatch(ScratchTupleBatch* scratch_batch) {
+  int num_rows = min<int64_t>(scratch_batch->capacity, rows_remaining_);
+  for (OrcNativeColumnReader* reader : readers_) {
+    RETURN_IF_ERROR(reader->ReadValueBatch(
+        num_rows, scratch_batch->tuple_mem, scratch_batch->tuple_byte_size));
+  }
+  scratch_batch->num_tuples = num_rows;
+  rows_remaining_ -= num_rows;
+  return Status::OK();
+}
+
+}
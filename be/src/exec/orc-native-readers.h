@@ -0,0 +1,182 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <orc/OrcFile.hh>
+
+#include "common/status.h"
+#include "exec/orc-rle-decoder.h"
+
+namespace impala {
+
+class Codec;
+class HdfsOrcScanner;
+class MemPool;
+class SlotDescriptor;
+struct ScratchTupleBatch;
+
+/// The decompressed bytes of a stream of an ORC stripe.
+struct OrcStreamData {
+  const uint8_t* data = nullptr;
+  int64_t len = 0;
+};
+
+/// Base class for decoding a primitive top-level ORC column directly from the streams of
+/// a stripe into the slots of tuples, without the orc::ColumnVectorBatch that the ORC
+/// library decodes the column into. The nulls of a column are decoded from its PRESENT
+/// stream, if it has one, and its values, which only exist for the non-null rows, by the
+/// subclasses.
+class OrcNativeColumnReader {
+ public:
+  /// Creates a reader for 'slot_desc', which is materialized from the ORC column 'node',
+  /// in the object pool of 'scanner'. Returns nullptr if the type of the slot or of the
+  /// column is not supported.
+  static OrcNativeColumnReader* Create(const orc::Type& node,
+      const SlotDescriptor* slot_desc, HdfsOrcScanner* scanner);
+
+  virtual ~OrcNativeColumnReader() {}
+
+  /// Returns true if columns with 'encoding' can be decoded.
+  virtual bool SupportsEncoding(orc::ColumnEncodingKind encoding) const = 0;
+
+  /// Returns true if the slots point into the data of the stream of 'kind', which then
+  /// must stay valid until the rows are consumed.
+  virtual bool SlotsReferenceStream(orc::StreamKind kind) const { return false; }
+
+  /// Starts decoding the column of a new stripe from 'streams', which is indexed by
+  /// orc::StreamKind. 'encoding' must be supported. 'dictionary_size' is the number of
+  /// dictionary entries of DICTIONARY_V2 columns.
+  Status StartStripe(orc::ColumnEncodingKind encoding, uint32_t dictionary_size,
+      const std::vector<OrcStreamData>& streams) WARN_UNUSED_RESULT;
+
+  /// Decodes the next 'num_rows' rows of the column into the slots of the tuples in
+  /// [tuple_mem, tuple_mem + num_rows * tuple_byte_size).
+  Status ReadValueBatch(int num_rows, uint8_t* tuple_mem, int tuple_byte_size)
+      WARN_UNUSED_RESULT;
+
+  uint64_t orc_column_id() const { return orc_column_id_; }
+
+ protected:
+  OrcNativeColumnReader(const orc::Type& node, const SlotDescriptor* slot_desc,
+      HdfsOrcScanner* scanner);
+
+  /// Called by StartStripe() to initialize the decoding of the values.
+  virtual Status StartValues(orc::ColumnEncodingKind encoding, uint32_t dictionary_size,
+      const std::vector<OrcStreamData>& streams) WARN_UNUSED_RESULT = 0;
+
+  /// Decodes the values of 'num_rows' rows into the slots of the tuples starting at
+  /// 'tuple_mem'. 'present' has one byte per row that is 0 for NULLs, or is nullptr if
+  /// there are no NULLs. 'num_values' is the number of non-null rows.
+  virtual Status ReadValues(int num_rows, int num_values, const uint8_t* present,
+      uint8_t* tuple_mem, int tuple_byte_size) WARN_UNUSED_RESULT = 0;
+
+  /// Returns the error for a corrupt stream of 'kind'.
+  Status CorruptStreamError(orc::StreamKind kind) const;
+
+  const SlotDescriptor* const slot_desc_;
+  HdfsOrcScanner* const scanner_;
+  const uint64_t orc_column_id_;
+
+ private:
+  /// Decoder of the PRESENT stream and whether the column has one in the current stripe.
+  OrcBoolRleDecoder present_decoder_;
+  bool has_present_stream_ = false;
+
+  /// Scratch space for the decoded PRESENT stream of a batch.
+  std::vector<uint8_t> present_;
+};
+
+/// Decodes the slots of a flat scan of an ORC file directly from the streams of the
+/// stripes, with an OrcNativeColumnReader per slot. This avoids the ORC library's
+/// intermediate orc::ColumnVectorBatches, from which the values would have to be copied
+/// into the tuples, and the string data is referenced in place instead of being copied
+/// out of them.
+///
+/// The streams of the selected columns are read and decompressed a stripe at a time.
+/// String data of uncompressed files is referenced directly in the buffers that the
+/// streams are read into. Stripes with an encoding that is not supported, e.g. RLEv1
+/// written by old versions of Hive, are left to the ORC library.
+class OrcNativeStripeReader {
+ public:
+  /// 'readers' decode the slots of the scan. 'data_pool' is used for the stream data
+  /// that slots reference; the scanner transfers it to the output at the end of each
+  /// stripe.
+  OrcNativeStripeReader(HdfsOrcScanner* scanner,
+      std::vector<OrcNativeColumnReader*> readers, MemPool* data_pool);
+  ~OrcNativeStripeReader();
+
+  /// Creates the decompressor for the file's 'compression', which must be supported,
+  /// see SupportsCompression().
+  Status Open(orc::CompressionKind compression, uint64_t compression_block_size)
+      WARN_UNUSED_RESULT;
+
+  /// Frees the resources that are not transferred to 'data_pool'.
+  void Close();
+
+  /// Returns true if files compressed with 'compression' can be decoded.
+  static bool SupportsCompression(orc::CompressionKind compression);
+
+  /// Prepares the decoding of 'stripe' by reading and decompressing the streams of the
+  /// columns. Sets 'supported' to false, without reading anything, if any of the
+  /// columns has an encoding that is not supported.
+  Status StartStripe(const orc::StripeInformation& stripe, bool* supported)
+      WARN_UNUSED_RESULT;
+
+  /// Decodes the next rows of the current stripe into 'scratch_batch', as many as fit.
+  Status ReadBatch(ScratchTupleBatch* scratch_batch) WARN_UNUSED_RESULT;
+
+  int64_t rows_remaining() const { return rows_remaining_; }
+
+ private:
+  /// Reads the streams of the column of 'reader', which are among 'stream_infos', into
+  /// 'streams', decompressing them if needed.
+  Status ReadColumnStreams(OrcNativeColumnReader* reader,
+      const std::vector<std::unique_ptr<orc::StreamInformation>>& stream_infos,
+      std::vector<OrcStreamData>* streams) WARN_UNUSED_RESULT;
+
+  /// Decompresses the compressed stream [data, data + len) into memory from 'pool'.
+  Status Decompress(const uint8_t* data, int64_t len, MemPool* pool,
+      OrcStreamData* stream) WARN_UNUSED_RESULT;
+
+  /// Allocates 'len' bytes from 'pool'.
+  Status Allocate(MemPool* pool, int64_t len, uint8_t** buffer) WARN_UNUSED_RESULT;
+
+  HdfsOrcScanner* const scanner_;
+  const std::vector<OrcNativeColumnReader*> readers_;
+
+  /// Pool for the stream data that slots reference. Owned by the scanner.
+  MemPool* const data_pool_;
+
+  /// Pool for the other stream data of the current stripe.
+  boost::scoped_ptr<MemPool> stripe_pool_;
+
+  /// Decompressor of the file and the maximum size of decompressed chunks. Null if the
+  /// file is not compressed.
+  boost::scoped_ptr<MemPool> decompressor_pool_;
+  boost::scoped_ptr<Codec> decompressor_;
+  int64_t compression_block_size_ = 0;
+
+  /// Number of rows of the current stripe that were not decoded yet.
+  int64_t rows_remaining_ = 0;
+};
+
+}
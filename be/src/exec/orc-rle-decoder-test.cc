@@ -0,0 +1,101 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <vector>
+
+#include "exec/orc-rle-decoder.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+/// Decodes 'encoded' with an RLEv2 decoder and checks that it holds exactly 'expected'.
+template <typename T>
+static void ValidateRleV2(bool is_signed, const vector<uint8_t>& encoded,
+    const vector<int64_t>& expected) {
+  OrcRleV2Decoder decoder(is_signed);
+  decoder.Reset(encoded.data(), encoded.size());
+  vector<T> values(expected.size());
+  ASSERT_TRUE(decoder.GetValues(values.size(), values.data()));
+  for (int i = 0; i < expected.size(); ++i) EXPECT_EQ(expected[i], values[i]) << i;
+  T extra;
+  EXPECT_FALSE(decoder.GetValues(1, &extra));
+}
+
+// The examples are from the ORC specification.
+TEST(OrcRleDecoderTest, ShortRepeat) {
+  ValidateRleV2<int64_t>(false, {0x0a, 0x27, 0x10}, {10000, 10000, 10000, 10000, 10000});
+  ValidateRleV2<int32_t>(true, {0x00, 0x01}, {-1, -1, -1});
+}
+
+TEST(OrcRleDecoderTest, Direct) {
+  ValidateRleV2<int64_t>(false, {0x5e, 0x03, 0x5c, 0xa1, 0xab, 0x1e, 0xde, 0xad, 0xbe,
+      0xef}, {23713, 43806, 57005, 48879});
+  // 3 bit zigzag-encoded values.
+  ValidateRleV2<int64_t>(true, {0x44, 0x03, 0x05, 0x30}, {0, -1, 1, -2});
+}
+
+TEST(OrcRleDecoderTest, PatchedBase) {
+  ValidateRleV2<int64_t>(false, {0x8e, 0x13, 0x2b, 0x21, 0x07, 0xd0, 0x1e, 0x00, 0x14,
+      0x70, 0x28, 0x32, 0x3c, 0x46, 0x50, 0x5a, 0x64, 0x6e, 0x78, 0x82, 0x8c, 0x96,
+      0xa0, 0xaa, 0xb4, 0xbe, 0xfc, 0xe8}, {2030, 2000, 2020, 1000000, 2040, 2050, 2060,
+      2070, 2080, 2090, 2100, 2110, 2120, 2130, 2140, 2150, 2160, 2170, 2180, 2190});
+}
+
+TEST(OrcRleDecoderTest, Delta) {
+  ValidateRleV2<int64_t>(false, {0xc6, 0x09, 0x02, 0x02, 0x22, 0x42, 0x42, 0x46},
+      {2, 3, 5, 7, 11, 13, 17, 19, 23, 29});
+  // Fixed negative delta.
+  ValidateRleV2<int16_t>(true, {0xc0, 0x04, 0x14, 0x03}, {10, 8, 6, 4, 2});
+  // Decreasing values with varying deltas.
+  ValidateRleV2<int64_t>(false, {0xc6, 0x03, 0x64, 0x01, 0x23}, {100, 99, 97, 94});
+}
+
+TEST(OrcRleDecoderTest, Truncated) {
+  vector<uint8_t> encoded = {0x5e, 0x03, 0x5c, 0xa1};
+  OrcRleV2Decoder decoder(false);
+  decoder.Reset(encoded.data(), encoded.size());
+  int64_t values[4];
+  EXPECT_FALSE(decoder.GetValues(4, values));
+}
+
+TEST(OrcRleDecoderTest, ByteRle) {
+  // A run of 100 zeros followed by the literals 0x44 and 0x45.
+  vector<uint8_t> encoded = {0x61, 0x00, 0xfe, 0x44, 0x45};
+  OrcByteRleDecoder decoder;
+  decoder.Reset(encoded.data(), encoded.size());
+  uint8_t values[102];
+  ASSERT_TRUE(decoder.GetValues(102, values));
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(0, values[i]) << i;
+  EXPECT_EQ(0x44, values[100]);
+  EXPECT_EQ(0x45, values[101]);
+  EXPECT_FALSE(decoder.GetValues(1, values));
+}
+
+TEST(OrcRleDecoderTest, BoolRle) {
+  // The literal byte 0x80 encodes a true followed by seven falses.
+  vector<uint8_t> encoded = {0xff, 0x80};
+  OrcBoolRleDecoder decoder;
+  decoder.Reset(encoded.data(), encoded.size());
+  uint8_t values[8];
+  ASSERT_TRUE(decoder.GetValues(8, values));
+  EXPECT_EQ(1, values[0]);
+  for (int i = 1; i < 8; ++i) EXPECT_EQ(0, values[i]) << i;
+}
+
+}
@@ -0,0 +1,303 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/orc-rle-decoder.h"
+
+#include <string.h>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+/// Minimum length of a repeated run of the byte run length encoding.
+static const int BYTE_RLE_MIN_REPEAT = 3;
+
+void OrcByteRleDecoder::Reset(const uint8_t* data, int64_t len) {
+  data_ = data;
+  data_end_ = data + len;
+  run_remaining_ = 0;
+}
+
+bool OrcByteRleDecoder::GetValues(int64_t num_values, uint8_t* values) {
+  while (num_values > 0) {
+    if (run_remaining_ == 0) {
+      if (UNLIKELY(data_ == data_end_)) return false;
+      int8_t control = static_cast<int8_t>(*data_++);
+      run_is_repeated_ = control >= 0;
+      if (run_is_repeated_) {
+        if (UNLIKELY(data_ == data_end_)) return false;
+        run_remaining_ = control + BYTE_RLE_MIN_REPEAT;
+        repeated_value_ = *data_++;
+      } else {
+        run_remaining_ = -static_cast<int64_t>(control);
+        if (UNLIKELY(data_end_ - data_ < run_remaining_)) return false;
+      }
+    }
+    int64_t n = min(num_values, run_remaining_);
+    if (run_is_repeated_) {
+      memset(values, repeated_value_, n);
+    } else {
+      memcpy(values, data_, n);
+      data_ += n;
+    }
+    run_remaining_ -= n;
+    values += n;
+    num_values -= n;
+  }
+  return true;
+}
+
+void OrcBoolRleDecoder::Reset(const uint8_t* data, int64_t len) {
+  byte_decoder_.Reset(data, len);
+  bits_left_ = 0;
+}
+
+bool OrcBoolRleDecoder::GetValues(int64_t num_values, uint8_t* values) {
+  for (int64_t i = 0; i < num_values; ++i) {
+    if (bits_left_ == 0) {
+      if (UNLIKELY(!byte_decoder_.GetValues(1, &current_byte_))) return false;
+      bits_left_ = 8;
+    }
+    --bits_left_;
+    values[i] = (current_byte_ >> bits_left_) & 1;
+  }
+  return true;
+}
+
+/// The sub-encodings of RLEv2, stored in the two most significant bits of the first
+/// byte of a run.
+enum RleV2Encoding {
+  SHORT_REPEAT = 0,
+  DIRECT = 1,
+  PATCHED_BASE = 2,
+  DELTA = 3
+};
+
+/// Minimum length of a SHORT_REPEAT run.
+static const int SHORT_REPEAT_MIN_LENGTH = 3;
+
+void OrcRleV2Decoder::Reset(const uint8_t* data, int64_t len) {
+  data_ = data;
+  data_end_ = data + len;
+  num_literals_ = 0;
+  literal_idx_ = 0;
+}
+
+int OrcRleV2Decoder::DecodeBitWidth(int code) {
+  DCHECK_GE(code, 0);
+  DCHECK_LT(code, 32);
+  if (code < 24) return code + 1;
+  // Codes 24 to 31 stand for 26, 28, 30, 32, 40, 48, 56 and 64 bits.
+  if (code < 28) return 26 + (code - 24) * 2;
+  return 40 + (code - 28) * 8;
+}
+
+int OrcRleV2Decoder::ClosestFixedBits(int bit_width) {
+  if (bit_width == 0) return 1;
+  if (bit_width <= 24) return bit_width;
+  if (bit_width <= 32) return (bit_width + 1) & ~1;
+  return (bit_width + 7) & ~7;
+}
+
+bool OrcRleV2Decoder::ReadVarint(uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (UNLIKELY(data_ == data_end_)) return false;
+    uint8_t byte = *data_++;
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool OrcRleV2Decoder::ReadBigEndian(int num_bytes, uint64_t* value) {
+  if (UNLIKELY(data_end_ - data_ < num_bytes)) return false;
+  uint64_t result = 0;
+  for (int i = 0; i < num_bytes; ++i) result = (result << 8) | data_[i];
+  data_ += num_bytes;
+  *value = result;
+  return true;
+}
+
+bool OrcRleV2Decoder::UnpackBits(int bit_width, int num_values, int64_t* values) {
+  DCHECK_GE(bit_width, 1);
+  DCHECK_LE(bit_width, 64);
+  int64_t num_bytes = (static_cast<int64_t>(bit_width) * num_values + 7) / 8;
+  if (UNLIKELY(data_end_ - data_ < num_bytes)) return false;
+  if (bit_width % 8 == 0) {
+    // Byte-aligned values are common, e.g. for the dictionary indices of small
+    // dictionaries, so they get a simpler loop.
+    int bytes_per_value = bit_width / 8;
+    for (int i = 0; i < num_values; ++i) {
+      uint64_t value = 0;
+      for (int j = 0; j < bytes_per_value; ++j) value = (value << 8) | data_[j];
+      data_ += bytes_per_value;
+      values[i] = static_cast<int64_t>(value);
+    }
+    return true;
+  }
+  uint64_t current_byte = 0;
+  int bits_left = 0;
+  for (int i = 0; i < num_values; ++i) {
+    uint64_t value = 0;
+    int bits_needed = bit_width;
+    while (bits_needed > bits_left) {
+      value = (value << bits_left) | (current_byte & ((1U << bits_left) - 1));
+      bits_needed -= bits_left;
+      current_byte = *data_++;
+      bits_left = 8;
+    }
+    if (bits_needed > 0) {
+      bits_left -= bits_needed;
+      value = (value << bits_needed)
+          | ((current_byte >> bits_left) & ((1U << bits_needed) - 1));
+    }
+    values[i] = static_cast<int64_t>(value);
+  }
+  return true;
+}
+
+bool OrcRleV2Decoder::DecodeRun() {
+  if (UNLIKELY(data_ == data_end_)) return false;
+  uint8_t first_byte = *data_++;
+  literal_idx_ = 0;
+  switch (first_byte >> 6) {
+    case SHORT_REPEAT: return DecodeShortRepeat(first_byte);
+    case DIRECT: return DecodeDirect(first_byte);
+    case PATCHED_BASE: return DecodePatchedBase(first_byte);
+    case DELTA: return DecodeDelta(first_byte);
+  }
+  DCHECK(false);
+  return false;
+}
+
+bool OrcRleV2Decoder::DecodeShortRepeat(uint8_t first_byte) {
+  int num_bytes = ((first_byte >> 3) & 0x07) + 1;
+  num_literals_ = (first_byte & 0x07) + SHORT_REPEAT_MIN_LENGTH;
+  uint64_t value;
+  if (UNLIKELY(!ReadBigEndian(num_bytes, &value))) return false;
+  int64_t literal = is_signed_ ? ZigzagDecode(value) : static_cast<int64_t>(value);
+  for (int i = 0; i < num_literals_; ++i) literals_[i] = literal;
+  return true;
+}
+
+bool OrcRleV2Decoder::DecodeDirect(uint8_t first_byte) {
+  int bit_width = DecodeBitWidth((first_byte >> 1) & 0x1f);
+  if (UNLIKELY(data_ == data_end_)) return false;
+  num_literals_ = (((first_byte & 0x01) << 8) | *data_++) + 1;
+  if (UNLIKELY(!UnpackBits(bit_width, num_literals_, literals_))) return false;
+  if (is_signed_) {
+    for (int i = 0; i < num_literals_; ++i) {
+      literals_[i] = ZigzagDecode(static_cast<uint64_t>(literals_[i]));
+    }
+  }
+  return true;
+}
+
+bool OrcRleV2Decoder::DecodePatchedBase(uint8_t first_byte) {
+  int bit_width = DecodeBitWidth((first_byte >> 1) & 0x1f);
+  if (UNLIKELY(data_end_ - data_ < 3)) return false;
+  num_literals_ = (((first_byte & 0x01) << 8) | data_[0]) + 1;
+  int base_bytes = ((data_[1] >> 5) & 0x07) + 1;
+  int patch_width = DecodeBitWidth(data_[1] & 0x1f);
+  int patch_gap_width = ((data_[2] >> 5) & 0x07) + 1;
+  int num_patches = data_[2] & 0x1f;
+  data_ += 3;
+  if (UNLIKELY(patch_width + patch_gap_width > 64 || bit_width + patch_width > 64)) {
+    return false;
+  }
+
+  // The base value is stored in sign-magnitude form.
+  uint64_t base_magnitude;
+  if (UNLIKELY(!ReadBigEndian(base_bytes, &base_magnitude))) return false;
+  uint64_t sign_mask = 1ULL << (base_bytes * 8 - 1);
+  int64_t base = static_cast<int64_t>(base_magnitude & ~sign_mask);
+  if ((base_magnitude & sign_mask) != 0) base = -base;
+
+  if (UNLIKELY(!UnpackBits(bit_width, num_literals_, literals_))) return false;
+
+  // Each patch holds the gap to the position of the previous patch and the bits of the
+  // value above 'bit_width'. Gaps of more than 255 are split into entries with a gap of
+  // 255 and a patch of 0.
+  int64_t patches[OrcRleV2Decoder::MAX_RUN_LENGTH];
+  if (num_patches > 0
+      && UNLIKELY(!UnpackBits(ClosestFixedBits(patch_width + patch_gap_width),
+          num_patches, patches))) {
+    return false;
+  }
+  uint64_t patch_mask = patch_width == 64 ? ~0ULL : (1ULL << patch_width) - 1;
+  int64_t position = 0;
+  for (int i = 0; i < num_patches; ++i) {
+    uint64_t entry = static_cast<uint64_t>(patches[i]);
+    uint64_t patch = entry & patch_mask;
+    position += patch_width == 64 ? 0 : static_cast<int64_t>(entry >> patch_width);
+    if (patch == 0) continue;
+    if (UNLIKELY(position >= num_literals_)) return false;
+    literals_[position] = static_cast<int64_t>(
+        static_cast<uint64_t>(literals_[position]) | (patch << bit_width));
+  }
+  for (int i = 0; i < num_literals_; ++i) {
+    literals_[i] = static_cast<int64_t>(
+        static_cast<uint64_t>(base) + static_cast<uint64_t>(literals_[i]));
+  }
+  return true;
+}
+
+bool OrcRleV2Decoder::DecodeDelta(uint8_t first_byte) {
+  int width_code = (first_byte >> 1) & 0x1f;
+  // Width code 0 stands for a fixed delta rather than for a width of 1 bit.
+  int bit_width = width_code == 0 ? 0 : DecodeBitWidth(width_code);
+  if (UNLIKELY(data_ == data_end_)) return false;
+  num_literals_ = (((first_byte & 0x01) << 8) | *data_++) + 1;
+
+  uint64_t first_value;
+  uint64_t delta_base;
+  if (UNLIKELY(!ReadVarint(&first_value) || !ReadVarint(&delta_base))) return false;
+  // Unsigned arithmetic, so that overflows wrap around like in the writer.
+  uint64_t value = is_signed_ ? ZigzagDecode(first_value) : first_value;
+  int64_t delta = ZigzagDecode(delta_base);
+  literals_[0] = static_cast<int64_t>(value);
+  if (bit_width == 0) {
+    for (int i = 1; i < num_literals_; ++i) {
+      value += static_cast<uint64_t>(delta);
+      literals_[i] = static_cast<int64_t>(value);
+    }
+    return true;
+  }
+  if (num_literals_ == 1) return true;
+  // The second value is given by the delta base, whose sign is the direction of the
+  // bit-packed deltas of the remaining values.
+  value += static_cast<uint64_t>(delta);
+  literals_[1] = static_cast<int64_t>(value);
+  if (num_literals_ == 2) return true;
+  int64_t* deltas = literals_ + 2;
+  if (UNLIKELY(!UnpackBits(bit_width, num_literals_ - 2, deltas))) return false;
+  for (int i = 0; i < num_literals_ - 2; ++i) {
+    if (delta < 0) {
+      value -= static_cast<uint64_t>(deltas[i]);
+    } else {
+      value += static_cast<uint64_t>(deltas[i]);
+    }
+    deltas[i] = static_cast<int64_t>(value);
+  }
+  return true;
+}
@@ -0,0 +1,151 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "common/compiler-util.h"
+
+namespace impala {
+
+/// Decoder for the byte run length encoding of ORC, which is used for streams of bytes
+/// and, with OrcBoolRleDecoder, of booleans such as the PRESENT streams. The stream is
+/// a sequence of runs that start with a control byte 'c'. If 'c' is at most 127, the
+/// run repeats the next byte c + 3 times. Otherwise -c (as a signed byte) literal bytes
+/// follow.
+class OrcByteRleDecoder {
+ public:
+  /// Starts decoding the stream [data, data + len).
+  void Reset(const uint8_t* data, int64_t len);
+
+  /// Decodes the next 'num_values' bytes into 'values'. Returns false if the stream is
+  /// corrupt or has fewer values.
+  bool GetValues(int64_t num_values, uint8_t* values);
+
+ private:
+  const uint8_t* data_ = nullptr;
+  const uint8_t* data_end_ = nullptr;
+
+  /// Number of values left in the current run.
+  int64_t run_remaining_ = 0;
+
+  /// True if the current run is a repeated run of 'repeated_value_'.
+  bool run_is_repeated_ = false;
+  uint8_t repeated_value_ = 0;
+};
+
+/// Decoder for the boolean streams of ORC: the booleans are packed into bytes, most
+/// significant bit first, which are encoded with the byte run length encoding.
+class OrcBoolRleDecoder {
+ public:
+  /// Starts decoding the stream [data, data + len).
+  void Reset(const uint8_t* data, int64_t len);
+
+  /// Decodes the next 'num_values' booleans into 'values' as 0 or 1. Returns false if the
+  /// stream is corrupt or has fewer values.
+  bool GetValues(int64_t num_values, uint8_t* values);
+
+ private:
+  OrcByteRleDecoder byte_decoder_;
+
+  /// The byte that the next booleans are taken from and the number of them left in it.
+  uint8_t current_byte_ = 0;
+  int bits_left_ = 0;
+};
+
+/// Decoder for version 2 of the integer run length encoding of ORC (RLEv2), which is
+/// used for the integer columns and for the lengths and dictionary indices of the string
+/// columns with the DIRECT_V2 and DICTIONARY_V2 encodings. The stream is a sequence of
+/// runs of at most MAX_RUN_LENGTH values, each in one of four sub-encodings:
+///  - SHORT_REPEAT: a value repeated 3 to 10 times.
+///  - DIRECT: values bit-packed with a fixed width.
+///  - PATCHED_BASE: values bit-packed relative to a base value, with a list of patches
+///    for the outliers that do not fit into the width.
+///  - DELTA: a base value followed by a fixed delta or by bit-packed deltas.
+/// Signed values are zigzag-encoded except in PATCHED_BASE runs, whose base value is
+/// stored in sign-magnitude form. Bits are packed most significant bit first.
+///
+/// The runs are decoded into a buffer of int64_t values one at a time, from which
+/// GetValues() copies them into the output.
+class OrcRleV2Decoder {
+ public:
+  static const int MAX_RUN_LENGTH = 512;
+
+  explicit OrcRleV2Decoder(bool is_signed) : is_signed_(is_signed) {}
+
+  /// Starts decoding the stream [data, data + len).
+  void Reset(const uint8_t* data, int64_t len);
+
+  /// Decodes the next 'num_values' values into 'values', converting them to T. Returns
+  /// false if the stream is corrupt or has fewer values.
+  template <typename T>
+  bool GetValues(int64_t num_values, T* values) {
+    while (num_values > 0) {
+      if (literal_idx_ == num_literals_) {
+        if (UNLIKELY(!DecodeRun())) return false;
+      }
+      int64_t n = std::min<int64_t>(num_values, num_literals_ - literal_idx_);
+      const int64_t* literals = literals_ + literal_idx_;
+      for (int64_t i = 0; i < n; ++i) values[i] = static_cast<T>(literals[i]);
+      literal_idx_ += n;
+      values += n;
+      num_values -= n;
+    }
+    return true;
+  }
+
+ private:
+  /// Decodes the next run into 'literals_'. Returns false if the stream is corrupt or
+  /// at its end.
+  bool DecodeRun();
+  bool DecodeShortRepeat(uint8_t first_byte);
+  bool DecodeDirect(uint8_t first_byte);
+  bool DecodePatchedBase(uint8_t first_byte);
+  bool DecodeDelta(uint8_t first_byte);
+
+  /// Unpacks 'num_values' values of 'bit_width' bits into 'values'. The packed values
+  /// are padded to a whole number of bytes.
+  bool UnpackBits(int bit_width, int num_values, int64_t* values);
+
+  /// Reads a base 128 varint, or a big-endian integer of 'num_bytes' bytes.
+  bool ReadVarint(uint64_t* value);
+  bool ReadBigEndian(int num_bytes, uint64_t* value);
+
+  /// Returns the bit width of the 5 bit code in the header of a run.
+  static int DecodeBitWidth(int code);
+
+  /// Returns the smallest bit width that can be encoded in the header of a run and is at
+  /// least 'bit_width'.
+  static int ClosestFixedBits(int bit_width);
+
+  static int64_t ZigzagDecode(uint64_t value) {
+    return static_cast<int64_t>((value >> 1) ^ -(value & 1));
+  }
+
+  const bool is_signed_;
+  const uint8_t* data_ = nullptr;
+  const uint8_t* data_end_ = nullptr;
+
+  /// The values of the current run, of which 'literal_idx_' were returned.
+  int64_t literals_[MAX_RUN_LENGTH];
+  int num_literals_ = 0;
+  int literal_idx_ = 0;
+};
+
+}
@@ -85,6 +85,15 @@ struct OutputPartition {
 
   /// The block size decided on for this file.
   int64_t block_size = 0;
+
+  /// True if HdfsTableSink finalized the current file and closed the writer before the
+  /// end of an unclustered insert to bound the number of open writers. The next rows of
+  /// the partition are written to a new file with a new writer.
+  bool writer_closed = false;
+
+  /// Sequence number of the last write of rows to this partition, used by
+  /// HdfsTableSink to find the least recently written partitions.
+  int64_t last_write_seq = 0;
 };
 
 }
@@ -492,6 +492,10 @@ class HdfsParquetScanner : public HdfsColumnarScanner {
   /// Number of row groups skipped due to dictionary filter
   RuntimeProfile::Counter* num_dict_filtered_row_groups_counter_;
 
+  /// Number of column chunks whose data pages were decompressed in a separate thread
+  /// while their values were decoded.
+  RuntimeProfile::Counter* num_pipelined_column_chunks_counter_;
+
   /// Tracks the size of any compressed pages read. If no compressed pages are read, this
   /// counter is empty
   RuntimeProfile::SummaryStatsCounter* parquet_compressed_page_size_counter_;
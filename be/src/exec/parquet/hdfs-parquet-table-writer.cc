@@ -28,11 +28,13 @@
 #include "rpc/thrift-util.h"
 #include "runtime/date-value.h"
 #include "runtime/decimal-value.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/string-value.inline.h"
+#include "runtime/thread-resource-mgr.h"
 #include "util/bit-stream-utils.h"
 #include "util/bit-util.h"
 #include "util/buffer-builder.h"
@@ -43,6 +45,7 @@
 #include "util/pretty-printer.h"
 #include "util/rle-encoding.h"
 #include "util/string-util.h"
+#include "util/thread.h"
 
 #include <sstream>
 
@@ -93,6 +96,11 @@ DEFINE_bool_hidden(write_new_parquet_dictionary_encodings, false,
     "(Experimental) Write parquet files with PLAIN/RLE_DICTIONARY encoding instead of "
     "PLAIN_DICTIONARY as recommended by Parquet 2.0 standard");
 
+DEFINE_int32(parquet_writer_encoding_threads, 0, "(Advanced) Maximum number of "
+    "additional threads that each Parquet table writer uses to encode and compress its "
+    "columns in parallel. The threads are only started if the fragment's thread "
+    "resource pool has spare thread tokens for them. 0 disables parallel encoding.");
+
 namespace impala {
 
 // Returns the parquet::Encoding enum value to use for plain-encoded dictionary pages.
@@ -130,7 +138,11 @@ class HdfsParquetTableWriter::BaseColumnWriter {
       page_stats_base_(nullptr),
       row_group_stats_base_(nullptr),
       table_sink_mem_tracker_(parent_->parent_->mem_tracker()),
-      column_name_(std::move(column_name)) {
+      column_name_(std::move(column_name)),
+      per_file_mem_pool_(parent_->per_file_mem_pool_.get()),
+      reusable_col_mem_pool_(parent_->reusable_col_mem_pool_.get()),
+      compression_staging_buffer_(&parent_->compression_staging_buffer_),
+      thrift_serializer_(parent_->thrift_serializer_.get()) {
     static_assert(std::is_same<decltype(parent_->parent_), HdfsTableSink*>::value,
         "'table_sink_mem_tracker_' must point to the mem tracker of an HdfsTableSink");
     def_levels_ = parent_->state_->obj_pool()->Add(
@@ -141,6 +153,20 @@ class HdfsParquetTableWriter::BaseColumnWriter {
 
   virtual ~BaseColumnWriter() {}
 
+  // Gives this column writer its own memory pools, compression staging buffer and
+  // thrift serializer, so that it can append rows concurrently with the other columns.
+  // The sizes of the encoded data are then collected in 'pending_file_size_' instead of
+  // being added to the writer's file size estimate. Must be called before Init().
+  void EnableParallelEncoding() {
+    own_per_file_mem_pool_.reset(new MemPool(table_sink_mem_tracker_));
+    own_reusable_col_mem_pool_.reset(new MemPool(table_sink_mem_tracker_));
+    own_thrift_serializer_.reset(new ThriftSerializer(true));
+    per_file_mem_pool_ = own_per_file_mem_pool_.get();
+    reusable_col_mem_pool_ = own_reusable_col_mem_pool_.get();
+    compression_staging_buffer_ = &own_compression_staging_buffer_;
+    thrift_serializer_ = own_thrift_serializer_.get();
+  }
+
   // Called after the constructor to initialize the column writer.
   Status Init() WARN_UNUSED_RESULT {
     Reset();
@@ -156,6 +182,32 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // would also solve this problem.
   Status AppendRow(TupleRow* row) WARN_UNUSED_RESULT;
 
+  // Appends the rows [start_row, end_row) of 'batch', or the rows with these indices in
+  // 'row_group_indices' if it is not empty.
+  Status AppendRows(RowBatch* batch, const vector<int32_t>& row_group_indices,
+      int start_row, int end_row) WARN_UNUSED_RESULT {
+    for (int i = start_row; i < end_row; ++i) {
+      RETURN_IF_ERROR(AppendRow(row_group_indices.empty() ?
+          batch->GetRow(i) : batch->GetRow(row_group_indices[i])));
+    }
+    return Status::OK();
+  }
+
+  // Returns the size of the data that was encoded since the last call if the column
+  // writer has its own memory pools, see EnableParallelEncoding(), or 0 otherwise.
+  int64_t TakePendingFileSize() {
+    int64_t pending_file_size = pending_file_size_;
+    pending_file_size_ = 0;
+    return pending_file_size;
+  }
+
+  // Called when the writer starts a new file. Frees the memory of the column writer's
+  // own per-file pool, if it has one, and drops the pending size of the last file.
+  void InitNewFile() {
+    if (own_per_file_mem_pool_ != nullptr) own_per_file_mem_pool_->Clear();
+    pending_file_size_ = 0;
+  }
+
   // Flushes all buffered data pages to the file.
   // *file_pos is an output parameter and will be incremented by
   // the number of bytes needed to write all the data pages for this column.
@@ -218,10 +270,14 @@ class HdfsParquetTableWriter::BaseColumnWriter {
     // We must release the memory consumption of this column writer.
     table_sink_mem_tracker_->Release(page_index_memory_consumption_);
     page_index_memory_consumption_ = 0;
+    if (own_per_file_mem_pool_ != nullptr) own_per_file_mem_pool_->FreeAll();
+    if (own_reusable_col_mem_pool_ != nullptr) own_reusable_col_mem_pool_->FreeAll();
+    own_compression_staging_buffer_.clear();
   }
 
   const ColumnType& type() const { return expr_eval_->root().type(); }
   uint64_t num_values() const { return num_values_; }
+  int64_t max_value_size() const { return max_value_size_; }
   uint64_t total_compressed_size() const { return total_compressed_byte_size_; }
   uint64_t total_uncompressed_size() const { return total_uncompressed_byte_size_; }
   parquet::CompressionCodec::type GetParquetCodec() const {
@@ -238,6 +294,15 @@ class HdfsParquetTableWriter::BaseColumnWriter {
     return def_levels_->buffer_full() || num_values >= parent_->page_row_count_limit();
   }
 
+  // Adds 'bytes' of encoded data to the file size estimate.
+  void AddToFileSizeEstimate(int64_t bytes) {
+    if (own_per_file_mem_pool_ != nullptr) {
+      pending_file_size_ += bytes;
+    } else {
+      parent_->file_size_estimate_ += bytes;
+    }
+  }
+
   Status AddMemoryConsumptionForPageIndex(int64_t new_memory_allocation) {
     if (UNLIKELY(!table_sink_mem_tracker_->TryConsume(new_memory_allocation))) {
       return table_sink_mem_tracker_->MemLimitExceeded(parent_->state_,
@@ -419,6 +484,27 @@ class HdfsParquetTableWriter::BaseColumnWriter {
 
   // Column name in the HdfsTableDescriptor.
   const string column_name_;
+
+  // The memory pools, compression staging buffer and thrift serializer that are used
+  // while appending rows. These are the ones of the table writer unless
+  // EnableParallelEncoding() was called, which sets them to the 'own_*' members.
+  MemPool* per_file_mem_pool_;
+  MemPool* reusable_col_mem_pool_;
+  vector<uint8_t>* compression_staging_buffer_;
+  ThriftSerializer* thrift_serializer_;
+
+  scoped_ptr<MemPool> own_per_file_mem_pool_;
+  scoped_ptr<MemPool> own_reusable_col_mem_pool_;
+  vector<uint8_t> own_compression_staging_buffer_;
+  scoped_ptr<ThriftSerializer> own_thrift_serializer_;
+
+  // Size of the encoded data that was not added to the file size estimate yet. Only
+  // used if EnableParallelEncoding() was called.
+  int64_t pending_file_size_ = 0;
+
+  // Largest number of bytes that a single value of this column added to the page or
+  // dictionary it was encoded into, or -1 if no row was appended yet.
+  int64_t max_value_size_ = -1;
 };
 
 // Per type column writer.
@@ -442,14 +528,14 @@ class HdfsParquetTableWriter::ColumnWriter :
     // it will fall back to plain.
     current_encoding_ = DataPageDictionaryEncoding();
     next_page_encoding_ = DataPageDictionaryEncoding();
-    dict_encoder_.reset(new DictEncoder<T>(parent_->per_file_mem_pool_.get(),
+    dict_encoder_.reset(new DictEncoder<T>(per_file_mem_pool_,
         plain_encoded_value_size_, parent_->parent_->mem_tracker()));
     dict_encoder_base_ = dict_encoder_.get();
     page_stats_.reset(
-        new ColumnStats<T>(parent_->per_file_mem_pool_.get(), plain_encoded_value_size_));
+        new ColumnStats<T>(per_file_mem_pool_, plain_encoded_value_size_));
     page_stats_base_ = page_stats_.get();
     row_group_stats_.reset(
-        new ColumnStats<T>(parent_->per_file_mem_pool_.get(), plain_encoded_value_size_));
+        new ColumnStats<T>(per_file_mem_pool_, plain_encoded_value_size_));
     row_group_stats_base_ = row_group_stats_.get();
   }
 
@@ -470,7 +556,7 @@ class HdfsParquetTableWriter::ColumnWriter :
         next_page_encoding_ = parquet::Encoding::PLAIN;
         return false;
       }
-      parent_->file_size_estimate_ += *bytes_needed;
+      AddToFileSizeEstimate(*bytes_needed);
     } else if (current_encoding_ == parquet::Encoding::PLAIN) {
       *bytes_needed = plain_encoded_value_size_ < 0 ?
           ParquetPlainEncoder::ByteSize<T>(*val) :
@@ -701,7 +787,9 @@ inline Status HdfsParquetTableWriter::BaseColumnWriter::AppendRow(TupleRow* row)
     }
 
     int64_t bytes_needed = 0;
-    if (ProcessValue(value, &bytes_needed)) {
+    bool appended = ProcessValue(value, &bytes_needed);
+    max_value_size_ = max(max_value_size_, bytes_needed);
+    if (appended) {
       ++current_page_->num_non_null;
       break; // Succesfully appended, don't need to retry.
     }
@@ -722,7 +810,7 @@ inline Status HdfsParquetTableWriter::BaseColumnWriter::AppendRow(TupleRow* row)
       }
       page_size_ = bytes_needed;
       values_buffer_len_ = page_size_;
-      values_buffer_ = parent_->reusable_col_mem_pool_->Allocate(values_buffer_len_);
+      values_buffer_ = reusable_col_mem_pool_->Allocate(values_buffer_len_);
     }
     NewPage();
   }
@@ -746,7 +834,7 @@ inline void HdfsParquetTableWriter::BaseColumnWriter::WriteDictDataPage() {
     // len < 0 indicates the data doesn't fit into a data page. Allocate a larger data
     // page.
     values_buffer_len_ *= 2;
-    values_buffer_ = parent_->reusable_col_mem_pool_->Allocate(values_buffer_len_);
+    values_buffer_ = reusable_col_mem_pool_->Allocate(values_buffer_len_);
     len = dict_encoder_base_->WriteData(values_buffer_, values_buffer_len_);
   }
   dict_encoder_base_->ClearIndices();
@@ -781,11 +869,11 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
 
     // Write the dictionary page data, compressing it if necessary.
     uint8_t* dict_buffer =
-        parent_->per_file_mem_pool_->TryAllocate(header.uncompressed_page_size);
+        per_file_mem_pool_->TryAllocate(header.uncompressed_page_size);
     if (UNLIKELY(dict_buffer == nullptr)) {
       string details = (Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "BaseColumnWriter::Flush",
           header.uncompressed_page_size, "dictionary page"));
-      return parent_->per_file_mem_pool_->mem_tracker()->MemLimitExceeded(
+      return per_file_mem_pool_->mem_tracker()->MemLimitExceeded(
           parent_->state_, details, header.uncompressed_page_size);
     }
     dict_encoder_base_->WriteDict(dict_buffer);
@@ -795,12 +883,12 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
           compressor_->MaxOutputLen(header.uncompressed_page_size);
       DCHECK_GT(max_compressed_size, 0);
       uint8_t* compressed_data =
-          parent_->per_file_mem_pool_->TryAllocate(max_compressed_size);
+          per_file_mem_pool_->TryAllocate(max_compressed_size);
       if (UNLIKELY(compressed_data == nullptr)) {
         string details =
             (Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "BaseColumnWriter::Flush",
                 max_compressed_size, "compressed dictionary page"));
-        return parent_->per_file_mem_pool_->mem_tracker()->MemLimitExceeded(
+        return per_file_mem_pool_->mem_tracker()->MemLimitExceeded(
             parent_->state_, details, max_compressed_size);
       }
       header.compressed_page_size = max_compressed_size;
@@ -814,7 +902,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
       dict_buffer = compressed_data;
       // We allocated the output based on the guessed size, return the extra allocated
       // bytes back to the mem pool.
-      parent_->per_file_mem_pool_->ReturnPartialAllocation(
+      per_file_mem_pool_->ReturnPartialAllocation(
           max_compressed_size - header.compressed_page_size);
     } else {
       header.compressed_page_size = header.uncompressed_page_size;
@@ -822,7 +910,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
 
     uint8_t* header_buffer;
     uint32_t header_len;
-    RETURN_IF_ERROR(parent_->thrift_serializer_->SerializeToBuffer(
+    RETURN_IF_ERROR(thrift_serializer_->SerializeToBuffer(
         &header, &header_len, &header_buffer));
     RETURN_IF_ERROR(parent_->Write(header_buffer, header_len));
     *file_pos += header_len;
@@ -859,7 +947,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
     uint8_t* buffer = nullptr;
     uint32_t len = 0;
     RETURN_IF_ERROR(
-        parent_->thrift_serializer_->SerializeToBuffer(&page.header, &len, &buffer));
+        thrift_serializer_->SerializeToBuffer(&page.header, &len, &buffer));
     RETURN_IF_ERROR(parent_->Write(buffer, len));
     *file_pos += len;
 
@@ -904,13 +992,11 @@ Status HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   // At this point we know all the data for the data page.  Combine them into one buffer.
   uint8_t* uncompressed_data = nullptr;
   if (compressor_.get() == nullptr) {
-    uncompressed_data =
-        parent_->per_file_mem_pool_->Allocate(header.uncompressed_page_size);
+    uncompressed_data = per_file_mem_pool_->Allocate(header.uncompressed_page_size);
   } else {
     // We have compression.  Combine into the staging buffer.
-    parent_->compression_staging_buffer_.resize(
-        header.uncompressed_page_size);
-    uncompressed_data = &parent_->compression_staging_buffer_[0];
+    compression_staging_buffer_->resize(header.uncompressed_page_size);
+    uncompressed_data = compression_staging_buffer_->data();
   }
 
   BufferBuilder buffer(uncompressed_data, header.uncompressed_page_size);
@@ -932,7 +1018,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
     int64_t max_compressed_size =
         compressor_->MaxOutputLen(header.uncompressed_page_size);
     DCHECK_GT(max_compressed_size, 0);
-    uint8_t* compressed_data = parent_->per_file_mem_pool_->Allocate(max_compressed_size);
+    uint8_t* compressed_data = per_file_mem_pool_->Allocate(max_compressed_size);
     header.compressed_page_size = max_compressed_size;
     const Status& status =
         compressor_->ProcessBlock32(true, header.uncompressed_page_size,
@@ -945,7 +1031,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
 
     // We allocated the output based on the guessed size, return the extra allocated
     // bytes back to the mem pool.
-    parent_->per_file_mem_pool_->ReturnPartialAllocation(
+    per_file_mem_pool_->ReturnPartialAllocation(
         max_compressed_size - header.compressed_page_size);
   }
 
@@ -960,13 +1046,13 @@ Status HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   // Add the size of the data page header
   uint8_t* header_buffer;
   uint32_t header_len = 0;
-  RETURN_IF_ERROR(parent_->thrift_serializer_->SerializeToBuffer(
+  RETURN_IF_ERROR(thrift_serializer_->SerializeToBuffer(
       &current_page_->header, &header_len, &header_buffer));
 
   current_page_->finalized = true;
   total_compressed_byte_size_ += header_len + header.compressed_page_size;
   total_uncompressed_byte_size_ += header_len + header.uncompressed_page_size;
-  parent_->file_size_estimate_ += header_len + header.compressed_page_size;
+  AddToFileSizeEstimate(header_len + header.compressed_page_size);
   def_levels_->Clear();
   return Status::OK();
 }
@@ -1088,59 +1174,52 @@ Status HdfsParquetTableWriter::Init() {
   ConfigureStringType();
 
   columns_.resize(num_cols);
+  RETURN_IF_ERROR(StartEncodingThreads());
   // Initialize each column structure.
   for (int i = 0; i < columns_.size(); ++i) {
     BaseColumnWriter* writer = nullptr;
-    const ColumnType& type = output_expr_evals_[i]->root().type();
+    ScalarExprEvaluator* eval =
+        encoding_threads_.empty() ? output_expr_evals_[i] : encoding_expr_evals_[i];
+    const ColumnType& type = eval->root().type();
     const int num_clustering_cols = table_desc_->num_clustering_cols();
     const string& col_name = table_desc_->col_descs()[i + num_clustering_cols].name();
     switch (type.type) {
       case TYPE_BOOLEAN:
-        writer =
-          new BoolColumnWriter(this, output_expr_evals_[i], codec_info, col_name);
+        writer = new BoolColumnWriter(this, eval, codec_info, col_name);
         break;
       case TYPE_TINYINT:
-        writer =
-          new ColumnWriter<int8_t>(this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<int8_t>(this, eval, codec_info, col_name);
         break;
       case TYPE_SMALLINT:
-        writer =
-          new ColumnWriter<int16_t>(this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<int16_t>(this, eval, codec_info, col_name);
         break;
       case TYPE_INT:
-        writer =
-          new ColumnWriter<int32_t>(this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<int32_t>(this, eval, codec_info, col_name);
         break;
       case TYPE_BIGINT:
-        writer =
-          new ColumnWriter<int64_t>(this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<int64_t>(this, eval, codec_info, col_name);
         break;
       case TYPE_FLOAT:
-        writer =
-          new ColumnWriter<float>(this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<float>(this, eval, codec_info, col_name);
         break;
       case TYPE_DOUBLE:
-        writer =
-          new ColumnWriter<double>(this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<double>(this, eval, codec_info, col_name);
         break;
       case TYPE_TIMESTAMP:
         switch (timestamp_type_) {
           case TParquetTimestampType::INT96_NANOS:
-            writer =
-                new ColumnWriter<TimestampValue>(
-                    this, output_expr_evals_[i], codec_info, col_name);
+            writer = new ColumnWriter<TimestampValue>(this, eval, codec_info, col_name);
             break;
           case TParquetTimestampType::INT64_MILLIS:
             writer = new Int64MilliTimestampColumnWriter(
-                this, output_expr_evals_[i], codec_info, col_name);
+                this, eval, codec_info, col_name);
             break;
           case TParquetTimestampType::INT64_MICROS:
             writer = new Int64MicroTimestampColumnWriter(
-                this, output_expr_evals_[i], codec_info, col_name);
+                this, eval, codec_info, col_name);
             break;
           case TParquetTimestampType::INT64_NANOS:
-            writer = new Int64NanoTimestampColumnWriter(
-                this, output_expr_evals_[i], codec_info, col_name);
+            writer = new Int64NanoTimestampColumnWriter(this, eval, codec_info, col_name);
             break;
           default:
             DCHECK(false);
@@ -1149,38 +1228,31 @@ Status HdfsParquetTableWriter::Init() {
       case TYPE_VARCHAR:
       case TYPE_STRING:
       case TYPE_CHAR:
-        writer = new ColumnWriter<StringValue>(
-            this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<StringValue>(this, eval, codec_info, col_name);
         break;
       case TYPE_DECIMAL:
-        switch (output_expr_evals_[i]->root().type().GetByteSize()) {
+        switch (eval->root().type().GetByteSize()) {
           case 4:
-            writer =
-                new ColumnWriter<Decimal4Value>(
-                    this, output_expr_evals_[i], codec_info, col_name);
+            writer = new ColumnWriter<Decimal4Value>(this, eval, codec_info, col_name);
             break;
           case 8:
-            writer =
-                new ColumnWriter<Decimal8Value>(
-                    this, output_expr_evals_[i], codec_info, col_name);
+            writer = new ColumnWriter<Decimal8Value>(this, eval, codec_info, col_name);
             break;
           case 16:
-            writer =
-                new ColumnWriter<Decimal16Value>(
-                    this, output_expr_evals_[i], codec_info, col_name);
+            writer = new ColumnWriter<Decimal16Value>(this, eval, codec_info, col_name);
             break;
           default:
             DCHECK(false);
         }
         break;
       case TYPE_DATE:
-        writer = new ColumnWriter<DateValue>(
-            this, output_expr_evals_[i], codec_info, col_name);
+        writer = new ColumnWriter<DateValue>(this, eval, codec_info, col_name);
         break;
       default:
         DCHECK(false);
     }
     columns_[i].reset(writer);
+    if (!encoding_threads_.empty()) columns_[i]->EnableParallelEncoding();
     RETURN_IF_ERROR(columns_[i]->Init());
   }
   RETURN_IF_ERROR(CreateSchema());
@@ -1254,6 +1326,7 @@ Status HdfsParquetTableWriter::InitNewFile() {
   DCHECK(current_row_group_ == nullptr);
 
   per_file_mem_pool_->Clear();
+  for (unique_ptr<BaseColumnWriter>& column : columns_) column->InitNewFile();
 
   // Get the file limit
   file_size_limit_ = output_->block_size;
@@ -1275,7 +1348,9 @@ Status HdfsParquetTableWriter::InitNewFile() {
   // pages, means we stop 800KB shy of the limit.
   // Data pages calculate their size precisely when they are complete so having
   // a two page buffer guarantees we will never go over (unless there are huge values
-  // that require increasing the page size).
+  // that require increasing the page size). With parallel encoding, the limit is only
+  // checked between rounds, so rounds are sized to fit into the space left below the
+  // limit, see ParallelEncodingRoundRows().
   // TODO: this should be made dynamic based on the size of rows seen so far.
   // This would for example, let us account for very long string columns.
   const int64_t num_cols = columns_.size();
@@ -1311,6 +1386,28 @@ Status HdfsParquetTableWriter::AppendRows(
     limit = row_group_indices.size();
   }
 
+  if (!encoding_threads_.empty()) {
+    // The expression results of the previous batch are no longer referenced.
+    if (row_idx_ == 0) {
+      for (unique_ptr<MemPool>& pool : encoding_expr_results_pools_) pool->Clear();
+    }
+    while (row_idx_ < limit) {
+      int end_row = min(row_idx_ + ParallelEncodingRoundRows(), limit);
+      RETURN_IF_ERROR(AppendRowsInParallel(batch, row_group_indices, row_idx_, end_row));
+      row_count_ += end_row - row_idx_;
+      output_->num_rows += end_row - row_idx_;
+      row_idx_ = end_row;
+      for (unique_ptr<BaseColumnWriter>& column : columns_) {
+        file_size_estimate_ += column->TakePendingFileSize();
+      }
+      if (file_size_estimate_ > file_size_limit_) {
+        // This file is full.  We need a new file.
+        *new_file = true;
+        return Status::OK();
+      }
+    }
+  }
+
   bool all_rows = row_group_indices.empty();
   for (; row_idx_ < limit;) {
     TupleRow* current_row = all_rows ?
@@ -1369,15 +1466,137 @@ void HdfsParquetTableWriter::FinalizePartitionInfo() {
 }
 
 void HdfsParquetTableWriter::Close() {
+  StopEncodingThreads();
   // Release all accumulated memory
   for (int i = 0; i < columns_.size(); ++i) {
     columns_[i]->Close();
   }
+  ScalarExprEvaluator::Close(encoding_expr_evals_, state_);
+  encoding_expr_evals_.clear();
+  for (unique_ptr<MemPool>& pool : encoding_expr_results_pools_) pool->FreeAll();
+  if (encoding_expr_perm_pool_ != nullptr) encoding_expr_perm_pool_->FreeAll();
   reusable_col_mem_pool_->FreeAll();
   per_file_mem_pool_->FreeAll();
   compression_staging_buffer_.clear();
 }
 
+Status HdfsParquetTableWriter::StartEncodingThreads() {
+  DCHECK(encoding_threads_.empty());
+  // No round is started until the first batch.
+  next_round_column_ = columns_.size();
+  num_round_columns_done_ = columns_.size();
+  int num_threads = min(FLAGS_parquet_writer_encoding_threads,
+      static_cast<int>(columns_.size()) - 1);
+  ThreadResourcePool* thread_pool = state_->resource_pool();
+  for (int i = 0; i < num_threads; ++i) {
+    if (!thread_pool->TryAcquireThreadToken()) break;
+    string name = Substitute("parquet-encoder (finst:$0, thread-idx:$1)",
+        PrintId(state_->fragment_instance_id()), i);
+    unique_ptr<Thread> thread;
+    Status status = Thread::Create(FragmentInstanceState::FINST_THREAD_GROUP_NAME,
+        name, [this]() { EncodingThread(); }, &thread, true);
+    if (!status.ok()) {
+      // Encode with the threads that could be started.
+      thread_pool->ReleaseThreadToken(false);
+      break;
+    }
+    encoding_threads_.push_back(move(thread));
+  }
+  if (encoding_threads_.empty()) return Status::OK();
+  VLOG_FILE << "Encoding Parquet columns with " << encoding_threads_.size()
+            << " additional threads";
+
+  // The column writers evaluate their output expressions in different threads, so each
+  // of them needs its own clone that allocates from a pool of its own.
+  encoding_expr_perm_pool_.reset(new MemPool(parent_->mem_tracker()));
+  for (int i = 0; i < columns_.size(); ++i) {
+    encoding_expr_results_pools_.emplace_back(new MemPool(parent_->mem_tracker()));
+    ScalarExprEvaluator* eval;
+    Status status = output_expr_evals_[i]->Clone(state_->obj_pool(), state_,
+        encoding_expr_perm_pool_.get(), encoding_expr_results_pools_.back().get(), &eval);
+    // Always add the evaluator so that it is closed.
+    encoding_expr_evals_.push_back(eval);
+    RETURN_IF_ERROR(status);
+  }
+  round_column_status_.resize(columns_.size());
+  return Status::OK();
+}
+
+void HdfsParquetTableWriter::StopEncodingThreads() {
+  {
+    lock_guard<mutex> l(encoding_lock_);
+    stop_encoding_ = true;
+  }
+  encoding_round_cv_.NotifyAll();
+  for (unique_ptr<Thread>& thread : encoding_threads_) {
+    thread->Join();
+    state_->resource_pool()->ReleaseThreadToken(false);
+  }
+  encoding_threads_.clear();
+}
+
+void HdfsParquetTableWriter::EncodingThread() {
+  unique_lock<mutex> l(encoding_lock_);
+  while (true) {
+    while (!stop_encoding_ && next_round_column_ >= columns_.size()) {
+      encoding_round_cv_.Wait(l);
+    }
+    if (stop_encoding_) return;
+    EncodeColumns(&l);
+  }
+}
+
+int HdfsParquetTableWriter::ParallelEncodingRoundRows() const {
+  // Upper bound of the encoded size of a row, assuming that every column holds its
+  // largest value so far. A byte per column accounts for the definition levels and
+  // the bit-packed booleans. Columns that only held NULLs so far add nothing else.
+  int64_t max_row_size = columns_.size();
+  bool value_size_known = false;
+  for (const unique_ptr<BaseColumnWriter>& column : columns_) {
+    if (column->max_value_size() < 0) continue;
+    max_row_size += column->max_value_size();
+    value_size_known = true;
+  }
+  // Nothing is known about the size of the rows before the first one was encoded.
+  if (!value_size_known && row_count_ == 0) return 1;
+  int64_t space_left = file_size_limit_ - file_size_estimate_;
+  DCHECK_GE(space_left, 0);
+  return max<int64_t>(1, min<int64_t>(PARALLEL_ENCODING_ROUND_ROWS,
+      space_left / max_row_size));
+}
+
+Status HdfsParquetTableWriter::AppendRowsInParallel(RowBatch* batch,
+    const vector<int32_t>& row_group_indices, int start_row, int end_row) {
+  unique_lock<mutex> l(encoding_lock_);
+  DCHECK_EQ(num_round_columns_done_, next_round_column_);
+  round_batch_ = batch;
+  round_row_group_indices_ = &row_group_indices;
+  round_start_row_ = start_row;
+  round_end_row_ = end_row;
+  next_round_column_ = 0;
+  num_round_columns_done_ = 0;
+  encoding_round_cv_.NotifyAll();
+  // The fragment thread takes columns from the round as well.
+  EncodeColumns(&l);
+  while (num_round_columns_done_ < columns_.size()) encoding_done_cv_.Wait(l);
+  for (const Status& status : round_column_status_) RETURN_IF_ERROR(status);
+  return Status::OK();
+}
+
+void HdfsParquetTableWriter::EncodeColumns(unique_lock<mutex>* lock) {
+  DCHECK(lock->owns_lock());
+  while (next_round_column_ < columns_.size()) {
+    int column_idx = next_round_column_++;
+    lock->unlock();
+    // The rows of the round do not change until all columns are done.
+    Status status = columns_[column_idx]->AppendRows(round_batch_,
+        *round_row_group_indices_, round_start_row_, round_end_row_);
+    lock->lock();
+    round_column_status_[column_idx] = status;
+    if (++num_round_columns_done_ == columns_.size()) encoding_done_cv_.NotifyAll();
+  }
+}
+
 Status HdfsParquetTableWriter::WriteFileHeader() {
   DCHECK_EQ(file_pos_, 0);
   RETURN_IF_ERROR(Write(PARQUET_VERSION_NUMBER, sizeof(PARQUET_VERSION_NUMBER)));
@@ -23,12 +23,15 @@
 
 #include <hdfs.h>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <boost/scoped_ptr.hpp>
 
 #include "exec/hdfs-table-writer.h"
 #include "exec/parquet/parquet-common.h"
 #include "runtime/descriptors.h"
 #include "util/compress.h"
+#include "util/condition-variable.h"
 
 #include "gen-cpp/control_service.pb.h"
 
@@ -37,6 +40,7 @@ namespace impala {
 class Expr;
 struct OutputPartition;
 class RuntimeState;
+class Thread;
 class ThriftSerializer;
 class TupleRow;
 
@@ -50,6 +54,20 @@ class TupleRow;
 /// from the FE.  This includes:
 /// - compression & codec
 /// - type of encoding to use for each type
+///
+/// Parallel encoding:
+/// The columns of a file are independent until they are flushed, so the writer can
+/// encode and compress them concurrently. If --parquet_writer_encoding_threads is
+/// positive and the fragment's ThreadResourcePool has spare thread tokens when the
+/// writer is initialized, the writer starts encoding threads for them. Each column
+/// writer then gets its own memory pools, compression staging buffer, thrift serializer
+/// and clone of its output expression, and the rows of a batch are appended in rounds
+/// of up to PARALLEL_ENCODING_ROUND_ROWS rows: the fragment thread and the encoding
+/// threads take columns from the round until all of them have appended its rows.
+/// Since the file size is only checked between rounds, rounds are shortened when the
+/// largest rows seen so far would not fit into the space left in the file. The pages
+/// are still written to the file by the fragment thread, in column order, when the row
+/// group is flushed.
 
 class HdfsParquetTableWriter : public HdfsTableWriter {
  public:
@@ -99,6 +117,10 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   /// Default row group size.  In bytes.
   static const int ROW_GROUP_SIZE = HDFS_BLOCK_SIZE;
 
+  /// Maximum number of rows that are appended to the columns in each round of parallel
+  /// encoding, see ParallelEncodingRoundRows().
+  static const int PARALLEL_ENCODING_ROUND_ROWS = 256;
+
   /// Minimum file size.  If the configured size is less, fail.
   static const int HDFS_MIN_FILE_SIZE = 8 * 1024 * 1024;
 
@@ -166,6 +188,34 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   /// Updates output partition with some summary about the written file.
   void FinalizePartitionInfo();
 
+  /// Starts up to --parquet_writer_encoding_threads encoding threads, as many as thread
+  /// tokens can be acquired for, and clones the output expressions of the columns into
+  /// 'encoding_expr_evals_'. Does nothing if no thread could be started.
+  Status StartEncodingThreads();
+
+  /// Stops the encoding threads, waits for them to exit and releases their tokens.
+  void StopEncodingThreads();
+
+  /// Main function of the encoding threads. Appends the rows of the current round to
+  /// the columns that were not taken by another thread until StopEncodingThreads() is
+  /// called.
+  void EncodingThread();
+
+  /// Returns the number of rows of the next round of parallel encoding. That is at most
+  /// PARALLEL_ENCODING_ROUND_ROWS, and fewer if the rows could not be encoded without
+  /// the file size estimate going over 'file_size_limit_', judging by the largest value
+  /// of each column so far. At least one row.
+  int ParallelEncodingRoundRows() const;
+
+  /// Appends the rows [start_row, end_row) of 'batch' to all of the columns with the
+  /// encoding threads and the calling thread. Returns the first error of a column.
+  Status AppendRowsInParallel(RowBatch* batch,
+      const std::vector<int32_t>& row_group_indices, int start_row, int end_row);
+
+  /// Appends the rows of the current round to the columns that were not taken yet,
+  /// until all columns were taken. 'lock' must hold 'encoding_lock_'.
+  void EncodeColumns(std::unique_lock<std::mutex>* lock);
+
   /// Thrift serializer utility object.  Reusing this object allows for
   /// fewer memory allocations.
   boost::scoped_ptr<ThriftSerializer> thrift_serializer_;
@@ -231,6 +281,42 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
 
   /// If true, STRING values are annotated with UTF8 in Parquet metadata.
   bool string_utf8_ = false;
+
+  /// The encoding threads. Empty if the columns are encoded by the fragment thread.
+  std::vector<std::unique_ptr<Thread>> encoding_threads_;
+
+  /// Clones of the output expressions of the columns that the column writers evaluate
+  /// if there are encoding threads, with a results pool per column. The results pools
+  /// are cleared at the start of each batch.
+  std::vector<ScalarExprEvaluator*> encoding_expr_evals_;
+  boost::scoped_ptr<MemPool> encoding_expr_perm_pool_;
+  std::vector<std::unique_ptr<MemPool>> encoding_expr_results_pools_;
+
+  /// Protects the members below, which describe the current round of parallel encoding.
+  std::mutex encoding_lock_;
+
+  /// Signalled when a round is started or the encoding threads are stopped.
+  ConditionVariable encoding_round_cv_;
+
+  /// Signalled when the last column of a round has appended its rows.
+  ConditionVariable encoding_done_cv_;
+
+  /// The rows of the current round. Only changed while no column is being encoded.
+  RowBatch* round_batch_ = nullptr;
+  const std::vector<int32_t>* round_row_group_indices_ = nullptr;
+  int round_start_row_ = 0;
+  int round_end_row_ = 0;
+
+  /// Index of the next column of the round that is not taken by a thread yet and the
+  /// number of columns that have appended the rows of the round.
+  int next_round_column_ = 0;
+  int num_round_columns_done_ = 0;
+
+  /// The status of appending the rows of the current round to each column.
+  std::vector<Status> round_column_status_;
+
+  /// True once StopEncodingThreads() was called.
+  bool stop_encoding_ = false;
 };
 
 }
@@ -19,13 +19,31 @@
 
 #include <string>
 
+#include <gflags/gflags.h>
+
+#include "exec/hdfs-scan-node-base.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/mem-pool.h"
 #include "runtime/runtime-state.h"
 #include "runtime/scoped-buffer.h"
+#include "runtime/thread-resource-mgr.h"
+#include "util/async-block-decompressor.h"
 #include "util/codec.h"
+#include "util/debug-util.h"
 
 #include "common/names.h"
 
+DEFINE_int32(parquet_decompression_read_ahead_pages, 4, "(Advanced) Number of data "
+    "pages of a GZIP or ZSTD compressed Parquet column chunk that are read ahead and "
+    "decompressed in a separate thread, if a thread token is available, while the "
+    "values of the current pages are decoded. Column chunks with other codecs are "
+    "decompressed fast enough to not gain from it. 0 disables the pipelined "
+    "decompression of Parquet pages.");
+DEFINE_int64_hidden(parquet_pipelined_decompression_min_chunk_size,
+    2L * 1024L * 1024L, "Minimum compressed size of a Parquet column chunk for the "
+    "decompression of its data pages to be pipelined. Smaller column chunks do not take "
+    "long enough to decompress to make up for starting a thread.");
+
 using namespace impala::io;
 
 using parquet::Encoding;
@@ -35,6 +53,10 @@ namespace impala {
 const string PARQUET_PAGE_MEM_LIMIT_EXCEEDED =
     "ParquetColumnChunkReader::$0() failed to allocate $1 bytes for $2.";
 
+// Maximum total uncompressed size of the data pages of a batch that is read ahead. At
+// least one page is read ahead regardless of its size.
+static const int64_t MAX_READ_AHEAD_BATCH_SIZE = 8 * 1024 * 1024;
+
 // In 1.1, we had a bug where the dictionary page metadata was not set. Returns true
 // if this matches those versions and compatibility workarounds need to be used.
 static bool RequiresSkippedDictionaryHeaderCheck(
@@ -54,15 +76,25 @@ ParquetColumnChunkReader::ParquetColumnChunkReader(HdfsParquetScanner* parent,
 {
 }
 
-ParquetColumnChunkReader::~ParquetColumnChunkReader() {}
+ParquetColumnChunkReader::~ParquetColumnChunkReader() {
+  DCHECK(async_decompressor_ == nullptr) << "Must call Close()";
+}
 
 Status ParquetColumnChunkReader::InitColumnChunk(const HdfsFileDesc& file_desc,
     const parquet::ColumnChunk& col_chunk, int row_group_idx,
     std::vector<io::ScanRange::SubRange>&& sub_ranges) {
+  DCHECK(async_decompressor_ == nullptr);
+  codec_ = ConvertParquetToImpalaCodec(col_chunk.meta_data.codec);
   if (col_chunk.meta_data.codec != parquet::CompressionCodec::UNCOMPRESSED) {
-    RETURN_IF_ERROR(Codec::CreateDecompressor(nullptr, false,
-        ConvertParquetToImpalaCodec(col_chunk.meta_data.codec), &decompressor_));
+    RETURN_IF_ERROR(Codec::CreateDecompressor(nullptr, false, codec_, &decompressor_));
   }
+  // Snappy and LZ4 pages decompress so fast that handing them to another thread costs
+  // about as much as it saves, see parquet-decompression-benchmark.cc.
+  try_pipelined_decompression_ = decompressor_ != nullptr
+      && (codec_ == THdfsCompression::GZIP || codec_ == THdfsCompression::ZSTD)
+      && FLAGS_parquet_decompression_read_ahead_pages > 0
+      && col_chunk.meta_data.total_compressed_size
+          >= FLAGS_parquet_pipelined_decompression_min_chunk_size;
 
   RETURN_IF_ERROR(page_reader_.InitColumnChunk(file_desc, col_chunk,
         row_group_idx, move(sub_ranges)));
@@ -71,6 +103,8 @@ Status ParquetColumnChunkReader::InitColumnChunk(const HdfsFileDesc& file_desc,
 }
 
 void ParquetColumnChunkReader::Close(MemPool* mem_pool) {
+  StopPipelinedDecompression();
+  try_pipelined_decompression_ = false;
   if (mem_pool != nullptr && value_mem_type_ == ValueMemoryType::VAR_LEN_STR) {
     mem_pool->AcquireData(data_page_pool_.get(), false);
   } else {
@@ -209,6 +243,14 @@ Status ParquetColumnChunkReader::ReadNextDataPage(bool* eos, uint8_t** data,
   // be called after we know that the first page is not a dictionary page. Therefore, if
   // we find a dictionary page, it is an error in the parquet file and we return a non-ok
   // status (returned by page_reader_.ReadPageHeader()).
+  if (try_pipelined_decompression_) {
+    try_pipelined_decompression_ = false;
+    RETURN_IF_ERROR(StartPipelinedDecompression());
+  }
+  if (async_decompressor_ != nullptr) {
+    return ReadNextPipelinedDataPage(eos, data, data_size);
+  }
+
   bool next_data_page_found = false;
   while (!next_data_page_found) {
     RETURN_IF_ERROR(page_reader_.ReadPageHeader(eos));
@@ -308,4 +350,153 @@ Status ParquetColumnChunkReader::AllocateUncompressedDataPage(int64_t size,
   return Status::OK();
 }
 
+Status ParquetColumnChunkReader::StartPipelinedDecompression() {
+  DCHECK(async_decompressor_ == nullptr);
+  RuntimeState* state = parent_->state_;
+  if (!state->resource_pool()->TryAcquireThreadToken()) return Status::OK();
+  async_decompressor_.reset(
+      new AsyncBlockDecompressor(parent_->scan_node_->mem_tracker(), codec_));
+  string thread_name = Substitute("parquet-decompression (finst:$0, plan-node-id:$1, "
+      "column:$2)", PrintId(state->fragment_instance_id()), parent_->scan_node_->id(),
+      schema_name_);
+  Status status = async_decompressor_->Open(
+      FragmentInstanceState::FINST_THREAD_GROUP_NAME, thread_name);
+  if (!status.ok()) {
+    StopPipelinedDecompression();
+    return status;
+  }
+  COUNTER_ADD(parent_->num_pipelined_column_chunks_counter_, 1);
+  return Status::OK();
+}
+
+void ParquetColumnChunkReader::StopPipelinedDecompression() {
+  if (async_decompressor_ == nullptr) return;
+  // Waits for the batch in progress, if any, so the pages below are not written anymore.
+  async_decompressor_->Close();
+  async_decompressor_.reset();
+  parent_->state_->resource_pool()->ReleaseThreadToken(false);
+  for (ReadAheadPage& page : read_ahead_pages_) page.pool->FreeAll();
+  read_ahead_pages_.clear();
+  for (ReadAheadPage& page : decompressed_pages_) page.pool->FreeAll();
+  decompressed_pages_.clear();
+  read_ahead_status_ = Status::OK();
+  read_ahead_eos_ = false;
+}
+
+Status ParquetColumnChunkReader::ReadNextPipelinedDataPage(bool* eos, uint8_t** data,
+    int* data_size) {
+  DCHECK(async_decompressor_ != nullptr);
+  *eos = false;
+  if (decompressed_pages_.empty()) {
+    if (!async_decompressor_->batch_in_progress()) {
+      // Nothing was read ahead, because this is the first data page or because reading
+      // ahead stopped at an error or at the end of the stream.
+      ReadAhead();
+      if (!async_decompressor_->batch_in_progress()) {
+        RETURN_IF_ERROR(read_ahead_status_);
+        DCHECK(read_ahead_eos_);
+        *eos = true;
+        return Status::OK();
+      }
+    }
+    vector<AsyncBlockDecompressor::Output> outputs;
+    Status status;
+    {
+      // With pipelining, this is the time spent waiting for the decompression thread.
+      SCOPED_TIMER(parent_->decompress_timer_);
+      status = async_decompressor_->WaitForBatch(data_page_pool_.get(), &outputs);
+    }
+    if (!status.ok()) {
+      for (ReadAheadPage& page : read_ahead_pages_) page.pool->FreeAll();
+      read_ahead_pages_.clear();
+      return status;
+    }
+    DCHECK_EQ(outputs.size(), read_ahead_pages_.size());
+    for (int i = 0; i < outputs.size(); ++i) {
+      DCHECK_EQ(outputs[i].data, read_ahead_pages_[i].data);
+      read_ahead_pages_[i].data_size = outputs[i].len;
+    }
+    decompressed_pages_.swap(read_ahead_pages_);
+    // Decompress the next batch while the values of this one are decoded.
+    ReadAhead();
+  }
+
+  ReadAheadPage& page = decompressed_pages_.front();
+  read_ahead_page_header_ = page.header;
+  data_page_pool_->AcquireData(page.pool.get(), false);
+  *data = page.data;
+  int64_t uncompressed_size = page.data_size;
+  decompressed_pages_.pop_front();
+
+  const parquet::PageHeader& current_page_header = read_ahead_page_header_;
+  VLOG_FILE << "Decompressed " << current_page_header.compressed_page_size
+            << " to " << uncompressed_size;
+  if (current_page_header.uncompressed_page_size != uncompressed_size) {
+    return Status(Substitute("Error decompressing data page in file '$0'. "
+        "Expected $1 uncompressed bytes but got $2", filename(),
+        current_page_header.uncompressed_page_size, uncompressed_size));
+  }
+  *data_size = uncompressed_size;
+  if (value_mem_type_ != ValueMemoryType::NO_SLOT_DESC) {
+    int compressed_size = current_page_header.compressed_page_size;
+    parent_->scan_node_->UpdateBytesRead(slot_id_, uncompressed_size, compressed_size);
+    parent_->UpdateUncompressedPageSizeCounter(uncompressed_size);
+    parent_->UpdateCompressedPageSizeCounter(compressed_size);
+  }
+  return Status::OK();
+}
+
+void ParquetColumnChunkReader::ReadAhead() {
+  DCHECK(async_decompressor_ != nullptr);
+  DCHECK(!async_decompressor_->batch_in_progress());
+  DCHECK(read_ahead_pages_.empty());
+  if (!read_ahead_status_.ok() || read_ahead_eos_) return;
+  // The pages read before an error are still decompressed and returned.
+  read_ahead_status_ = ReadPagesAhead();
+  if (read_ahead_pages_.empty()) {
+    async_decompressor_->DiscardBlocks();
+    return;
+  }
+  async_decompressor_->StartBatch();
+}
+
+Status ParquetColumnChunkReader::ReadPagesAhead() {
+  const int max_pages = FLAGS_parquet_decompression_read_ahead_pages;
+  int64_t batch_size = 0;
+  while (read_ahead_pages_.size() < max_pages && batch_size < MAX_READ_AHEAD_BATCH_SIZE) {
+    RETURN_IF_ERROR(page_reader_.ReadPageHeader(&read_ahead_eos_));
+    if (read_ahead_eos_) return Status::OK();
+    const parquet::PageHeader& header = page_reader_.CurrentPageHeader();
+    if (header.type != parquet::PageType::DATA_PAGE) {
+      // We can safely skip non-data pages
+      RETURN_IF_ERROR(SkipPageData());
+      continue;
+    }
+    uint8_t* compressed_data;
+    RETURN_IF_ERROR(page_reader_.ReadPageData(&compressed_data));
+
+    ReadAheadPage page;
+    page.header = header;
+    page.pool.reset(new MemPool(data_page_pool_->mem_tracker()));
+    int64_t uncompressed_size = header.uncompressed_page_size;
+    page.data = page.pool->TryAllocate(uncompressed_size);
+    if (UNLIKELY(page.data == nullptr)) {
+      string details = Substitute(PARQUET_PAGE_MEM_LIMIT_EXCEEDED, "ReadPagesAhead",
+          uncompressed_size, "decompressed data");
+      return data_page_pool_->mem_tracker()->MemLimitExceeded(
+          parent_->state_, details, uncompressed_size);
+    }
+    // The compressed data is copied, so the stream can be advanced right away.
+    Status status = async_decompressor_->AddBlock(compressed_data,
+        header.compressed_page_size, page.data, uncompressed_size);
+    if (!status.ok()) {
+      page.pool->FreeAll();
+      return status;
+    }
+    batch_size += uncompressed_size;
+    read_ahead_pages_.push_back(move(page));
+  }
+  return Status::OK();
+}
+
 }
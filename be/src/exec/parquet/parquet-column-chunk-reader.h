@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
+
 #include <boost/scoped_ptr.hpp>
 
 #include "exec/parquet/hdfs-parquet-scanner.h"
@@ -24,6 +27,7 @@
 
 namespace impala {
 
+class AsyncBlockDecompressor;
 class Codec;
 class MemPool;
 class ScopedBuffer;
@@ -32,6 +36,11 @@ class ScopedBuffer;
 /// and the possible copying of the data buffers.
 /// Before reading, InitColumnChunk(), set_io_reservation() and StartScan() must be called
 /// in this order.
+///
+/// If the column chunk is compressed with GZIP or ZSTD and large enough, and a thread
+/// token is available, the decompression of its data pages is pipelined: the next
+/// --parquet_decompression_read_ahead_pages data pages are read ahead and decompressed
+/// by an AsyncBlockDecompressor while the values of the current ones are decoded.
 class ParquetColumnChunkReader {
  public:
 
@@ -53,6 +62,8 @@ class ParquetColumnChunkReader {
   const char* filename() const { return parent_->filename(); }
 
   const parquet::PageHeader& CurrentPageHeader() const {
+    // With pipelined decompression 'page_reader_' is ahead of the current data page.
+    if (async_decompressor_ != nullptr) return read_ahead_page_header_;
     return page_reader_.CurrentPageHeader();
   }
 
@@ -90,7 +101,7 @@ class ParquetColumnChunkReader {
 
   /// If the column type is a variable length string and 'mem_pool' is not NULL, transfers
   /// the remaining resources backing tuples to 'mem_pool' and frees up other resources.
-  /// Otherwise frees all resources.
+  /// Otherwise frees all resources. Stops the pipelined decompression, if any.
   void Close(MemPool* mem_pool);
 
   /// The following functions can all advance stream_, which invalidates the buffer
@@ -119,6 +130,9 @@ class ParquetColumnChunkReader {
   /// page and this method should only be called if a data page is expected.
   /// If the stream reaches the end before reading a complete page header, '*eos' is set
   /// to true.
+  /// The first call starts the pipelined decompression of the column chunk if it is
+  /// eligible. Errors found while reading ahead are only returned once the data pages
+  /// before them were returned.
   Status ReadNextDataPage(bool* eos, uint8_t** data, int* data_size);
 
   /// If the column type is a variable length string, transfers the remaining resources
@@ -147,6 +161,46 @@ class ParquetColumnChunkReader {
 
   boost::scoped_ptr<Codec> decompressor_;
 
+  /// The compression codec of the column chunk.
+  THdfsCompression::type codec_ = THdfsCompression::NONE;
+
+  /// A data page that was read ahead for pipelined decompression.
+  struct ReadAheadPage {
+    parquet::PageHeader header;
+
+    /// Owns the buffer that the page is decompressed into. The buffer is transferred to
+    /// 'data_page_pool_' when the page becomes the current page.
+    std::unique_ptr<MemPool> pool;
+    uint8_t* data = nullptr;
+
+    /// The number of bytes that the page was decompressed to. Only valid once the
+    /// decompression of the page is finished.
+    int64_t data_size = 0;
+  };
+
+  /// True if the decompression of the column chunk should be pipelined once the first
+  /// data page is read. Set by InitColumnChunk().
+  bool try_pipelined_decompression_ = false;
+
+  /// Decompresses the data pages that were read ahead in a thread of its own, which
+  /// holds a thread token of the fragment instance. Only set while the decompression of
+  /// the column chunk is pipelined.
+  std::unique_ptr<AsyncBlockDecompressor> async_decompressor_;
+
+  /// The pages of the batch that 'async_decompressor_' is decompressing.
+  std::deque<ReadAheadPage> read_ahead_pages_;
+
+  /// The decompressed pages that were not returned by ReadNextDataPage() yet.
+  std::deque<ReadAheadPage> decompressed_pages_;
+
+  /// The header of the current data page if the decompression is pipelined.
+  parquet::PageHeader read_ahead_page_header_;
+
+  /// The error and the end of the stream that reading ahead stopped at. They are
+  /// returned once all pages before them were returned.
+  Status read_ahead_status_;
+  bool read_ahead_eos_ = false;
+
   /// See TryReadDictionaryPage() for information about the parameters.
   Status ReadDictionaryData(ScopedBuffer* uncompressed_buffer, uint8_t** dict_values,
       int64_t* data_size, int* num_entries);
@@ -167,6 +221,29 @@ class ParquetColumnChunkReader {
   Status AllocateUncompressedDataPage(
       int64_t size, const char* err_ctx, uint8_t** buffer);
 
+  /// Starts the pipelined decompression of the column chunk if a thread token is
+  /// available. Otherwise the data pages are decompressed by ReadDataPageData().
+  Status StartPipelinedDecompression();
+
+  /// Stops the pipelined decompression, if any, and frees the pages that were read ahead.
+  void StopPipelinedDecompression();
+
+  /// Implements ReadNextDataPage() if the decompression is pipelined. Returns the next
+  /// decompressed page and starts the decompression of the next batch of pages whenever
+  /// it waited for a batch.
+  Status ReadNextPipelinedDataPage(bool* eos, uint8_t** data, int* data_size);
+
+  /// Reads the next batch of data pages into 'read_ahead_pages_' and starts their
+  /// decompression. Does nothing if reading ahead already stopped at an error or at the
+  /// end of the stream. Otherwise records where it stopped in 'read_ahead_status_' and
+  /// 'read_ahead_eos_'.
+  void ReadAhead();
+
+  /// Reads data pages into 'read_ahead_pages_' and adds them to the next batch of
+  /// 'async_decompressor_' until the batch is full. Non-data pages are skipped. Sets
+  /// 'read_ahead_eos_' if the end of the stream is reached.
+  Status ReadPagesAhead();
+
   ValueMemoryType value_mem_type_;
 };
 
@@ -36,6 +36,7 @@
 #include "runtime/runtime-filter.h"
 #include "runtime/runtime-state.h"
 #include "service/hs2-util.h"
+#include "util/bit-util.h"
 #include "util/bloom-filter.h"
 #include "util/cyclic-barrier.h"
 #include "util/debug-util.h"
@@ -259,6 +260,8 @@ Status PhjBuilder::Prepare(RuntimeState* state, MemTracker* parent_mem_tracker)
   ht_stats_profile_ = HashTable::AddHashTableCounters(profile());
   num_spilled_partitions_ = ADD_COUNTER(profile(), "SpilledPartitions", TUnit::UNIT);
   num_repartitions_ = ADD_COUNTER(profile(), "NumRepartitions", TUnit::UNIT);
+  num_skewed_partitions_ = ADD_COUNTER(profile(), "NumSkewedPartitions", TUnit::UNIT);
+  num_skew_chunks_ = ADD_COUNTER(profile(), "NumSkewedPartitionChunks", TUnit::UNIT);
   partition_build_rows_timer_ = ADD_TIMER(profile(), "BuildRowsPartitionTime");
   build_hash_table_timer_ = ADD_TIMER(profile(), "HashTablesBuildTime");
   num_hash_table_builds_skipped_ =
@@ -921,6 +924,39 @@ void PhjBuilder::InsertRuntimeFilters(
   for (const FilterContext& ctx : filter_ctxs_) ctx.Insert(build_row);
 }
 
+BloomFilter* PhjBuilder::FoldBloomFilter(const FilterContext& ctx) {
+  BloomFilter* bloom_filter = ctx.local_bloom_filter;
+  const TRuntimeFilterDesc& filter_desc = ctx.filter->filter_desc();
+  kudu::Slice directory = bloom_filter->GetBlockBloomFilter()->directory();
+  int64_t directory_size = directory.size();
+  int64_t ndv = BloomFilter::EstimateNdv(directory.data(), directory_size);
+  int log_space = BitUtil::Log2Ceiling64(directory_size);
+  int folded_log_space = log_space;
+  // Only the filters of broadcast joins are folded here: every producer inserts the
+  // whole build side and so folds to the same size. The filters of partitioned joins
+  // must keep a common size until they are merged, which happens on the coordinator.
+  if (filter_desc.is_broadcast_join) {
+    folded_log_space = RuntimeFilterBank::GetFoldedLogSpace(
+        runtime_state_->query_options(), ndv, log_space);
+  }
+  RuntimeProfile::Counter* ndv_counter = ADD_COUNTER(profile(),
+      Substitute("RuntimeFilter$0BuildNdv", ctx.filter->id()), TUnit::UNIT);
+  COUNTER_SET(ndv_counter, ndv);
+  RuntimeProfile::Counter* size_counter = ADD_COUNTER(profile(),
+      Substitute("RuntimeFilter$0Size", ctx.filter->id()), TUnit::BYTES);
+  COUNTER_SET(size_counter, 1LL << folded_log_space);
+  if (folded_log_space >= log_space) return bloom_filter;
+  Status status =
+      bloom_filter->Fold(folded_log_space, RuntimeFilterBank::DefaultHashSeed());
+  if (!status.ok()) {
+    // The original directory was already released, so the filter must be disabled.
+    VLOG_QUERY << "Could not fold runtime filter " << ctx.filter->id() << ": "
+               << status.GetDetail();
+    return nullptr;
+  }
+  return bloom_filter;
+}
+
 void PhjBuilder::PublishRuntimeFilters(int64_t num_build_rows) {
   VLOG(3) << "Join builder (join_node_id_=" << join_node_id_ << ") publishing "
           << filter_ctxs_.size() << " filters.";
@@ -930,7 +966,8 @@ void PhjBuilder::PublishRuntimeFilters(int64_t num_build_rows) {
     BloomFilter* bloom_filter = nullptr;
     if (ctx.local_bloom_filter != nullptr) {
       bloom_filter = ctx.local_bloom_filter;
-      ++num_enabled_filters;
+      if (!bloom_filter->AlwaysFalse()) bloom_filter = FoldBloomFilter(ctx);
+      if (bloom_filter != nullptr) ++num_enabled_filters;
     } else if (ctx.local_min_max_filter != nullptr) {
       /// Apply the column min/max stats (if applicable) to shut down the min/max
       /// filter early by setting always true flag for the filter. Do this only if
@@ -1066,10 +1103,22 @@ Status PhjBuilder::BeginSpilledProbeSerial() {
   // Try to build a hash table for the spilled build partition.
   bool built;
   RETURN_IF_ERROR(partition->BuildHashTable(&built));
+  if (!built && partition->is_skewed() && CanSplitSkewedPartitions()) {
+    // Repartitioning cannot split the dominant key of the partition. Split its build
+    // rows into chunks that fit in memory and probe them one after the other instead.
+    RETURN_IF_ERROR(SplitSkewedPartition(partition));
+    partition = spilled_partitions_.back().get();
+    RETURN_IF_ERROR(partition->BuildHashTable(&built));
+  }
   if (built) {
     UpdateState(HashJoinState::PROBING_SPILLED_PARTITION);
     return Status::OK();
   }
+  if (partition->is_skew_chunk()) {
+    return Status(TErrorCode::PARTITIONED_HASH_JOIN_SKEW_CHUNK_FAILS, join_node_id_,
+        partition->build_rows()->num_rows(), DebugString(),
+        buffer_pool_client_->DebugString());
+  }
   // This build partition still does not fit in memory, repartition.
   UpdateState(HashJoinState::REPARTITIONING_BUILD);
 
@@ -1102,6 +1151,15 @@ Status PhjBuilder::BeginSpilledProbeSerial() {
   DCHECK_GE(num_input_rows, largest_partition_rows) << "Cannot have a partition with "
                                                        "more rows than the input";
   if (UNLIKELY(num_input_rows == largest_partition_rows)) {
+    // All rows share the key that made the partition skewed, so the new partition is
+    // split into chunks once it is processed.
+    bool all_skewed = true;
+    for (const unique_ptr<PhjBuilderPartition>& hash_partition : hash_partitions_) {
+      if (hash_partition->IsClosed()) continue;
+      if (hash_partition->build_rows()->num_rows() != largest_partition_rows) continue;
+      all_skewed = hash_partition->is_skewed();
+    }
+    if (all_skewed && CanSplitSkewedPartitions()) return Status::OK();
     return Status(TErrorCode::PARTITIONED_HASH_JOIN_REPARTITION_FAILS, join_node_id_,
         next_partition_level, num_input_rows, DebugString(),
         buffer_pool_client_->DebugString());
@@ -1127,7 +1185,10 @@ Status PhjBuilder::RepartitionBuildInput(PhjBuilderPartition* input_partition) {
   }
   RETURN_IF_ERROR(CreateHashPartitions(new_level));
 
-  // Repartition 'input_stream' into 'hash_partitions_'.
+  // Repartition 'input_stream' into 'hash_partitions_', sampling the keys to detect
+  // skewed partitions.
+  SpaceSavingSketch sketch(SKEW_SKETCH_CAPACITY);
+  int64_t num_input_rows = build_rows->num_rows();
   RowBatch build_batch(row_desc_, state->batch_size(), mem_tracker());
   bool eos = false;
   while (!eos) {
@@ -1135,6 +1196,7 @@ Status PhjBuilder::RepartitionBuildInput(PhjBuilderPartition* input_partition) {
     RETURN_IF_ERROR(state->CheckQueryState());
 
     RETURN_IF_ERROR(build_rows->GetNext(&build_batch, &eos));
+    SampleBuildKeys(&build_batch, &sketch);
     RETURN_IF_ERROR(AddBatch(&build_batch));
     build_batch.Reset();
   }
@@ -1142,9 +1204,130 @@ Status PhjBuilder::RepartitionBuildInput(PhjBuilderPartition* input_partition) {
   // Done reading the input, we can safely close it now to free memory.
   input_partition->Close(nullptr);
   RETURN_IF_ERROR(FinalizeBuild(state));
+  MarkSkewedPartitions(sketch, num_input_rows);
+  return Status::OK();
+}
+
+void PhjBuilder::SampleBuildKeys(RowBatch* batch, SpaceSavingSketch* sketch) {
+  HashTableCtx::ExprValuesCache* expr_vals_cache = ht_ctx_->expr_values_cache();
+  for (int i = 0; i < batch->num_rows(); i += SKEW_SAMPLE_INTERVAL) {
+    expr_vals_cache->Reset();
+    if (ht_ctx_->EvalAndHashBuild(batch->GetRow(i))) {
+      sketch->Update(expr_vals_cache->CurExprValuesHash());
+    }
+  }
+}
+
+void PhjBuilder::MarkSkewedPartitions(
+    const SpaceSavingSketch& sketch, int64_t num_input_rows) {
+  if (sketch.total() == 0) return;
+  // Only keys with at least 1 / (2 * PARTITION_FANOUT) of the input can make up half
+  // of a partition that is no larger than the average.
+  for (const SpaceSavingSketch::Entry& key :
+      sketch.GetHeavyHitters(0.5 / PARTITION_FANOUT)) {
+    const uint32_t partition_idx =
+        static_cast<uint32_t>(key.key) >> (32 - NUM_PARTITIONING_BITS);
+    PhjBuilderPartition* partition = hash_partitions_[partition_idx].get();
+    if (partition->IsClosed() || !partition->is_spilled() || partition->is_skewed()) {
+      continue;
+    }
+    int64_t est_key_rows = static_cast<int64_t>(
+        static_cast<double>(key.count - key.error) / sketch.total() * num_input_rows);
+    if (2 * est_key_rows < partition->build_rows()->num_rows()) continue;
+    VLOG(2) << "PHJ(node_id=" << join_node_id_ << ") partition " << partition->id()
+            << " at level " << partition->level() << " is skewed: about " << est_key_rows
+            << " of its " << partition->build_rows()->num_rows()
+            << " rows have the same key";
+    partition->set_skewed();
+    COUNTER_ADD(num_skewed_partitions_, 1);
+  }
+}
+
+bool PhjBuilder::CanSplitSkewedPartitions() const {
+  // The null-aware partition would have to be matched against every chunk.
+  return join_op_ != TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN;
+}
+
+Status PhjBuilder::SplitSkewedPartition(PhjBuilderPartition* partition) {
+  DCHECK(CanSplitSkewedPartitions());
+  DCHECK_EQ(partition, spilled_partitions_.back().get());
+  DCHECK(partition->is_skewed());
+  RETURN_IF_ERROR(partition->Spill(BufferedTupleStream::UNPIN_ALL));
+  BufferedTupleStream* build_rows = partition->build_rows();
+  DCHECK_GT(build_rows->num_rows(), 0);
+
+  // Size the chunks so that the rows of a chunk and its hash table use at most half of
+  // the reservation that is now unused, which leaves room for rounding up to whole
+  // pages. Since most rows of a skewed partition are duplicates, budgeting two hash
+  // table buckets per row also covers the duplicate nodes.
+  int64_t bytes_per_row = build_rows->byte_size() / build_rows->num_rows()
+      + 2 * HashTable::BucketSize();
+  int64_t max_chunk_rows =
+      max<int64_t>(1, buffer_pool_client_->GetUnusedReservation() / 2 / bytes_per_row);
+
+  bool got_read_buffer;
+  RETURN_IF_ERROR(build_rows->PrepareForRead(true, &got_read_buffer));
+  if (!got_read_buffer) {
+    return mem_tracker()->MemLimitExceeded(
+        runtime_state_, Substitute(PREPARE_FOR_READ_FAILED_ERROR_MSG, join_node_id_));
+  }
+  // The chunks are inserted in front of 'partition' so that they are cleaned up by
+  // Close() if an error occurs.
+  auto insert_pos = spilled_partitions_.end() - 1;
+  PhjBuilderPartition* chunk = nullptr;
+  RowBatch batch(row_desc_, runtime_state_->batch_size(), mem_tracker());
+  bool eos = false;
+  while (!eos) {
+    RETURN_IF_CANCELLED(runtime_state_);
+    RETURN_IF_ERROR(runtime_state_->CheckQueryState());
+    RETURN_IF_ERROR(build_rows->GetNext(&batch, &eos));
+    FOREACH_ROW(&batch, 0, batch_iter) {
+      if (chunk == nullptr || chunk->build_rows()->num_rows() >= max_chunk_rows) {
+        if (chunk != nullptr) {
+          RETURN_IF_ERROR(chunk->Spill(BufferedTupleStream::UNPIN_ALL));
+        }
+        unique_ptr<PhjBuilderPartition> new_chunk;
+        RETURN_IF_ERROR(CreateAndPreparePartition(partition->level(), &new_chunk));
+        chunk = new_chunk.get();
+        insert_pos = spilled_partitions_.insert(insert_pos, std::move(new_chunk)) + 1;
+        // Write the chunk unpinned so that it only needs a single write buffer.
+        RETURN_IF_ERROR(chunk->Spill(BufferedTupleStream::UNPIN_ALL_EXCEPT_CURRENT));
+        chunk->set_probe_partition_id(partition->probe_partition_id());
+        chunk->IncrementNumSpilledProbeRows(partition->num_spilled_probe_rows());
+        COUNTER_ADD(num_skew_chunks_, 1);
+      }
+      Status status;
+      if (UNLIKELY(!chunk->build_rows()->AddRow(batch_iter.Get(), &status))) {
+        RETURN_IF_ERROR(status);
+        return mem_tracker()->MemLimitExceeded(runtime_state_,
+            Substitute("Failed to get a write buffer to split a skewed partition of the "
+                "hash join with id $0.", join_node_id_));
+      }
+    }
+    batch.Reset();
+  }
+  DCHECK(chunk != nullptr);
+  RETURN_IF_ERROR(chunk->Spill(BufferedTupleStream::UNPIN_ALL));
+  VLOG(2) << "PHJ(node_id=" << join_node_id_ << ") split skewed partition "
+          << partition->id() << " with " << build_rows->num_rows() << " rows into "
+          << "chunks of at most " << max_chunk_rows << " rows";
+  DCHECK_EQ(partition, spilled_partitions_.back().get());
+  partition->Close(nullptr);
+  spilled_partitions_.pop_back();
   return Status::OK();
 }
 
+PhjBuilderPartition* PhjBuilder::NextSkewChunk(const PhjBuilderPartition* chunk) const {
+  if (!chunk->is_skew_chunk()) return nullptr;
+  // The chunks of a partition are adjacent in 'spilled_partitions_' and are processed
+  // from the back.
+  for (auto it = spilled_partitions_.rbegin(); it != spilled_partitions_.rend(); ++it) {
+    if (it->get() == chunk) continue;
+    if ((*it)->probe_partition_id() == chunk->probe_partition_id()) return it->get();
+  }
+  return nullptr;
+}
+
 int64_t PhjBuilder::LargestPartitionRows() const {
   int64_t max_rows = 0;
   for (int i = 0; i < hash_partitions_.size(); ++i) {
@@ -1181,6 +1364,7 @@ PhjBuilderPartition::PhjBuilderPartition(RuntimeState* state, PhjBuilder* parent
   : parent_(parent),
     id_(parent->next_partition_id_++),
     is_spilled_(false),
+    probe_partition_id_(id_),
     level_(level) {
   build_rows_ = make_unique<BufferedTupleStream>(state, parent_->row_desc_,
       parent_->buffer_pool_client_, parent->spillable_buffer_size_,
@@ -36,6 +36,7 @@
 #include "runtime/bufferpool/buffer-pool.h"
 #include "runtime/bufferpool/suballocator.h"
 #include "runtime/reservation-manager.h"
+#include "util/space-saving-sketch.h"
 
 namespace impala {
 
@@ -248,6 +249,19 @@ class PhjBuilderPartition {
     num_spilled_probe_rows_.Add(count);
   }
 
+  /// True if, when this partition was created by repartitioning, a single join key was
+  /// found to make up at least half of its rows. Repartitioning cannot split such a
+  /// partition, see PhjBuilder::SplitSkewedPartition().
+  bool is_skewed() const { return is_skewed_; }
+  void set_skewed() { is_skewed_ = true; }
+
+  /// Id of the partition whose spilled probe rows this partition is probed with. This is
+  /// the partition's own id, unless it holds a chunk of the build rows of a skewed
+  /// partition, in which case it is the id of the skewed partition.
+  PartitionId probe_partition_id() const { return probe_partition_id_; }
+  bool is_skew_chunk() const { return probe_partition_id_ != id_; }
+  void set_probe_partition_id(PartitionId id) { probe_partition_id_ = id; }
+
  private:
   /// Inserts each row in 'batch' into 'hash_tbl_' using 'ctx'. 'flat_rows' is an array
   /// containing the rows in the hash table's tuple stream.
@@ -270,6 +284,12 @@ class PhjBuilderPartition {
   /// True if this partition is spilled.
   bool is_spilled_;
 
+  /// See is_skewed().
+  bool is_skewed_ = false;
+
+  /// See probe_partition_id().
+  PartitionId probe_partition_id_;
+
   /// How many times rows in this partition have been repartitioned. Partitions created
   /// from the node's children's input is level 0, 1 after the first repartitioning,
   /// etc.
@@ -356,11 +376,19 @@ class PhjBuilder : public JoinBuilder {
   /// limit and 64 fanout, we can support 256TB build tables in the case where
   /// there is no skew.
   /// In the case where there is skew, repartitioning is unlikely to help (assuming a
-  /// reasonable hash function).
+  /// reasonable hash function). Skewed partitions are therefore detected while
+  /// repartitioning and, if the join mode allows, split into chunks instead, see
+  /// SplitSkewedPartition().
   /// Note that we need to have at least as many SEED_PRIMES in HashTableCtx.
-  /// TODO: we can revisit and try harder to explicitly detect skew.
   static const int MAX_PARTITION_DEPTH = 16;
 
+  /// One out of this many build rows is sampled while repartitioning to find keys that
+  /// dominate a partition.
+  static const int SKEW_SAMPLE_INTERVAL = 16;
+
+  /// Number of keys tracked while sampling build rows for skew.
+  static const int SKEW_SKETCH_CAPACITY = 32;
+
   using PartitionId = int;
 
   // Constructor for separate join build.
@@ -496,6 +524,12 @@ class PhjBuilder : public JoinBuilder {
       std::deque<std::unique_ptr<PhjBuilderPartition>>* output_partitions,
       RowBatch* batch);
 
+  /// If 'chunk' is a chunk of a skewed partition (see SplitSkewedPartition()), returns
+  /// the chunk of the same partition that is probed after it, or nullptr if 'chunk' is
+  /// the last one or not a chunk. The probe side keeps the skewed partition's probe rows
+  /// until all of its chunks were probed.
+  PhjBuilderPartition* NextSkewChunk(const PhjBuilderPartition* chunk) const;
+
   /// Called to begin probing of the null-aware partition, after all other partitions
   /// have been fully processed. This should only be called if there are build rows in the
   /// null-aware partition. This pins the null-aware build rows in memory and allows all
@@ -684,6 +718,29 @@ class PhjBuilder : public JoinBuilder {
   /// Returns the largest build row count out of the current hash partitions.
   int64_t LargestPartitionRows() const;
 
+  /// Adds the partitioning hash values of every SKEW_SAMPLE_INTERVAL'th row of 'batch'
+  /// to 'sketch'. Must be called before the rows are partitioned with AddBatch().
+  void SampleBuildKeys(RowBatch* batch, SpaceSavingSketch* sketch);
+
+  /// Marks the spilled hash partitions in which a key sampled into 'sketch' makes up
+  /// at least half of the rows as skewed. 'num_input_rows' is the number of rows that
+  /// were repartitioned.
+  void MarkSkewedPartitions(const SpaceSavingSketch& sketch, int64_t num_input_rows);
+
+  /// Returns true if skewed partitions can be split with SplitSkewedPartition(). The
+  /// probe rows are processed once per chunk. Join modes that output probe rows based on
+  /// whether they matched remember the probe rows that matched in earlier chunks, see
+  /// PartitionedHashJoinNode::skew_matched_probe_rows_. This is not supported for null
+  /// aware anti joins.
+  bool CanSplitSkewedPartitions() const;
+
+  /// Block nested loop fallback for a skewed 'partition' whose build rows do not fit in
+  /// memory, which is the last of 'spilled_partitions_'. Splits the build rows into
+  /// chunks that each fit in memory with their hash table and replaces 'partition' with
+  /// the chunks in 'spilled_partitions_'. Each chunk is then probed with all of the
+  /// partition's spilled probe rows, as if it was a separate spilled partition.
+  Status SplitSkewedPartition(PhjBuilderPartition* partition) WARN_UNUSED_RESULT;
+
   /// Helper for DoneProbingHashPartitions() that processes and cleans up the hash
   /// partitions.
   void CleanUpHashPartitions(
@@ -716,6 +773,14 @@ class PhjBuilder : public JoinBuilder {
   /// This is replaced at runtime with code generated by CodegenInsertRuntimeFilters().
   void InsertRuntimeFilters(FilterContext filter_ctxs[], TupleRow* build_row) noexcept;
 
+  /// Estimates the number of distinct values in the local Bloom filter of 'ctx' and
+  /// reports it and the size of the published filter in the RuntimeFilter<id>BuildNdv
+  /// and RuntimeFilter<id>Size counters. For broadcast joins, also folds the filter
+  /// down to the size needed for that number, see RuntimeFilterBank::GetFoldedLogSpace().
+  /// Filters are never grown, so the size is at most the planner's size. Returns
+  /// the filter to publish, or nullptr if it must be disabled because folding failed.
+  BloomFilter* FoldBloomFilter(const FilterContext& ctx);
+
   /// Publish the runtime filters to the fragment-local RuntimeFilterBank.
   /// 'num_build_rows' is used to determine whether the computed filters have an
   /// unacceptably high false-positive rate.
@@ -798,6 +863,12 @@ class PhjBuilder : public JoinBuilder {
   /// Number of partitions that have been repartitioned.
   RuntimeProfile::Counter* num_repartitions_ = nullptr;
 
+  /// Number of partitions that repartitioning found to be dominated by a single key.
+  RuntimeProfile::Counter* num_skewed_partitions_ = nullptr;
+
+  /// Number of chunks that skewed partitions were split into by SplitSkewedPartition().
+  RuntimeProfile::Counter* num_skew_chunks_ = nullptr;
+
   /// Time spent partitioning build rows.
   RuntimeProfile::Counter* partition_build_rows_timer_ = nullptr;
 
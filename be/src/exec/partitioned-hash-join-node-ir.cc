@@ -129,11 +129,13 @@ bool IR_ALWAYS_INLINE PartitionedHashJoinNode::ProcessProbeRowLeftSemiJoins(
         continue;
       }
     }
-    // Create output row assembled from probe tuples.
-    out_batch_iterator->parent()->CopyRow(current_probe_row_, out_row);
     // A match is found in the hash table. The search is over for this probe row.
     matched_probe_ = true;
     hash_tbl_iterator_.SetAtEnd();
+    // Only output the probe row for the first chunk of a skewed partition it matches.
+    if (UNLIKELY(probing_skew_chunk_) && SetSkewProbeRowMatched()) return true;
+    // Create output row assembled from probe tuples.
+    out_batch_iterator->parent()->CopyRow(current_probe_row_, out_row);
     // Append to output batch for left semi joins if the conjuncts are satisfied.
     if (JoinOp == TJoinOp::LEFT_SEMI_JOIN &&
         ExecNode::EvalConjuncts(conjunct_evals, num_conjuncts, out_row)) {
@@ -146,6 +148,7 @@ bool IR_ALWAYS_INLINE PartitionedHashJoinNode::ProcessProbeRowLeftSemiJoins(
   }
 
   if (JoinOp != TJoinOp::LEFT_SEMI_JOIN && !matched_probe_) {
+    if (UNLIKELY(probing_skew_chunk_) && !IsSkewProbeRowUnmatched()) return true;
     if (JoinOp == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN) {
       // Null aware behavior. The probe row did not match in the hash table so we
       // should interpret the hash table probe as "unknown" if there are nulls on the
@@ -193,6 +196,7 @@ bool IR_ALWAYS_INLINE PartitionedHashJoinNode::ProcessProbeRowOuterJoins(
     }
     // At this point the probe is considered matched.
     matched_probe_ = true;
+    if (UNLIKELY(probing_skew_chunk_)) SetSkewProbeRowMatched();
     if (JoinOp == TJoinOp::RIGHT_OUTER_JOIN || JoinOp == TJoinOp::FULL_OUTER_JOIN) {
       // There is a match for this build row. Mark the Bucket or the DuplicateNode
       // as matched for right/full outer joins.
@@ -209,6 +213,7 @@ bool IR_ALWAYS_INLINE PartitionedHashJoinNode::ProcessProbeRowOuterJoins(
   }
 
   if (JoinOp != TJoinOp::RIGHT_OUTER_JOIN && !matched_probe_) {
+    if (UNLIKELY(probing_skew_chunk_) && !IsSkewProbeRowUnmatched()) return true;
     // No match for this row, we need to output it if it's a left/full outer join.
     CreateOutputRow(out_row, current_probe_row_, NULL);
     if (ExecNode::EvalConjuncts(conjunct_evals, num_conjuncts, out_row)) {
@@ -221,6 +226,25 @@ bool IR_ALWAYS_INLINE PartitionedHashJoinNode::ProcessProbeRowOuterJoins(
   return true;
 }
 
+bool IR_ALWAYS_INLINE PartitionedHashJoinNode::SetSkewProbeRowMatched() {
+  DCHECK(probing_skew_chunk_);
+  int64_t idx = skew_probe_batch_offset_ + (current_probe_row_ - probe_batch_->GetRow(0))
+      / probe_batch_->num_tuples_per_row();
+  DCHECK_LT(idx, skew_matched_probe_rows_.size());
+  if (skew_matched_probe_rows_[idx]) return true;
+  skew_matched_probe_rows_[idx] = true;
+  return false;
+}
+
+bool IR_ALWAYS_INLINE PartitionedHashJoinNode::IsSkewProbeRowUnmatched() const {
+  DCHECK(probing_skew_chunk_);
+  if (!probing_last_skew_chunk_) return false;
+  int64_t idx = skew_probe_batch_offset_ + (current_probe_row_ - probe_batch_->GetRow(0))
+      / probe_batch_->num_tuples_per_row();
+  DCHECK_LT(idx, skew_matched_probe_rows_.size());
+  return !skew_matched_probe_rows_[idx];
+}
+
 template <int const JoinOp>
 bool IR_ALWAYS_INLINE PartitionedHashJoinNode::ProcessProbeRow(
     ScalarExprEvaluator* const* other_join_conjunct_evals,
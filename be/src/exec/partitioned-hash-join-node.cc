@@ -35,6 +35,7 @@
 #include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "util/bit-util.h"
 #include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
 
@@ -246,6 +247,8 @@ Status PartitionedHashJoinNode::Reset(RuntimeState* state, RowBatch* row_batch)
     null_probe_output_idx_ = -1;
     matched_null_probe_.clear();
   }
+  probing_skew_chunk_ = false;
+  FreeSkewMatchedProbeRows();
   ht_ctx_->set_level(0);
   CloseAndDeletePartitions(row_batch);
   builder_->Reset(IsLeftSemiJoin(join_op_) ? nullptr : row_batch);
@@ -299,6 +302,7 @@ void PartitionedHashJoinNode::Close(RuntimeState* state) {
   if (build_batch_ != nullptr) build_batch_->Reset();
   if (probe_batch_ != nullptr) probe_batch_->Reset();
   CloseAndDeletePartitions(nullptr);
+  FreeSkewMatchedProbeRows();
   if (builder_ != nullptr) {
     bool separate_build = UseSeparateBuild(state->query_options());
     if (!separate_build || waited_for_build_) {
@@ -337,9 +341,9 @@ Status PartitionedHashJoinNode::ProbePartition::PrepareForWrite(
   return Status::OK();
 }
 
-Status PartitionedHashJoinNode::ProbePartition::PrepareForRead() {
+Status PartitionedHashJoinNode::ProbePartition::PrepareForRead(bool delete_on_read) {
   bool got_read_buffer;
-  RETURN_IF_ERROR(probe_rows_->PrepareForRead(true, &got_read_buffer));
+  RETURN_IF_ERROR(probe_rows_->PrepareForRead(delete_on_read, &got_read_buffer));
   DCHECK(got_read_buffer) << "Accounted in min reservation";
   return Status::OK();
 }
@@ -420,6 +424,7 @@ Status PartitionedHashJoinNode::NextSpilledProbeRowBatch(
   BufferedTupleStream* probe_rows = input_partition_->probe_rows();
   if (LIKELY(probe_rows->rows_returned() < probe_rows->num_rows())) {
     // Continue from the current probe stream.
+    skew_probe_batch_offset_ = probe_rows->rows_returned();
     RETURN_IF_ERROR(probe_rows->GetNext(probe_batch_.get(), eos));
     DCHECK_GT(probe_batch_->num_rows(), 0);
     ResetForProbe();
@@ -444,11 +449,16 @@ Status PartitionedHashJoinNode::BeginSpilledProbe() {
   RETURN_IF_ERROR(builder_->BeginSpilledProbe(buffer_pool_client(), runtime_profile(),
       &repartitioned, &build_input_partition, &build_hash_partitions_));
 
-  auto it = spilled_partitions_.find(build_input_partition->id());
+  auto it = spilled_partitions_.find(build_input_partition->probe_partition_id());
   DCHECK(it != spilled_partitions_.end())
       << "All spilled build partitions must have a corresponding probe partition";
   input_partition_ = std::move(it->second);
   spilled_partitions_.erase(it);
+  // The chunks of a skewed build partition share the probe partition of the partition
+  // that they were split from.
+  if (build_input_partition->is_skew_chunk()) {
+    input_partition_->set_build_partition(build_input_partition);
+  }
   DCHECK_EQ(build_input_partition, input_partition_->build_partition());
   DCHECK_EQ(input_partition_->probe_rows()->BytesPinned(false), 0) << NodeDebugString();
 
@@ -1056,8 +1066,21 @@ Status PartitionedHashJoinNode::PrepareForUnpartitionedProbe() {
   DCHECK(input_partition_->build_partition()->hash_tbl() != nullptr);
 
   // This is a spilled partition - we need to read the probe rows. Memory was reserved
-  // in builder_->BeginSpilledProbe() for the input stream's read buffer.
-  RETURN_IF_ERROR(input_partition_->PrepareForRead());
+  // in builder_->BeginSpilledProbe() for the input stream's read buffer. The rows are
+  // kept if more chunks of a skewed build partition need to be probed with them.
+  PhjBuilderPartition* build_partition = input_partition_->build_partition();
+  bool is_last_chunk = builder_->NextSkewChunk(build_partition) == nullptr;
+  RETURN_IF_ERROR(input_partition_->PrepareForRead(is_last_chunk));
+  probing_skew_chunk_ = build_partition->is_skew_chunk()
+      && (join_op_ == TJoinOp::LEFT_OUTER_JOIN || join_op_ == TJoinOp::FULL_OUTER_JOIN
+             || IsLeftSemiJoin(join_op_));
+  if (probing_skew_chunk_) {
+    // The probe rows that matched are remembered across the chunks.
+    probing_last_skew_chunk_ = is_last_chunk;
+    RETURN_IF_ERROR(
+        AllocateSkewMatchedProbeRows(input_partition_->probe_rows()->num_rows()));
+    skew_probe_batch_offset_ = 0;
+  }
 
   // In this case, we did not have to partition the build again, we just built
   // a hash table. This means the probe does not have to be partitioned either.
@@ -1067,6 +1090,33 @@ Status PartitionedHashJoinNode::PrepareForUnpartitionedProbe() {
   return Status::OK();
 }
 
+Status PartitionedHashJoinNode::AllocateSkewMatchedProbeRows(int64_t num_probe_rows) {
+  if (!skew_matched_probe_rows_.empty()) {
+    // A later chunk of the same skewed partition is probed with the same rows.
+    DCHECK_EQ(skew_matched_probe_rows_.size(), num_probe_rows);
+    return Status::OK();
+  }
+  // std::vector<bool> stores one bit per row.
+  int64_t bytes = BitUtil::RoundUpNumBytes(num_probe_rows);
+  if (!mem_tracker()->TryConsume(bytes)) {
+    return mem_tracker()->MemLimitExceeded(runtime_state_, Substitute("Failed to "
+        "allocate $0 bytes to track the matched probe rows of a skewed partition in "
+        "hash join id=$1.", bytes, id_), bytes);
+  }
+  skew_matched_probe_rows_bytes_ = bytes;
+  skew_matched_probe_rows_.resize(num_probe_rows, false);
+  return Status::OK();
+}
+
+void PartitionedHashJoinNode::FreeSkewMatchedProbeRows() {
+  skew_matched_probe_rows_.clear();
+  skew_matched_probe_rows_.shrink_to_fit();
+  if (skew_matched_probe_rows_bytes_ > 0) {
+    mem_tracker()->Release(skew_matched_probe_rows_bytes_);
+    skew_matched_probe_rows_bytes_ = 0;
+  }
+}
+
 bool PartitionedHashJoinNode::AppendProbeRowSlow(
     BufferedTupleStream* stream, TupleRow* row, Status* status) {
   if (!status->ok()) return false; // Check if AddRow() set status.
@@ -1136,8 +1186,23 @@ Status PartitionedHashJoinNode::DoneProbing(RuntimeState* state, RowBatch* batch
   // Clean up input partition first to free up probe reservation before calling
   // DoneProbing*().
   if (input_partition_ != nullptr) {
-    input_partition_->Close(batch);
-    input_partition_.reset();
+    PhjBuilderPartition* next_chunk = nullptr;
+    if (builder_->state() == HashJoinState::PROBING_SPILLED_PARTITION) {
+      next_chunk = builder_->NextSkewChunk(input_partition_->build_partition());
+    }
+    if (next_chunk != nullptr) {
+      // Keep the probe rows to probe the next chunk of the skewed build partition.
+      RETURN_IF_ERROR(
+          input_partition_->probe_rows()->UnpinStream(BufferedTupleStream::UNPIN_ALL));
+      input_partition_->set_build_partition(next_chunk);
+      spilled_partitions_.emplace(
+          next_chunk->probe_partition_id(), std::move(input_partition_));
+    } else {
+      input_partition_->Close(batch);
+      input_partition_.reset();
+      FreeSkewMatchedProbeRows();
+    }
+    probing_skew_chunk_ = false;
   }
   if (builder_->state() == HashJoinState::PROBING_SPILLED_PARTITION) {
     // Need to clean up single in-memory build partition instead of hash partitions.
@@ -373,6 +373,23 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// Probes 'current_probe_row_' against the the hash tables and append outputs
   /// to output batch. Wrapper around the join-type specific probe row functions
   /// declared above.
+  /// Marks 'current_probe_row_' as matched in 'skew_matched_probe_rows_'. Returns true
+  /// if it had already matched a previous chunk of the skewed build partition.
+  bool inline SetSkewProbeRowMatched();
+
+  /// Returns true if 'current_probe_row_', which did not match the current chunk of the
+  /// skewed build partition, should be output as unmatched: if this is the last chunk
+  /// and no previous chunk matched it either.
+  bool inline IsSkewProbeRowUnmatched() const;
+
+  /// Sizes 'skew_matched_probe_rows_' for 'num_probe_rows' probe rows if it is empty,
+  /// charging its memory to this node's MemTracker. Returns an error if that exceeds a
+  /// memory limit.
+  Status AllocateSkewMatchedProbeRows(int64_t num_probe_rows) WARN_UNUSED_RESULT;
+
+  /// Frees 'skew_matched_probe_rows_' and releases its memory.
+  void FreeSkewMatchedProbeRows();
+
   template <int const JoinOp>
   bool inline ProcessProbeRow(ScalarExprEvaluator* const* other_join_conjunct_evals,
       int num_other_join_conjuncts, ScalarExprEvaluator* const* conjunct_evals,
@@ -614,7 +631,8 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   std::vector<std::unique_ptr<ProbePartition>> probe_hash_partitions_;
 
   /// Probe partitions that have been spilled and still need more processing. Each of
-  /// these has a corresponding build partition in 'builder_' with the same PartitionId.
+  /// these has a corresponding build partition in 'builder_' with the same PartitionId,
+  /// or one or more chunks of a skewed build partition with that probe partition id.
   /// For shared broadcast join builds, the set of keys in this map will be the same
   /// across all of the instances of the join builder.
   /// This list is populated at DoneProbing().
@@ -660,6 +678,26 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// OUTPUTTING_NULL_PROBE.
   int64_t null_probe_output_idx_ = -1;
 
+  /// True if 'input_partition_' is probed against a chunk of a skewed build partition
+  /// (see PhjBuilder::SplitSkewedPartition()) for a join mode that outputs probe rows
+  /// based on whether they matched. Such probe rows are only output once: matched rows
+  /// by the first chunk that they match and unmatched rows by the last chunk.
+  bool probing_skew_chunk_ = false;
+
+  /// True if 'probing_skew_chunk_' is true and the current chunk is the last one.
+  bool probing_last_skew_chunk_ = false;
+
+  /// For each row of the probe stream of 'input_partition_', true if the row matched a
+  /// build row in one of the chunks that were probed so far. Only used if
+  /// 'probing_skew_chunk_' is true and cleared after the last chunk. Its memory is
+  /// counted in 'skew_matched_probe_rows_bytes_' and charged to mem_tracker().
+  std::vector<bool> skew_matched_probe_rows_;
+  int64_t skew_matched_probe_rows_bytes_ = 0;
+
+  /// Index in the probe stream of 'input_partition_' of the first row of 'probe_batch_'.
+  /// Only used if 'probing_skew_chunk_' is true.
+  int64_t skew_probe_batch_offset_ = 0;
+
   /// Used by OutputAllBuild() to iterate over the entire build side tuple stream of the
   /// current partition. Only used when probe_state_ is OUTPUTTING_UNMATCHED.
   std::unique_ptr<RowBatch> output_unmatched_batch_;
@@ -690,9 +728,10 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
 
     /// Prepare to read the probe rows. Allocates the first read block, so reads will
     /// not fail with out of memory if this succeeds. Returns an error if the first read
-    /// block cannot be acquired. "delete_on_read" mode is used, so the blocks backing
-    /// the buffered tuple stream will be destroyed after reading.
-    Status PrepareForRead() WARN_UNUSED_RESULT;
+    /// block cannot be acquired. If 'delete_on_read' is true, the blocks backing the
+    /// buffered tuple stream will be destroyed after reading. Otherwise the rows can be
+    /// read again, which is needed to probe each chunk of a skewed build partition.
+    Status PrepareForRead(bool delete_on_read = true) WARN_UNUSED_RESULT;
 
     /// Close the partition and attach resources to 'batch' if non-NULL or free the
     /// resources if 'batch' is NULL. Idempotent.
@@ -700,6 +739,9 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
 
     BufferedTupleStream* ALWAYS_INLINE probe_rows() { return probe_rows_.get(); }
     PhjBuilderPartition* build_partition() { return build_partition_; }
+    void set_build_partition(PhjBuilderPartition* build_partition) {
+      build_partition_ = build_partition;
+    }
 
     inline bool IsClosed() const { return probe_rows_ == NULL; }
 
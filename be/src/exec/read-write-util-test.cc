@@ -119,5 +119,54 @@ TEST(ReadWriteUtil, ZeroCompressedLong) {
   TestPutGetZeroCompressedLong(0x8000000000000000);
 }
 
+// Checks that 'val' is read back from its zig-zag encoding, which is followed by
+// 'num_padding_bytes' bytes with all bits set, and that truncated encodings are errors.
+void TestPutReadZLong(int64_t val, int num_padding_bytes) {
+  uint8_t buffer[ReadWriteUtil::MAX_ZLONG_LEN + 16];
+  int len = ReadWriteUtil::PutZLong(val, buffer);
+  memset(buffer + len, 0xff, num_padding_bytes);
+  uint8_t* buf = buffer;
+  ReadWriteUtil::ZLongResult r =
+      ReadWriteUtil::ReadZLong(&buf, buffer + len + num_padding_bytes);
+  ASSERT_TRUE(r.ok) << val;
+  EXPECT_EQ(val, r.val);
+  EXPECT_EQ(buffer + len, buf) << val;
+
+  buf = buffer;
+  EXPECT_FALSE(ReadWriteUtil::ReadZLong(&buf, buffer + len - 1).ok) << val;
+
+  if (val < numeric_limits<int32_t>::min() || val > numeric_limits<int32_t>::max()) {
+    return;
+  }
+  buf = buffer;
+  ReadWriteUtil::ZIntResult ri =
+      ReadWriteUtil::ReadZInt(&buf, buffer + len + num_padding_bytes);
+  ASSERT_TRUE(ri.ok) << val;
+  EXPECT_EQ(val, ri.val);
+  EXPECT_EQ(buffer + len, buf) << val;
+}
+
+TEST(ReadWriteUtil, ZigZag) {
+  // Values of every encoded length, read with and without enough bytes after them for
+  // the word-at-a-time decoding.
+  for (int num_padding_bytes : {0, 16}) {
+    for (int shift = 0; shift < 64; ++shift) {
+      int64_t val = static_cast<int64_t>(1ULL << shift);
+      for (int64_t v : {val, val - 1, -val, -val + 1}) {
+        TestPutReadZLong(v, num_padding_bytes);
+      }
+    }
+    TestPutReadZLong(numeric_limits<int64_t>::max(), num_padding_bytes);
+    TestPutReadZLong(numeric_limits<int64_t>::min(), num_padding_bytes);
+  }
+
+  // Ints of more than 5 bytes and longs of more than 10 bytes are errors.
+  uint8_t buffer[16];
+  memset(buffer, 0x80, sizeof(buffer));
+  uint8_t* buf = buffer;
+  EXPECT_FALSE(ReadWriteUtil::ReadZInt(&buf, buffer + sizeof(buffer)).ok);
+  buf = buffer;
+  EXPECT_FALSE(ReadWriteUtil::ReadZLong(&buf, buffer + sizeof(buffer)).ok);
 }
 
+}
@@ -17,23 +17,28 @@
 
 #include "exec/read-write-util.h"
 
+#include <cstring>
+
 #include "common/names.h"
 
 using namespace impala;
 
 namespace {
 
-// Returns MAX_ZLONG_LEN + 1 if the encoded int is more than MAX_ZLONG_LEN bytes long,
-// otherwise returns the length of the encoded int. Reads MAX_ZLONG_LEN bytes in 'buf'.
-int FindZIntegerLength(uint8_t* buf) {
-  uint64_t x = *reinterpret_cast<uint64_t*>(buf);
-  for (int i = 0; i < sizeof(x); ++i) {
-    if ((x & (0x80LL << (i * 8))) == 0) return i + 1;
-  }
-  uint16_t y = *reinterpret_cast<uint16_t*>(buf + 8);
-  if ((y & 0x80) == 0) return 9;
-  if ((y & 0x8000) == 0) return 10;
-  return 11;
+// The continuation bits of the bytes of a word. The encoding of a zig-zag integer ends
+// with the first byte without a continuation bit.
+constexpr uint64_t ZINTEGER_CONTINUATION_BITS = 0x8080808080808080ULL;
+
+// Concatenates the low 7 bits of the 8 bytes of 'x', from the lowest to the highest
+// byte, into a 56 bit integer. Instead of shifting each byte into place, the groups of
+// bits are merged pairwise into groups of 14, 28 and then 56 bits, which takes a
+// constant number of instructions regardless of the number of bytes.
+inline uint64_t CompactZIntegerBytes(uint64_t x) {
+  x &= ~ZINTEGER_CONTINUATION_BITS;
+  x = ((x & 0x7f007f007f007f00ULL) >> 1) | (x & 0x007f007f007f007fULL);
+  x = ((x & 0x3fff00003fff0000ULL) >> 2) | (x & 0x00003fff00003fffULL);
+  x = ((x & 0x0fffffff00000000ULL) >> 4) | (x & 0x000000000fffffffULL);
+  return x;
 }
 
 // Slow path for ReadZInteger() that checks for out-of-bounds on every byte
@@ -64,22 +69,22 @@ template <int MAX_LEN, typename ZResultType>
 ZResultType ReadWriteUtil::ReadZInteger(uint8_t** buf, uint8_t* buf_end) {
   DCHECK(MAX_LEN == MAX_ZINT_LEN || MAX_LEN == MAX_ZLONG_LEN);
 
-  // Use MAX_ZLONG_LEN rather than MAX_LEN since FindZIntegerLength() always assumes at
-  // least MAX_ZLONG_LEN bytes in buffer.
   if (UNLIKELY(buf_end - *buf < MAX_ZLONG_LEN)) {
     return ReadZIntegerSlow<MAX_LEN, ZResultType>(buf, buf_end);
   }
   // Once we get here, we don't need to worry about going off end of buffer.
-  int num_bytes = FindZIntegerLength(*buf);
-  if (UNLIKELY(num_bytes > MAX_LEN)) return ZResultType::error();
-
-  uint64_t zlong = 0;
-  int shift = 0;
-  for (int i = 0; i < num_bytes; ++i) {
-    zlong |= static_cast<uint64_t>(**buf & 0x7f) << shift;
-    shift += 7;
-    ++(*buf);
+  uint64_t word;
+  memcpy(&word, *buf, sizeof(word));
+  uint64_t stop_bits = ~word & ZINTEGER_CONTINUATION_BITS;
+  // Integers of more than 8 bytes are rare, i.e. only longs with the highest bits set.
+  if (UNLIKELY(stop_bits == 0)) {
+    return ReadZIntegerSlow<MAX_LEN, ZResultType>(buf, buf_end);
   }
+  int num_bytes = BitUtil::CountTrailingZeros(stop_bits) / 8 + 1;
+  if (UNLIKELY(num_bytes > MAX_LEN)) return ZResultType::error();
+  // Clear the bytes after the last byte of the integer, i.e. the bits above its stop bit.
+  uint64_t zlong = CompactZIntegerBytes(word & (stop_bits ^ (stop_bits - 1)));
+  *buf += num_bytes;
   return ZResultType((zlong >> 1) ^ -(zlong & 1));
 }
 
@@ -216,10 +216,16 @@ bool ScanNode::WaitForRuntimeFilters() {
   }
   vector<string> arrived_filter_ids;
   vector<string> missing_filter_ids;
+  vector<string> skipped_filter_ids;
   int32_t max_arrival_delay = 0;
   int64_t start = MonotonicMillis();
-  for (auto& ctx: filter_ctxs_) {
+  for (int i = 0; i < filter_ctxs_.size(); ++i) {
+    const FilterContext& ctx = filter_ctxs_[i];
     string filter_id = Substitute("$0", ctx.filter->id());
+    if (!ctx.filter->HasFilter() && SkipWaitForFilter(i)) {
+      skipped_filter_ids.push_back(filter_id);
+      continue;
+    }
     if (ctx.filter->WaitForArrival(wait_time_ms)) {
       arrived_filter_ids.push_back(filter_id);
     } else {
@@ -231,7 +237,12 @@ bool ScanNode::WaitForRuntimeFilters() {
   const string& wait_time = PrettyPrinter::Print(end - start, TUnit::TIME_MS);
   const string& arrival_delay = PrettyPrinter::Print(max_arrival_delay, TUnit::TIME_MS);
 
-  if (arrived_filter_ids.size() == filter_ctxs_.size()) {
+  if (!skipped_filter_ids.empty()) {
+    runtime_profile()->AddInfoString("Runtime filters not waited for",
+        Substitute("Filters that were ineffective in past scans: [$0]",
+            join(skipped_filter_ids, ", ")));
+  }
+  if (missing_filter_ids.empty()) {
     runtime_profile()->AddInfoString("Runtime filters",
         Substitute("All filters arrived. Waited $0. Maximum arrival delay: $1.",
                                          wait_time, arrival_delay));
@@ -189,10 +189,15 @@ class ScanNode : public ExecNode {
 
   /// Waits for runtime filters to arrive, checking every 20ms. Max wait time is specified
   /// by the 'runtime_filter_wait_time_ms' flag, which is overridden by the query option
-  /// of the same name. The wait starts from when this function is called. Returns
-  /// true if all filters arrived within the time limit, false otherwise.
+  /// of the same name. The wait starts from when this function is called. Filters for
+  /// which SkipWaitForFilter() returns true are not waited for. Returns true if all
+  /// other filters arrived within the time limit, false otherwise.
   bool WaitForRuntimeFilters();
 
+  /// Returns true if WaitForRuntimeFilters() should not wait for the arrival of the
+  /// filter in 'filter_ctxs_[filter_idx]'.
+  virtual bool SkipWaitForFilter(int filter_idx) const { return false; }
+
   /// Additional state only used by multi-threaded scan node implementations.
   /// The lifecycle is as follows:
   /// 1. Prepare() is called.
@@ -247,6 +247,19 @@ Status ScannerContext::Stream::GetBuffer(bool peek, uint8_t** out_buffer, int64_
   return Status::OK();
 }
 
+Status ScannerContext::Stream::TakeBuffer(unique_ptr<BufferDescriptor>* io_buffer,
+    uint8_t** out_buffer, int64_t* len) {
+  io_buffer->reset();
+  bool from_io_buffer = boundary_buffer_bytes_left_ == 0;
+  RETURN_IF_ERROR(GetBuffer(false, out_buffer, len));
+  if (from_io_buffer && *len > 0 && io_buffer_bytes_left_ == 0) {
+    DCHECK(io_buffer_ != nullptr);
+    *io_buffer = move(io_buffer_);
+    io_buffer_pos_ = nullptr;
+  }
+  return Status::OK();
+}
+
 Status ScannerContext::Stream::GetBytesInternal(int64_t requested_len,
     uint8_t** out_buffer, bool peek, int64_t* out_len) {
   DCHECK_GT(requested_len, boundary_buffer_bytes_left_);
@@ -124,6 +124,15 @@ class ScannerContext {
     /// If we are past the end of the scan range, no bytes are returned.
     Status GetBuffer(bool peek, uint8_t** buffer, int64_t* out_len);
 
+    /// Like GetBuffer() with 'peek' set to false, but if the bytes are the rest of the
+    /// current I/O buffer, the ownership of the I/O buffer is transferred to the caller
+    /// in 'io_buffer'. The caller must return it with ScanRange::ReturnBuffer() once it
+    /// is done with the bytes, which can be done from any thread. Otherwise, e.g. if the
+    /// bytes come from the boundary buffer, 'io_buffer' is set to nullptr and the bytes
+    /// are only valid until the next read from the stream.
+    Status TakeBuffer(std::unique_ptr<io::BufferDescriptor>* io_buffer, uint8_t** buffer,
+        int64_t* out_len);
+
     /// Callback that returns the buffer size to use when reading past the end of the scan
     /// range. Reading past the end of the scan range is likely a remote read, so we want
     /// find a good trade-off between io requests and data volume. Scanners that have
@@ -70,10 +70,14 @@ void TextConverter::UnescapeString(const char* src, char* dest, int* len,
 // define i1 @WriteSlot(<{ i32, i8 }>* %tuple_arg, i8* %data, i32 %len) #38 {
 // entry:
 //   %parse_result = alloca i32
+//   %data_is_null = icmp eq i8* %data, null
+//   br i1 %data_is_null, label %set_null, label %check_null_string
+//
+// check_null_string:                                ; preds = %entry
 //   %0 = call i1 @IrIsNullString(i8* %data, i32 %len)
 //   br i1 %0, label %set_null, label %check_zero
 //
-// set_null:                                         ; preds = %check_zero, %entry
+// set_null:                              ; preds = %check_zero, %check_null_string, %entry
 //   %1 = bitcast <{ i32, i8 }>* %tuple_arg to i8*
 //   %null_byte_ptr2 = getelementptr inbounds i8, i8* %1, i32 4
 //   %null_byte3 = load i8, i8* %null_byte_ptr2
@@ -88,7 +92,7 @@ void TextConverter::UnescapeString(const char* src, char* dest, int* len,
 //   %failed = icmp eq i32 %parse_result1, 1
 //   br i1 %failed, label %parse_fail, label %parse_success
 //
-// check_zero:                                       ; preds = %entry
+// check_zero:                                       ; preds = %check_null_string
 //   %3 = icmp eq i32 %len, 0
 //   br i1 %3, label %set_null, label %parse_slot
 //
@@ -148,7 +152,15 @@ Status TextConverter::CodegenWriteSlot(LlvmCodeGen* codegen,
     check_zero_block = llvm::BasicBlock::Create(codegen->context(), "check_zero", *fn);
   }
 
+  // A null 'data' pointer marks a missing field, e.g. a JSON field that is absent or
+  // null. It is NULL regardless of the slot type.
+  llvm::BasicBlock* check_null_string_block =
+      llvm::BasicBlock::Create(codegen->context(), "check_null_string", *fn);
+  llvm::Value* data_is_null = builder.CreateIsNull(args[1], "data_is_null");
+  builder.CreateCondBr(data_is_null, set_null_block, check_null_string_block);
+
   // Check if the data matches the configured NULL string.
+  builder.SetInsertPoint(check_null_string_block);
   llvm::Value* is_null;
   if (check_null) {
     if (is_default_null) {
@@ -337,7 +349,7 @@ Status TextConverter::CodegenWriteSlot(LlvmCodeGen* codegen,
     builder.CreateRet(codegen->false_value());
   }
 
-  // Case where data is \N or len == 0 and it is not a string col
+  // Case where data is missing, \N or len == 0 and it is not a string col
   builder.SetInsertPoint(set_null_block);
   slot_desc->CodegenSetNullIndicator(codegen, &builder, args[0], codegen->true_value());
   builder.CreateRet(codegen->true_value());
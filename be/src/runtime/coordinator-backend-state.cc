@@ -154,6 +154,8 @@ void Coordinator::BackendState::SetRpcParams(const DebugOptions& debug_options,
     UniqueIdPBToTUniqueId(params.instance_id(), &instance_ctx.fragment_instance_id);
     instance_ctx.per_fragment_instance_idx = params.per_fragment_instance_idx();
     *instance_ctx_pb->mutable_per_node_scan_ranges() = params.per_node_scan_ranges();
+    *instance_ctx_pb->mutable_dynamic_scan_range_nodes() =
+        params.dynamic_scan_range_nodes();
     for (const auto& entry : fragment_exec_params.per_exch_num_senders()) {
       instance_ctx.per_exch_num_senders[entry.first] = entry.second;
     }
@@ -498,6 +500,7 @@ bool Coordinator::BackendState::ApplyExecStatusReport(
   backend_utilization_.cpu_user_ns = backend_exec_status.cpu_user_ns();
   backend_utilization_.cpu_sys_ns = backend_exec_status.cpu_sys_ns();
   backend_utilization_.bytes_read = backend_exec_status.bytes_read();
+  backend_utilization_.scan_time_ns = backend_exec_status.scan_time_ns();
   backend_utilization_.exchange_bytes_sent = backend_exec_status.exchange_bytes_sent();
   backend_utilization_.scan_bytes_sent = backend_exec_status.scan_bytes_sent();
   std::map<int32_t, int64_t> per_join_rows_produced(
@@ -70,7 +70,9 @@ class Coordinator::FilterState {
   }
 
   BloomFilterPB& bloom_filter() { return bloom_filter_; }
+  const BloomFilterPB& bloom_filter() const { return bloom_filter_; }
   std::string& bloom_filter_directory() { return bloom_filter_directory_; }
+  int64_t bloom_filter_ndv() const { return bloom_filter_ndv_; }
   MinMaxFilterPB& min_max_filter() { return min_max_filter_; }
   std::vector<FilterTarget>* targets() { return &targets_; }
   const std::vector<FilterTarget>& targets() const { return targets_; }
@@ -112,6 +114,16 @@ class Coordinator::FilterState {
   /// Release consumed memory of this filter. Caller must hold `lock_` and make sure
   /// filter already disabled.
   void Release(MemTracker* tracker);
+  /// Estimates the number of distinct values in the aggregated Bloom filter and folds
+  /// it down to the smallest size that meets the target false positive probability,
+  /// see RuntimeFilterBank::GetFoldedLogSpace(). Releases the saved memory from
+  /// 'tracker'. Must only be called once no more updates are applied and before
+  /// CompressBloomFilter().
+  void FoldBloomFilter(const TQueryOptions& query_options, MemTracker* tracker);
+  /// Replaces the aggregated Bloom filter directory with its compressed form if
+  /// BloomFilter::CompressDirectory() deems it worthwhile, and releases the saved
+  /// memory from 'tracker'. Must only be called once no more updates are applied.
+  void CompressBloomFilter(MemTracker* tracker);
 
   void IncrementNumInflightRpcs(int i) {
     num_inflight_publish_filter_rpcs_ += i;
@@ -142,8 +154,12 @@ class Coordinator::FilterState {
   /// the filter is moved from the following member to the output structure.
   BloomFilterPB bloom_filter_;
   /// When the filter is a Bloom filter, we use this string to store the contents of the
-  /// aggregated Bloom filter.
+  /// aggregated Bloom filter. Once aggregation is complete, this may hold the compressed
+  /// directory, as indicated by 'bloom_filter_.directory_compression'.
   std::string bloom_filter_directory_;
+  /// Number of distinct values in the aggregated Bloom filter as estimated by
+  /// FoldBloomFilter(), or -1 if not estimated.
+  int64_t bloom_filter_ndv_ = -1;
   MinMaxFilterPB min_max_filter_;
 
   /// Time at which first local filter arrived.
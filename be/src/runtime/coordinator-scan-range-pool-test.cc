@@ -0,0 +1,126 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/coordinator-scan-range-pool.h"
+
+#include "testutil/gtest-util.h"
+#include "util/network-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+class ScanRangePoolTest : public testing::Test {
+ protected:
+  /// Holds back 'num_ranges' ranges of scan node 'node_id' that were assigned to 'host'.
+  /// The offset of each range identifies it.
+  void AddHeldBackRanges(QuerySchedulePB* schedule, int node_id,
+      const NetworkAddressPB& host, int num_ranges, int first_offset) {
+    HeldBackScanRangesPB* held_back = schedule->add_held_back_scan_ranges();
+    held_back->set_node_id(node_id);
+    *held_back->mutable_host() = host;
+    for (int i = 0; i < num_ranges; ++i) {
+      ScanRangeParamsPB* range = held_back->add_scan_ranges();
+      range->mutable_scan_range()->mutable_hdfs_file_split()->set_offset(first_offset + i);
+      range->set_is_remote(false);
+      range->set_volume_id(0);
+    }
+  }
+
+  static ScanRangeRequestPB MakeRequest(int num_wanted, int64_t num_received) {
+    ScanRangeRequestPB request;
+    request.set_num_ranges_wanted(num_wanted);
+    request.set_num_ranges_received(num_received);
+    return request;
+  }
+
+  static int64_t Offset(const ScanRangeParamsPB& range) {
+    return range.scan_range().hdfs_file_split().offset();
+  }
+
+  NetworkAddressPB host1_ = MakeNetworkAddressPB("host1", 27000);
+  NetworkAddressPB host2_ = MakeNetworkAddressPB("host2", 27000);
+};
+
+/// Backends first receive the ranges held back from them, then ranges of other backends
+/// as remote reads.
+TEST_F(ScanRangePoolTest, PrefersLocalRanges) {
+  QuerySchedulePB schedule;
+  AddHeldBackRanges(&schedule, 0, host1_, 2, 100);
+  AddHeldBackRanges(&schedule, 0, host2_, 3, 200);
+  ScanRangePool pool(schedule);
+  EXPECT_FALSE(pool.empty());
+
+  ScanRangeGrantPB grant;
+  pool.GrantScanRanges(0, host1_, 0, MakeRequest(3, 0), &grant);
+  ASSERT_EQ(grant.scan_ranges_size(), 3);
+  EXPECT_EQ(grant.first_range_idx(), 0);
+  EXPECT_EQ(Offset(grant.scan_ranges(0)), 100);
+  EXPECT_FALSE(grant.scan_ranges(0).is_remote());
+  EXPECT_EQ(Offset(grant.scan_ranges(1)), 101);
+  EXPECT_EQ(Offset(grant.scan_ranges(2)), 202);
+  EXPECT_TRUE(grant.scan_ranges(2).is_remote());
+  EXPECT_EQ(grant.scan_ranges(2).volume_id(), -1);
+  EXPECT_FALSE(grant.no_more_ranges());
+
+  grant.Clear();
+  pool.GrantScanRanges(1, host2_, 0, MakeRequest(5, 0), &grant);
+  ASSERT_EQ(grant.scan_ranges_size(), 2);
+  EXPECT_EQ(Offset(grant.scan_ranges(0)), 200);
+  EXPECT_EQ(Offset(grant.scan_ranges(1)), 201);
+  EXPECT_TRUE(grant.no_more_ranges());
+}
+
+/// Ranges that a backend did not acknowledge are granted again, before any new ranges.
+TEST_F(ScanRangePoolTest, ResendsUnacknowledgedRanges) {
+  QuerySchedulePB schedule;
+  AddHeldBackRanges(&schedule, 0, host1_, 4, 100);
+  ScanRangePool pool(schedule);
+
+  ScanRangeGrantPB grant;
+  pool.GrantScanRanges(0, host1_, 0, MakeRequest(2, 0), &grant);
+  ASSERT_EQ(grant.scan_ranges_size(), 2);
+
+  // The response was lost: the backend still reports 0 received ranges.
+  grant.Clear();
+  pool.GrantScanRanges(0, host1_, 0, MakeRequest(3, 0), &grant);
+  EXPECT_EQ(grant.first_range_idx(), 0);
+  ASSERT_EQ(grant.scan_ranges_size(), 3);
+  EXPECT_EQ(Offset(grant.scan_ranges(0)), 100);
+  EXPECT_EQ(Offset(grant.scan_ranges(1)), 101);
+  EXPECT_EQ(Offset(grant.scan_ranges(2)), 102);
+
+  grant.Clear();
+  pool.GrantScanRanges(0, host1_, 0, MakeRequest(3, 3), &grant);
+  EXPECT_EQ(grant.first_range_idx(), 3);
+  ASSERT_EQ(grant.scan_ranges_size(), 1);
+  EXPECT_EQ(Offset(grant.scan_ranges(0)), 103);
+  EXPECT_TRUE(grant.no_more_ranges());
+}
+
+/// Requests for scan nodes without held back ranges are answered with no more ranges.
+TEST_F(ScanRangePoolTest, UnknownNode) {
+  QuerySchedulePB schedule;
+  ScanRangePool pool(schedule);
+  EXPECT_TRUE(pool.empty());
+  ScanRangeGrantPB grant;
+  pool.GrantScanRanges(0, host1_, 3, MakeRequest(2, 0), &grant);
+  EXPECT_EQ(grant.scan_ranges_size(), 0);
+  EXPECT_TRUE(grant.no_more_ranges());
+}
+
+}
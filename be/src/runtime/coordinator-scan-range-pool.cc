@@ -0,0 +1,88 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/coordinator-scan-range-pool.h"
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+ScanRangePool::ScanRangePool(const QuerySchedulePB& query_schedule) {
+  for (const HeldBackScanRangesPB& held_back : query_schedule.held_back_scan_ranges()) {
+    NodeRanges& node_ranges = nodes_[held_back.node_id()];
+    deque<ScanRangeParamsPB>& host_ranges = node_ranges.per_host[held_back.host()];
+    for (const ScanRangeParamsPB& range : held_back.scan_ranges()) {
+      host_ranges.push_back(range);
+    }
+    node_ranges.num_remaining += held_back.scan_ranges_size();
+  }
+}
+
+ScanRangeParamsPB ScanRangePool::TakeRange(
+    const NetworkAddressPB& host, NodeRanges* node_ranges) {
+  DCHECK_GT(node_ranges->num_remaining, 0);
+  --node_ranges->num_remaining;
+  auto local_it = node_ranges->per_host.find(host);
+  if (local_it != node_ranges->per_host.end() && !local_it->second.empty()) {
+    ScanRangeParamsPB range = move(local_it->second.front());
+    local_it->second.pop_front();
+    return range;
+  }
+  // Take from the backend that is furthest from being done with its held back ranges.
+  deque<ScanRangeParamsPB>* victim = nullptr;
+  for (auto& entry : node_ranges->per_host) {
+    if (victim == nullptr || entry.second.size() > victim->size()) {
+      victim = &entry.second;
+    }
+  }
+  DCHECK(victim != nullptr && !victim->empty());
+  ScanRangeParamsPB range = move(victim->back());
+  victim->pop_back();
+  range.set_is_remote(true);
+  range.set_volume_id(-1);
+  return range;
+}
+
+void ScanRangePool::GrantScanRanges(int backend_idx, const NetworkAddressPB& host,
+    TPlanNodeId node_id, const ScanRangeRequestPB& request, ScanRangeGrantPB* grant) {
+  lock_guard<mutex> l(lock_);
+  vector<ScanRangeParamsPB>& granted = granted_[make_pair(backend_idx, node_id)];
+  int64_t num_granted = granted.size();
+  int64_t num_received = request.num_ranges_received();
+  DCHECK_LE(num_received, num_granted);
+  num_received = min(num_received, num_granted);
+  grant->set_first_range_idx(num_received);
+  for (int64_t i = num_received; i < num_granted; ++i) {
+    *grant->add_scan_ranges() = granted[i];
+  }
+  auto node_it = nodes_.find(node_id);
+  if (node_it == nodes_.end()) {
+    grant->set_no_more_ranges(true);
+    return;
+  }
+  NodeRanges* node_ranges = &node_it->second;
+  while (grant->scan_ranges_size() < request.num_ranges_wanted()
+      && node_ranges->num_remaining > 0) {
+    granted.push_back(TakeRange(host, node_ranges));
+    *grant->add_scan_ranges() = granted.back();
+  }
+  grant->set_no_more_ranges(node_ranges->num_remaining == 0);
+}
+
+}
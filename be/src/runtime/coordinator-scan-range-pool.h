@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/global-types.h"
+#include "gen-cpp/admission_control_service.pb.h"
+#include "gen-cpp/control_service.pb.h"
+#include "util/container-util.h"
+
+namespace impala {
+
+/// Scan ranges that the scheduler held back (QuerySchedulePB.held_back_scan_ranges) and
+/// that the coordinator hands out while the query runs. Backends whose scans have spare
+/// capacity request ranges in their status reports (ReportExecStatusRequestPB.
+/// scan_range_requests) and receive them in the response, so that backends that finish
+/// their assigned ranges early take over work that a slow backend would otherwise do.
+///
+/// A backend is preferably given the ranges that the scheduler originally assigned to
+/// it, which preserves the locality of the assignment. Only once those are exhausted it
+/// receives ranges held back from the backend with the most remaining ranges; these are
+/// marked as remote reads.
+///
+/// All ranges granted to a backend are remembered so that ranges in a response that
+/// never reached the backend are granted again: each request acknowledges the number
+/// of ranges the backend has received so far.
+///
+/// Thread-safe.
+class ScanRangePool {
+ public:
+  explicit ScanRangePool(const QuerySchedulePB& query_schedule);
+
+  /// Returns true if the schedule did not hold back any scan ranges.
+  bool empty() const { return nodes_.empty(); }
+
+  /// Handles 'request' for scan node 'node_id' from the backend with index 'backend_idx'
+  /// and address 'host'. Fills 'grant' with the ranges the backend has not acknowledged
+  /// yet, followed by new ranges up to the number of ranges wanted.
+  void GrantScanRanges(int backend_idx, const NetworkAddressPB& host,
+      TPlanNodeId node_id, const ScanRangeRequestPB& request, ScanRangeGrantPB* grant);
+
+ private:
+  struct NodeRanges {
+    /// Remaining ranges, keyed by the backend they were originally assigned to.
+    std::unordered_map<NetworkAddressPB, std::deque<ScanRangeParamsPB>> per_host;
+    int64_t num_remaining = 0;
+  };
+
+  /// Removes the next range for 'host' from 'node_ranges'. Must have remaining ranges.
+  ScanRangeParamsPB TakeRange(const NetworkAddressPB& host, NodeRanges* node_ranges);
+
+  /// Protects all members below.
+  std::mutex lock_;
+
+  /// Scan node id => ranges held back for that node.
+  std::map<TPlanNodeId, NodeRanges> nodes_;
+
+  /// (backend index, scan node id) => all ranges granted so far, in order.
+  std::map<std::pair<int, TPlanNodeId>, std::vector<ScanRangeParamsPB>> granted_;
+};
+
+}
@@ -40,6 +40,7 @@
 #include "kudu/rpc/rpc_sidecar.h"
 #include "runtime/coordinator-backend-state.h"
 #include "runtime/coordinator-filter-state.h"
+#include "runtime/coordinator-scan-range-pool.h"
 #include "runtime/debug-options.h"
 #include "runtime/exec-env.h"
 #include "runtime/fragment-instance-state.h"
@@ -48,7 +49,9 @@
 #include "runtime/query-exec-mgr.h"
 #include "runtime/query-state.h"
 #include "runtime/raw-value.h"
+#include "runtime/runtime-filter-bank.h"
 #include "scheduling/admission-control-client.h"
+#include "scheduling/executor-scan-model.h"
 #include "scheduling/scheduler.h"
 #include "service/client-request-state.h"
 #include "service/frontend.h"
@@ -59,6 +62,7 @@
 #include "util/histogram-metric.h"
 #include "util/kudu-status-util.h"
 #include "util/min-max-filter.h"
+#include "util/network-util.h"
 #include "util/pretty-printer.h"
 #include "util/table-printer.h"
 #include "util/uid-util.h"
@@ -165,6 +169,10 @@ Status Coordinator::Exec() {
   const string& str = Substitute("Query $0", PrintId(query_id()));
   progress_.Init(str, exec_params_.query_schedule().num_scan_ranges());
 
+  if (exec_params_.query_schedule().held_back_scan_ranges_size() > 0) {
+    scan_range_pool_.reset(new ScanRangePool(exec_params_.query_schedule()));
+  }
+
   query_state_ = ExecEnv::GetInstance()->query_exec_mgr()->CreateQueryState(
       query_ctx(), exec_params_.query_schedule().coord_backend_mem_limit());
   filter_mem_tracker_ = query_state_->obj_pool()->Add(new MemTracker(
@@ -357,6 +365,13 @@ void Coordinator::InitFilterRoutingTable() {
       << "InitFilterRoutingTable() called after table marked as complete";
 
   lock_guard<shared_mutex> lock(filter_routing_table_->lock); // Exclusive lock.
+  unordered_map<int, BackendState*> instance_to_backend;
+  for (BackendState* backend_state : backend_states_) {
+    for (const FInstanceExecParamsPB& instance_params :
+        backend_state->exec_params().instance_params()) {
+      instance_to_backend[GetInstanceIdx(instance_params.instance_id())] = backend_state;
+    }
+  }
   for (const FragmentExecParamsPB& fragment_params :
       exec_params_.query_schedule().fragment_exec_params()) {
     int num_instances = fragment_params.instances_size();
@@ -373,8 +388,8 @@ void Coordinator::InitFilterRoutingTable() {
         // The join node ID is used to identify the join that produces the filter, even
         // though the builder is separate from the actual node.
         DCHECK_EQ(filter.src_node_id, join_sink.dest_node_id);
-        AddFilterSource(
-            fragment_params, num_instances, num_backends, filter, filter.src_node_id);
+        AddFilterSource(fragment_params, num_instances, num_backends, filter,
+            filter.src_node_id, instance_to_backend);
       }
     }
     for (const TPlanNode& plan_node : fragment->plan.nodes) {
@@ -385,8 +400,8 @@ void Coordinator::InitFilterRoutingTable() {
         // a filter consumer.
         if (plan_node.__isset.join_node &&
             plan_node.join_node.__isset.hash_join_node) {
-          AddFilterSource(
-              fragment_params, num_instances, num_backends, filter, plan_node.node_id);
+          AddFilterSource(fragment_params, num_instances, num_backends, filter,
+              plan_node.node_id, instance_to_backend);
         } else if (plan_node.__isset.hdfs_scan_node || plan_node.__isset.kudu_scan_node) {
           FilterState* f = filter_routing_table_->GetOrCreateFilterState(filter);
           auto it = filter.planid_to_target_ndx.find(plan_node.node_id);
@@ -411,7 +426,7 @@ void Coordinator::InitFilterRoutingTable() {
 
 void Coordinator::AddFilterSource(const FragmentExecParamsPB& src_fragment_params,
     int num_instances, int num_backends, const TRuntimeFilterDesc& filter,
-    int join_node_id) {
+    int join_node_id, const unordered_map<int, BackendState*>& instance_to_backend) {
   FilterState* f = filter_routing_table_->GetOrCreateFilterState(filter);
   // Set the 'pending_count_' to zero to indicate that for a filter with
   // local-only targets the coordinator does not expect to receive any filter
@@ -447,12 +462,54 @@ void Coordinator::AddFilterSource(const FragmentExecParamsPB& src_fragment_param
     random_shuffle(src_idxs.begin(), src_idxs.end());
     src_idxs.resize(MAX_BROADCAST_FILTER_PRODUCERS);
   }
+  // Backends producing the filter, in the order of their first instance, and the
+  // aggregation settings for the instances on each backend.
+  vector<BackendState*> src_backends;
+  unordered_map<BackendState*, TRuntimeFilterSource> backend_filter_src;
   for (int src_idx : src_idxs) {
+    auto it = instance_to_backend.find(src_idx);
+    DCHECK(it != instance_to_backend.end());
     TRuntimeFilterSource filter_src;
     filter_src.src_node_id = join_node_id;
     filter_src.filter_id = filter.filter_id;
+    if (backend_filter_src.emplace(it->second, filter_src).second) {
+      src_backends.push_back(it->second);
+    }
+  }
+
+  int fanout = exec_params_.query_options().runtime_filter_aggregation_fanout;
+  int num_src_backends = src_backends.size();
+  if (!filter.is_broadcast_join && filter.has_remote_targets && fanout >= 2
+      && num_src_backends > fanout) {
+    // Each group of up to 'fanout' backends sends its filters to the first backend of
+    // the group, which sends one aggregated filter to the coordinator. The pending count
+    // stays one per backend: aggregated updates count for the backends they merge, so
+    // that updates which an aggregator rejected can be sent to the coordinator directly.
+    int num_groups = 0;
+    for (int begin = 0; begin < num_src_backends; begin += fanout) {
+      int end = min(begin + fanout, num_src_backends);
+      BackendState* aggregator = src_backends[begin];
+      TRuntimeFilterAggDesc agg_desc;
+      agg_desc.krpc_hostname = aggregator->impalad_address().hostname();
+      agg_desc.krpc_address = FromNetworkAddressPB(aggregator->krpc_impalad_address());
+      if (end - begin > 1) {
+        backend_filter_src[aggregator].__set_num_remote_updates(end - begin - 1);
+      }
+      for (int i = begin + 1; i < end; ++i) {
+        backend_filter_src[src_backends[i]].__set_aggregator(agg_desc);
+      }
+      ++num_groups;
+    }
+    VLOG_QUERY << "Filter " << filter.filter_id << " is aggregated by " << num_groups
+               << " intermediate aggregators for " << num_src_backends
+               << " producing backends (query_id=" << PrintId(query_id()) << ")";
+    f->set_pending_count(num_src_backends);
+  }
+
+  for (int src_idx : src_idxs) {
+    BackendState* backend_state = instance_to_backend.at(src_idx);
     filter_routing_table_->finstance_filters_produced[src_idx].emplace_back(
-        filter_src);
+        backend_filter_src[backend_state]);
   }
   f->set_num_producers(src_idxs.size());
 }
@@ -635,10 +692,17 @@ string Coordinator::FilterDebugString() {
 
     // Add size and fpp for bloom filters.
     if (state.is_bloom_filter()) {
+      // Once the filter was aggregated, show its (possibly folded) actual size and the
+      // fpp for the NDV it actually holds rather than the planner's estimates.
       int64_t filter_size = state.desc().filter_size_bytes;
+      int64_t ndv = state.desc().ndv_estimate;
+      if (state.bloom_filter_ndv() >= 0) {
+        filter_size = 1LL << state.bloom_filter().log_bufferpool_space();
+        ndv = state.bloom_filter_ndv();
+      }
       row.push_back(PrettyPrinter::Print(filter_size, TUnit::BYTES));
-      double fpp = BloomFilter::FalsePositiveProb(
-          state.desc().ndv_estimate, BitUtil::Log2Ceiling64(filter_size));
+      double fpp =
+          BloomFilter::FalsePositiveProb(ndv, BitUtil::Log2Ceiling64(filter_size));
       stringstream ss;
       ss << setprecision(3) << fpp;
       row.push_back(ss.str());
@@ -782,7 +846,7 @@ void Coordinator::HandleExecStateTransition(
   } else {
     CancelBackends(/*fire_and_forget=*/ true);
   }
-  ReleaseQueryAdmissionControlResources();
+  ReleaseQueryAdmissionControlResources(new_state == ExecState::RETURNED_RESULTS);
   // Once the query has released its admission control resources, update its end time.
   parent_request_state_->UpdateEndTime();
   // Can compute summary only after we stop accepting reports from the backends. Both
@@ -997,7 +1061,7 @@ void Coordinator::CancelBackends(bool fire_and_forget) {
 }
 
 Status Coordinator::UpdateBackendExecStatus(const ReportExecStatusRequestPB& request,
-    const TRuntimeProfileForest& thrift_profiles) {
+    const TRuntimeProfileForest& thrift_profiles, ReportExecStatusResponsePB* response) {
   const int32_t coord_state_idx = request.coord_state_idx();
   VLOG_FILE << "UpdateBackendExecStatus() query_id=" << PrintId(query_id())
             << " backend_idx=" << coord_state_idx;
@@ -1013,6 +1077,16 @@ Status Coordinator::UpdateBackendExecStatus(const ReportExecStatusRequestPB& req
     backend_state->UpdateHostProfile(thrift_profiles.host_profile);
   }
 
+  for (const auto& entry : request.scan_range_requests()) {
+    ScanRangeGrantPB& grant = (*response->mutable_scan_range_grants())[entry.first];
+    if (scan_range_pool_ == nullptr) {
+      grant.set_no_more_ranges(true);
+      continue;
+    }
+    scan_range_pool_->GrantScanRanges(coord_state_idx,
+        backend_state->impalad_address(), entry.first, entry.second, &grant);
+  }
+
   // Set by ApplyExecStatusReport, contains all the AuxErrorInfoPB objects in
   // ReportExecStatusRequestPB.
   vector<AuxErrorInfoPB> aux_error_info;
@@ -1270,6 +1344,14 @@ void Coordinator::ComputeQuerySummary() {
   for (BackendState* backend_state: backend_states_) {
     ResourceUtilization utilization = backend_state->GetResourceUtilization();
     total_utilization.Merge(utilization);
+    // Feed the scan throughput of the backend into the scheduler's model. The krpc
+    // address contains the backend's IP address. Failed and cancelled queries may have
+    // stopped their scans at any point, so only successful ones are taken into account.
+    if (ReturnedAllResults()) {
+      ExecutorScanModel::GetInstance()->Update(
+          backend_state->krpc_impalad_address().hostname(), utilization.bytes_read,
+          utilization.scan_time_ns);
+    }
     string network_address = NetworkAddressPBToString(backend_state->impalad_address());
     mem_info << network_address << "("
              << PrettyPrinter::Print(utilization.peak_per_host_mem_consumption,
@@ -1353,7 +1435,7 @@ void Coordinator::ReleaseExecResources() {
   // caching. The query MemTracker will be cleaned up later.
 }
 
-void Coordinator::ReleaseQueryAdmissionControlResources() {
+void Coordinator::ReleaseQueryAdmissionControlResources(bool query_succeeded) {
   DCHECK(exec_rpcs_complete_.Load()) << "Exec() must be called first";
   vector<BackendState*> unreleased_backends =
       backend_resource_state_->CloseAndGetUnreleasedBackends();
@@ -1372,7 +1454,7 @@ void Coordinator::ReleaseQueryAdmissionControlResources() {
       parent_request_state_->admission_control_client();
   DCHECK(admission_control_client != nullptr);
   admission_control_client->ReleaseQuery(
-      ComputeQueryResourceUtilization().peak_per_host_mem_consumption);
+      ComputeQueryResourceUtilization().peak_per_host_mem_consumption, query_succeeded);
   query_events_->MarkEvent("Released admission control resources");
 }
 
@@ -1477,6 +1559,13 @@ void Coordinator::UpdateFilter(const UpdateFilterParamsPB& params, RpcContext* c
     }
 
     if (state->is_bloom_filter()) {
+      // The aggregated directory is not modified anymore, so it can be shrunk to the
+      // size its actual number of distinct values requires and then replaced by its
+      // compressed form, which is then sent to all backends.
+      if (state->enabled()) {
+        state->FoldBloomFilter(exec_params_.query_options(), filter_mem_tracker_);
+        state->CompressBloomFilter(filter_mem_tracker_);
+      }
       // Assign an outgoing bloom filter.
       *rpc_params.mutable_bloom_filter() = state->bloom_filter();
 
@@ -1498,20 +1587,38 @@ void Coordinator::UpdateFilter(const UpdateFilterParamsPB& params, RpcContext* c
     rpc_params.set_filter_id(params.filter_id());
 
     // Called WaitForExecRpcs() so backend_states_ is valid.
+    vector<BackendState*> target_backends;
     for (BackendState* bs : backend_states_) {
+      if (bs->HasFragmentIdx(target_fragment_idxs) && !bs->IsDone()) {
+        target_backends.push_back(bs);
+      }
+    }
+    // With a fanout of at least 2, the filter is only sent to the root of each fan-out
+    // group, which forwards it to the rest of its group. Otherwise every group consists
+    // of a single backend.
+    int fanout = exec_params_.query_options().runtime_filter_aggregation_fanout;
+    if (fanout < 2) fanout = max<int>(1, target_backends.size());
+    rpc_params.set_forward_fanout(fanout);
+    for (const auto& group :
+        RuntimeFilterBank::GetFanOutGroups(target_backends.size(), fanout)) {
       if (!IsExecuting()) break;
 
-      if (bs->HasFragmentIdx(target_fragment_idxs)) {
-        rpc_params.set_filter_id(params.filter_id());
-        RpcController* controller = obj_pool()->Add(new RpcController);
-        PublishFilterResultPB* res = obj_pool()->Add(new PublishFilterResultPB);
-        if (rpc_params.has_bloom_filter() && !rpc_params.bloom_filter().always_false()
-            && !rpc_params.bloom_filter().always_true()) {
-          BloomFilter::AddDirectorySidecar(rpc_params.mutable_bloom_filter(), controller,
-              state->bloom_filter_directory());
-        }
-        bs->PublishFilter(state, filter_mem_tracker_, rpc_params, *controller, *res);
+      rpc_params.set_filter_id(params.filter_id());
+      rpc_params.clear_forward_targets();
+      for (int i = group.first + 1; i < group.second; ++i) {
+        FilterForwardTargetPB* target = rpc_params.add_forward_targets();
+        target->set_hostname(target_backends[i]->impalad_address().hostname());
+        *target->mutable_krpc_address() = target_backends[i]->krpc_impalad_address();
       }
+      RpcController* controller = obj_pool()->Add(new RpcController);
+      PublishFilterResultPB* res = obj_pool()->Add(new PublishFilterResultPB);
+      if (rpc_params.has_bloom_filter() && !rpc_params.bloom_filter().always_false()
+          && !rpc_params.bloom_filter().always_true()) {
+        BloomFilter::AddDirectorySidecar(rpc_params.mutable_bloom_filter(), controller,
+            state->bloom_filter_directory());
+      }
+      target_backends[group.first]->PublishFilter(
+          state, filter_mem_tracker_, rpc_params, *controller, *res);
     }
   }
 }
@@ -1525,7 +1632,8 @@ void Coordinator::FilterState::ApplyUpdate(
     first_arrival_time_ = coord->query_events_->ElapsedTime();
   }
 
-  --pending_count_;
+  DCHECK_LE(params.num_aggregated_backends(), pending_count_);
+  pending_count_ -= min(params.num_aggregated_backends(), pending_count_);
   if (is_bloom_filter()) {
     DCHECK(params.has_bloom_filter());
     if (params.bloom_filter().always_true()) {
@@ -1542,13 +1650,23 @@ void Coordinator::FilterState::ApplyUpdate(
       // has been received. Refer to BloomFilter::ToProtobuf() for further details.
       DCHECK(params.bloom_filter().has_directory_sidecar_idx());
       kudu::Slice sidecar_slice;
+      kudu::Slice directory;
+      string decompressed_directory;
       kudu::Status status = context->GetInboundSidecar(
           params.bloom_filter().directory_sidecar_idx(), &sidecar_slice);
+      Status decompress_status;
+      if (status.ok()) {
+        decompress_status = BloomFilter::DecompressDirectory(
+            params.bloom_filter(), sidecar_slice, &decompressed_directory, &directory);
+      }
       if (!status.ok()) {
         LOG(ERROR) << "Cannot get inbound sidecar: " << status.message().ToString();
         DisableAndRelease(coord->filter_mem_tracker_, false);
+      } else if (!decompress_status.ok()) {
+        LOG(ERROR) << "Cannot decompress Bloom filter: " << decompress_status.GetDetail();
+        DisableAndRelease(coord->filter_mem_tracker_, false);
       } else if (bloom_filter_.always_false()) {
-        int64_t heap_space = sidecar_slice.size();
+        int64_t heap_space = directory.size();
         if (!coord->filter_mem_tracker_->TryConsume(heap_space)) {
           VLOG_QUERY << "Not enough memory to allocate filter: "
                      << PrettyPrinter::Print(heap_space, TUnit::BYTES)
@@ -1557,13 +1675,18 @@ void Coordinator::FilterState::ApplyUpdate(
           DisableAndRelease(coord->filter_mem_tracker_, false);
         } else {
           bloom_filter_ = params.bloom_filter();
-          bloom_filter_directory_ = sidecar_slice.ToString();
+          bloom_filter_.set_directory_compression(CompressionTypePB::NONE);
+          if (directory.data() == sidecar_slice.data()) {
+            bloom_filter_directory_ = directory.ToString();
+          } else {
+            bloom_filter_directory_.swap(decompressed_directory);
+          }
         }
       } else {
-        DCHECK_EQ(bloom_filter_directory_.size(), sidecar_slice.size());
-        BloomFilter::Or(params.bloom_filter(), sidecar_slice.data(), &bloom_filter_,
+        DCHECK_EQ(bloom_filter_directory_.size(), directory.size());
+        BloomFilter::Or(params.bloom_filter(), directory.data(), &bloom_filter_,
             reinterpret_cast<uint8_t*>(const_cast<char*>(bloom_filter_directory_.data())),
-            sidecar_slice.size());
+            directory.size());
       }
     }
   } else {
@@ -1614,6 +1737,43 @@ void Coordinator::FilterState::Release(MemTracker* tracker) {
   }
 }
 
+void Coordinator::FilterState::FoldBloomFilter(
+    const TQueryOptions& query_options, MemTracker* tracker) {
+  DCHECK(is_bloom_filter());
+  if (bloom_filter_.always_false() || bloom_filter_.always_true()) return;
+  DCHECK_EQ(bloom_filter_.directory_compression(), CompressionTypePB::NONE);
+  uint8_t* directory =
+      reinterpret_cast<uint8_t*>(const_cast<char*>(bloom_filter_directory_.data()));
+  int64_t directory_size = bloom_filter_directory_.size();
+  bloom_filter_ndv_ = BloomFilter::EstimateNdv(directory, directory_size);
+  int log_space = BitUtil::Log2Ceiling64(directory_size);
+  int folded_log_space =
+      RuntimeFilterBank::GetFoldedLogSpace(query_options, bloom_filter_ndv_, log_space);
+  if (folded_log_space >= log_space) return;
+  int64_t folded_size = 1LL << folded_log_space;
+  BloomFilter::FoldDirectory(directory, directory_size, folded_size);
+  bloom_filter_directory_.resize(folded_size);
+  bloom_filter_directory_.shrink_to_fit();
+  tracker->Release(directory_size - folded_size);
+  bloom_filter_.set_log_bufferpool_space(folded_log_space);
+}
+
+void Coordinator::FilterState::CompressBloomFilter(MemTracker* tracker) {
+  DCHECK(is_bloom_filter());
+  if (bloom_filter_.always_false() || bloom_filter_.always_true()) return;
+  DCHECK_EQ(bloom_filter_.directory_compression(), CompressionTypePB::NONE);
+  string compressed;
+  if (!BloomFilter::CompressDirectory(
+          reinterpret_cast<const uint8_t*>(bloom_filter_directory_.data()),
+          bloom_filter_directory_.size(), &compressed)) {
+    return;
+  }
+  DCHECK_LT(compressed.size(), bloom_filter_directory_.size());
+  tracker->Release(bloom_filter_directory_.size() - compressed.size());
+  bloom_filter_directory_.swap(compressed);
+  bloom_filter_.set_directory_compression(CompressionTypePB::LZ4);
+}
+
 void Coordinator::FilterState::WaitForPublishFilter() {
   while (num_inflight_publish_filter_rpcs_ > 0) {
     publish_filter_done_cv_.wait(lock_);
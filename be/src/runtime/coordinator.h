@@ -58,8 +58,10 @@ class QueryDriver;
 class QueryResultSet;
 class QueryState;
 class ReportExecStatusRequestPB;
+class ReportExecStatusResponsePB;
 class RuntimeProfile;
 class RuntimeState;
+class ScanRangePool;
 class TPlanExecRequest;
 class TRuntimeProfileTree;
 class TUpdateCatalogRequest;
@@ -158,9 +160,11 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
   /// Called by the report status RPC handler to update execution status of a particular
   /// backend as well as dml_exec_state_ and the profile. This may block if exec RPCs are
   /// pending. 'request' contains details of the status update. 'thrift_profiles' contains
-  /// Thrift runtime profiles of all fragment instances from the backend.
+  /// Thrift runtime profiles of all fragment instances from the backend. Scan ranges
+  /// granted for the backend's 'scan_range_requests' are added to 'response'.
   Status UpdateBackendExecStatus(const ReportExecStatusRequestPB& request,
-      const TRuntimeProfileForest& thrift_profiles) WARN_UNUSED_RESULT;
+      const TRuntimeProfileForest& thrift_profiles,
+      ReportExecStatusResponsePB* response) WARN_UNUSED_RESULT;
 
   /// Returns the time in ms since the latest report was received for the backend which
   /// has gone the longest without a report being received, and sets 'address' to the host
@@ -215,6 +219,9 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
     /// Total bytes read across all scan nodes.
     int64_t bytes_read = 0;
 
+    /// Total local time of the scan nodes that read 'bytes_read'.
+    int64_t scan_time_ns = 0;
+
     /// Total bytes sent by instances that did not contain a scan node.
     int64_t exchange_bytes_sent = 0;
 
@@ -235,6 +242,7 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
       peak_per_host_mem_consumption =
           std::max(peak_per_host_mem_consumption, other.peak_per_host_mem_consumption);
       bytes_read += other.bytes_read;
+      scan_time_ns += other.scan_time_ns;
       exchange_bytes_sent += other.exchange_bytes_sent;
       scan_bytes_sent += other.scan_bytes_sent;
       cpu_user_ns += other.cpu_user_ns;
@@ -443,6 +451,10 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
   /// Contains all the state about filters being handled by this coordinator.
   std::unique_ptr<FilterRoutingTable> filter_routing_table_;
 
+  /// Scan ranges held back by the scheduler that are handed out to backends on demand.
+  /// Set in Exec() if the schedule held back any ranges.
+  std::unique_ptr<ScanRangePool> scan_range_pool_;
+
   /// True if the first row has been fetched, false otherwise.
   bool first_row_fetched_ = false;
 
@@ -569,9 +581,15 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
   /// for 'filter' to the routing table. 'src_fragment_params' is the parameters for the
   /// fragment containing the join node (if build is integrated) or build sink (if the
   /// build is separate). 'num_instances' and 'num_backends' are the number of instances
-  /// and backends that the fragment runs on.
+  /// and backends that the fragment runs on. 'instance_to_backend' maps the instance
+  /// index of every fragment instance to the backend it runs on.
+  /// If RUNTIME_FILTER_AGGREGATION_FANOUT is set and a partitioned join filter is
+  /// produced on more backends than the fanout, the producing backends are split into
+  /// groups of at most 'fanout' backends, and the first backend of each group is made
+  /// the intermediate aggregator for the rest of the group.
   void AddFilterSource(const FragmentExecParamsPB& src_fragment_params, int num_instances,
-      int num_backends, const TRuntimeFilterDesc& filter, int join_node_id);
+      int num_backends, const TRuntimeFilterDesc& filter, int join_node_id,
+      const boost::unordered_map<int, BackendState*>& instance_to_backend);
 
   /// Helper for HandleExecStateTransition(). Releases all resources associated with
   /// query execution. The ExecState state-machine ensures this is called exactly once.
@@ -602,8 +620,10 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
   /// step post query execution (e.g. a DML statement), then this should be called
   /// after that completes to avoid over-admitting queries.
   ///
+  /// 'query_succeeded' is true if the query returned all of its results.
+  ///
   /// The ExecState state-machine ensures this is called exactly once.
-  void ReleaseQueryAdmissionControlResources();
+  void ReleaseQueryAdmissionControlResources(bool query_succeeded);
 
   /// Helper method to release admission control resource for the given vector of
   /// BackendStates. Resources are released using
@@ -86,6 +86,8 @@ static const int PER_ROW_DATA = 8;
 static const int TOTAL_DATA_SIZE = 8 * 1024;
 static const int NUM_BATCHES = TOTAL_DATA_SIZE / BATCH_CAPACITY / PER_ROW_DATA;
 static const int SHORT_SERVICE_QUEUE_MEM_LIMIT = 16;
+// Value of every other row if the senders send skewed data.
+static const int64_t SKEWED_VALUE = -1;
 
 namespace impala {
 
@@ -133,6 +135,9 @@ class ImpalaKRPCTestBackend : public DataStreamServiceIf {
   virtual void PublishFilter(const PublishFilterParamsPB* req,
       PublishFilterResultPB* resp, RpcContext* context) {}
 
+  virtual void UpdateFilterFromRemote(
+      const UpdateFilterParamsPB* req, UpdateFilterResultPB* resp, RpcContext* context) {}
+
   MemTracker* mem_tracker() { return mem_tracker_.get(); }
 
  private:
@@ -285,10 +290,17 @@ class DataStreamTest : public testing::Test {
   TDataStreamSink hash_sink_;
   google::protobuf::RepeatedPtrField<PlanFragmentDestinationPB> dest_;
 
+  // Number of batches sent by each sender. If 'skewed_data_' is true, every other row
+  // has the value SKEWED_VALUE.
+  int num_batches_ = NUM_BATCHES;
+  bool skewed_data_ = false;
+
   struct SenderInfo {
     unique_ptr<thread> thread_handle;
     Status status;
     int num_bytes_sent = 0;
+    int64_t num_skewed_partition_keys = 0;
+    int64_t num_skewed_partition_key_rows = 0;
   };
   // Allocate each SenderInfo separately so the address doesn't change.
   vector<unique_ptr<SenderInfo>> sender_info_;
@@ -387,6 +399,7 @@ class DataStreamTest : public testing::Test {
       TupleRow* row = batch->GetRow(i);
       int64_t* val = reinterpret_cast<int64_t*>(row->GetTuple(0)->GetSlot(0));
       *val = (*next_val)++;
+      if (skewed_data_ && *val % 2 == 0) *val = SKEWED_VALUE;
     }
   }
 
@@ -620,7 +633,7 @@ class DataStreamTest : public testing::Test {
     EXPECT_OK(sender->Open(&state));
     scoped_ptr<RowBatch> batch(CreateRowBatch());
     int next_val = 0;
-    for (int i = 0; i < NUM_BATCHES; ++i) {
+    for (int i = 0; i < num_batches_; ++i) {
       GetNextBatch(batch.get(), &next_val);
       VLOG_QUERY << "sender " << sender_num << ": #rows=" << batch->num_rows();
       info->status = sender->Send(&state, batch.get());
@@ -631,6 +644,16 @@ class DataStreamTest : public testing::Test {
     sender->Close(&state);
     info->num_bytes_sent = static_cast<KrpcDataStreamSender*>(
         sender.get())->GetNumDataBytesSent();
+    RuntimeProfile::Counter* skewed_keys_counter =
+        sender->profile()->GetCounter("SkewedPartitionKeys");
+    if (skewed_keys_counter != nullptr) {
+      info->num_skewed_partition_keys = skewed_keys_counter->value();
+    }
+    RuntimeProfile::Counter* skewed_rows_counter =
+        sender->profile()->GetCounter("SkewedPartitionKeyRows");
+    if (skewed_rows_counter != nullptr) {
+      info->num_skewed_partition_key_rows = skewed_rows_counter->value();
+    }
 
     batch->Reset();
     state.ReleaseResources();
@@ -763,6 +786,51 @@ TEST_F(DataStreamTest, HashPartitionTest) {
   ASSERT_EQ(result, true);
 }
 
+// Test that hash-partitioning senders detect and report a skewed key, and that they
+// still send its rows only to the receiver of its hash.
+TEST_F(DataStreamTest, SkewedKeyDetection) {
+  const int num_receivers = 4;
+  const int buffer_size = 16 * 1024;
+  num_batches_ = 200;
+  const int64_t num_rows = num_batches_ * BATCH_CAPACITY;
+  const uint64_t seed = GetExchangeHashSeed(runtime_state_->query_id());
+  for (bool skewed_data : {false, true}) {
+    skewed_data_ = skewed_data;
+    Reset();
+    for (int i = 0; i < num_receivers; ++i) {
+      StartReceiver(TPartitionType::HASH_PARTITIONED, 1, i, buffer_size, false);
+    }
+    StartSender(TPartitionType::HASH_PARTITIONED, buffer_size);
+    JoinSenders();
+    CheckSenders();
+    JoinReceivers();
+
+    int64_t total_rows = 0;
+    for (int i = 0; i < num_receivers; ++i) {
+      ReceiverInfo* info = receiver_info_[i].get();
+      EXPECT_OK(info->status);
+      for (int64_t value : info->data_values) {
+        uint64_t hash_val =
+            RawValue::GetHashValueFastHash(&value, ColumnType(TYPE_BIGINT), seed);
+        EXPECT_EQ(hash_val % num_receivers, i) << value;
+      }
+      total_rows += info->data_values.size();
+    }
+    EXPECT_EQ(num_rows, total_rows);
+    const SenderInfo* sender = sender_info_[0].get();
+    if (skewed_data) {
+      // Every other row has the skewed value. Its share of the rows is estimated from
+      // the sampled rows.
+      EXPECT_EQ(1, sender->num_skewed_partition_keys);
+      EXPECT_GT(sender->num_skewed_partition_key_rows, num_rows * 4 / 10);
+      EXPECT_LT(sender->num_skewed_partition_key_rows, num_rows * 6 / 10);
+    } else {
+      EXPECT_EQ(0, sender->num_skewed_partition_keys);
+      EXPECT_EQ(0, sender->num_skewed_partition_key_rows);
+    }
+  }
+}
+
 // This test is to exercise a previously present deadlock path which is now fixed, to
 // ensure that the deadlock does not happen anymore. It does this by doing the following:
 // This test starts multiple senders to send to the same receiver. It makes sure that
@@ -44,6 +44,7 @@
 #include "runtime/thread-resource-mgr.h"
 #include "runtime/tmp-file-mgr.h"
 #include "scheduling/admission-controller.h"
+#include "scheduling/admission-lease-mgr.h"
 #include "scheduling/cluster-membership-mgr.h"
 #include "scheduling/request-pool-service.h"
 #include "scheduling/scheduler.h"
@@ -251,9 +252,11 @@ ExecEnv::ExecEnv(int krpc_port, int subscriber_port, int webserver_port,
     hdfs_op_thread_pool_.reset(
         CreateHdfsOpThreadPool("hdfs-worker-pool", FLAGS_num_hdfs_worker_threads, 1024));
   }
-  if (FLAGS_is_coordinator && !AdmissionServiceEnabled()) {
+  if (FLAGS_is_coordinator
+      && (!AdmissionServiceEnabled() || AdmissionLeaseMgr::IsEnabled())) {
     // We only need a Scheduler if we're performing admission control locally, i.e. if
-    // this is a coordinator and there isn't an admissiond.
+    // this is a coordinator and there isn't an admissiond, or if we admit queries against
+    // resources leased from the admissiond.
     scheduler_.reset(new Scheduler(metrics_.get(), request_pool_service_.get()));
   }
 
@@ -270,6 +273,11 @@ ExecEnv::ExecEnv(int krpc_port, int subscriber_port, int webserver_port,
         FLAGS_metrics_webserver_port, metrics_.get(), Webserver::AuthMode::NONE));
   }
 
+  if (FLAGS_is_coordinator && AdmissionServiceEnabled()
+      && AdmissionLeaseMgr::IsEnabled()) {
+    admission_lease_mgr_.reset(new AdmissionLeaseMgr(metrics_.get()));
+  }
+
   if (AdmissionServiceEnabled()) {
     admission_service_address_ =
         MakeNetworkAddress(FLAGS_admission_service_host, FLAGS_admission_service_port);
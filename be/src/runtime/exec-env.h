@@ -41,6 +41,7 @@ class KuduClient;
 namespace impala {
 
 class AdmissionController;
+class AdmissionLeaseMgr;
 class BufferPool;
 class CallableThreadPool;
 class ClusterMembershipMgr;
@@ -149,6 +150,7 @@ class ExecEnv {
   ClusterMembershipMgr* cluster_membership_mgr() { return cluster_membership_mgr_.get(); }
   Scheduler* scheduler() { return scheduler_.get(); }
   AdmissionController* admission_controller() { return admission_controller_.get(); }
+  AdmissionLeaseMgr* admission_lease_mgr() { return admission_lease_mgr_.get(); }
   StatestoreSubscriber* subscriber() { return statestore_subscriber_.get(); }
 
   const TNetworkAddress& configured_backend_address() const {
@@ -197,6 +199,7 @@ class ExecEnv {
   boost::scoped_ptr<ClusterMembershipMgr> cluster_membership_mgr_;
   boost::scoped_ptr<Scheduler> scheduler_;
   boost::scoped_ptr<AdmissionController> admission_controller_;
+  boost::scoped_ptr<AdmissionLeaseMgr> admission_lease_mgr_;
   boost::scoped_ptr<StatestoreSubscriber> statestore_subscriber_;
   boost::scoped_ptr<CatalogServiceClientCache> catalogd_client_cache_;
   boost::scoped_ptr<HBaseTableFactory> htable_factory_;
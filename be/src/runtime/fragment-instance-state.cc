@@ -313,12 +313,16 @@ void FragmentInstanceState::GetStatusReport(FragmentInstanceExecStatusPB* instan
   vector<RuntimeProfileBase*> nodes;
   profile()->GetAllChildren(&nodes);
   int64_t bytes_read = 0;
+  int64_t scan_time_ns = 0;
   int64_t scan_ranges_complete = 0;
   int64_t total_bytes_sent = 0;
   std::map<int32_t, int64_t> per_join_rows_produced;
   for (RuntimeProfileBase* node : nodes) {
     RuntimeProfile::Counter* c = node->GetCounter(PROFILE_BytesRead.name());
-    if (c != nullptr) bytes_read += c->value();
+    if (c != nullptr) {
+      bytes_read += c->value();
+      scan_time_ns += node->local_time();
+    }
     c = node->GetCounter(PROFILE_ScanRangesComplete.name());
     if (c != nullptr) scan_ranges_complete += c->value();
     c = node->GetCounter(KrpcDataStreamSender::TOTAL_BYTES_SENT_COUNTER);
@@ -351,6 +355,7 @@ void FragmentInstanceState::GetStatusReport(FragmentInstanceExecStatusPB* instan
     }
   }
   bytes_read_ = bytes_read;
+  scan_time_ns_ = scan_time_ns;
   scan_ranges_complete_ = scan_ranges_complete;
   total_bytes_sent_  = total_bytes_sent;
   per_join_rows_produced_ = per_join_rows_produced;
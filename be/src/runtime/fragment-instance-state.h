@@ -150,6 +150,7 @@ class FragmentInstanceState {
   int64_t cpu_user_ns() const { return cpu_user_ns_; }
   int64_t cpu_sys_ns() const { return cpu_sys_ns_; }
   int64_t bytes_read() const { return bytes_read_; }
+  int64_t scan_time_ns() const { return scan_time_ns_; }
   int64_t total_bytes_sent() const { return total_bytes_sent_; }
   const std::map<int32_t, int64_t>& per_join_rows_produced() const {
     return per_join_rows_produced_;
@@ -215,6 +216,10 @@ class FragmentInstanceState {
   /// Sum of BytesRead counters on this backend. Set in GetStatusReport().
   int64_t bytes_read_ = 0;
 
+  /// Sum of the local time of the scan nodes that read 'bytes_read_'. Set in
+  /// GetStatusReport().
+  int64_t scan_time_ns_ = 0;
+
   /// Total bytes sent on exchanges in this backend. Set in GetStatusReport().
   int64_t total_bytes_sent_ = 0;
 
@@ -76,6 +76,7 @@ class FragmentState {
   }
   const PlanNode* plan_tree() const { return plan_tree_; }
   const DataSinkConfig* sink_config() const { return sink_config_; }
+  QueryState* query_state() const { return query_state_; }
   const TUniqueId& query_id() const { return query_state_->query_id(); }
   const DescriptorTbl& desc_tbl() const { return query_state_->desc_tbl(); }
   MemTracker* query_mem_tracker() const { return query_state_->query_mem_tracker(); }
@@ -29,17 +29,22 @@ ScalarExprEvaluator* KrpcDataStreamSender::GetPartitionExprEvaluator(int i) {
 Status KrpcDataStreamSender::HashAndAddRows(RowBatch* batch) {
   const int num_rows = batch->num_rows();
   const int num_channels = GetNumChannels();
-  int channel_ids[RowBatch::HASH_BATCH_SIZE];
+  uint64_t hashes[RowBatch::HASH_BATCH_SIZE];
   int row_idx = 0;
   while (row_idx < num_rows) {
     int row_count = 0;
     FOREACH_ROW_LIMIT(batch, row_idx, RowBatch::HASH_BATCH_SIZE, row_batch_iter) {
-      TupleRow* row = row_batch_iter.Get();
-      channel_ids[row_count++] = HashRow(row) % num_channels;
+      hashes[row_count++] = HashRow(row_batch_iter.Get());
+    }
+    // Only one row of each window is sampled to keep skew detection cheap.
+    if (row_count > 0) {
+      SamplePartitionHash(hashes[next_sample_offset_ % row_count]);
+      next_sample_offset_ = (next_sample_offset_ + 1) % RowBatch::HASH_BATCH_SIZE;
     }
     row_count = 0;
     FOREACH_ROW_LIMIT(batch, row_idx, RowBatch::HASH_BATCH_SIZE, row_batch_iter) {
-      RETURN_IF_ERROR(AddRowToChannel(channel_ids[row_count++], row_batch_iter.Get()));
+      RETURN_IF_ERROR(
+          AddRowToChannel(hashes[row_count++] % num_channels, row_batch_iter.Get()));
     }
     row_idx += row_count;
   }
@@ -21,6 +21,7 @@
 
 #include <chrono>
 #include <condition_variable>
+#include <iomanip>
 #include <iostream>
 #include <thrift/protocol/TDebugProtocol.h>
 
@@ -724,6 +725,7 @@ KrpcDataStreamSender::KrpcDataStreamSender(TDataSinkId sink_id, int sender_id,
     dest_node_id_(sink.dest_node_id),
     next_unknown_partition_(0),
     exchange_hash_seed_(sink_config.exchange_hash_seed_),
+    partition_hash_sketch_(PARTITION_HASH_SKETCH_CAPACITY),
     hash_and_add_rows_fn_(sink_config.hash_and_add_rows_fn_) {
   DCHECK_GT(destinations.size(), 0);
   DCHECK(sink.output_partition.type == TPartitionType::UNPARTITIONED
@@ -775,6 +777,12 @@ Status KrpcDataStreamSender::Prepare(
   uncompressed_bytes_counter_ =
       ADD_COUNTER(profile(), "UncompressedRowBatchSize", TUnit::BYTES);
   total_sent_rows_counter_= ADD_COUNTER(profile(), "RowsSent", TUnit::UNIT);
+  if (partition_type_ == TPartitionType::HASH_PARTITIONED) {
+    skewed_partition_keys_counter_ =
+        ADD_COUNTER(profile(), "SkewedPartitionKeys", TUnit::UNIT);
+    skewed_partition_key_rows_counter_ =
+        ADD_COUNTER(profile(), "SkewedPartitionKeyRows", TUnit::UNIT);
+  }
   for (int i = 0; i < channels_.size(); ++i) {
     RETURN_IF_ERROR(channels_[i]->Init(state));
   }
@@ -971,6 +979,34 @@ Status KrpcDataStreamSender::AddRowToChannel(const int channel_id, TupleRow* row
   return channels_[channel_id]->AddRow(row);
 }
 
+void KrpcDataStreamSender::SamplePartitionHash(uint64_t hash) {
+  partition_hash_sketch_.Update(hash);
+}
+
+void KrpcDataStreamSender::ReportSkewedPartitionKeys() {
+  if (partition_type_ != TPartitionType::HASH_PARTITIONED) return;
+  int64_t num_samples = partition_hash_sketch_.total();
+  if (num_samples < MIN_SKEW_SAMPLES) return;
+  // A key is skewed if it alone sends more rows to its receiver than every receiver
+  // would get if the rows were spread evenly.
+  vector<SpaceSavingSketch::Entry> skewed_keys =
+      partition_hash_sketch_.GetHeavyHitters(1.0 / channels_.size());
+  if (skewed_keys.empty()) return;
+  int64_t num_skewed_samples = 0;
+  for (const SpaceSavingSketch::Entry& entry : skewed_keys) {
+    num_skewed_samples += entry.count - entry.error;
+  }
+  double skewed_fraction = static_cast<double>(num_skewed_samples) / num_samples;
+  COUNTER_SET(skewed_partition_keys_counter_, static_cast<int64_t>(skewed_keys.size()));
+  COUNTER_SET(skewed_partition_key_rows_counter_,
+      static_cast<int64_t>(skewed_fraction * total_sent_rows_counter_->value()));
+  VLOG_QUERY << "Exchange to node " << dest_node_id_ << " of instance "
+             << PrintId(state_->fragment_instance_id()) << " has " << skewed_keys.size()
+             << " skewed partition key(s) with " << setprecision(3)
+             << 100 * skewed_fraction << "% of the rows across " << channels_.size()
+             << " receivers";
+}
+
 uint64_t KrpcDataStreamSender::HashRow(TupleRow* row) {
   uint64_t hash_val = exchange_hash_seed_;
   for (ScalarExprEvaluator* eval : partition_expr_evals_) {
@@ -1064,6 +1100,7 @@ Status KrpcDataStreamSender::FlushFinal(RuntimeState* state) {
   for (unique_ptr<Channel>& channel : channels_) {
     RETURN_IF_ERROR(channel->WaitForRpc());
   }
+  ReportSkewedPartitionKeys();
   for (unique_ptr<Channel>& channel : channels_) {
     RETURN_IF_ERROR(channel->SendEosAsync());
   }
@@ -30,6 +30,7 @@
 #include "exprs/scalar-expr.h"
 #include "runtime/row-batch.h"
 #include "util/runtime-profile.h"
+#include "util/space-saving-sketch.h"
 
 namespace impala {
 
@@ -183,6 +184,14 @@ class KrpcDataStreamSender : public DataSink {
   /// Adds the given row to 'channels_[channel_id]'.
   Status AddRowToChannel(const int channel_id, TupleRow* row);
 
+  /// Adds the partition hash value 'hash' of a sampled row to 'partition_hash_sketch_'.
+  /// Called by HashAndAddRows() for one row out of every RowBatch::HASH_BATCH_SIZE.
+  void SamplePartitionHash(uint64_t hash);
+
+  /// Reports the partition keys that received a disproportionate share of the sampled
+  /// rows in the profile. Called once all rows were sent.
+  void ReportSkewedPartitionKeys();
+
   /// Sender instance id, unique within a fragment.
   const int sender_id_;
 
@@ -244,6 +253,15 @@ class KrpcDataStreamSender : public DataSink {
   /// Total number of rows sent.
   RuntimeProfile::Counter* total_sent_rows_counter_ = nullptr;
 
+  /// Number of partition keys that each received more rows than a receiver would get
+  /// if all keys were spread evenly. Only set when 'partition_type_' is
+  /// HASH_PARTITIONED.
+  RuntimeProfile::Counter* skewed_partition_keys_counter_ = nullptr;
+
+  /// Estimated number of rows sent for the keys counted in
+  /// 'skewed_partition_keys_counter_'.
+  RuntimeProfile::Counter* skewed_partition_key_rows_counter_ = nullptr;
+
   /// Summary of network throughput for sending row batches. Network time also includes
   /// queuing time in KRPC transfer queue for transmitting the RPC requests and receiving
   /// the responses.
@@ -268,6 +286,18 @@ class KrpcDataStreamSender : public DataSink {
   /// Hash seed used for exchanges. Query id will be used to seed the hash function.
   uint64_t exchange_hash_seed_;
 
+  /// Heavy hitters among the partition hash values of the sampled rows. Only used when
+  /// 'partition_type_' is HASH_PARTITIONED.
+  static const int PARTITION_HASH_SKETCH_CAPACITY = 64;
+  SpaceSavingSketch partition_hash_sketch_;
+
+  /// Minimum number of sampled rows before skewed partition keys are reported.
+  static const int MIN_SKEW_SAMPLES = 1000;
+
+  /// Offset within the next window of RowBatch::HASH_BATCH_SIZE rows of the row that is
+  /// sampled. Rotates so that the samples do not depend on the position of the rows.
+  int next_sample_offset_ = 0;
+
   /// Pointer for the codegen'd HashAndAddRows() function.
   /// NULL if codegen is disabled or failed.
   const CodegenFnPtr<KrpcDataStreamSenderConfig::HashAndAddRowsFn>& hash_and_add_rows_fn_;
@@ -17,6 +17,7 @@
 
 #include "runtime/query-state.h"
 
+#include <algorithm>
 #include <mutex>
 
 #include "codegen/llvm-codegen.h"
@@ -68,6 +69,16 @@ static const int DEFAULT_REPORT_WAIT_TIME_MS = 5000;
 DECLARE_int32(backend_client_rpc_timeout_ms);
 DECLARE_int64(rpc_max_message_size);
 
+DEFINE_int32(scan_range_request_interval_ms, 100, "(Advanced) Interval at which "
+    "backends send status reports while some of their scans have spare capacity and "
+    "the coordinator may have scan ranges to hand out to them. See "
+    "--scan_range_holdback_fraction.");
+DEFINE_bool(status_report_delta_profiles, false, "(Advanced) If true, the fragment "
+    "instance profiles in periodic status reports only include the counters and info "
+    "strings that changed since the last report that was sent successfully. Reduces the "
+    "network and coordinator CPU cost of reports for queries with many fragment "
+    "instances. The profiles as of the last report are kept in memory, which counts "
+    "against the memory limit of the query.");
 DEFINE_int32_hidden(stress_status_report_delay_ms, 0, "Stress option to inject a delay "
     "before status reports. Has no effect on release builds.");
 
@@ -156,6 +167,8 @@ void QueryState::ReleaseBackendResources() {
 QueryState::~QueryState() {
   DCHECK_EQ(refcnt_.Load(), 0);
   DCHECK_EQ(backend_resource_refcnt_.Load(), 0);
+  ClearProfileBaselines(&pending_instance_profiles_);
+  ClearProfileBaselines(&sent_instance_profiles_);
   if (query_mem_tracker_ != nullptr) {
     // Disconnect the query MemTracker hierarchy from the global hierarchy. After this
     // point nothing must touch this query's MemTracker and all tracked memory associated
@@ -422,6 +435,13 @@ Status QueryState::InitFilterBank() {
       auto it = filters.find(produced_filter.filter_id);
       DCHECK(it != filters.end());
       ++it->second.num_producers;
+      // The aggregation settings are the same for all instances on this backend.
+      if (produced_filter.__isset.aggregator) {
+        it->second.aggregator = &produced_filter.aggregator;
+      }
+      if (produced_filter.__isset.num_remote_updates) {
+        it->second.num_remote_updates = produced_filter.num_remote_updates;
+      }
     }
   }
   filter_bank_.reset(
@@ -507,6 +527,7 @@ void QueryState::ConstructReport(bool instances_started,
     ReportExecStatusRequestPB* report, TRuntimeProfileForest* profiles_forest) {
   report->Clear();
   report->set_backend_report_seq_no(++last_report_seq_no_);
+  ClearProfileBaselines(&pending_instance_profiles_);
   TUniqueIdToUniqueIdPB(query_id(), report->mutable_query_id());
   DCHECK(exec_rpc_params_.has_coord_state_idx());
   report->set_coord_state_idx(exec_rpc_params_.coord_state_idx());
@@ -529,6 +550,16 @@ void QueryState::ConstructReport(bool instances_started,
     report->set_local_disk_faulty(true);
   }
 
+  {
+    lock_guard<mutex> l(scan_range_receivers_lock_);
+    for (ScanRangeReceiver* receiver : scan_range_receivers_) {
+      ScanRangeRequestPB request;
+      if (receiver->GetScanRangeRequest(&request)) {
+        (*report->mutable_scan_range_requests())[receiver->node_id()] = request;
+      }
+    }
+  }
+
   // Add profile to report
   host_profile_->ToThrift(&profiles_forest->host_profile);
   profiles_forest->__isset.host_profile = true;
@@ -547,6 +578,7 @@ void QueryState::ConstructReport(bool instances_started,
     int64_t cpu_user_ns = AsyncCodegenThreadUserTime();
     int64_t cpu_sys_ns = AsyncCodegenThreadSysTime();
     int64_t bytes_read = 0;
+    int64_t scan_time_ns = 0;
     int64_t scan_ranges_complete = 0;
     int64_t exchange_bytes_sent = 0;
     int64_t scan_bytes_sent = 0;
@@ -558,6 +590,7 @@ void QueryState::ConstructReport(bool instances_started,
       // If this fragment instance has already sent its last report, skip it.
       if (fis->final_report_sent()) {
         DCHECK(fis->IsDone());
+        EraseProfileBaseline(entry.first, &sent_instance_profiles_);
       } else {
         // Update the status and profiles of this fragment instance.
         FragmentInstanceExecStatusPB* instance_status =
@@ -575,8 +608,15 @@ void QueryState::ConstructReport(bool instances_started,
               instance_status, nullptr, agg_profile, report_overall_status);
         } else {
           profiles_forest->profile_trees.emplace_back();
-          fis->GetStatusReport(instance_status, &profiles_forest->profile_trees.back(),
-              nullptr, report_overall_status);
+          TRuntimeProfileTree* profile = &profiles_forest->profile_trees.back();
+          fis->GetStatusReport(instance_status, profile, nullptr, report_overall_status);
+          if (FLAGS_status_report_delta_profiles) {
+            AddPendingProfileBaseline(entry.first, *profile);
+            auto sent_it = sent_instance_profiles_.find(entry.first);
+            if (sent_it != sent_instance_profiles_.end()) {
+              RuntimeProfile::RemoveUnchangedFromThrift(sent_it->second.profile, profile);
+            }
+          }
         }
       }
 
@@ -584,6 +624,7 @@ void QueryState::ConstructReport(bool instances_started,
       cpu_user_ns += fis->cpu_user_ns();
       cpu_sys_ns += fis->cpu_sys_ns();
       bytes_read += fis->bytes_read();
+      scan_time_ns += fis->scan_time_ns();
       scan_ranges_complete += fis->scan_ranges_complete();
       // Determine whether this instance had a scan node in its plan.
       // Note: this is hacky. E.g. it doesn't work for Kudu scans.
@@ -614,6 +655,7 @@ void QueryState::ConstructReport(bool instances_started,
     report->set_cpu_user_ns(cpu_user_ns);
     report->set_cpu_sys_ns(cpu_sys_ns);
     report->set_bytes_read(bytes_read);
+    report->set_scan_time_ns(scan_time_ns);
     report->set_scan_ranges_complete(scan_ranges_complete);
     report->set_exchange_bytes_sent(exchange_bytes_sent);
     report->set_scan_bytes_sent(scan_bytes_sent);
@@ -623,6 +665,42 @@ void QueryState::ConstructReport(bool instances_started,
   }
 }
 
+void QueryState::AddPendingProfileBaseline(
+    const TUniqueId& instance_id, const TRuntimeProfileTree& profile) {
+  ProfileBaseline baseline;
+  baseline.profile = profile;
+  // RemoveUnchangedFromThrift() always keeps these, so the baseline doesn't need them.
+  for (TRuntimeProfileNode& node : baseline.profile.nodes) {
+    node.event_sequences.clear();
+    node.__isset.event_sequences = false;
+    node.time_series_counters.clear();
+    node.__isset.time_series_counters = false;
+  }
+  baseline.bytes = RuntimeProfile::EstimateThriftSize(baseline.profile);
+  if (!query_mem_tracker_->TryConsume(baseline.bytes)) {
+    VLOG(2) << "Not enough memory to keep the profile of fragment instance "
+            << PrintId(instance_id) << ", sending the full profile in the next report";
+    // The next report can't be computed against a baseline that is older than this one.
+    EraseProfileBaseline(instance_id, &sent_instance_profiles_);
+    return;
+  }
+  EraseProfileBaseline(instance_id, &pending_instance_profiles_);
+  pending_instance_profiles_[instance_id] = move(baseline);
+}
+
+void QueryState::EraseProfileBaseline(
+    const TUniqueId& instance_id, ProfileBaselineMap* baselines) {
+  auto it = baselines->find(instance_id);
+  if (it == baselines->end()) return;
+  query_mem_tracker_->Release(it->second.bytes);
+  baselines->erase(it);
+}
+
+void QueryState::ClearProfileBaselines(ProfileBaselineMap* baselines) {
+  for (const auto& entry : *baselines) query_mem_tracker_->Release(entry.second.bytes);
+  baselines->clear();
+}
+
 bool QueryState::ReportExecStatus() {
 #ifndef NDEBUG
   if (FLAGS_stress_status_report_delay_ms) {
@@ -708,6 +786,21 @@ bool QueryState::ReportExecStatus() {
         PrintId(query_id()), num_failed_reports_, retry_time_ms);
   }
 
+  if (rpc_status.ok() && result_status.ok()) AddGrantedScanRanges(resp);
+
+  // The coordinator has the profiles in this report now, so the next report only needs
+  // to include what changed since. If it dropped them, send complete profiles again.
+  if (rpc_status.ok() && resp.profiles_dropped()) {
+    ClearProfileBaselines(&sent_instance_profiles_);
+  } else if (rpc_status.ok() && profile_buf != nullptr) {
+    for (auto& entry : pending_instance_profiles_) {
+      EraseProfileBaseline(entry.first, &sent_instance_profiles_);
+      sent_instance_profiles_[entry.first] = move(entry.second);
+    }
+    pending_instance_profiles_.clear();
+  }
+  ClearProfileBaselines(&pending_instance_profiles_);
+
   // Notify the fragment instances of the report's status.
   for (const FragmentInstanceExecStatusPB& instance_exec_status :
       report.instance_exec_status()) {
@@ -745,11 +838,14 @@ bool QueryState::ReportExecStatus() {
   return rpc_status.ok();
 }
 
-int64_t QueryState::GetReportWaitTimeMs() const {
+int64_t QueryState::GetReportWaitTimeMs() {
   int64_t report_interval = query_ctx().status_report_interval_ms > 0 ?
       query_ctx().status_report_interval_ms :
       DEFAULT_REPORT_WAIT_TIME_MS;
   if (num_failed_reports_ == 0) {
+    if (FLAGS_scan_range_request_interval_ms > 0 && WantsScanRanges()) {
+      return min<int64_t>(report_interval, FLAGS_scan_range_request_interval_ms);
+    }
     return report_interval;
   } else {
     // Generate a random number between 0 and 1 - we'll retry sometime evenly distributed
@@ -760,6 +856,37 @@ int64_t QueryState::GetReportWaitTimeMs() const {
   }
 }
 
+void QueryState::RegisterScanRangeReceiver(ScanRangeReceiver* receiver) {
+  lock_guard<mutex> l(scan_range_receivers_lock_);
+  scan_range_receivers_.push_back(receiver);
+}
+
+void QueryState::UnregisterScanRangeReceiver(ScanRangeReceiver* receiver) {
+  lock_guard<mutex> l(scan_range_receivers_lock_);
+  auto it =
+      std::find(scan_range_receivers_.begin(), scan_range_receivers_.end(), receiver);
+  DCHECK(it != scan_range_receivers_.end());
+  if (it != scan_range_receivers_.end()) scan_range_receivers_.erase(it);
+}
+
+bool QueryState::WantsScanRanges() {
+  lock_guard<mutex> l(scan_range_receivers_lock_);
+  for (ScanRangeReceiver* receiver : scan_range_receivers_) {
+    ScanRangeRequestPB request;
+    if (receiver->GetScanRangeRequest(&request)) return true;
+  }
+  return false;
+}
+
+void QueryState::AddGrantedScanRanges(const ReportExecStatusResponsePB& response) {
+  if (response.scan_range_grants().empty()) return;
+  lock_guard<mutex> l(scan_range_receivers_lock_);
+  for (ScanRangeReceiver* receiver : scan_range_receivers_) {
+    auto it = response.scan_range_grants().find(receiver->node_id());
+    if (it != response.scan_range_grants().end()) receiver->AddScanRanges(it->second);
+  }
+}
+
 void QueryState::ErrorDuringFragmentCodegen(const Status& status) {
   unique_lock<SpinLock> l(status_lock_);
   if (!HasErrorStatus()) {
@@ -988,10 +1115,20 @@ void QueryState::Cancel() {
 }
 
 void QueryState::PublishFilter(const PublishFilterParamsPB& params, RpcContext* context) {
-  if (!WaitForPrepare().ok()) return;
+  if (!WaitForPrepare().ok()) {
+    // The backends below this one in the fan-out tree may still need the filter.
+    RuntimeFilterBank::ForwardFilter(params, context);
+    return;
+  }
   filter_bank_->PublishGlobalFilter(params, context);
 }
 
+Status QueryState::UpdateFilterFromRemote(
+    const UpdateFilterParamsPB& params, RpcContext* context) {
+  RETURN_IF_ERROR(WaitForPrepare());
+  return filter_bank_->UpdateFilterFromRemote(params, context);
+}
+
 Status QueryState::StartSpilling(RuntimeState* runtime_state, MemTracker* mem_tracker) {
   // Return an error message with the root cause of why spilling is disabled.
   if (query_options().scratch_limit == 0) {
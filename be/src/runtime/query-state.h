@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "common/atomic.h"
 #include "common/compiler-util.h"
@@ -28,6 +29,7 @@
 #include "common/object-pool.h"
 #include "common/status.h"
 #include "gen-cpp/ImpalaInternalService_types.h"
+#include "gen-cpp/RuntimeProfile_types.h"
 #include "gen-cpp/Types_types.h"
 #include "gen-cpp/control_service.pb.h"
 #include "gutil/macros.h"
@@ -54,6 +56,7 @@ class LlvmCodeGen;
 class MemTracker;
 class PlanNode;
 class PublishFilterParamsPB;
+class UpdateFilterParamsPB;
 class ReservationTracker;
 class RuntimeFilterBank;
 class RuntimeProfile;
@@ -63,6 +66,25 @@ class ScannerMemLimiter;
 class TmpFileGroup;
 class TRuntimeProfileForest;
 
+/// Interface of scan nodes for which the coordinator holds back some of the scan ranges
+/// and hands them out while the query runs (see Scheduler::HoldBackScanRanges()). The
+/// QueryState requests ranges on behalf of the registered receivers in its status
+/// reports and passes on the ranges that the coordinator grants in the responses.
+class ScanRangeReceiver {
+ public:
+  virtual ~ScanRangeReceiver() {}
+
+  /// Id of the scan node.
+  virtual int node_id() const = 0;
+
+  /// Returns true and fills 'request' if the scan node has spare capacity and the
+  /// coordinator may still have ranges for it.
+  virtual bool GetScanRangeRequest(ScanRangeRequestPB* request) = 0;
+
+  /// Adds the ranges in 'grant' that were not received before.
+  virtual void AddScanRanges(const ScanRangeGrantPB& grant) = 0;
+};
+
 /// Central class for all backend execution state (example: the FragmentInstanceStates
 /// of the individual fragment instances) created for a particular query.
 /// This class contains or makes accessible state that is shared across fragment
@@ -215,6 +237,13 @@ class QueryState {
   /// Blocks until all fragment instances have finished their Prepare phase.
   void PublishFilter(const PublishFilterParamsPB& params, kudu::rpc::RpcContext* context);
 
+  /// Blocks until all fragment instances have finished their Prepare phase. Then passes
+  /// a filter update from another backend to the filter bank, which aggregates it if
+  /// this backend is an intermediate aggregator for the filter. Returns an error if the
+  /// update was not merged, see RuntimeFilterBank::UpdateFilterFromRemote().
+  Status UpdateFilterFromRemote(const UpdateFilterParamsPB& params,
+      kudu::rpc::RpcContext* context) WARN_UNUSED_RESULT;
+
   /// Cancels all actively executing fragment instances. Blocks until all fragment
   /// instances have finished their Prepare phase. Idempotent.
   /// For uninitialized QueryState, just set is_cancelled_ and don't need to cancel
@@ -281,6 +310,11 @@ class QueryState {
   /// unlimited.
   int64_t GetMaxReservation();
 
+  /// Registers 'receiver' to request scan ranges in status reports. 'receiver' must be
+  /// unregistered before it is destroyed.
+  void RegisterScanRangeReceiver(ScanRangeReceiver* receiver);
+  void UnregisterScanRangeReceiver(ScanRangeReceiver* receiver);
+
   /// The default BATCH_SIZE.
   static const int DEFAULT_BATCH_SIZE = 1024;
 
@@ -420,6 +454,12 @@ class QueryState {
   /// Protects 'is_initialized_'.
   std::mutex init_lock_;
 
+  /// Scan nodes that receive scan ranges from the coordinator while they run. The lock
+  /// is held while the receivers are called, so that they cannot be unregistered
+  /// concurrently.
+  std::mutex scan_range_receivers_lock_;
+  std::vector<ScanRangeReceiver*> scan_range_receivers_;
+
   /// Set as true on successful initialization.
   /// Protected by 'init_lock_'.
   bool is_initialized_ = false;
@@ -455,6 +495,29 @@ class QueryState {
   /// send a status report so that we can cancel after a configurable timeout.
   int64_t failed_report_time_ms_ = 0;
 
+  /// The profile of a fragment instance as of a status report, without its event
+  /// sequences and time series counters, which are always sent in full.
+  struct ProfileBaseline {
+    TRuntimeProfileTree profile;
+
+    /// Estimated memory used by 'profile', which is tracked by 'query_mem_tracker_'.
+    int64_t bytes = 0;
+  };
+  typedef std::unordered_map<TUniqueId, ProfileBaseline> ProfileBaselineMap;
+
+  /// Fragment instance id => the profile of the instance as of the last status report
+  /// that was sent successfully. If --status_report_delta_profiles is true, later
+  /// reports only include the counters and info strings that changed since then. Since
+  /// the coordinator applies values rather than increments, re-sending changes after a
+  /// failed report is harmless.
+  /// Thread-safety: Only accessed by the query state thread.
+  ProfileBaselineMap sent_instance_profiles_;
+
+  /// The profiles of the instances in the report that is currently being sent. Moved to
+  /// 'sent_instance_profiles_' once the report was sent successfully.
+  /// Thread-safety: Only accessed by the query state thread.
+  ProfileBaselineMap pending_instance_profiles_;
+
   /// Create QueryState w/ a refcnt of 0 and a memory limit of 'mem_limit' bytes applied
   /// to the query mem tracker. The query is associated with the resource pool set in
   /// 'query_ctx.request_pool' or from 'request_pool', if the former is not set (needed
@@ -490,6 +553,18 @@ class QueryState {
   void ConstructReport(bool instances_started, ReportExecStatusRequestPB* report,
       TRuntimeProfileForest* profiles_forest);
 
+  /// Stores 'profile' as the pending baseline of fragment instance 'instance_id' if its
+  /// memory fits into the query's memory limit. Otherwise drops the instance's baseline,
+  /// so that its next report includes the full profile.
+  void AddPendingProfileBaseline(
+      const TUniqueId& instance_id, const TRuntimeProfileTree& profile);
+
+  /// Removes the baseline of 'instance_id' from 'baselines' and releases its memory.
+  void EraseProfileBaseline(const TUniqueId& instance_id, ProfileBaselineMap* baselines);
+
+  /// Removes all baselines from 'baselines' and releases their memory.
+  void ClearProfileBaselines(ProfileBaselineMap* baselines);
+
   /// Gather statuses and profiles of all fragment instances belonging to this query state
   /// and send it to the coordinator via ReportExecStatus() RPC. Returns true if the
   /// report rpc was successful or if it was unsuccessful and we've reached the maximum
@@ -498,8 +573,15 @@ class QueryState {
 
   /// Returns the amount of time in ms to wait before sending the next status report,
   /// calculated as a function of the status report interval with backoff based on the
-  /// number of consecutive failed reports.
-  int64_t GetReportWaitTimeMs() const;
+  /// number of consecutive failed reports. Reports are sent at least every
+  /// --scan_range_request_interval_ms while a ScanRangeReceiver wants more ranges.
+  int64_t GetReportWaitTimeMs();
+
+  /// Returns true if any registered ScanRangeReceiver wants more ranges.
+  bool WantsScanRanges();
+
+  /// Passes on the scan ranges granted in 'response' to the registered receivers.
+  void AddGrantedScanRanges(const ReportExecStatusResponsePB& response);
 
   /// Returns true if the overall backend status is already set with an error.
   bool HasErrorStatus() const {
@@ -41,6 +41,7 @@
 #include "util/bloom-filter.h"
 #include "util/debug-util.h"
 #include "util/min-max-filter.h"
+#include "util/network-util.h"
 #include "util/pretty-printer.h"
 #include "util/uid-util.h"
 
@@ -55,10 +56,23 @@ using namespace strings;
 DEFINE_double(max_filter_error_rate, 0.75, "(Advanced) The target false positive "
     "probability used to determine the ideal size for each bloom filter size. This value "
     "can be overriden by the RUNTIME_FILTER_ERROR_RATE query option.");
+DEFINE_bool(fold_runtime_bloom_filters, true, "(Advanced) If true, Bloom filters that "
+    "the planner oversized are shrunk to the size needed for the number of distinct "
+    "values actually inserted before they are sent to their consumers.");
 
 const int64_t RuntimeFilterBank::MIN_BLOOM_FILTER_SIZE;
 const int64_t RuntimeFilterBank::MAX_BLOOM_FILTER_SIZE;
 
+int RuntimeFilterBank::GetFoldedLogSpace(
+    const TQueryOptions& query_options, int64_t ndv, int log_space) {
+  if (!FLAGS_fold_runtime_bloom_filters) return log_space;
+  double fpp = query_options.__isset.runtime_filter_error_rate ?
+      query_options.runtime_filter_error_rate :
+      FLAGS_max_filter_error_rate;
+  return BloomFilter::GetFoldedLogSpace(
+      ndv, fpp, BitUtil::Log2Ceiling64(MIN_BLOOM_FILTER_SIZE), log_space);
+}
+
 RuntimeFilterBank::RuntimeFilterBank(QueryState* query_state,
     const unordered_map<int32_t, FilterRegistration>& filters,
     long total_filter_mem_required)
@@ -68,7 +82,23 @@ RuntimeFilterBank::RuntimeFilterBank(QueryState* query_state,
         -1, "Runtime Filter Bank", query_state->query_mem_tracker(), false))),
     bloom_memory_allocated_(
         query_state->host_profile()->AddCounter("BloomFilterBytes", TUnit::BYTES)),
-    total_bloom_filter_mem_required_(total_filter_mem_required) {}
+    remote_filter_updates_received_(query_state->host_profile()->AddCounter(
+        "RemoteFilterUpdatesAggregated", TUnit::UNIT)),
+    filters_forwarded_(
+        query_state->host_profile()->AddCounter("FiltersForwarded", TUnit::UNIT)),
+    total_bloom_filter_mem_required_(total_filter_mem_required) {
+  for (auto& entry : filters) {
+    const FilterRegistration& reg = entry.second;
+    if (reg.num_remote_updates == 0) continue;
+    PerFilterState* fs = filters_.at(entry.first).get();
+    DCHECK(fs->aggregator == nullptr);
+    RuntimeFilter* result_filter = fs->produced_filter.result_filter;
+    DCHECK(result_filter != nullptr);
+    // Remote updates and the locally complete filter are merged.
+    fs->aggregated_filter = make_unique<AggregatedFilter>(reg.num_remote_updates + 1,
+        result_filter->is_bloom_filter(), result_filter->type(), filter_mem_tracker_);
+  }
+}
 
 RuntimeFilterBank::~RuntimeFilterBank() {}
 
@@ -89,8 +119,8 @@ RuntimeFilterBank::BuildFilterMap(
       result_filter =
           obj_pool->Add(new RuntimeFilter(reg.desc, reg.desc.filter_size_bytes));
     }
-    result.emplace(entry.first,
-        make_unique<PerFilterState>(reg.num_producers, result_filter, consumed_filter));
+    result.emplace(entry.first, make_unique<PerFilterState>(reg.num_producers,
+        result_filter, consumed_filter, reg.aggregator));
   }
   return result;
 }
@@ -135,6 +165,21 @@ RuntimeFilter* RuntimeFilterBank::RegisterConsumer(
   return fs->consumed_filter;
 }
 
+void RuntimeFilterBank::IncrementNumInflightRpcs(int num_rpcs) {
+  unique_lock<SpinLock> l(num_inflight_rpcs_lock_);
+  DCHECK_GE(num_inflight_rpcs_, 0);
+  num_inflight_rpcs_ += num_rpcs;
+}
+
+void RuntimeFilterBank::DecrementNumInflightRpcs() {
+  {
+    unique_lock<SpinLock> l(num_inflight_rpcs_lock_);
+    DCHECK_GT(num_inflight_rpcs_, 0);
+    --num_inflight_rpcs_;
+  }
+  krpcs_done_cv_.notify_one();
+}
+
 void RuntimeFilterBank::UpdateFilterCompleteCb(
     const RpcController* rpc_controller, const UpdateFilterResultPB* res) {
   const kudu::Status controller_status = rpc_controller->status();
@@ -148,13 +193,68 @@ void RuntimeFilterBank::UpdateFilterCompleteCb(
   }
   // DataStreamService::UpdateFilter() should never set an error status
   DCHECK_EQ(res->status().status_code(), TErrorCode::OK);
+  DecrementNumInflightRpcs();
+}
 
-  {
-    std::unique_lock<SpinLock> l(num_inflight_rpcs_lock_);
-    DCHECK_GT(num_inflight_rpcs_, 0);
-    --num_inflight_rpcs_;
+void RuntimeFilterBank::AggregatorUpdateCompleteCb(AggregatorUpdate* update) {
+  const kudu::Status controller_status = update->controller->status();
+  if (controller_status.ok() && update->res.status().status_code() == TErrorCode::OK) {
+    DecrementNumInflightRpcs();
+    return;
   }
-  krpcs_done_cv_.notify_one();
+  // The aggregator did not merge the update, e.g. because it has not started executing
+  // the query yet or already finished it. The coordinator merges it instead.
+  LOG(INFO) << "UpdateFilterFromRemote() failed, sending filter "
+            << update->params.filter_id() << " to the coordinator: "
+            << (controller_status.ok() ? Status(update->res.status()).GetDetail() :
+                                         controller_status.message().ToString());
+  SendAggregatorUpdateToCoordinator(update);
+}
+
+void RuntimeFilterBank::SendFilterUpdate(
+    const UpdateFilterParamsPB& params, RpcController* controller) {
+  const TQueryCtx& query_ctx = query_state_->query_ctx();
+  unique_ptr<DataStreamServiceProxy> proxy;
+  Status get_proxy_status = DataStreamService::GetProxy(
+      query_ctx.coord_ip_address, query_ctx.coord_hostname, &proxy);
+  if (!get_proxy_status.ok()) {
+    // Failing to send a filter is not a query-wide error - the remote fragment will
+    // continue regardless.
+    LOG(INFO) << Substitute("Failed to get proxy to coordinator $0: $1",
+        query_ctx.coord_hostname, get_proxy_status.msg().msg());
+    DecrementNumInflightRpcs();
+    return;
+  }
+  UpdateFilterResultPB* res = obj_pool_.Add(new UpdateFilterResultPB);
+  proxy->UpdateFilterAsync(params, res, controller,
+      boost::bind(&RuntimeFilterBank::UpdateFilterCompleteCb, this, controller, res));
+}
+
+void RuntimeFilterBank::SendAggregatorUpdate(
+    const TRuntimeFilterAggDesc& aggregator, AggregatorUpdate* update) {
+  unique_ptr<DataStreamServiceProxy> proxy;
+  Status get_proxy_status = DataStreamService::GetProxy(
+      aggregator.krpc_address, aggregator.krpc_hostname, &proxy);
+  if (!get_proxy_status.ok()) {
+    LOG(INFO) << Substitute("Failed to get proxy to filter aggregator $0, sending filter "
+        "$1 to the coordinator: $2", aggregator.krpc_hostname, update->params.filter_id(),
+        get_proxy_status.msg().msg());
+    SendAggregatorUpdateToCoordinator(update);
+    return;
+  }
+  proxy->UpdateFilterFromRemoteAsync(update->params, &update->res, update->controller,
+      boost::bind(&RuntimeFilterBank::AggregatorUpdateCompleteCb, this, update));
+}
+
+void RuntimeFilterBank::SendAggregatorUpdateToCoordinator(AggregatorUpdate* update) {
+  // The sidecars of the failed RPC cannot be reused, so the Bloom filter directory is
+  // attached again. The filter stays valid as Close() waits for the in-flight RPC.
+  RpcController* controller = obj_pool_.Add(new RpcController);
+  if (update->params.has_bloom_filter()) {
+    BloomFilter::ToProtobuf(
+        update->bloom_filter, controller, update->params.mutable_bloom_filter());
+  }
+  SendFilterUpdate(update->params, controller);
 }
 
 void RuntimeFilterBank::UpdateFilterFromLocal(
@@ -254,54 +354,313 @@ void RuntimeFilterBank::UpdateFilterFromLocal(
 
   if (complete_filter != nullptr && has_remote_target &&
       query_state_->query_options().runtime_filter_mode == TRuntimeFilterMode::GLOBAL) {
-    UpdateFilterParamsPB params;
-    // The memory associated with the following 2 objects needs to live until
-    // the asynchronous KRPC call proxy->UpdateFilterAsync() is completed.
-    // Hence, we allocate these 2 objects in 'obj_pool_'.
-    UpdateFilterResultPB* res = obj_pool_.Add(new UpdateFilterResultPB);
-    RpcController* controller = obj_pool_.Add(new RpcController);
-
-    TUniqueIdToUniqueIdPB(query_state_->query_id(), params.mutable_query_id());
-    params.set_filter_id(filter_id);
+    if (fs->aggregated_filter != nullptr) {
+      // This backend aggregates the filter for a group of backends. The local filter
+      // only reaches the coordinator as part of the aggregated filter.
+      AggregateLocalFilter(fs, filter_id, bloom_filter, min_max_filter);
+      return;
+    }
+    // The memory associated with the following objects needs to live until
+    // the asynchronous KRPC call is completed. Hence, we allocate them in 'obj_pool_'.
+    AggregatorUpdate* update = obj_pool_.Add(new AggregatorUpdate);
+    update->controller = obj_pool_.Add(new RpcController);
+    UpdateFilterParamsPB* params = &update->params;
+    TUniqueIdToUniqueIdPB(query_state_->query_id(), params->mutable_query_id());
+    params->set_filter_id(filter_id);
     TRuntimeFilterType::type type = complete_filter->filter_desc().type;
     if (type == TRuntimeFilterType::BLOOM) {
-      BloomFilter::ToProtobuf(bloom_filter, controller, params.mutable_bloom_filter());
+      update->bloom_filter = bloom_filter;
+      BloomFilter::ToProtobuf(
+          bloom_filter, update->controller, params->mutable_bloom_filter());
     } else {
       DCHECK_EQ(type, TRuntimeFilterType::MIN_MAX);
-      min_max_filter->ToProtobuf(params.mutable_min_max_filter());
+      min_max_filter->ToProtobuf(params->mutable_min_max_filter());
+    }
+    // Increment 'num_inflight_rpcs_' to make sure that the filter will not be deallocated
+    // in Close() until all in-flight RPCs complete.
+    IncrementNumInflightRpcs(1);
+    if (fs->aggregator != nullptr) {
+      SendAggregatorUpdate(*fs->aggregator, update);
+    } else {
+      SendFilterUpdate(*params, update->controller);
+    }
+  }
+}
+
+void RuntimeFilterBank::AggregateLocalFilter(PerFilterState* fs, int32_t filter_id,
+    BloomFilter* bloom_filter, MinMaxFilter* min_max_filter) {
+  UpdateFilterParamsPB params;
+  RpcController* controller = nullptr;
+  {
+    lock_guard<SpinLock> l(fs->lock);
+    AggregatedFilter* agg = fs->aggregated_filter.get();
+    if (!agg->accepts_updates()) return;
+    RuntimeFilter* result_filter = fs->produced_filter.result_filter;
+    if (result_filter->is_bloom_filter()) {
+      BloomFilterPB local_filter;
+      if (bloom_filter == BloomFilter::ALWAYS_TRUE_FILTER) {
+        local_filter.set_always_true(true);
+        agg->AddBloomFilter(local_filter, nullptr, 0);
+      } else if (bloom_filter->AlwaysFalse()) {
+        local_filter.set_always_false(true);
+        agg->AddBloomFilter(local_filter, nullptr, 0);
+      } else {
+        kudu::BlockBloomFilter* block_bloom_filter = bloom_filter->GetBlockBloomFilter();
+        kudu::Slice directory = block_bloom_filter->directory();
+        local_filter.set_log_bufferpool_space(block_bloom_filter->log_space_bytes());
+        agg->AddBloomFilter(local_filter, directory.data(), directory.size());
+      }
+    } else {
+      DCHECK(result_filter->is_min_max_filter());
+      MinMaxFilterPB local_filter;
+      if (min_max_filter == nullptr) {
+        local_filter.set_always_true(true);
+      } else {
+        min_max_filter->ToProtobuf(&local_filter);
+      }
+      agg->AddMinMaxFilter(local_filter);
+    }
+    if (!FinishAggregatedUpdateLocked(fs, filter_id, &params, &controller)) return;
+  }
+  AddAggregatedDirectorySidecar(fs, &params, controller);
+  SendFilterUpdate(params, controller);
+}
+
+bool RuntimeFilterBank::FinishAggregatedUpdateLocked(PerFilterState* fs,
+    int32_t filter_id, UpdateFilterParamsPB* params, RpcController** controller) {
+  AggregatedFilter* agg = fs->aggregated_filter.get();
+  bool send = agg->FinishUpdate();
+  VLOG(3) << "Aggregated update for filter " << filter_id << ". "
+          << agg->pending_updates() << " updates left.";
+  if (!send) return false;
+  PrepareAggregatedUpdateLocked(fs, filter_id, params, controller);
+  return true;
+}
+
+void RuntimeFilterBank::PrepareAggregatedUpdateLocked(PerFilterState* fs,
+    int32_t filter_id, UpdateFilterParamsPB* params, RpcController** controller) {
+  AggregatedFilter* agg = fs->aggregated_filter.get();
+  DCHECK(agg->sent());
+  // Once sent, the aggregated filter is not modified anymore, so the directory can be
+  // read without holding 'fs->lock' and stays valid until Close().
+  *controller = obj_pool_.Add(new RpcController);
+  TUniqueIdToUniqueIdPB(query_state_->query_id(), params->mutable_query_id());
+  params->set_filter_id(filter_id);
+  params->set_num_aggregated_backends(agg->num_updates_merged());
+  if (fs->produced_filter.result_filter->is_bloom_filter()) {
+    *params->mutable_bloom_filter() = agg->bloom_filter();
+  } else {
+    MinMaxFilter::Copy(agg->min_max_filter(), params->mutable_min_max_filter());
+  }
+  // Counted while holding 'fs->lock' so that Close() waits for this RPC.
+  IncrementNumInflightRpcs(1);
+}
+
+void RuntimeFilterBank::AddAggregatedDirectorySidecar(
+    PerFilterState* fs, UpdateFilterParamsPB* params, RpcController* controller) {
+  if (!params->has_bloom_filter()) return;
+  BloomFilterPB* bloom_filter = params->mutable_bloom_filter();
+  if (bloom_filter->always_true() || bloom_filter->always_false()) return;
+  const string& directory = fs->aggregated_filter->bloom_filter_directory();
+  BloomFilter::AddCompressedDirectorySidecar(bloom_filter, controller,
+      reinterpret_cast<const uint8_t*>(directory.data()), directory.size());
+}
+
+bool RuntimeFilterBank::GetBloomFilterDirectory(const BloomFilterPB& bloom_filter,
+    RpcContext* context, kudu::Slice* sidecar, string* buffer, kudu::Slice* directory) {
+  DCHECK(bloom_filter.has_directory_sidecar_idx());
+  kudu::Status status =
+      context->GetInboundSidecar(bloom_filter.directory_sidecar_idx(), sidecar);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to get Bloom filter sidecar: " << status.message().ToString();
+    return false;
+  }
+  Status decompress_status =
+      BloomFilter::DecompressDirectory(bloom_filter, *sidecar, buffer, directory);
+  if (!decompress_status.ok()) {
+    LOG(ERROR) << "Failed to decompress Bloom filter: " << decompress_status.GetDetail();
+    return false;
+  }
+  return true;
+}
+
+Status RuntimeFilterBank::UpdateFilterFromRemote(
+    const UpdateFilterParamsPB& params, RpcContext* context) {
+  VLOG(3) << "UpdateFilterFromRemote(filter_id=" << params.filter_id() << ")";
+  auto it = filters_.find(params.filter_id());
+  DCHECK(it != filters_.end()) << "Filter ID " << params.filter_id() << " not registered";
+  PerFilterState* fs = it->second.get();
+  // Retrieve and decompress the Bloom filter directory before taking 'fs->lock'.
+  kudu::Slice sidecar_slice;
+  kudu::Slice directory;
+  string decompressed_directory;
+  bool has_directory = false;
+  if (params.has_bloom_filter() && !params.bloom_filter().always_true()
+      && !params.bloom_filter().always_false()) {
+    has_directory = GetBloomFilterDirectory(params.bloom_filter(), context,
+        &sidecar_slice, &decompressed_directory, &directory);
+  }
+  UpdateFilterParamsPB coord_params;
+  RpcController* controller = nullptr;
+  {
+    lock_guard<SpinLock> l(fs->lock);
+    AggregatedFilter* agg = fs->aggregated_filter.get();
+    if (agg == nullptr) {
+      DCHECK(false) << "Backend is not an aggregator for filter " << params.filter_id();
+      return Status(Substitute("Backend is not an aggregator for filter $0",
+          params.filter_id()));
+    }
+    if (!agg->accepts_updates()) {
+      return Status(Substitute("Filter $0 is not aggregated anymore on this backend",
+          params.filter_id()));
+    }
+    COUNTER_ADD(remote_filter_updates_received_, 1);
+    RuntimeFilter* result_filter = fs->produced_filter.result_filter;
+    if (result_filter->is_bloom_filter()) {
+      DCHECK(params.has_bloom_filter());
+      const BloomFilterPB& in = params.bloom_filter();
+      if (!in.always_true() && !in.always_false()) {
+        if (!has_directory) {
+          agg->Disable();
+        } else {
+          agg->AddBloomFilter(in, directory.data(), directory.size());
+        }
+      } else {
+        agg->AddBloomFilter(in, nullptr, 0);
+      }
+    } else {
+      DCHECK(params.has_min_max_filter());
+      agg->AddMinMaxFilter(params.min_max_filter());
+    }
+    if (!FinishAggregatedUpdateLocked(
+            fs, params.filter_id(), &coord_params, &controller)) {
+      return Status::OK();
     }
-    const TNetworkAddress& krpc_address = query_state_->query_ctx().coord_ip_address;
-    const std::string& hostname = query_state_->query_ctx().coord_hostname;
+  }
+  AddAggregatedDirectorySidecar(fs, &coord_params, controller);
+  SendFilterUpdate(coord_params, controller);
+  return Status::OK();
+}
 
-    // Use 'proxy' to send the filter to the coordinator.
+vector<std::pair<int, int>> RuntimeFilterBank::GetFanOutGroups(
+    int num_targets, int fanout) {
+  vector<std::pair<int, int>> groups;
+  if (num_targets <= 0) return groups;
+  DCHECK_GT(fanout, 0);
+  int num_groups = min(fanout, num_targets);
+  int min_group_size = num_targets / num_groups;
+  int num_larger_groups = num_targets % num_groups;
+  int begin = 0;
+  for (int i = 0; i < num_groups; ++i) {
+    int end = begin + min_group_size + (i < num_larger_groups ? 1 : 0);
+    groups.emplace_back(begin, end);
+    begin = end;
+  }
+  DCHECK_EQ(begin, num_targets);
+  return groups;
+}
+
+namespace {
+
+/// A PublishFilter() RPC that forwards a published filter to another backend. Owns
+/// everything that the RPC references and is deleted by ForwardFilterCompleteCb().
+struct ForwardedFilterRpc {
+  PublishFilterParamsPB params;
+  RpcController controller;
+  PublishFilterResultPB res;
+  /// The Bloom filter directory as received. Shared by the RPCs of one filter.
+  std::shared_ptr<const string> directory;
+};
+
+void ForwardFilterCompleteCb(ForwardedFilterRpc* rpc) {
+  unique_ptr<ForwardedFilterRpc> rpc_owner(rpc);
+  const kudu::Status controller_status = rpc->controller.status();
+  // As for filters published by the coordinator, failing to forward a filter is not a
+  // query-wide error. Consumers on the target backend stop waiting for it eventually.
+  if (!controller_status.ok()) {
+    LOG(ERROR) << "PublishFilter() failed: " << controller_status.message().ToString();
+  } else if (rpc->res.status().status_code() != TErrorCode::OK) {
+    VLOG_QUERY << "PublishFilter() failed: " << Status(rpc->res.status()).GetDetail();
+  }
+}
+
+} // anonymous namespace
+
+int RuntimeFilterBank::ForwardFilter(
+    const PublishFilterParamsPB& params, RpcContext* context) {
+  if (params.forward_targets_size() == 0) return 0;
+  shared_ptr<const string> directory;
+  bool directory_lost = false;
+  if (params.has_bloom_filter() && params.bloom_filter().has_directory_sidecar_idx()) {
+    kudu::Slice sidecar;
+    kudu::Status status = context->GetInboundSidecar(
+        params.bloom_filter().directory_sidecar_idx(), &sidecar);
+    if (status.ok()) {
+      directory = make_shared<const string>(sidecar.ToString());
+    } else {
+      LOG(ERROR) << "Failed to get Bloom filter sidecar: " << status.message().ToString();
+      directory_lost = true;
+    }
+  }
+  // The coordinator only sends forward targets if the fanout is at least 2.
+  DCHECK_GE(params.forward_fanout(), 2);
+  int fanout = max(params.forward_fanout(), 2);
+  const auto& targets = params.forward_targets();
+  int num_rpcs = 0;
+  for (const std::pair<int, int>& group : GetFanOutGroups(targets.size(), fanout)) {
+    const FilterForwardTargetPB& target = targets.Get(group.first);
     unique_ptr<DataStreamServiceProxy> proxy;
-    Status get_proxy_status = DataStreamService::GetProxy(krpc_address, hostname, &proxy);
+    Status get_proxy_status = DataStreamService::GetProxy(
+        FromNetworkAddressPB(target.krpc_address()), target.hostname(), &proxy);
     if (!get_proxy_status.ok()) {
-      // Failing to send a filter is not a query-wide error - the remote fragment will
-      // continue regardless.
-      LOG(INFO) << Substitute("Failed to get proxy to coordinator $0: $1", hostname,
-          get_proxy_status.msg().msg());
-      return;
+      LOG(INFO) << Substitute("Failed to get proxy to $0 for forwarding filter: $1",
+          target.hostname(), get_proxy_status.msg().msg());
+      continue;
     }
-    // Increment 'num_inflight_rpcs_' to make sure that the filter will not be deallocated
-    // in Close() until all in-flight RPCs complete.
-    {
-      unique_lock<SpinLock> l(num_inflight_rpcs_lock_);
-      DCHECK_GE(num_inflight_rpcs_, 0);
-      ++num_inflight_rpcs_;
+    ForwardedFilterRpc* rpc = new ForwardedFilterRpc();
+    rpc->params = params;
+    rpc->params.clear_forward_targets();
+    for (int i = group.first + 1; i < group.second; ++i) {
+      *rpc->params.add_forward_targets() = targets.Get(i);
     }
-
-    proxy->UpdateFilterAsync(params, res, controller,
-        boost::bind(&RuntimeFilterBank::UpdateFilterCompleteCb, this, controller, res));
+    if (directory_lost) {
+      // Same as in BloomFilter::AddDirectorySidecar(), 'disable' the filter.
+      BloomFilterPB* bloom_filter = rpc->params.mutable_bloom_filter();
+      bloom_filter->clear_directory_sidecar_idx();
+      bloom_filter->set_always_false(false);
+      bloom_filter->set_always_true(true);
+    } else if (directory != nullptr) {
+      // Forward the directory in the form it was received in, i.e. without
+      // decompressing and recompressing it.
+      rpc->directory = directory;
+      BloomFilter::AddDirectorySidecar(
+          rpc->params.mutable_bloom_filter(), &rpc->controller, *directory);
+    }
+    proxy->PublishFilterAsync(rpc->params, &rpc->res, &rpc->controller,
+        boost::bind(&ForwardFilterCompleteCb, rpc));
+    ++num_rpcs;
   }
+  return num_rpcs;
 }
 
 void RuntimeFilterBank::PublishGlobalFilter(
     const PublishFilterParamsPB& params, RpcContext* context) {
   VLOG(3) << "PublishGlobalFilter(filter_id=" << params.filter_id() << ")";
+  // The filter is forwarded even if this backend already finished the query, so that
+  // the backends below it in the fan-out tree receive it.
+  COUNTER_ADD(filters_forwarded_, ForwardFilter(params, context));
   auto it = filters_.find(params.filter_id());
   DCHECK(it != filters_.end()) << "Filter ID " << params.filter_id() << " not registered";
   PerFilterState* fs = it->second.get();
+  // Retrieve and decompress the Bloom filter directory before taking 'fs->lock'.
+  kudu::Slice sidecar_slice;
+  kudu::Slice directory;
+  string decompressed_directory;
+  bool has_directory = true;
+  if (params.has_bloom_filter() && params.bloom_filter().has_directory_sidecar_idx()) {
+    has_directory = GetBloomFilterDirectory(params.bloom_filter(), context,
+        &sidecar_slice, &decompressed_directory, &directory);
+  }
   lock_guard<SpinLock> l(fs->lock);
   if (closed_) return;
   if (fs->consumed_filter->HasFilter()) {
@@ -313,6 +672,11 @@ void RuntimeFilterBank::PublishGlobalFilter(
         << "Got duplicate partitioned join filter";
     return;
   }
+  SetConsumedFilterLocked(fs, params, has_directory ? &directory : nullptr);
+}
+
+void RuntimeFilterBank::SetConsumedFilterLocked(PerFilterState* fs,
+    const PublishFilterParamsPB& params, const kudu::Slice* directory) {
   BloomFilter* bloom_filter = nullptr;
   MinMaxFilter* min_max_filter = nullptr;
   if (fs->consumed_filter->is_bloom_filter()) {
@@ -327,22 +691,16 @@ void RuntimeFilterBank::PublishGlobalFilter(
              "allocation";
       bloom_filter = obj_pool_.Add(new BloomFilter(&buffer_pool_client_));
 
-      kudu::Slice sidecar_slice;
-      if (params.bloom_filter().has_directory_sidecar_idx()) {
-        kudu::Status status = context->GetInboundSidecar(
-            params.bloom_filter().directory_sidecar_idx(), &sidecar_slice);
-        if (!status.ok()) {
-          LOG(ERROR) << "Failed to get Bloom filter sidecar: "
-                     << status.message().ToString();
-          bloom_filter = BloomFilter::ALWAYS_TRUE_FILTER;
-        }
-      } else {
+      if (directory == nullptr) {
+        // The directory could not be retrieved, see GetBloomFilterDirectory().
+        bloom_filter = BloomFilter::ALWAYS_TRUE_FILTER;
+      } else if (!params.bloom_filter().has_directory_sidecar_idx()) {
         DCHECK(params.bloom_filter().always_false());
       }
 
       if (bloom_filter != BloomFilter::ALWAYS_TRUE_FILTER) {
-        Status status = bloom_filter->Init(params.bloom_filter(), sidecar_slice.data(),
-            sidecar_slice.size(), DefaultHashSeed());
+        Status status = bloom_filter->Init(params.bloom_filter(), directory->data(),
+            directory->size(), DefaultHashSeed());
         if (!status.ok()) {
           LOG(ERROR) << "Unable to allocate memory for bloom filter: "
                      << status.GetDetail();
@@ -425,11 +783,48 @@ void RuntimeFilterBank::CancelLocked() {
   // Cancel all filters that a thread might be waiting on.
   for (auto& entry : filters_) {
     if (entry.second->consumed_filter != nullptr) entry.second->consumed_filter->Cancel();
+    if (entry.second->aggregated_filter != nullptr) {
+      entry.second->aggregated_filter->Cancel();
+    }
   }
   cancelled_ = true;
 }
 
 void RuntimeFilterBank::Close() {
+  // Aggregated filters that were still waiting for updates from remote backends.
+  struct FlushedFilter {
+    PerFilterState* fs;
+    UpdateFilterParamsPB params;
+    RpcController* controller;
+  };
+  vector<FlushedFilter> flushed_filters;
+  {
+    // Unless the query was cancelled, send the updates merged so far for filters that
+    // this backend aggregates. The coordinator receives the missing updates directly
+    // from their backends, which this backend rejects from now on.
+    auto all_locks = LockAllFilters();
+    if (!cancelled_) {
+      for (auto& entry : filters_) {
+        PerFilterState* fs = entry.second.get();
+        if (fs->aggregated_filter == nullptr || !fs->aggregated_filter->Flush()) continue;
+        flushed_filters.push_back({fs, UpdateFilterParamsPB(), nullptr});
+        FlushedFilter& flushed = flushed_filters.back();
+        PrepareAggregatedUpdateLocked(
+            fs, entry.first, &flushed.params, &flushed.controller);
+      }
+    }
+    // Stop aggregating filter updates from remote backends, so that no new RPCs are
+    // issued while waiting for in-flight RPCs below.
+    CancelLocked();
+  }
+  for (FlushedFilter& flushed : flushed_filters) {
+    VLOG_QUERY << "Sending filter " << flushed.params.filter_id() << " with "
+               << flushed.params.num_aggregated_backends()
+               << " aggregated updates before closing the filter bank (query_id="
+               << PrintId(query_state_->query_id()) << ")";
+    AddAggregatedDirectorySidecar(flushed.fs, &flushed.params, flushed.controller);
+    SendFilterUpdate(flushed.params, flushed.controller);
+  }
   // Wait for all in-flight RPCs to complete before closing the filters.
   {
     unique_lock<SpinLock> l1(num_inflight_rpcs_lock_);
@@ -438,17 +833,19 @@ void RuntimeFilterBank::Close() {
     }
   }
   auto all_locks = LockAllFilters();
-  CancelLocked();
   // We do not have to set 'closed_' to true before waiting for all in-flight RPCs to
   // drain because the async build thread in
   // BlockingJoinNode::ProcessBuildInputAndOpenProbe() should have exited by the time
-  // Close() is called so there shouldn't be any new RPCs being issued when this function
-  // is called.
+  // Close() is called, and RPCs on behalf of remote backends are not issued once
+  // 'cancelled_' is set, so there shouldn't be any new RPCs being issued when this
+  // function is called.
   if (closed_) return;
   closed_ = true;
   for (auto& entry : filters_) {
     for (BloomFilter* filter : entry.second->bloom_filters) filter->Close();
     for (MinMaxFilter* filter : entry.second->min_max_filters) filter->Close();
+    AggregatedFilter* agg = entry.second->aggregated_filter.get();
+    if (agg != nullptr) agg->Close();
   }
   obj_pool_.Clear();
   if (buffer_pool_client_.is_registered()) {
@@ -466,6 +863,97 @@ RuntimeFilterBank::ProducedFilter::ProducedFilter(
     int pending_producers, RuntimeFilter* result_filter)
   : result_filter(result_filter), pending_producers(pending_producers) {}
 
-RuntimeFilterBank::PerFilterState::PerFilterState(
-    int pending_producers, RuntimeFilter* result_filter, RuntimeFilter* consumed_filter)
-  : produced_filter(pending_producers, result_filter), consumed_filter(consumed_filter) {}
+RuntimeFilterBank::AggregatedFilter::AggregatedFilter(int pending_updates,
+    bool is_bloom_filter, const ColumnType& type, MemTracker* mem_tracker)
+  : is_bloom_filter_(is_bloom_filter),
+    type_(type),
+    mem_tracker_(mem_tracker),
+    pending_updates_(pending_updates) {
+  DCHECK_GT(pending_updates, 0);
+  // The aggregated filter is a disjunction so the unit value is always_false.
+  bloom_filter_.set_always_false(true);
+  min_max_filter_.set_always_false(true);
+}
+
+void RuntimeFilterBank::AggregatedFilter::AddBloomFilter(
+    const BloomFilterPB& in, const uint8_t* directory, size_t directory_size) {
+  DCHECK(is_bloom_filter_);
+  DCHECK(accepts_updates());
+  if (bloom_filter_.always_true() || in.always_false()) return;
+  if (in.always_true()) {
+    // No need to wait for the other updates, the aggregated filter is always true.
+    Disable();
+    return;
+  }
+  DCHECK(directory != nullptr);
+  if (bloom_filter_.always_false()) {
+    if (!mem_tracker_->TryConsume(directory_size)) {
+      VLOG_QUERY << "Not enough memory to aggregate filter: "
+                 << PrettyPrinter::Print(directory_size, TUnit::BYTES);
+      // Disable, as one missing update means a correct filter cannot be produced.
+      Disable();
+      return;
+    }
+    bloom_filter_ = in;
+    bloom_filter_.clear_directory_sidecar_idx();
+    bloom_filter_.clear_directory_compression();
+    bloom_filter_directory_.assign(
+        reinterpret_cast<const char*>(directory), directory_size);
+  } else {
+    DCHECK_EQ(bloom_filter_directory_.size(), directory_size);
+    BloomFilter::Or(in, directory, &bloom_filter_,
+        reinterpret_cast<uint8_t*>(&bloom_filter_directory_[0]), directory_size);
+  }
+}
+
+void RuntimeFilterBank::AggregatedFilter::AddMinMaxFilter(const MinMaxFilterPB& in) {
+  DCHECK(!is_bloom_filter_);
+  DCHECK(accepts_updates());
+  if (min_max_filter_.always_false()) {
+    MinMaxFilter::Copy(in, &min_max_filter_);
+  } else {
+    MinMaxFilter::Or(in, &min_max_filter_, type_);
+  }
+}
+
+void RuntimeFilterBank::AggregatedFilter::Disable() {
+  DCHECK(!sent_);
+  bloom_filter_.set_always_true(true);
+  bloom_filter_.set_always_false(false);
+  min_max_filter_.set_always_true(true);
+  min_max_filter_.set_always_false(false);
+  FreeDirectory();
+}
+
+bool RuntimeFilterBank::AggregatedFilter::FinishUpdate() {
+  DCHECK(accepts_updates());
+  DCHECK_GT(pending_updates_, 0);
+  --pending_updates_;
+  ++num_updates_merged_;
+  if (pending_updates_ > 0 && !always_true()) return false;
+  sent_ = true;
+  return true;
+}
+
+bool RuntimeFilterBank::AggregatedFilter::Flush() {
+  if (!accepts_updates() || num_updates_merged_ == 0) return false;
+  sent_ = true;
+  return true;
+}
+
+void RuntimeFilterBank::AggregatedFilter::Close() {
+  FreeDirectory();
+}
+
+void RuntimeFilterBank::AggregatedFilter::FreeDirectory() {
+  mem_tracker_->Release(bloom_filter_directory_.size());
+  bloom_filter_directory_.clear();
+  bloom_filter_directory_.shrink_to_fit();
+}
+
+RuntimeFilterBank::PerFilterState::PerFilterState(int pending_producers,
+    RuntimeFilter* result_filter, RuntimeFilter* consumed_filter,
+    const TRuntimeFilterAggDesc* aggregator)
+  : produced_filter(pending_producers, result_filter),
+    consumed_filter(consumed_filter),
+    aggregator(aggregator) {}
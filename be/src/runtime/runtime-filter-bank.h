@@ -20,6 +20,8 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 #include "codegen/impala-ir.h"
 #include "common/object-pool.h"
@@ -39,6 +41,7 @@ namespace rpc {
 class RpcContext;
 class RpcController;
 } // namespace rpc
+class Slice;
 } // namespace kudu
 
 namespace impala {
@@ -49,8 +52,11 @@ class MinMaxFilter;
 class RuntimeFilter;
 class QueryState;
 class TBloomFilter;
+class TNetworkAddress;
+class TRuntimeFilterAggDesc;
 class TRuntimeFilterDesc;
 class TQueryCtx;
+class TQueryOptions;
 
 /// Metadata about each filter required to initialize the RuntimeFilterBank for a query
 /// running on a backend.
@@ -64,6 +70,15 @@ struct FilterRegistration {
 
   // The number of producers of this filter executing on the backend.
   int num_producers = 0;
+
+  // If non-NULL, the locally complete filter is sent to this intermediate aggregator
+  // instead of to the coordinator. Points into the fragment instance contexts owned by
+  // the QueryState.
+  const TRuntimeFilterAggDesc* aggregator = nullptr;
+
+  // If > 0, this backend is an intermediate aggregator for the filter and combines the
+  // locally complete filter with this many updates from other backends.
+  int num_remote_updates = 0;
 };
 
 /// RuntimeFilters are produced and consumed by plan nodes at run time to propagate
@@ -83,6 +98,22 @@ struct FilterRegistration {
 /// called. The expected number of filters to be produced locally must be specified ahead
 /// of time so that RuntimeFilterBank knows when the filter is complete.
 ///
+/// If the coordinator selected intermediate aggregators for a filter (see
+/// RUNTIME_FILTER_AGGREGATION_FANOUT), a backend either sends its locally complete filter
+/// to its aggregator rather than to the coordinator, or it is itself an aggregator and
+/// combines its local filter with the updates from other backends received through
+/// UpdateFilterFromRemote() before sending one update to the coordinator. Published
+/// filters may also carry a list of backends that this backend forwards the filter to,
+/// so that publication fans out through a tree instead of all originating from the
+/// coordinator.
+///
+/// An aggregator may not be able to merge an update, e.g. if the update arrives before
+/// the aggregator started executing the query or after it finished. The update is then
+/// sent to the coordinator directly, which counts every update for the producing
+/// backends whose filters it contains. An aggregator that finishes before all of the
+/// updates of its group arrived sends the ones it merged so far. Published filters are
+/// forwarded to the rest of the fan-out tree even by backends that already finished.
+///
 /// After PublishGlobalFilter() has been called (at most once per filter_id), the
 /// RuntimeFilter object associated with filter_id will have a valid bloom_filter or
 /// min_max_filter, and may be used for filter evaluation. This operation occurs
@@ -126,10 +157,37 @@ class RuntimeFilterBank {
       int32_t filter_id, BloomFilter* bloom_filter, MinMaxFilter* min_max_filter);
 
   /// Makes a bloom_filter (aggregated globally from all producer fragments) available for
-  /// consumption by operators that wish to use it for filtering.
+  /// consumption by operators that wish to use it for filtering. Forwards the filter to
+  /// the backends in 'params.forward_targets', if any, even if this filter bank was
+  /// already closed.
   void PublishGlobalFilter(
       const PublishFilterParamsPB& params, kudu::rpc::RpcContext* context);
 
+  /// Merges a filter update sent by another backend into the filter that this backend
+  /// aggregates as an intermediate aggregator. Sends the aggregated filter to the
+  /// coordinator once all expected updates have been received, or as soon as the
+  /// aggregated filter is known to be always true. Returns an error if the update
+  /// cannot be merged anymore because the aggregated filter was already sent or this
+  /// filter bank was cancelled or closed. The sender then sends the update to the
+  /// coordinator instead.
+  Status UpdateFilterFromRemote(const UpdateFilterParamsPB& params,
+      kudu::rpc::RpcContext* context) WARN_UNUSED_RESULT;
+
+  /// Forwards the filter published with 'params' to the backends in
+  /// 'params.forward_targets', splitting them into a fan-out tree with GetFanOutGroups().
+  /// The Bloom filter directory is forwarded in the form it was received in. The RPCs
+  /// own copies of everything they send, so they do not depend on the lifetime of a
+  /// filter bank or QueryState and are also used to forward filters of queries that
+  /// already finished on this backend. Returns the number of RPCs sent.
+  static int ForwardFilter(
+      const PublishFilterParamsPB& params, kudu::rpc::RpcContext* context);
+
+  /// Splits 'num_targets' backends that a filter is published to into at most 'fanout'
+  /// contiguous groups of nearly equal size. The first backend of each group receives
+  /// the filter directly and forwards it to the rest of its group, which it splits
+  /// recursively in the same way. Returns the [begin, end) index range of each group.
+  static std::vector<std::pair<int, int>> GetFanOutGroups(int num_targets, int fanout);
+
   /// Returns a bloom_filter that can be used by an operator to produce a local filter,
   /// which may then be used in UpdateFilterFromLocal(). The memory returned is owned by
   /// the RuntimeFilterBank and should not be deleted by the caller. The filter identified
@@ -145,6 +203,15 @@ class RuntimeFilterBank {
   /// Default hash seed to use when computing hashed values to insert into filters.
   static int32_t IR_ALWAYS_INLINE DefaultHashSeed() { return 1234; }
 
+  /// Returns the log (base 2) of the size in bytes that a Bloom filter of
+  /// 2^'log_space' bytes holding 'ndv' distinct values can be folded to while still
+  /// meeting the target false positive probability of the query, i.e. the
+  /// RUNTIME_FILTER_ERROR_RATE query option if set or --max_filter_error_rate otherwise.
+  /// Never returns less than log2(MIN_BLOOM_FILTER_SIZE). Returns 'log_space' if the
+  /// filter cannot be shrunk or if --fold_runtime_bloom_filters is false.
+  static int GetFoldedLogSpace(
+      const TQueryOptions& query_options, int64_t ndv, int log_space);
+
   /// Called to signal that the query is being cancelled. Wakes up any threads blocked
   /// waiting for filters to allow them to finish.
   void Cancel();
@@ -152,6 +219,92 @@ class RuntimeFilterBank {
   /// Releases all memory allocated for BloomFilters.
   void Close();
 
+  /// State of a filter that this backend aggregates on behalf of other backends. Like in
+  /// Coordinator::FilterState, the aggregated filter is kept in its serialized form so
+  /// that updates from remote backends can be merged without deserializing them.
+  /// Not thread-safe: the owner of the filter must serialize the calls.
+  class AggregatedFilter {
+   public:
+    /// 'pending_updates' is the number of updates to merge, including the locally
+    /// complete filter. 'type' is the column type of a min-max filter. The memory of the
+    /// aggregated Bloom filter directory is tracked by 'mem_tracker'.
+    AggregatedFilter(int pending_updates, bool is_bloom_filter, const ColumnType& type,
+        MemTracker* mem_tracker);
+
+    /// Merges a Bloom filter update. 'directory' must be non-NULL unless 'in' is always
+    /// true or always false. Disables the filter if memory for the aggregated directory
+    /// cannot be allocated.
+    void AddBloomFilter(
+        const BloomFilterPB& in, const uint8_t* directory, size_t directory_size);
+
+    /// Merges a min-max filter update.
+    void AddMinMaxFilter(const MinMaxFilterPB& in);
+
+    /// Makes the filter always true and releases the memory of its Bloom filter
+    /// directory. Used if an update is lost.
+    void Disable();
+
+    /// Counts an update merged with one of the methods above. Returns true if the
+    /// aggregated filter must be sent to the coordinator now, i.e. if no more updates are
+    /// expected or if it became always true, in which case it is marked as sent.
+    bool FinishUpdate();
+
+    /// Stops merging updates, e.g. because the query was cancelled.
+    void Cancel() { cancelled_ = true; }
+
+    /// Marks the updates merged so far as sent, for when this backend finishes before
+    /// all expected updates arrived. Returns false if there is nothing to send, i.e. if
+    /// the filter was already sent, was cancelled or no update was merged yet.
+    bool Flush();
+
+    /// False once the filter was sent or Cancel() was called. Updates must only be
+    /// merged while this is true.
+    bool accepts_updates() const { return !sent_ && !cancelled_; }
+
+    int pending_updates() const { return pending_updates_; }
+    int num_updates_merged() const { return num_updates_merged_; }
+    bool sent() const { return sent_; }
+    bool always_true() const {
+      return is_bloom_filter_ ? bloom_filter_.always_true() :
+                                min_max_filter_.always_true();
+    }
+
+    /// The aggregated filter. 'bloom_filter_directory()' is only non-empty if the Bloom
+    /// filter is neither always true nor always false. Once sent, the filter is not
+    /// modified anymore.
+    const BloomFilterPB& bloom_filter() const { return bloom_filter_; }
+    const std::string& bloom_filter_directory() const { return bloom_filter_directory_; }
+    const MinMaxFilterPB& min_max_filter() const { return min_max_filter_; }
+
+    /// Releases the memory of the Bloom filter directory.
+    void Close();
+
+   private:
+    /// Releases the memory of 'bloom_filter_directory_'.
+    void FreeDirectory();
+
+    const bool is_bloom_filter_;
+    const ColumnType type_;
+    MemTracker* const mem_tracker_;
+
+    /// The number of updates yet to be merged, including the locally complete filter.
+    int pending_updates_;
+
+    /// The number of updates merged so far, i.e. the number of producing backends whose
+    /// filters the aggregated filter contains.
+    int num_updates_merged_ = 0;
+
+    /// True once FinishUpdate() returned true.
+    bool sent_ = false;
+
+    /// True once Cancel() was called.
+    bool cancelled_ = false;
+
+    BloomFilterPB bloom_filter_;
+    std::string bloom_filter_directory_;
+    MinMaxFilterPB min_max_filter_;
+  };
+
   static const int64_t MIN_BLOOM_FILTER_SIZE = 4 * 1024;           // 4KB
   static const int64_t MAX_BLOOM_FILTER_SIZE = 512 * 1024 * 1024; // 512MB
 
@@ -168,6 +321,19 @@ class RuntimeFilterBank {
   /// Implementation of Cancel(). All filter locks must be held by caller.
   void CancelLocked();
 
+  /// An update of a locally complete filter that was sent to an intermediate aggregator.
+  /// Owned by 'obj_pool_'. Kept until the RPC completes so that the update can be sent
+  /// to the coordinator instead if the aggregator cannot merge it.
+  struct AggregatorUpdate {
+    UpdateFilterParamsPB params;
+    /// The locally complete Bloom filter whose directory is attached as a sidecar, or
+    /// nullptr if it is always true or a min-max filter. Owned by this filter bank.
+    BloomFilter* bloom_filter = nullptr;
+    /// Owned by 'obj_pool_'.
+    kudu::rpc::RpcController* controller = nullptr;
+    UpdateFilterResultPB res;
+  };
+
   /// Data tracked for each produced filter in the filter bank.
   struct ProducedFilter {
     ProducedFilter(int pending_producers, RuntimeFilter* result_filter);
@@ -196,8 +362,9 @@ class RuntimeFilterBank {
     ///   there are any producers. Must be owned by 'obj_pool_'.
     /// consumed_filter: the filter that will be returned to consumers. Non-NULL if there
     ///   are any consumers. Must be owned by 'obj_pool_'.
+    /// aggregator: see FilterRegistration::aggregator.
     PerFilterState(int pending_producers, RuntimeFilter* result_filter,
-        RuntimeFilter* consumed_filter);
+        RuntimeFilter* consumed_filter, const TRuntimeFilterAggDesc* aggregator);
 
     /// Lock protecting the structures in this PerFilterState. If multiple locks are
     /// acquired, they must be acquired in the 'filters_' map iteration order.
@@ -214,6 +381,14 @@ class RuntimeFilterBank {
     /// broadcast join filters.
     RuntimeFilter* const consumed_filter;
 
+    /// If non-NULL, the intermediate aggregator that the locally complete filter is sent
+    /// to instead of the coordinator.
+    const TRuntimeFilterAggDesc* const aggregator;
+
+    /// Non-NULL iff this backend is an intermediate aggregator for the filter, see
+    /// FilterRegistration::num_remote_updates. Set by the RuntimeFilterBank constructor.
+    std::unique_ptr<AggregatedFilter> aggregated_filter;
+
     /// Contains references to all the bloom filters generated. Used in Close() to safely
     /// release all memory allocated for BloomFilters.
     vector<BloomFilter*> bloom_filters;
@@ -260,6 +435,13 @@ class RuntimeFilterBank {
   /// Total amount of memory allocated to Bloom Filters
   RuntimeProfile::Counter* const bloom_memory_allocated_;
 
+  /// Number of filter updates received from other backends by this backend acting as an
+  /// intermediate aggregator.
+  RuntimeProfile::Counter* const remote_filter_updates_received_;
+
+  /// Number of published filters that this backend forwarded to other backends.
+  RuntimeProfile::Counter* const filters_forwarded_;
+
   /// Total amount of memory required by the bloom filters as calculated by the planner.
   const int64_t total_bloom_filter_mem_required_;
 
@@ -270,10 +452,75 @@ class RuntimeFilterBank {
   /// methods.
   BufferPool::ClientHandle buffer_pool_client_;
 
-  /// This is the callback for the asynchronous rpc UpdateFilterAsync() in
-  /// UpdateFilterFromLocal().
+  /// Increments 'num_inflight_rpcs_'. Must be called before issuing any RPC that
+  /// references memory owned by this filter bank.
+  void IncrementNumInflightRpcs(int num_rpcs);
+
+  /// Decrements 'num_inflight_rpcs_' and wakes up Close() if it is waiting.
+  void DecrementNumInflightRpcs();
+
+  /// Sends 'params' to the coordinator with UpdateFilter(). 'controller' must be owned by
+  /// 'obj_pool_'. The caller must have called IncrementNumInflightRpcs().
+  void SendFilterUpdate(
+      const UpdateFilterParamsPB& params, kudu::rpc::RpcController* controller);
+
+  /// Sends 'update' to the intermediate aggregator 'aggregator' with
+  /// UpdateFilterFromRemote(), or to the coordinator if no proxy to the aggregator can be
+  /// created. The caller must have called IncrementNumInflightRpcs().
+  void SendAggregatorUpdate(
+      const TRuntimeFilterAggDesc& aggregator, AggregatorUpdate* update);
+
+  /// Sends 'update', which an intermediate aggregator could not merge, to the
+  /// coordinator. Takes over the in-flight RPC of the failed update.
+  void SendAggregatorUpdateToCoordinator(AggregatorUpdate* update);
+
+  /// Merges the locally complete filter ('bloom_filter' or 'min_max_filter') into the
+  /// filter aggregated by this backend and sends it to the coordinator if complete.
+  void AggregateLocalFilter(PerFilterState* fs, int32_t filter_id,
+      BloomFilter* bloom_filter, MinMaxFilter* min_max_filter);
+
+  /// Counts an update merged into 'fs->aggregated_filter'. If no more updates are
+  /// expected or the aggregated filter became always true, prepares 'params' for
+  /// sending it to the coordinator with PrepareAggregatedUpdateLocked() and returns
+  /// true. Caller must hold 'fs->lock'.
+  bool FinishAggregatedUpdateLocked(PerFilterState* fs, int32_t filter_id,
+      UpdateFilterParamsPB* params, kudu::rpc::RpcController** controller);
+
+  /// Prepares 'params' for sending the sent 'fs->aggregated_filter' to the coordinator
+  /// with a new 'controller' owned by 'obj_pool_'. Caller must hold 'fs->lock'. The
+  /// Bloom filter directory is attached with AddAggregatedDirectorySidecar() after
+  /// releasing the lock.
+  void PrepareAggregatedUpdateLocked(PerFilterState* fs, int32_t filter_id,
+      UpdateFilterParamsPB* params, kudu::rpc::RpcController** controller);
+
+  /// Attaches the directory of the sent aggregated Bloom filter of 'fs' to 'controller',
+  /// compressing it if worthwhile. No-op for min-max and always true/false filters.
+  void AddAggregatedDirectorySidecar(PerFilterState* fs, UpdateFilterParamsPB* params,
+      kudu::rpc::RpcController* controller);
+
+  /// Retrieves the sidecar of 'bloom_filter' from 'context' into 'sidecar' and sets
+  /// 'directory' to its uncompressed directory, using 'buffer' to decompress it if
+  /// needed. Returns false and logs an error if the directory cannot be retrieved.
+  static bool GetBloomFilterDirectory(const BloomFilterPB& bloom_filter,
+      kudu::rpc::RpcContext* context, kudu::Slice* sidecar, std::string* buffer,
+      kudu::Slice* directory);
+
+  /// Deserializes the filter in 'params' and makes it available to the consumers of
+  /// 'fs->consumed_filter'. 'directory' is the uncompressed Bloom filter directory
+  /// (empty if there is no sidecar), or nullptr if it could not be retrieved, in which
+  /// case the filter is always true. Caller must hold 'fs->lock'.
+  void SetConsumedFilterLocked(PerFilterState* fs, const PublishFilterParamsPB& params,
+      const kudu::Slice* directory);
+
+  /// This is the callback for the asynchronous rpc UpdateFilterAsync() issued in
+  /// SendFilterUpdate().
   void UpdateFilterCompleteCb(
       const kudu::rpc::RpcController* rpc_controller, const UpdateFilterResultPB* res);
+
+  /// This is the callback for the asynchronous rpc UpdateFilterFromRemoteAsync() issued
+  /// in SendAggregatorUpdate(). Sends the update to the coordinator if the aggregator
+  /// could not merge it.
+  void AggregatorUpdateCompleteCb(AggregatorUpdate* update);
 };
 
 }
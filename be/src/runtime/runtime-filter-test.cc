@@ -19,9 +19,13 @@
 
 #include "common/init.h"
 #include "common/object-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/runtime-filter-bank.h"
 #include "runtime/runtime-filter.h"
 #include "runtime/runtime-filter.inline.h"
 #include "testutil/gtest-util.h"
+#include "util/bit-util.h"
+#include "util/min-max-filter.h"
 #include "util/stopwatch.h"
 
 #include "common/names.h"
@@ -100,4 +104,236 @@ TEST_F(RuntimeFilterTest, Arrived) {
   ASSERT_LT(sw.ElapsedTime(), (tc.injection_delay + tc.wait_for_ms) * 1000000);
 }
 
+// Test that the fan-out groups used to publish filters through a tree cover all targets
+// exactly once and are balanced.
+TEST_F(RuntimeFilterTest, FanOutGroups) {
+  EXPECT_TRUE(RuntimeFilterBank::GetFanOutGroups(0, 4).empty());
+  for (int num_targets : {1, 3, 4, 5, 16, 17, 200}) {
+    for (int fanout : {1, 2, 4, 16}) {
+      vector<std::pair<int, int>> groups =
+          RuntimeFilterBank::GetFanOutGroups(num_targets, fanout);
+      ASSERT_EQ(min(num_targets, fanout), static_cast<int>(groups.size()));
+      int expected_begin = 0;
+      int min_size = num_targets;
+      int max_size = 0;
+      for (const auto& group : groups) {
+        EXPECT_EQ(expected_begin, group.first);
+        EXPECT_LT(group.first, group.second);
+        min_size = min(min_size, group.second - group.first);
+        max_size = max(max_size, group.second - group.first);
+        expected_begin = group.second;
+      }
+      EXPECT_EQ(num_targets, expected_begin);
+      EXPECT_LE(max_size - min_size, 1);
+    }
+  }
+}
+
+// Size of the Bloom filter directories merged by the AggregatedFilter tests.
+static const int AGG_DIRECTORY_SIZE = 1024;
+
+// Returns a Bloom filter update whose directory has only byte 'byte_idx' set to 'val'.
+static BloomFilterPB MakeBloomFilterUpdate(int byte_idx, uint8_t val, string* directory) {
+  BloomFilterPB filter;
+  filter.set_log_bufferpool_space(BitUtil::Log2Ceiling64(AGG_DIRECTORY_SIZE));
+  directory->assign(AGG_DIRECTORY_SIZE, '\0');
+  (*directory)[byte_idx] = static_cast<char>(val);
+  return filter;
+}
+
+static void AddBloomFilter(RuntimeFilterBank::AggregatedFilter* agg,
+    const BloomFilterPB& filter, const string& directory) {
+  agg->AddBloomFilter(
+      filter, reinterpret_cast<const uint8_t*>(directory.data()), directory.size());
+}
+
+// Test that an aggregator merges the Bloom filter updates of other backends and of the
+// local producers and that the aggregated filter is only sent once all expected updates
+// were merged.
+TEST_F(RuntimeFilterTest, AggregatedBloomFilter) {
+  // Two remote updates and the locally complete filter.
+  RuntimeFilterBank::AggregatedFilter agg(
+      3, true, ColumnType(PrimitiveType::TYPE_INT), &tracker_);
+  EXPECT_TRUE(agg.bloom_filter().always_false());
+
+  string dir1;
+  AddBloomFilter(&agg, MakeBloomFilterUpdate(0, 0x01, &dir1), dir1);
+  EXPECT_FALSE(agg.FinishUpdate());
+  EXPECT_EQ(2, agg.pending_updates());
+  EXPECT_FALSE(agg.sent());
+  EXPECT_TRUE(agg.accepts_updates());
+  EXPECT_FALSE(agg.bloom_filter().always_false());
+  EXPECT_EQ(AGG_DIRECTORY_SIZE, tracker_.consumption());
+
+  // An always false update does not change the aggregated filter, but counts.
+  BloomFilterPB always_false;
+  always_false.set_always_false(true);
+  agg.AddBloomFilter(always_false, nullptr, 0);
+  EXPECT_FALSE(agg.FinishUpdate());
+  EXPECT_EQ(1, agg.pending_updates());
+
+  string dir2;
+  BloomFilterPB update = MakeBloomFilterUpdate(0, 0x10, &dir2);
+  dir2[AGG_DIRECTORY_SIZE - 1] = 0x20;
+  AddBloomFilter(&agg, update, dir2);
+  EXPECT_TRUE(agg.FinishUpdate());
+  EXPECT_EQ(0, agg.pending_updates());
+  EXPECT_TRUE(agg.sent());
+  EXPECT_FALSE(agg.accepts_updates());
+
+  // The sent filter is the disjunction of all updates.
+  EXPECT_FALSE(agg.bloom_filter().always_true());
+  EXPECT_FALSE(agg.bloom_filter().always_false());
+  EXPECT_FALSE(agg.bloom_filter().has_directory_sidecar_idx());
+  const string& directory = agg.bloom_filter_directory();
+  ASSERT_EQ(AGG_DIRECTORY_SIZE, directory.size());
+  EXPECT_EQ(0x11, static_cast<uint8_t>(directory[0]));
+  EXPECT_EQ(0x20, static_cast<uint8_t>(directory[AGG_DIRECTORY_SIZE - 1]));
+  for (int i = 1; i < AGG_DIRECTORY_SIZE - 1; ++i) EXPECT_EQ(0, directory[i]) << i;
+
+  agg.Close();
+  EXPECT_EQ(0, tracker_.consumption());
+}
+
+// Test that the aggregated filter is sent as soon as it becomes always true, without
+// waiting for the remaining updates, and that its directory memory is released.
+TEST_F(RuntimeFilterTest, AggregatedFilterAlwaysTrue) {
+  RuntimeFilterBank::AggregatedFilter agg(
+      4, true, ColumnType(PrimitiveType::TYPE_INT), &tracker_);
+  string dir;
+  AddBloomFilter(&agg, MakeBloomFilterUpdate(5, 0xff, &dir), dir);
+  EXPECT_FALSE(agg.FinishUpdate());
+  EXPECT_EQ(AGG_DIRECTORY_SIZE, tracker_.consumption());
+
+  BloomFilterPB always_true;
+  always_true.set_always_true(true);
+  agg.AddBloomFilter(always_true, nullptr, 0);
+  EXPECT_TRUE(agg.FinishUpdate());
+  EXPECT_EQ(2, agg.pending_updates());
+  EXPECT_TRUE(agg.sent());
+  EXPECT_TRUE(agg.always_true());
+  EXPECT_TRUE(agg.bloom_filter().always_true());
+  EXPECT_TRUE(agg.bloom_filter_directory().empty());
+  EXPECT_EQ(0, tracker_.consumption());
+
+  // A lost update disables the filter in the same way.
+  RuntimeFilterBank::AggregatedFilter lost(
+      2, true, ColumnType(PrimitiveType::TYPE_INT), &tracker_);
+  lost.Disable();
+  EXPECT_TRUE(lost.FinishUpdate());
+  EXPECT_TRUE(lost.bloom_filter().always_true());
+
+  // Memory for the aggregated directory that cannot be allocated disables the filter.
+  MemTracker limited_tracker(AGG_DIRECTORY_SIZE - 1);
+  RuntimeFilterBank::AggregatedFilter no_mem(
+      2, true, ColumnType(PrimitiveType::TYPE_INT), &limited_tracker);
+  AddBloomFilter(&no_mem, MakeBloomFilterUpdate(0, 1, &dir), dir);
+  EXPECT_TRUE(no_mem.FinishUpdate());
+  EXPECT_TRUE(no_mem.bloom_filter().always_true());
+  EXPECT_EQ(0, limited_tracker.consumption());
+  agg.Close();
+  lost.Close();
+  no_mem.Close();
+}
+
+// Test that min-max filter updates are merged and that an always true update is sent
+// right away.
+TEST_F(RuntimeFilterTest, AggregatedMinMaxFilter) {
+  ColumnType int_type(PrimitiveType::TYPE_INT);
+  RuntimeFilterBank::AggregatedFilter agg(2, false, int_type, &tracker_);
+  for (int32_t val : {10, 20}) {
+    MinMaxFilter* filter = MinMaxFilter::Create(int_type, &pool_, &tracker_);
+    filter->Insert(&val);
+    int32_t other_val = val + 5;
+    filter->Insert(&other_val);
+    MinMaxFilterPB update;
+    filter->ToProtobuf(&update);
+    filter->Close();
+    agg.AddMinMaxFilter(update);
+    EXPECT_EQ(val == 20, agg.FinishUpdate());
+  }
+  EXPECT_TRUE(agg.sent());
+  EXPECT_FALSE(agg.min_max_filter().always_false());
+  EXPECT_FALSE(agg.min_max_filter().always_true());
+  EXPECT_EQ(10, agg.min_max_filter().min().int_val());
+  EXPECT_EQ(25, agg.min_max_filter().max().int_val());
+
+  RuntimeFilterBank::AggregatedFilter always_true_agg(3, false, int_type, &tracker_);
+  MinMaxFilterPB always_true;
+  always_true.set_always_true(true);
+  always_true_agg.AddMinMaxFilter(always_true);
+  EXPECT_TRUE(always_true_agg.FinishUpdate());
+  EXPECT_TRUE(always_true_agg.min_max_filter().always_true());
+}
+
+// Test that a cancelled aggregator stops accepting updates and never sends its filter.
+TEST_F(RuntimeFilterTest, AggregatedFilterCancelled) {
+  RuntimeFilterBank::AggregatedFilter agg(
+      2, true, ColumnType(PrimitiveType::TYPE_INT), &tracker_);
+  string dir;
+  AddBloomFilter(&agg, MakeBloomFilterUpdate(0, 1, &dir), dir);
+  EXPECT_FALSE(agg.FinishUpdate());
+  agg.Cancel();
+  EXPECT_FALSE(agg.accepts_updates());
+  EXPECT_FALSE(agg.sent());
+  EXPECT_EQ(1, agg.pending_updates());
+  // The directory is still owned by the aggregator until it is closed.
+  EXPECT_EQ(AGG_DIRECTORY_SIZE, tracker_.consumption());
+  agg.Close();
+  EXPECT_EQ(0, tracker_.consumption());
+}
+
+// Test that an aggregator that finishes before all expected updates arrived sends the
+// updates merged so far and reports how many backends they cover, so that the
+// coordinator can wait for the rest to be sent to it directly.
+TEST_F(RuntimeFilterTest, AggregatedFilterFlush) {
+  RuntimeFilterBank::AggregatedFilter agg(
+      3, true, ColumnType(PrimitiveType::TYPE_INT), &tracker_);
+  // Nothing was merged yet, the producers send their updates to the coordinator.
+  EXPECT_FALSE(agg.Flush());
+  EXPECT_TRUE(agg.accepts_updates());
+
+  string dir1;
+  AddBloomFilter(&agg, MakeBloomFilterUpdate(0, 0x01, &dir1), dir1);
+  EXPECT_FALSE(agg.FinishUpdate());
+  string dir2;
+  AddBloomFilter(&agg, MakeBloomFilterUpdate(1, 0x02, &dir2), dir2);
+  EXPECT_FALSE(agg.FinishUpdate());
+  EXPECT_EQ(2, agg.num_updates_merged());
+
+  EXPECT_TRUE(agg.Flush());
+  EXPECT_TRUE(agg.sent());
+  EXPECT_FALSE(agg.accepts_updates());
+  EXPECT_EQ(1, agg.pending_updates());
+  EXPECT_EQ(2, agg.num_updates_merged());
+  const string& directory = agg.bloom_filter_directory();
+  ASSERT_EQ(AGG_DIRECTORY_SIZE, directory.size());
+  EXPECT_EQ(0x01, static_cast<uint8_t>(directory[0]));
+  EXPECT_EQ(0x02, static_cast<uint8_t>(directory[1]));
+  // The filter is only sent once.
+  EXPECT_FALSE(agg.Flush());
+
+  // An aggregator that sent its complete filter has nothing left to flush.
+  RuntimeFilterBank::AggregatedFilter complete(
+      1, true, ColumnType(PrimitiveType::TYPE_INT), &tracker_);
+  AddBloomFilter(&complete, MakeBloomFilterUpdate(0, 0x01, &dir1), dir1);
+  EXPECT_TRUE(complete.FinishUpdate());
+  EXPECT_EQ(1, complete.num_updates_merged());
+  EXPECT_FALSE(complete.Flush());
+
+  // Neither has a cancelled one.
+  RuntimeFilterBank::AggregatedFilter cancelled(
+      2, true, ColumnType(PrimitiveType::TYPE_INT), &tracker_);
+  AddBloomFilter(&cancelled, MakeBloomFilterUpdate(0, 0x01, &dir1), dir1);
+  EXPECT_FALSE(cancelled.FinishUpdate());
+  cancelled.Cancel();
+  EXPECT_FALSE(cancelled.Flush());
+  EXPECT_FALSE(cancelled.sent());
+
+  agg.Close();
+  complete.Close();
+  cancelled.Close();
+  EXPECT_EQ(0, tracker_.consumption());
+}
+
 } // namespace impala
@@ -48,7 +48,8 @@ class AdmissionControlClient {
       std::unique_ptr<QuerySchedulePB>* schedule_result) = 0;
 
   // Called when the query has completed to release all of its resources.
-  virtual void ReleaseQuery(int64_t peak_mem_consumption) = 0;
+  // 'query_succeeded' is true if the query returned all of its results.
+  virtual void ReleaseQuery(int64_t peak_mem_consumption, bool query_succeeded) = 0;
 
   // Called with a list of backends the query has completed on, to release the resources
   // for the query on those backends.
@@ -218,7 +218,7 @@ void AdmissionControlService::ReleaseQuery(const ReleaseQueryRequestPB* req,
     if (!admission_state->released) {
       AdmissiondEnv::GetInstance()->admission_controller()->ReleaseQuery(req->query_id(),
           admission_state->coord_id, req->peak_mem_consumption(),
-          /* release_remaining_backends */ true);
+          req->query_succeeded(), /* release_remaining_backends */ true);
       admission_state->released = true;
     } else {
       LOG(WARNING) << "Query " << req->query_id() << " was already released.";
@@ -286,6 +286,50 @@ void AdmissionControlService::AdmissionHeartbeat(const AdmissionHeartbeatRequest
     discard_result(admission_state_map_.Delete(query_id));
   }
 
+  for (const AdmissionLeaseUsagePB& usage : req->lease_usage()) {
+    vector<string> users(usage.users().begin(), usage.users().end());
+    if (AdmissiondEnv::GetInstance()->admission_controller()->UpdateLeaseUsage(
+            usage.lease_id(), req->host_id(), users)) {
+      *resp->add_revoked_lease_ids() = usage.lease_id();
+    }
+  }
+
+  RespondAndReleaseRpc(Status::OK(), resp, rpc_context);
+}
+
+void AdmissionControlService::AdmitLease(const AdmitLeaseRequestPB* req,
+    AdmitLeaseResponsePB* resp, kudu::rpc::RpcContext* rpc_context) {
+  VLOG(1) << "AdmitLease: lease_id=" << req->lease_id()
+          << " coordinator=" << req->coord_id() << " pool=" << req->request_pool();
+  shared_ptr<AdmissionState> admission_state =
+      make_shared<AdmissionState>(req->lease_id(), req->coord_id());
+  admission_state->summary_profile =
+      RuntimeProfile::Create(&admission_state->profile_pool, "Summary");
+  admission_state->request_pool = req->request_pool();
+
+  // Leases are registered like admitted queries so that ReleaseQuery(), the heartbeat
+  // and the failed coordinator detection release them.
+  lock_guard<mutex> l(admission_state->lock);
+  RESPOND_IF_ERROR(admission_state_map_.Add(req->lease_id(), admission_state));
+  string executor_group;
+  vector<NetworkAddressPB> backends;
+  int32_t max_queries;
+  Status status = AdmissiondEnv::GetInstance()->admission_controller()->AdmitLease(
+      req->lease_id(), req->coord_id(), req->request_pool(), req->mem_per_backend(),
+      req->slots_per_backend(), &executor_group, &backends, &max_queries);
+  if (!status.ok()) {
+    discard_result(admission_state_map_.Delete(req->lease_id()));
+    RespondAndReleaseRpc(status, resp, rpc_context);
+    return;
+  }
+  admission_state->submitted = true;
+  admission_state->admission_done = true;
+  resp->set_executor_group(executor_group);
+  resp->set_max_queries(max_queries);
+  for (const NetworkAddressPB& backend : backends) {
+    admission_state->unreleased_backends.insert(backend);
+    *resp->add_backends() = backend;
+  }
   RespondAndReleaseRpc(Status::OK(), resp, rpc_context);
 }
 
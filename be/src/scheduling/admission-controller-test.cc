@@ -28,11 +28,16 @@
 #include "service/impala-server.h"
 #include "testutil/gtest-util.h"
 #include "util/metrics.h"
+#include "util/time.h"
 #include <regex>
 
 // Access the flags that are defined in RequestPoolService.
 DECLARE_string(fair_scheduler_allocation_path);
 DECLARE_string(llama_site_path);
+DECLARE_bool(admission_control_use_memory_history);
+DECLARE_bool(admission_control_fair_share);
+DECLARE_int32(admission_control_backfill_depth);
+DECLARE_double(admission_control_backfill_max_mem_fraction);
 
 namespace impala {
 
@@ -147,6 +152,45 @@ class AdmissionControllerTest : public testing::Test {
     }
   }
 
+  /// Make a QueueNode for a query of 'user' with id 'query_id_lo' to 'pool_name' that
+  /// is scheduled on 'num_hosts' hosts of 'executor_group' with 'per_host_mem_estimate'.
+  /// The node is marked as scheduled with 'membership_snapshot', so that admission
+  /// attempts with that snapshot use its schedule instead of calling the scheduler.
+  AdmissionController::QueueNode* MakeQueueNode(int64_t query_id_lo,
+      const string& pool_name, const string& user, int num_hosts,
+      int64_t per_host_mem_estimate, const ExecutorGroup& executor_group,
+      ClusterMembershipMgr::SnapshotPtr membership_snapshot) {
+    TQueryExecRequest* request = pool_.Add(new TQueryExecRequest());
+    request->query_ctx.request_pool = pool_name;
+    request->__set_per_host_mem_estimate(per_host_mem_estimate);
+    request->__set_dedicated_coord_mem_estimate(per_host_mem_estimate);
+    request->__set_stmt_type(TStmtType::QUERY);
+    UniqueIdPB* query_id = pool_.Add(new UniqueIdPB());
+    query_id->set_lo(query_id_lo);
+    UniqueIdPB* coord_id = pool_.Add(new UniqueIdPB());
+    TQueryOptions* query_options = pool_.Add(new TQueryOptions());
+    RuntimeProfile* profile = RuntimeProfile::Create(&pool_, "pool1");
+    auto* blacklisted_executor_addresses =
+        pool_.Add(new std::unordered_set<NetworkAddressPB>());
+    auto* admit_outcome = pool_.Add(
+        new Promise<AdmissionOutcome, PromiseMode::MULTIPLE_PRODUCER>());
+    AdmissionController::QueueNode* node =
+        pool_.Add(new AdmissionController::QueueNode(
+            {*query_id, *coord_id, *request, *query_options, profile,
+                *blacklisted_executor_addresses},
+            admit_outcome, profile));
+    node->pool_name = pool_name;
+    node->user = user;
+    node->wait_start_ms = MonotonicMillis();
+    node->membership_snapshot = membership_snapshot;
+    unique_ptr<ScheduleState> state = make_unique<ScheduleState>(
+        *query_id, *request, *query_options, profile, true);
+    state->set_executor_group(executor_group.name());
+    SetHostsInScheduleState(*state, num_hosts, false);
+    node->group_states.emplace_back(std::move(state), executor_group);
+    return node;
+  }
+
   /// Extract the host network addresses from 'schedule'.
   vector<NetworkAddressPB> GetHostAddrs(const ScheduleState& schedule_state) {
     vector<NetworkAddressPB> host_addrs;
@@ -701,6 +745,161 @@ TEST_F(AdmissionControllerTest, GetMaxToDequeue) {
   ASSERT_EQ(5, max_to_dequeue);
 }
 
+/// Test parsing of the pool weights used for fair sharing.
+TEST_F(AdmissionControllerTest, ParsePoolWeights) {
+  std::unordered_map<string, double> weights;
+  ASSERT_OK(AdmissionController::ParsePoolWeights("", &weights));
+  EXPECT_TRUE(weights.empty());
+  ASSERT_OK(AdmissionController::ParsePoolWeights(
+      "root.etl:1, root.interactive:4,root.adhoc:0.5", &weights));
+  EXPECT_EQ(3, weights.size());
+  EXPECT_EQ(1, weights["root.etl"]);
+  EXPECT_EQ(4, weights["root.interactive"]);
+  EXPECT_EQ(0.5, weights["root.adhoc"]);
+  EXPECT_FALSE(AdmissionController::ParsePoolWeights("root.etl", &weights).ok());
+  EXPECT_FALSE(AdmissionController::ParsePoolWeights(":2", &weights).ok());
+  EXPECT_FALSE(AdmissionController::ParsePoolWeights("root.etl:0", &weights).ok());
+  EXPECT_FALSE(AdmissionController::ParsePoolWeights("root.etl:x", &weights).ok());
+}
+
+/// Test that with fair sharing pools are dequeued in the order of the memory they hold
+/// relative to their weight, and that within a pool the oldest query of the user with
+/// the fewest running queries is dequeued first.
+TEST_F(AdmissionControllerTest, FairShareDequeueOrder) {
+  AdmissionController* admission_controller = MakeAdmissionController();
+  TPoolConfig config;
+  for (const string& pool_name : {QUEUE_A, QUEUE_B, QUEUE_C}) {
+    admission_controller->pool_config_map_[pool_name] = config;
+    admission_controller->GetPoolStats(pool_name);
+  }
+  // QUEUE_A holds twice as much memory as QUEUE_B but has four times its weight.
+  admission_controller->GetPoolStats(QUEUE_A)->agg_mem_reserved_ = 400 * MEGABYTE;
+  admission_controller->GetPoolStats(QUEUE_B)->agg_mem_reserved_ = 200 * MEGABYTE;
+  // The memory admitted by this coordinator counts if the aggregate is stale.
+  admission_controller->GetPoolStats(QUEUE_C)->local_mem_admitted_ = 150 * MEGABYTE;
+  admission_controller->pool_weights_[QUEUE_A] = 4;
+
+  FLAGS_admission_control_fair_share = true;
+  vector<string> pool_order;
+  for (const auto* entry : admission_controller->GetPoolsInDequeueOrder()) {
+    pool_order.push_back(entry->first);
+  }
+  EXPECT_EQ(vector<string>({QUEUE_A, QUEUE_C, QUEUE_B}), pool_order);
+
+  // A pool that is given less weight falls behind.
+  admission_controller->pool_weights_[QUEUE_C] = 0.5;
+  pool_order.clear();
+  for (const auto* entry : admission_controller->GetPoolsInDequeueOrder()) {
+    pool_order.push_back(entry->first);
+  }
+  EXPECT_EQ(vector<string>({QUEUE_A, QUEUE_B, QUEUE_C}), pool_order);
+
+  // Queue queries of three users. 'alice' runs two queries and 'bob' one.
+  auto snapshot = std::make_shared<ClusterMembershipMgr::Snapshot>();
+  snapshot->version = 1;
+  ExecutorGroup* group =
+      pool_.Add(new ExecutorGroup(ImpalaServer::DEFAULT_EXECUTOR_GROUP_NAME));
+  AdmissionController::RequestQueue& queue =
+      admission_controller->request_queue_map_[QUEUE_C];
+  AdmissionController::QueueNode* alice_1 =
+      MakeQueueNode(1, QUEUE_C, "alice", 1, MEGABYTE, *group, snapshot);
+  AdmissionController::QueueNode* bob_1 =
+      MakeQueueNode(2, QUEUE_C, "bob", 1, MEGABYTE, *group, snapshot);
+  AdmissionController::QueueNode* bob_2 =
+      MakeQueueNode(3, QUEUE_C, "bob", 1, MEGABYTE, *group, snapshot);
+  queue.Enqueue(alice_1);
+  queue.Enqueue(bob_1);
+  queue.Enqueue(bob_2);
+  admission_controller->num_running_per_pool_user_[QUEUE_C]["alice"] = 2;
+  admission_controller->num_running_per_pool_user_[QUEUE_C]["bob"] = 1;
+  EXPECT_EQ(bob_1, admission_controller->GetNextToDequeue(&queue, QUEUE_C));
+
+  // A user without running queries goes first, even if queued last.
+  AdmissionController::QueueNode* carol_1 =
+      MakeQueueNode(4, QUEUE_C, "carol", 1, MEGABYTE, *group, snapshot);
+  queue.Enqueue(carol_1);
+  EXPECT_EQ(carol_1, admission_controller->GetNextToDequeue(&queue, QUEUE_C));
+
+  // Without fair sharing the queue is first-in first-out.
+  FLAGS_admission_control_fair_share = false;
+  EXPECT_EQ(alice_1, admission_controller->GetNextToDequeue(&queue, QUEUE_C));
+  while (!queue.empty()) queue.Dequeue();
+}
+
+/// Test that small queries queued behind a query that does not fit into the free memory
+/// are backfilled, up to the configured fraction of the memory of the blocked query.
+TEST_F(AdmissionControllerTest, BackfillQueries) {
+  FLAGS_admission_control_backfill_depth = 4;
+  FLAGS_admission_control_backfill_max_mem_fraction = 0.5;
+  AdmissionController* admission_controller = MakeAdmissionController();
+  TPoolConfig config;
+  config.max_requests = 10;
+  config.max_queued = 10;
+  config.max_mem_resources = 10 * GIGABYTE;
+  admission_controller->pool_config_map_[QUEUE_C] = config;
+  AdmissionController::PoolStats* stats = admission_controller->GetPoolStats(QUEUE_C);
+
+  // Both hosts have 50MB of their 200MB free.
+  for (const string& host : {HOST_0, HOST_1}) {
+    admission_controller->host_stats_[host].mem_admitted = 150 * MEGABYTE;
+  }
+
+  auto snapshot = std::make_shared<ClusterMembershipMgr::Snapshot>();
+  snapshot->version = 1;
+  ExecutorGroup* group =
+      pool_.Add(new ExecutorGroup(ImpalaServer::DEFAULT_EXECUTOR_GROUP_NAME));
+  AdmissionController::RequestQueue& queue =
+      admission_controller->request_queue_map_[QUEUE_C];
+  // The head of the queue needs 200MB across the cluster, so up to 100MB can be
+  // backfilled. The second query does not fit either, the next two fit and use up 80MB
+  // of the budget, which leaves not enough for the last one.
+  vector<AdmissionController::QueueNode*> nodes;
+  for (int64_t per_host_mem : {100, 60, 20, 20, 20}) {
+    nodes.push_back(MakeQueueNode(nodes.size() + 1, QUEUE_C, "alice", 2,
+        per_host_mem * MEGABYTE, *group, snapshot));
+    queue.Enqueue(nodes.back());
+    stats->Queue();
+  }
+
+  AdmissionController::QueueNode* head = queue.head();
+  ASSERT_EQ(nodes[0], head);
+  bool coordinator_resource_limited = false;
+  ASSERT_TRUE(admission_controller->FindGroupToAdmitOrReject(snapshot, config,
+      /* admit_from_queue=*/true, stats, head, coordinator_resource_limited));
+  ASSERT_TRUE(head->admitted_schedule == nullptr);
+
+  EXPECT_EQ(2,
+      admission_controller->BackfillQueries(snapshot, config, stats, &queue, head, 10));
+  EXPECT_EQ(3, queue.size());
+  EXPECT_EQ(head, queue.head());
+  EXPECT_FALSE(head->admit_outcome->IsSet());
+  EXPECT_FALSE(nodes[1]->admit_outcome->IsSet());
+  EXPECT_EQ(AdmissionOutcome::ADMITTED, nodes[2]->admit_outcome->Get());
+  EXPECT_EQ(AdmissionOutcome::ADMITTED, nodes[3]->admit_outcome->Get());
+  EXPECT_FALSE(nodes[4]->admit_outcome->IsSet());
+  EXPECT_EQ(80 * MEGABYTE, head->backfilled_mem);
+  EXPECT_EQ(2, stats->metrics()->total_backfilled->GetValue());
+  EXPECT_EQ(3, stats->local_stats().num_queued);
+  EXPECT_EQ(190 * MEGABYTE, admission_controller->host_stats_[HOST_0].mem_admitted);
+  EXPECT_EQ(2, admission_controller->num_running_per_pool_user_[QUEUE_C]["alice"]);
+
+  // The budget is not reset while the head stays blocked, so the last query is not
+  // backfilled even after memory was freed up for it.
+  for (const string& host : {HOST_0, HOST_1}) {
+    admission_controller->host_stats_[host].mem_admitted = 0;
+  }
+  EXPECT_EQ(0,
+      admission_controller->BackfillQueries(snapshot, config, stats, &queue, head, 10));
+  EXPECT_EQ(3, queue.size());
+
+  // At most 'max_to_admit' queries are backfilled.
+  head->backfilled_mem = 0;
+  EXPECT_EQ(0,
+      admission_controller->BackfillQueries(snapshot, config, stats, &queue, head, 0));
+  EXPECT_EQ(3, queue.size());
+  while (!queue.empty()) queue.Dequeue();
+}
+
 /// Test that RequestPoolService correctly reads configuration files.
 TEST_F(AdmissionControllerTest, Config) {
   // Pass the paths of the configuration files as command line flags
@@ -847,6 +1046,74 @@ TEST_F(AdmissionControllerTest, DedicatedCoordScheduleState) {
   ASSERT_EQ(700 * MEGABYTE, schedule_state->coord_backend_mem_limit());
 }
 
+// Test that only the peak memory of queries that returned all of their results is
+// added to the memory history, and that the estimate from the history is capped at the
+// MEM_LIMIT_EXECUTORS query option.
+TEST_F(AdmissionControllerTest, MemoryHistory) {
+  FLAGS_admission_control_use_memory_history = true;
+  AdmissionController* admission_controller = MakeAdmissionController();
+  RequestPoolService* request_pool_service = admission_controller->request_pool_service_;
+  TPoolConfig pool_config;
+  ASSERT_OK(request_pool_service->GetPoolConfig("default", &pool_config));
+  const uint64_t SIGNATURE = 42;
+  UniqueIdPB coord_id;
+  coord_id.set_hi(1);
+  int next_query_id = 0;
+  auto release_query = [&](int64_t peak_mem, bool query_succeeded) {
+    UniqueIdPB query_id;
+    query_id.set_lo(++next_query_id);
+    AdmissionController::RunningQuery& running_query =
+        admission_controller->running_queries_[coord_id][query_id];
+    running_query.request_pool = "default";
+    running_query.memory_signature = SIGNATURE;
+    admission_controller->num_released_backends_[query_id] = 0;
+    admission_controller->ReleaseQuery(query_id, coord_id, peak_mem, query_succeeded);
+  };
+
+  // Failed and cancelled queries are not recorded.
+  int64_t mem_estimate;
+  for (int i = 0; i < 5; ++i) release_query(GIGABYTE, false);
+  EXPECT_FALSE(admission_controller->memory_history_.GetMemEstimate(
+      SIGNATURE, &mem_estimate));
+  // Neither are queries whose peak memory is unknown.
+  release_query(-1, true);
+  for (int i = 0; i < 2; ++i) release_query(100 * MEGABYTE, true);
+  EXPECT_FALSE(admission_controller->memory_history_.GetMemEstimate(
+      SIGNATURE, &mem_estimate));
+  release_query(100 * MEGABYTE, true);
+  ASSERT_TRUE(admission_controller->memory_history_.GetMemEstimate(
+      SIGNATURE, &mem_estimate));
+  EXPECT_GE(mem_estimate, 100 * MEGABYTE);
+  EXPECT_LT(mem_estimate, GIGABYTE);
+
+  // The estimate from the history replaces the planner's estimate.
+  ScheduleState* schedule_state =
+      MakeScheduleState("default", 0, pool_config, 2, GIGABYTE, GIGABYTE, false);
+  schedule_state->set_mem_estimate_from_history(mem_estimate);
+  schedule_state->UpdateMemoryRequirements(pool_config);
+  EXPECT_TRUE(schedule_state->UsesMemEstimateFromHistory());
+  EXPECT_EQ(mem_estimate, schedule_state->per_backend_mem_to_admit());
+  EXPECT_EQ(mem_estimate, schedule_state->coord_backend_mem_to_admit());
+
+  // It is capped at MEM_LIMIT_EXECUTORS.
+  TQueryExecRequest* request = pool_.Add(new TQueryExecRequest());
+  request->query_ctx.request_pool = "default";
+  request->__set_per_host_mem_estimate(GIGABYTE);
+  request->__set_dedicated_coord_mem_estimate(GIGABYTE);
+  request->__set_stmt_type(TStmtType::QUERY);
+  TQueryOptions* query_options = pool_.Add(new TQueryOptions());
+  query_options->__set_mem_limit_executors(50 * MEGABYTE);
+  UniqueIdPB* query_id = pool_.Add(new UniqueIdPB());
+  schedule_state = pool_.Add(new ScheduleState(*query_id, *request, *query_options,
+      RuntimeProfile::Create(&pool_, "pool1"), true));
+  SetHostsInScheduleState(*schedule_state, 2, false);
+  schedule_state->set_mem_estimate_from_history(mem_estimate);
+  schedule_state->UpdateMemoryRequirements(pool_config);
+  EXPECT_EQ(50 * MEGABYTE, schedule_state->mem_estimate_from_history());
+  EXPECT_EQ(50 * MEGABYTE, schedule_state->per_backend_mem_to_admit());
+  EXPECT_EQ(50 * MEGABYTE, schedule_state->coord_backend_mem_to_admit());
+}
+
 // Test admission decisions for clusters with dedicated coordinators, where different
 // amounts of memory should be admitted on coordinators and executors.
 TEST_F(AdmissionControllerTest, DedicatedCoordAdmissionChecks) {
@@ -17,6 +17,8 @@
 
 #include "scheduling/admission-controller.h"
 
+#include <limits>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/mem_fn.hpp>
 #include <gutil/strings/stringpiece.h>
@@ -31,12 +33,14 @@
 #include "scheduling/schedule-state.h"
 #include "scheduling/scheduler.h"
 #include "service/impala-server.h"
+#include "util/auth-util.h"
 #include "util/bit-util.h"
 #include "util/debug-util.h"
 #include "util/metrics.h"
 #include "util/pretty-printer.h"
 #include "util/runtime-profile-counters.h"
 #include "util/scope-exit-trigger.h"
+#include "util/string-parser.h"
 #include "util/thread.h"
 #include "util/time.h"
 #include "util/uid-util.h"
@@ -60,8 +64,44 @@ DEFINE_int64_hidden(admission_control_stale_topic_threshold_ms, 5 * 1000,
     "capture most cases where the Impala daemon is disconnected from the statestore "
     "or topic updates are seriously delayed.");
 
+DEFINE_bool(admission_control_use_memory_history, false, "(Advanced) If true, queries "
+    "without a mem_limit are admitted based on the per-host peak memory that earlier "
+    "queries with the same plan actually consumed, instead of the planner's memory "
+    "estimate. Queries with plans that have not run often enough yet use the estimate.");
+DEFINE_double(admission_control_memory_history_percentile, 95, "(Advanced) Percentile "
+    "of the recent per-host peak memory consumption of queries with the same plan that "
+    "is admitted if --admission_control_use_memory_history is true.");
+DEFINE_double(admission_control_memory_history_safety_margin, 0.2, "(Advanced) "
+    "Fraction by which the memory from --admission_control_memory_history_percentile "
+    "is increased before admitting it.");
+DEFINE_bool(admission_control_fair_share, false, "(Advanced) If true, queued queries "
+    "are dequeued in weighted fair order instead of strictly first-in first-out: pools "
+    "holding the least memory relative to their weight are served first, and within a "
+    "pool the oldest query of the user with the fewest running queries is dequeued "
+    "next.");
+DEFINE_string(admission_control_pool_weights, "", "(Advanced) Comma-separated list of "
+    "<pool name>:<weight> pairs used with --admission_control_fair_share. Pools that are "
+    "not listed have a weight of 1.");
+DEFINE_int32(admission_control_backfill_depth, 0, "(Advanced) If the next queued query "
+    "of a pool cannot be admitted, up to this many queries behind it are admitted if "
+    "they fit into the free resources and are small compared to the blocked query, see "
+    "--admission_control_backfill_max_mem_fraction. 0 disables backfilling.");
+DEFINE_double(admission_control_backfill_max_mem_fraction, 0.1, "(Advanced) Maximum "
+    "total memory of the queries that are backfilled while a query is blocked, as a "
+    "fraction of the memory that the blocked query needs.");
+
 namespace impala {
 
+// Number of queued queries of a pool that are considered when picking the next query to
+// dequeue with --admission_control_fair_share.
+static const int FAIR_SHARE_MAX_CANDIDATES = 100;
+
+// Bounds on the QueryMemoryHistory of the admission controller and the number of
+// samples that a plan needs before its history is used.
+static const int MEMORY_HISTORY_MAX_SIGNATURES = 10000;
+static const int MEMORY_HISTORY_SAMPLES_PER_SIGNATURE = 20;
+static const int MEMORY_HISTORY_MIN_SAMPLES = 3;
+
 const int64_t AdmissionController::PoolStats::HISTOGRAM_NUM_OF_BINS = 128;
 const int64_t AdmissionController::PoolStats::HISTOGRAM_BIN_SIZE = 1024L * 1024L * 1024L;
 const double AdmissionController::PoolStats::EMA_MULTIPLIER = 0.2;
@@ -87,6 +127,8 @@ const string EXEC_GROUP_QUERY_LOAD_KEY_FORMAT =
 
 const string TOTAL_DEQUEUE_FAILED_COORDINATOR_LIMITED =
   "admission-controller.total-dequeue-failed-coordinator-limited";
+const string TOTAL_ADMITTED_WITH_MEMORY_HISTORY =
+  "admission-controller.total-admitted-with-memory-history";
 
 // Define metric key format strings for metrics in PoolMetrics
 // '$0' is replaced with the pool name by strings::Substitute
@@ -104,6 +146,10 @@ const string TOTAL_RELEASED_METRIC_KEY_FORMAT =
   "admission-controller.total-released.$0";
 const string TIME_IN_QUEUE_METRIC_KEY_FORMAT =
   "admission-controller.time-in-queue-ms.$0";
+const string TOTAL_BACKFILLED_METRIC_KEY_FORMAT =
+  "admission-controller.total-backfilled.$0";
+const string BACKFILL_TIME_IN_QUEUE_METRIC_KEY_FORMAT =
+  "admission-controller.backfill-time-in-queue-ms.$0";
 const string AGG_NUM_RUNNING_METRIC_KEY_FORMAT =
   "admission-controller.agg-num-running.$0";
 const string AGG_NUM_QUEUED_METRIC_KEY_FORMAT =
@@ -143,6 +189,8 @@ const string AdmissionController::PROFILE_INFO_VAL_QUEUED = "Queued";
 const string AdmissionController::PROFILE_INFO_VAL_CANCELLED_IN_QUEUE =
     "Cancelled (queued)";
 const string AdmissionController::PROFILE_INFO_VAL_ADMIT_QUEUED = "Admitted (queued)";
+const string AdmissionController::PROFILE_INFO_VAL_ADMIT_LEASED =
+    "Admitted immediately (leased resources)";
 const string AdmissionController::PROFILE_INFO_VAL_REJECTED = "Rejected";
 const string AdmissionController::PROFILE_INFO_VAL_TIME_OUT = "Timed out (queued)";
 const string AdmissionController::PROFILE_INFO_KEY_INITIAL_QUEUE_REASON =
@@ -154,6 +202,8 @@ const string AdmissionController::PROFILE_INFO_KEY_LAST_QUEUED_REASON =
 const string AdmissionController::PROFILE_INFO_KEY_ADMITTED_MEM =
     "Cluster Memory Admitted";
 const string AdmissionController::PROFILE_INFO_KEY_EXECUTOR_GROUP = "Executor Group";
+const string AdmissionController::PROFILE_INFO_KEY_MEM_ESTIMATE_FROM_HISTORY =
+    "Per-Host Memory Estimate From History";
 const string AdmissionController::PROFILE_INFO_KEY_STALENESS_WARNING =
     "Admission control state staleness";
 const string AdmissionController::PROFILE_TIME_SINCE_LAST_UPDATE_COUNTER_NAME =
@@ -220,6 +270,10 @@ const string REASON_NO_EXECUTOR_GROUPS =
 // $0 = num running queries, $1 = num queries limit, $2 = staleness detail
 const string QUEUED_NUM_RUNNING =
     "number of running queries $0 is at or over limit $1.$2";
+// $0 = pool name, $1 = memory per backend, $2 = slots per backend,
+// $3 = staleness detail
+const string LEASE_NOT_AVAILABLE = "no executor group of pool $0 has $1 of memory and "
+    "$2 slots available on every backend.$3";
 // $0 = queue size, $1 = staleness detail
 const string QUEUED_QUEUE_NOT_EMPTY = "queue is not empty (size $0); queued queries are "
     "executed first.$1";
@@ -612,6 +666,10 @@ AdmissionController::AdmissionController(ClusterMembershipMgr* cluster_membershi
     pool_mem_trackers_(pool_mem_trackers),
     host_id_(TNetworkAddressToString(host_addr)),
     thrift_serializer_(false),
+    memory_history_(MEMORY_HISTORY_MAX_SIGNATURES, MEMORY_HISTORY_SAMPLES_PER_SIGNATURE,
+        MEMORY_HISTORY_MIN_SAMPLES,
+        max(1.0, min(100.0, FLAGS_admission_control_memory_history_percentile)),
+        max(0.0, FLAGS_admission_control_memory_history_safety_margin)),
     done_(false) {
   cluster_membership_mgr_->RegisterUpdateCallbackFn(
       [this](ClusterMembershipMgr::SnapshotPtr snapshot) {
@@ -619,6 +677,8 @@ AdmissionController::AdmissionController(ClusterMembershipMgr* cluster_membershi
       });
   total_dequeue_failed_coordinator_limited_ =
       metrics_group_->AddCounter(TOTAL_DEQUEUE_FAILED_COORDINATOR_LIMITED, 0);
+  total_admitted_with_memory_history_ =
+      metrics_group_->AddCounter(TOTAL_ADMITTED_WITH_MEMORY_HISTORY, 0);
 }
 
 AdmissionController::~AdmissionController() {
@@ -641,6 +701,7 @@ AdmissionController::~AdmissionController() {
 }
 
 Status AdmissionController::Init() {
+  RETURN_IF_ERROR(ParsePoolWeights(FLAGS_admission_control_pool_weights, &pool_weights_));
   RETURN_IF_ERROR(Thread::Create("scheduling", "admission-thread",
       &AdmissionController::DequeueLoop, this, &dequeue_thread_));
   auto cb = [this](
@@ -656,27 +717,33 @@ Status AdmissionController::Init() {
 }
 
 void AdmissionController::PoolStats::AdmitQueryAndMemory(const ScheduleState& state) {
-  int64_t cluster_mem_admitted = state.GetClusterMemoryToAdmit();
+  AdmitQueryAndMemory(state.GetClusterMemoryToAdmit());
+}
+
+void AdmissionController::PoolStats::AdmitQueryAndMemory(
+    int64_t cluster_mem_admitted, int64_t num_running) {
   DCHECK_GT(cluster_mem_admitted, 0);
+  DCHECK_GT(num_running, 0);
   local_mem_admitted_ += cluster_mem_admitted;
   metrics_.local_mem_admitted->Increment(cluster_mem_admitted);
 
-  agg_num_running_ += 1;
-  metrics_.agg_num_running->Increment(1L);
+  agg_num_running_ += num_running;
+  metrics_.agg_num_running->Increment(num_running);
 
-  local_stats_.num_admitted_running += 1;
-  metrics_.local_num_admitted_running->Increment(1L);
+  local_stats_.num_admitted_running += num_running;
+  metrics_.local_num_admitted_running->Increment(num_running);
 
   metrics_.total_admitted->Increment(1L);
 }
 
-void AdmissionController::PoolStats::ReleaseQuery(int64_t peak_mem_consumption) {
+void AdmissionController::PoolStats::ReleaseQuery(
+    int64_t peak_mem_consumption, int64_t num_running) {
   // Update stats tracking the number of running and admitted queries.
-  agg_num_running_ -= 1;
-  metrics_.agg_num_running->Increment(-1L);
+  agg_num_running_ -= num_running;
+  metrics_.agg_num_running->Increment(-num_running);
 
-  local_stats_.num_admitted_running -= 1;
-  metrics_.local_num_admitted_running->Increment(-1L);
+  local_stats_.num_admitted_running -= num_running;
+  metrics_.local_num_admitted_running->Increment(-num_running);
 
   metrics_.total_released->Increment(1L);
   DCHECK_GE(local_stats_.num_admitted_running, 0);
@@ -1173,6 +1240,10 @@ Status AdmissionController::SubmitForAdmission(const AdmissionRequest& request,
   RETURN_IF_ERROR(ResolvePoolAndGetConfig(
       request.request.query_ctx, &queue_node->pool_name, &queue_node->pool_cfg));
   request.summary_profile->AddInfoString("Request Pool", queue_node->pool_name);
+  if (FLAGS_admission_control_use_memory_history) {
+    queue_node->memory_signature = QueryMemoryHistory::ComputeSignature(request.request);
+  }
+  queue_node->user = GetEffectiveUser(request.request.query_ctx.session);
 
   {
     // Take lock to ensure the Dequeue thread does not modify the request queue.
@@ -1350,7 +1421,7 @@ Status AdmissionController::WaitOnQueued(const UniqueIdPB& query_id,
 }
 
 void AdmissionController::ReleaseQuery(const UniqueIdPB& query_id,
-    const UniqueIdPB& coord_id, int64_t peak_mem_consumption,
+    const UniqueIdPB& coord_id, int64_t peak_mem_consumption, bool query_succeeded,
     bool release_remaining_backends) {
   {
     lock_guard<mutex> lock(admission_ctrl_lock_);
@@ -1390,7 +1461,20 @@ void AdmissionController::ReleaseQuery(const UniqueIdPB& query_id,
     DCHECK_EQ(num_released_backends_.at(query_id), 0) << PrintId(query_id);
     num_released_backends_.erase(num_released_backends_.find(query_id));
     PoolStats* stats = GetPoolStats(running_query.request_pool);
-    stats->ReleaseQuery(peak_mem_consumption);
+    if (running_query.is_lease) {
+      stats->ReleaseQuery(peak_mem_consumption, running_query.lease_max_queries);
+      for (const auto& entry : running_query.lease_users) {
+        UpdateNumRunningForUser(running_query.request_pool, entry.first, -entry.second);
+      }
+    } else {
+      stats->ReleaseQuery(peak_mem_consumption);
+      // Failed and cancelled queries may have stopped before reaching their peak.
+      if (FLAGS_admission_control_use_memory_history && query_succeeded
+          && peak_mem_consumption >= 0) {
+        memory_history_.AddSample(running_query.memory_signature, peak_mem_consumption);
+      }
+      UpdateNumRunningForUser(running_query.request_pool, running_query.user, -1);
+    }
     // No need to update the Host Stats as they should have been updated in
     // ReleaseQueryBackends.
     pools_for_updates_.insert(running_query.request_pool);
@@ -1486,7 +1570,8 @@ vector<UniqueIdPB> AdmissionController::CleanupQueriesForHost(
     LOG(INFO) << "Releasing resources for query " << PrintId(query_id)
               << " as it's coordinator " << PrintId(coord_id)
               << " reports that it is no longer registered.";
-    ReleaseQuery(query_id, coord_id, -1, /* release_remaining_backends */ true);
+    ReleaseQuery(query_id, coord_id, -1, /* query_succeeded */ false,
+        /* release_remaining_backends */ true);
   }
   return to_clean_up;
 }
@@ -1515,7 +1600,8 @@ AdmissionController::CancelQueriesOnFailedCoordinators(
   for (const auto& entry : to_clean_up) {
     const UniqueIdPB& coord_id = entry.first;
     for (const UniqueIdPB& query_id : entry.second) {
-      ReleaseQuery(query_id, coord_id, -1, /* release_remaining_backends */ true);
+      ReleaseQuery(query_id, coord_id, -1, /* query_succeeded */ false,
+          /* release_remaining_backends */ true);
     }
 
     lock_guard<mutex> lock(admission_ctrl_lock_);
@@ -1531,6 +1617,168 @@ AdmissionController::CancelQueriesOnFailedCoordinators(
   return to_clean_up;
 }
 
+Status AdmissionController::AdmitLease(const UniqueIdPB& lease_id,
+    const UniqueIdPB& coord_id, const string& pool_name, int64_t mem_per_backend,
+    int32_t slots_per_backend, string* executor_group,
+    vector<NetworkAddressPB>* backends, int32_t* max_queries) {
+  DCHECK_GT(mem_per_backend, 0);
+  DCHECK_GT(slots_per_backend, 0);
+  TPoolConfig pool_cfg;
+  RETURN_IF_ERROR(request_pool_service_->GetPoolConfig(pool_name, &pool_cfg));
+  if (PoolDisabled(pool_cfg)) {
+    return Status::Expected(Substitute("Pool $0 is disabled.", pool_name));
+  }
+  ClusterMembershipMgr::SnapshotPtr membership_snapshot =
+      cluster_membership_mgr_->GetSnapshot();
+  DCHECK(membership_snapshot.get() != nullptr);
+  auto coord_it = membership_snapshot->current_backends.find(PrintId(coord_id));
+  if (coord_it == membership_snapshot->current_backends.end()) {
+    return Status::Expected(REASON_COORDINATOR_NOT_FOUND);
+  }
+  const BackendDescriptorPB& coord_desc = coord_it->second;
+
+  lock_guard<mutex> lock(admission_ctrl_lock_);
+  PoolStats* pool_stats = GetPoolStats(pool_name);
+  // Leases must not overtake queued queries.
+  if (pool_stats->local_stats().num_queued > 0) {
+    return Status::Expected(Substitute(QUEUED_QUEUE_NOT_EMPTY,
+        pool_stats->local_stats().num_queued, GetStalenessDetailLocked(" ")));
+  }
+  const int64_t max_requests = GetMaxRequestsForPool(pool_cfg);
+  if (max_requests >= 0 && pool_stats->agg_num_running() >= max_requests) {
+    return Status::Expected(Substitute(QUEUED_NUM_RUNNING,
+        pool_stats->agg_num_running(), max_requests, GetStalenessDetailLocked(" ")));
+  }
+  // The lease counts as the number of queries that may run against it, so that they
+  // can't exceed the limit of the pool. Each query uses at least one slot per backend.
+  int32_t lease_max_queries = slots_per_backend;
+  if (max_requests >= 0) {
+    lease_max_queries = static_cast<int32_t>(std::min<int64_t>(
+        lease_max_queries, max_requests - pool_stats->agg_num_running()));
+  }
+  DCHECK_GT(lease_max_queries, 0);
+  const int64_t max_mem = GetMaxMemForPool(pool_cfg);
+  for (const ExecutorGroup* group :
+      GetExecutorGroupsForPool(membership_snapshot->executor_groups, pool_name)) {
+    ExecutorGroup::Executors descs = group->GetAllExecutorDescriptors();
+    if (group->LookUpBackendDesc(coord_desc.address()) == nullptr) {
+      descs.push_back(coord_desc);
+    }
+    int64_t cluster_mem = mem_per_backend * descs.size();
+    if (max_mem >= 0 && pool_stats->EffectiveMemReserved() + cluster_mem > max_mem) {
+      continue;
+    }
+    bool fits = true;
+    for (const BackendDescriptorPB& desc : descs) {
+      const HostStats& host_stats = host_stats_[NetworkAddressPBToString(desc.address())];
+      int64_t effective_host_mem_reserved =
+          std::max(host_stats.mem_reserved, host_stats.mem_admitted);
+      if (effective_host_mem_reserved + mem_per_backend > desc.admit_mem_limit()
+          || host_stats.slots_in_use + slots_per_backend > desc.admission_slots()) {
+        fits = false;
+        break;
+      }
+    }
+    if (!fits) continue;
+
+    RunningQuery& running_query = running_queries_[coord_id][lease_id];
+    running_query.request_pool = pool_name;
+    running_query.executor_group = group->name();
+    running_query.is_lease = true;
+    running_query.lease_max_queries = lease_max_queries;
+    backends->clear();
+    for (const BackendDescriptorPB& desc : descs) {
+      UpdateHostStats(desc.address(), mem_per_backend, 1, slots_per_backend);
+      BackendAllocation& allocation = running_query.per_backend_resources[desc.address()];
+      allocation.slots_to_use = slots_per_backend;
+      allocation.mem_to_admit = mem_per_backend;
+      backends->push_back(desc.address());
+    }
+    num_released_backends_[lease_id] = descs.size();
+    pool_stats->AdmitQueryAndMemory(cluster_mem, lease_max_queries);
+    pools_for_updates_.insert(pool_name);
+    UpdateExecGroupMetric(group->name(), 1);
+    *executor_group = group->name();
+    *max_queries = lease_max_queries;
+    VLOG_QUERY << "Admitted lease id=" << PrintId(lease_id) << " in pool_name="
+               << pool_name << " executor_group_name=" << group->name()
+               << " mem_per_backend=" << PrintBytes(mem_per_backend)
+               << " slots_per_backend=" << slots_per_backend
+               << " max_queries=" << lease_max_queries;
+    return Status::OK();
+  }
+  return Status::Expected(Substitute(LEASE_NOT_AVAILABLE, pool_name,
+      PrintBytes(mem_per_backend), slots_per_backend, GetStalenessDetailLocked(" ")));
+}
+
+bool AdmissionController::UpdateLeaseUsage(const UniqueIdPB& lease_id,
+    const UniqueIdPB& coord_id, const vector<string>& users) {
+  lock_guard<mutex> lock(admission_ctrl_lock_);
+  auto host_it = running_queries_.find(coord_id);
+  if (host_it == running_queries_.end()) return false;
+  auto it = host_it->second.find(lease_id);
+  if (it == host_it->second.end() || !it->second.is_lease) return false;
+  RunningQuery& lease = it->second;
+  unordered_map<string, int64_t> lease_users;
+  for (const string& user : users) ++lease_users[user];
+  for (const auto& entry : lease.lease_users) {
+    UpdateNumRunningForUser(lease.request_pool, entry.first, -entry.second);
+  }
+  for (const auto& entry : lease_users) {
+    UpdateNumRunningForUser(lease.request_pool, entry.first, entry.second);
+  }
+  lease.lease_users = move(lease_users);
+  return GetPoolStats(lease.request_pool)->local_stats().num_queued > 0;
+}
+
+Status AdmissionController::ScheduleOnExecutorGroup(const AdmissionRequest& request,
+    const string& executor_group, unique_ptr<ScheduleState>* state,
+    unordered_map<NetworkAddressPB, BackendAllocation>* per_backend_resources) {
+  DCHECK(scheduler_ != nullptr);
+  string pool_name;
+  TPoolConfig pool_cfg;
+  RETURN_IF_ERROR(ResolvePoolAndGetConfig(request.request.query_ctx, &pool_name,
+      &pool_cfg));
+  ClusterMembershipMgr::SnapshotPtr membership_snapshot =
+      cluster_membership_mgr_->GetSnapshot();
+  DCHECK(membership_snapshot.get() != nullptr);
+  auto coord_it = membership_snapshot->current_backends.find(PrintId(request.coord_id));
+  if (coord_it == membership_snapshot->current_backends.end()) {
+    return Status(REASON_COORDINATOR_NOT_FOUND);
+  }
+  const ExecutorGroup* group;
+  if (scheduler_->IsCoordinatorOnlyQuery(request.request)) {
+    group = cluster_membership_mgr_->GetEmptyExecutorGroup();
+  } else {
+    auto group_it = membership_snapshot->executor_groups.find(executor_group);
+    if (group_it == membership_snapshot->executor_groups.end()
+        || !group_it->second.IsHealthy()) {
+      return Status(Substitute("Executor group $0 is not available.", executor_group));
+    }
+    group = &group_it->second;
+  }
+
+  state->reset(new ScheduleState(request.query_id, request.request,
+      request.query_options, request.summary_profile, false));
+  const Scheduler::ExecutorConfig group_config = {*group, coord_it->second};
+  RETURN_IF_ERROR(scheduler_->Schedule(group_config, state->get()));
+  (*state)->UpdateMemoryRequirements(pool_cfg);
+  {
+    lock_guard<mutex> lock(admission_ctrl_lock_);
+    string rejection_reason;
+    if (RejectForSchedule(**state, pool_cfg, &rejection_reason)) {
+      return Status(rejection_reason);
+    }
+  }
+  per_backend_resources->clear();
+  for (const auto& entry : (*state)->per_backend_schedule_states()) {
+    BackendAllocation& allocation = (*per_backend_resources)[entry.first];
+    allocation.slots_to_use = entry.second.exec_params->slots_to_use();
+    allocation.mem_to_admit = GetMemToAdmit(**state, entry.second);
+  }
+  return Status::OK();
+}
+
 Status AdmissionController::ResolvePoolAndGetConfig(
     const TQueryCtx& query_ctx, string* pool_name, TPoolConfig* pool_config) {
   RETURN_IF_ERROR(request_pool_service_->ResolveRequestPool(query_ctx, pool_name));
@@ -1781,7 +2029,7 @@ Status AdmissionController::ComputeGroupScheduleStates(
 bool AdmissionController::FindGroupToAdmitOrReject(
     ClusterMembershipMgr::SnapshotPtr membership_snapshot, const TPoolConfig& pool_config,
     bool admit_from_queue, PoolStats* pool_stats, QueueNode* queue_node,
-    bool& coordinator_resource_limited) {
+    bool& coordinator_resource_limited, int64_t max_cluster_mem_to_admit) {
   // Check for rejection based on current cluster size
   const string& pool_name = pool_stats->name();
   string rejection_reason;
@@ -1803,9 +2051,17 @@ bool AdmissionController::FindGroupToAdmitOrReject(
     return true;
   }
 
+  int64_t mem_estimate_from_history = -1;
+  if (FLAGS_admission_control_use_memory_history) {
+    memory_history_.GetMemEstimate(
+        queue_node->memory_signature, &mem_estimate_from_history);
+  }
   for (GroupScheduleState& group_state : queue_node->group_states) {
     const ExecutorGroup& executor_group = group_state.executor_group;
     ScheduleState* state = group_state.state.get();
+    if (mem_estimate_from_history >= 0) {
+      state->set_mem_estimate_from_history(mem_estimate_from_history);
+    }
     state->UpdateMemoryRequirements(pool_config);
 
     const string& group_name = executor_group.name();
@@ -1822,6 +2078,7 @@ bool AdmissionController::FindGroupToAdmitOrReject(
                << PrintBytes(state->GetPerExecutorMemoryEstimate())
                << " dedicated_coord_mem_estimate="
                << PrintBytes(state->GetDedicatedCoordMemoryEstimate())
+               << " mem_estimate_from_history=" << PrintBytes(mem_estimate_from_history)
                << " max_requests=" << max_requests << " max_queued=" << max_queued
                << " max_mem=" << PrintBytes(max_mem);
     VLOG_QUERY << "Stats: " << pool_stats->DebugString();
@@ -1833,6 +2090,14 @@ bool AdmissionController::FindGroupToAdmitOrReject(
       return false;
     }
 
+    if (max_cluster_mem_to_admit >= 0
+        && state->GetClusterMemoryToAdmit() > max_cluster_mem_to_admit) {
+      VLOG_RPC << "Not admitting query " << queue_node->admission_request.query_id
+               << " to group " << group_name << ": needs more than "
+               << PrintBytes(max_cluster_mem_to_admit);
+      continue;
+    }
+
     if (CanAdmitRequest(*state, pool_config, admit_from_queue,
             &queue_node->not_admitted_reason, &queue_node->not_admitted_details,
             coordinator_resource_limited)) {
@@ -1916,9 +2181,9 @@ void AdmissionController::DequeueLoop() {
     // be empty.
     if (membership_snapshot->executor_groups.empty()) continue;
 
-    for (const PoolConfigMap::value_type& entry: pool_config_map_) {
-      const string& pool_name = entry.first;
-      const TPoolConfig& pool_config = entry.second;
+    for (const PoolConfigMap::value_type* entry : GetPoolsInDequeueOrder()) {
+      const string& pool_name = entry->first;
+      const TPoolConfig& pool_config = entry->second;
       PoolStats* stats = GetPoolStats(pool_name, /* dcheck_exists=*/true);
 
       if (stats->local_stats().num_queued == 0) continue; // Nothing to dequeue
@@ -1933,7 +2198,7 @@ void AdmissionController::DequeueLoop() {
       if (max_to_dequeue == 0) continue; // to next pool.
 
       while (max_to_dequeue > 0 && !queue.empty()) {
-        QueueNode* queue_node = queue.head();
+        QueueNode* queue_node = GetNextToDequeue(&queue, pool_name);
         DCHECK(queue_node != nullptr);
         // Find a group that can admit the query
         bool is_cancelled = queue_node->admit_outcome->IsSet()
@@ -1947,21 +2212,24 @@ void AdmissionController::DequeueLoop() {
 
         if (!is_cancelled && !is_rejected
             && queue_node->admitted_schedule.get() == nullptr) {
-          // If no group was found, stop trying to dequeue.
-          // TODO(IMPALA-2968): Requests further in the queue may be blocked
-          // unnecessarily. Consider a better policy once we have better test scenarios.
+          // If no group was found, stop trying to dequeue in order. Small queries
+          // further in the queue may still be backfilled.
           LogDequeueFailed(queue_node, queue_node->not_admitted_reason);
           if (coordinator_resource_limited) {
             // Dequeue failed because of a resource issue that can't be solved by adding
             // more executor groups. The common reason for this is that we are hitting a
             // limit on the coordinator.
             total_dequeue_failed_coordinator_limited_->Increment(1);
+          } else if (FLAGS_admission_control_backfill_depth > 0) {
+            max_to_dequeue -= BackfillQueries(membership_snapshot, pool_config, stats,
+                &queue, queue_node, max_to_dequeue);
           }
           break;
         }
 
         // At this point we know that the query must be taken off the queue
-        queue.Dequeue();
+        bool removed = queue.Remove(queue_node);
+        DCHECK(removed);
         --max_to_dequeue;
         VLOG(3) << "Dequeueing from stats for pool " << pool_name;
         stats->Dequeue(false);
@@ -2007,6 +2275,147 @@ void AdmissionController::DequeueLoop() {
   }
 }
 
+vector<const AdmissionController::PoolConfigMap::value_type*>
+AdmissionController::GetPoolsInDequeueOrder() {
+  vector<const PoolConfigMap::value_type*> pools;
+  for (const PoolConfigMap::value_type& entry : pool_config_map_) pools.push_back(&entry);
+  if (!FLAGS_admission_control_fair_share) return pools;
+  vector<pair<double, const PoolConfigMap::value_type*>> pools_by_usage;
+  for (const PoolConfigMap::value_type* entry : pools) {
+    auto weight_it = pool_weights_.find(entry->first);
+    double weight = weight_it == pool_weights_.end() ? 1 : weight_it->second;
+    PoolStats* stats = GetPoolStats(entry->first, /* dcheck_exists=*/true);
+    pools_by_usage.emplace_back(stats->EffectiveMemReserved() / weight, entry);
+  }
+  stable_sort(pools_by_usage.begin(), pools_by_usage.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (int i = 0; i < pools.size(); ++i) pools[i] = pools_by_usage[i].second;
+  return pools;
+}
+
+AdmissionController::QueueNode* AdmissionController::GetNextToDequeue(
+    RequestQueue* queue, const string& pool_name) {
+  DCHECK(!queue->empty());
+  if (!FLAGS_admission_control_fair_share) return queue->head();
+  auto pool_users_it = num_running_per_pool_user_.find(pool_name);
+  if (pool_users_it == num_running_per_pool_user_.end()) return queue->head();
+  const unordered_map<string, int64_t>& num_running_per_user = pool_users_it->second;
+  QueueNode* next = nullptr;
+  int64_t min_num_running = std::numeric_limits<int64_t>::max();
+  queue->IterateFirstN(
+      [&](QueueNode* node) {
+        auto user_it = num_running_per_user.find(node->user);
+        int64_t num_running =
+            user_it == num_running_per_user.end() ? 0 : user_it->second;
+        if (num_running < min_num_running) {
+          next = node;
+          min_num_running = num_running;
+        }
+        return min_num_running > 0;
+      },
+      FAIR_SHARE_MAX_CANDIDATES);
+  DCHECK(next != nullptr);
+  return next;
+}
+
+void AdmissionController::UpdateNumRunningForUser(
+    const string& pool_name, const string& user, int64_t delta) {
+  if (delta == 0) return;
+  unordered_map<string, int64_t>& num_running_per_user =
+      num_running_per_pool_user_[pool_name];
+  auto user_it = num_running_per_user.emplace(user, 0).first;
+  user_it->second += delta;
+  DCHECK_GE(user_it->second, 0) << user;
+  if (user_it->second <= 0) num_running_per_user.erase(user_it);
+}
+
+int64_t AdmissionController::BackfillQueries(
+    ClusterMembershipMgr::SnapshotPtr membership_snapshot,
+    const TPoolConfig& pool_config, PoolStats* stats, RequestQueue* queue,
+    QueueNode* blocked_node, int64_t max_to_admit) {
+  // The blocked query may have no schedules, e.g. if its coordinator is unknown.
+  int64_t blocked_mem = std::numeric_limits<int64_t>::max();
+  for (const GroupScheduleState& group_state : blocked_node->group_states) {
+    if (group_state.state == nullptr) continue;
+    blocked_mem = min(blocked_mem, group_state.state->GetClusterMemoryToAdmit());
+  }
+  if (blocked_mem == std::numeric_limits<int64_t>::max()) return 0;
+  double max_mem_fraction = FLAGS_admission_control_backfill_max_mem_fraction;
+  int64_t mem_budget = static_cast<int64_t>(max_mem_fraction * blocked_mem)
+      - blocked_node->backfilled_mem;
+  if (mem_budget <= 0) return 0;
+
+  // Collect the candidates first, the queue must not be modified while iterating it.
+  vector<QueueNode*> candidates;
+  queue->IterateFirstN(
+      [&](QueueNode* node) {
+        if (node != blocked_node) candidates.push_back(node);
+        return true;
+      },
+      FLAGS_admission_control_backfill_depth + 1);
+
+  int64_t num_dequeued = 0;
+  for (QueueNode* node : candidates) {
+    if (num_dequeued >= max_to_admit || mem_budget <= 0) break;
+    // Cancelled and rejected queries are taken off the queue in order.
+    if (node->admit_outcome->IsSet()) continue;
+    bool unused_bool;
+    if (!FindGroupToAdmitOrReject(membership_snapshot, pool_config,
+            /* admit_from_queue=*/true, stats, node, unused_bool, mem_budget)
+        || node->admitted_schedule == nullptr) {
+      continue;
+    }
+    bool removed = queue->Remove(node);
+    DCHECK(removed);
+    ++num_dequeued;
+    stats->Dequeue(false);
+    const UniqueIdPB& query_id = node->admission_request.query_id;
+    AdmissionOutcome outcome = node->admit_outcome->Set(AdmissionOutcome::ADMITTED);
+    if (outcome != AdmissionOutcome::ADMITTED) {
+      DCHECK_ENUM_EQ(outcome, AdmissionOutcome::CANCELLED);
+      VLOG_QUERY << "Dequeued cancelled query=" << PrintId(query_id);
+      continue;
+    }
+    int64_t cluster_mem = node->admitted_schedule->GetClusterMemoryToAdmit();
+    VLOG_QUERY << "Backfilling from queue: query=" << PrintId(query_id)
+               << " ahead of query=" << PrintId(blocked_node->admission_request.query_id)
+               << " cluster_mem=" << PrintBytes(cluster_mem);
+    blocked_node->backfilled_mem += cluster_mem;
+    mem_budget -= cluster_mem;
+    stats->metrics()->total_backfilled->Increment(1);
+    stats->metrics()->backfill_time_in_queue_ms->Increment(
+        MonotonicMillis() - node->wait_start_ms);
+    AdmitQuery(node, true);
+  }
+  return num_dequeued;
+}
+
+Status AdmissionController::ParsePoolWeights(
+    const string& weights, unordered_map<string, double>* pool_weights) {
+  pool_weights->clear();
+  vector<string> entries;
+  boost::split(entries, weights, boost::is_any_of(","), boost::token_compress_on);
+  for (string entry : entries) {
+    boost::trim(entry);
+    if (entry.empty()) continue;
+    size_t pos = entry.rfind(':');
+    double weight = 0;
+    if (pos != string::npos) {
+      StringParser::ParseResult result;
+      weight = StringParser::StringToFloat<double>(
+          entry.data() + pos + 1, entry.size() - pos - 1, &result);
+      if (result != StringParser::PARSE_SUCCESS) weight = 0;
+    }
+    if (pos == string::npos || pos == 0 || weight <= 0) {
+      return Status(Substitute("Invalid pool weight '$0' in "
+          "--admission_control_pool_weights, expected <pool name>:<positive weight>",
+          entry));
+    }
+    (*pool_weights)[entry.substr(0, pos)] = weight;
+  }
+  return Status::OK();
+}
+
 int64_t AdmissionController::GetQueueTimeoutForPoolMs(const TPoolConfig& pool_config) {
   int64_t queue_wait_timeout_ms = pool_config.__isset.queue_timeout_ms ?
       pool_config.queue_timeout_ms :
@@ -2095,6 +2504,11 @@ void AdmissionController::AdmitQuery(QueueNode* node, bool was_queued) {
       PROFILE_INFO_KEY_ADMITTED_MEM, PrintBytes(state->GetClusterMemoryToAdmit()));
   state->summary_profile()->AddInfoString(
       PROFILE_INFO_KEY_EXECUTOR_GROUP, state->executor_group());
+  if (state->UsesMemEstimateFromHistory()) {
+    total_admitted_with_memory_history_->Increment(1);
+    state->summary_profile()->AddInfoString(PROFILE_INFO_KEY_MEM_ESTIMATE_FROM_HISTORY,
+        PrintBytes(state->mem_estimate_from_history()));
+  }
   // We may have admitted based on stale information. Include a warning in the profile
   // if this this may be the case.
   int64_t time_since_update_ms;
@@ -2123,6 +2537,9 @@ void AdmissionController::AdmitQuery(QueueNode* node, bool was_queued) {
   RunningQuery& running_query = it->second[state->query_id()];
   running_query.request_pool = state->request_pool();
   running_query.executor_group = state->executor_group();
+  running_query.memory_signature = node->memory_signature;
+  running_query.user = node->user;
+  UpdateNumRunningForUser(running_query.request_pool, running_query.user, 1);
   for (const auto& entry : state->per_backend_schedule_states()) {
     BackendAllocation& allocation = running_query.per_backend_resources[entry.first];
     allocation.slots_to_use = entry.second.exec_params->slots_to_use();
@@ -2316,6 +2733,10 @@ void AdmissionController::PoolStats::InitMetrics() {
       TOTAL_RELEASED_METRIC_KEY_FORMAT, 0, name_);
   metrics_.time_in_queue_ms = parent_->metrics_group_->AddCounter(
       TIME_IN_QUEUE_METRIC_KEY_FORMAT, 0, name_);
+  metrics_.total_backfilled = parent_->metrics_group_->AddCounter(
+      TOTAL_BACKFILLED_METRIC_KEY_FORMAT, 0, name_);
+  metrics_.backfill_time_in_queue_ms = parent_->metrics_group_->AddCounter(
+      BACKFILL_TIME_IN_QUEUE_METRIC_KEY_FORMAT, 0, name_);
 
   metrics_.agg_num_running = parent_->metrics_group_->AddGauge(
       AGG_NUM_RUNNING_METRIC_KEY_FORMAT, 0, name_);
@@ -2375,7 +2796,12 @@ vector<const ExecutorGroup*> AdmissionController::GetExecutorGroupsForQuery(
     matching_groups.push_back(cluster_membership_mgr_->GetEmptyExecutorGroup());
     return matching_groups;
   }
-  const string& pool_name = request.request.query_ctx.request_pool;
+  return GetExecutorGroupsForPool(all_groups, request.request.query_ctx.request_pool);
+}
+
+vector<const ExecutorGroup*> AdmissionController::GetExecutorGroupsForPool(
+    const ClusterMembershipMgr::ExecutorGroups& all_groups, const string& pool_name) {
+  vector<const ExecutorGroup*> matching_groups;
   string prefix(pool_name + POOL_GROUP_DELIMITER);
   // We search for matching groups before the health check so that we don't fall back to
   // the default group in case there are matching but unhealthy groups.
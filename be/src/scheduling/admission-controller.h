@@ -30,6 +30,7 @@
 
 #include "common/status.h"
 #include "scheduling/cluster-membership-mgr.h"
+#include "scheduling/query-memory-history.h"
 #include "scheduling/request-pool-service.h"
 #include "scheduling/schedule-state.h"
 #include "statestore/statestore-subscriber.h"
@@ -331,6 +332,7 @@ class AdmissionController {
   static const std::string PROFILE_INFO_VAL_QUEUED;
   static const std::string PROFILE_INFO_VAL_CANCELLED_IN_QUEUE;
   static const std::string PROFILE_INFO_VAL_ADMIT_QUEUED;
+  static const std::string PROFILE_INFO_VAL_ADMIT_LEASED;
   static const std::string PROFILE_INFO_VAL_REJECTED;
   static const std::string PROFILE_INFO_VAL_TIME_OUT;
   static const std::string PROFILE_INFO_KEY_INITIAL_QUEUE_REASON;
@@ -338,6 +340,7 @@ class AdmissionController {
   static const std::string PROFILE_INFO_KEY_LAST_QUEUED_REASON;
   static const std::string PROFILE_INFO_KEY_ADMITTED_MEM;
   static const std::string PROFILE_INFO_KEY_EXECUTOR_GROUP;
+  static const std::string PROFILE_INFO_KEY_MEM_ESTIMATE_FROM_HISTORY;
   static const std::string PROFILE_INFO_KEY_STALENESS_WARNING;
   static const std::string PROFILE_TIME_SINCE_LAST_UPDATE_COUNTER_NAME;
 
@@ -359,6 +362,17 @@ class AdmissionController {
     std::unordered_set<NetworkAddressPB>& blacklisted_executor_addresses;
   };
 
+  /// Container for info about the resources allocated to a query on a single backend.
+  struct BackendAllocation {
+    /// Number of admission control slots this query is using.
+    int32_t slots_to_use;
+
+    /// Amount of memory allocated to this query. This will be equal to
+    /// ScheduleState::coord_backend_mem_to_admit() if this is the coordinator backend, or
+    /// ScheduleState::per_backend_mem_to_admit() otherwise.
+    int64_t mem_to_admit;
+  };
+
   /// Submits the request for admission. If the query is queued, 'queued' will be true
   /// and WaitOnQueued() must be called to block until a decision is made. Otherwise, when
   /// this method returns, the following <admit_outcome, Status> pairs are possible:
@@ -384,12 +398,15 @@ class AdmissionController {
   /// been submitted via AdmitQuery(). 'query_id' is the completed query, 'coord_id' is
   /// the backend id of the coordinator for the query, and 'peak_mem_consumption' is the
   /// peak memory consumption of the query, which may be -1 if unavailable.
+  /// 'query_succeeded' is true if the query returned all of its results; only the peak
+  /// memory of such queries is added to the memory history.
   /// If 'release_remaining_backends' is true, calls ReleaseQueryBackends() for any
   /// backends that have not been released yet. This is only used in the context of the
   /// admission control service to account for the possibility of failed rpcs.
   /// This does not block.
   void ReleaseQuery(const UniqueIdPB& query_id, const UniqueIdPB& coord_id,
-      int64_t peak_mem_consumption, bool release_remaining_backends = false);
+      int64_t peak_mem_consumption, bool query_succeeded,
+      bool release_remaining_backends = false);
 
   /// Updates the pool statistics when a Backend running a query completes (either
   /// successfully, is cancelled or failed). This should be called for all Backends part
@@ -414,6 +431,38 @@ class AdmissionController {
   std::unordered_map<UniqueIdPB, std::vector<UniqueIdPB>>
   CancelQueriesOnFailedCoordinators(std::unordered_set<UniqueIdPB> current_backends);
 
+  /// Leases 'mem_per_backend' bytes of memory and 'slots_per_backend' admission slots on
+  /// every backend of one executor group of pool 'pool_name' and on the coordinator
+  /// 'coord_id', so that the coordinator can admit small queries against them without
+  /// contacting the admission control service. The lease is registered like a query
+  /// with id 'lease_id' and is returned with ReleaseQuery(). It counts as
+  /// 'max_queries' running queries of the pool, which is the number of queries that the
+  /// coordinator may run against it. Returns an error if the resources are not available
+  /// right now or queries of the pool are queued, the lease is never queued. On success
+  /// sets 'executor_group' and 'backends' to where the resources were leased. Only used
+  /// in the context of the admission control service.
+  Status AdmitLease(const UniqueIdPB& lease_id, const UniqueIdPB& coord_id,
+      const std::string& pool_name, int64_t mem_per_backend, int32_t slots_per_backend,
+      std::string* executor_group, std::vector<NetworkAddressPB>* backends,
+      int32_t* max_queries);
+
+  /// Records that the queries of the users in 'users' are running against the lease
+  /// 'lease_id' of coordinator 'coord_id', one entry per query, so that they count as
+  /// running queries of their users. Returns true if the coordinator must stop admitting
+  /// queries against the lease because queries of its pool are queued. Called for every
+  /// lease on each admission heartbeat.
+  bool UpdateLeaseUsage(const UniqueIdPB& lease_id, const UniqueIdPB& coord_id,
+      const std::vector<std::string>& users);
+
+  /// Schedules 'request' on the executor group 'executor_group' and sets
+  /// 'per_backend_resources' to the memory and slots it needs on each backend, without
+  /// admitting it. Used by coordinators to admit queries against resources that they
+  /// leased with AdmitLease(). Returns an error if the query cannot be scheduled on the
+  /// group or would be rejected.
+  Status ScheduleOnExecutorGroup(const AdmissionRequest& request,
+      const std::string& executor_group, std::unique_ptr<ScheduleState>* state,
+      std::unordered_map<NetworkAddressPB, BackendAllocation>* per_backend_resources);
+
   /// Registers the request queue topic with the statestore, starts up the dequeue thread
   /// and registers a callback with the cluster membership manager to receive updates for
   /// membership changes.
@@ -515,6 +564,10 @@ class AdmissionController {
   /// executor groups).
   IntCounter* total_dequeue_failed_coordinator_limited_ = nullptr;
 
+  /// Counter of the number of queries that were admitted with a per-host memory
+  /// estimate from 'memory_history_' instead of the planner's estimate.
+  IntCounter* total_admitted_with_memory_history_ = nullptr;
+
   /// Contains all per-pool statistics and metrics. Accessed via GetPoolStats().
   class PoolStats {
    public:
@@ -528,6 +581,10 @@ class AdmissionController {
       IntCounter* total_timed_out;
       IntCounter* total_released;
       IntCounter* time_in_queue_ms;
+      /// Queries that were admitted ahead of a blocked query in their queue, and the
+      /// total time that they spent queued.
+      IntCounter* total_backfilled;
+      IntCounter* backfill_time_in_queue_ms;
 
       /// The following mirror the current values in PoolStats.
       /// TODO: Avoid duplication: replace the int64_t fields on PoolStats with these.
@@ -569,8 +626,13 @@ class AdmissionController {
     // ADMISSION LIFECYCLE METHODS
     /// Updates the pool stats when the request represented by 'state' is admitted.
     void AdmitQueryAndMemory(const ScheduleState& state);
-    /// Updates the pool stats except the memory admitted stat.
-    void ReleaseQuery(int64_t peak_mem_consumption);
+    /// Updates the pool stats when a query or lease with 'cluster_mem_admitted' bytes of
+    /// memory across all backends is admitted. A lease counts as 'num_running' running
+    /// queries.
+    void AdmitQueryAndMemory(int64_t cluster_mem_admitted, int64_t num_running = 1);
+    /// Updates the pool stats except the memory admitted stat. 'num_running' must match
+    /// the value passed to AdmitQueryAndMemory().
+    void ReleaseQuery(int64_t peak_mem_consumption, int64_t num_running = 1);
     /// Releases the specified memory from the pool stats.
     void ReleaseMem(int64_t mem_to_release);
     /// Updates the pool stats when the request represented by 'state' is queued.
@@ -706,6 +768,8 @@ class AdmissionController {
     FRIEND_TEST(AdmissionControllerTest, GetMaxToDequeue);
     FRIEND_TEST(AdmissionControllerTest, QueryRejection);
     FRIEND_TEST(AdmissionControllerTest, TopNQueryCheck);
+    FRIEND_TEST(AdmissionControllerTest, FairShareDequeueOrder);
+    FRIEND_TEST(AdmissionControllerTest, BackfillQueries);
     friend class AdmissionControllerTest;
   };
 
@@ -778,6 +842,12 @@ class AdmissionController {
     string pool_name;
     TPoolConfig pool_cfg;
 
+    /// Signature of the plan in the QueryMemoryHistory.
+    uint64_t memory_signature = 0;
+
+    /// Effective user of the query, used for fair sharing within a pool.
+    std::string user;
+
     /// END: Members that are valid for new objects after initialization
     /////////////////////////////////////////
 
@@ -799,6 +869,10 @@ class AdmissionController {
     /// The MonotonicMillis() time when the query was queued.
     int64_t wait_start_ms;
 
+    /// Cluster memory admitted to queries that were backfilled while this query was the
+    /// next one to dequeue from its pool.
+    int64_t backfilled_mem = 0;
+
     /// END: Members that are only valid while queued, but invalid once dequeued.
     /////////////////////////////////////////
 
@@ -841,17 +915,6 @@ class AdmissionController {
   typedef boost::unordered_map<std::string, RequestQueue> RequestQueueMap;
   RequestQueueMap request_queue_map_;
 
-  /// Container for info about the resources allocated to a query on a single backend.
-  struct BackendAllocation {
-    /// Number of admission control slots this query is using.
-    int32_t slots_to_use;
-
-    /// Amount of memory allocated to this query. This will be equal to
-    /// ScheduleState::coord_backend_mem_to_admit() if this is the coordinator backend, or
-    /// ScheduleState::per_backend_mem_to_admit() otherwise.
-    int64_t mem_to_admit;
-  };
-
   /// Container for info about the resources allocated to a currently running query.
   struct RunningQuery {
     /// The request pool this query was scheduled on.
@@ -860,6 +923,22 @@ class AdmissionController {
     /// The executor group this query was scheduled on.
     std::string executor_group;
 
+    /// Signature of the plan in the QueryMemoryHistory.
+    uint64_t memory_signature = 0;
+
+    /// Effective user of the query.
+    std::string user;
+
+    /// True if this is a lease granted by AdmitLease() rather than a query.
+    bool is_lease = false;
+
+    /// For leases, the number of running queries of the pool that the lease counts as.
+    int32_t lease_max_queries = 0;
+
+    /// For leases, user => number of queries of the user that run against the lease, as
+    /// last reported by UpdateLeaseUsage().
+    std::unordered_map<std::string, int64_t> lease_users;
+
     /// Map from backend addresses to the resouces this query was allocated on them. When
     /// backends are released, they are removed from this map.
     std::unordered_map<NetworkAddressPB, BackendAllocation> per_backend_resources;
@@ -872,6 +951,23 @@ class AdmissionController {
   std::unordered_map<UniqueIdPB, std::unordered_map<UniqueIdPB, RunningQuery>>
       running_queries_;
 
+  /// Actual per-host peak memory consumption of released queries, used to admit later
+  /// queries with the same plan if FLAGS_admission_control_use_memory_history is true.
+  /// Protected by admission_ctrl_lock_.
+  QueryMemoryHistory memory_history_;
+
+  /// Map from pool name to a map from user to the number of queries of that user which
+  /// were admitted by this admission controller and are running in the pool. Used to
+  /// pick the next query to dequeue if FLAGS_admission_control_fair_share is true.
+  /// Protected by admission_ctrl_lock_.
+  std::unordered_map<std::string, std::unordered_map<std::string, int64_t>>
+      num_running_per_pool_user_;
+
+  /// Weights of the pools for fair sharing, parsed from
+  /// FLAGS_admission_control_pool_weights in Init(). Pools without an entry have a
+  /// weight of 1.
+  std::unordered_map<std::string, double> pool_weights_;
+
   /// Map of pool names to the pool configs returned by request_pool_service_. Stored so
   /// that the dequeue thread does not need to access the configs via the request pool
   /// service again (which involves a JNI call and error checking).
@@ -942,12 +1038,49 @@ class AdmissionController {
   /// method returns false and sets queue_node->not_admitted_reason.
   bool FindGroupToAdmitOrReject(ClusterMembershipMgr::SnapshotPtr membership_snapshot,
       const TPoolConfig& pool_config, bool admit_from_queue, PoolStats* pool_stats,
-      QueueNode* queue_node, bool& coordinator_resource_limited);
+      QueueNode* queue_node, bool& coordinator_resource_limited,
+      int64_t max_cluster_mem_to_admit = -1);
 
   /// Dequeues the queued queries when notified by dequeue_cv_ and admits them if they
   /// have not been cancelled yet.
   void DequeueLoop();
 
+  /// Returns the pools in the order in which DequeueLoop() tries to admit their queued
+  /// queries. If FLAGS_admission_control_fair_share is true, pools that hold the least
+  /// memory relative to their weight come first, so that they get the first share of
+  /// host memory that was freed up. Otherwise the order is arbitrary.
+  /// Must hold admission_ctrl_lock_.
+  std::vector<const PoolConfigMap::value_type*> GetPoolsInDequeueOrder();
+
+  /// Returns the query to dequeue next from 'queue' of pool 'pool_name', which must not
+  /// be empty. This is the head of the queue unless FLAGS_admission_control_fair_share
+  /// is true, in which case it is the oldest query of the user with the fewest running
+  /// queries in the pool among the first queued queries. Must hold admission_ctrl_lock_.
+  QueueNode* GetNextToDequeue(RequestQueue* queue, const std::string& pool_name);
+
+  /// Adds 'delta' to the number of running queries of 'user' in pool 'pool_name' in
+  /// num_running_per_pool_user_. Must hold admission_ctrl_lock_.
+  void UpdateNumRunningForUser(
+      const std::string& pool_name, const std::string& user, int64_t delta);
+
+  /// Tries to admit queries that are queued behind 'blocked_node', which is the next
+  /// query to dequeue from 'queue' but cannot be admitted now. Up to
+  /// FLAGS_admission_control_backfill_depth queries are considered. A query is admitted
+  /// if it fits into the currently free resources and its memory, together with the
+  /// memory of the queries backfilled before it, is at most
+  /// FLAGS_admission_control_backfill_max_mem_fraction of the memory that 'blocked_node'
+  /// needs. This bounds how much backfilling can delay 'blocked_node'. Admits at most
+  /// 'max_to_admit' queries and returns the number of queries that were taken off the
+  /// queue. Must hold admission_ctrl_lock_.
+  int64_t BackfillQueries(ClusterMembershipMgr::SnapshotPtr membership_snapshot,
+      const TPoolConfig& pool_config, PoolStats* stats, RequestQueue* queue,
+      QueueNode* blocked_node, int64_t max_to_admit);
+
+  /// Parses 'weights', a comma-separated list of <pool name>:<weight> pairs, into
+  /// 'pool_weights'.
+  static Status ParsePoolWeights(
+      const std::string& weights, std::unordered_map<std::string, double>* pool_weights);
+
   /// Returns true if schedule can be admitted to the pool with pool_cfg.
   /// admit_from_queue is true if attempting to admit from the queue. Otherwise, returns
   /// false and not_admitted_reason specifies why the request can not be admitted
@@ -1115,6 +1248,12 @@ class AdmissionController {
       const ClusterMembershipMgr::ExecutorGroups& all_groups,
       const AdmissionRequest& request);
 
+  /// Returns all healthy groups from 'all_groups' that can be used to run queries for the
+  /// resource pool 'pool_name', sorted by name.
+  std::vector<const ExecutorGroup*> GetExecutorGroupsForPool(
+      const ClusterMembershipMgr::ExecutorGroups& all_groups,
+      const std::string& pool_name);
+
   /// Returns the current size of the cluster.
   int64_t GetClusterSize(const ClusterMembershipMgr::Snapshot& membership_snapshot);
 
@@ -1185,7 +1324,10 @@ class AdmissionController {
   FRIEND_TEST(AdmissionControllerTest, QueryRejection);
   FRIEND_TEST(AdmissionControllerTest, DedicatedCoordScheduleState);
   FRIEND_TEST(AdmissionControllerTest, DedicatedCoordAdmissionChecks);
+  FRIEND_TEST(AdmissionControllerTest, MemoryHistory);
   FRIEND_TEST(AdmissionControllerTest, TopNQueryCheck);
+  FRIEND_TEST(AdmissionControllerTest, FairShareDequeueOrder);
+  FRIEND_TEST(AdmissionControllerTest, BackfillQueries);
   friend class AdmissionControllerTest;
 };
 
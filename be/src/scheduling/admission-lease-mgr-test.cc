@@ -0,0 +1,206 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/admission-lease-mgr.h"
+#include "gen-cpp/admission_control_service.pb.h"
+#include "testutil/gtest-util.h"
+#include "util/container-util.h"
+#include "util/metrics.h"
+#include "util/network-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int64_t MEGABYTE = 1024L * 1024L;
+
+class AdmissionLeaseMgrTest : public testing::Test {
+ protected:
+  typedef AdmissionLeaseMgr::Lease Lease;
+  typedef AdmissionLeaseMgr::BackendResources BackendResources;
+
+  void SetUp() override {
+    metrics_.reset(new MetricGroup("lease-mgr-test"));
+    mgr_.reset(new AdmissionLeaseMgr(metrics_.get()));
+    host1_ = MakeNetworkAddressPB("host1", 27000);
+    host2_ = MakeNetworkAddressPB("host2", 27000);
+  }
+
+  /// Returns a lease of 'pool_name' with 100MB and 2 slots on both hosts for up to 4
+  /// queries that expires at time 1000.
+  shared_ptr<Lease> MakeLease(const string& pool_name, int64_t id) {
+    shared_ptr<Lease> lease = make_shared<Lease>();
+    lease->id.set_hi(id);
+    lease->id.set_lo(id);
+    lease->pool_name = pool_name;
+    lease->executor_group = "default";
+    lease->expiry_ms = 1000;
+    lease->max_queries = 4;
+    for (const NetworkAddressPB& host : {host1_, host2_}) {
+      lease->available[host].mem_to_admit = 100 * MEGABYTE;
+      lease->available[host].slots_to_use = 2;
+    }
+    return lease;
+  }
+
+  BackendResources MakeResources(int64_t mem, int32_t slots) {
+    BackendResources resources;
+    for (const NetworkAddressPB& host : {host1_, host2_}) {
+      resources[host].mem_to_admit = mem;
+      resources[host].slots_to_use = slots;
+    }
+    return resources;
+  }
+
+  /// Reserves 'mem' and 'slots' on both hosts for query 'id' of 'user' from 'lease'.
+  bool Reserve(const shared_ptr<Lease>& lease, int64_t id, int64_t mem, int32_t slots,
+      int64_t now_ms, const string& user = "user") {
+    return mgr_->Reserve(lease, MakeQueryId(id), user, MakeResources(mem, slots), now_ms);
+  }
+
+  UniqueIdPB MakeQueryId(int64_t id) {
+    UniqueIdPB query_id;
+    query_id.set_hi(0);
+    query_id.set_lo(id);
+    return query_id;
+  }
+
+  scoped_ptr<MetricGroup> metrics_;
+  scoped_ptr<AdmissionLeaseMgr> mgr_;
+  NetworkAddressPB host1_;
+  NetworkAddressPB host2_;
+};
+
+/// Queries are admitted while all of their backends fit into the lease and return their
+/// resources when they are released.
+TEST_F(AdmissionLeaseMgrTest, ReserveAndRelease) {
+  shared_ptr<Lease> lease = MakeLease("pool", 1);
+  mgr_->AddLease(lease);
+  bool may_acquire;
+  EXPECT_EQ(mgr_->GetLease("pool", 0, &may_acquire), lease);
+
+  EXPECT_TRUE(Reserve(lease, 1, 60 * MEGABYTE, 1, 0));
+  // Not enough memory left.
+  EXPECT_FALSE(Reserve(lease, 2, 60 * MEGABYTE, 1, 0));
+  EXPECT_TRUE(Reserve(lease, 2, 10 * MEGABYTE, 1, 0));
+  // Not enough slots left.
+  EXPECT_FALSE(Reserve(lease, 3, MEGABYTE, 1, 0));
+  // Backends outside of the lease can't be used.
+  BackendResources other_host;
+  other_host[MakeNetworkAddressPB("host3", 27000)].mem_to_admit = MEGABYTE;
+  EXPECT_FALSE(mgr_->Reserve(lease, MakeQueryId(3), "user", other_host, 0));
+  EXPECT_EQ(lease->num_queries, 2);
+
+  // Releasing a single backend only frees resources on that backend.
+  EXPECT_TRUE(mgr_->ReleaseQueryBackends(MakeQueryId(1), {host1_}));
+  EXPECT_EQ(lease->available[host1_].mem_to_admit, 90 * MEGABYTE);
+  EXPECT_EQ(lease->available[host2_].mem_to_admit, 30 * MEGABYTE);
+  EXPECT_EQ(lease->num_queries, 2);
+  EXPECT_TRUE(mgr_->ReleaseQuery(MakeQueryId(1)));
+  EXPECT_TRUE(mgr_->ReleaseQuery(MakeQueryId(2)));
+  EXPECT_EQ(lease->num_queries, 0);
+  for (const NetworkAddressPB& host : {host1_, host2_}) {
+    EXPECT_EQ(lease->available[host].mem_to_admit, 100 * MEGABYTE);
+    EXPECT_EQ(lease->available[host].slots_to_use, 2);
+  }
+  // Queries that were not admitted against a lease are not known.
+  EXPECT_FALSE(mgr_->ReleaseQuery(MakeQueryId(3)));
+}
+
+/// Expired leases don't admit queries and are returned once their queries finished.
+TEST_F(AdmissionLeaseMgrTest, Expiry) {
+  shared_ptr<Lease> lease = MakeLease("pool", 1);
+  mgr_->AddLease(lease);
+  EXPECT_TRUE(Reserve(lease, 1, MEGABYTE, 1, 999));
+  EXPECT_FALSE(Reserve(lease, 2, MEGABYTE, 1, 1000));
+
+  // Only one thread acquires a new lease.
+  bool may_acquire;
+  EXPECT_EQ(mgr_->GetLease("pool", 1000, &may_acquire), nullptr);
+  EXPECT_TRUE(may_acquire);
+  EXPECT_EQ(mgr_->GetLease("pool", 1000, &may_acquire), nullptr);
+  EXPECT_FALSE(may_acquire);
+
+  // The expired lease is kept alive while it has running queries.
+  vector<shared_ptr<Lease>> expired;
+  AdmissionHeartbeatRequestPB heartbeat;
+  mgr_->TakeExpiredLeases(1000, &expired, &heartbeat);
+  EXPECT_TRUE(expired.empty());
+  ASSERT_EQ(heartbeat.query_ids_size(), 1);
+  EXPECT_EQ(heartbeat.query_ids(0), lease->id);
+
+  EXPECT_TRUE(mgr_->ReleaseQuery(MakeQueryId(1)));
+  heartbeat.Clear();
+  mgr_->TakeExpiredLeases(1000, &expired, &heartbeat);
+  ASSERT_EQ(expired.size(), 1);
+  EXPECT_EQ(expired[0], lease);
+  EXPECT_EQ(heartbeat.query_ids_size(), 0);
+}
+
+/// No more than the maximum number of queries run against a lease and their users are
+/// reported in the heartbeat.
+TEST_F(AdmissionLeaseMgrTest, MaxQueriesAndUsage) {
+  shared_ptr<Lease> lease = MakeLease("pool", 1);
+  lease->max_queries = 1;
+  mgr_->AddLease(lease);
+  EXPECT_TRUE(Reserve(lease, 1, MEGABYTE, 1, 0, "alice"));
+  EXPECT_FALSE(Reserve(lease, 2, MEGABYTE, 1, 0, "bob"));
+  lease->max_queries = 2;
+  EXPECT_TRUE(Reserve(lease, 2, MEGABYTE, 1, 0, "bob"));
+
+  vector<shared_ptr<Lease>> expired;
+  AdmissionHeartbeatRequestPB heartbeat;
+  mgr_->TakeExpiredLeases(0, &expired, &heartbeat);
+  ASSERT_EQ(heartbeat.lease_usage_size(), 1);
+  const AdmissionLeaseUsagePB& usage = heartbeat.lease_usage(0);
+  EXPECT_EQ(usage.lease_id(), lease->id);
+  EXPECT_EQ(set<string>(usage.users().begin(), usage.users().end()),
+      set<string>({"alice", "bob"}));
+
+  EXPECT_TRUE(mgr_->ReleaseQuery(MakeQueryId(1)));
+  heartbeat.Clear();
+  mgr_->TakeExpiredLeases(0, &expired, &heartbeat);
+  ASSERT_EQ(heartbeat.lease_usage_size(), 1);
+  ASSERT_EQ(heartbeat.lease_usage(0).users_size(), 1);
+  EXPECT_EQ(heartbeat.lease_usage(0).users(0), "bob");
+}
+
+/// Revoked leases don't admit queries and are returned once their queries finished.
+TEST_F(AdmissionLeaseMgrTest, Revoke) {
+  shared_ptr<Lease> lease = MakeLease("pool", 1);
+  mgr_->AddLease(lease);
+  EXPECT_TRUE(Reserve(lease, 1, MEGABYTE, 1, 0));
+  AdmissionHeartbeatResponsePB response;
+  *response.add_revoked_lease_ids() = lease->id;
+  mgr_->RevokeLeases(response);
+  EXPECT_FALSE(Reserve(lease, 2, MEGABYTE, 1, 0));
+  bool may_acquire;
+  EXPECT_EQ(mgr_->GetLease("pool", 0, &may_acquire), nullptr);
+
+  vector<shared_ptr<Lease>> expired;
+  AdmissionHeartbeatRequestPB heartbeat;
+  mgr_->TakeExpiredLeases(0, &expired, &heartbeat);
+  EXPECT_TRUE(expired.empty());
+  ASSERT_EQ(heartbeat.query_ids_size(), 1);
+  EXPECT_EQ(heartbeat.query_ids(0), lease->id);
+  EXPECT_TRUE(mgr_->ReleaseQuery(MakeQueryId(1)));
+  mgr_->TakeExpiredLeases(0, &expired, &heartbeat);
+  ASSERT_EQ(expired.size(), 1);
+  EXPECT_EQ(expired[0], lease);
+}
+
+} // namespace impala
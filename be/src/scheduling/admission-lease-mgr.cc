@@ -0,0 +1,379 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/admission-lease-mgr.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "gen-cpp/admission_control_service.pb.h"
+#include "gen-cpp/admission_control_service.proxy.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/util/monotime.h"
+#include "rpc/rpc-mgr.inline.h"
+#include "runtime/exec-env.h"
+#include "scheduling/admission-control-service.h"
+#include "scheduling/schedule-state.h"
+#include "util/auth-util.h"
+#include "util/container-util.h"
+#include "util/debug-util.h"
+#include "util/kudu-status-util.h"
+#include "util/metrics.h"
+#include "util/pretty-printer.h"
+#include "util/time.h"
+#include "util/uid-util.h"
+
+#include "common/names.h"
+
+DEFINE_int64(admission_lease_mem_per_host, 0,
+    "(Advanced) If greater than 0 and the admission control service is used, "
+    "coordinators lease this many bytes of memory on every backend of an executor group "
+    "from the admission control service and admit small queries against the lease "
+    "without contacting it. Reduces the admission latency of short queries.");
+DEFINE_int32(admission_lease_slots_per_host, 4,
+    "(Advanced) The number of admission slots that coordinators lease on every backend "
+    "if --admission_lease_mem_per_host is set. At most this many queries run against a "
+    "lease at the same time.");
+DEFINE_int64(admission_lease_max_query_mem_per_host, 0,
+    "(Advanced) Queries that need more than this many bytes of memory on any backend "
+    "are always submitted to the admission control service, even if they would fit "
+    "into a lease. If 0, any query that fits is admitted against a lease.");
+DEFINE_int32(admission_lease_duration_ms, 5000,
+    "(Advanced) The number of milliseconds for which coordinators admit queries against "
+    "a lease. After that the lease is returned to the admission control service once "
+    "its queries have finished.");
+
+using kudu::MonoDelta;
+using kudu::rpc::RpcController;
+
+namespace impala {
+
+static const string LEASES_ACQUIRED_KEY = "admission-controller.leases-acquired";
+static const string LEASE_QUERIES_ADMITTED_KEY =
+    "admission-controller.lease-queries-admitted";
+
+/// Time to wait before requesting another lease for a pool after an attempt failed.
+static const int64_t ACQUIRE_RETRY_INTERVAL_MS = 1000;
+
+/// Timeout of the AdmitLease() and ReleaseQuery() rpcs.
+static const int64_t RPC_TIMEOUT_MS = 10 * MILLIS_PER_SEC;
+
+AdmissionLeaseMgr::AdmissionLeaseMgr(MetricGroup* metrics) {
+  MetricGroup* metrics_group = metrics->GetOrCreateChildGroup("admission-controller");
+  leases_acquired_ = metrics_group->AddCounter(LEASES_ACQUIRED_KEY, 0);
+  queries_admitted_ = metrics_group->AddCounter(LEASE_QUERIES_ADMITTED_KEY, 0);
+}
+
+bool AdmissionLeaseMgr::IsEnabled() {
+  return FLAGS_admission_lease_mem_per_host > 0
+      && FLAGS_admission_lease_slots_per_host > 0;
+}
+
+bool AdmissionLeaseMgr::TryAdmit(const AdmissionController::AdmissionRequest& request,
+    unique_ptr<QuerySchedulePB>* schedule_result) {
+  // Retried queries need to exclude blacklisted executors, which leases don't support.
+  if (!request.blacklisted_executor_addresses.empty()) return false;
+  const string& pool_name = request.request.query_ctx.request_pool;
+  bool may_acquire;
+  shared_ptr<Lease> lease = GetLease(pool_name, MonotonicMillis(), &may_acquire);
+  if (lease == nullptr) {
+    if (!may_acquire) return false;
+    Status status = AcquireLease(pool_name, &lease);
+    if (!status.ok()) {
+      VLOG(2) << "Could not lease resources for pool " << pool_name << ": " << status;
+      return false;
+    }
+  }
+
+  unique_ptr<ScheduleState> state;
+  BackendResources resources;
+  Status status = ExecEnv::GetInstance()->admission_controller()->ScheduleOnExecutorGroup(
+      request, lease->executor_group, &state, &resources);
+  if (!status.ok()) {
+    VLOG(2) << "Could not schedule query " << PrintId(request.query_id)
+            << " on leased executor group " << lease->executor_group << ": " << status;
+    return false;
+  }
+  if (FLAGS_admission_lease_max_query_mem_per_host > 0) {
+    for (const auto& entry : resources) {
+      if (entry.second.mem_to_admit > FLAGS_admission_lease_max_query_mem_per_host) {
+        return false;
+      }
+    }
+  }
+  const string& user = GetEffectiveUser(request.request.query_ctx.session);
+  if (!Reserve(lease, request.query_id, user, resources, MonotonicMillis())) {
+    return false;
+  }
+  queries_admitted_->Increment(1);
+
+  VLOG_QUERY << "Admitted query id=" << PrintId(request.query_id)
+             << " against lease id=" << PrintId(lease->id);
+  RuntimeProfile* profile = request.summary_profile;
+  profile->AddInfoString("Request Pool", pool_name);
+  profile->AddInfoString(AdmissionController::PROFILE_INFO_KEY_ADMISSION_RESULT,
+      AdmissionController::PROFILE_INFO_VAL_ADMIT_LEASED);
+  profile->AddInfoString(AdmissionController::PROFILE_INFO_KEY_ADMITTED_MEM,
+      PrintBytes(state->GetClusterMemoryToAdmit()));
+  profile->AddInfoString(
+      AdmissionController::PROFILE_INFO_KEY_EXECUTOR_GROUP, state->executor_group());
+  *schedule_result = move(state->query_schedule_pb());
+  return true;
+}
+
+bool AdmissionLeaseMgr::ReleaseQueryBackends(
+    const UniqueIdPB& query_id, const vector<NetworkAddressPB>& backends) {
+  lock_guard<mutex> l(lock_);
+  auto it = queries_.find(query_id);
+  if (it == queries_.end()) return false;
+  ReleaseLocked(it, &backends);
+  return true;
+}
+
+bool AdmissionLeaseMgr::ReleaseQuery(const UniqueIdPB& query_id) {
+  lock_guard<mutex> l(lock_);
+  auto it = queries_.find(query_id);
+  if (it == queries_.end()) return false;
+  ReleaseLocked(it, nullptr);
+  return true;
+}
+
+void AdmissionLeaseMgr::ReturnExpiredLeases(AdmissionHeartbeatRequestPB* heartbeat) {
+  vector<shared_ptr<Lease>> expired;
+  TakeExpiredLeases(MonotonicMillis(), &expired, heartbeat);
+  for (const shared_ptr<Lease>& lease : expired) ReturnLease(*lease);
+}
+
+void AdmissionLeaseMgr::RevokeLeases(const AdmissionHeartbeatResponsePB& response) {
+  if (response.revoked_lease_ids().empty()) return;
+  lock_guard<mutex> l(lock_);
+  for (const UniqueIdPB& lease_id : response.revoked_lease_ids()) {
+    for (auto it = active_leases_.begin(); it != active_leases_.end(); ++it) {
+      if (it->second->id != lease_id) continue;
+      VLOG_QUERY << "Lease id=" << PrintId(lease_id) << " was revoked because queries "
+                 << "of pool " << it->first << " are queued";
+      // The lease is returned by the next heartbeat once its queries have finished.
+      it->second->expiry_ms = 0;
+      draining_leases_.push_back(move(it->second));
+      active_leases_.erase(it);
+      break;
+    }
+  }
+}
+
+shared_ptr<AdmissionLeaseMgr::Lease> AdmissionLeaseMgr::GetLease(
+    const string& pool_name, int64_t now_ms, bool* may_acquire) {
+  *may_acquire = false;
+  lock_guard<mutex> l(lock_);
+  auto it = active_leases_.find(pool_name);
+  if (it != active_leases_.end()) {
+    if (now_ms < it->second->expiry_ms) return it->second;
+    draining_leases_.push_back(move(it->second));
+    active_leases_.erase(it);
+  }
+  int64_t& next_acquire_ms = next_acquire_ms_[pool_name];
+  if (now_ms >= next_acquire_ms) {
+    // Keep other threads from acquiring a lease for the pool at the same time. This is
+    // also the back off in case the attempt fails.
+    next_acquire_ms = now_ms + ACQUIRE_RETRY_INTERVAL_MS;
+    *may_acquire = true;
+  }
+  return nullptr;
+}
+
+void AdmissionLeaseMgr::AddLease(shared_ptr<Lease> lease) {
+  lock_guard<mutex> l(lock_);
+  acquiring_lease_ids_.erase(lease->id);
+  next_acquire_ms_.erase(lease->pool_name);
+  shared_ptr<Lease>& active = active_leases_[lease->pool_name];
+  if (active != nullptr) draining_leases_.push_back(move(active));
+  active = move(lease);
+}
+
+bool AdmissionLeaseMgr::Reserve(const shared_ptr<Lease>& lease,
+    const UniqueIdPB& query_id, const string& user, const BackendResources& resources,
+    int64_t now_ms) {
+  lock_guard<mutex> l(lock_);
+  if (now_ms >= lease->expiry_ms) return false;
+  if (lease->num_queries >= lease->max_queries) return false;
+  for (const auto& entry : resources) {
+    auto available_it = lease->available.find(entry.first);
+    if (available_it == lease->available.end()) return false;
+    const AdmissionController::BackendAllocation& available = available_it->second;
+    if (entry.second.mem_to_admit > available.mem_to_admit
+        || entry.second.slots_to_use > available.slots_to_use) {
+      return false;
+    }
+  }
+  for (const auto& entry : resources) {
+    AdmissionController::BackendAllocation& available = lease->available[entry.first];
+    available.mem_to_admit -= entry.second.mem_to_admit;
+    available.slots_to_use -= entry.second.slots_to_use;
+  }
+  ++lease->num_queries;
+  DCHECK(queries_.find(query_id) == queries_.end()) << PrintId(query_id);
+  queries_[query_id] = {lease, resources, user};
+  return true;
+}
+
+void AdmissionLeaseMgr::ReleaseLocked(
+    unordered_map<UniqueIdPB, LeasedQuery>::iterator it,
+    const vector<NetworkAddressPB>* backends) {
+  LeasedQuery& query = it->second;
+  auto release = [&query](BackendResources::iterator resources_it) {
+    AdmissionController::BackendAllocation& available =
+        query.lease->available[resources_it->first];
+    available.mem_to_admit += resources_it->second.mem_to_admit;
+    available.slots_to_use += resources_it->second.slots_to_use;
+    return query.resources.erase(resources_it);
+  };
+  if (backends == nullptr) {
+    for (auto resources_it = query.resources.begin();
+         resources_it != query.resources.end();) {
+      resources_it = release(resources_it);
+    }
+  } else {
+    for (const NetworkAddressPB& backend : *backends) {
+      auto resources_it = query.resources.find(backend);
+      if (resources_it != query.resources.end()) release(resources_it);
+    }
+  }
+  // The query keeps counting against the lease until ReleaseQuery() is called.
+  if (backends == nullptr) {
+    --query.lease->num_queries;
+    DCHECK_GE(query.lease->num_queries, 0);
+    queries_.erase(it);
+  }
+}
+
+void AdmissionLeaseMgr::TakeExpiredLeases(int64_t now_ms,
+    vector<shared_ptr<Lease>>* expired, AdmissionHeartbeatRequestPB* heartbeat) {
+  lock_guard<mutex> l(lock_);
+  // Lease => its usage in 'heartbeat'.
+  unordered_map<const Lease*, AdmissionLeaseUsagePB*> lease_usage;
+  auto add_lease = [heartbeat, &lease_usage](const Lease* lease) {
+    *heartbeat->add_query_ids() = lease->id;
+    AdmissionLeaseUsagePB* usage = heartbeat->add_lease_usage();
+    *usage->mutable_lease_id() = lease->id;
+    lease_usage[lease] = usage;
+  };
+  for (auto it = active_leases_.begin(); it != active_leases_.end();) {
+    if (now_ms >= it->second->expiry_ms) {
+      draining_leases_.push_back(move(it->second));
+      it = active_leases_.erase(it);
+    } else {
+      add_lease(it->second.get());
+      ++it;
+    }
+  }
+  for (const UniqueIdPB& lease_id : acquiring_lease_ids_) {
+    *heartbeat->add_query_ids() = lease_id;
+  }
+  auto keep_end = std::partition(draining_leases_.begin(), draining_leases_.end(),
+      [](const shared_ptr<Lease>& lease) { return lease->num_queries > 0; });
+  for (auto it = draining_leases_.begin(); it != keep_end; ++it) add_lease(it->get());
+  expired->insert(expired->end(), make_move_iterator(keep_end),
+      make_move_iterator(draining_leases_.end()));
+  draining_leases_.erase(keep_end, draining_leases_.end());
+  for (const auto& entry : queries_) {
+    auto usage_it = lease_usage.find(entry.second.lease.get());
+    DCHECK(usage_it != lease_usage.end());
+    usage_it->second->add_users(entry.second.user);
+  }
+}
+
+Status AdmissionLeaseMgr::AcquireLease(
+    const string& pool_name, shared_ptr<Lease>* lease) {
+  UniqueIdPB lease_id;
+  TUniqueIdToUniqueIdPB(GenerateUUID(), &lease_id);
+  {
+    // Include the lease in the admission heartbeat from now on, so that it isn't
+    // released by the admissiond if a heartbeat races with the rpc.
+    lock_guard<mutex> l(lock_);
+    acquiring_lease_ids_.insert(lease_id);
+  }
+  Status status = SendAdmitLease(pool_name, lease_id, lease);
+  if (status.ok()) {
+    AddLease(*lease);
+  } else {
+    lock_guard<mutex> l(lock_);
+    acquiring_lease_ids_.erase(lease_id);
+  }
+  return status;
+}
+
+Status AdmissionLeaseMgr::SendAdmitLease(const string& pool_name,
+    const UniqueIdPB& lease_id, shared_ptr<Lease>* lease) {
+  unique_ptr<AdmissionControlServiceProxy> proxy;
+  RETURN_IF_ERROR(AdmissionControlService::GetProxy(&proxy));
+  AdmitLeaseRequestPB req;
+  AdmitLeaseResponsePB resp;
+  *req.mutable_lease_id() = lease_id;
+  *req.mutable_coord_id() = ExecEnv::GetInstance()->backend_id();
+  req.set_request_pool(pool_name);
+  req.set_mem_per_backend(FLAGS_admission_lease_mem_per_host);
+  req.set_slots_per_backend(FLAGS_admission_lease_slots_per_host);
+  RpcController rpc_controller;
+  rpc_controller.set_timeout(MonoDelta::FromMilliseconds(RPC_TIMEOUT_MS));
+  int64_t start_ms = MonotonicMillis();
+  KUDU_RETURN_IF_ERROR(
+      proxy->AdmitLease(req, &resp, &rpc_controller), "AdmitLease rpc failed");
+  RETURN_IF_ERROR(Status(resp.status()));
+
+  lease->reset(new Lease());
+  (*lease)->id = lease_id;
+  (*lease)->pool_name = pool_name;
+  (*lease)->executor_group = resp.executor_group();
+  (*lease)->expiry_ms = start_ms + FLAGS_admission_lease_duration_ms;
+  (*lease)->max_queries = resp.max_queries();
+  for (const NetworkAddressPB& backend : resp.backends()) {
+    AdmissionController::BackendAllocation& available = (*lease)->available[backend];
+    available.mem_to_admit = FLAGS_admission_lease_mem_per_host;
+    available.slots_to_use = FLAGS_admission_lease_slots_per_host;
+  }
+  leases_acquired_->Increment(1);
+  VLOG_QUERY << "Acquired lease id=" << PrintId(lease_id) << " for pool " << pool_name
+             << " on executor group " << resp.executor_group() << " for up to "
+             << resp.max_queries() << " queries";
+  return Status::OK();
+}
+
+void AdmissionLeaseMgr::ReturnLease(const Lease& lease) {
+  VLOG_QUERY << "Returning lease id=" << PrintId(lease.id);
+  unique_ptr<AdmissionControlServiceProxy> proxy;
+  Status status = AdmissionControlService::GetProxy(&proxy);
+  if (!status.ok()) {
+    LOG(WARNING) << "Returning lease " << PrintId(lease.id)
+                 << " failed to get proxy: " << status;
+    return;
+  }
+  ReleaseQueryRequestPB req;
+  ReleaseQueryResponsePB resp;
+  *req.mutable_query_id() = lease.id;
+  req.set_peak_mem_consumption(-1);
+  // If this fails, the admission heartbeat releases the lease since its id isn't
+  // included anymore.
+  status = RpcMgr::DoRpcWithRetry(proxy, &AdmissionControlServiceProxy::ReleaseQuery,
+      req, &resp, TQueryCtx(), "ReleaseQuery() RPC failed", /* times_to_try */ 3,
+      RPC_TIMEOUT_MS);
+  if (status.ok()) status = Status(resp.status());
+  if (!status.ok()) {
+    LOG(WARNING) << "Returning lease " << PrintId(lease.id) << " failed: " << status;
+  }
+}
+
+} // namespace impala
@@ -0,0 +1,198 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "common/status.h"
+#include "gen-cpp/common.pb.h"
+#include "scheduling/admission-controller.h"
+#include "util/metrics-fwd.h"
+#include "util/unique-id-hash.h"
+
+namespace impala {
+
+class AdmissionHeartbeatRequestPB;
+class AdmissionHeartbeatResponsePB;
+class MetricGroup;
+class QuerySchedulePB;
+
+/// Admits small queries on a coordinator against resources that it leased from the
+/// admission control service, so that they don't pay for the AdmitQuery(),
+/// GetQueryStatus(), ReleaseQueryBackends() and ReleaseQuery() rpcs, which can dominate
+/// the latency of sub-second queries.
+///
+/// A lease reserves --admission_lease_mem_per_host bytes and
+/// --admission_lease_slots_per_host slots on every backend of one executor group of a
+/// pool and on the coordinator. It is admitted by the admissiond like running queries,
+/// i.e. it counts against the limits of the pool and is never queued, and it is kept
+/// alive by the admission heartbeat. The admissiond limits the number of queries that may
+/// run against the lease at the same time so that the running queries of the pool stay
+/// within its limit, and the lease counts as that many running queries. Queries of the
+/// pool are scheduled locally on the leased executor group and admitted if all of their
+/// backends fit into what is left of the lease. Everything else, including queries that
+/// don't fit and queries of pools for which no lease could be acquired, goes through the
+/// admission control service as usual.
+///
+/// The admission heartbeat reports the users of the queries running against each lease,
+/// so that they count as running queries of their users in the admissiond. If queries of
+/// the pool are queued in the admissiond, it revokes the lease in the heartbeat response
+/// and no new queries are admitted against it, so that they don't overtake the queued
+/// ones.
+///
+/// New queries are admitted against a lease for --admission_lease_duration_ms. After
+/// that it is returned with a single ReleaseQuery() rpc once its last query finished, so
+/// that leased resources are periodically given back to the other coordinators.
+///
+/// Thread safe.
+class AdmissionLeaseMgr {
+ public:
+  typedef std::unordered_map<NetworkAddressPB, AdmissionController::BackendAllocation>
+      BackendResources;
+
+  AdmissionLeaseMgr(MetricGroup* metrics);
+
+  /// Returns true if coordinators should lease resources from the admission control
+  /// service.
+  static bool IsEnabled();
+
+  /// Tries to admit 'request' against a lease of its pool, acquiring one first if
+  /// needed. Returns true and sets 'schedule_result' if the query was admitted, in which
+  /// case its resources must be returned with ReleaseQuery(). Returns false if the query
+  /// must be submitted to the admission control service instead.
+  bool TryAdmit(const AdmissionController::AdmissionRequest& request,
+      std::unique_ptr<QuerySchedulePB>* schedule_result);
+
+  /// Returns the resources that query 'query_id' used on 'backends' to its lease.
+  /// Returns false if the query was not admitted by TryAdmit().
+  bool ReleaseQueryBackends(
+      const UniqueIdPB& query_id, const std::vector<NetworkAddressPB>& backends);
+
+  /// Returns all remaining resources of query 'query_id' to its lease. Returns false if
+  /// the query was not admitted by TryAdmit().
+  bool ReleaseQuery(const UniqueIdPB& query_id);
+
+  /// Returns expired leases without running queries to the admission control service.
+  /// Adds the ids of the remaining ones to the query ids of 'heartbeat' to keep them
+  /// alive and the users of the queries running against them to its lease usage.
+  void ReturnExpiredLeases(AdmissionHeartbeatRequestPB* heartbeat);
+
+  /// Stops admitting queries against the leases that the admission control service
+  /// revoked in 'response'.
+  void RevokeLeases(const AdmissionHeartbeatResponsePB& response);
+
+ private:
+  friend class AdmissionLeaseMgrTest;
+
+  struct Lease {
+    UniqueIdPB id;
+    std::string pool_name;
+    std::string executor_group;
+
+    /// No new queries are admitted against the lease at or after this time.
+    int64_t expiry_ms;
+
+    /// Maximum number of queries that may run against the lease at the same time.
+    int max_queries;
+
+    /// Leased resources that are not used by any query.
+    BackendResources available;
+
+    /// Number of queries admitted against the lease that were not released yet.
+    int num_queries = 0;
+  };
+
+  /// Resources used by a query admitted against 'lease'.
+  struct LeasedQuery {
+    std::shared_ptr<Lease> lease;
+    BackendResources resources;
+
+    /// Effective user of the query.
+    std::string user;
+  };
+
+  /// Returns the lease that queries of 'pool_name' can be admitted against at 'now_ms',
+  /// or nullptr if there is none. Moves an expired lease to 'draining_leases_'. If
+  /// 'may_acquire' is set to true, no other thread is acquiring a lease for the pool
+  /// and the caller should do so.
+  std::shared_ptr<Lease> GetLease(
+      const std::string& pool_name, int64_t now_ms, bool* may_acquire);
+
+  /// Makes 'lease' the one that new queries of its pool are admitted against.
+  void AddLease(std::shared_ptr<Lease> lease);
+
+  /// Takes 'resources' for query 'query_id' of 'user' from 'lease'. Returns false if
+  /// 'lease' has expired at 'now_ms', already runs its maximum number of queries or
+  /// doesn't have enough resources left on all backends.
+  bool Reserve(const std::shared_ptr<Lease>& lease, const UniqueIdPB& query_id,
+      const std::string& user, const BackendResources& resources, int64_t now_ms);
+
+  /// Returns the resources of the query in 'it' on 'backends' to its lease. If
+  /// 'backends' is nullptr, returns all of them and removes the query. Must hold
+  /// 'lock_'.
+  void ReleaseLocked(std::unordered_map<UniqueIdPB, LeasedQuery>::iterator it,
+      const std::vector<NetworkAddressPB>* backends);
+
+  /// Removes leases that expired at 'now_ms' and have no running queries and returns
+  /// them in 'expired'. Adds the ids of all other leases, including the ones being
+  /// acquired, to the query ids of 'heartbeat' and the users of the queries running
+  /// against the acquired ones to its lease usage.
+  void TakeExpiredLeases(int64_t now_ms, std::vector<std::shared_ptr<Lease>>* expired,
+      AdmissionHeartbeatRequestPB* heartbeat);
+
+  /// Leases resources of 'pool_name' from the admission control service. On success
+  /// adds the lease with AddLease() and returns it in 'lease'.
+  Status AcquireLease(const std::string& pool_name, std::shared_ptr<Lease>* lease);
+
+  /// Sends the AdmitLease() rpc for 'pool_name' and returns the granted lease in 'lease'.
+  Status SendAdmitLease(const std::string& pool_name, const UniqueIdPB& lease_id,
+      std::shared_ptr<Lease>* lease);
+
+  /// Sends the ReleaseQuery() rpc for 'lease'.
+  void ReturnLease(const Lease& lease);
+
+  /// Protects all of the following members.
+  std::mutex lock_;
+
+  /// Pool name => the lease that new queries of the pool are admitted against.
+  std::unordered_map<std::string, std::shared_ptr<Lease>> active_leases_;
+
+  /// Expired leases that still have running queries.
+  std::vector<std::shared_ptr<Lease>> draining_leases_;
+
+  /// Ids of leases for which the AdmitLease() rpc is in flight.
+  std::unordered_set<UniqueIdPB> acquiring_lease_ids_;
+
+  /// Pool name => time before which no new lease is requested for the pool. Set while a
+  /// lease is being acquired and after an attempt failed.
+  std::unordered_map<std::string, int64_t> next_acquire_ms_;
+
+  /// Query id => resources of queries admitted by TryAdmit() that were not released yet.
+  std::unordered_map<UniqueIdPB, LeasedQuery> queries_;
+
+  /// Metrics.
+  IntCounter* leases_acquired_;
+  IntCounter* queries_admitted_;
+};
+
+} // namespace impala
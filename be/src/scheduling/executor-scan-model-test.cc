@@ -0,0 +1,74 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/executor-scan-model.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int64_t GB = 1024L * 1024L * 1024L;
+static const int64_t SECOND_NS = 1000L * 1000L * 1000L;
+
+class ExecutorScanModelTest : public testing::Test {
+ protected:
+  virtual void SetUp() override { model_.Clear(); }
+  ExecutorScanModel model_;
+};
+
+/// Throughput is decayed across updates and small measurements are ignored.
+TEST_F(ExecutorScanModelTest, Update) {
+  EXPECT_EQ(model_.GetThroughput("10.0.0.1"), 0);
+  model_.Update("10.0.0.1", GB, SECOND_NS);
+  EXPECT_DOUBLE_EQ(model_.GetThroughput("10.0.0.1"), GB);
+  model_.Update("10.0.0.1", 2 * GB, SECOND_NS);
+  EXPECT_DOUBLE_EQ(model_.GetThroughput("10.0.0.1"),
+      ExecutorScanModel::DECAY_WEIGHT * 2 * GB
+          + (1 - ExecutorScanModel::DECAY_WEIGHT) * GB);
+  model_.Clear();
+  model_.Update("10.0.0.1", 1024, SECOND_NS);
+  model_.Update("10.0.0.1", GB, 1000);
+  EXPECT_EQ(model_.GetThroughput("10.0.0.1"), 0);
+}
+
+/// Slow executors get a higher cost per byte than fast ones, bounded by MAX_COST_FACTOR.
+/// Executors without history are treated as average ones.
+TEST_F(ExecutorScanModelTest, CostFactors) {
+  vector<IpAddr> ips = {"10.0.0.1", "10.0.0.2", "10.0.0.3", "10.0.0.4"};
+  boost::unordered_map<IpAddr, double> cost_factors;
+  model_.Update(ips[0], GB, SECOND_NS);
+  model_.GetCostFactors(ips, &cost_factors);
+  for (const IpAddr& ip : ips) EXPECT_EQ(cost_factors[ip], 1);
+
+  model_.Update(ips[1], 3 * GB, SECOND_NS);
+  model_.Update(ips[2], 100 * GB, SECOND_NS);
+  cost_factors.clear();
+  model_.GetCostFactors(ips, &cost_factors);
+  double mean = (1 + 3 + 100) * GB / 3.0;
+  EXPECT_DOUBLE_EQ(cost_factors[ips[0]], ExecutorScanModel::MAX_COST_FACTOR);
+  EXPECT_DOUBLE_EQ(cost_factors[ips[1]], ExecutorScanModel::MAX_COST_FACTOR);
+  EXPECT_DOUBLE_EQ(cost_factors[ips[2]], mean / (100 * GB));
+  EXPECT_EQ(cost_factors[ips[3]], 1);
+
+  // Only the executors that take part in the scan determine the mean.
+  cost_factors.clear();
+  model_.GetCostFactors({ips[0], ips[1]}, &cost_factors);
+  EXPECT_DOUBLE_EQ(cost_factors[ips[0]], 2);
+  EXPECT_DOUBLE_EQ(cost_factors[ips[1]], 2.0 / 3);
+}
+}
@@ -0,0 +1,87 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/executor-scan-model.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+constexpr double ExecutorScanModel::DECAY_WEIGHT;
+constexpr double ExecutorScanModel::MAX_COST_FACTOR;
+
+ExecutorScanModel* ExecutorScanModel::GetInstance() {
+  static ExecutorScanModel model;
+  return &model;
+}
+
+void ExecutorScanModel::Update(
+    const IpAddr& ip, int64_t bytes_read, int64_t scan_time_ns) {
+  if (bytes_read < MIN_BYTES_FOR_UPDATE) return;
+  if (scan_time_ns < MIN_SCAN_TIME_NS_FOR_UPDATE) return;
+  double throughput = bytes_read / (scan_time_ns / 1e9);
+  lock_guard<SpinLock> l(lock_);
+  auto it = throughputs_.find(ip);
+  if (it == throughputs_.end()) {
+    throughputs_.emplace(ip, throughput);
+  } else {
+    it->second = DECAY_WEIGHT * throughput + (1 - DECAY_WEIGHT) * it->second;
+  }
+}
+
+double ExecutorScanModel::GetThroughput(const IpAddr& ip) const {
+  lock_guard<SpinLock> l(lock_);
+  auto it = throughputs_.find(ip);
+  return it == throughputs_.end() ? 0 : it->second;
+}
+
+void ExecutorScanModel::GetCostFactors(const vector<IpAddr>& ips,
+    boost::unordered_map<IpAddr, double>* cost_factors) const {
+  vector<double> throughputs(ips.size(), 0);
+  double sum_throughput = 0;
+  int num_known = 0;
+  {
+    lock_guard<SpinLock> l(lock_);
+    for (int i = 0; i < ips.size(); ++i) {
+      auto it = throughputs_.find(ips[i]);
+      if (it == throughputs_.end()) continue;
+      throughputs[i] = it->second;
+      sum_throughput += it->second;
+      ++num_known;
+    }
+  }
+  double mean_throughput = num_known > 0 ? sum_throughput / num_known : 0;
+  for (int i = 0; i < ips.size(); ++i) {
+    double factor = 1;
+    if (num_known >= 2 && throughputs[i] > 0) {
+      factor = min(MAX_COST_FACTOR,
+          max(1 / MAX_COST_FACTOR, mean_throughput / throughputs[i]));
+    }
+    (*cost_factors)[ips[i]] = factor;
+  }
+}
+
+void ExecutorScanModel::Clear() {
+  lock_guard<SpinLock> l(lock_);
+  throughputs_.clear();
+}
+}
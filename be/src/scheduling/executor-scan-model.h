@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+#include "util/network-util.h"
+#include "util/spinlock.h"
+
+namespace impala {
+
+/// Process-wide model of how fast each executor scans data, fed from the resource
+/// utilization of completed queries (see Coordinator::ComputeQuerySummary()). For every
+/// executor it keeps the number of bytes its scan nodes read per second of scan node
+/// time, exponentially decayed across queries. The measured throughput includes the
+/// effect of the executor's disks, CPUs and its data cache hit rate, so executors with
+/// faster hardware or hot caches end up with a higher throughput.
+///
+/// The scheduler uses the model to weigh the bytes it assigns to each executor by the
+/// executor's relative cost of scanning a byte, so that it balances the predicted scan
+/// time instead of the number of bytes. Executors without history are treated as
+/// average ones. Thread safe.
+class ExecutorScanModel {
+ public:
+  static ExecutorScanModel* GetInstance();
+
+  /// Records that the scan nodes of a query on executor 'ip' read 'bytes_read' bytes
+  /// in 'scan_time_ns' nanoseconds, summed over all fragment instances. Queries that read
+  /// too little data for a meaningful measurement are ignored.
+  void Update(const IpAddr& ip, int64_t bytes_read, int64_t scan_time_ns);
+
+  /// Returns the decayed scan throughput of 'ip' in bytes per second, or 0 if there is
+  /// no history for it.
+  double GetThroughput(const IpAddr& ip) const;
+
+  /// Fills 'cost_factors' with the relative cost of scanning a byte on each executor in
+  /// 'ips': the mean throughput of the executors with history divided by the executor's
+  /// throughput, bounded to [1 / MAX_COST_FACTOR, MAX_COST_FACTOR]. Executors without
+  /// history get a factor of 1. All factors are 1 unless at least two executors in 'ips'
+  /// have history.
+  void GetCostFactors(const std::vector<IpAddr>& ips,
+      boost::unordered_map<IpAddr, double>* cost_factors) const;
+
+  /// Removes all history. Used by tests.
+  void Clear();
+
+  /// Weight of the most recent query in the decayed throughput.
+  static constexpr double DECAY_WEIGHT = 0.2;
+
+  /// Bound on the relative cost of scanning a byte on a single executor, which limits the
+  /// impact of a misleading measurement.
+  static constexpr double MAX_COST_FACTOR = 4.0;
+
+  /// Minimum amount of data and scan time of a query on an executor to update its
+  /// history.
+  static const int64_t MIN_BYTES_FOR_UPDATE = 16L * 1024L * 1024L;
+  static const int64_t MIN_SCAN_TIME_NS_FOR_UPDATE = 100L * 1000L * 1000L;
+
+ private:
+  /// Protects 'throughputs_'.
+  mutable SpinLock lock_;
+
+  /// Executor IP address => decayed scan throughput in bytes per second.
+  boost::unordered_map<IpAddr, double> throughputs_;
+};
+}
@@ -225,4 +225,46 @@ TEST_F(HashRingTest, MaxMinRatio) {
   }
 }
 
+TEST_F(HashRingTest, BoundedLoad) {
+  vector<IpAddr> addresses;
+  GetMultipleNetworkAddresses("bounded_load_host", 10, addresses);
+  HashRing h(25);
+  int num_skipped;
+  EXPECT_EQ(h.GetNodeWithBoundedLoad(0, [](const IpAddr&) { return false; },
+      &num_skipped), nullptr);
+  for (const IpAddr& addr : addresses) h.AddNode(addr);
+
+  // Without overloaded nodes the lookup matches GetNode(). If all nodes are overloaded,
+  // it also falls back to GetNode().
+  pcg32 prng(1234);
+  for (int i = 0; i < 100; ++i) {
+    uint32_t hash = prng();
+    EXPECT_EQ(h.GetNodeWithBoundedLoad(hash, [](const IpAddr&) { return false; },
+        &num_skipped), h.GetNode(hash));
+    EXPECT_EQ(num_skipped, 0);
+    EXPECT_EQ(h.GetNodeWithBoundedLoad(hash, [](const IpAddr&) { return true; },
+        &num_skipped), h.GetNode(hash));
+    EXPECT_EQ(num_skipped, 0);
+  }
+
+  // Assign items with a load bound of 1.25 times the average. No node exceeds the bound
+  // and most items stay on their preferred node.
+  const int num_items = 10000;
+  std::map<IpAddr, int> loads;
+  int num_affine = 0;
+  for (int i = 0; i < num_items; ++i) {
+    int capacity = ceil(1.25 * (i + 1) / addresses.size());
+    const IpAddr* node = h.GetNodeWithBoundedLoad(prng(),
+        [&loads, capacity](const IpAddr& ip) { return loads[ip] + 1 > capacity; },
+        &num_skipped);
+    ASSERT_TRUE(node != nullptr);
+    ++loads[*node];
+    if (num_skipped == 0) ++num_affine;
+  }
+  for (const auto& entry : loads) {
+    EXPECT_LE(entry.second, ceil(1.25 * num_items / addresses.size()));
+  }
+  EXPECT_GT(num_affine, num_items / 2);
+}
+
 }
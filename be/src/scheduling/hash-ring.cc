@@ -17,6 +17,7 @@
 
 #include <map>
 #include <random>
+#include <unordered_set>
 
 #include "scheduling/hash-ring.h"
 #include "thirdparty/pcg-cpp-0.98/include/pcg_random.hpp"
@@ -97,6 +98,28 @@ const IpAddr* HashRing::GetNode(uint32_t hash_value) const {
   return &(*node_it);
 }
 
+const IpAddr* HashRing::GetNodeWithBoundedLoad(uint32_t hash_value,
+    const std::function<bool(const IpAddr&)>& is_overloaded, int* num_skipped) const {
+  *num_skipped = 0;
+  if (hash_to_node_.empty()) return nullptr;
+  auto elem = hash_to_node_.lower_bound(hash_value);
+  if (elem == hash_to_node_.end()) elem = hash_to_node_.begin();
+  const IpAddr* first_node = &(*elem->second);
+  // Nodes appear 'num_replicas_' times on the ring, so remember the ones that were
+  // already found to be overloaded.
+  std::unordered_set<const IpAddr*> visited;
+  for (size_t i = 0; i < hash_to_node_.size() && visited.size() < nodes_.size(); ++i) {
+    const IpAddr* node = &(*elem->second);
+    if (visited.insert(node).second) {
+      if (!is_overloaded(*node)) return node;
+      ++*num_skipped;
+    }
+    if (++elem == hash_to_node_.end()) elem = hash_to_node_.begin();
+  }
+  *num_skipped = 0;
+  return first_node;
+}
+
 void HashRing::GetDistributionMap(
     map<IpAddr, uint64_t>* distribution_map) const {
   // Start at zero and add up the ranges for each distinct node by walking the map.
@@ -18,6 +18,7 @@
 #ifndef SCHEDULING_HASH_RING_H
 #define SCHEDULING_HASH_RING_H
 
+#include <functional>
 #include <map>
 #include <set>
 #include <vector>
@@ -82,6 +83,18 @@ class HashRing {
   /// is larger than the largest hash value, it gets the element with the smallest hash
   /// value. If the hash ring is empty, this returns nullptr.
   const IpAddr* GetNode(uint32_t hash_value) const;
+
+  /// Bounded-load lookup: walks the ring from 'hash_value' like GetNode() and returns the
+  /// first distinct node for which 'is_overloaded' returns false, i.e. an item spills
+  /// over to the next node in ring order while its preferred node is at capacity. This
+  /// keeps the affinity of items to nodes of consistent hashing, also when nodes are
+  /// added or removed, while no node receives more than its share. Sets 'num_skipped' to
+  /// the number of overloaded nodes that were skipped. If all nodes are overloaded,
+  /// returns the same node as GetNode() and sets 'num_skipped' to 0. Returns nullptr if
+  /// the hash ring is empty.
+  const IpAddr* GetNodeWithBoundedLoad(uint32_t hash_value,
+      const std::function<bool(const IpAddr&)>& is_overloaded, int* num_skipped) const;
+
  private:
   friend class HashRingTest;
   friend class HashRingDistributionCheck;
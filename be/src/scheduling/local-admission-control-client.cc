@@ -48,9 +48,10 @@ Status LocalAdmissionControlClient::SubmitForAdmission(
   return status;
 }
 
-void LocalAdmissionControlClient::ReleaseQuery(int64_t peak_mem_consumption) {
-  ExecEnv::GetInstance()->admission_controller()->ReleaseQuery(
-      query_id_, ExecEnv::GetInstance()->backend_id(), peak_mem_consumption);
+void LocalAdmissionControlClient::ReleaseQuery(
+    int64_t peak_mem_consumption, bool query_succeeded) {
+  ExecEnv::GetInstance()->admission_controller()->ReleaseQuery(query_id_,
+      ExecEnv::GetInstance()->backend_id(), peak_mem_consumption, query_succeeded);
 }
 
 void LocalAdmissionControlClient::ReleaseQueryBackends(
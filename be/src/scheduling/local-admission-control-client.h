@@ -38,7 +38,7 @@ class LocalAdmissionControlClient : public AdmissionControlClient {
   virtual Status SubmitForAdmission(const AdmissionController::AdmissionRequest& request,
       RuntimeProfile::EventSequence* query_events,
       std::unique_ptr<QuerySchedulePB>* schedule_result) override;
-  virtual void ReleaseQuery(int64_t peak_mem_consumption) override;
+  virtual void ReleaseQuery(int64_t peak_mem_consumption, bool query_succeeded) override;
   virtual void ReleaseQueryBackends(
       const std::vector<NetworkAddressPB>& host_addr) override;
   virtual void CancelAdmission() override;
@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/query-memory-history.h"
+#include "gen-cpp/Query_types.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int64_t MEGABYTE = 1024L * 1024L;
+
+/// Estimates are a percentile of the most recent samples plus the safety margin and
+/// require a minimum number of samples.
+TEST(QueryMemoryHistoryTest, Estimate) {
+  QueryMemoryHistory history(10, 10, 3, 90, 0.5);
+  int64_t estimate;
+  EXPECT_FALSE(history.GetMemEstimate(1, &estimate));
+  history.AddSample(1, 100 * MEGABYTE);
+  history.AddSample(1, 0);
+  history.AddSample(1, 200 * MEGABYTE);
+  EXPECT_FALSE(history.GetMemEstimate(1, &estimate));
+  history.AddSample(1, 300 * MEGABYTE);
+  ASSERT_TRUE(history.GetMemEstimate(1, &estimate));
+  EXPECT_EQ(estimate, 450 * MEGABYTE);
+
+  // Only the last 10 samples are kept, so the large first sample ages out.
+  QueryMemoryHistory window(10, 10, 1, 100, 0);
+  window.AddSample(1, 1000 * MEGABYTE);
+  for (int i = 1; i <= 10; ++i) window.AddSample(1, i * MEGABYTE);
+  ASSERT_TRUE(window.GetMemEstimate(1, &estimate));
+  EXPECT_EQ(estimate, 10 * MEGABYTE);
+}
+
+/// The least recently used signature is evicted when the history is full.
+TEST(QueryMemoryHistoryTest, Eviction) {
+  QueryMemoryHistory history(2, 10, 1, 50, 0);
+  int64_t estimate;
+  history.AddSample(1, MEGABYTE);
+  history.AddSample(2, MEGABYTE);
+  EXPECT_TRUE(history.GetMemEstimate(1, &estimate));
+  history.AddSample(3, MEGABYTE);
+  EXPECT_EQ(history.num_signatures(), 2);
+  EXPECT_TRUE(history.GetMemEstimate(1, &estimate));
+  EXPECT_FALSE(history.GetMemEstimate(2, &estimate));
+  EXPECT_TRUE(history.GetMemEstimate(3, &estimate));
+}
+
+/// The signature depends on the shape of the plan, but not on other parts of the request.
+TEST(QueryMemoryHistoryTest, Signature) {
+  TQueryExecRequest request;
+  TPlanExecInfo plan_exec_info;
+  TPlanFragment fragment;
+  TPlanNode scan;
+  scan.__set_node_type(TPlanNodeType::HDFS_SCAN_NODE);
+  scan.__set_label("00:SCAN HDFS");
+  scan.__set_label_detail("functional.alltypes");
+  TPlanNode agg;
+  agg.__set_node_type(TPlanNodeType::AGGREGATION_NODE);
+  agg.__set_num_children(1);
+  agg.__set_label("01:AGGREGATE");
+  fragment.plan.nodes = {agg, scan};
+  fragment.__isset.plan = true;
+  plan_exec_info.fragments.push_back(fragment);
+  request.plan_exec_info.push_back(plan_exec_info);
+  uint64_t signature = QueryMemoryHistory::ComputeSignature(request);
+
+  request.__set_query_plan("different explain string");
+  EXPECT_EQ(QueryMemoryHistory::ComputeSignature(request), signature);
+  request.plan_exec_info[0].fragments[0].plan.nodes[1].__set_label_detail(
+      "functional.alltypessmall");
+  EXPECT_NE(QueryMemoryHistory::ComputeSignature(request), signature);
+}
+}
@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/query-memory-history.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "common/logging.h"
+#include "gen-cpp/Query_types.h"
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+QueryMemoryHistory::QueryMemoryHistory(int max_signatures,
+    int max_samples_per_signature, int min_samples, double percentile,
+    double safety_margin)
+  : max_signatures_(max_signatures),
+    max_samples_per_signature_(max_samples_per_signature),
+    min_samples_(min_samples),
+    percentile_(percentile),
+    safety_margin_(safety_margin) {
+  DCHECK_GT(max_signatures_, 0);
+  DCHECK_GT(max_samples_per_signature_, 0);
+  DCHECK_GT(percentile_, 0);
+  DCHECK_LE(percentile_, 100);
+}
+
+static uint64_t HashString(const string& str, uint64_t seed) {
+  return HashUtil::MurmurHash2_64(str.data(), str.size(), seed);
+}
+
+template <typename T>
+static uint64_t HashValue(const T& value, uint64_t seed) {
+  return HashUtil::MurmurHash2_64(&value, sizeof(value), seed);
+}
+
+uint64_t QueryMemoryHistory::ComputeSignature(const TQueryExecRequest& request) {
+  uint64_t hash = HashValue(request.stmt_type, 0);
+  const TQueryOptions& query_options = request.query_ctx.client_request.query_options;
+  hash = HashValue(query_options.mt_dop, hash);
+  for (const TPlanExecInfo& plan_exec_info : request.plan_exec_info) {
+    for (const TPlanFragment& fragment : plan_exec_info.fragments) {
+      hash = HashValue(fragment.partition.type, hash);
+      if (!fragment.__isset.plan) continue;
+      for (const TPlanNode& node : fragment.plan.nodes) {
+        hash = HashValue(node.node_type, hash);
+        hash = HashValue(node.num_children, hash);
+        hash = HashString(node.label, hash);
+        hash = HashString(node.label_detail, hash);
+      }
+    }
+  }
+  return hash;
+}
+
+void QueryMemoryHistory::Touch(Entry* entry) {
+  lru_list_.splice(lru_list_.begin(), lru_list_, entry->lru_it);
+}
+
+void QueryMemoryHistory::AddSample(uint64_t signature, int64_t peak_mem) {
+  if (peak_mem <= 0) return;
+  auto it = entries_.find(signature);
+  if (it == entries_.end()) {
+    if (entries_.size() >= max_signatures_) {
+      entries_.erase(lru_list_.back());
+      lru_list_.pop_back();
+    }
+    lru_list_.push_front(signature);
+    it = entries_.emplace(signature, Entry()).first;
+    it->second.lru_it = lru_list_.begin();
+  } else {
+    Touch(&it->second);
+  }
+  deque<int64_t>& samples = it->second.samples;
+  samples.push_back(peak_mem);
+  if (samples.size() > max_samples_per_signature_) samples.pop_front();
+}
+
+bool QueryMemoryHistory::GetMemEstimate(uint64_t signature, int64_t* mem_estimate) {
+  auto it = entries_.find(signature);
+  if (it == entries_.end()) return false;
+  const deque<int64_t>& samples = it->second.samples;
+  if (samples.size() < max(min_samples_, 1)) return false;
+  Touch(&it->second);
+  // Nearest-rank percentile.
+  vector<int64_t> sorted(samples.begin(), samples.end());
+  int rank = static_cast<int>(ceil(percentile_ / 100 * sorted.size()));
+  int idx = max(0, min(rank, static_cast<int>(sorted.size())) - 1);
+  nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+  *mem_estimate = static_cast<int64_t>(sorted[idx] * (1 + safety_margin_));
+  return true;
+}
+}
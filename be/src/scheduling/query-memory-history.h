@@ -0,0 +1,87 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <unordered_map>
+
+namespace impala {
+
+class TQueryExecRequest;
+
+/// History of the actual per-host peak memory consumption of completed queries, keyed
+/// by a signature of their plan. Used by the AdmissionController to admit recurring
+/// queries based on the memory that they actually used in the past instead of the
+/// planner's estimate, which is often far off in either direction.
+///
+/// The signature is a hash of the shape of the plan: the type, label and details of each
+/// plan node (e.g. table names and join strategies) and the mt_dop. Literals in
+/// predicates are not part of it, so that runs of the same report with different
+/// parameters share their history.
+///
+/// For each signature the most recent 'max_samples_per_signature' samples are kept. The
+/// number of signatures is bounded by 'max_signatures', evicting the least recently used
+/// one. Not thread safe.
+class QueryMemoryHistory {
+ public:
+  /// 'percentile' is in (0, 100]. The estimate is the given percentile of the samples,
+  /// increased by the fraction 'safety_margin'. Signatures with fewer than 'min_samples'
+  /// samples do not have an estimate.
+  QueryMemoryHistory(int max_signatures, int max_samples_per_signature, int min_samples,
+      double percentile, double safety_margin);
+
+  /// Returns the plan signature of 'request'.
+  static uint64_t ComputeSignature(const TQueryExecRequest& request);
+
+  /// Records that a query with plan signature 'signature' used at most 'peak_mem' bytes
+  /// on any host. Non-positive values are ignored.
+  void AddSample(uint64_t signature, int64_t peak_mem);
+
+  /// Returns true and sets 'mem_estimate' to the per-host memory to admit for queries
+  /// with plan signature 'signature' if there are enough samples for it.
+  bool GetMemEstimate(uint64_t signature, int64_t* mem_estimate);
+
+  int num_signatures() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    /// Most recent samples, oldest first.
+    std::deque<int64_t> samples;
+
+    /// Position in 'lru_list_'.
+    std::list<uint64_t>::iterator lru_it;
+  };
+
+  /// Moves 'entry' to the front of 'lru_list_'.
+  void Touch(Entry* entry);
+
+  const int max_signatures_;
+  const int max_samples_per_signature_;
+  const int min_samples_;
+  const double percentile_;
+  const double safety_margin_;
+
+  /// Signature => samples.
+  std::unordered_map<uint64_t, Entry> entries_;
+
+  /// Signatures in 'entries_', most recently used first.
+  std::list<uint64_t> lru_list_;
+};
+}
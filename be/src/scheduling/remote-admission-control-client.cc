@@ -25,6 +25,7 @@
 #include "rpc/sidecar-util.h"
 #include "runtime/exec-env.h"
 #include "scheduling/admission-control-service.h"
+#include "scheduling/admission-lease-mgr.h"
 #include "util/debug-util.h"
 #include "util/kudu-status-util.h"
 #include "util/runtime-profile-counters.h"
@@ -101,6 +102,11 @@ Status RemoteAdmissionControlClient::SubmitForAdmission(
   ScopedEvent completedEvent(
       query_events, AdmissionControlClient::QUERY_EVENT_COMPLETED_ADMISSION);
 
+  AdmissionLeaseMgr* lease_mgr = ExecEnv::GetInstance()->admission_lease_mgr();
+  if (lease_mgr != nullptr && lease_mgr->TryAdmit(request, schedule_result)) {
+    return Status::OK();
+  }
+
   std::unique_ptr<AdmissionControlServiceProxy> proxy;
   RETURN_IF_ERROR(AdmissionControlService::GetProxy(&proxy));
   AdmitQueryRequestPB req;
@@ -182,7 +188,11 @@ Status RemoteAdmissionControlClient::SubmitForAdmission(
   return admit_status;
 }
 
-void RemoteAdmissionControlClient::ReleaseQuery(int64_t peak_mem_consumption) {
+void RemoteAdmissionControlClient::ReleaseQuery(
+    int64_t peak_mem_consumption, bool query_succeeded) {
+  AdmissionLeaseMgr* lease_mgr = ExecEnv::GetInstance()->admission_lease_mgr();
+  if (lease_mgr != nullptr && lease_mgr->ReleaseQuery(query_id_)) return;
+
   std::unique_ptr<AdmissionControlServiceProxy> proxy;
   Status get_proxy_status = AdmissionControlService::GetProxy(&proxy);
   if (!get_proxy_status.ok()) {
@@ -195,6 +205,7 @@ void RemoteAdmissionControlClient::ReleaseQuery(int64_t peak_mem_consumption) {
   ReleaseQueryResponsePB resp;
   *req.mutable_query_id() = query_id_;
   req.set_peak_mem_consumption(peak_mem_consumption);
+  req.set_query_succeeded(query_succeeded);
   Status rpc_status =
       RpcMgr::DoRpcWithRetry(proxy, &AdmissionControlServiceProxy::ReleaseQuery, req,
           &resp, query_ctx_, "ReleaseQuery() RPC failed", RPC_NUM_RETRIES, RPC_TIMEOUT_MS,
@@ -214,6 +225,11 @@ void RemoteAdmissionControlClient::ReleaseQuery(int64_t peak_mem_consumption) {
 
 void RemoteAdmissionControlClient::ReleaseQueryBackends(
     const vector<NetworkAddressPB>& host_addrs) {
+  AdmissionLeaseMgr* lease_mgr = ExecEnv::GetInstance()->admission_lease_mgr();
+  if (lease_mgr != nullptr && lease_mgr->ReleaseQueryBackends(query_id_, host_addrs)) {
+    return;
+  }
+
   std::unique_ptr<AdmissionControlServiceProxy> proxy;
   Status get_proxy_status = AdmissionControlService::GetProxy(&proxy);
   if (!get_proxy_status.ok()) {
@@ -213,6 +213,11 @@ int64_t ScheduleState::GetPerExecutorMemoryEstimate() const {
   return request_.per_host_mem_estimate;
 }
 
+bool ScheduleState::UsesMemEstimateFromHistory() const {
+  return mem_estimate_from_history_ >= 0
+      && !(query_options().__isset.mem_limit && query_options().mem_limit > 0);
+}
+
 int64_t ScheduleState::GetDedicatedCoordMemoryEstimate() const {
   DCHECK(request_.__isset.dedicated_coord_mem_estimate);
   return request_.dedicated_coord_mem_estimate;
@@ -269,10 +274,21 @@ void ScheduleState::UpdateMemoryRequirements(const TPoolConfig& pool_cfg) {
   }
 
   if (!is_mem_limit_set) {
-    per_backend_mem_to_admit = GetPerExecutorMemoryEstimate();
+    // Prefer the memory that earlier runs of the same plan actually used over the
+    // estimate from planning. Executors never get more memory than MEM_LIMIT_EXECUTORS,
+    // so the estimate from the history is capped at it as well.
+    if (mem_estimate_from_history_ >= 0 && query_options().__isset.mem_limit_executors
+        && query_options().mem_limit_executors > 0) {
+      mem_estimate_from_history_ =
+          min(mem_estimate_from_history_, query_options().mem_limit_executors);
+    }
+    int64_t per_executor_mem_estimate = mem_estimate_from_history_ >= 0 ?
+        mem_estimate_from_history_ :
+        GetPerExecutorMemoryEstimate();
+    per_backend_mem_to_admit = per_executor_mem_estimate;
     coord_backend_mem_to_admit = use_dedicated_coord_estimates ?
         GetDedicatedCoordMemoryEstimate() :
-        GetPerExecutorMemoryEstimate();
+        per_executor_mem_estimate;
     VLOG(3) << "use_dedicated_coord_estimates=" << use_dedicated_coord_estimates
             << " coord_backend_mem_to_admit=" << coord_backend_mem_to_admit
             << " per_backend_mem_to_admit=" << per_backend_mem_to_admit;
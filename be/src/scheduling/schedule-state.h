@@ -172,6 +172,19 @@ class ScheduleState {
   /// Returns the estimated memory (bytes) per-node from planning.
   int64_t GetPerExecutorMemoryEstimate() const;
 
+  /// Sets the per-node memory (bytes) to use instead of the estimate from planning,
+  /// derived from the actual memory consumption of earlier runs of the same plan. Must
+  /// be called before UpdateMemoryRequirements() to take effect, which clamps it to the
+  /// MEM_LIMIT_EXECUTORS query option.
+  void set_mem_estimate_from_history(int64_t mem_estimate) {
+    mem_estimate_from_history_ = mem_estimate;
+  }
+  int64_t mem_estimate_from_history() const { return mem_estimate_from_history_; }
+
+  /// Returns true if UpdateMemoryRequirements() used the memory estimate from the
+  /// history, i.e. if there is one and the mem_limit query option is not set.
+  bool UsesMemEstimateFromHistory() const;
+
   /// Returns the estimated memory (bytes) for the coordinator backend returned by the
   /// planner. This estimate is only meaningful if this schedule was generated on a
   /// dedicated coordinator.
@@ -302,6 +315,9 @@ class ScheduleState {
   /// The query options from the TClientRequest
   const TQueryOptions& query_options_;
 
+  /// Per-node memory estimate from the QueryMemoryHistory, or -1 if there is none.
+  int64_t mem_estimate_from_history_ = -1;
+
   /// Contains the results of scheduling that will be sent back to the coordinator.
   /// Ownership is transferred to the coordinator after scheduling has completed.
   std::unique_ptr<QuerySchedulePB> query_schedule_pb_;
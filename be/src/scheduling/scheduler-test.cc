@@ -17,15 +17,22 @@
 
 #include <algorithm>
 #include <random>
+#include <gflags/gflags.h>
 
 #include "common/logging.h"
 #include "gen-cpp/control_service.pb.h"
 #include "scheduling/cluster-membership-mgr.h"
+#include "scheduling/cluster-membership-test-util.h"
+#include "scheduling/executor-group.h"
+#include "scheduling/executor-scan-model.h"
+#include "scheduling/schedule-state.h"
 #include "scheduling/scheduler.h"
 #include "scheduling/scheduler-test-util.h"
 #include "testutil/gtest-util.h"
 #include "testutil/rand-util.h"
 
+DECLARE_double(scan_range_holdback_fraction);
+
 using namespace impala;
 using namespace impala::test;
 
@@ -784,4 +791,156 @@ TEST_F(SchedulerTest, TestMultipleFinstances) {
     }
   }
 }
+
+// Test which scan nodes may have some of their ranges handed out while the query runs.
+TEST_F(SchedulerTest, TestCanHoldBackScanRanges) {
+  TPlanNode node;
+  node.node_type = TPlanNodeType::HDFS_SCAN_NODE;
+  node.hdfs_scan_node.use_mt_scan_node = true;
+  node.hdfs_scan_node.file_formats = {THdfsFileFormat::PARQUET, THdfsFileFormat::ORC,
+      THdfsFileFormat::TEXT, THdfsFileFormat::JSON};
+  EXPECT_TRUE(Scheduler::CanHoldBackScanRanges(node));
+
+  // Sequence-based scanners issue the splits of a file after reading its header.
+  TPlanNode seq_node = node;
+  seq_node.hdfs_scan_node.file_formats.push_back(THdfsFileFormat::SEQUENCE_FILE);
+  EXPECT_FALSE(Scheduler::CanHoldBackScanRanges(seq_node));
+  TPlanNode avro_node = node;
+  avro_node.hdfs_scan_node.file_formats = {THdfsFileFormat::AVRO};
+  EXPECT_FALSE(Scheduler::CanHoldBackScanRanges(avro_node));
+
+  // Only multi-threaded scans ask the coordinator for more ranges.
+  TPlanNode non_mt_node = node;
+  non_mt_node.hdfs_scan_node.use_mt_scan_node = false;
+  EXPECT_FALSE(Scheduler::CanHoldBackScanRanges(non_mt_node));
+
+  TPlanNode partition_key_node = node;
+  partition_key_node.hdfs_scan_node.__set_is_partition_key_scan(true);
+  EXPECT_FALSE(Scheduler::CanHoldBackScanRanges(partition_key_node));
+
+  TPlanNode kudu_node;
+  kudu_node.node_type = TPlanNodeType::KUDU_SCAN_NODE;
+  EXPECT_FALSE(Scheduler::CanHoldBackScanRanges(kudu_node));
+}
+
+// Test that the smallest ranges are held back and that enough ranges remain assigned
+// for all instances of the host.
+TEST_F(SchedulerTest, TestHoldBackScanRanges) {
+  gflags::FlagSaver saver;
+  const int NUM_RANGES = 10;
+  const int MAX_NUM_INSTANCES = 4;
+  const TPlanNodeId NODE_ID = 3;
+  ObjectPool pool;
+  TQueryExecRequest request;
+  TQueryOptions query_options;
+  UniqueIdPB query_id;
+  ScheduleState state(query_id, request, query_options,
+      RuntimeProfile::Create(&pool, "test"), true);
+  NetworkAddressPB host;
+  host.set_hostname("host_1");
+  host.set_port(1000);
+  auto make_ranges = [this]() {
+    vector<ScanRangeParamsPB> ranges(NUM_RANGES);
+    for (int i = 0; i < NUM_RANGES; ++i) {
+      ranges[i].mutable_scan_range()->mutable_hdfs_file_split()->set_length(i + 1);
+    }
+    std::shuffle(ranges.begin(), ranges.end(), rng_);
+    return ranges;
+  };
+  auto lengths = [](const google::protobuf::RepeatedPtrField<ScanRangeParamsPB>& ranges) {
+    set<int64_t> result;
+    for (const ScanRangeParamsPB& range : ranges) {
+      result.insert(range.scan_range().hdfs_file_split().length());
+    }
+    return result;
+  };
+
+  FLAGS_scan_range_holdback_fraction = 0.5;
+  vector<ScanRangeParamsPB> ranges = make_ranges();
+  EXPECT_TRUE(Scheduler::HoldBackScanRanges(
+      MAX_NUM_INSTANCES, host, NODE_ID, &ranges, &state));
+  ASSERT_EQ(1, state.query_schedule_pb()->held_back_scan_ranges_size());
+  const HeldBackScanRangesPB& held_back =
+      state.query_schedule_pb()->held_back_scan_ranges(0);
+  EXPECT_EQ(NODE_ID, held_back.node_id());
+  EXPECT_EQ(host.hostname(), held_back.host().hostname());
+  EXPECT_EQ(host.port(), held_back.host().port());
+  EXPECT_EQ(set<int64_t>({1, 2, 3, 4, 5}), lengths(held_back.scan_ranges()));
+  ASSERT_EQ(5, ranges.size());
+  for (const ScanRangeParamsPB& range : ranges) {
+    EXPECT_GT(range.scan_range().hdfs_file_split().length(), 5);
+  }
+
+  // At least one range per instance stays assigned.
+  FLAGS_scan_range_holdback_fraction = 0.9;
+  ranges = make_ranges();
+  EXPECT_TRUE(Scheduler::HoldBackScanRanges(
+      MAX_NUM_INSTANCES, host, NODE_ID, &ranges, &state));
+  ASSERT_EQ(2, state.query_schedule_pb()->held_back_scan_ranges_size());
+  EXPECT_EQ(NUM_RANGES - MAX_NUM_INSTANCES,
+      state.query_schedule_pb()->held_back_scan_ranges(1).scan_ranges_size());
+  EXPECT_EQ(MAX_NUM_INSTANCES, ranges.size());
+
+  // Nothing is held back if there are not more ranges than instances.
+  ranges = make_ranges();
+  EXPECT_FALSE(
+      Scheduler::HoldBackScanRanges(NUM_RANGES, host, NODE_ID, &ranges, &state));
+  EXPECT_EQ(NUM_RANGES, ranges.size());
+  EXPECT_EQ(2, state.query_schedule_pb()->held_back_scan_ranges_size());
+}
+
+// Test that the assignment context weighs the bytes assigned to each executor by its
+// cost of scanning a byte according to the ExecutorScanModel.
+TEST_F(SchedulerTest, TestCostWeightedAssignment) {
+  const int NUM_RANGES = 8;
+  const int64_t RANGE_LENGTH = 1024L * 1024L;
+  const int64_t GB = 1024L * 1024L * 1024L;
+  const int64_t SECOND_NS = 1000L * 1000L * 1000L;
+  ExecutorGroup group("test-group");
+  group.AddExecutor(MakeBackendDescriptor(1, group));
+  group.AddExecutor(MakeBackendDescriptor(2, group));
+  const vector<IpAddr> ips = {HostIdxToIpAddr(1), HostIdxToIpAddr(2)};
+  // The first executor scans three times as fast as the second one, which gives them
+  // cost factors of 2/3 and 2.
+  ExecutorScanModel scan_model;
+  scan_model.Update(ips[0], 3 * GB, SECOND_NS);
+  scan_model.Update(ips[1], GB, SECOND_NS);
+
+  // Assigns NUM_RANGES remote ranges and returns the number of ranges per executor.
+  auto assign_ranges = [&](const ExecutorScanModel* model) {
+    Scheduler::AssignmentCtx ctx(group, nullptr, nullptr, &rng_, model);
+    FragmentScanRangeAssignment assignment;
+    map<IpAddr, int> num_ranges;
+    for (int i = 0; i < NUM_RANGES; ++i) {
+      TScanRangeLocationList scan_range_locations;
+      scan_range_locations.scan_range.__set_hdfs_file_split(THdfsFileSplit());
+      scan_range_locations.scan_range.hdfs_file_split.__set_length(RANGE_LENGTH);
+      const IpAddr* executor_ip = ctx.SelectExecutorFromCandidates(ips, RANGE_LENGTH,
+          /* break_ties_by_rank */ false);
+      ++num_ranges[*executor_ip];
+      BackendDescriptorPB executor;
+      ctx.SelectExecutorOnHost(*executor_ip, &executor);
+      ctx.RecordScanRangeAssignment(
+          executor, 0, {}, scan_range_locations, &assignment);
+    }
+    return num_ranges;
+  };
+
+  // Without a model the bytes are balanced.
+  map<IpAddr, int> num_ranges = assign_ranges(nullptr);
+  EXPECT_EQ(NUM_RANGES / 2, num_ranges[ips[0]]);
+  EXPECT_EQ(NUM_RANGES / 2, num_ranges[ips[1]]);
+
+  // With the model the predicted scan time is balanced, so the fast executor gets three
+  // times as many ranges.
+  num_ranges = assign_ranges(&scan_model);
+  EXPECT_EQ(6, num_ranges[ips[0]]);
+  EXPECT_EQ(2, num_ranges[ips[1]]);
+
+  // Executors without history are treated as equally fast.
+  scan_model.Clear();
+  num_ranges = assign_ranges(&scan_model);
+  EXPECT_EQ(NUM_RANGES / 2, num_ranges[ips[0]]);
+  EXPECT_EQ(NUM_RANGES / 2, num_ranges[ips[1]]);
+}
 } // end namespace impala
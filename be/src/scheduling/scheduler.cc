@@ -19,8 +19,11 @@
 
 #include <stdlib.h>
 #include <algorithm>
+#include <cmath>
 #include <limits>
+#include <numeric>
 #include <random>
+#include <set>
 #include <unordered_map>
 #include <vector>
 #include <boost/unordered_set.hpp>
@@ -35,6 +38,7 @@
 #include "gen-cpp/common.pb.h"
 #include "gen-cpp/statestore_service.pb.h"
 #include "scheduling/executor-group.h"
+#include "scheduling/executor-scan-model.h"
 #include "scheduling/hash-ring.h"
 #include "thirdparty/pcg-cpp-0.98/include/pcg_random.hpp"
 #include "util/compression-util.h"
@@ -55,10 +59,32 @@ using namespace apache::thrift;
 using namespace org::apache::impala::fb;
 using namespace strings;
 
+DEFINE_double(scan_range_holdback_fraction, 0, "(Advanced) Fraction of the scan ranges "
+    "of multi-threaded HDFS scans that the scheduler does not assign to any backend. The "
+    "coordinator hands them out while the query runs to backends that report spare scan "
+    "capacity, so that a slow backend does not bound the runtime of the scan. Only the "
+    "ranges beyond mt_dop per backend are held back. 0 disables this.");
+DEFINE_bool(scheduler_use_scan_throughput, false, "(Advanced) If true, the scheduler "
+    "balances the predicted scan time of executors instead of the number of bytes "
+    "assigned to them. The prediction is based on the scan throughput that each executor "
+    "achieved in past queries, which makes executors with faster hardware or hot data "
+    "caches receive more scan ranges.");
+DEFINE_double(remote_scheduling_load_bound_factor, 0, "(Advanced) If greater than 0, "
+    "remote reads of HDFS file splits are assigned by consistent hashing of the split "
+    "with bounded loads: a split goes to the executor that owns its position on the hash "
+    "ring unless that executor would exceed this factor times the average assigned work, "
+    "in which case it spills to the next executor in ring order. This keeps the data "
+    "cache affinity of remote reads under executor membership changes and skew. Values "
+    "below 1 are treated as 1. Takes precedence over num_remote_executor_candidates.");
+
 namespace impala {
 
 static const string LOCAL_ASSIGNMENTS_KEY("simple-scheduler.local-assignments.total");
 static const string ASSIGNMENTS_KEY("simple-scheduler.assignments.total");
+static const string REMOTE_HASH_ASSIGNMENTS_KEY(
+    "simple-scheduler.remote-hash-assignments.total");
+static const string REMOTE_HASH_AFFINITY_ASSIGNMENTS_KEY(
+    "simple-scheduler.remote-hash-assignments.affinity");
 static const string SCHEDULER_INIT_KEY("simple-scheduler.initialized");
 
 static const vector<TPlanNodeType::type> SCAN_NODE_TYPES{TPlanNodeType::HDFS_SCAN_NODE,
@@ -82,6 +108,9 @@ Scheduler::Scheduler(MetricGroup* metrics, RequestPoolService* request_pool_serv
   if (metrics_ != nullptr) {
     total_assignments_ = metrics_->AddCounter(ASSIGNMENTS_KEY, 0);
     total_local_assignments_ = metrics_->AddCounter(LOCAL_ASSIGNMENTS_KEY, 0);
+    total_remote_hash_assignments_ = metrics_->AddCounter(REMOTE_HASH_ASSIGNMENTS_KEY, 0);
+    total_remote_hash_affinity_assignments_ =
+        metrics_->AddCounter(REMOTE_HASH_AFFINITY_ASSIGNMENTS_KEY, 0);
     initialized_ = metrics_->AddProperty(SCHEDULER_INIT_KEY, true);
   }
 }
@@ -422,6 +451,8 @@ void Scheduler::CreateCollocatedAndScanInstances(const ExecutorConfig& executor_
   // Number of instances should be bounded by mt_dop.
   int max_num_instances =
       max(1, state->request().query_ctx.client_request.query_options.mt_dop);
+  // Scan nodes for which some ranges were held back on any host.
+  set<TPlanNodeId> dynamic_scan_node_ids;
   // Track the index of the next instance to be created for this fragment.
   int per_fragment_instance_idx = 0;
   for (const auto& entry : instances_per_host) {
@@ -440,6 +471,12 @@ void Scheduler::CreateCollocatedAndScanInstances(const ExecutorConfig& executor_
       if (assignment_it == sra.end()) continue;
       auto scan_ranges_it = assignment_it->second.find(scan_node_id);
       if (scan_ranges_it == assignment_it->second.end()) continue;
+      if (FLAGS_scan_range_holdback_fraction > 0
+          && CanHoldBackScanRanges(state->GetNode(scan_node_id))
+          && HoldBackScanRanges(max_num_instances, host, scan_node_id,
+              &scan_ranges_it->second, state)) {
+        dynamic_scan_node_ids.insert(scan_node_id);
+      }
       per_scan_per_instance_ranges.back() =
           AssignRangesToInstances(max_num_instances, scan_ranges_it->second);
       DCHECK_LE(per_scan_per_instance_ranges.back().size(), max_num_instances);
@@ -478,6 +515,13 @@ void Scheduler::CreateCollocatedAndScanInstances(const ExecutorConfig& executor_
       }
     }
   }
+  // Every instance of the fragment may be handed held back ranges, so all of them need
+  // to wait for the coordinator before they finish the scan.
+  for (TPlanNodeId scan_node_id : dynamic_scan_node_ids) {
+    for (FInstanceScheduleState& instance_state : fragment_state->instance_states) {
+      instance_state.exec_params.add_dynamic_scan_range_nodes(scan_node_id);
+    }
+  }
   if (fragment.output_sink.__isset.table_sink
       && fragment.output_sink.table_sink.__isset.hdfs_table_sink
       && state->query_options().max_fs_writers > 0
@@ -507,6 +551,62 @@ vector<vector<ScanRangeParamsPB>> Scheduler::AssignRangesToInstances(
   return per_instance_ranges;
 }
 
+bool Scheduler::CanHoldBackScanRanges(const TPlanNode& node) {
+  if (node.node_type != TPlanNodeType::HDFS_SCAN_NODE) return false;
+  const THdfsScanNode& hdfs_scan_node = node.hdfs_scan_node;
+  if (!hdfs_scan_node.use_mt_scan_node) return false;
+  if (hdfs_scan_node.__isset.is_partition_key_scan
+      && hdfs_scan_node.is_partition_key_scan) {
+    return false;
+  }
+  // Scanners of sequence-based formats issue the splits of a file after reading its
+  // header, so all splits of a file must be known when the scan starts.
+  for (THdfsFileFormat::type format : hdfs_scan_node.file_formats) {
+    if (format != THdfsFileFormat::PARQUET && format != THdfsFileFormat::ORC
+        && format != THdfsFileFormat::TEXT && format != THdfsFileFormat::JSON) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Scheduler::HoldBackScanRanges(int max_num_instances, const NetworkAddressPB& host,
+    TPlanNodeId node_id, vector<ScanRangeParamsPB>* ranges, ScheduleState* state) {
+  int num_ranges = ranges->size();
+  int num_held_back = min(
+      static_cast<int>(num_ranges * FLAGS_scan_range_holdback_fraction),
+      num_ranges - max_num_instances);
+  if (num_held_back <= 0) return false;
+  // Hold back the smallest ranges. They are the best fit to fill the gaps of backends
+  // that run out of work early.
+  auto range_length = [ranges](int idx) {
+    return (*ranges)[idx].scan_range().hdfs_file_split().length();
+  };
+  vector<int> range_idxs(num_ranges);
+  std::iota(range_idxs.begin(), range_idxs.end(), 0);
+  std::nth_element(range_idxs.begin(), range_idxs.begin() + num_held_back,
+      range_idxs.end(),
+      [&range_length](int a, int b) { return range_length(a) < range_length(b); });
+  vector<bool> held_back(num_ranges, false);
+  for (int i = 0; i < num_held_back; ++i) held_back[range_idxs[i]] = true;
+
+  HeldBackScanRangesPB* held_back_pb =
+      state->query_schedule_pb()->add_held_back_scan_ranges();
+  held_back_pb->set_node_id(node_id);
+  *held_back_pb->mutable_host() = host;
+  vector<ScanRangeParamsPB> assigned_ranges;
+  assigned_ranges.reserve(num_ranges - num_held_back);
+  for (int i = 0; i < num_ranges; ++i) {
+    if (held_back[i]) {
+      *held_back_pb->add_scan_ranges() = move((*ranges)[i]);
+    } else {
+      assigned_ranges.push_back(move((*ranges)[i]));
+    }
+  }
+  ranges->swap(assigned_ranges);
+  return true;
+}
+
 void Scheduler::CreateInputCollocatedInstances(
     FragmentScheduleState* fragment_state, ScheduleState* state) {
   DCHECK_GE(fragment_state->exchange_input_fragments.size(), 1);
@@ -514,7 +614,6 @@ void Scheduler::CreateInputCollocatedInstances(
   const FragmentScheduleState& input_fragment_state =
       *state->GetFragmentScheduleState(fragment_state->exchange_input_fragments[0]);
   int per_fragment_instance_idx = 0;
-
   if (fragment.output_sink.__isset.table_sink
       && fragment.output_sink.table_sink.__isset.hdfs_table_sink
       && state->query_options().max_fs_writers > 0
@@ -627,7 +726,8 @@ Status Scheduler::ComputeScanRangeAssignment(const ExecutorConfig& executor_conf
   coord_only_executor_group.AddExecutor(coord_desc);
   VLOG_ROW << "Exec at coord is " << (exec_at_coord ? "true" : "false");
   AssignmentCtx assignment_ctx(exec_at_coord ? coord_only_executor_group : executor_group,
-      total_assignments_, total_local_assignments_, rng);
+      total_assignments_, total_local_assignments_, rng,
+      FLAGS_scheduler_use_scan_throughput ? ExecutorScanModel::GetInstance() : nullptr);
 
   // Holds scan ranges that must be assigned for remote reads.
   vector<const TScanRangeLocationList*> remote_scan_range_locations;
@@ -701,8 +801,8 @@ Status Scheduler::ComputeScanRangeAssignment(const ExecutorConfig& executor_conf
       // Remote reads will always break ties by executor rank.
       bool decide_local_assignment_by_rank = random_replica || cached_replica;
       const IpAddr* executor_ip = nullptr;
-      executor_ip = assignment_ctx.SelectExecutorFromCandidates(
-          executor_candidates, decide_local_assignment_by_rank);
+      executor_ip = assignment_ctx.SelectExecutorFromCandidates(executor_candidates,
+          GetScanRangeLength(scan_range_locations), decide_local_assignment_by_rank);
       BackendDescriptorPB executor;
       assignment_ctx.SelectExecutorOnHost(*executor_ip, &executor);
       assignment_ctx.RecordScanRangeAssignment(
@@ -713,27 +813,43 @@ Status Scheduler::ComputeScanRangeAssignment(const ExecutorConfig& executor_conf
   // Assign remote scans to executors.
   int num_remote_executor_candidates =
       min(query_options.num_remote_executor_candidates, executor_group.NumExecutors());
+  double load_bound_factor = FLAGS_remote_scheduling_load_bound_factor > 0 ?
+      max(1.0, FLAGS_remote_scheduling_load_bound_factor) : 0;
   for (const TScanRangeLocationList* scan_range_locations : remote_scan_range_locations) {
     DCHECK(!exec_at_coord);
     const IpAddr* executor_ip;
     vector<IpAddr> remote_executor_candidates;
-    // Limit the number of remote executor candidates:
-    // 1. When enabled by setting 'num_remote_executor_candidates' > 0
-    // AND
-    // 2. This is an HDFS file split
+    bool is_hdfs_file_split = scan_range_locations->scan_range.__isset.hdfs_file_split;
+    // Whether the range went to the executor that owns its position on the hash ring.
+    bool on_hash_owner = false;
+    // For HDFS file splits, assign remote reads by consistent hashing:
+    // 1. When enabled by setting 'remote_scheduling_load_bound_factor' > 0, the split
+    //    goes to its owner on the hash ring unless the owner is overloaded.
+    // 2. When enabled by setting 'num_remote_executor_candidates' > 0, the split goes
+    //    to the least loaded of a limited number of candidates.
     // Otherwise, fall back to the normal method of selecting executors for remote
     // ranges, which allows for execution on any backend.
-    if (scan_range_locations->scan_range.__isset.hdfs_file_split &&
-        num_remote_executor_candidates > 0) {
+    if (is_hdfs_file_split && load_bound_factor > 0) {
+      executor_ip = assignment_ctx.SelectRemoteExecutorWithBoundedLoad(
+          &scan_range_locations->scan_range.hdfs_file_split,
+          GetScanRangeLength(*scan_range_locations), load_bound_factor, &on_hash_owner);
+    } else if (is_hdfs_file_split && num_remote_executor_candidates > 0) {
       assignment_ctx.GetRemoteExecutorCandidates(
           &scan_range_locations->scan_range.hdfs_file_split,
           num_remote_executor_candidates, &remote_executor_candidates);
       // Like the local case, schedule_random_replica determines how to break ties.
       executor_ip = assignment_ctx.SelectExecutorFromCandidates(
-          remote_executor_candidates, random_replica);
+          remote_executor_candidates, GetScanRangeLength(*scan_range_locations),
+          random_replica);
+      on_hash_owner = *executor_ip == remote_executor_candidates[0];
     } else {
       executor_ip = assignment_ctx.SelectRemoteExecutor();
     }
+    if (total_remote_hash_assignments_ != nullptr && is_hdfs_file_split
+        && (load_bound_factor > 0 || num_remote_executor_candidates > 0)) {
+      total_remote_hash_assignments_->Increment(1);
+      if (on_hash_owner) total_remote_hash_affinity_assignments_->Increment(1);
+    }
     BackendDescriptorPB executor;
     assignment_ctx.SelectExecutorOnHost(*executor_ip, &executor);
     assignment_ctx.RecordScanRangeAssignment(
@@ -931,7 +1047,8 @@ void Scheduler::ComputeBackendExecParams(
 }
 
 Scheduler::AssignmentCtx::AssignmentCtx(const ExecutorGroup& executor_group,
-    IntCounter* total_assignments, IntCounter* total_local_assignments, std::mt19937* rng)
+    IntCounter* total_assignments, IntCounter* total_local_assignments, std::mt19937* rng,
+    const ExecutorScanModel* scan_model)
   : executor_group_(executor_group),
     first_unused_executor_idx_(0),
     total_assignments_(total_assignments),
@@ -942,27 +1059,39 @@ Scheduler::AssignmentCtx::AssignmentCtx(const ExecutorGroup& executor_group,
   // Initialize inverted map for executor rank lookups
   int i = 0;
   for (const IpAddr& ip : random_executor_order_) random_executor_rank_[ip] = i++;
+  if (scan_model != nullptr && random_executor_order_.size() > 1) {
+    scan_model->GetCostFactors(random_executor_order_, &executor_cost_factors_);
+  }
+}
+
+int64_t Scheduler::AssignmentCtx::GetAssignmentCost(
+    const IpAddr& ip, int64_t scan_range_length) const {
+  auto it = executor_cost_factors_.find(ip);
+  if (it == executor_cost_factors_.end()) return scan_range_length;
+  return static_cast<int64_t>(scan_range_length * it->second);
 }
 
 const IpAddr* Scheduler::AssignmentCtx::SelectExecutorFromCandidates(
-    const std::vector<IpAddr>& data_locations, bool break_ties_by_rank) {
+    const std::vector<IpAddr>& data_locations, int64_t scan_range_length,
+    bool break_ties_by_rank) {
   DCHECK(!data_locations.empty());
   // List of candidate indexes into 'data_locations'.
   vector<int> candidates_idxs;
-  // Find locations with minimum number of assigned bytes.
-  int64_t min_assigned_bytes = numeric_limits<int64_t>::max();
+  // Find locations with the minimum assigned cost after adding the scan range. With
+  // equally fast executors this is the location with the fewest assigned bytes.
+  int64_t min_assigned_cost = numeric_limits<int64_t>::max();
   for (int i = 0; i < data_locations.size(); ++i) {
     const IpAddr& executor_ip = data_locations[i];
-    int64_t assigned_bytes = 0;
+    int64_t assigned_cost = GetAssignmentCost(executor_ip, scan_range_length);
     auto handle_it = assignment_heap_.find(executor_ip);
     if (handle_it != assignment_heap_.end()) {
-      assigned_bytes = (*handle_it->second).assigned_bytes;
+      assigned_cost += (*handle_it->second).assigned_cost;
     }
-    if (assigned_bytes < min_assigned_bytes) {
+    if (assigned_cost < min_assigned_cost) {
       candidates_idxs.clear();
-      min_assigned_bytes = assigned_bytes;
+      min_assigned_cost = assigned_cost;
     }
-    if (assigned_bytes == min_assigned_bytes) candidates_idxs.push_back(i);
+    if (assigned_cost == min_assigned_cost) candidates_idxs.push_back(i);
   }
 
   DCHECK(!candidates_idxs.empty());
@@ -990,14 +1119,7 @@ void Scheduler::AssignmentCtx::GetRemoteExecutorCandidates(
   unordered_set<IpAddr> distinct_backends;
   distinct_backends.reserve(num_candidates);
   // Generate multiple hashes of the file split by using the hash as a seed to a PRNG.
-  // Note: The hash includes the partition path hash, the filename (relative to the
-  // partition directory), and the offset. The offset is used to allow very large files
-  // that have multiple splits to be spread across more executors.
-  uint32_t hash = static_cast<uint32_t>(hdfs_file_split->partition_path_hash);
-  hash = HashUtil::Hash(hdfs_file_split->relative_path.data(),
-      hdfs_file_split->relative_path.length(), hash);
-  hash = HashUtil::Hash(&hdfs_file_split->offset, sizeof(hdfs_file_split->offset), hash);
-  pcg32 prng(hash);
+  pcg32 prng(GetFileSplitHash(hdfs_file_split));
   // The function should return distinct executors, so it may need to do more hashes
   // than 'num_candidates'. To avoid any problem scenarios, limit the total number of
   // iterations. The number of iterations is set to a reasonably high level, because
@@ -1037,6 +1159,45 @@ void Scheduler::AssignmentCtx::GetRemoteExecutorCandidates(
   }
 }
 
+uint32_t Scheduler::AssignmentCtx::GetFileSplitHash(
+    const THdfsFileSplit* hdfs_file_split) {
+  // The hash includes the partition path hash, the filename (relative to the partition
+  // directory), and the offset. The offset is used to allow very large files that have
+  // multiple splits to be spread across more executors.
+  uint32_t hash = static_cast<uint32_t>(hdfs_file_split->partition_path_hash);
+  hash = HashUtil::Hash(hdfs_file_split->relative_path.data(),
+      hdfs_file_split->relative_path.length(), hash);
+  hash = HashUtil::Hash(&hdfs_file_split->offset, sizeof(hdfs_file_split->offset), hash);
+  return hash;
+}
+
+const IpAddr* Scheduler::AssignmentCtx::SelectRemoteExecutorWithBoundedLoad(
+    const THdfsFileSplit* hdfs_file_split, int64_t scan_range_length,
+    double load_bound_factor, bool* on_hash_owner) {
+  DCHECK_GE(load_bound_factor, 1);
+  // Use the first hash of GetRemoteExecutorCandidates() as the ring position, so that
+  // the owner is the same as the first remote executor candidate.
+  pcg32 prng(GetFileSplitHash(hdfs_file_split));
+  uint32_t ring_position = prng();
+  int64_t load_bound = static_cast<int64_t>(ceil(load_bound_factor
+      * (total_assigned_cost_ + scan_range_length) / executor_group_.NumHosts()));
+  // Executors without assigned work are never overloaded, so that a single large range
+  // does not make all executors appear overloaded.
+  auto is_overloaded = [this, scan_range_length, load_bound](const IpAddr& ip) {
+    auto handle_it = assignment_heap_.find(ip);
+    if (handle_it == assignment_heap_.end()) return false;
+    int64_t assigned_cost = (*handle_it->second).assigned_cost;
+    return assigned_cost > 0
+        && assigned_cost + GetAssignmentCost(ip, scan_range_length) > load_bound;
+  };
+  int num_skipped = 0;
+  const IpAddr* executor_ip = executor_group_.GetHashRing()->GetNodeWithBoundedLoad(
+      ring_position, is_overloaded, &num_skipped);
+  DCHECK(executor_ip != nullptr);
+  *on_hash_owner = num_skipped == 0;
+  return executor_ip;
+}
+
 const IpAddr* Scheduler::AssignmentCtx::SelectRemoteExecutor() {
   const IpAddr* candidate_ip;
   if (HasUnusedExecutors()) {
@@ -1122,27 +1283,34 @@ void TScanRangeToScanRangePB(const TScanRange& tscan_range, ScanRangePB* scan_ra
   }
 }
 
-void Scheduler::AssignmentCtx::RecordScanRangeAssignment(
-    const BackendDescriptorPB& executor, PlanNodeId node_id,
-    const vector<TNetworkAddress>& host_list,
-    const TScanRangeLocationList& scan_range_locations,
-    FragmentScanRangeAssignment* assignment) {
-  int64_t scan_range_length = 0;
+int64_t Scheduler::GetScanRangeLength(
+    const TScanRangeLocationList& scan_range_locations) {
   if (scan_range_locations.scan_range.__isset.hdfs_file_split) {
-    scan_range_length = scan_range_locations.scan_range.hdfs_file_split.length;
+    return scan_range_locations.scan_range.hdfs_file_split.length;
   } else if (scan_range_locations.scan_range.__isset.kudu_scan_token) {
     // Hack so that kudu ranges are well distributed.
     // TODO: KUDU-1133 Use the tablet size instead.
-    scan_range_length = 1000;
+    return 1000;
   }
+  return 0;
+}
+
+void Scheduler::AssignmentCtx::RecordScanRangeAssignment(
+    const BackendDescriptorPB& executor, PlanNodeId node_id,
+    const vector<TNetworkAddress>& host_list,
+    const TScanRangeLocationList& scan_range_locations,
+    FragmentScanRangeAssignment* assignment) {
+  int64_t scan_range_length = GetScanRangeLength(scan_range_locations);
 
   IpAddr executor_ip;
   bool ret =
       executor_group_.LookUpExecutorIp(executor.address().hostname(), &executor_ip);
   DCHECK(ret);
   DCHECK(!executor_ip.empty());
+  int64_t assignment_cost = GetAssignmentCost(executor_ip, scan_range_length);
   assignment_heap_.InsertOrUpdate(
-      executor_ip, scan_range_length, GetExecutorRank(executor_ip));
+      executor_ip, assignment_cost, GetExecutorRank(executor_ip));
+  total_assigned_cost_ += assignment_cost;
 
   // See if the read will be remote. This is not the case if the impalad runs on one of
   // the replica's datanodes.
@@ -1217,16 +1385,16 @@ void Scheduler::AssignmentCtx::PrintAssignment(
 }
 
 void Scheduler::AddressableAssignmentHeap::InsertOrUpdate(
-    const IpAddr& ip, int64_t assigned_bytes, int rank) {
+    const IpAddr& ip, int64_t assigned_cost, int rank) {
   auto handle_it = executor_handles_.find(ip);
   if (handle_it == executor_handles_.end()) {
-    AssignmentHeap::handle_type handle = executor_heap_.push({assigned_bytes, rank, ip});
+    AssignmentHeap::handle_type handle = executor_heap_.push({assigned_cost, rank, ip});
     executor_handles_.emplace(ip, handle);
   } else {
     // We need to rebuild the heap after every update operation. Calling decrease once is
     // sufficient as both assignments decrease the key.
     AssignmentHeap::handle_type handle = handle_it->second;
-    (*handle).assigned_bytes += assigned_bytes;
+    (*handle).assigned_cost += assigned_cost;
     executor_heap_.decrease(handle);
   }
 }
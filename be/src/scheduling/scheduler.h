@@ -37,6 +37,7 @@
 namespace impala {
 
 class BackendDescriptorPB;
+class ExecutorScanModel;
 class MetricGroup;
 class RequestPoolService;
 class TPlanExecInfo;
@@ -86,8 +87,10 @@ class Scheduler {
   /// Internal structure to track scan range assignments for an executor host. This struct
   /// is used as the heap element in and maintained by AddressableAssignmentHeap.
   struct ExecutorAssignmentInfo {
-    /// The number of bytes assigned to an executor.
-    int64_t assigned_bytes;
+    /// The number of bytes assigned to an executor, each weighted by the executor's
+    /// relative cost of scanning a byte (see ExecutorScanModel). This is proportional to
+    /// the predicted time the executor needs to scan its assigned ranges.
+    int64_t assigned_cost;
 
     /// Each host gets assigned a random rank to break ties in a random but deterministic
     /// order per plan node.
@@ -96,10 +99,10 @@ class Scheduler {
     /// IP address of the executor.
     IpAddr ip;
 
-    /// Compare two elements of this struct. The key is (assigned_bytes, random_rank).
+    /// Compare two elements of this struct. The key is (assigned_cost, random_rank).
     bool operator>(const ExecutorAssignmentInfo& rhs) const {
-      if (assigned_bytes != rhs.assigned_bytes) {
-        return assigned_bytes > rhs.assigned_bytes;
+      if (assigned_cost != rhs.assigned_cost) {
+        return assigned_cost > rhs.assigned_cost;
       }
       return random_rank > rhs.random_rank;
     }
@@ -108,8 +111,8 @@ class Scheduler {
   /// Heap to compute candidates for scan range assignments. Elements are of type
   /// ExecutorAssignmentInfo and track assignment information for each executor. By
   /// default boost implements a max-heap so we use std::greater<T> to obtain a min-heap.
-  /// This will make the top() element of the heap be the executor with the lowest number
-  /// of assigned bytes and the lowest random rank.
+  /// This will make the top() element of the heap be the executor with the lowest
+  /// assigned cost and the lowest random rank.
   typedef boost::heap::binomial_heap<ExecutorAssignmentInfo,
       boost::heap::compare<std::greater<ExecutorAssignmentInfo>>>
       AssignmentHeap;
@@ -126,7 +129,7 @@ class Scheduler {
     const AssignmentHeap& executor_heap() const { return executor_heap_; }
     const ExecutorHandleMap& executor_handles() const { return executor_handles_; }
 
-    void InsertOrUpdate(const IpAddr& ip, int64_t assigned_bytes, int rank);
+    void InsertOrUpdate(const IpAddr& ip, int64_t assigned_cost, int rank);
 
     // Forward interface for boost::heap
     decltype(auto) size() const { return executor_heap_.size(); }
@@ -146,21 +149,24 @@ class Scheduler {
   /// Class to store context information on assignments during scheduling. It is
   /// initialized with a copy of the executor group and assigns a random rank to each
   /// executor to break ties in cases where multiple executors have been assigned the same
-  /// number or bytes. It tracks the number of assigned bytes, which executors have
-  /// already been used, etc. Objects of this class are created in
+  /// amount of work. It tracks the assigned cost, which executors have already been
+  /// used, etc. If 'scan_model' is not null, the bytes assigned to an executor are
+  /// weighted by its relative cost of scanning a byte according to the model, otherwise
+  /// all executors are considered equally fast. Objects of this class are created in
   /// ComputeScanRangeAssignment() and thus don't need to be thread safe.
   class AssignmentCtx {
    public:
     AssignmentCtx(const ExecutorGroup& executor_group, IntCounter* total_assignments,
-        IntCounter* total_local_assignments, std::mt19937* rng);
+        IntCounter* total_local_assignments, std::mt19937* rng,
+        const ExecutorScanModel* scan_model = nullptr);
 
-    /// Among hosts in 'data_locations', select the one with the minimum number of
-    /// assigned bytes. If executors have been assigned equal amounts of work and
-    /// 'break_ties_by_rank' is true, then the executor rank is used to break ties.
-    /// Otherwise the first executor according to their order in 'data_locations' is
-    /// selected.
-    const IpAddr* SelectExecutorFromCandidates(
-        const std::vector<IpAddr>& data_locations, bool break_ties_by_rank);
+    /// Among hosts in 'data_locations', select the one with the minimum assigned cost
+    /// after assigning a scan range of 'scan_range_length' bytes to it, i.e. the one
+    /// predicted to finish first. If executors are tied and 'break_ties_by_rank' is
+    /// true, then the executor rank is used to break ties. Otherwise the first executor
+    /// according to their order in 'data_locations' is selected.
+    const IpAddr* SelectExecutorFromCandidates(const std::vector<IpAddr>& data_locations,
+        int64_t scan_range_length, bool break_ties_by_rank);
 
     /// Populate 'remote_executor_candidates' with 'num_candidates' distinct
     /// executors. The algorithm for picking remote executor candidates is to hash
@@ -172,10 +178,22 @@ class Scheduler {
     void GetRemoteExecutorCandidates(const THdfsFileSplit* hdfs_file_split,
         int num_remote_replicas, vector<IpAddr>* remote_executor_candidates);
 
+    /// Select an executor for a remote read of 'hdfs_file_split' by consistent hashing
+    /// with bounded loads. The split goes to the executor that owns its position on the
+    /// ExecutorGroup's HashRing, which is the same executor as the first candidate of
+    /// GetRemoteExecutorCandidates(). If the owner would exceed 'load_bound_factor' times
+    /// the average assigned cost after taking the range, the next executor in ring
+    /// order that would not is picked. Adding or removing executors only moves the
+    /// splits owned by them, so the executors' data caches stay warm. Sets
+    /// 'on_hash_owner' to whether the owner was picked.
+    const IpAddr* SelectRemoteExecutorWithBoundedLoad(
+        const THdfsFileSplit* hdfs_file_split, int64_t scan_range_length,
+        double load_bound_factor, bool* on_hash_owner);
+
     /// Select an executor for a remote read. If there are unused executor hosts, then
-    /// those will be preferred. Otherwise the one with the lowest number of assigned
-    /// bytes is picked. If executors have been assigned equal amounts of work, then the
-    /// executor rank is used to break ties.
+    /// those will be preferred. Otherwise the one with the lowest assigned cost is
+    /// picked. If executors have been assigned equal amounts of work, then the executor
+    /// rank is used to break ties.
     const IpAddr* SelectRemoteExecutor();
 
     /// Return the next executor that has not been assigned to. This assumes that a
@@ -213,7 +231,7 @@ class Scheduler {
     const ExecutorGroup& executor_group_;
 
     // Addressable heap to select remote executors from. Elements are ordered by the
-    // number of already assigned bytes (and a random rank to break ties).
+    // already assigned cost (and a random rank to break ties).
     AddressableAssignmentHeap assignment_heap_;
 
     /// Store a random rank per executor host to break ties between otherwise equivalent
@@ -238,13 +256,32 @@ class Scheduler {
     IntCounter* total_assignments_;
     IntCounter* total_local_assignments_;
 
+    /// Sum of the assigned cost of all executors.
+    int64_t total_assigned_cost_ = 0;
+
+    /// Returns the hash of the partition, file name and offset of 'hdfs_file_split' that
+    /// determines its positions on the HashRing.
+    static uint32_t GetFileSplitHash(const THdfsFileSplit* hdfs_file_split);
+
     /// Return whether there are executors that have not been assigned a scan range.
     bool HasUnusedExecutors() const;
 
     /// Return the rank of an executor.
     int GetExecutorRank(const IpAddr& ip) const;
+
+    /// Return the cost of scanning 'scan_range_length' bytes on executor 'ip'.
+    int64_t GetAssignmentCost(const IpAddr& ip, int64_t scan_range_length) const;
+
+    /// Relative cost of scanning a byte per executor host, taken from the
+    /// ExecutorScanModel when the context is created. Empty if all executors are
+    /// considered equally fast.
+    boost::unordered_map<IpAddr, double> executor_cost_factors_;
   };
 
+  /// Returns the number of bytes of the scan range in 'scan_range_locations', which is
+  /// used to balance the assignment.
+  static int64_t GetScanRangeLength(const TScanRangeLocationList& scan_range_locations);
+
   /// Total number of scan ranges assigned to executors during the lifetime of the
   /// scheduler.
   int64_t num_assignments_;
@@ -256,6 +293,11 @@ class Scheduler {
   IntCounter* total_assignments_ = nullptr;
   IntCounter* total_local_assignments_ = nullptr;
 
+  /// Number of remote reads of HDFS file splits assigned by consistent hashing, and the
+  /// number of those that went to the owner of the split on the hash ring.
+  IntCounter* total_remote_hash_assignments_ = nullptr;
+  IntCounter* total_remote_hash_affinity_assignments_ = nullptr;
+
   /// Initialization metric
   BooleanProperty* initialized_ = nullptr;
 
@@ -396,6 +438,19 @@ class Scheduler {
   static std::vector<std::vector<ScanRangeParamsPB>> AssignRangesToInstances(
       int max_num_instances, std::vector<ScanRangeParamsPB>& ranges);
 
+  /// Returns true if the coordinator can hand out the scan ranges of 'node' while the
+  /// query runs, i.e. if it is a multi-threaded HDFS scan of formats whose scanners
+  /// issue each split independently.
+  static bool CanHoldBackScanRanges(const TPlanNode& node);
+
+  /// Moves the smallest of the scan ranges 'ranges' of scan node 'node_id' that were
+  /// assigned to 'host' to QuerySchedulePB.held_back_scan_ranges of 'state', as many as
+  /// --scan_range_holdback_fraction allows while leaving at least 'max_num_instances'
+  /// ranges assigned, so that the number of instances on 'host' does not shrink.
+  /// Returns true if any range was held back.
+  static bool HoldBackScanRanges(int max_num_instances, const NetworkAddressPB& host,
+      TPlanNodeId node_id, std::vector<ScanRangeParamsPB>* ranges, ScheduleState* state);
+
   /// For each instance of fragment_state's input fragment, create a collocated
   /// instance for fragment_state's fragment.
   /// Also enforces an upper limit on the number of instances in case this fragment_state
@@ -442,6 +497,9 @@ class Scheduler {
   FRIEND_TEST(SimpleAssignmentTest, ComputeAssignmentRandomDiskLocal);
   FRIEND_TEST(SimpleAssignmentTest, ComputeAssignmentRandomRemote);
   FRIEND_TEST(SchedulerTest, TestMultipleFinstances);
+  FRIEND_TEST(SchedulerTest, TestCanHoldBackScanRanges);
+  FRIEND_TEST(SchedulerTest, TestHoldBackScanRanges);
+  FRIEND_TEST(SchedulerTest, TestCostWeightedAssignment);
 };
 
 }
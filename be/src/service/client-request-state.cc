@@ -1535,9 +1535,9 @@ beeswax::QueryState::type ClientRequestState::BeeswaxQueryState() const {
 // 'coord_exec_called_' for more details.
 Status ClientRequestState::UpdateBackendExecStatus(
     const ReportExecStatusRequestPB& request,
-    const TRuntimeProfileForest& thrift_profiles) {
+    const TRuntimeProfileForest& thrift_profiles, ReportExecStatusResponsePB* response) {
   DCHECK(coord_.get());
-  return coord_->UpdateBackendExecStatus(request, thrift_profiles);
+  return coord_->UpdateBackendExecStatus(request, thrift_profiles, response);
 }
 
 void ClientRequestState::UpdateFilter(
@@ -40,6 +40,7 @@ class Coordinator;
 class Expr;
 class Frontend;
 class ReportExecStatusRequestPB;
+class ReportExecStatusResponsePB;
 class RowBatch;
 class RuntimeState;
 class Thread;
@@ -205,7 +206,8 @@ class ClientRequestState {
   /// methods should be used instead of calling them directly using the coordinator
   /// object.
   Status UpdateBackendExecStatus(const ReportExecStatusRequestPB& request,
-      const TRuntimeProfileForest& thrift_profiles) WARN_UNUSED_RESULT;
+      const TRuntimeProfileForest& thrift_profiles,
+      ReportExecStatusResponsePB* response) WARN_UNUSED_RESULT;
   void UpdateFilter(const UpdateFilterParamsPB& params, kudu::rpc::RpcContext* context);
 
   /// Populate DML stats in 'dml_result' if this request succeeded.
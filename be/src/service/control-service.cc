@@ -196,10 +196,12 @@ void ControlService::ReportExecStatus(const ReportExecStatusRequestPB* request,
       // Do not expose a partially deserialized profile.
       TRuntimeProfileForest empty_profiles;
       swap(thrift_profiles, empty_profiles);
+      response->set_profiles_dropped(true);
     }
   }
 
-  Status resp_status = query_handle->UpdateBackendExecStatus(*request, thrift_profiles);
+  Status resp_status =
+      query_handle->UpdateBackendExecStatus(*request, thrift_profiles, response);
   RespondAndReleaseRpc(resp_status, response, rpc_context);
 }
 
@@ -31,6 +31,7 @@
 #include "runtime/mem-tracker.h"
 #include "runtime/query-state.h"
 #include "runtime/row-batch.h"
+#include "runtime/runtime-filter-bank.h"
 #include "service/impala-server.h"
 #include "util/memory-metrics.h"
 #include "util/parse-util.h"
@@ -134,6 +135,9 @@ void DataStreamService::PublishFilter(
     qs->PublishFilter(*req, context);
     RespondAndReleaseRpc(Status::OK(), resp, context, mem_tracker_.get());
   } else {
+    // The query may have finished on this backend while backends below it in the
+    // fan-out tree still need the filter.
+    RuntimeFilterBank::ForwardFilter(*req, context);
     string err_msg = Substitute("Query State not found for query_id=$0",
         PrintId(ProtoToQueryId(req->dst_query_id())));
     LOG(INFO) << err_msg;
@@ -141,6 +145,27 @@ void DataStreamService::PublishFilter(
   }
 }
 
+void DataStreamService::UpdateFilterFromRemote(
+    const UpdateFilterParamsPB* req, UpdateFilterResultPB* resp, RpcContext* context) {
+  // This failpoint is to allow jitter to be injected.
+  DebugActionNoFail(FLAGS_debug_actions, "UPDATE_FILTER_FROM_REMOTE_DELAY");
+  DCHECK(req->has_filter_id());
+  DCHECK(req->has_query_id());
+  DCHECK(req->has_bloom_filter() || req->has_min_max_filter());
+  QueryState::ScopedRef qs(ProtoToQueryId(req->query_id()));
+
+  if (qs.get() != nullptr) {
+    // The sender sends the update to the coordinator instead if it was not merged.
+    Status status = qs->UpdateFilterFromRemote(*req, context);
+    RespondAndReleaseRpc(status, resp, context, mem_tracker_.get());
+  } else {
+    string err_msg = Substitute("Query State not found for query_id=$0",
+        PrintId(ProtoToQueryId(req->query_id())));
+    LOG(INFO) << err_msg;
+    RespondAndReleaseRpc(Status(err_msg), resp, context, mem_tracker_.get());
+  }
+}
+
 template<typename ResponsePBType>
 void DataStreamService::RespondRpc(const Status& status,
     ResponsePBType* response, kudu::rpc::RpcContext* ctx) {
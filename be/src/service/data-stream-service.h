@@ -69,10 +69,16 @@ class DataStreamService : public DataStreamServiceIf {
       kudu::rpc::RpcContext* context);
 
   /// Called by the coordinator to deliver global runtime filters to fragments for
-  /// application at plan nodes.
+  /// application at plan nodes. Also called by other backends to forward filters that
+  /// are published through a fan-out tree.
   virtual void PublishFilter(const PublishFilterParamsPB* req,
       PublishFilterResultPB* resp, kudu::rpc::RpcContext* context);
 
+  /// Called by backends that produce runtime filters to deliver them to this backend,
+  /// which acts as an intermediate aggregator for the filter.
+  virtual void UpdateFilterFromRemote(const UpdateFilterParamsPB* req,
+      UpdateFilterResultPB* resp, kudu::rpc::RpcContext* context);
+
   /// Respond to a RPC passed in 'response'/'ctx' with 'status' and release
   /// the payload memory from 'mem_tracker'. Takes ownership of 'ctx'.
   template<typename ResponsePBType>
@@ -76,6 +76,7 @@
 #include "runtime/tmp-file-mgr.h"
 #include "scheduling/admission-control-service.h"
 #include "scheduling/admission-controller.h"
+#include "scheduling/admission-lease-mgr.h"
 #include "service/cancellation-work.h"
 #include "service/client-request-state.h"
 #include "service/frontend.h"
@@ -2756,6 +2757,9 @@ void ImpalaServer::UnregisterSessionTimeout(int32_t session_timeout) {
           ClientRequestState* request_state = query_driver->GetActiveClientRequestState();
           TUniqueIdToUniqueIdPB(request_state->query_id(), request.add_query_ids());
         });
+    if (exec_env_->admission_lease_mgr() != nullptr) {
+      exec_env_->admission_lease_mgr()->ReturnExpiredLeases(&request);
+    }
 
     kudu::rpc::RpcController rpc_controller;
     kudu::Status rpc_status =
@@ -2768,6 +2772,9 @@ void ImpalaServer::UnregisterSessionTimeout(int32_t session_timeout) {
     if (!heartbeat_status.ok()) {
       LOG(ERROR) << "Admission heartbeat failed: " << heartbeat_status;
     }
+    if (exec_env_->admission_lease_mgr() != nullptr) {
+      exec_env_->admission_lease_mgr()->RevokeLeases(response);
+    }
   }
 }
 
@@ -1049,6 +1049,25 @@ Status impala::SetQueryOption(const string& key, const string& value,
         query_options->__set_utf8_mode(IsTrue(value));
         break;
       }
+      case TImpalaQueryOptions::RUNTIME_FILTER_AGGREGATION_FANOUT: {
+        StringParser::ParseResult status;
+        int32_t val =
+            StringParser::StringToInt<int32_t>(value.c_str(), value.size(), &status);
+        if (status != StringParser::PARSE_SUCCESS || val < 0) {
+          return Status(Substitute("Invalid runtime filter aggregation fanout: '$0'. "
+              "Only non-negative numbers are allowed.", value));
+        }
+        query_options->__set_runtime_filter_aggregation_fanout(val);
+        break;
+      }
+      case TImpalaQueryOptions::ORC_READ_STATISTICS: {
+        query_options->__set_orc_read_statistics(IsTrue(value));
+        break;
+      }
+      case TImpalaQueryOptions::AGGREGATE_SPILLED_PARTITIONS_IN_PASSES: {
+        query_options->__set_aggregate_spilled_partitions_in_passes(IsTrue(value));
+        break;
+      }
       case TImpalaQueryOptions::ANALYTIC_RANK_PUSHDOWN_THRESHOLD: {
         StringParser::ParseResult status;
         int64_t val =
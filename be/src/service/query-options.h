@@ -47,7 +47,7 @@ typedef std::unordered_map<string, beeswax::TQueryOptionLevel::type>
 // time we add or remove a query option to/from the enum TImpalaQueryOptions.
 #define QUERY_OPTS_TABLE\
   DCHECK_EQ(_TImpalaQueryOptions_VALUES_TO_NAMES.size(),\
-      TImpalaQueryOptions::SHOW_COLUMN_MINMAX_STATS + 1);\
+      TImpalaQueryOptions::AGGREGATE_SPILLED_PARTITIONS_IN_PASSES + 1);\
   REMOVED_QUERY_OPT_FN(abort_on_default_limit_exceeded, ABORT_ON_DEFAULT_LIMIT_EXCEEDED)\
   QUERY_OPT_FN(abort_on_error, ABORT_ON_ERROR, TQueryOptionLevel::REGULAR)\
   REMOVED_QUERY_OPT_FN(allow_unsupported_formats, ALLOW_UNSUPPORTED_FORMATS)\
@@ -242,6 +242,11 @@ typedef std::unordered_map<string, beeswax::TQueryOptionLevel::type>
       TQueryOptionLevel::ADVANCED)\
   QUERY_OPT_FN(show_column_minmax_stats, SHOW_COLUMN_MINMAX_STATS,\
       TQueryOptionLevel::ADVANCED)\
+  QUERY_OPT_FN(runtime_filter_aggregation_fanout, RUNTIME_FILTER_AGGREGATION_FANOUT,\
+      TQueryOptionLevel::ADVANCED)\
+  QUERY_OPT_FN(orc_read_statistics, ORC_READ_STATISTICS, TQueryOptionLevel::ADVANCED)\
+  QUERY_OPT_FN(aggregate_spilled_partitions_in_passes,\
+      AGGREGATE_SPILLED_PARTITIONS_IN_PASSES, TQueryOptionLevel::DEVELOPMENT)\
   ;
 
 /// Enforce practical limits on some query options to avoid undesired query state.
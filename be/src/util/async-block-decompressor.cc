@@ -0,0 +1,167 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/async-block-decompressor.h"
+
+#include <string.h>
+
+#include "gutil/strings/substitute.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "util/codec.h"
+#include "util/thread.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using strings::Substitute;
+
+AsyncBlockDecompressor::AsyncBlockDecompressor(MemTracker* mem_tracker,
+    THdfsCompression::type format)
+  : mem_tracker_(mem_tracker),
+    format_(format) {
+}
+
+AsyncBlockDecompressor::~AsyncBlockDecompressor() {
+  DCHECK(thread_ == nullptr) << "Must call Close()";
+}
+
+Status AsyncBlockDecompressor::Open(const string& category, const string& name) {
+  input_pool_.reset(new MemPool(mem_tracker_));
+  decompressor_pool_.reset(new MemPool(mem_tracker_));
+  // The output buffers of a batch are handed to the caller, so the decompressor must not
+  // reuse them.
+  RETURN_IF_ERROR(Codec::CreateDecompressor(
+      decompressor_pool_.get(), false, format_, &decompressor_));
+  return Thread::Create(category, name, [this]() { DecompressThread(); }, &thread_);
+}
+
+Status AsyncBlockDecompressor::AddBlock(const uint8_t* data, int64_t len) {
+  return AddBlockInternal(data, len, false, nullptr, 0);
+}
+
+Status AsyncBlockDecompressor::AddBlock(const uint8_t* data, int64_t len,
+    uint8_t* output, int64_t output_len) {
+  return AddBlockInternal(data, len, true, output, output_len);
+}
+
+Status AsyncBlockDecompressor::AddBlockInternal(const uint8_t* data, int64_t len,
+    bool output_preallocated, uint8_t* output, int64_t output_len) {
+  DCHECK(!batch_in_progress_);
+  Block block;
+  if (len > 0) {
+    block.input = input_pool_->TryAllocate(len);
+    if (UNLIKELY(block.input == nullptr)) {
+      string details = Substitute(
+          "AsyncBlockDecompressor failed to allocate $0 bytes for input.", len);
+      return mem_tracker_->MemLimitExceeded(nullptr, details, len);
+    }
+    memcpy(block.input, data, len);
+  }
+  block.input_len = len;
+  block.output_preallocated = output_preallocated;
+  block.output = output;
+  block.output_len = output_len;
+  blocks_.push_back(block);
+  return Status::OK();
+}
+
+void AsyncBlockDecompressor::StartBatch() {
+  DCHECK(!batch_in_progress_);
+  batch_in_progress_ = true;
+  {
+    lock_guard<mutex> l(lock_);
+    batch_pending_ = true;
+  }
+  batch_started_cv_.NotifyOne();
+}
+
+void AsyncBlockDecompressor::DiscardBlocks() {
+  DCHECK(!batch_in_progress_);
+  blocks_.clear();
+  input_pool_->Clear();
+}
+
+Status AsyncBlockDecompressor::WaitForBatch(MemPool* pool, vector<Output>* outputs) {
+  DCHECK(batch_in_progress_);
+  outputs->clear();
+  Status status;
+  {
+    unique_lock<mutex> l(lock_);
+    while (batch_pending_) batch_done_cv_.Wait(l);
+    status = batch_status_;
+  }
+  batch_in_progress_ = false;
+  input_pool_->Clear();
+  if (status.ok()) {
+    pool->AcquireData(decompressor_pool_.get(), false);
+    for (const Block& block : blocks_) {
+      Output output;
+      output.data = block.output;
+      output.len = block.output_len;
+      outputs->push_back(output);
+    }
+  } else {
+    decompressor_pool_->FreeAll();
+  }
+  blocks_.clear();
+  return status;
+}
+
+void AsyncBlockDecompressor::Close() {
+  {
+    lock_guard<mutex> l(lock_);
+    closed_ = true;
+  }
+  batch_started_cv_.NotifyAll();
+  if (thread_ != nullptr) {
+    thread_->Join();
+    thread_.reset();
+  }
+  blocks_.clear();
+  if (input_pool_ != nullptr) input_pool_->FreeAll();
+  if (decompressor_ != nullptr) {
+    decompressor_->Close();
+    decompressor_.reset();
+  }
+  if (decompressor_pool_ != nullptr) decompressor_pool_->FreeAll();
+}
+
+void AsyncBlockDecompressor::DecompressThread() {
+  while (true) {
+    {
+      unique_lock<mutex> l(lock_);
+      while (!batch_pending_ && !closed_) batch_started_cv_.Wait(l);
+      if (closed_) return;
+    }
+    Status status = DecompressBatch();
+    {
+      lock_guard<mutex> l(lock_);
+      batch_status_ = status;
+      batch_pending_ = false;
+    }
+    batch_done_cv_.NotifyAll();
+  }
+}
+
+Status AsyncBlockDecompressor::DecompressBatch() {
+  for (Block& block : blocks_) {
+    RETURN_IF_ERROR(decompressor_->ProcessBlock(block.output_preallocated,
+        block.input_len, block.input, &block.output_len, &block.output));
+  }
+  return Status::OK();
+}
@@ -0,0 +1,158 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "common/status.h"
+#include "gen-cpp/CatalogObjects_types.h"
+#include "util/condition-variable.h"
+
+namespace impala {
+
+class Codec;
+class MemPool;
+class MemTracker;
+class Thread;
+
+/// Decompresses independently compressed blocks, e.g. the blocks of a block-compressed
+/// SequenceFile or the column buffers of an RCFile row group, in a thread of its own.
+/// This lets a scanner read ahead and decompress the next block while it parses the
+/// current one. Unlike PipelinedDecompressor, which decompresses a single compressed
+/// stream, every block is decompressed on its own with Codec::ProcessBlock().
+///
+/// Blocks are decompressed in batches, one batch at a time: the caller adds the blocks of
+/// a batch with AddBlock(), starts their decompression with StartBatch() and gets the
+/// decompressed blocks with WaitForBatch(), after which the next batch can be added. The
+/// memory used is therefore bounded by the size of a single batch. Input is copied, so
+/// the caller can release its buffers right away.
+///
+/// All methods but the constructor and Close() must be called between Open() and
+/// Close(), from the same thread. Close() must be called if Open() was called.
+class AsyncBlockDecompressor {
+ public:
+  /// A decompressed block.
+  struct Output {
+    uint8_t* data = nullptr;
+    int64_t len = 0;
+  };
+
+  /// Memory is tracked against 'mem_tracker'.
+  AsyncBlockDecompressor(MemTracker* mem_tracker, THdfsCompression::type format);
+  ~AsyncBlockDecompressor();
+
+  /// Creates the decompressor and starts the decompression thread with 'category' and
+  /// 'name'.
+  Status Open(const std::string& category, const std::string& name) WARN_UNUSED_RESULT;
+
+  /// Copies the compressed block [data, data + len) and adds it to the next batch. The
+  /// block is decompressed into a buffer allocated by the decompressor. Must not be
+  /// called while a batch is in progress.
+  Status AddBlock(const uint8_t* data, int64_t len) WARN_UNUSED_RESULT;
+
+  /// Same as above, but the block is decompressed into the 'output_len' bytes at
+  /// 'output', which must stay valid until WaitForBatch() returns.
+  Status AddBlock(const uint8_t* data, int64_t len, uint8_t* output, int64_t output_len)
+      WARN_UNUSED_RESULT;
+
+  /// Starts decompressing the blocks that were added since the last batch.
+  void StartBatch();
+
+  /// Discards the blocks that were added since the last batch.
+  void DiscardBlocks();
+
+  /// Returns true between StartBatch() and WaitForBatch().
+  bool batch_in_progress() const { return batch_in_progress_; }
+
+  /// Waits until the blocks of the batch in progress are decompressed and returns them
+  /// in 'outputs', in the order in which they were added. The memory of the buffers that
+  /// the decompressor allocated is transferred to 'pool'. Returns the first error of the
+  /// batch, in which case 'outputs' is empty.
+  Status WaitForBatch(MemPool* pool, std::vector<Output>* outputs) WARN_UNUSED_RESULT;
+
+  /// Stops the decompression thread, waits for it to finish the batch in progress, if
+  /// any, and frees the memory that was not transferred by WaitForBatch().
+  void Close();
+
+ private:
+  /// A block of a batch.
+  struct Block {
+    uint8_t* input = nullptr;
+    int64_t input_len = 0;
+    bool output_preallocated = false;
+    uint8_t* output = nullptr;
+    int64_t output_len = 0;
+  };
+
+  /// Implements AddBlock().
+  Status AddBlockInternal(const uint8_t* data, int64_t len, bool output_preallocated,
+      uint8_t* output, int64_t output_len) WARN_UNUSED_RESULT;
+
+  /// Main function of the decompression thread. Decompresses the batches until Close()
+  /// is called.
+  void DecompressThread();
+
+  /// Decompresses the blocks of 'blocks_'. Called by the decompression thread.
+  Status DecompressBatch() WARN_UNUSED_RESULT;
+
+  MemTracker* const mem_tracker_;
+  const THdfsCompression::type format_;
+
+  /// The copies of the input of the blocks of the current batch.
+  boost::scoped_ptr<MemPool> input_pool_;
+
+  /// The decompressor, only used by the decompression thread. It allocates the output
+  /// buffers that are not preallocated from 'decompressor_pool_', whose memory is
+  /// transferred by WaitForBatch().
+  boost::scoped_ptr<MemPool> decompressor_pool_;
+  boost::scoped_ptr<Codec> decompressor_;
+
+  std::unique_ptr<Thread> thread_;
+
+  /// The blocks of the current batch. Only accessed by the decompression thread while
+  /// the batch is in progress, otherwise only by the caller.
+  std::vector<Block> blocks_;
+
+  /// True between StartBatch() and WaitForBatch(). Only accessed by the caller.
+  bool batch_in_progress_ = false;
+
+  /// Protects the members below.
+  std::mutex lock_;
+
+  /// Signalled when a batch is started or Close() is called.
+  ConditionVariable batch_started_cv_;
+
+  /// Signalled when the decompression thread finished a batch.
+  ConditionVariable batch_done_cv_;
+
+  /// True from StartBatch() until the decompression thread finished the batch.
+  bool batch_pending_ = false;
+
+  /// True once Close() was called.
+  bool closed_ = false;
+
+  /// The result of the last batch.
+  Status batch_status_;
+};
+
+}
@@ -408,5 +408,31 @@ TEST(BitUtil, IntToByteArray) {
       {1, 20, -117, 11, 84, -65, -45, -115, -87, -119, 96});
 }
 
+
+// Compares FindEscaped64() against a character by character scan of random blocks.
+TEST(BitUtil, FindEscaped64) {
+  srand(0);
+  for (int iter = 0; iter < 10000; ++iter) {
+    // Dense escape masks produce long runs of escape characters.
+    uint64_t escape_mask = 0;
+    for (int i = 0; i < 64; ++i) {
+      if (rand() % 3 != 0) escape_mask |= 1ULL << i;
+    }
+    bool escape_next = rand() % 2;
+    uint64_t expected = 0;
+    bool escaped = escape_next;
+    for (int i = 0; i < 64; ++i) {
+      if (escaped) {
+        expected |= 1ULL << i;
+        escaped = false;
+      } else {
+        escaped = (escape_mask >> i) & 1;
+      }
+    }
+    EXPECT_EQ(expected, BitUtil::FindEscaped64(escape_mask, &escape_next));
+    EXPECT_EQ(escaped, escape_next);
+  }
+}
+
 }
 
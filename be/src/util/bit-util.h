@@ -163,6 +163,27 @@ class BitUtil {
     return ((1UL << num_bits) - 1) & v;
   }
 
+  /// Returns the mask of the characters of a 64 character block that are escaped, given
+  /// the mask 'escape_mask' of the escape characters in the block. Escape characters can
+  /// escape escape characters, so a character is escaped if it follows an odd-length run
+  /// of escape characters. '*escape_next' is true if the first character of the block is
+  /// escaped and is updated for the next block. The runs of escape characters starting
+  /// at odd positions are added to 'escape_mask', so that the carry of the addition ends
+  /// up right after the end of each run and flips the parity of the escaped positions.
+  static inline uint64_t FindEscaped64(uint64_t escape_mask, bool* escape_next) {
+    const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+    const uint64_t escaped_first = *escape_next ? 1 : 0;
+    // An escape character that is escaped itself doesn't escape the next character.
+    escape_mask &= ~escaped_first;
+    const uint64_t follows_escape = escape_mask << 1 | escaped_first;
+    const uint64_t odd_run_starts = escape_mask & ~EVEN_BITS & ~follows_escape;
+    unsigned long long runs_starting_on_even_bits;
+    *escape_next = __builtin_uaddll_overflow(
+        odd_run_starts, escape_mask, &runs_starting_on_even_bits);
+    const uint64_t invert_mask = runs_starting_on_even_bits << 1;
+    return (EVEN_BITS ^ invert_mask) & follows_escape;
+  }
+
   /// Swaps the byte order (i.e. endianess)
   static inline int64_t ByteSwap(int64_t value) {
     return __builtin_bswap64(value);
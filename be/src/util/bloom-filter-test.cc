@@ -443,5 +443,86 @@ TEST_F(BloomFilterTest, ProtobufOr) {
   ASSERT_FALSE(BfFind(*bf4, 81));
 }
 
+// Sparse directories are compressed and can be decompressed into an identical directory.
+// Dense directories are sent uncompressed.
+TEST_F(BloomFilterTest, CompressDirectory) {
+  const int log_bufferpool_space = 20;
+  BloomFilter* sparse = CreateBloomFilter(log_bufferpool_space);
+  for (int i = 0; i < 1000; ++i) BfInsert(*sparse, MakeRand());
+  kudu::Slice directory = sparse->GetBlockBloomFilter()->directory();
+  EXPECT_LT(BloomFilter::GetFillRatio(directory.data(), directory.size()), 0.1);
+
+  string compressed;
+  ASSERT_TRUE(
+      BloomFilter::CompressDirectory(directory.data(), directory.size(), &compressed));
+  EXPECT_LT(compressed.size(), directory.size() / 10);
+
+  BloomFilterPB protobuf;
+  protobuf.set_log_bufferpool_space(log_bufferpool_space);
+  protobuf.set_directory_compression(CompressionTypePB::LZ4);
+  string buffer;
+  kudu::Slice decompressed;
+  ASSERT_OK(BloomFilter::DecompressDirectory(
+      protobuf, kudu::Slice(compressed), &buffer, &decompressed));
+  EXPECT_TRUE(directory == decompressed);
+
+  // A truncated directory is rejected.
+  kudu::Slice truncated(compressed.data(), compressed.size() / 2);
+  EXPECT_FALSE(
+      BloomFilter::DecompressDirectory(protobuf, truncated, &buffer, &decompressed).ok());
+
+  // Uncompressed directories are returned as is.
+  protobuf.set_directory_compression(CompressionTypePB::NONE);
+  ASSERT_OK(
+      BloomFilter::DecompressDirectory(protobuf, directory, &buffer, &decompressed));
+  EXPECT_EQ(directory.data(), decompressed.data());
+
+  BloomFilter* dense = CreateBloomFilter(log_bufferpool_space);
+  for (int i = 0; i < 1000000; ++i) BfInsert(*dense, MakeRand());
+  directory = dense->GetBlockBloomFilter()->directory();
+  EXPECT_GT(BloomFilter::GetFillRatio(directory.data(), directory.size()), 0.9);
+  EXPECT_FALSE(
+      BloomFilter::CompressDirectory(directory.data(), directory.size(), &compressed));
+}
+
+// Folding a filter produces the same directory as inserting the same elements into a
+// smaller filter, and the number of distinct elements can be estimated from the
+// directory.
+TEST_F(BloomFilterTest, Fold) {
+  const int log_large = 20;
+  const int log_small = 14;
+  const int ndv = 10000;
+  BloomFilter* large = CreateBloomFilter(log_large);
+  BloomFilter* small = CreateBloomFilter(log_small);
+  for (int i = 0; i < ndv; ++i) {
+    uint32_t val = MakeRand();
+    BfInsert(*large, val);
+    BfInsert(*small, val);
+  }
+  kudu::Slice large_directory = large->GetBlockBloomFilter()->directory();
+  kudu::Slice small_directory = small->GetBlockBloomFilter()->directory();
+  int64_t estimate = BloomFilter::EstimateNdv(large_directory.data(),
+      large_directory.size());
+  EXPECT_NEAR(estimate, ndv, ndv / 10);
+
+  string folded = large_directory.ToString();
+  BloomFilter::FoldDirectory(reinterpret_cast<uint8_t*>(&folded[0]), folded.size(),
+      small_directory.size());
+  EXPECT_TRUE(kudu::Slice(folded.data(), small_directory.size()) == small_directory);
+
+  ASSERT_OK(large->Fold(log_small, 0));
+  EXPECT_EQ(1LL << log_small, large->GetBufferPoolSpaceUsed());
+  EXPECT_TRUE(large->GetBlockBloomFilter()->directory() == small_directory);
+
+  // The folded size keeps the false positive probability below the target, but is
+  // bounded by the minimum and the current size.
+  int log_space = BloomFilter::GetFoldedLogSpace(ndv, 0.1, 12, log_large);
+  EXPECT_EQ(BloomFilter::MinLogSpace(ndv, 0.1), log_space);
+  EXPECT_LE(BloomFilter::FalsePositiveProb(ndv, log_space), 0.1);
+  EXPECT_EQ(12, BloomFilter::GetFoldedLogSpace(1, 0.1, 12, log_large));
+  EXPECT_EQ(log_large, BloomFilter::GetFoldedLogSpace(
+      numeric_limits<int64_t>::max(), 0.1, 12, log_large));
+}
+
 }  // namespace impala
 
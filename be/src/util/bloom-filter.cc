@@ -26,22 +26,81 @@
 
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <ostream>
 
 #include "gen-cpp/data_stream_service.pb.h"
+#include "gutil/strings/substitute.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/util/block_bloom_filter.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "runtime/exec-env.h"
+#include "util/bit-util.h"
+#include "util/compress.h"
+#include "util/decompress.h"
 #include "util/kudu-status-util.h"
+#include "util/scope-exit-trigger.h"
 
 using namespace std;
+using strings::Substitute;
+
+DEFINE_double(bloom_filter_compression_max_fill_ratio, 0.5,
+    "Runtime Bloom filter directories in which at most this fraction of 64-bit words "
+    "have a bit set are compressed with LZ4 before being sent over the network. Sparse "
+    "filters, e.g. filters that were sized for a much larger build side, compress well. "
+    "Set to 0 to disable compression.");
+DEFINE_int64(bloom_filter_compression_min_size, 64L * 1024,
+    "Runtime Bloom filter directories smaller than this number of bytes are always sent "
+    "uncompressed.");
 
 namespace impala {
 
+namespace {
+
+/// Maximum number of 64-bit words inspected by BloomFilter::GetFillRatio().
+constexpr int64_t FILL_RATIO_MAX_SAMPLES = 64 * 1024;
+
+/// Size in bytes of a bucket of kudu::BlockBloomFilter, made up of 8 32-bit words.
+constexpr int64_t BUCKET_BYTES = 32;
+
+/// Maximum number of buckets inspected by BloomFilter::EstimateNdv().
+constexpr int64_t NDV_ESTIMATE_MAX_SAMPLES = 64 * 1024;
+
+/// Compresses 'directory' into 'compressed' with LZ4. 'T' is either std::string or
+/// kudu::faststring. Returns true if the compressed directory is smaller than the input.
+template <typename T>
+bool CompressDirectoryInternal(
+    const uint8_t* directory, int64_t directory_size, T* compressed) {
+  if (directory_size < FLAGS_bloom_filter_compression_min_size) return false;
+  double fill_ratio = BloomFilter::GetFillRatio(directory, directory_size);
+  if (fill_ratio > FLAGS_bloom_filter_compression_max_fill_ratio) return false;
+
+  Lz4Compressor compressor(nullptr, false);
+  Status status = compressor.Init();
+  if (!status.ok()) return false;
+  auto compressor_cleanup = MakeScopeExitTrigger([&compressor]() { compressor.Close(); });
+  // If the input size is too large for LZ4 to compress, MaxOutputLen() will return 0.
+  int64_t compressed_size = compressor.MaxOutputLen(directory_size);
+  if (compressed_size == 0) return false;
+  compressed->resize(compressed_size);
+  uint8_t* output = reinterpret_cast<uint8_t*>(&(*compressed)[0]);
+  status = compressor.ProcessBlock(
+      true, directory_size, directory, &compressed_size, &output);
+  if (!status.ok() || compressed_size <= 0 || compressed_size >= directory_size) {
+    return false;
+  }
+  compressed->resize(compressed_size);
+  VLOG(3) << "Compressed Bloom filter directory with fill ratio " << fill_ratio
+          << " from " << directory_size << " to " << compressed_size << " bytes";
+  return true;
+}
+
+} // anonymous namespace
+
 constexpr BloomFilter* const BloomFilter::ALWAYS_TRUE_FILTER;
 
 BloomFilter::BloomFilter(BufferPool::ClientHandle* client)
@@ -110,6 +169,146 @@ void BloomFilter::AddDirectorySidecar(BloomFilterPB* rpc_params,
       static_cast<unsigned long>(directory.size()));
 }
 
+void BloomFilter::AddCompressedDirectorySidecar(BloomFilterPB* rpc_params,
+    kudu::rpc::RpcController* controller, const uint8_t* directory,
+    int64_t directory_size) {
+  DCHECK(rpc_params != nullptr);
+  unique_ptr<kudu::faststring> compressed(new kudu::faststring());
+  if (!CompressDirectoryInternal(directory, directory_size, compressed.get())) {
+    rpc_params->set_directory_compression(CompressionTypePB::NONE);
+    AddDirectorySidecar(rpc_params, controller, reinterpret_cast<const char*>(directory),
+        static_cast<unsigned long>(directory_size));
+    return;
+  }
+  DCHECK(!rpc_params->always_false());
+  DCHECK(!rpc_params->always_true());
+  int sidecar_idx = -1;
+  kudu::Status sidecar_status = controller->AddOutboundSidecar(
+      kudu::rpc::RpcSidecar::FromFaststring(move(compressed)), &sidecar_idx);
+  if (!sidecar_status.ok()) {
+    LOG(ERROR) << "Cannot add outbound sidecar: " << sidecar_status.message().ToString();
+    // Same as in AddDirectorySidecar(), 'disable' the BloomFilterPB.
+    rpc_params->set_always_false(false);
+    rpc_params->set_always_true(true);
+    return;
+  }
+  rpc_params->set_directory_sidecar_idx(sidecar_idx);
+  rpc_params->set_directory_compression(CompressionTypePB::LZ4);
+  rpc_params->set_always_false(false);
+  rpc_params->set_always_true(false);
+}
+
+double BloomFilter::GetFillRatio(const uint8_t* directory, int64_t directory_size) {
+  int64_t num_words = directory_size / sizeof(uint64_t);
+  if (num_words == 0) return 1.0;
+  int64_t stride = max<int64_t>(1, num_words / FILL_RATIO_MAX_SAMPLES);
+  int64_t num_samples = 0;
+  int64_t num_set = 0;
+  for (int64_t i = 0; i < num_words; i += stride) {
+    uint64_t word;
+    memcpy(&word, directory + i * sizeof(uint64_t), sizeof(word));
+    num_set += word != 0;
+    ++num_samples;
+  }
+  return static_cast<double>(num_set) / num_samples;
+}
+
+Status BloomFilter::Fold(int log_bufferpool_space, uint32_t hash_seed) {
+  DCHECK(!AlwaysFalse());
+  kudu::Slice directory = block_bloom_filter_.directory();
+  int64_t folded_size = 1LL << log_bufferpool_space;
+  DCHECK_LE(folded_size, directory.size());
+  if (folded_size >= directory.size()) return Status::OK();
+  // InitFromDirectory() frees the current directory before allocating the new one, so
+  // the folded directory is assembled in a temporary copy.
+  string folded(reinterpret_cast<const char*>(directory.data()), folded_size);
+  uint8_t* folded_data = reinterpret_cast<uint8_t*>(&folded[0]);
+  for (int64_t offset = folded_size; offset < directory.size(); offset += folded_size) {
+    kudu::BlockBloomFilter::OrEqualArray(
+        folded_size, directory.data() + offset, folded_data);
+  }
+  KUDU_RETURN_IF_ERROR(
+      block_bloom_filter_.InitFromDirectory(log_bufferpool_space, kudu::Slice(folded),
+          false, kudu::FAST_HASH, hash_seed),
+      "Failed to fold Block Bloom Filter");
+  return Status::OK();
+}
+
+void BloomFilter::FoldDirectory(
+    uint8_t* directory, int64_t directory_size, int64_t folded_size) {
+  DCHECK(BitUtil::IsPowerOf2(folded_size));
+  DCHECK_LE(folded_size, directory_size);
+  DCHECK_EQ(directory_size % folded_size, 0);
+  for (int64_t offset = folded_size; offset < directory_size; offset += folded_size) {
+    kudu::BlockBloomFilter::OrEqualArray(folded_size, directory + offset, directory);
+  }
+}
+
+int64_t BloomFilter::EstimateNdv(const uint8_t* directory, int64_t directory_size) {
+  int64_t num_buckets = directory_size / BUCKET_BYTES;
+  if (num_buckets == 0) return 0;
+  int64_t stride = max<int64_t>(1, num_buckets / NDV_ESTIMATE_MAX_SAMPLES);
+  int64_t num_samples = 0;
+  int64_t num_set = 0;
+  for (int64_t i = 0; i < num_buckets; i += stride) {
+    const uint8_t* bucket = directory + i * BUCKET_BYTES;
+    for (int j = 0; j < BUCKET_BYTES; j += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, bucket + j, sizeof(word));
+      num_set += BitUtil::Popcount(word);
+    }
+    ++num_samples;
+  }
+  int64_t num_bits = num_samples * BUCKET_BYTES * 8;
+  if (num_set >= num_bits) return numeric_limits<int64_t>::max();
+  double unset_fraction = static_cast<double>(num_bits - num_set) / num_bits;
+  return llround(-32.0 * num_buckets * log(unset_fraction));
+}
+
+int BloomFilter::GetFoldedLogSpace(
+    int64_t ndv, double fpp, int min_log_space, int log_space) {
+  if (ndv >= static_cast<int64_t>(MaxNdv(log_space, fpp))) return log_space;
+  return min(log_space, max(min_log_space, MinLogSpace(ndv, fpp)));
+}
+
+bool BloomFilter::CompressDirectory(
+    const uint8_t* directory, int64_t directory_size, string* compressed) {
+  return CompressDirectoryInternal(directory, directory_size, compressed);
+}
+
+Status BloomFilter::DecompressDirectory(const BloomFilterPB& protobuf,
+    const kudu::Slice& sidecar, string* buffer, kudu::Slice* directory) {
+  if (protobuf.directory_compression() == CompressionTypePB::NONE) {
+    *directory = sidecar;
+    return Status::OK();
+  }
+  if (protobuf.directory_compression() != CompressionTypePB::LZ4) {
+    return Status(Substitute("Unsupported Bloom filter directory compression: $0",
+        CompressionTypePB_Name(protobuf.directory_compression())));
+  }
+  // Only directories that LZ4 can compress, i.e. smaller than 2GB, are compressed.
+  int log_space = protobuf.log_bufferpool_space();
+  if (log_space < 0 || log_space > 30) {
+    return Status(Substitute("Invalid Bloom filter log space: $0", log_space));
+  }
+  int64_t directory_size = 1LL << log_space;
+  buffer->resize(directory_size);
+  Lz4Decompressor decompressor(nullptr, false);
+  RETURN_IF_ERROR(decompressor.Init());
+  auto decompressor_cleanup =
+      MakeScopeExitTrigger([&decompressor]() { decompressor.Close(); });
+  int64_t decompressed_size = directory_size;
+  uint8_t* output = reinterpret_cast<uint8_t*>(&(*buffer)[0]);
+  RETURN_IF_ERROR(decompressor.ProcessBlock(
+      true, sidecar.size(), sidecar.data(), &decompressed_size, &output));
+  if (decompressed_size != directory_size) {
+    return Status(Substitute("Decompressed Bloom filter directory has $0 bytes, "
+        "expected $1", decompressed_size, directory_size));
+  }
+  *directory = kudu::Slice(*buffer);
+  return Status::OK();
+}
+
 void BloomFilter::ToProtobuf(
     BloomFilterPB* protobuf, kudu::rpc::RpcController* controller) const {
   protobuf->set_log_bufferpool_space(block_bloom_filter_.log_space_bytes());
@@ -119,9 +318,8 @@ void BloomFilter::ToProtobuf(
     return;
   }
   kudu::Slice directory = block_bloom_filter_.directory();
-  BloomFilter::AddDirectorySidecar(protobuf, controller,
-      reinterpret_cast<const char*>(directory.data()),
-      static_cast<unsigned long>(directory.size()));
+  BloomFilter::AddCompressedDirectorySidecar(
+      protobuf, controller, directory.data(), directory.size());
 }
 
 void BloomFilter::ToProtobuf(const BloomFilter* filter,
@@ -208,6 +208,63 @@ class BloomFilter {
   static void AddDirectorySidecar(BloomFilterPB* rpc_params,
       kudu::rpc::RpcController* controller, const string& directory);
 
+  /// Same as AddDirectorySidecar(), but first tries to compress 'directory' with
+  /// CompressDirectory(). If the directory is compressed, the sidecar owns the
+  /// compressed copy and 'directory' does not need to outlive the RPC. Otherwise the
+  /// sidecar references 'directory' directly, as in AddDirectorySidecar(). Sets
+  /// 'rpc_params->directory_compression' accordingly.
+  static void AddCompressedDirectorySidecar(BloomFilterPB* rpc_params,
+      kudu::rpc::RpcController* controller, const uint8_t* directory,
+      int64_t directory_size);
+
+  /// Shrinks the filter to (1 << log_bufferpool_space) bytes by folding its directory,
+  /// see FoldDirectory(). The filter must not be always false and 'hash_seed' must be
+  /// the seed it was initialized with. The smaller directory is allocated after the
+  /// current one is freed. If that fails, an error is returned and the filter must not
+  /// be used anymore.
+  Status Fold(int log_bufferpool_space, uint32_t hash_seed);
+
+  /// Folds 'directory' of 'directory_size' bytes in place, so that its first
+  /// 'folded_size' bytes are the directory of a filter of that size with the same
+  /// elements. 'folded_size' must be a power of two that is at most 'directory_size'.
+  /// Folding is exact because the bucket of an element is its rehashed hash masked by
+  /// the number of buckets, so bucket i of the folded filter is the OR of all buckets
+  /// whose index is i modulo the number of buckets in the folded filter.
+  static void FoldDirectory(
+      uint8_t* directory, int64_t directory_size, int64_t folded_size);
+
+  /// Estimates the number of distinct elements inserted into 'directory' from the
+  /// fraction of its bits that are set. Each insert sets one bit in each of the 8 words
+  /// of a bucket, so after n inserts into B buckets, a bit is unset with probability
+  /// exp(-n / (32 * B)). Large directories are sampled at evenly spaced buckets.
+  /// Returns INT64_MAX if all sampled bits are set.
+  static int64_t EstimateNdv(const uint8_t* directory, int64_t directory_size);
+
+  /// Returns the log (base 2) of the smallest size in bytes that is at least
+  /// (1 << min_log_space) and keeps the false positive probability of a filter with
+  /// 'ndv' distinct elements below 'fpp'. The result is capped at 'log_space', the
+  /// current size of the filter, since filters can only be folded to smaller sizes.
+  static int GetFoldedLogSpace(int64_t ndv, double fpp, int min_log_space, int log_space);
+
+  /// Returns the fraction of 64-bit words in 'directory' that have at least one bit set.
+  /// Large directories are sampled at evenly spaced words to bound the cost.
+  static double GetFillRatio(const uint8_t* directory, int64_t directory_size);
+
+  /// Compresses 'directory' with LZ4 into 'compressed' if compression is expected to
+  /// pay off, i.e. if the directory is at least --bloom_filter_compression_min_size
+  /// bytes and its fill ratio is at most --bloom_filter_compression_max_fill_ratio.
+  /// Returns true if 'compressed' holds a compressed directory that is smaller than
+  /// the input, false if the directory should be sent uncompressed.
+  static bool CompressDirectory(
+      const uint8_t* directory, int64_t directory_size, std::string* compressed);
+
+  /// Sets 'directory' to the uncompressed directory of 'protobuf', given the contents
+  /// of its sidecar in 'sidecar'. If the directory was compressed by the sender, it is
+  /// decompressed into 'buffer' and 'directory' points into 'buffer'. Otherwise
+  /// 'directory' points to 'sidecar'. Returns an error if the directory is corrupt.
+  static Status DecompressDirectory(const BloomFilterPB& protobuf,
+      const kudu::Slice& sidecar, std::string* buffer, kudu::Slice* directory);
+
   kudu::BlockBloomFilter* GetBlockBloomFilter() { return &block_bloom_filter_; }
 
  private:
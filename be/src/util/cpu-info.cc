@@ -73,6 +73,7 @@ const int64_t CpuInfo::POPCNT;
 const int64_t CpuInfo::AVX;
 const int64_t CpuInfo::AVX2;
 const int64_t CpuInfo::PCLMULQDQ;
+const int64_t CpuInfo::AVX512BW;
 
 bool CpuInfo::initialized_ = false;
 int64_t CpuInfo::hardware_flags_ = 0;
@@ -97,7 +98,8 @@ static struct {
   { "popcnt",    CpuInfo::POPCNT },
   { "avx",       CpuInfo::AVX },
   { "avx2",      CpuInfo::AVX2 },
-  { "pclmulqdq", CpuInfo::PCLMULQDQ }
+  { "pclmulqdq", CpuInfo::PCLMULQDQ },
+  { "avx512bw",  CpuInfo::AVX512BW }
 };
 static const long num_flags = sizeof(flag_mappings) / sizeof(flag_mappings[0]);
 
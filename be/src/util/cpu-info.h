@@ -39,6 +39,7 @@ class CpuInfo {
   static const int64_t AVX       = (1 << 5);
   static const int64_t AVX2      = (1 << 6);
   static const int64_t PCLMULQDQ = (1 << 7);
+  static const int64_t AVX512BW  = (1 << 8);
 
   /// Cache enums for L1 (data), L2 and L3
   enum CacheLevel {
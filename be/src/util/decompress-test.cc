@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <zlib.h>
 #include <zstd.h>
 #include <iostream>
 
@@ -27,8 +28,10 @@
 #include "runtime/mem-pool.h"
 #include "testutil/gtest-util.h"
 #include "testutil/rand-util.h"
+#include "util/async-block-decompressor.h"
 #include "util/decompress.h"
 #include "util/compress.h"
+#include "util/pipelined-decompressor.h"
 #include "util/ubsan.h"
 
 #include "common/names.h"
@@ -593,6 +596,176 @@ TEST_F(DecompressorTest, LZ4HadoopCompat) {
 TEST_F(DecompressorTest, LZ4Blocked) {
   RunTest(THdfsCompression::LZ4_BLOCKED);
 }
+
+// Compresses [input, input + input_len) into a BGZF block, as bgzip does, and appends it
+// to 'output'.
+static void AppendBgzfBlock(
+    const uint8_t* input, int input_len, vector<uint8_t>* output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  ASSERT_EQ(Z_OK, deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+      Z_DEFAULT_STRATEGY));
+  vector<uint8_t> deflated(deflateBound(&stream, input_len));
+  stream.next_in = const_cast<uint8_t*>(input);
+  stream.avail_in = input_len;
+  stream.next_out = deflated.data();
+  stream.avail_out = deflated.size();
+  ASSERT_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+  int deflated_len = stream.total_out;
+  ASSERT_EQ(Z_OK, deflateEnd(&stream));
+
+  int block_size = GzipDecompressor::BGZF_HEADER_SIZE + deflated_len + 8;
+  ASSERT_LE(block_size, GzipDecompressor::BGZF_MAX_BLOCK_SIZE);
+  uint8_t header[] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0,
+      static_cast<uint8_t>((block_size - 1) & 0xff),
+      static_cast<uint8_t>((block_size - 1) >> 8)};
+  output->insert(output->end(), header, header + sizeof(header));
+  output->insert(output->end(), deflated.data(), deflated.data() + deflated_len);
+  uint32_t trailer[] = {static_cast<uint32_t>(crc32(0, input, input_len)),
+      static_cast<uint32_t>(input_len)};
+  const uint8_t* trailer_bytes = reinterpret_cast<const uint8_t*>(trailer);
+  output->insert(output->end(), trailer_bytes, trailer_bytes + sizeof(trailer));
+}
+
+TEST_F(DecompressorTest, Bgzf) {
+  // Two blocks with data and the empty block that bgzip writes at the end of a file.
+  vector<uint8_t> file;
+  AppendBgzfBlock(input_, 10000, &file);
+  int second_block_offset = file.size();
+  AppendBgzfBlock(input_ + 10000, sizeof(input_) - 10000, &file);
+  int eof_block_offset = file.size();
+  AppendBgzfBlock(nullptr, 0, &file);
+
+  scoped_ptr<Codec> decompressor;
+  EXPECT_OK(Codec::CreateDecompressor(
+      &mem_pool_, true, THdfsCompression::GZIP, &decompressor));
+  int64_t offset = 0;
+  for (int64_t block_offset : {0, second_block_offset, eof_block_offset}) {
+    const uint8_t* block = file.data() + block_offset;
+    ASSERT_TRUE(GzipDecompressor::IsBgzfHeader(block));
+    int block_size = GzipDecompressor::BgzfBlockSize(block);
+    int64_t uncompressed_size = GzipDecompressor::BgzfUncompressedSize(block, block_size);
+    // Each block can be decompressed on its own.
+    uint8_t* output = mem_pool_.Allocate(uncompressed_size);
+    int64_t output_len = uncompressed_size;
+    EXPECT_OK(decompressor->ProcessBlock(true, block_size, const_cast<uint8_t*>(block),
+        &output_len, &output));
+    ASSERT_EQ(uncompressed_size, output_len);
+    EXPECT_EQ(0, Ubsan::MemCmp(input_ + offset, output, output_len));
+    offset += output_len;
+  }
+  EXPECT_EQ(sizeof(input_), offset);
+
+  // Plain gzip is not BGZF.
+  scoped_ptr<Codec> compressor;
+  EXPECT_OK(Codec::CreateCompressor(&mem_pool_, true,
+      Codec::CodecInfo(THdfsCompression::GZIP), &compressor));
+  uint8_t* compressed;
+  int64_t compressed_len;
+  EXPECT_OK(compressor->ProcessBlock(false, sizeof(input_), input_, &compressed_len,
+      &compressed));
+  ASSERT_GE(compressed_len, GzipDecompressor::BGZF_HEADER_SIZE);
+  EXPECT_FALSE(GzipDecompressor::IsBgzfHeader(compressed));
+  compressor->Close();
+  decompressor->Close();
+}
+
+TEST_F(DecompressorTest, Pipelined) {
+  scoped_ptr<Codec> compressor;
+  EXPECT_OK(Codec::CreateCompressor(&mem_pool_, true,
+      Codec::CodecInfo(THdfsCompression::GZIP), &compressor));
+  uint8_t* compressed;
+  int64_t compressed_len;
+  EXPECT_OK(compressor->ProcessBlock(false, sizeof(input_streaming_), input_streaming_,
+      &compressed_len, &compressed));
+  compressor->Close();
+
+  // Feed the compressed data in small chunks, as the text scanner does with I/O buffers,
+  // and truncated to check that the error is returned.
+  for (bool truncated : {false, true}) {
+    int64_t input_len = truncated ? compressed_len / 2 : compressed_len;
+    PipelinedDecompressor decompressor(&mem_tracker_, THdfsCompression::GZIP, "file");
+    ASSERT_OK(decompressor.Open("test", "pipelined-decompression"));
+    const int64_t CHUNK_SIZE = 1000;
+    int64_t input_offset = 0;
+    int64_t output_offset = 0;
+    bool eos = false;
+    Status status;
+    while (!eos) {
+      while (input_offset < input_len && decompressor.NeedsInput()) {
+        int64_t chunk_len = min(CHUNK_SIZE, input_len - input_offset);
+        input_offset += chunk_len;
+        ASSERT_OK(decompressor.AddInput(compressed + input_offset - chunk_len, chunk_len,
+            input_offset == input_len));
+      }
+      uint8_t* output;
+      int64_t output_len;
+      status = decompressor.GetOutput(&mem_pool_, &output, &output_len, &eos);
+      if (!status.ok()) break;
+      ASSERT_LE(output_offset + output_len, sizeof(input_streaming_));
+      EXPECT_EQ(0, Ubsan::MemCmp(input_streaming_ + output_offset, output, output_len));
+      output_offset += output_len;
+    }
+    decompressor.Close();
+    if (truncated) {
+      EXPECT_EQ(TErrorCode::COMPRESSED_FILE_TRUNCATED, status.code());
+    } else {
+      EXPECT_OK(status);
+      EXPECT_EQ(sizeof(input_streaming_), output_offset);
+    }
+  }
+}
+
+TEST_F(DecompressorTest, AsyncBlock) {
+  scoped_ptr<Codec> compressor;
+  EXPECT_OK(Codec::CreateCompressor(&mem_pool_, true,
+      Codec::CodecInfo(THdfsCompression::SNAPPY), &compressor));
+  uint8_t* compressed;
+  int64_t compressed_len;
+  EXPECT_OK(compressor->ProcessBlock(false, sizeof(input_), input_, &compressed_len,
+      &compressed));
+  compressor->Close();
+
+  AsyncBlockDecompressor decompressor(&mem_tracker_, THdfsCompression::SNAPPY);
+  ASSERT_OK(decompressor.Open("test", "async-block-decompression"));
+  // Decompress the same block into a buffer of the decompressor and into a preallocated
+  // buffer, in two consecutive batches, as the scanners do.
+  uint8_t preallocated[sizeof(input_)];
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_OK(decompressor.AddBlock(compressed, compressed_len));
+    ASSERT_OK(decompressor.AddBlock(
+        compressed, compressed_len, preallocated, sizeof(preallocated)));
+    decompressor.StartBatch();
+    EXPECT_TRUE(decompressor.batch_in_progress());
+    vector<AsyncBlockDecompressor::Output> outputs;
+    ASSERT_OK(decompressor.WaitForBatch(&mem_pool_, &outputs));
+    EXPECT_FALSE(decompressor.batch_in_progress());
+    ASSERT_EQ(2, outputs.size());
+    EXPECT_NE(preallocated, outputs[0].data);
+    EXPECT_EQ(preallocated, outputs[1].data);
+    for (const AsyncBlockDecompressor::Output& output : outputs) {
+      ASSERT_EQ(sizeof(input_), output.len);
+      EXPECT_EQ(0, memcmp(input_, output.data, output.len));
+    }
+  }
+
+  // A corrupt block fails its batch, but not the next one.
+  ASSERT_OK(decompressor.AddBlock(compressed, compressed_len / 2));
+  decompressor.StartBatch();
+  vector<AsyncBlockDecompressor::Output> outputs;
+  EXPECT_FALSE(decompressor.WaitForBatch(&mem_pool_, &outputs).ok());
+  EXPECT_TRUE(outputs.empty());
+  ASSERT_OK(decompressor.AddBlock(compressed, compressed_len));
+  decompressor.StartBatch();
+  ASSERT_OK(decompressor.WaitForBatch(&mem_pool_, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ(sizeof(input_), outputs[0].len);
+
+  // Close() waits for a batch in progress.
+  ASSERT_OK(decompressor.AddBlock(compressed, compressed_len));
+  decompressor.StartBatch();
+  decompressor.Close();
+}
 }
 
 int main(int argc, char **argv) {
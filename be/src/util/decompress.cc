@@ -17,6 +17,7 @@
 
 #include "util/decompress.h"
 
+#include <string.h>
 #include <strings.h>
 
 #include <sstream>
@@ -73,6 +74,29 @@ int64_t GzipDecompressor::MaxOutputLen(int64_t input_len, const uint8_t* input)
   return -1;
 }
 
+bool GzipDecompressor::IsBgzfHeader(const uint8_t* header) {
+  // The gzip magic, the deflate method and FLG.FEXTRA, followed by the extra field. The
+  // extra field must consist of a single 'BC' subfield with the 2 byte block size, as
+  // bgzip writes it. MTIME, XFL and OS (bytes 4-9) can have any value.
+  static const uint8_t BGZF_MAGIC[] = {31, 139, 8, 4};
+  static const uint8_t BGZF_EXTRA[] = {6, 0, 'B', 'C', 2, 0};
+  return memcmp(header, BGZF_MAGIC, sizeof(BGZF_MAGIC)) == 0
+      && memcmp(header + 10, BGZF_EXTRA, sizeof(BGZF_EXTRA)) == 0
+      && BgzfBlockSize(header) >= BGZF_HEADER_SIZE + 8;
+}
+
+int GzipDecompressor::BgzfBlockSize(const uint8_t* header) {
+  // BSIZE is the block size minus 1, little-endian.
+  return (header[16] | (header[17] << 8)) + 1;
+}
+
+int64_t GzipDecompressor::BgzfUncompressedSize(const uint8_t* block, int block_size) {
+  // The trailer is CRC32 followed by ISIZE, both little-endian.
+  const uint8_t* isize = block + block_size - 4;
+  return static_cast<int64_t>(isize[0]) | (static_cast<int64_t>(isize[1]) << 8)
+      | (static_cast<int64_t>(isize[2]) << 16) | (static_cast<int64_t>(isize[3]) << 24);
+}
+
 string GzipDecompressor::DebugStreamState() const {
   stringstream ss;
   ss << "next_in=" << (void*)stream_.next_in;
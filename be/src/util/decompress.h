@@ -53,6 +53,29 @@ class GzipDecompressor : public Codec {
 
   virtual std::string file_extension() const override { return "gz"; }
 
+  /// BGZF, as written by bgzip, is gzip made of independent members, called blocks, of
+  /// at most 64KB each. The header of a block holds the size of the block in a 'BC' extra
+  /// subfield, so the start of a block can be found from any offset of a file by looking
+  /// for a block header. This makes BGZF files splittable. A block can be decompressed
+  /// with ProcessBlock() into a buffer of its uncompressed size.
+
+  /// Size of the header of a BGZF block.
+  static const int BGZF_HEADER_SIZE = 18;
+
+  /// Maximum compressed and uncompressed size of a BGZF block.
+  static const int BGZF_MAX_BLOCK_SIZE = 64 * 1024;
+
+  /// Returns true if the BGZF_HEADER_SIZE bytes at 'header' are the header of a BGZF
+  /// block.
+  static bool IsBgzfHeader(const uint8_t* header);
+
+  /// Returns the size of the BGZF block with 'header', including its header and trailer.
+  static int BgzfBlockSize(const uint8_t* header);
+
+  /// Returns the uncompressed size of the BGZF block [block, block + block_size), which
+  /// is stored in its trailer.
+  static int64_t BgzfUncompressedSize(const uint8_t* block, int block_size);
+
  private:
   std::string DebugStreamState() const;
 
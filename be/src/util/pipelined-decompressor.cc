@@ -0,0 +1,226 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/pipelined-decompressor.h"
+
+#include <string.h>
+
+#include "gen-cpp/ErrorCodes_types.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/io/request-ranges.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "util/codec.h"
+#include "util/thread.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using namespace impala::io;
+using strings::Substitute;
+
+PipelinedDecompressor::PipelinedDecompressor(MemTracker* mem_tracker,
+    THdfsCompression::type format, const string& filename)
+  : mem_tracker_(mem_tracker),
+    format_(format),
+    filename_(filename) {
+}
+
+PipelinedDecompressor::~PipelinedDecompressor() {
+  DCHECK(thread_ == nullptr) << "Must call Close()";
+}
+
+Status PipelinedDecompressor::Open(const string& category, const string& name) {
+  decompressor_pool_.reset(new MemPool(mem_tracker_));
+  // Output buffers are queued, so the decompressor must not reuse them.
+  RETURN_IF_ERROR(Codec::CreateDecompressor(
+      decompressor_pool_.get(), false, format_, &decompressor_));
+  DCHECK(decompressor_->supports_streaming());
+  return Thread::Create(category, name, [this]() { DecompressThread(); }, &thread_);
+}
+
+bool PipelinedDecompressor::NeedsInput() {
+  lock_guard<mutex> l(lock_);
+  return !input_done_ && inputs_.size() < MAX_QUEUED_INPUTS;
+}
+
+Status PipelinedDecompressor::AddInput(const uint8_t* data, int64_t len, bool eos) {
+  Buffer input;
+  input.pool.reset(new MemPool(mem_tracker_));
+  if (len > 0) {
+    input.data = input.pool->TryAllocate(len);
+    if (UNLIKELY(input.data == nullptr)) {
+      string details = Substitute(
+          "PipelinedDecompressor failed to allocate $0 bytes for input.", len);
+      return mem_tracker_->MemLimitExceeded(nullptr, details, len);
+    }
+    memcpy(input.data, data, len);
+  }
+  input.len = len;
+  input.eos = eos;
+  EnqueueInput(move(input));
+  return Status::OK();
+}
+
+void PipelinedDecompressor::AddInput(unique_ptr<BufferDescriptor> io_buffer,
+    const uint8_t* data, int64_t len, bool eos) {
+  DCHECK(io_buffer != nullptr);
+  DCHECK(data >= io_buffer->buffer());
+  DCHECK_LE(data + len, io_buffer->buffer() + io_buffer->len());
+  Buffer input;
+  input.io_buffer = move(io_buffer);
+  input.data = const_cast<uint8_t*>(data);
+  input.len = len;
+  input.eos = eos;
+  EnqueueInput(move(input));
+}
+
+void PipelinedDecompressor::EnqueueInput(Buffer input) {
+  {
+    lock_guard<mutex> l(lock_);
+    DCHECK(!input_done_);
+    DCHECK_LT(inputs_.size(), MAX_QUEUED_INPUTS);
+    input_done_ = input.eos;
+    inputs_.push_back(move(input));
+  }
+  input_cv_.NotifyOne();
+}
+
+void PipelinedDecompressor::FreeBuffer(Buffer* buffer) {
+  if (buffer->pool != nullptr) buffer->pool->FreeAll();
+  if (buffer->io_buffer != nullptr) {
+    ScanRange* range = buffer->io_buffer->scan_range();
+    range->ReturnBuffer(move(buffer->io_buffer));
+  }
+  buffer->data = nullptr;
+}
+
+Status PipelinedDecompressor::GetOutput(
+    MemPool* pool, uint8_t** buffer, int64_t* len, bool* eos) {
+  *buffer = nullptr;
+  *len = 0;
+  *eos = false;
+  Buffer output;
+  {
+    unique_lock<mutex> l(lock_);
+    // Wait until there is output or the decompression thread cannot produce more without
+    // more input.
+    while (outputs_.empty() && !output_done_ && (decompressing_ || !inputs_.empty())) {
+      output_cv_.Wait(l);
+    }
+    if (outputs_.empty()) {
+      RETURN_IF_ERROR(status_);
+      *eos = output_done_;
+      return Status::OK();
+    }
+    output = move(outputs_.front());
+    outputs_.pop_front();
+    *eos = outputs_.empty() && output_done_ && status_.ok();
+  }
+  // Wake up the decompression thread if it waits for space in 'outputs_'.
+  output_cv_.NotifyAll();
+  pool->AcquireData(output.pool.get(), false);
+  *buffer = output.data;
+  *len = output.len;
+  return Status::OK();
+}
+
+void PipelinedDecompressor::Close() {
+  {
+    lock_guard<mutex> l(lock_);
+    closed_ = true;
+  }
+  input_cv_.NotifyAll();
+  output_cv_.NotifyAll();
+  if (thread_ != nullptr) {
+    thread_->Join();
+    thread_.reset();
+  }
+  for (Buffer& input : inputs_) FreeBuffer(&input);
+  inputs_.clear();
+  for (Buffer& output : outputs_) FreeBuffer(&output);
+  outputs_.clear();
+  if (decompressor_ != nullptr) {
+    decompressor_->Close();
+    decompressor_.reset();
+  }
+  if (decompressor_pool_ != nullptr) decompressor_pool_->FreeAll();
+}
+
+void PipelinedDecompressor::DecompressThread() {
+  while (true) {
+    Buffer input;
+    {
+      unique_lock<mutex> l(lock_);
+      while (inputs_.empty() && !closed_) input_cv_.Wait(l);
+      if (closed_) return;
+      input = move(inputs_.front());
+      inputs_.pop_front();
+      decompressing_ = true;
+    }
+    bool closed = false;
+    Status status = DecompressInput(input, &closed);
+    FreeBuffer(&input);
+    {
+      lock_guard<mutex> l(lock_);
+      decompressing_ = false;
+      if (!status.ok()) status_ = status;
+      output_done_ = !status.ok() || input.eos;
+    }
+    output_cv_.NotifyAll();
+    if (closed || !status.ok() || input.eos) return;
+  }
+}
+
+Status PipelinedDecompressor::DecompressInput(const Buffer& input, bool* closed) {
+  int64_t offset = 0;
+  while (offset < input.len) {
+    int64_t bytes_read = 0;
+    int64_t output_len = 0;
+    uint8_t* output = nullptr;
+    RETURN_IF_ERROR(decompressor_->ProcessBlockStreaming(input.len - offset,
+        input.data + offset, &bytes_read, &output_len, &output, &stream_end_));
+    offset += bytes_read;
+    Buffer buffer;
+    buffer.pool.reset(new MemPool(mem_tracker_));
+    buffer.pool->AcquireData(decompressor_pool_.get(), false);
+    if (output_len == 0) {
+      buffer.pool->FreeAll();
+      if (bytes_read == 0) {
+        return Status(TErrorCode::COMPRESSED_FILE_DECOMPRESSOR_NO_PROGRESS, filename_);
+      }
+      continue;
+    }
+    buffer.data = output;
+    buffer.len = output_len;
+    {
+      unique_lock<mutex> l(lock_);
+      while (outputs_.size() >= MAX_QUEUED_OUTPUTS && !closed_) output_cv_.Wait(l);
+      if (closed_) {
+        buffer.pool->FreeAll();
+        *closed = true;
+        return Status::OK();
+      }
+      outputs_.push_back(move(buffer));
+    }
+    output_cv_.NotifyAll();
+  }
+  if (input.eos && !stream_end_) {
+    return Status(TErrorCode::COMPRESSED_FILE_TRUNCATED, filename_);
+  }
+  return Status::OK();
+}
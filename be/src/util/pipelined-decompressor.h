@@ -0,0 +1,175 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "common/status.h"
+#include "gen-cpp/CatalogObjects_types.h"
+#include "util/condition-variable.h"
+
+namespace impala {
+
+class Codec;
+class MemPool;
+class MemTracker;
+class Thread;
+
+namespace io {
+class BufferDescriptor;
+}
+
+/// Runs a streaming decompressor in a thread of its own, so that the decompression of a
+/// single compressed stream, e.g. of a gzip-compressed text file that cannot be split,
+/// overlaps with the processing of its output in the caller's thread.
+///
+/// The caller hands the compressed stream to the decompression thread in chunks with
+/// AddInput() and gets the decompressed data back with GetOutput(). At most
+/// MAX_QUEUED_INPUTS chunks of input and MAX_QUEUED_OUTPUTS buffers of output are queued
+/// at a time, which bounds the memory used, besides the buffers that were already
+/// returned. Input is either copied, so that the caller can release its buffers right
+/// away, or handed off as an I/O buffer, which is returned to its scan range once it was
+/// decompressed or Close() is called.
+///
+/// All methods but the constructor and Close() must be called between Open() and
+/// Close(), from the same thread. Close() must be called if Open() was called.
+class PipelinedDecompressor {
+ public:
+  /// 'format' must be a codec that supports streaming. Memory is tracked against
+  /// 'mem_tracker'. 'filename' is used in error messages.
+  PipelinedDecompressor(MemTracker* mem_tracker, THdfsCompression::type format,
+      const std::string& filename);
+  ~PipelinedDecompressor();
+
+  /// Creates the decompressor and starts the decompression thread with 'category' and
+  /// 'name'.
+  Status Open(const std::string& category, const std::string& name) WARN_UNUSED_RESULT;
+
+  /// Returns true if the decompression thread should be given more input, i.e. if the
+  /// last input was not added yet and fewer than MAX_QUEUED_INPUTS chunks are queued.
+  bool NeedsInput();
+
+  /// Copies the compressed data [data, data + len) to the end of the input queue.
+  /// 'eos' must be true for the last chunk of input. Must only be called if NeedsInput()
+  /// returns true.
+  Status AddInput(const uint8_t* data, int64_t len, bool eos) WARN_UNUSED_RESULT;
+
+  /// Like the above, but takes the ownership of 'io_buffer', which holds the compressed
+  /// data [data, data + len), instead of copying the data. 'io_buffer' is returned to
+  /// its scan range from the decompression thread or from Close(), so the scan range
+  /// must have enough buffers to make progress without the ones that are queued here.
+  void AddInput(std::unique_ptr<io::BufferDescriptor> io_buffer, const uint8_t* data,
+      int64_t len, bool eos);
+
+  /// Waits for the next buffer of decompressed data and returns it in 'buffer' and
+  /// 'len'. The memory of the buffer is transferred to 'pool'. Returns with 'len' set to
+  /// 0 if no output can be produced before more input is added. Sets 'eos' to true once
+  /// all of the output of the last input has been returned. Returns the error of the
+  /// decompression thread if decompression failed.
+  Status GetOutput(MemPool* pool, uint8_t** buffer, int64_t* len, bool* eos)
+      WARN_UNUSED_RESULT;
+
+  /// Stops the decompression thread, waits for it to exit and frees the memory that was
+  /// not returned by GetOutput().
+  void Close();
+
+  /// Maximum number of chunks of input and buffers of output in the queues.
+  static const int MAX_QUEUED_INPUTS = 2;
+  static const int MAX_QUEUED_OUTPUTS = 2;
+
+ private:
+  /// A chunk of compressed input or a buffer of decompressed output, with the MemPool
+  /// or, for input that was handed off, the I/O buffer that owns its memory.
+  struct Buffer {
+    std::unique_ptr<MemPool> pool;
+    std::unique_ptr<io::BufferDescriptor> io_buffer;
+    uint8_t* data = nullptr;
+    int64_t len = 0;
+    bool eos = false;
+  };
+
+  /// Main function of the decompression thread. Decompresses the input chunks in the
+  /// order in which they were added until Close() is called, the last chunk was
+  /// decompressed or an error occurred, which is stored in 'status_'.
+  void DecompressThread();
+
+  /// Adds 'input' to the end of the input queue.
+  void EnqueueInput(Buffer input);
+
+  /// Frees the memory of 'buffer' or returns its I/O buffer to its scan range.
+  static void FreeBuffer(Buffer* buffer);
+
+  /// Decompresses 'input' and adds the output to 'outputs_'. Sets 'closed' to true if
+  /// Close() was called while waiting for space in 'outputs_'.
+  Status DecompressInput(const Buffer& input, bool* closed) WARN_UNUSED_RESULT;
+
+  MemTracker* const mem_tracker_;
+  const THdfsCompression::type format_;
+  const std::string filename_;
+
+  /// The streaming decompressor, only used by the decompression thread. It allocates its
+  /// output buffers from 'decompressor_pool_', whose memory is transferred to the output
+  /// buffers in 'outputs_'.
+  boost::scoped_ptr<MemPool> decompressor_pool_;
+  boost::scoped_ptr<Codec> decompressor_;
+
+  /// True if the last call to the decompressor ended at the end of a compressed stream.
+  /// Only used by the decompression thread.
+  bool stream_end_ = false;
+
+  std::unique_ptr<Thread> thread_;
+
+  /// Protects all of the members below.
+  std::mutex lock_;
+
+  /// Signalled when input is added or Close() is called.
+  ConditionVariable input_cv_;
+
+  /// Signalled when output is added, the decompression thread runs out of input or
+  /// exits, or when output is removed.
+  ConditionVariable output_cv_;
+
+  /// Input chunks that were not decompressed yet.
+  std::deque<Buffer> inputs_;
+
+  /// Output buffers that were not returned by GetOutput() yet.
+  std::deque<Buffer> outputs_;
+
+  /// True once the last input chunk was added.
+  bool input_done_ = false;
+
+  /// True while the decompression thread decompresses an input chunk.
+  bool decompressing_ = false;
+
+  /// True once the decompression thread added the output of the last input chunk or
+  /// exited because of an error.
+  bool output_done_ = false;
+
+  /// True once Close() was called.
+  bool closed_ = false;
+
+  /// The first error of the decompression thread.
+  Status status_;
+};
+
+}
@@ -32,14 +32,14 @@ ProgressUpdater::ProgressUpdater() :
 void ProgressUpdater::Init(const string& label, int64_t total, int update_period) {
   DCHECK_GE(total, 0);
   label_ = label;
-  total_ = total;
+  total_.Store(total);
   update_period_ = update_period;
   DCHECK_EQ(num_complete_.Load(), 0) << "Update() should not have been called yet";
   DCHECK_EQ(last_output_percentage_.Load(), 0);
 }
 
 void ProgressUpdater::Update(int64_t delta) {
-  DCHECK_GE(total_, 0) << "Init() should have been called already";
+  DCHECK_GE(total_.Load(), 0) << "Init() should have been called already";
   DCHECK_GE(delta, 0);
   if (delta == 0) return;
 
@@ -49,34 +49,42 @@ void ProgressUpdater::Update(int64_t delta) {
   // update is out of order (e.g. prints 1 out of 10 after 2 out of 10)
   double old_percentage = last_output_percentage_.Load();
   int64_t num_complete = num_complete_.Load();
+  int64_t total = total_.Load();
 
-  if (num_complete >= total_) {
+  if (num_complete >= total) {
     // Always print the final 100% complete
     VLOG(logging_level_) << label_ << " 100% Complete ("
-                         << num_complete << " out of " << total_ << ")";
+                         << num_complete << " out of " << total << ")";
     return;
   }
 
   // Convert to percentage as int
-  int new_percentage = (static_cast<double>(num_complete) / total_) * 100;
+  int new_percentage = (static_cast<double>(num_complete) / total) * 100;
   if (new_percentage - old_percentage > update_period_) {
     // Only update shared variable if this guy was the latest.
     last_output_percentage_.CompareAndSwap(old_percentage, new_percentage);
     VLOG(logging_level_) << label_ << ": " << new_percentage << "% Complete ("
-                         << num_complete << " out of " << total_ << ")";
+                         << num_complete << " out of " << total << ")";
   }
 }
 
+void ProgressUpdater::AddTotal(int64_t delta) {
+  DCHECK_GE(total_.Load(), 0) << "Init() should have been called already";
+  DCHECK_GE(delta, 0);
+  total_.Add(delta);
+}
+
 string ProgressUpdater::ToString() const {
   stringstream ss;
   int64_t num_complete = num_complete_.Load();
-  if (num_complete >= total_) {
+  int64_t total = total_.Load();
+  if (num_complete >= total) {
     // Always print the final 100% complete
-    ss << label_ << " 100% Complete (" << num_complete << " out of " << total_ << ")";
+    ss << label_ << " 100% Complete (" << num_complete << " out of " << total << ")";
     return ss.str();
   }
-  int percentage = (static_cast<double>(num_complete) / total_) * 100;
+  int percentage = (static_cast<double>(num_complete) / total) * 100;
   ss << label_ << ": " << percentage << "% Complete ("
-     << num_complete << " out of " << total_ << ")";
+     << num_complete << " out of " << total << ")";
   return ss.str();
 }
@@ -52,10 +52,14 @@ class ProgressUpdater {
   /// VLOG_PROGRESS. Init() must be called before Update().
   void Update(int64_t delta);
 
+  /// 'delta' more work items were discovered after Init(), e.g. because a work item was
+  /// split into several.
+  void AddTotal(int64_t delta);
+
   /// Returns true if all tasks are done.
-  bool done() const { return num_complete() >= total_; }
+  bool done() const { return num_complete() >= total(); }
 
-  int64_t total() const { return total_; }
+  int64_t total() const { return total_.Load(); }
   int64_t num_complete() const { return num_complete_.Load(); }
   int64_t remaining() const { return total() - num_complete(); }
 
@@ -70,7 +74,7 @@ class ProgressUpdater {
   int logging_level_;
 
   /// Total number of work items. -1 before Init().
-  int64_t total_;
+  AtomicInt64 total_;
 
   /// Number of percentage points between outputs.
   int update_period_;
@@ -350,6 +350,77 @@ TEST(CountersTest, MergeAndUpdateChildOrder) {
   deserialized_profile->PrettyPrint(&dummy);
 }
 
+// Test that profiles stripped of unchanged values update a profile in the same way as
+// the full profiles.
+TEST(CountersTest, RemoveUnchangedFromThrift) {
+  ObjectPool pool;
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "Parent");
+  RuntimeProfile* child = RuntimeProfile::Create(&pool, "Child");
+  profile->AddChild(child);
+  RuntimeProfile::Counter* parent_counter = profile->AddCounter("A", TUnit::UNIT);
+  RuntimeProfile::Counter* child_counter1 = child->AddCounter("B", TUnit::UNIT);
+  RuntimeProfile::Counter* child_counter2 = child->AddCounter("C", TUnit::UNIT);
+  parent_counter->Set(1);
+  child_counter1->Set(2);
+  child_counter2->Set(3);
+  profile->AddInfoString("Key1", "Value1");
+  profile->AddInfoString("Key2", "Value2");
+
+  TRuntimeProfileTree baseline;
+  profile->ToThrift(&baseline);
+  RuntimeProfile* updated_profile = RuntimeProfile::Create(&pool, "Parent");
+  updated_profile->Update(baseline);
+
+  // Nothing changed.
+  TRuntimeProfileTree delta;
+  profile->ToThrift(&delta);
+  RuntimeProfile::RemoveUnchangedFromThrift(baseline, &delta);
+  ASSERT_EQ(delta.nodes.size(), 2);
+  EXPECT_TRUE(delta.nodes[0].counters.empty());
+  EXPECT_TRUE(delta.nodes[1].counters.empty());
+  EXPECT_TRUE(delta.nodes[0].info_strings.empty());
+  EXPECT_TRUE(delta.nodes[0].info_strings_display_order.empty());
+  EXPECT_EQ(delta.nodes[0].num_children, 1);
+  EXPECT_EQ(delta.nodes[1].name, "Child");
+
+  // Change one counter and one info string and add a new child.
+  child_counter2->Set(4);
+  profile->AddInfoString("Key2", "NewValue2");
+  RuntimeProfile* child2 = RuntimeProfile::Create(&pool, "Child2");
+  profile->AddChild(child2);
+  child2->AddCounter("D", TUnit::UNIT)->Set(5);
+  profile->ToThrift(&delta);
+  RuntimeProfile::RemoveUnchangedFromThrift(baseline, &delta);
+  ASSERT_EQ(delta.nodes.size(), 3);
+  EXPECT_EQ(delta.nodes[0].info_strings.size(), 1);
+  EXPECT_EQ(delta.nodes[0].info_strings_display_order.size(), 1);
+  EXPECT_EQ(delta.nodes[0].info_strings["Key2"], "NewValue2");
+  ASSERT_EQ(delta.nodes[1].counters.size(), 1);
+  EXPECT_EQ(delta.nodes[1].counters[0].name, "C");
+  EXPECT_EQ(delta.nodes[2].name, "Child2");
+  EXPECT_EQ(delta.nodes[2].counters.size(), child2->num_counters());
+
+  updated_profile->Update(delta);
+  EXPECT_EQ(updated_profile->GetCounter("A")->value(), 1);
+  EXPECT_EQ(*updated_profile->GetInfoString("Key1"), "Value1");
+  EXPECT_EQ(*updated_profile->GetInfoString("Key2"), "NewValue2");
+  vector<RuntimeProfileBase*> children;
+  updated_profile->GetChildren(&children);
+  ASSERT_EQ(children.size(), 2);
+  EXPECT_EQ(children[0]->name(), "Child");
+  EXPECT_EQ(children[0]->GetCounter("B")->value(), 2);
+  EXPECT_EQ(children[0]->GetCounter("C")->value(), 4);
+  EXPECT_EQ(children[1]->name(), "Child2");
+  EXPECT_EQ(children[1]->GetCounter("D")->value(), 5);
+
+  // Profiles with a different root are left unchanged.
+  RuntimeProfile* other = RuntimeProfile::Create(&pool, "Other");
+  TRuntimeProfileTree other_tree;
+  other->ToThrift(&other_tree);
+  RuntimeProfile::RemoveUnchangedFromThrift(baseline, &other_tree);
+  EXPECT_EQ(other_tree.nodes[0].counters.size(), other->num_counters());
+}
+
 TEST(CountersTest, TotalTimeCounters) {
   ObjectPool pool;
 
@@ -861,6 +861,122 @@ void RuntimeProfile::Update(const vector<TRuntimeProfileNode>& nodes, int* idx)
   }
 }
 
+/// Returns the index of the node following the subtree rooted at 'nodes[idx]'.
+static int SkipThriftSubtree(const vector<TRuntimeProfileNode>& nodes, int idx) {
+  int num_children = nodes[idx].num_children;
+  ++idx;
+  for (int i = 0; i < num_children; ++i) idx = SkipThriftSubtree(nodes, idx);
+  return idx;
+}
+
+/// Removes everything from 'node' that has the same value in 'base'.
+static void RemoveUnchangedFromThriftNode(
+    const TRuntimeProfileNode& base, TRuntimeProfileNode* node) {
+  unordered_map<string, int64_t> base_counters;
+  for (const TCounter& counter : base.counters) {
+    base_counters.emplace(counter.name, counter.value);
+  }
+  auto counters_end = remove_if(node->counters.begin(), node->counters.end(),
+      [&base_counters](const TCounter& counter) {
+        auto it = base_counters.find(counter.name);
+        return it != base_counters.end() && it->second == counter.value;
+      });
+  node->counters.erase(counters_end, node->counters.end());
+
+  vector<string> display_order;
+  for (string& key : node->info_strings_display_order) {
+    auto base_it = base.info_strings.find(key);
+    auto it = node->info_strings.find(key);
+    if (base_it != base.info_strings.end() && it != node->info_strings.end()
+        && base_it->second == it->second) {
+      node->info_strings.erase(it);
+    } else {
+      display_order.push_back(move(key));
+    }
+  }
+  node->info_strings_display_order = move(display_order);
+
+  if (node->child_counters_map == base.child_counters_map) {
+    node->child_counters_map.clear();
+  }
+
+  if (node->__isset.summary_stats_counters && base.__isset.summary_stats_counters) {
+    unordered_map<string, const TSummaryStatsCounter*> base_stats;
+    for (const TSummaryStatsCounter& counter : base.summary_stats_counters) {
+      base_stats.emplace(counter.name, &counter);
+    }
+    vector<TSummaryStatsCounter>& stats = node->summary_stats_counters;
+    auto stats_end = remove_if(stats.begin(), stats.end(),
+        [&base_stats](const TSummaryStatsCounter& counter) {
+          auto it = base_stats.find(counter.name);
+          return it != base_stats.end() && *it->second == counter;
+        });
+    stats.erase(stats_end, stats.end());
+  }
+}
+
+/// Removes unchanged values from the subtree rooted at '(*nodes)[*idx]', which
+/// corresponds to the subtree rooted at 'base_nodes[base_idx]'. Children are matched up
+/// by name. Advances '*idx' past the subtree.
+static void RemoveUnchangedFromThriftSubtree(
+    const vector<TRuntimeProfileNode>& base_nodes, int base_idx,
+    vector<TRuntimeProfileNode>* nodes, int* idx) {
+  const TRuntimeProfileNode& base = base_nodes[base_idx];
+  RemoveUnchangedFromThriftNode(base, &(*nodes)[*idx]);
+  unordered_map<string, int> base_children;
+  int base_child_idx = base_idx + 1;
+  for (int i = 0; i < base.num_children; ++i) {
+    base_children.emplace(base_nodes[base_child_idx].name, base_child_idx);
+    base_child_idx = SkipThriftSubtree(base_nodes, base_child_idx);
+  }
+  int num_children = (*nodes)[*idx].num_children;
+  ++*idx;
+  for (int i = 0; i < num_children; ++i) {
+    auto it = base_children.find((*nodes)[*idx].name);
+    if (it == base_children.end()) {
+      *idx = SkipThriftSubtree(*nodes, *idx);
+    } else {
+      RemoveUnchangedFromThriftSubtree(base_nodes, it->second, nodes, idx);
+    }
+  }
+}
+
+void RuntimeProfile::RemoveUnchangedFromThrift(
+    const TRuntimeProfileTree& baseline, TRuntimeProfileTree* profile) {
+  if (baseline.nodes.empty() || profile->nodes.empty()) return;
+  if (baseline.nodes[0].name != profile->nodes[0].name) return;
+  if (baseline.nodes[0].__isset.aggregated || profile->nodes[0].__isset.aggregated) {
+    return;
+  }
+  int idx = 0;
+  RemoveUnchangedFromThriftSubtree(baseline.nodes, 0, &profile->nodes, &idx);
+  DCHECK_EQ(idx, profile->nodes.size());
+}
+
+int64_t RuntimeProfile::EstimateThriftSize(const TRuntimeProfileTree& profile) {
+  int64_t size = sizeof(profile);
+  for (const TRuntimeProfileNode& node : profile.nodes) {
+    size += sizeof(node) + node.name.size();
+    for (const TCounter& counter : node.counters) {
+      size += sizeof(counter) + counter.name.size();
+    }
+    for (const auto& entry : node.info_strings) {
+      size += 2 * sizeof(string) + entry.first.size() + entry.second.size();
+    }
+    for (const string& key : node.info_strings_display_order) {
+      size += sizeof(key) + key.size();
+    }
+    for (const auto& entry : node.child_counters_map) {
+      size += sizeof(string) + entry.first.size();
+      for (const string& child : entry.second) size += sizeof(child) + child.size();
+    }
+    for (const TSummaryStatsCounter& counter : node.summary_stats_counters) {
+      size += sizeof(counter) + counter.name.size();
+    }
+  }
+  return size;
+}
+
 void RuntimeProfileBase::ComputeTimeInProfile() {
   // Recurse on children. After this, childrens' total time is up to date.
   int64_t children_total_time = 0;
@@ -481,6 +481,18 @@ class RuntimeProfile : public RuntimeProfileBase {
   /// the key has already been registered.
   void Update(const TRuntimeProfileTree& thrift_profile);
 
+  /// Removes the counters, info strings, summary stats counters and child counter maps
+  /// from 'profile' that are unchanged in 'baseline', an earlier serialization of the
+  /// same profile. Updating a profile that was already updated with 'baseline' with the
+  /// result has the same effect as updating it with the full 'profile'. Event sequences
+  /// and time series counters are kept. Aggregated profiles are left unchanged.
+  static void RemoveUnchangedFromThrift(
+      const TRuntimeProfileTree& baseline, TRuntimeProfileTree* profile);
+
+  /// Returns an estimate of the number of bytes of memory used by 'profile', not
+  /// counting its event sequences and time series counters.
+  static int64_t EstimateThriftSize(const TRuntimeProfileTree& profile);
+
   /// Add a counter with 'name'/'unit'.  Returns a counter object that the caller can
   /// update.  The counter is owned by the RuntimeProfile object.
   /// If parent_counter_name is a non-empty string, the counter is added as a child of
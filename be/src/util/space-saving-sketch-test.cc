@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <random>
+
+#include "testutil/gtest-util.h"
+#include "util/space-saving-sketch.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+/// Keys that fit into the sketch are counted exactly.
+TEST(SpaceSavingSketch, Exact) {
+  SpaceSavingSketch sketch(8);
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j <= i; ++j) sketch.Update(i);
+  }
+  sketch.Update(7, 10);
+  EXPECT_EQ(sketch.total(), 36 + 10);
+  vector<SpaceSavingSketch::Entry> heavy_hitters = sketch.GetHeavyHitters(0.1);
+  ASSERT_EQ(heavy_hitters.size(), 2);
+  EXPECT_EQ(heavy_hitters[0].key, 7);
+  EXPECT_EQ(heavy_hitters[0].count, 18);
+  EXPECT_EQ(heavy_hitters[0].error, 0);
+  EXPECT_EQ(heavy_hitters[1].key, 6);
+  EXPECT_EQ(heavy_hitters[1].count, 7);
+  sketch.Clear();
+  EXPECT_EQ(sketch.total(), 0);
+  EXPECT_TRUE(sketch.GetHeavyHitters(0).empty());
+}
+
+/// A few hot keys hidden in many more distinct cold keys than the sketch can hold are
+/// found, their counts are bounded correctly and no cold key is reported.
+TEST(SpaceSavingSketch, HeavyHitters) {
+  const int NUM_ROWS = 100000;
+  SpaceSavingSketch sketch(32);
+  mt19937 rng(1234);
+  uniform_int_distribution<uint64_t> cold_keys(1000, 1000000);
+  uniform_real_distribution<double> coin(0, 1);
+  int64_t num_hot1 = 0;
+  int64_t num_hot2 = 0;
+  for (int i = 0; i < NUM_ROWS; ++i) {
+    double p = coin(rng);
+    if (p < 0.3) {
+      sketch.Update(1);
+      ++num_hot1;
+    } else if (p < 0.4) {
+      sketch.Update(2);
+      ++num_hot2;
+    } else {
+      sketch.Update(cold_keys(rng));
+    }
+  }
+  vector<SpaceSavingSketch::Entry> heavy_hitters = sketch.GetHeavyHitters(0.05);
+  ASSERT_EQ(heavy_hitters.size(), 2);
+  EXPECT_EQ(heavy_hitters[0].key, 1);
+  EXPECT_GE(heavy_hitters[0].count, num_hot1);
+  EXPECT_LE(heavy_hitters[0].count - heavy_hitters[0].error, num_hot1);
+  EXPECT_EQ(heavy_hitters[1].key, 2);
+  EXPECT_GE(heavy_hitters[1].count, num_hot2);
+  EXPECT_LE(heavy_hitters[1].count - heavy_hitters[1].error, num_hot2);
+  // The error of any key is bounded by total() / capacity.
+  for (const SpaceSavingSketch::Entry& entry : sketch.GetHeavyHitters(0)) {
+    EXPECT_LE(entry.error, NUM_ROWS / 32);
+  }
+}
+
+}
@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_SPACE_SAVING_SKETCH_H
+#define IMPALA_UTIL_SPACE_SAVING_SKETCH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "common/logging.h"
+
+namespace impala {
+
+/// Space-Saving sketch (Metwally et al., "Efficient Computation of Frequent and Top-k
+/// Elements in Data Streams") that finds the heavy hitters of a stream of 64-bit keys,
+/// typically hash values, with a fixed number of counters.
+///
+/// Each monitored key has a count that overestimates its true frequency by at most its
+/// 'error'. When a key that is not monitored arrives and all counters are in use, it
+/// replaces the key with the smallest count and inherits that count as its error. Every
+/// key whose frequency is more than total() / capacity is guaranteed to be monitored.
+///
+/// Counters are searched linearly, so the capacity should be small (tens of keys) and
+/// callers on hot paths should only feed a sample of their keys. Not thread-safe.
+class SpaceSavingSketch {
+ public:
+  struct Entry {
+    uint64_t key;
+    /// Upper bound of the frequency of 'key'.
+    int64_t count;
+    /// Maximum overestimation of 'count'. The frequency is at least 'count - error'.
+    int64_t error;
+  };
+
+  explicit SpaceSavingSketch(int capacity) : capacity_(capacity) {
+    DCHECK_GT(capacity, 0);
+    entries_.reserve(capacity);
+  }
+
+  /// Adds 'weight' occurrences of 'key'.
+  void Update(uint64_t key, int64_t weight = 1) {
+    DCHECK_GT(weight, 0);
+    total_ += weight;
+    int min_idx = 0;
+    for (int i = 0; i < entries_.size(); ++i) {
+      if (entries_[i].key == key) {
+        entries_[i].count += weight;
+        return;
+      }
+      if (entries_[i].count < entries_[min_idx].count) min_idx = i;
+    }
+    if (entries_.size() < capacity_) {
+      entries_.push_back({key, weight, 0});
+      return;
+    }
+    Entry* victim = &entries_[min_idx];
+    victim->error = victim->count;
+    victim->key = key;
+    victim->count += weight;
+  }
+
+  /// Returns the keys whose frequency is guaranteed to be at least 'min_fraction' of
+  /// total(), ordered by decreasing count.
+  std::vector<Entry> GetHeavyHitters(double min_fraction) const {
+    std::vector<Entry> result;
+    for (const Entry& entry : entries_) {
+      if (entry.count - entry.error >= min_fraction * total_) result.push_back(entry);
+    }
+    std::sort(result.begin(), result.end(),
+        [](const Entry& a, const Entry& b) { return a.count > b.count; });
+    return result;
+  }
+
+  /// Returns the sum of the weights of all keys added so far.
+  int64_t total() const { return total_; }
+
+  int capacity() const { return capacity_; }
+
+  void Clear() {
+    entries_.clear();
+    total_ = 0;
+  }
+
+ private:
+  const int capacity_;
+  int64_t total_ = 0;
+  std::vector<Entry> entries_;
+};
+
+} // namespace impala
+
+#endif // IMPALA_UTIL_SPACE_SAVING_SKETCH_H
@@ -52,10 +52,29 @@ struct TDebugOptions {
 }
 
 
+// Identifies the backend that aggregates a runtime filter on behalf of other backends
+// before sending the combined filter to the coordinator.
+struct TRuntimeFilterAggDesc {
+  // Hostname of the aggregator's KRPC service, used for authentication.
+  1: required string krpc_hostname
+
+  // IP address + port of the aggregator's KRPC service.
+  2: required Types.TNetworkAddress krpc_address
+}
+
 // Descriptor that indicates that a runtime filter is produced by a plan node.
 struct TRuntimeFilterSource {
   1: required Types.TPlanNodeId src_node_id
   2: required i32 filter_id
+
+  // If set, the backend sends its locally aggregated filter to this intermediate
+  // aggregator instead of directly to the coordinator.
+  3: optional TRuntimeFilterAggDesc aggregator
+
+  // If > 0, this backend is an intermediate aggregator for the filter. It combines its
+  // locally aggregated filter with this many updates from other backends and then sends
+  // a single update to the coordinator.
+  4: optional i32 num_remote_updates
 }
 
 // The Thrift portion of the execution parameters of a single fragment instance. Every
@@ -637,7 +637,8 @@ enum TImpalaQueryOptions {
   // predicates (via min/max filters) for equi-hash joins at the Parquet table scan
   // operator. Set to 0.0 to disable the feature. Set to 1.0 to evaluate all
   // overlap predicates. Set to a value between 0.0 and 1.0 to evaluate only those
-  // with an overlap ratio less than the threshold.
+  // with an overlap ratio less than the threshold. Any value above 0.0 also enables
+  // min/max filters on ORC table scans, see ORC_READ_STATISTICS.
   MINMAX_FILTER_THRESHOLD = 122
 
   // Minmax filtering level to be applied to Parquet scanners.
@@ -651,6 +652,23 @@ enum TImpalaQueryOptions {
 
   // If true, show the min and max stats during show column stats.
   SHOW_COLUMN_MINMAX_STATS = 125
+
+  // If >= 2, global runtime filters produced on more than this many backends are first
+  // combined by intermediate aggregator backends, each aggregating the filters of up to
+  // this many backends, so that the coordinator only receives one update per group.
+  // Completed filters are also published through a fan-out tree of this width rather
+  // than by the coordinator to every target backend. 0 or 1 disables the feature.
+  RUNTIME_FILTER_AGGREGATION_FANOUT = 126
+
+  // Indicates whether to read stripe statistics from ORC files and use them to skip
+  // stripes that cannot contain rows passing the runtime min/max filters of the scan.
+  // Min/max filters are only assigned to ORC scans if MINMAX_FILTER_THRESHOLD is above
+  // 0.0.
+  ORC_READ_STATISTICS = 127
+
+  // For testing: if true, grouping aggregations do not try to fit a spilled partition
+  // in memory or repartition it, but aggregate it in multiple passes right away.
+  AGGREGATE_SPILLED_PARTITIONS_IN_PASSES = 128
 }
 
 // The summary of a DML statement.
@@ -484,6 +484,15 @@ struct TQueryOptions {
 
   // See comment in ImpalaService.thrift
   126: optional bool show_column_minmax_stats = false;
+
+  // See comment in ImpalaService.thrift
+  127: optional i32 runtime_filter_aggregation_fanout = 0;
+
+  // See comment in ImpalaService.thrift
+  128: optional bool orc_read_statistics = true;
+
+  // See comment in ImpalaService.thrift
+  129: optional bool aggregate_spilled_partitions_in_passes = false;
 }
 
 // Impala currently has three types of sessions: Beeswax, HiveServer2 and external
@@ -471,6 +471,14 @@ error_codes = (
 
   ("LOCAL_DISK_FAULTY", 152,
    "Query execution failure caused by local disk IO fatal error on backend: $0."),
+
+  ("PARTITIONED_HASH_JOIN_SKEW_CHUNK_FAILS", 153, "Cannot perform hash join at node "
+   "with id $0. A chunk of $1 rows of a skewed spilled partition did not fit in "
+   "memory:\\n$2\\n$3"),
+
+  ("PARTITIONED_AGG_MULTI_PASS_FAILS", 154, "Cannot perform aggregation at node with "
+   "id $0. Failed to aggregate a skewed spilled partition at repartitioning level $1 "
+   "in multiple passes without spilling it:\\n$2"),
 )
 
 import sys
@@ -79,7 +79,12 @@ public enum HdfsFileFormat {
       "org.apache.hadoop.hive.ql.io.parquet.serde.ParquetHiveSerDe", true, true, true),
   ICEBERG("org.apache.iceberg.mr.hive.HiveIcebergInputFormat",
       "org.apache.iceberg.mr.hive.HiveIcebergOutputFormat",
-      "org.apache.iceberg.mr.hive.HiveIcebergSerDe", false, false, false);
+      "org.apache.iceberg.mr.hive.HiveIcebergSerDe", false, false, false),
+  // Newline-delimited JSON. Shares the input format class with TEXT and is told apart
+  // from it by the SerDe, see HdfsStorageDescriptor.fromStorageDescriptor().
+  JSON("org.apache.hadoop.mapred.TextInputFormat",
+      "org.apache.hadoop.hive.ql.io.HiveIgnoreKeyTextOutputFormat",
+      "org.apache.hive.hcatalog.data.JsonSerDe", false, false, true);
 
   private final String inputFormat_;
   private final String outputFormat_;
@@ -173,6 +178,7 @@ public enum HdfsFileFormat {
       case PARQUET: return HdfsFileFormat.PARQUET;
       case KUDU: return HdfsFileFormat.KUDU;
       case ICEBERG: return HdfsFileFormat.ICEBERG;
+      case JSON: return HdfsFileFormat.JSON;
       default:
         throw new RuntimeException("Unknown THdfsFileFormat: "
             + thriftFormat + " - should never happen!");
@@ -190,6 +196,7 @@ public enum HdfsFileFormat {
       case PARQUET: return THdfsFileFormat.PARQUET;
       case KUDU: return THdfsFileFormat.KUDU;
       case ICEBERG: return THdfsFileFormat.ICEBERG;
+      case JSON: return THdfsFileFormat.JSON;
       default:
         throw new RuntimeException("Unknown HdfsFormat: "
             + this + " - should never happen!");
@@ -215,6 +222,7 @@ public enum HdfsFileFormat {
       case KUDU: return "KUDU";
       case HUDI_PARQUET: return "HUDIPARQUET";
       case ICEBERG: return "ICEBERG";
+      case JSON: return "JSONFILE";
       default:
         throw new RuntimeException("Unknown HdfsFormat: "
             + this + " - should never happen!");
@@ -227,6 +235,7 @@ public enum HdfsFileFormat {
   public boolean isSplittable(HdfsCompression compression) {
     switch (this) {
       case TEXT:
+      case JSON:
         return compression == HdfsCompression.NONE;
       case RC_FILE:
       case SEQUENCE_FILE:
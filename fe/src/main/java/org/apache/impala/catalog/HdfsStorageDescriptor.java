@@ -72,7 +72,8 @@ public class HdfsStorageDescriptor {
       // TODO: Verify the following Parquet SerDe works with Impala and add
       // support for the new input/output format classes. See IMPALA-4214.
       "org.apache.hadoop.hive.ql.io.parquet.serde.ParquetHiveSerDe", // (parquet)
-      "org.apache.iceberg.mr.hive.HiveIcebergSerDe"); // (iceberg)
+      "org.apache.iceberg.mr.hive.HiveIcebergSerDe", // (iceberg)
+      "org.apache.hive.hcatalog.data.JsonSerDe"); // (json)
 
   private final static Logger LOG = LoggerFactory.getLogger(HdfsStorageDescriptor.class);
 
@@ -226,8 +227,13 @@ public class HdfsStorageDescriptor {
     }
 
     try {
-      return INTERNER.intern(new HdfsStorageDescriptor(tblName,
-          HdfsFileFormat.fromJavaClassName(sd.getInputFormat()),
+      HdfsFileFormat format = HdfsFileFormat.fromJavaClassName(sd.getInputFormat());
+      // JSON tables use the text input format with a JSON SerDe.
+      if (format == HdfsFileFormat.TEXT && HdfsFileFormat.JSON.serializationLib().equals(
+          sd.getSerdeInfo().getSerializationLib())) {
+        format = HdfsFileFormat.JSON;
+      }
+      return INTERNER.intern(new HdfsStorageDescriptor(tblName, format,
           delimMap.get(serdeConstants.LINE_DELIM),
           delimMap.get(serdeConstants.FIELD_DELIM),
           delimMap.get(serdeConstants.COLLECTION_DELIM),
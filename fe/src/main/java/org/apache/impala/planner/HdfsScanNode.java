@@ -188,6 +188,7 @@ public class HdfsScanNode extends ScanNode {
       ImmutableSet.<HdfsFileFormat>builder()
       .add(HdfsFileFormat.RC_FILE)
       .add(HdfsFileFormat.TEXT)
+      .add(HdfsFileFormat.JSON)
       .add(HdfsFileFormat.SEQUENCE_FILE)
       .add(HdfsFileFormat.AVRO)
       .build();
@@ -1434,7 +1435,7 @@ public class HdfsScanNode extends ScanNode {
     for (FeFsPartition p : partitions) {
       HdfsFileFormat format = p.getFileFormat();
       long estimatedPartitionSize = 0;
-      if (format == HdfsFileFormat.TEXT) {
+      if (format == HdfsFileFormat.TEXT || format == HdfsFileFormat.JSON) {
         for (FileDescriptor desc : p.getFileDescriptors()) {
           HdfsCompression compression
             = HdfsCompression.fromFileName(desc.getRelativePath().toString());
@@ -2144,6 +2145,13 @@ public class HdfsScanNode extends ScanNode {
 
   protected Set<HdfsFileFormat> getFileFormats() { return fileFormats_; }
 
+  /**
+   * Returns true if all the files scanned by this node are ORC files.
+   */
+  public boolean isAllOrc() {
+    return fileFormats_.equals(Collections.singleton(HdfsFileFormat.ORC));
+  }
+
   /**
    * Returns of all the values in the given {@link Map}.
    */
@@ -809,7 +809,9 @@ public final class RuntimeFilterGenerator {
    *    scan node.
    * 3. Only Hdfs and Kudu scan nodes are supported:
    *     a. If the target is an HdfsScanNode, the filter must be type BLOOM for non
-   *        Parquet tables, or type BLOOM and/or MIN_MAX for Parquet tables.
+   *        Parquet and non ORC tables, or type BLOOM and/or MIN_MAX for Parquet tables.
+   *        For ORC tables, MIN_MAX filters are allowed if the ORC_READ_STATISTICS
+   *        query option is set and the target is a slot ref on a column.
    *     b. If the target is a KuduScanNode, the filter could be type MIN_MAX, and/or
    *        BLOOM, the target must be a slot ref on a column, and the comp op cannot
    *        be 'not distinct'.
@@ -862,7 +864,17 @@ public final class RuntimeFilterGenerator {
           if (isBoundByPartitionColumns) {
             continue;
           }
-          if (!disable_overlap_filter) {
+          if (((HdfsScanNode) scanNode).isAllOrc()) {
+            // ORC scanners evaluate min/max filters against the stripe statistics of
+            // the target column, which requires the target to be the column itself.
+            if (disable_overlap_filter
+                || !ctx.getQueryOptions().isOrc_read_statistics()
+                || !(targetExpr instanceof SlotRef)
+                || ((SlotRef) targetExpr).getDesc().getColumn() == null
+                || filter.getExprCompOp() == Operator.NOT_DISTINCT) {
+              continue;
+            }
+          } else if (!disable_overlap_filter) {
             // If the filter is not defined on partition columns, try to compute
             // an overlap predicate for it. This predicate will be used to filter
             // out row groups or pages in Parquet data files.
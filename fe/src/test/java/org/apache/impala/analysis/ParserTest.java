@@ -2433,7 +2433,8 @@ public class ParserTest extends FrontendTestBase {
   public void TestAlterTableSet() {
     // Supported file formats
     String [] supportedFileFormats =
-        {"TEXTFILE", "SEQUENCEFILE", "PARQUET", "PARQUETFILE", "RCFILE", "AVRO"};
+        {"TEXTFILE", "SEQUENCEFILE", "PARQUET", "PARQUETFILE", "RCFILE", "AVRO",
+        "JSONFILE"};
     for (String format: supportedFileFormats) {
       ParsesOk("ALTER TABLE Foo SET FILEFORMAT " + format);
       ParsesOk("ALTER TABLE TestDb.Foo SET FILEFORMAT " + format);
@@ -2716,7 +2717,8 @@ public class ParserTest extends FrontendTestBase {
 
     // Supported file formats
     String [] supportedFileFormats =
-        {"TEXTFILE", "SEQUENCEFILE", "PARQUET", "PARQUETFILE", "RCFILE", "AVRO"};
+        {"TEXTFILE", "SEQUENCEFILE", "PARQUET", "PARQUETFILE", "RCFILE", "AVRO",
+        "JSONFILE"};
     for (String format: supportedFileFormats) {
       ParsesOk("CREATE TABLE Foo (i int, s string) STORED AS " + format);
       ParsesOk("CREATE EXTERNAL TABLE Foo (i int, s string) STORED AS " + format);
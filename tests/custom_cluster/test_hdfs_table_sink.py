@@ -0,0 +1,104 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+# Tests for the number of open partition writers of unclustered HDFS inserts.
+
+import pytest
+import re
+
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+
+# A single scanner thread returns the rows of each file of functional.alltypes, which
+# holds one month, before the rows of the next one.
+QUERY_OPTIONS = {'num_nodes': 1, 'mt_dop': 0, 'num_scanner_threads': 1}
+
+# The rows of each file cycle through the ten values of int_col.
+INSERT_UNCLUSTERED = """insert into {0}.int_parts partition (p) /* +noclustered */
+    select id, int_col from functional.alltypes"""
+
+# The rows of each partition come from a single file.
+INSERT_CLUSTERED = """insert into {0}.month_parts partition (year, month)
+    /* +noclustered */ select id, year, month from functional.alltypes"""
+
+
+class TestHdfsTableSinkOpenWriters(CustomClusterTestSuite):
+
+  @classmethod
+  def get_workload(cls):
+    return 'functional-query'
+
+  def _insert(self, db, insert):
+    """Runs 'insert' and returns the number of files that the sink created and the
+    number of writers it closed early."""
+    result = self.execute_query_expect_success(self.client, insert.format(db),
+        QUERY_OPTIONS)
+    return (self._get_sink_counter(result.runtime_profile, "FilesCreated"),
+        self._get_sink_counter(result.runtime_profile, "PartitionWritersClosedEarly"))
+
+  def _get_sink_counter(self, profile, name):
+    # The averaged fragment comes first in the profile, the only instance last.
+    values = re.findall(r"{0}: .*\((\d+)\)".format(name), profile)
+    assert len(values) > 0, name
+    return int(values[-1])
+
+  def _num_files(self, db, tbl):
+    return len(self.execute_query_expect_success(self.client,
+        "show files in {0}.{1}".format(db, tbl)).data)
+
+  def _create_tables(self, db):
+    self.execute_query_expect_success(self.client, """create table {0}.int_parts
+        (id int) partitioned by (p int) stored as parquet""".format(db))
+    self.execute_query_expect_success(self.client, """create table {0}.month_parts
+        (id int) partitioned by (year int, month int) stored as parquet""".format(db))
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args("--hdfs_sink_max_open_partition_writers=0")
+  def test_no_writer_limit(self, vector, unique_database):
+    """Tests that without a limit, every partition of unclustered input gets a single
+    file, and that input that is clustered by the partition keys gets one file per
+    partition as well while only one writer is kept open."""
+    self._create_tables(unique_database)
+    files_created, closed_early = self._insert(unique_database, INSERT_UNCLUSTERED)
+    assert files_created == 10
+    assert closed_early == 0
+    assert self._num_files(unique_database, "int_parts") == 10
+
+    files_created, closed_early = self._insert(unique_database, INSERT_CLUSTERED)
+    assert files_created == 24
+    assert closed_early == 23
+    assert self._num_files(unique_database, "month_parts") == 24
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args("--hdfs_sink_max_open_partition_writers=2")
+  def test_writer_limit(self, vector, unique_database):
+    """Tests that with a limit, the partitions of unclustered input whose writers were
+    closed get new files for their later rows, and that no rows are lost."""
+    self._create_tables(unique_database)
+    files_created, closed_early = self._insert(unique_database, INSERT_UNCLUSTERED)
+    assert closed_early > 0
+    assert files_created > 10
+    assert files_created <= 10 + closed_early
+    assert self._num_files(unique_database, "int_parts") == files_created
+    result = self.execute_query_expect_success(self.client,
+        "select p, count(*) from {0}.int_parts group by p order by p".format(
+            unique_database))
+    assert result.data == ["{0}\t730".format(p) for p in range(10)]
+
+    # Clustered input keeps a single writer open, so the limit does not matter.
+    files_created, closed_early = self._insert(unique_database, INSERT_CLUSTERED)
+    assert files_created == 24
+    assert self._num_files(unique_database, "month_parts") == 24
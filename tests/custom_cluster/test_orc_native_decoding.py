@@ -0,0 +1,148 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+# Differential tests of the native ORC decoding against the ORC library.
+
+import pytest
+import re
+
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.skip import SkipIfS3, SkipIfABFS, SkipIfADLS, SkipIfGCS, SkipIfLocal
+from tests.common.test_dimensions import create_exec_option_dimension
+from tests.util.filesystem_utils import get_fs_path
+
+# Files written by Hive with these table properties cover the codecs, the RLEv1 (file
+# version 0.11) and RLEv2 integer encodings, and the direct and dictionary string
+# encodings. A dictionary key threshold of 0 disables dictionaries, 1 always uses them.
+ORC_VARIANTS = [
+  ('none', 'NONE', '0.12', '1'),
+  ('none_direct', 'NONE', '0.12', '0'),
+  ('zlib', 'ZLIB', '0.12', '1'),
+  ('zlib_direct', 'ZLIB', '0.12', '0'),
+  ('snappy', 'SNAPPY', '0.12', '1'),
+  ('lz4', 'LZ4', '0.12', '0'),
+  ('rlev1', 'ZLIB', '0.11', '1'),
+  ('rlev1_direct', 'NONE', '0.11', '0'),
+]
+
+# NULLs in every column, large and negative integers for the patched base and delta
+# runs of RLEv2, and strings that are longer than the VARCHAR and CHAR columns of the
+# truncating tables.
+SOURCE_QUERY = """select id,
+    if(id % 7 = 0, null, smallint_col) smallint_col,
+    if(id % 5 = 0, null, int_col * (id % 100)) int_col,
+    if(id % 9 = 0, null,
+       if(id % 101 = 0, bigint_col * 100000000000, id - 3650)) bigint_col,
+    if(id % 11 = 0, null, float_col) float_col,
+    if(id % 3 = 0, null, double_col * id) double_col,
+    if(id % 13 = 0, null, concat(string_col, '-', date_string_col)) string_col,
+    if(id % 17 = 0, null, date_string_col) date_string_col
+    from functional.alltypes"""
+
+COLUMNS = """id int, smallint_col smallint, int_col int, bigint_col bigint,
+    float_col float, double_col double"""
+
+QUERIES = [
+  "select * from {tbl} order by id",
+  "select * from {tbl}_trunc order by id",
+  """select count(*), count(int_col), sum(bigint_col), min(string_col),
+     max(date_string_col), sum(length(string_col)) from {tbl}""",
+  """select id, string_col from {tbl} where int_col > 300 and string_col like '1%'
+     order by id""",
+  "select date_string_col, count(*) from {tbl}_trunc group by 1 order by 1",
+]
+
+
+@SkipIfS3.hive
+@SkipIfABFS.hive
+@SkipIfADLS.hive
+@SkipIfGCS.hive
+@SkipIfLocal.hive
+class TestOrcNativeDecoding(CustomClusterTestSuite):
+
+  @classmethod
+  def get_workload(self):
+    return 'functional-query'
+
+  @classmethod
+  def setup_class(cls):
+    if cls.exploration_strategy() != 'exhaustive':
+      pytest.skip('runs only in exhaustive')
+    super(TestOrcNativeDecoding, cls).setup_class()
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(CustomClusterTestSuite, cls).add_test_dimensions()
+    cls.ImpalaTestMatrix.add_dimension(create_exec_option_dimension(
+        cluster_sizes=[0], disable_codegen_options=[False], batch_sizes=[0]))
+    cls.ImpalaTestMatrix.add_constraint(
+        lambda v: v.get_value('table_format').file_format == 'orc')
+
+  def _create_tables(self, db, name, codec, write_format, dictionary_threshold):
+    """Writes the source rows to an ORC table with Hive and creates a table over the
+    same files that truncates the string columns to VARCHAR and CHAR."""
+    location = get_fs_path("/test-warehouse/{0}.db/{1}".format(db, name))
+    self.run_stmt_in_hive("""create external table {0}.{1} ({2},
+        string_col string, date_string_col string) stored as orc location '{3}'
+        tblproperties ('orc.compress'='{4}', 'orc.write.format'='{5}',
+        'orc.dictionary.key.threshold'='{6}', 'orc.row.index.stride'='1000',
+        'orc.stripe.size'='65536')""".format(db, name, COLUMNS, location, codec,
+        write_format, dictionary_threshold))
+    self.run_stmt_in_hive("insert overwrite table {0}.{1} {2}".format(
+        db, name, SOURCE_QUERY))
+    self.client.execute("invalidate metadata {0}.{1}".format(db, name))
+    self.client.execute("""create external table {0}.{1}_trunc ({2},
+        string_col varchar(4), date_string_col char(5)) stored as orc
+        location '{3}'""".format(db, name, COLUMNS, location))
+
+  def _run_queries(self, vector, db):
+    """Returns the results of QUERIES for each variant and the number of stripes that
+    were decoded natively."""
+    results = {}
+    num_native_stripes = {}
+    for name, _, _, _ in ORC_VARIANTS:
+      for query in QUERIES:
+        result = self.execute_query_expect_success(self.client,
+            query.format(tbl="{0}.{1}".format(db, name)),
+            vector.get_value('exec_option'))
+        results[(name, query)] = result.data
+        num_native_stripes[name] = num_native_stripes.get(name, 0) + sum(
+            int(n) for n in re.findall(r"NumOrcStripesDecodedNatively: (\d+)",
+                result.runtime_profile))
+    return results, num_native_stripes
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args("--enable_orc_native_decoding=false")
+  def test_native_decoding_matches_library(self, vector, unique_database):
+    for name, codec, write_format, dictionary_threshold in ORC_VARIANTS:
+      self._create_tables(unique_database, name, codec, write_format,
+          dictionary_threshold)
+    library_results, num_native_stripes = self._run_queries(vector, unique_database)
+    assert all(n == 0 for n in num_native_stripes.values())
+
+    self.close_impala_clients()
+    self._start_impala_cluster(["--impalad_args=--enable_orc_native_decoding=true"])
+    self.create_impala_clients()
+    native_results, num_native_stripes = self._run_queries(vector, unique_database)
+    for key, rows in library_results.items():
+      assert native_results[key] == rows, "Results differ for {0}".format(key)
+    # RLEv1 stripes are left to the ORC library, all others are decoded natively.
+    for name, _, write_format, _ in ORC_VARIANTS:
+      if write_format == '0.11':
+        assert num_native_stripes[name] == 0, name
+      else:
+        assert num_native_stripes[name] > 0, name
@@ -0,0 +1,113 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+# Tests for the parallel encoding of the columns of Parquet files.
+
+import os
+import pytest
+from subprocess import check_call
+
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.skip import SkipIfLocal
+from tests.util.filesystem_utils import get_fs_path
+
+# The rows are sorted so that every writer gets them in the same order. The o_comment
+# column falls back from dictionary to plain encoding.
+INSERT_SORTED_ORDERS = """insert into {0}.{1}
+    select * from tpch.orders order by o_orderkey limit 300000"""
+
+# Rows of up to 40KB, with values that are still smaller than a data page.
+INSERT_WIDE_ROWS = """insert into {0}.wide_rows
+    select o_orderkey, repeat(o_comment, 300), repeat(o_clerk, 1000)
+    from tpch.orders where o_orderkey < 8000"""
+
+FILE_SIZE = 8 * 1024 * 1024
+
+
+@SkipIfLocal.hdfs_client
+class TestParquetEncodingThreads(CustomClusterTestSuite):
+
+  @classmethod
+  def get_workload(cls):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(CustomClusterTestSuite, cls).add_test_dimensions()
+    cls.ImpalaTestMatrix.add_constraint(lambda v:
+        v.get_value('table_format').file_format == 'parquet' and
+        v.get_value('table_format').compression_codec == 'none')
+
+  def _insert_orders(self, db, tbl):
+    self.execute_query_expect_success(self.client,
+        "create table {0}.{1} like tpch_parquet.orders stored as parquet".format(db, tbl))
+    self.execute_query_expect_success(self.client,
+        INSERT_SORTED_ORDERS.format(db, tbl), {'num_nodes': 1})
+
+  def _copy_files_to_local(self, db, tbl, local_dir):
+    """Copies the files of 'tbl' to 'local_dir' and returns their contents."""
+    os.mkdir(local_dir)
+    check_call(['hadoop', 'fs', '-copyToLocal',
+        get_fs_path('/test-warehouse/{0}.db/{1}/*.parq'.format(db, tbl)), local_dir])
+    contents = []
+    for name in sorted(os.listdir(local_dir)):
+      with open(os.path.join(local_dir, name), 'rb') as f:
+        contents.append(f.read())
+    return contents
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args("--parquet_writer_encoding_threads=0")
+  def test_parallel_encoding_output_identical(self, vector, unique_database, tmpdir):
+    """Tests that the files written with encoding threads are the same byte for byte as
+    the ones written without them."""
+    self._insert_orders(unique_database, "sequential")
+
+    self.close_impala_clients()
+    self._start_impala_cluster(["--impalad_args=--parquet_writer_encoding_threads=4"])
+    self.create_impala_clients()
+    self._insert_orders(unique_database, "parallel")
+
+    sequential_files = self._copy_files_to_local(unique_database, "sequential",
+        tmpdir.join("sequential").strpath)
+    parallel_files = self._copy_files_to_local(unique_database, "parallel",
+        tmpdir.join("parallel").strpath)
+    assert len(sequential_files) == 1
+    assert len(parallel_files) == 1
+    assert sequential_files[0] == parallel_files[0]
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args("--parquet_writer_encoding_threads=4")
+  def test_parallel_encoding_file_size(self, vector, unique_database):
+    """Tests that the files written with encoding threads stay below the file size limit
+    when the rows are wide."""
+    self.execute_query_expect_success(self.client, """create table {0}.wide_rows
+        (id bigint, s1 string, s2 string) stored as parquet""".format(unique_database))
+    self.execute_query_expect_success(self.client,
+        INSERT_WIDE_ROWS.format(unique_database),
+        {'num_nodes': 1, 'parquet_file_size': FILE_SIZE, 'compression_codec': 'none'})
+
+    sizes = self.filesystem_client.get_all_file_sizes(
+        get_fs_path("test-warehouse/{0}.db/wide_rows".format(unique_database)))
+    assert len(sizes) > 1
+    for size in sizes:
+      assert size <= FILE_SIZE, "File size {0} is over the limit".format(size)
+    result = self.execute_query_expect_success(self.client,
+        "select count(*), sum(length(s1)) from {0}.wide_rows".format(unique_database))
+    expected = self.execute_query_expect_success(self.client,
+        """select count(*), sum(length(o_comment) * 300) from tpch.orders
+        where o_orderkey < 8000""")
+    assert result.data == expected.data
@@ -0,0 +1,256 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+# Differential tests of the pipelined decompression of the data pages of Parquet column
+# chunks against their sequential decompression.
+
+import os
+import pytest
+import re
+from parquet.ttypes import OffsetIndex
+from subprocess import check_call
+
+from tests.beeswax.impala_beeswax import ImpalaBeeswaxException
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.skip import (SkipIfS3, SkipIfABFS, SkipIfADLS, SkipIfGCS,
+    SkipIfLocal)
+from tests.util.cancel_util import cancel_query_and_validate_state
+from tests.util.filesystem_utils import get_fs_path
+from tests.util.get_parquet_metadata import (get_parquet_metadata,
+    read_serialized_object)
+
+SEQUENTIAL = "--parquet_decompression_read_ahead_pages=0"
+# GZIP and ZSTD column chunks of any size are decompressed in a separate thread.
+PIPELINED = ("--parquet_decompression_read_ahead_pages=4 "
+    "--parquet_pipelined_decompression_min_chunk_size=0")
+
+# The low cardinality columns are dictionary encoded, l_comment falls back to plain
+# encoding.
+LINEITEM_QUERIES = [
+  """select count(*), sum(l_orderkey), sum(l_extendedprice), min(l_shipdate),
+     max(l_comment), sum(length(l_comment)) from {tbl}""",
+  """select l_returnflag, l_linestatus, l_shipmode, count(*) from {tbl}
+     group by 1, 2, 3 order by 1, 2, 3""",
+  "select * from {tbl} where l_orderkey % 50000 = 1 order by l_orderkey, l_linenumber",
+]
+
+# The pages of 100 rows give column chunks with many pages in every read ahead batch.
+ALLTYPES_QUERIES = [
+  "select * from {tbl} order by id",
+  "select id, string_col from {tbl} where int_col = 3 and id % 7 = 0 order by id",
+]
+
+CODECS = ['snappy', 'gzip', 'zstd']
+
+# The codecs whose column chunks are decompressed in a separate thread.
+PIPELINED_CODECS = ['gzip', 'zstd']
+
+# The data pages of l_comment whose compressed bytes are overwritten: the first one, one
+# in the middle and the last one.
+CORRUPT_PAGES = ['first', 'middle', 'last']
+
+
+@SkipIfLocal.hdfs_client
+class TestParquetPipelinedDecompression(CustomClusterTestSuite):
+
+  @classmethod
+  def get_workload(cls):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(CustomClusterTestSuite, cls).add_test_dimensions()
+    cls.ImpalaTestMatrix.add_constraint(lambda v:
+        v.get_value('table_format').file_format == 'parquet' and
+        v.get_value('table_format').compression_codec == 'none')
+
+  def _restart_pipelined(self):
+    self.close_impala_clients()
+    self._start_impala_cluster(["--impalad_args={0}".format(PIPELINED)])
+    self.create_impala_clients()
+
+  def _num_pipelined_chunks(self, profile):
+    return sum(int(n) for n in
+        re.findall(r"NumPipelinedDecompressionColumnChunks: (\d+)", profile))
+
+  def _run(self, query, query_options=None):
+    """Returns the rows of 'query', or None if it failed, and the number of column chunks
+    whose decompression was pipelined."""
+    try:
+      result = self.execute_query(query, query_options)
+    except ImpalaBeeswaxException:
+      return None, 0
+    return result.data, self._num_pipelined_chunks(result.runtime_profile)
+
+  def _run_queries(self, queries):
+    """Runs the (query, query_options) pairs of 'queries' and returns a list of their
+    results and the number of column chunks whose decompression was pipelined."""
+    results = []
+    num_pipelined_chunks = 0
+    for query, query_options in queries:
+      rows, num_chunks = self._run(query, query_options)
+      results.append(rows)
+      num_pipelined_chunks += num_chunks
+    return results, num_pipelined_chunks
+
+  def _compare_with_pipelined(self, queries):
+    """Runs 'queries' with the sequential decompression of the current cluster and again
+    after restarting it with pipelined decompression, checks that the results are the
+    same and returns them."""
+    sequential_results, num_pipelined_chunks = self._run_queries(queries)
+    assert num_pipelined_chunks == 0
+    self._restart_pipelined()
+    pipelined_results, num_pipelined_chunks = self._run_queries(queries)
+    assert num_pipelined_chunks > 0
+    for query, sequential, pipelined in zip(queries, sequential_results,
+        pipelined_results):
+      assert pipelined == sequential, "Results differ for {0}".format(query)
+    return pipelined_results
+
+  def _corrupt_page(self, db, src_tbl, dst_tbl, column, page, tmpdir):
+    """Creates 'dst_tbl' over a copy of the single file of 'src_tbl' whose compressed
+    bytes of the given data page of 'column' are overwritten. The page headers stay
+    intact."""
+    local_dir = tmpdir.join(dst_tbl).strpath
+    os.mkdir(local_dir)
+    check_call(['hadoop', 'fs', '-copyToLocal',
+        get_fs_path('/test-warehouse/{0}.db/{1}/*.parq'.format(db, src_tbl)), local_dir])
+    files = os.listdir(local_dir)
+    assert len(files) == 1
+    local_file = os.path.join(local_dir, files[0])
+    file_meta_data = get_parquet_metadata(local_file)
+    assert len(file_meta_data.row_groups) == 1
+    col_idx = [s.name for s in file_meta_data.schema[1:]].index(column)
+    col_chunk = file_meta_data.row_groups[0].columns[col_idx]
+    with open(local_file, 'r+b') as f:
+      offset_index = read_serialized_object(OffsetIndex, f,
+          col_chunk.offset_index_offset, col_chunk.offset_index_length)
+      locations = offset_index.page_locations
+      assert len(locations) > 2
+      loc = {'first': locations[0], 'middle': locations[len(locations) / 2],
+          'last': locations[-1]}[page]
+      # The page header is much smaller than the last half of the page.
+      num_bytes = loc.compressed_page_size / 2
+      f.seek(loc.offset + loc.compressed_page_size - num_bytes)
+      f.write('\x00' * num_bytes)
+
+    location = get_fs_path("/test-warehouse/{0}.db/{1}".format(db, dst_tbl))
+    self.execute_query_expect_success(self.client,
+        "create table {0}.{1} like {0}.{2} location '{3}'".format(
+            db, dst_tbl, src_tbl, location))
+    self.filesystem_client.copy_from_local(local_file, location)
+    self.execute_query_expect_success(self.client,
+        "refresh {0}.{1}".format(db, dst_tbl))
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=SEQUENTIAL)
+  def test_pipelined_matches_sequential(self, vector, unique_database, tmpdir):
+    """Tests that pipelined decompression returns the same rows as sequential
+    decompression for column chunks with dictionary pages, plain encoded data pages and
+    many small pages, and that corrupt pages fail the same queries. Only the GZIP and
+    ZSTD column chunks are pipelined."""
+    db = unique_database
+    for codec in CODECS:
+      self.execute_query_expect_success(self.client, """create table {0}.lineitem_{1}
+          stored as parquet as select * from tpch.lineitem where l_orderkey < 1000000
+          """.format(db, codec), {'compression_codec': codec, 'num_nodes': 1})
+    self.execute_query_expect_success(self.client, """create table {0}.alltypes_pages
+        stored as parquet as select * from functional.alltypes""".format(db),
+        {'compression_codec': 'gzip', 'num_nodes': 1,
+         'parquet_page_row_count_limit': 100})
+    for page in CORRUPT_PAGES:
+      self._corrupt_page(db, "lineitem_gzip", "corrupt_{0}".format(page), "l_comment",
+          page, tmpdir)
+
+    tables = ["tpch_parquet.lineitem"] +\
+        ["{0}.lineitem_{1}".format(db, codec) for codec in CODECS]
+    queries = [(q.format(tbl=t), None) for t in tables for q in LINEITEM_QUERIES]
+    queries += [(q.format(tbl="{0}.alltypes_pages".format(db)), None)
+        for q in ALLTYPES_QUERIES]
+    for page in CORRUPT_PAGES:
+      for abort_on_error in [0, 1]:
+        queries.append(("select count(*), max(l_comment) from {0}.corrupt_{1}".format(
+            db, page), {'abort_on_error': abort_on_error}))
+    results = self._compare_with_pipelined(queries)
+
+    rows_by_query = dict((query, rows) for (query, query_options), rows
+        in zip(queries, results) if query_options is None)
+    expected = self.execute_query_expect_success(self.client,
+        LINEITEM_QUERIES[0].format(
+            tbl="(select * from tpch.lineitem where l_orderkey < 1000000) v")).data
+    for codec in CODECS:
+      assert rows_by_query[LINEITEM_QUERIES[0].format(
+          tbl="{0}.lineitem_{1}".format(db, codec))] == expected, codec
+    expected = self.execute_query_expect_success(self.client,
+        ALLTYPES_QUERIES[0].format(tbl="functional.alltypes")).data
+    assert rows_by_query[ALLTYPES_QUERIES[0].format(
+        tbl="{0}.alltypes_pages".format(db))] == expected
+    for (query, query_options), rows in zip(queries, results):
+      if query_options is not None and query_options['abort_on_error'] == 1:
+        assert rows is None, query
+
+    for tbl in tables:
+      _, num_chunks = self._run(LINEITEM_QUERIES[0].format(tbl=tbl))
+      is_pipelined_codec = any(tbl.endswith("_" + c) for c in PIPELINED_CODECS)
+      assert (num_chunks > 0) == is_pipelined_codec, tbl
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=PIPELINED)
+  def test_close_with_page_in_flight(self, vector, unique_database):
+    """Tests that scans that end early or are cancelled while data pages are decompressed
+    in the separate thread shut down cleanly."""
+    self.execute_query_expect_success(self.client, """create table {0}.lineitem_gzip
+        stored as parquet as select * from tpch.lineitem""".format(unique_database),
+        {'compression_codec': 'gzip'})
+    for limit in [1, 10, 5000]:
+      result = self.execute_query_expect_success(self.client,
+          "select * from {0}.lineitem_gzip limit {1}".format(unique_database, limit))
+      assert len(result.data) == limit
+      assert self._num_pipelined_chunks(result.runtime_profile) > 0
+    for cancel_delay in [0.1, 0.5, 1]:
+      cancel_query_and_validate_state(self.client,
+          """select count(*) from {0}.lineitem_gzip
+          where l_comment like '%x%y%z%'""".format(unique_database),
+          None, None, cancel_delay)
+
+  @SkipIfS3.hive
+  @SkipIfABFS.hive
+  @SkipIfADLS.hive
+  @SkipIfGCS.hive
+  @SkipIfLocal.hive
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=SEQUENTIAL)
+  def test_data_page_v2(self, vector, unique_database):
+    """Tests that pipelined decompression treats files with DATA_PAGE_V2 pages written by
+    Hive like sequential decompression does."""
+    if self.exploration_strategy() != 'exhaustive':
+      pytest.skip('runs only in exhaustive')
+    location = get_fs_path("/test-warehouse/{0}.db/alltypes_v2".format(unique_database))
+    self.run_stmt_in_hive("""create external table {0}.alltypes_v2 (id int,
+        int_col int, string_col string) stored as parquet location '{1}'""".format(
+        unique_database, location))
+    self.run_stmt_in_hive("""set parquet.writer.version=v2;
+        set parquet.compression=gzip; set parquet.page.size=4096;
+        insert overwrite table {0}.alltypes_v2
+        select id, int_col, string_col from functional.alltypes""".format(
+        unique_database))
+    self.client.execute("invalidate metadata {0}.alltypes_v2".format(unique_database))
+    self._compare_with_pipelined([(q.format(tbl="{0}.alltypes_v2".format(
+        unique_database)), None) for q in [
+        "select * from {tbl} order by id",
+        "select count(*), count(string_col), sum(int_col) from {tbl}"]] +
+        [("select count(*), max(l_comment) from tpch_parquet.lineitem", None)])
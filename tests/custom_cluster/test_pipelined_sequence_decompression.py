@@ -0,0 +1,187 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+# Tests for the pipelined decompression of the blocks of SequenceFiles and RCFiles.
+
+import os
+import pytest
+import re
+import shutil
+import struct
+import tempfile
+import zlib
+
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.util.cancel_util import cancel_query_and_validate_state
+from tests.util.filesystem_utils import get_fs_path
+
+# Scan ranges of any size are decompressed in a separate thread.
+PIPELINE_ALL_RANGES = "--pipelined_sequence_decompression_min_range_size=0"
+
+CHECKSUM_QUERY = """select count(*), sum(l_orderkey), sum(l_linenumber),
+    max(l_comment) from {0}.lineitem"""
+
+SYNC = "0123456789abcdef"
+NUM_BLOCKS = 5
+ROWS_PER_BLOCK = 200
+
+
+def _vlong(i):
+  """Returns 'i' encoded like Hadoop's WritableUtils.writeVLong()."""
+  if -112 <= i <= 127: return struct.pack("b", i)
+  length = -112
+  if i < 0:
+    i ^= -1
+    length = -120
+  tmp = i
+  while tmp != 0:
+    tmp >>= 8
+    length -= 1
+  num_bytes = -(length + 120) if length < -120 else -(length + 112)
+  return struct.pack("b", length) + "".join(
+      chr((i >> (8 * (idx - 1))) & 0xff) for idx in xrange(num_bytes, 0, -1))
+
+
+def _text(s):
+  """Returns 's' serialized like a Hadoop Text."""
+  return _vlong(len(s)) + s
+
+
+def _rows(block):
+  return ["block%d-row%03d" % (block, i) for i in xrange(ROWS_PER_BLOCK)]
+
+
+def _make_seq_file(corrupt_block=None, truncate=False):
+  """Returns a block-compressed SequenceFile with NUM_BLOCKS blocks of ROWS_PER_BLOCK
+  rows each, compressed with the DefaultCodec. The values of 'corrupt_block' are not
+  valid compressed data. If 'truncate' is true, the file ends in the middle of the
+  values of the last block."""
+  data = "SEQ\x06" + _text("org.apache.hadoop.io.BytesWritable") +\
+      _text("org.apache.hadoop.io.Text") + "\x01\x01" +\
+      _text("org.apache.hadoop.io.compress.DefaultCodec") + struct.pack(">i", 0) + SYNC
+  for block in xrange(NUM_BLOCKS):
+    values = zlib.compress("".join(_text(row) for row in _rows(block)))
+    if block == corrupt_block: values = "\x00" * len(values)
+    # The scanner skips the key lengths, keys and value lengths.
+    data += struct.pack(">i", -1) + SYNC + _vlong(ROWS_PER_BLOCK) +\
+        _text(zlib.compress("")) * 3 + _text(values)
+  if truncate: data = data[:-len(values) / 2]
+  return data
+
+
+class TestPipelinedSequenceDecompression(CustomClusterTestSuite):
+
+  @classmethod
+  def get_workload(cls):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(CustomClusterTestSuite, cls).add_test_dimensions()
+    cls.ImpalaTestMatrix.add_constraint(lambda v:
+        v.get_value('table_format').file_format == 'text' and
+        v.get_value('table_format').compression_codec == 'none')
+
+  def _num_pipelined_ranges(self, profile):
+    return sum(int(n) for n in
+        re.findall(r"PipelinedDecompressionRanges: (\d+)", profile))
+
+  def _create_seq_table(self, db, name, data):
+    location = get_fs_path("/test-warehouse/{0}.db/{1}".format(db, name))
+    self.execute_query_expect_success(self.client, """create table {0}.{1} (s string)
+        stored as sequencefile location '{2}'""".format(db, name, location))
+    tmp_dir = tempfile.mkdtemp()
+    try:
+      local_file = os.path.join(tmp_dir, "data.seq")
+      with open(local_file, "wb") as f:
+        f.write(data)
+      self.filesystem_client.copy_from_local(local_file, location)
+    finally:
+      shutil.rmtree(tmp_dir)
+    self.execute_query_expect_success(self.client, "refresh {0}.{1}".format(db, name))
+
+  def _scan_seq_table(self, db, name, query_options):
+    result = self.execute_query_expect_success(self.client,
+        "select s from {0}.{1}".format(db, name), query_options)
+    assert self._num_pipelined_ranges(result.runtime_profile) > 0
+    return sorted(result.data)
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=PIPELINE_ALL_RANGES)
+  def test_read_ahead_across_syncs(self, vector, unique_database):
+    """Tests that reading ahead across the sync markers of many blocks and across the
+    ends of scan ranges neither loses nor duplicates rows."""
+    expected = self.execute_query_expect_success(self.client,
+        CHECKSUM_QUERY.format("tpch_parquet")).data
+    for db in ["tpch_seq_snap", "tpch_seq_gzip"]:
+      for max_range_len in [0, 1024 * 1024]:
+        result = self.execute_query_expect_success(self.client,
+            CHECKSUM_QUERY.format(db), {'max_scan_range_length': max_range_len})
+        assert result.data == expected, db
+        assert self._num_pipelined_ranges(result.runtime_profile) > 0
+    if self.exploration_strategy() == 'exhaustive':
+      result = self.execute_query_expect_success(self.client,
+          CHECKSUM_QUERY.format("tpch_rc_snap"), {'max_scan_range_length': 1024 * 1024})
+      assert result.data == expected
+      assert self._num_pipelined_ranges(result.runtime_profile) > 0
+
+    # Ranges that end between any two of the sync markers of a small file.
+    self._create_seq_table(unique_database, "valid", _make_seq_file())
+    all_rows = sorted(row for block in xrange(NUM_BLOCKS) for row in _rows(block))
+    for max_range_len in [0, 100, 700, 1500]:
+      assert self._scan_seq_table(unique_database, "valid",
+          {'max_scan_range_length': max_range_len}) == all_rows
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=PIPELINE_ALL_RANGES)
+  def test_errors_in_read_ahead_blocks(self, vector, unique_database):
+    """Tests that errors in blocks that were read ahead take effect after the rows of
+    the blocks before them were returned, and that the scan continues with the block
+    after them."""
+    for corrupt_block in [0, 2, NUM_BLOCKS - 1]:
+      name = "corrupt_block_{0}".format(corrupt_block)
+      self._create_seq_table(unique_database, name,
+          _make_seq_file(corrupt_block=corrupt_block))
+      expected = sorted(row for block in xrange(NUM_BLOCKS)
+          if block != corrupt_block for row in _rows(block))
+      assert self._scan_seq_table(unique_database, name, {'abort_on_error': 0}) ==\
+          expected, name
+      self.execute_query_expect_failure(self.client,
+          "select s from {0}.{1}".format(unique_database, name), {'abort_on_error': 1})
+
+    # The end of the file is reached while reading the last block ahead.
+    self._create_seq_table(unique_database, "truncated", _make_seq_file(truncate=True))
+    expected = sorted(row for block in xrange(NUM_BLOCKS - 1) for row in _rows(block))
+    assert self._scan_seq_table(unique_database, "truncated", {'abort_on_error': 0}) ==\
+        expected
+    self.execute_query_expect_failure(self.client,
+        "select s from {0}.truncated".format(unique_database), {'abort_on_error': 1})
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=PIPELINE_ALL_RANGES)
+  def test_close_with_block_in_flight(self, vector):
+    """Tests that scans that end early or are cancelled while a block is decompressed
+    in the separate thread shut down cleanly."""
+    for db in ["tpch_seq_snap", "functional_rc_snap"]:
+      table = "lineitem" if db.startswith("tpch") else "alltypesagg"
+      result = self.execute_query_expect_success(self.client,
+          "select * from {0}.{1} limit 10".format(db, table))
+      assert len(result.data) == 10
+    for cancel_delay in [0.1, 0.5, 1]:
+      cancel_query_and_validate_state(self.client,
+          "select count(*) from tpch_seq_snap.lineitem where l_comment like '%x%y%z%'",
+          None, None, cancel_delay)
@@ -0,0 +1,68 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+import pytest
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.impala_cluster import ImpalaCluster
+from tests.common.skip import SkipIfBuildType
+from tests.verifiers.metric_verifier import MetricVerifier
+
+
+@SkipIfBuildType.not_dev_build
+class TestRuntimeFilterAggregation(CustomClusterTestSuite):
+  """Tests that filter updates and published filters are not lost when the backends that
+  aggregate or forward them finish the query before the RPCs arrive."""
+  QUERY = """select STRAIGHT_JOIN count(*), sum(a.int_col) from functional.alltypes a
+      join [SHUFFLE] functional.alltypes b on a.id = b.id where b.int_col = 3"""
+
+  # The probe side scans only wait briefly for the filters, so that backends finish
+  # while the delayed RPCs are still in flight.
+  QUERY_OPTIONS = {'runtime_filter_mode': 'GLOBAL',
+                   'runtime_filter_wait_time_ms': 500,
+                   'runtime_filter_aggregation_fanout': 2,
+                   'max_scan_range_length': 1024}
+
+  @classmethod
+  def get_workload(cls):
+    return 'functional-query'
+
+  def _run_and_verify(self):
+    expected = self.execute_query_expect_success(self.client, self.QUERY,
+        {'runtime_filter_mode': 'OFF'}).data
+    for _ in range(3):
+      result = self.execute_query_expect_success(self.client, self.QUERY,
+          self.QUERY_OPTIONS)
+      assert result.data == expected
+    verifiers = [MetricVerifier(i.service)
+                 for i in ImpalaCluster.get_e2e_test_cluster().impalads]
+    for v in verifiers:
+      v.wait_for_metric("impala-server.num-fragments-in-flight", 0)
+      v.verify_num_unused_buffers()
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(
+      "--debug_actions=UPDATE_FILTER_FROM_REMOTE_DELAY:SLEEP@2000")
+  def test_aggregator_finished(self, vector):
+    """Updates that arrive after the aggregator finished are rejected by it and sent to
+    the coordinator instead."""
+    self._run_and_verify()
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args("--debug_actions=PUBLISH_FILTER_DELAY:SLEEP@2000")
+  def test_forwarder_finished(self, vector):
+    """Published filters are still forwarded by backends that finished the query."""
+    self._run_and_verify()
@@ -16,6 +16,7 @@
 # under the License.
 
 import pytest
+import re
 from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
 from tests.common.skip import SkipIfEC
 
@@ -46,3 +47,40 @@ class TestRuntimeProfile(CustomClusterTestSuite):
                                add_executors=True,
                                expected_num_executors=4)
     self.run_test_case('runtime-profile-aggregated', vector)
+
+  DELTA_PROFILE_QUERY = """select count(*), sum(id) from functional.alltypestiny
+      where sleep(200)"""
+
+  def _get_profile_counters(self, profile):
+    """Returns the sorted names of the counters and info strings in the execution profile
+    of 'profile' together with the values of the row counters, which don't depend on
+    timing."""
+    lines = profile[profile.index("Execution Profile"):].splitlines()
+    counters = []
+    for line in lines:
+      # Fragment instance ids differ between queries.
+      line = re.sub(r'[0-9a-f]{8,}:[0-9a-f]{8,}', 'ID', line)
+      if ':' not in line:
+        continue
+      name, value = [s.strip() for s in line.split(':', 1)]
+      counters.append(line.strip() if name in ("- RowsRead", "- RowsReturned") else name)
+    return sorted(counters)
+
+  def _run_delta_profile_query(self):
+    result = self.execute_query_expect_success(self.client, self.DELTA_PROFILE_QUERY,
+        {'num_nodes': 1})
+    return self._get_profile_counters(result.runtime_profile)
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(
+      '--status_report_delta_profiles=false --status_report_interval_ms=50')
+  def test_delta_profiles(self, vector):
+    """Tests that the final profile of a query that sends many status reports is the same
+    with and without delta profiles in the reports."""
+    full_profile = self._run_delta_profile_query()
+    self.close_impala_clients()
+    self._start_impala_cluster(['--impalad_args=--status_report_delta_profiles=true '
+        '--status_report_interval_ms=50'])
+    self.create_impala_clients()
+    delta_profile = self._run_delta_profile_query()
+    assert delta_profile == full_profile
@@ -25,7 +25,10 @@ import os
 import pytest
 import random
 import re
+import shutil
+import struct
 import tempfile
+import zlib
 from copy import deepcopy
 from parquet.ttypes import ConvertedType
 from subprocess import check_call
@@ -1272,6 +1275,90 @@ class TestTextSplitDelimiters(ImpalaTestSuite):
 
     assert sorted(result.data) == sorted(expected_result)
 
+class TestBgzfTextSplits(ImpalaTestSuite):
+  """Tests that the splits of BGZF-compressed text files are scanned in parallel without
+  losing or duplicating rows, and that other gzip files are still read as a whole."""
+  NUM_ROWS = 20000
+
+  @classmethod
+  def get_workload(cls):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestBgzfTextSplits, cls).add_test_dimensions()
+    cls.ImpalaTestMatrix.add_dimension(
+        create_exec_option_dimension(cluster_sizes=[0], batch_sizes=[0]))
+    cls.ImpalaTestMatrix.add_constraint(lambda v:
+        v.get_value('table_format').file_format == 'text' and
+        v.get_value('table_format').compression_codec == 'none')
+
+  @staticmethod
+  def _make_rows():
+    """Returns rows of varying length, so that rows cross the BGZF member and split
+    boundaries at different offsets."""
+    return "".join("%d,%s\n" % (i, "abcdefghij"[:i % 11] * (i % 7))
+        for i in xrange(TestBgzfTextSplits.NUM_ROWS))
+
+  @staticmethod
+  def _write_bgzf(f, data, member_size):
+    """Writes 'data' to 'f' as BGZF members of 'member_size' uncompressed bytes, followed
+    by the empty end-of-file member."""
+    chunks = [data[i:i + member_size] for i in xrange(0, len(data), member_size)]
+    for chunk in chunks + [""]:
+      compressor = zlib.compressobj(6, zlib.DEFLATED, -zlib.MAX_WBITS)
+      deflated = compressor.compress(chunk) + compressor.flush()
+      # Gzip header with the 'BC' extra subfield, which holds the member size - 1.
+      f.write(struct.pack("<BBBBIBBHBBHH", 31, 139, 8, 4, 0, 0, 255, 6, 66, 67, 2,
+          len(deflated) + 25))
+      f.write(deflated)
+      f.write(struct.pack("<II", zlib.crc32(chunk) & 0xffffffff, len(chunk)))
+
+  def _create_and_query_table(self, vector, unique_database, table_name, write_fn):
+    qualified_table_name = "%s.%s" % (unique_database, table_name)
+    location = get_fs_path("/test-warehouse/%s_%s" % (unique_database, table_name))
+    self.client.execute("create table %s (i int, s string) row format delimited "
+        "fields terminated by ',' location '%s'" % (qualified_table_name, location))
+    tmp_dir = tempfile.mkdtemp()
+    try:
+      # The file extension tells Impala that the file is gzip-compressed.
+      local_file = os.path.join(tmp_dir, "data.gz")
+      with open(local_file, "wb") as f:
+        write_fn(f, self._make_rows())
+      self.filesystem_client.copy_from_local(local_file, location)
+    finally:
+      shutil.rmtree(tmp_dir)
+    self.client.execute("refresh %s" % qualified_table_name)
+
+    exec_options = deepcopy(vector.get_value('exec_option'))
+    exec_options['max_scan_range_length'] = 4096
+    result = self.execute_query_expect_success(self.client,
+        "select count(*), count(distinct i), sum(i), sum(length(s)) from %s"
+        % qualified_table_name, exec_options)
+    n = self.NUM_ROWS
+    expected_length = sum(len("abcdefghij"[:i % 11] * (i % 7)) for i in xrange(n))
+    assert result.data == ["%d\t%d\t%d\t%d" % (n, n, n * (n - 1) / 2, expected_length)]
+
+  def test_bgzf_splits(self, vector, unique_database):
+    """Members are smaller than the splits, so every split contains member boundaries
+    and rows that continue in the next split."""
+    self._create_and_query_table(vector, unique_database, "bgzf_small",
+        lambda f, data: self._write_bgzf(f, data, 1000))
+
+  def test_bgzf_large_members(self, vector, unique_database):
+    """Members are larger than the splits, so some splits contain no member start and
+    produce no rows."""
+    self._create_and_query_table(vector, unique_database, "bgzf_large",
+        lambda f, data: self._write_bgzf(f, data, 40000))
+
+  def test_gzip_not_split(self, vector, unique_database):
+    """A plain gzip file spans several splits but is read as a whole by one scanner."""
+    def write_gzip(f, data):
+      compressor = zlib.compressobj(6, zlib.DEFLATED, zlib.MAX_WBITS | 16)
+      f.write(compressor.compress(data) + compressor.flush())
+    self._create_and_query_table(vector, unique_database, "gzip", write_gzip)
+
+
 # Test for IMPALA-1740: Support for skip.header.line.count
 class TestTextScanRangeLengths(ImpalaTestSuite):
   @classmethod
@@ -1378,6 +1465,29 @@ class TestUncompressedText(ImpalaTestSuite):
                                 unique_database, "lazy_ts", test_files)
     self.run_test_case('QueryTest/select-lazy-timestamp', vector, unique_database)
 
+class TestJson(ImpalaTestSuite):
+  @classmethod
+  def get_workload(cls):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestJson, cls).add_test_dimensions()
+    cls.ImpalaTestMatrix.add_dimension(
+        create_exec_option_dimension(cluster_sizes=[0],
+            disable_codegen_options=[False, True], batch_sizes=[0]))
+    cls.ImpalaTestMatrix.add_constraint(lambda v:
+        v.get_value('table_format').file_format == 'text' and
+        v.get_value('table_format').compression_codec == 'none')
+
+  def test_json_nulls(self, vector, unique_database):
+    """Tests that missing fields and JSON nulls are NULL with and without codegen."""
+    create_table_and_copy_files(self.client, """CREATE TABLE {db}.{tbl} (id INT,
+        b BOOLEAN, i INT, d DOUBLE, s STRING, v VARCHAR(3), ts TIMESTAMP)
+        STORED AS JSONFILE""", unique_database, "json_nulls",
+        ["testdata/data/json_nulls.json"])
+    self.run_test_case('QueryTest/json-nulls', vector, unique_database)
+
 class TestOrc(ImpalaTestSuite):
   @classmethod
   def get_workload(cls):
@@ -133,6 +133,11 @@ class TestSpillingNoDebugActionDimensions(ImpalaTestSuite):
        These tests either run with no debug action set or set their own debug action."""
     self.run_test_case('QueryTest/spilling-no-debug-action', vector)
 
+  def test_spilling_skew(self, vector):
+    """Test aggregations and joins on skewed inputs that repartitioning cannot split.
+       Some of the tests set their own debug action."""
+    self.run_test_case('QueryTest/spilling-skew', vector)
+
 
 @pytest.mark.xfail(IMPALA_TEST_CLUSTER_PROPERTIES.is_remote_cluster(),
                    reason='Queries may not spill on larger clusters')